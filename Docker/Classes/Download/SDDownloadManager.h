@@ -14,6 +14,9 @@
 
 @import AFNetworking;
 #import "SDDockerLogger.h"
+#import "SDConnectionPrewarmer.h"
+#import "SDNetworkQualityEstimator.h"
+#import "SDDeferredRequestQueue.h"
 
 /**
  *  Type of resource you want retreive. If not specified it will be return a generic NSData object.
@@ -97,6 +100,10 @@ typedef void (^ SDDownloadManagerBatchOperationCompletion)(BOOL downloadComplete
 // WARNING: in this moment the returned resource could be different from the finally one
 @property (nonatomic, assign) BOOL notifyBeforeValidityCheck;
 
+// non urgent download (ex. prefetch): it waits in deferredRequestQueue of the manager and starts with the next batch of deferred requests.
+// Resources still valid locally are returned immediately. Deferred downloads are saved across launches and restored without completion blocks
+@property (nonatomic, assign) BOOL deferrable;
+
 @end
 
 
@@ -196,6 +203,40 @@ typedef void (^ SDDownloadManagerBatchOperationCompletion)(BOOL downloadComplete
  */
 @property(nonatomic, strong, readonly) AFHTTPRequestOperationManager* _Nonnull downloadRequestOperationManager;
 
+/**
+ *  Urls of hosts (ex. your CDN) whose connections are opened at startup and every time network becomes reachable, before the first download.
+ *  Setting this property starts immediately the pre-warm. Pre-warm is skipped while there are pending downloads.
+ *
+ *  Default: nil (no pre-warm)
+ */
+@property(nonatomic, strong) NSArray<NSURL*>* _Nullable prewarmHosts;
+
+/**
+ *  Object that pre-warm connections of prewarmHosts. Use it to change budget and intervals or to read durations of pre-warms.
+ */
+@property(nonatomic, strong, readonly) SDConnectionPrewarmer* _Nonnull connectionPrewarmer;
+
+/**
+ *  Estimator that receives round trip time and throughput of every download and HEAD request that gets a response from server. Use nil to disable observations.
+ *
+ *  Default: [SDNetworkQualityEstimator sharedEstimator]
+ */
+@property(nonatomic, strong) SDNetworkQualityEstimator* _Nullable networkQualityEstimator;
+
+/**
+ *  Adapt the number of concurrent downloads to the quality of the network estimated by networkQualityEstimator: 2 on 2G or worse, 4 on 3G, 10 otherwise.
+ *
+ *  Default: NO (always 10)
+ */
+@property(nonatomic, assign) BOOL adaptsConcurrencyToNetworkQuality;
+
+/**
+ *  Queue of deferrable downloads (see deferrable of SDDownloadOptions). Use nil to start deferrable downloads immediately.
+ *
+ *  Default: [SDDeferredRequestQueue sharedQueue]
+ */
+@property(nonatomic, strong) SDDeferredRequestQueue* _Nullable deferredRequestQueue;
+
 
 
 
@@ -323,6 +364,14 @@ typedef void (^ SDDownloadManagerBatchOperationCompletion)(BOOL downloadComplete
 
 
 
+#pragma mark - Pre-warm
+
+/**
+ *  Pre-warm connections to all prewarmHosts. Called automatically when prewarmHosts is set and when network becomes reachable.
+ */
+- (void) prewarmConnections;
+
+
 #pragma mark - Cancel/Reset
 
 /**
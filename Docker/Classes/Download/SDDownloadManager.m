@@ -26,6 +26,8 @@
 #define CONTENT_LENGTH_EMPTY_IMAGE             100
 
 #define OPERATION_QUEUE_COUNT                  10
+#define OPERATION_QUEUE_COUNT_3G               4
+#define OPERATION_QUEUE_COUNT_2G               2
 
 #define DEFAULT_TIMEOUT_INTERVAL               120  // 2 min
 #define DEFAULT_EXPIRATION_INTERVAL            7200 // 2h
@@ -39,6 +41,17 @@
 
 #define DOWNLOAD_OPERATION_INFO_RESULT_TYPE    @"resultType"
 
+#define DEFERRED_DOWNLOAD_URL                  @"url"
+#define DEFERRED_DOWNLOAD_HTTP_METHOD          @"method"
+#define DEFERRED_DOWNLOAD_HEADERS              @"headers"
+#define DEFERRED_DOWNLOAD_TIMEOUT              @"timeout"
+#define DEFERRED_DOWNLOAD_TYPE                 @"type"
+#define DEFERRED_DOWNLOAD_LOCAL_PATH           @"localPath"
+#define DEFERRED_DOWNLOAD_EXPIRATION_INTERVAL  @"expirationInterval"
+#define DEFERRED_DOWNLOAD_FORCE_DOWNLOAD       @"forceDownload"
+#define DEFERRED_DOWNLOAD_USE_BUNDLE           @"useBundle"
+#define DEFERRED_DOWNLOAD_SAVE_DISABLED        @"saveDisabled"
+
 
 
 // ---------------------------------------------------------------------------------------------------------
@@ -123,6 +136,7 @@
 
 @property (nonatomic, strong, readwrite) NSDateFormatter* serverDateFormatter;
 @property (nonatomic, strong, readwrite) AFHTTPRequestOperationManager* downloadRequestOperationManager;
+@property (nonatomic, strong, readwrite) SDConnectionPrewarmer* connectionPrewarmer;
 
 @property (nonatomic, readwrite) BOOL checkSizeElementsProcessing;
 @property (nonatomic, strong) SDDownloadManagerCheckSizeCompletion checkSizeCompletion;
@@ -211,6 +225,16 @@
         self.memoryCache = [[NSCache alloc] init];
         self.memoryCache.delegate = self;
         
+        self.connectionPrewarmer = [[SDConnectionPrewarmer alloc] initWithLogModuleName:kDownloadManagerLogModuleName];
+        __weak typeof(self)weakSelf = self;
+        self.connectionPrewarmer.shouldPrewarmBlock = ^BOOL{
+            // running downloads already open the connections
+            return weakSelf.downloadRequestOperationManager.operationQueue.operationCount == 0;
+        };
+        
+        self.networkQualityEstimator = [SDNetworkQualityEstimator sharedEstimator];
+        self.deferredRequestQueue = [SDDeferredRequestQueue sharedQueue];
+        
         
         expirationDateInfoQueue = dispatch_queue_create("it.sysdata.downloadcache.info", DISPATCH_QUEUE_SERIAL);
         [self synchronizeCacheInfos];
@@ -226,6 +250,53 @@
     [[NSNotificationCenter defaultCenter] removeObserver:self];
 }
 
+#pragma mark - Network quality
+
+- (void) setNetworkQualityEstimator:(SDNetworkQualityEstimator*)networkQualityEstimator
+{
+    if (_networkQualityEstimator)
+    {
+        [[NSNotificationCenter defaultCenter] removeObserver:self name:SDNetworkQualityDidChangeNotification object:_networkQualityEstimator];
+    }
+    _networkQualityEstimator = networkQualityEstimator;
+    if (networkQualityEstimator)
+    {
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(updateConcurrentDownloads) name:SDNetworkQualityDidChangeNotification object:networkQualityEstimator];
+    }
+    [self updateConcurrentDownloads];
+}
+
+- (void) setAdaptsConcurrencyToNetworkQuality:(BOOL)adaptsConcurrencyToNetworkQuality
+{
+    _adaptsConcurrencyToNetworkQuality = adaptsConcurrencyToNetworkQuality;
+    [self updateConcurrentDownloads];
+}
+
+- (void) updateConcurrentDownloads
+{
+    NSInteger count = OPERATION_QUEUE_COUNT;
+    if (self.adaptsConcurrencyToNetworkQuality)
+    {
+        switch (self.networkQualityEstimator.quality)
+        {
+            case SDNetworkQualitySlow2G:
+            case SDNetworkQuality2G:
+                count = OPERATION_QUEUE_COUNT_2G;
+                break;
+            case SDNetworkQuality3G:
+                count = OPERATION_QUEUE_COUNT_3G;
+                break;
+            default:
+                break;
+        }
+    }
+    if (self.downloadRequestOperationManager.operationQueue.maxConcurrentOperationCount != count)
+    {
+        SDLogModuleInfo(kDownloadManagerLogModuleName, @"Concurrent downloads: %ld (network quality %@)", (long)count, NSStringFromSDNetworkQuality(self.networkQualityEstimator.quality));
+        self.downloadRequestOperationManager.operationQueue.maxConcurrentOperationCount = count;
+    }
+}
+
 - (BOOL) useBundle
 {
     if (!_useBundle)
@@ -657,6 +728,12 @@
         return;
     }
     
+    if (options.deferrable && self.deferredRequestQueue)
+    {
+        [self deferDownloadElement:elementType withRequest:request options:options lastModificationDate:lastModificationDate completionSuccess:completionSuccess progress:progress completionFailure:completionFailure];
+        return;
+    }
+    
     [self addSubscriberForUrl:urlString withCompletionSuccess:completionSuccess progress:progress completionFailure:completionFailure];
     
     if ([self downloadElementAlreadyQueued:options.localPath])
@@ -683,6 +760,98 @@
     }
 }
 
+#pragma mark - DEFERRED DOWNLOAD
+
+- (void) setDeferredRequestQueue:(SDDeferredRequestQueue*)deferredRequestQueue
+{
+    _deferredRequestQueue = deferredRequestQueue;
+    
+    // downloads deferred by managers of this class, restored ones included
+    __weak typeof(self)weakSelf = self;
+    [deferredRequestQueue setSendBlock:^BOOL (SDDeferredRequest* deferredRequest) {
+        if (deferredRequest.context)
+        {
+            dispatch_block_t downloadBlock = deferredRequest.context;
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), downloadBlock);
+            return YES;
+        }
+        if (!weakSelf)
+        {
+            return NO;
+        }
+        [weakSelf downloadDeferredPayload:deferredRequest.payload];
+        return YES;
+    } forOwnerName:NSStringFromClass([self class])];
+}
+
+- (void) deferDownloadElement:(DownloadOperationType)elementType
+                  withRequest:(NSMutableURLRequest*)request
+                      options:(SDDownloadOptions*)options
+         lastModificationDate:(NSDate*)lastModificationDate
+            completionSuccess:(SDDownloadManagerCompletionSuccessHandler)completionSuccess
+                     progress:(SDDownloadManagerProgressHandler)progress
+            completionFailure:(SDDownloadManagerCompletionFailureHandler)completionFailure
+{
+    NSString* urlString = request.URL.absoluteString;
+    SDLogModuleVerbose(kDownloadManagerLogModuleName, @"SDDownloadManager: download deferred for URL: %@", urlString);
+    
+    // options may be shared with other deferrable downloads
+    SDDownloadOptions* downloadOptions = [SDDownloadOptions new];
+    downloadOptions.localPath = options.localPath;
+    downloadOptions.expirationInterval = options.expirationInterval;
+    downloadOptions.forceDownload = options.forceDownload;
+    downloadOptions.useBundle = options.useBundle;
+    downloadOptions.saveDisabled = options.saveDisabled;
+    downloadOptions.notifyBeforeValidityCheck = options.notifyBeforeValidityCheck;
+    
+    __weak typeof(self)weakSelf = self;
+    dispatch_block_t downloadBlock = ^{
+        [weakSelf downloadElement:elementType withRequest:request options:downloadOptions lastModificationDate:lastModificationDate completionSuccess:completionSuccess progress:progress completionFailure:completionFailure];
+    };
+    
+    NSMutableDictionary* payload = [NSMutableDictionary dictionary];
+    payload[DEFERRED_DOWNLOAD_URL] = urlString;
+    payload[DEFERRED_DOWNLOAD_HTTP_METHOD] = request.HTTPMethod ?: @"GET";
+    payload[DEFERRED_DOWNLOAD_HEADERS] = request.allHTTPHeaderFields ?: @{};
+    payload[DEFERRED_DOWNLOAD_TIMEOUT] = @(request.timeoutInterval);
+    payload[DEFERRED_DOWNLOAD_TYPE] = @(elementType);
+    payload[DEFERRED_DOWNLOAD_EXPIRATION_INTERVAL] = @(options.expirationInterval);
+    payload[DEFERRED_DOWNLOAD_FORCE_DOWNLOAD] = @(options.forceDownload);
+    payload[DEFERRED_DOWNLOAD_USE_BUNDLE] = @(options.useBundle);
+    payload[DEFERRED_DOWNLOAD_SAVE_DISABLED] = @(options.saveDisabled);
+    // default local path is computed again at restore, because the app container path changes between launches
+    if (![options.localPath isEqualToString:[self localResourcePathForUrlString:urlString]])
+    {
+        payload[DEFERRED_DOWNLOAD_LOCAL_PATH] = options.localPath;
+    }
+    
+    [self.deferredRequestQueue enqueueRequestWithOwnerName:NSStringFromClass([self class]) requestDescription:urlString payload:payload context:downloadBlock];
+}
+
+- (void) downloadDeferredPayload:(NSDictionary*)payload
+{
+    NSURL* url = [NSURL URLWithString:payload[DEFERRED_DOWNLOAD_URL]];
+    if (!url)
+    {
+        SDLogModuleWarning(kDownloadManagerLogModuleName, @"SDDownloadManager: deferred download can't be restored: %@", payload);
+        return;
+    }
+    
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    request.HTTPMethod = payload[DEFERRED_DOWNLOAD_HTTP_METHOD] ?: @"GET";
+    request.allHTTPHeaderFields = payload[DEFERRED_DOWNLOAD_HEADERS];
+    request.timeoutInterval = [payload[DEFERRED_DOWNLOAD_TIMEOUT] doubleValue] ?: self.timeoutInterval;
+    
+    SDDownloadOptions* options = [SDDownloadOptions new];
+    options.localPath = payload[DEFERRED_DOWNLOAD_LOCAL_PATH];
+    options.expirationInterval = [payload[DEFERRED_DOWNLOAD_EXPIRATION_INTERVAL] doubleValue];
+    options.forceDownload = [payload[DEFERRED_DOWNLOAD_FORCE_DOWNLOAD] boolValue];
+    options.useBundle = [payload[DEFERRED_DOWNLOAD_USE_BUNDLE] boolValue];
+    options.saveDisabled = [payload[DEFERRED_DOWNLOAD_SAVE_DISABLED] boolValue];
+    
+    [self getResourceWithRequest:request type:[payload[DEFERRED_DOWNLOAD_TYPE] integerValue] options:options completionSuccess:nil progress:nil completionFailure:nil];
+}
+
 /**
  *  Check (HEAD) + download operation if needed
  */
@@ -862,6 +1031,11 @@
                           lastModifiedDate:(NSDate*)lastModifiedDate
                                   userInfo:(NSDictionary*)userInfo
 {
+    if (operation.response)
+    {
+        [self.networkQualityEstimator addObservationWithOperation:operation];
+    }
+    
     NSString* localPath = options.localPath;
     
     if (localPath)
@@ -978,6 +1152,10 @@
                                    options:(SDDownloadOptions*)options
                                   userInfo:(NSDictionary*)userInfo
 {
+    if (operation.response)
+    {
+        [self.networkQualityEstimator addObservationWithOperation:operation];
+    }
     [self checkEmptyQueue];
     
     DownloadOperationResultType resultType = [(NSNumber*) userInfo[DOWNLOAD_OPERATION_INFO_RESULT_TYPE] integerValue];
@@ -1108,6 +1286,20 @@
     }
 }
 
+#pragma mark Pre-warm
+
+- (void) setPrewarmHosts:(NSArray<NSURL*>*)prewarmHosts
+{
+    _prewarmHosts = [prewarmHosts copy];
+    self.connectionPrewarmer.hosts = _prewarmHosts;
+    [self prewarmConnections];
+}
+
+- (void) prewarmConnections
+{
+    [self.connectionPrewarmer prewarm];
+}
+
 #pragma mark Cancel Requests
 
 - (void) cancelAllDownloadRequests
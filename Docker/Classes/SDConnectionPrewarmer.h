@@ -0,0 +1,92 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+@import AFNetworking;
+
+typedef BOOL (^ SDConnectionPrewarmerShouldPrewarmBlock)(void);
+
+/**
+ *  Opens connections toward a list of hosts before the first real call, so that DNS resolution, TCP and TLS handshakes are not paid on the critical path.
+ *  Connections are kept in the shared URL loading system pool, so they are reused by any subsequent request to the same host.
+ *
+ *  Used by SDServiceManager and SDDownloadManager through their prewarmHosts property.
+ */
+@interface SDConnectionPrewarmer : NSObject
+
+- (instancetype _Nonnull) initWithLogModuleName:(NSString* _Nonnull)logModuleName;
+
+/**
+ *  Urls of hosts to pre-warm. Only scheme, host and port are used.
+ */
+@property (nonatomic, strong) NSArray<NSURL*>* _Nullable hosts;
+
+/**
+ *  Maximum number of pre-warm requests running at the same time. Keep it low, so pre-warming doesn't compete with real calls.
+ *
+ *  Default: 2
+ */
+@property (nonatomic, assign) NSUInteger budget;
+
+/**
+ *  Timeout for a single pre-warm request.
+ *
+ *  Default: 10 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval timeoutInterval;
+
+/**
+ *  Minimum interval between two pre-warms of the same host. Pre-warm requests asked before this interval are skipped.
+ *
+ *  Default: 30 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval minimumIntervalBetweenPrewarms;
+
+/**
+ *  Pre-warm all hosts again every time network becomes reachable (ex. after a network change). It starts monitoring of the shared AFNetworkReachabilityManager.
+ *
+ *  Default: YES
+ */
+@property (nonatomic, assign) BOOL prewarmsOnReachabilityChange;
+
+/**
+ *  Security policy of pre-warm requests. Use the same policy of real calls (ex. pinned certificates), otherwise pre-warm of their hosts fails the TLS handshake.
+ *
+ *  Default: AFSecurityPolicy defaultPolicy
+ */
+@property (nonatomic, strong) AFSecurityPolicy* _Nonnull securityPolicy;
+
+/**
+ *  Block asked before each pre-warm. Return NO to skip it (ex. because real calls are already running to the host).
+ */
+@property (nonatomic, strong) SDConnectionPrewarmerShouldPrewarmBlock _Nullable shouldPrewarmBlock;
+
+/**
+ *  Duration (in seconds) of the last pre-warm request for each host. Key: host url as string.
+ *
+ *  @discussion it is the time paid for DNS, TCP and TLS setup plus one round trip and it's a good approximation of the latency saved on the first real call.
+ */
+@property (atomic, strong, readonly) NSDictionary<NSString*, NSNumber*>* _Nonnull lastPrewarmDurations;
+
+/**
+ *  Start pre-warming of all hosts respecting budget and minimum interval.
+ */
+- (void) prewarm;
+
+/**
+ *  Cancel all running pre-warm requests.
+ */
+- (void) cancelAllPrewarms;
+
+@end
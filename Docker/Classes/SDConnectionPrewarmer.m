@@ -0,0 +1,226 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDConnectionPrewarmer.h"
+#import "SDDockerLogger.h"
+
+#define DEFAULT_PREWARM_BUDGET                 2
+#define DEFAULT_PREWARM_TIMEOUT_INTERVAL       10
+#define DEFAULT_PREWARM_MINIMUM_INTERVAL       30
+
+@interface SDConnectionPrewarmer ()
+
+@property (nonatomic, strong) NSString* logModuleName;
+@property (nonatomic, strong) AFHTTPRequestOperationManager* prewarmOperationManager;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, NSDate*>* lastPrewarmDates;
+@property (atomic, strong, readwrite) NSDictionary<NSString*, NSNumber*>* lastPrewarmDurations;
+
+@end
+
+@implementation SDConnectionPrewarmer
+
+- (instancetype) initWithLogModuleName:(NSString*)logModuleName
+{
+    self = [super init];
+    if (self)
+    {
+        self.logModuleName = logModuleName;
+        
+        // pre-warm requests have their own queue, so the budget doesn't touch the queues of real calls
+        self.prewarmOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:nil];
+        self.prewarmOperationManager.responseSerializer = [AFHTTPResponseSerializer serializer];
+        // any answer from server means connection is open
+        self.prewarmOperationManager.responseSerializer.acceptableStatusCodes = nil;
+        self.prewarmOperationManager.responseSerializer.acceptableContentTypes = nil;
+        
+        self.lastPrewarmDates = [NSMutableDictionary new];
+        self.lastPrewarmDurations = [NSDictionary dictionary];
+        
+        self.budget = DEFAULT_PREWARM_BUDGET;
+        self.timeoutInterval = DEFAULT_PREWARM_TIMEOUT_INTERVAL;
+        self.minimumIntervalBetweenPrewarms = DEFAULT_PREWARM_MINIMUM_INTERVAL;
+        self.prewarmsOnReachabilityChange = YES;
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self cancelAllPrewarms];
+}
+
+- (void) setBudget:(NSUInteger)budget
+{
+    _budget = MAX(budget, 1);
+    self.prewarmOperationManager.operationQueue.maxConcurrentOperationCount = _budget;
+}
+
+- (AFSecurityPolicy*) securityPolicy
+{
+    return self.prewarmOperationManager.securityPolicy;
+}
+
+- (void) setSecurityPolicy:(AFSecurityPolicy*)securityPolicy
+{
+    self.prewarmOperationManager.securityPolicy = securityPolicy;
+}
+
+- (void) setPrewarmsOnReachabilityChange:(BOOL)prewarmsOnReachabilityChange
+{
+    _prewarmsOnReachabilityChange = prewarmsOnReachabilityChange;
+    [self updateReachabilityObserver];
+}
+
+- (void) setHosts:(NSArray<NSURL*>*)hosts
+{
+    _hosts = [hosts copy];
+    [self updateReachabilityObserver];
+}
+
+- (void) updateReachabilityObserver
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:AFNetworkingReachabilityDidChangeNotification object:nil];
+    
+    // reachability is monitored only if there is something to pre-warm
+    if (self.prewarmsOnReachabilityChange && self.hosts.count > 0)
+    {
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(reachabilityDidChange:) name:AFNetworkingReachabilityDidChangeNotification object:nil];
+        [[AFNetworkReachabilityManager sharedManager] startMonitoring];
+    }
+}
+
+#pragma mark - Reachability
+
+- (void) reachabilityDidChange:(NSNotification*)notification
+{
+    AFNetworkReachabilityStatus status = [notification.userInfo[AFNetworkingReachabilityNotificationStatusItem] integerValue];
+    if (status != AFNetworkReachabilityStatusReachableViaWWAN && status != AFNetworkReachabilityStatusReachableViaWiFi)
+    {
+        return;
+    }
+    
+    SDLogModuleVerbose(self.logModuleName, @"Network changed to %@: pre-warm connections", AFStringFromNetworkReachabilityStatus(status));
+    
+    // connections opened on the previous network are useless now
+    [self.lastPrewarmDates removeAllObjects];
+    [self prewarm];
+}
+
+#pragma mark - Prewarm
+
+- (void) prewarm
+{
+    if (!NSThread.isMainThread)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self prewarm];
+        });
+        return;
+    }
+    
+    for (NSURL* url in self.hosts)
+    {
+        NSURL* hostURL = [self hostURLFromURL:url];
+        if (!hostURL)
+        {
+            SDLogModuleWarning(self.logModuleName, @"Can't pre-warm invalid host url %@", url);
+            continue;
+        }
+        [self prewarmHostURL:hostURL];
+    }
+}
+
+- (void) prewarmHostURL:(NSURL*)hostURL
+{
+    NSString* hostKey = hostURL.absoluteString;
+    
+    NSDate* lastPrewarmDate = self.lastPrewarmDates[hostKey];
+    if (lastPrewarmDate && -[lastPrewarmDate timeIntervalSinceNow] < self.minimumIntervalBetweenPrewarms)
+    {
+        return;
+    }
+    
+    if (self.shouldPrewarmBlock && !self.shouldPrewarmBlock())
+    {
+        SDLogModuleVerbose(self.logModuleName, @"Pre-warm of %@ skipped", hostKey);
+        return;
+    }
+    
+    self.lastPrewarmDates[hostKey] = [NSDate date];
+    
+    // HEAD request to the host root: the smallest request that forces DNS, TCP and TLS setup
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:hostURL];
+    request.HTTPMethod = @"HEAD";
+    request.timeoutInterval = self.timeoutInterval;
+    request.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+    request.HTTPShouldHandleCookies = NO;
+    
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    __weak typeof (self) weakSelf = self;
+    void (^ completion)(AFHTTPRequestOperation*) = ^(AFHTTPRequestOperation* operation) {
+        NSTimeInterval duration = CFAbsoluteTimeGetCurrent() - startTime;
+        if (operation.response)
+        {
+            NSMutableDictionary* durations = [weakSelf.lastPrewarmDurations mutableCopy];
+            durations[hostKey] = @(duration);
+            weakSelf.lastPrewarmDurations = durations;
+            SDLogModuleVerbose(weakSelf.logModuleName, @"Pre-warmed connection to %@ in %.0f ms", hostKey, duration * 1000.);
+        }
+        else
+        {
+            // allow a new attempt on next trigger
+            [weakSelf.lastPrewarmDates removeObjectForKey:hostKey];
+            SDLogModuleVerbose(weakSelf.logModuleName, @"Pre-warm of %@ failed: %@", hostKey, operation.error.localizedDescription);
+        }
+    };
+    
+    AFHTTPRequestOperation* operation = [self.prewarmOperationManager HTTPRequestOperationWithRequest:request success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
+        completion(operation);
+    } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
+        completion(operation);
+    }];
+    
+    operation.queuePriority = NSOperationQueuePriorityVeryLow;
+    if ([operation respondsToSelector:@selector(setQualityOfService:)])
+    {
+        operation.qualityOfService = NSQualityOfServiceUtility;
+    }
+    
+    [self.prewarmOperationManager.operationQueue addOperation:operation];
+}
+
+- (void) cancelAllPrewarms
+{
+    [self.prewarmOperationManager.operationQueue cancelAllOperations];
+}
+
+#pragma mark - Utils
+
+- (NSURL*) hostURLFromURL:(NSURL*)url
+{
+    if (url.scheme.length == 0 || url.host.length == 0)
+    {
+        return nil;
+    }
+    
+    NSURLComponents* components = [NSURLComponents new];
+    components.scheme = url.scheme;
+    components.host = url.host;
+    components.port = url.port;
+    components.path = @"/";
+    return components.URL;
+}
+
+@end
@@ -0,0 +1,154 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+@import AFNetworking;
+
+typedef NS_ENUM (NSInteger, SDDeferredRequestFlushReason)
+{
+    SDDeferredRequestFlushReasonManual = 0,
+    SDDeferredRequestFlushReasonUrgentTraffic,      // another request started: radio is already awake
+    SDDeferredRequestFlushReasonMaximumDelay,       // oldest request waited maximumDelay
+    SDDeferredRequestFlushReasonBatchSize           // maximumBatchSize requests are waiting
+};
+
+/**
+ *  Request held by SDDeferredRequestQueue until the next flush.
+ */
+@interface SDDeferredRequest : NSObject
+
+@property (nonatomic, strong, readonly) NSString* _Nonnull identifier;
+
+/**
+ *  Name of the object that sends the request when flushed (ex. class name of the manager). See setSendBlock:forOwnerName: of SDDeferredRequestQueue.
+ */
+@property (nonatomic, strong, readonly) NSString* _Nonnull ownerName;
+
+/**
+ *  Human readable description (ex. service class or url), for inspection and logs.
+ */
+@property (nonatomic, strong, readonly) NSString* _Nonnull requestDescription;
+
+@property (nonatomic, strong, readonly) NSDate* _Nonnull enqueueDate;
+
+/**
+ *  Property list that describes the request, saved across launches. Requests without payload are not saved.
+ */
+@property (nonatomic, strong, readonly) NSDictionary* _Nullable payload;
+
+/**
+ *  Object of the owner kept only in memory (ex. the call with its completion blocks). nil for requests restored at launch.
+ */
+@property (nonatomic, strong, readonly) id _Nullable context;
+
+/**
+ *  YES if the request was saved by a previous launch.
+ */
+@property (nonatomic, readonly) BOOL isRestored;
+
+@end
+
+/**
+ *  Block that sends a deferred request. Called on main thread. Return NO if the request can't be sent now: it stays in the queue until next flush.
+ */
+typedef BOOL (^ SDDeferredRequestSendBlock)(SDDeferredRequest* _Nonnull request);
+
+/**
+ *  Holds non urgent requests (ex. analytics, background refresh) and sends them together, so the cellular radio wakes up once for a batch instead of once for every request.
+ *  Requests are flushed when any other AFNetworking operation starts (the radio is already awake), when the oldest one waited maximumDelay, or when maximumBatchSize requests are waiting.
+ *
+ *  Requests with a payload are saved and restored at next launch, and are sent by the send block of their owner.
+ *  Used by SDServiceManager and SDDownloadManager for calls and downloads marked as deferrable.
+ */
+@interface SDDeferredRequestQueue : NSObject
+
+/**
+ *  Queue used by default by SDServiceManager and SDDownloadManager, saved in Application Support.
+ */
++ (instancetype _Nonnull) sharedQueue;
+
+/**
+ *  Queue saved at path (nil to keep requests only in memory). Requests saved at path are restored immediately.
+ */
+- (instancetype _Nonnull) initWithPersistencePath:(NSString* _Nullable)persistencePath;
+
+@property (nonatomic, strong, readonly) NSString* _Nullable persistencePath;
+
+/**
+ *  Maximum time a request waits for a batch.
+ *
+ *  Default: 300 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval maximumDelay;
+
+/**
+ *  Number of waiting requests that flushes the queue.
+ *
+ *  Default: 10
+ */
+@property (nonatomic, assign) NSUInteger maximumBatchSize;
+
+/**
+ *  Maximum number of requests in the queue (restored ones included): when it is full the oldest request is discarded.
+ *
+ *  Default: 100
+ */
+@property (nonatomic, assign) NSUInteger maximumNumberOfRequests;
+
+/**
+ *  Flush when another AFNetworking operation starts.
+ *
+ *  Default: YES
+ */
+@property (nonatomic, assign) BOOL flushesOnUrgentTraffic;
+
+/**
+ *  Requests waiting, oldest first.
+ */
+@property (nonatomic, readonly) NSArray<SDDeferredRequest*>* _Nonnull pendingRequests;
+
+/**
+ *  Metrics: number of flushes that sent at least one request, requests sent and requests discarded because the queue was full.
+ */
+@property (atomic, readonly) NSUInteger numberOfFlushes;
+@property (atomic, readonly) NSUInteger numberOfSentRequests;
+@property (atomic, readonly) NSUInteger numberOfDiscardedRequests;
+@property (atomic, readonly) SDDeferredRequestFlushReason lastFlushReason;
+
+/**
+ *  Register the block that sends requests of an owner. Requests of owners without send block wait in the queue (ex. restored requests before their manager is created).
+ */
+- (void) setSendBlock:(SDDeferredRequestSendBlock _Nullable)sendBlock forOwnerName:(NSString* _Nonnull)ownerName;
+
+/**
+ *  Add a request to the queue. It may flush the queue immediately if maximumBatchSize is reached.
+ *
+ *  @param ownerName          name used to find the send block.
+ *  @param requestDescription description for inspection and logs.
+ *  @param payload            property list saved across launches (nil to keep the request only in memory).
+ *  @param context            object kept in memory for the send block.
+ */
+- (SDDeferredRequest* _Nonnull) enqueueRequestWithOwnerName:(NSString* _Nonnull)ownerName requestDescription:(NSString* _Nonnull)requestDescription payload:(NSDictionary* _Nullable)payload context:(id _Nullable)context;
+
+/**
+ *  Remove a request without sending it. Returns NO if it was already sent or discarded.
+ */
+- (BOOL) removeRequest:(SDDeferredRequest* _Nonnull)request;
+
+/**
+ *  Send all waiting requests now (ex. when the app goes to background).
+ */
+- (void) flush;
+
+@end
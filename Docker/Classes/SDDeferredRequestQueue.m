@@ -0,0 +1,384 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDDeferredRequestQueue.h"
+#import "SDDockerLogger.h"
+
+#define DEFAULT_MAXIMUM_DELAY                   300.
+#define DEFAULT_MAXIMUM_BATCH_SIZE              10
+#define DEFAULT_MAXIMUM_NUMBER_OF_REQUESTS      100
+
+#define DEFERRED_REQUESTS_FOLDER                @"Docker"
+#define DEFERRED_REQUESTS_FILE_NAME             @"DeferredRequests.plist"
+
+#define DEFERRED_REQUEST_IDENTIFIER             @"identifier"
+#define DEFERRED_REQUEST_OWNER_NAME             @"ownerName"
+#define DEFERRED_REQUEST_DESCRIPTION            @"description"
+#define DEFERRED_REQUEST_ENQUEUE_DATE           @"enqueueDate"
+#define DEFERRED_REQUEST_PAYLOAD                @"payload"
+
+@interface SDDeferredRequest ()
+
+@property (nonatomic, strong, readwrite) NSString* identifier;
+@property (nonatomic, strong, readwrite) NSString* ownerName;
+@property (nonatomic, strong, readwrite) NSString* requestDescription;
+@property (nonatomic, strong, readwrite) NSDate* enqueueDate;
+@property (nonatomic, strong, readwrite) NSDictionary* payload;
+@property (nonatomic, strong, readwrite) id context;
+@property (nonatomic, readwrite) BOOL isRestored;
+
+@end
+
+@implementation SDDeferredRequest
+
+- (NSDictionary*) propertyListRepresentation
+{
+    return @{ DEFERRED_REQUEST_IDENTIFIER : self.identifier,
+              DEFERRED_REQUEST_OWNER_NAME : self.ownerName,
+              DEFERRED_REQUEST_DESCRIPTION : self.requestDescription,
+              DEFERRED_REQUEST_ENQUEUE_DATE : self.enqueueDate,
+              DEFERRED_REQUEST_PAYLOAD : self.payload };
+}
+
++ (instancetype) requestWithPropertyListRepresentation:(NSDictionary*)dictionary
+{
+    if (![dictionary isKindOfClass:[NSDictionary class]] || ![dictionary[DEFERRED_REQUEST_OWNER_NAME] isKindOfClass:[NSString class]] || ![dictionary[DEFERRED_REQUEST_PAYLOAD] isKindOfClass:[NSDictionary class]])
+    {
+        return nil;
+    }
+    SDDeferredRequest* request = [SDDeferredRequest new];
+    request.identifier = dictionary[DEFERRED_REQUEST_IDENTIFIER] ?: [NSUUID UUID].UUIDString;
+    request.ownerName = dictionary[DEFERRED_REQUEST_OWNER_NAME];
+    request.requestDescription = dictionary[DEFERRED_REQUEST_DESCRIPTION] ?: request.ownerName;
+    request.enqueueDate = dictionary[DEFERRED_REQUEST_ENQUEUE_DATE] ?: [NSDate date];
+    request.payload = dictionary[DEFERRED_REQUEST_PAYLOAD];
+    request.isRestored = YES;
+    return request;
+}
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: %@ (%@), waiting %.1f seconds%@>", NSStringFromClass([self class]), self.requestDescription, self.ownerName, -[self.enqueueDate timeIntervalSinceNow], self.isRestored ? @", restored" : @""];
+}
+
+@end
+
+
+@interface SDDeferredRequestQueue ()
+{
+    dispatch_queue_t persistenceQueue;
+}
+
+@property (nonatomic, strong, readwrite) NSString* persistencePath;
+@property (nonatomic, strong) NSMutableArray<SDDeferredRequest*>* requests;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDDeferredRequestSendBlock>* sendBlocks;
+
+@property (atomic, readwrite) NSUInteger numberOfFlushes;
+@property (atomic, readwrite) NSUInteger numberOfSentRequests;
+@property (atomic, readwrite) NSUInteger numberOfDiscardedRequests;
+@property (atomic, readwrite) SDDeferredRequestFlushReason lastFlushReason;
+
+/**
+ *  Incremented at every reschedule, to ignore timers scheduled before.
+ */
+@property (nonatomic, assign) NSUInteger timerGeneration;
+@property (nonatomic, assign) BOOL flushing;
+
+@end
+
+@implementation SDDeferredRequestQueue
+
++ (instancetype) sharedQueue
+{
+    static dispatch_once_t pred;
+    static id sharedQueueInstance = nil;
+    
+    dispatch_once(&pred, ^{
+        NSString* directoryPath = [[NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject] stringByAppendingPathComponent:DEFERRED_REQUESTS_FOLDER];
+        [[NSFileManager defaultManager] createDirectoryAtPath:directoryPath withIntermediateDirectories:YES attributes:nil error:NULL];
+        sharedQueueInstance = [[self alloc] initWithPersistencePath:[directoryPath stringByAppendingPathComponent:DEFERRED_REQUESTS_FILE_NAME]];
+    });
+    
+    return sharedQueueInstance;
+}
+
+- (instancetype) init
+{
+    return [self initWithPersistencePath:nil];
+}
+
+- (instancetype) initWithPersistencePath:(NSString*)persistencePath
+{
+    self = [super init];
+    if (self)
+    {
+        _persistencePath = persistencePath;
+        _maximumDelay = DEFAULT_MAXIMUM_DELAY;
+        _maximumBatchSize = DEFAULT_MAXIMUM_BATCH_SIZE;
+        _maximumNumberOfRequests = DEFAULT_MAXIMUM_NUMBER_OF_REQUESTS;
+        _flushesOnUrgentTraffic = YES;
+        _requests = [NSMutableArray array];
+        _sendBlocks = [NSMutableDictionary dictionary];
+        persistenceQueue = dispatch_queue_create("it.sysdata.docker.deferredrequests", DISPATCH_QUEUE_SERIAL);
+        
+        [self restoreRequests];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(operationDidStart:) name:AFNetworkingOperationDidStartNotification object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - Requests
+
+- (NSArray<SDDeferredRequest*>*) pendingRequests
+{
+    @synchronized (self)
+    {
+        return [self.requests copy];
+    }
+}
+
+- (void) setSendBlock:(SDDeferredRequestSendBlock)sendBlock forOwnerName:(NSString*)ownerName
+{
+    @synchronized (self)
+    {
+        self.sendBlocks[ownerName] = sendBlock;
+    }
+    [self scheduleTimer];
+}
+
+- (SDDeferredRequest*) enqueueRequestWithOwnerName:(NSString*)ownerName requestDescription:(NSString*)requestDescription payload:(NSDictionary*)payload context:(id)context
+{
+    SDDeferredRequest* request = [SDDeferredRequest new];
+    request.identifier = [NSUUID UUID].UUIDString;
+    request.ownerName = ownerName;
+    request.requestDescription = requestDescription;
+    request.enqueueDate = [NSDate date];
+    request.payload = payload;
+    request.context = context;
+    
+    if (payload && ![NSPropertyListSerialization propertyList:payload isValidForFormat:NSPropertyListBinaryFormat_v1_0])
+    {
+        SDLogWarning(@"Deferred request %@: payload is not a property list, it will not be saved", requestDescription);
+        request.payload = nil;
+    }
+    
+    NSUInteger count = 0;
+    @synchronized (self)
+    {
+        [self.requests addObject:request];
+        while (self.requests.count > MAX(self.maximumNumberOfRequests, 1))
+        {
+            SDLogWarning(@"Deferred requests queue is full: %@ discarded", self.requests.firstObject.requestDescription);
+            [self.requests removeObjectAtIndex:0];
+            self.numberOfDiscardedRequests++;
+        }
+        count = self.requests.count;
+    }
+    SDLogVerbose(@"Deferred request %@ (%lu waiting)", requestDescription, (unsigned long)count);
+    [self saveRequests];
+    
+    if (count >= self.maximumBatchSize)
+    {
+        [self flushWithReason:SDDeferredRequestFlushReasonBatchSize];
+    }
+    else
+    {
+        [self scheduleTimer];
+    }
+    return request;
+}
+
+- (BOOL) removeRequest:(SDDeferredRequest*)request
+{
+    BOOL removed = NO;
+    @synchronized (self)
+    {
+        removed = [self.requests containsObject:request];
+        [self.requests removeObject:request];
+    }
+    if (removed)
+    {
+        [self saveRequests];
+        [self scheduleTimer];
+    }
+    return removed;
+}
+
+#pragma mark - Flush
+
+- (void) flush
+{
+    [self flushWithReason:SDDeferredRequestFlushReasonManual];
+}
+
+- (void) operationDidStart:(NSNotification*)notification
+{
+    if (self.flushesOnUrgentTraffic && !self.flushing && self.pendingRequests.count > 0)
+    {
+        [self flushWithReason:SDDeferredRequestFlushReasonUrgentTraffic];
+    }
+}
+
+- (void) flushWithReason:(SDDeferredRequestFlushReason)reason
+{
+    if (!NSThread.isMainThread)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self flushWithReason:reason];
+        });
+        return;
+    }
+    if (self.flushing)
+    {
+        return;
+    }
+    
+    NSArray<SDDeferredRequest*>* requests = nil;
+    NSDictionary<NSString*, SDDeferredRequestSendBlock>* sendBlocks = nil;
+    @synchronized (self)
+    {
+        requests = [self.requests copy];
+        sendBlocks = [self.sendBlocks copy];
+    }
+    
+    // send blocks start operations: they must not flush again
+    self.flushing = YES;
+    NSMutableArray<SDDeferredRequest*>* sentRequests = [NSMutableArray arrayWithCapacity:requests.count];
+    for (SDDeferredRequest* request in requests)
+    {
+        SDDeferredRequestSendBlock sendBlock = sendBlocks[request.ownerName];
+        if (sendBlock && sendBlock(request))
+        {
+            [sentRequests addObject:request];
+        }
+    }
+    self.flushing = NO;
+    
+    if (sentRequests.count > 0)
+    {
+        @synchronized (self)
+        {
+            [self.requests removeObjectsInArray:sentRequests];
+        }
+        self.numberOfFlushes++;
+        self.numberOfSentRequests += sentRequests.count;
+        self.lastFlushReason = reason;
+        SDLogVerbose(@"Deferred requests flushed (reason %ld): %lu sent, %lu waiting", (long)reason, (unsigned long)sentRequests.count, (unsigned long)(requests.count - sentRequests.count));
+        [self saveRequests];
+    }
+    [self scheduleTimer];
+}
+
+/**
+ *  Timer of maximum delay of the oldest request that can be sent.
+ */
+- (void) scheduleTimer
+{
+    if (!NSThread.isMainThread)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self scheduleTimer];
+        });
+        return;
+    }
+    
+    self.timerGeneration++;
+    NSDate* oldestDate = nil;
+    @synchronized (self)
+    {
+        for (SDDeferredRequest* request in self.requests)
+        {
+            if (self.sendBlocks[request.ownerName])
+            {
+                oldestDate = request.enqueueDate;
+                break;
+            }
+        }
+    }
+    if (!oldestDate)
+    {
+        return;
+    }
+    
+    NSTimeInterval delay = MAX(self.maximumDelay + [oldestDate timeIntervalSinceNow], 0);
+    NSUInteger generation = self.timerGeneration;
+    __weak typeof (self) weakself = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        if (weakself.timerGeneration == generation)
+        {
+            [weakself flushWithReason:SDDeferredRequestFlushReasonMaximumDelay];
+        }
+    });
+}
+
+#pragma mark - Persistence
+
+- (void) restoreRequests
+{
+    if (!self.persistencePath)
+    {
+        return;
+    }
+    NSArray* list = [NSArray arrayWithContentsOfFile:self.persistencePath];
+    for (NSDictionary* dictionary in list)
+    {
+        SDDeferredRequest* request = [SDDeferredRequest requestWithPropertyListRepresentation:dictionary];
+        if (request)
+        {
+            [self.requests addObject:request];
+        }
+    }
+    while (self.requests.count > MAX(self.maximumNumberOfRequests, 1))
+    {
+        [self.requests removeObjectAtIndex:0];
+    }
+    if (self.requests.count > 0)
+    {
+        SDLogInfo(@"Restored %lu deferred requests", (unsigned long)self.requests.count);
+    }
+}
+
+- (void) saveRequests
+{
+    if (!self.persistencePath)
+    {
+        return;
+    }
+    NSMutableArray* list = [NSMutableArray array];
+    @synchronized (self)
+    {
+        for (SDDeferredRequest* request in self.requests)
+        {
+            if (request.payload)
+            {
+                [list addObject:[request propertyListRepresentation]];
+            }
+        }
+    }
+    NSString* persistencePath = self.persistencePath;
+    dispatch_async(persistenceQueue, ^{
+        if (![list writeToFile:persistencePath atomically:YES])
+        {
+            SDLogError(@"Can't save deferred requests at %@", persistencePath);
+        }
+    });
+}
+
+@end
@@ -7,4 +7,26 @@
 #import "SDServiceManager.h"
 #import "SDServiceGeneric.h"
 #import "SDServiceMantle.h"
+#import "SDServiceJSONEncoder.h"
+#import "SDServiceJSONDecoder.h"
+#import "SDServiceTrafficArchive.h"
+#import "SDServiceFaultInjector.h"
+#import "SDServiceLatencyTracker.h"
+#import "SDServiceHedgingPolicy.h"
+#import "SDServiceRateLimiter.h"
+#import "SDServicePaginationController.h"
+#import "SDServiceRouter.h"
+#import "SDServicePartialResultsCollector.h"
+#import "SDServiceParallelMapper.h"
+#import "SDServiceMappingExecutor.h"
+#import "SDServiceFuture.h"
+#import "SDServiceEventStream.h"
+#import "SDServicePollingScheduler.h"
+#import "SDNetworkQualityEstimator.h"
+#import "SDDeferredRequestQueue.h"
+#import "SDServiceBodyCodec.h"
+#import "SDServiceMessagePackCodec.h"
+#import "SDServiceJSONPatch.h"
+#import "SDServiceContentDecoder.h"
+#import "SDConnectionPrewarmer.h"
 
@@ -0,0 +1,143 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+@import AFNetworking;
+
+/**
+ *  Class of network quality, from round trip time and throughput (same thresholds of effective connection types of browsers).
+ */
+typedef NS_ENUM (NSInteger, SDNetworkQuality)
+{
+    SDNetworkQualityUnknown = 0,
+    SDNetworkQualityOffline,
+    SDNetworkQualitySlow2G,         // round trip time over 2 seconds or throughput up to 40 kbps
+    SDNetworkQuality2G,             // round trip time over 1.4 seconds or throughput up to 75 kbps
+    SDNetworkQuality3G,             // round trip time over 270 milliseconds or throughput up to 400 kbps
+    SDNetworkQuality4G
+};
+
+FOUNDATION_EXPORT NSString* _Nonnull NSStringFromSDNetworkQuality(SDNetworkQuality quality);
+
+/**
+ *  Posted on main thread by SDNetworkQualityEstimator when quality of the current network or network type change. Object is the estimator, userInfo contains the new estimate for SDNetworkQualityEstimateKey.
+ */
+FOUNDATION_EXPORT NSString* const _Nonnull SDNetworkQualityDidChangeNotification;
+FOUNDATION_EXPORT NSString* const _Nonnull SDNetworkQualityEstimateKey;
+
+/**
+ *  Estimate of a network type at a given time.
+ */
+@interface SDNetworkQualityEstimate : NSObject <NSCopying>
+
+/**
+ *  Network type: "wifi", "cellular" followed by the radio access technology (ex. "cellular/CTRadioAccessTechnologyLTE"), "offline" or "unknown".
+ */
+@property (nonatomic, strong, readonly) NSString* _Nonnull networkType;
+
+/**
+ *  Time between start and end of calls with small responses: network round trip plus server time. 0 if unknown.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval roundTripTime;
+
+/**
+ *  Download throughput of calls with large responses, in kilobits per second. 0 if unknown.
+ */
+@property (nonatomic, assign, readonly) double throughput;
+
+@property (nonatomic, assign, readonly) NSUInteger numberOfRoundTripTimeObservations;
+@property (nonatomic, assign, readonly) NSUInteger numberOfThroughputObservations;
+
+@property (nonatomic, assign, readonly) SDNetworkQuality quality;
+
+@end
+
+/**
+ *  Estimates round trip time and throughput of the network passively, from calls completed by SDServiceManager and SDDownloadManager (or reported with addObservationWithOperation:).
+ *  Estimates are kept for every network type and decay over time: every observation weighs half after halfLife seconds, so recent calls count more.
+ *
+ *  Use the estimate to adapt policies (ex. concurrency, timeouts, prefetch distance, image quality), and SDNetworkQualityDidChangeNotification to know when it changes.
+ *  Start time of operations is recorded from AFNetworkingOperationDidStartNotification, so durations include the time main thread takes to deliver AFNetworking notifications.
+ */
+@interface SDNetworkQualityEstimator : NSObject
+
+/**
+ *  Estimator used by default by SDServiceManager and SDDownloadManager.
+ */
++ (instancetype _Nonnull) sharedEstimator;
+
+/**
+ *  Time after which an observation weighs half.
+ *
+ *  Default: 60 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval halfLife;
+
+/**
+ *  Responses up to this size (bytes) are round trip time observations.
+ *
+ *  Default: 4096
+ */
+@property (nonatomic, assign) long long maximumRoundTripTimeResponseSize;
+
+/**
+ *  Responses of at least this size (bytes) are throughput observations.
+ *
+ *  Default: 32768
+ */
+@property (nonatomic, assign) long long minimumThroughputResponseSize;
+
+/**
+ *  Shorter calls are ignored, because they are probably served by NSURLCache.
+ *
+ *  Default: 0.005 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval minimumObservationDuration;
+
+/**
+ *  Current network type (see networkType of SDNetworkQualityEstimate).
+ */
+@property (atomic, strong, readonly) NSString* _Nonnull currentNetworkType;
+
+/**
+ *  Estimate of the current network type.
+ */
+- (SDNetworkQualityEstimate* _Nonnull) currentEstimate;
+
+- (SDNetworkQualityEstimate* _Nonnull) estimateForNetworkType:(NSString* _Nonnull)networkType;
+
+/**
+ *  Quality of the current estimate.
+ */
+@property (nonatomic, readonly) SDNetworkQuality quality;
+
+/**
+ *  Add the duration and size of the response of a completed operation to the estimate of the current network. Operations without response are ignored.
+ */
+- (void) addObservationWithOperation:(AFHTTPRequestOperation* _Nonnull)operation;
+
+/**
+ *  Add a call measured elsewhere (ex. with NSURLSession) to the estimate of the current network.
+ *
+ *  @param duration      time from start of the request to end of the response.
+ *  @param receivedBytes size of the response body.
+ */
+- (void) addObservationWithDuration:(NSTimeInterval)duration receivedBytes:(long long)receivedBytes;
+
+/**
+ *  Remove all estimates.
+ */
+- (void) reset;
+
+@end
@@ -0,0 +1,362 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDNetworkQualityEstimator.h"
+@import CoreTelephony;
+
+#define DEFAULT_HALF_LIFE                           60.
+#define DEFAULT_MAXIMUM_ROUND_TRIP_TIME_SIZE        4096
+#define DEFAULT_MINIMUM_THROUGHPUT_SIZE             32768
+#define DEFAULT_MINIMUM_OBSERVATION_DURATION        0.005
+
+// thresholds of effective connection types
+#define SLOW_2G_ROUND_TRIP_TIME                     2.010
+#define SLOW_2G_THROUGHPUT                          40.
+#define QUALITY_2G_ROUND_TRIP_TIME                  1.420
+#define QUALITY_2G_THROUGHPUT                       75.
+#define QUALITY_3G_ROUND_TRIP_TIME                  0.272
+#define QUALITY_3G_THROUGHPUT                       400.
+
+NSString* const SDNetworkQualityDidChangeNotification = @"SDNetworkQualityDidChangeNotification";
+NSString* const SDNetworkQualityEstimateKey = @"SDNetworkQualityEstimateKey";
+
+NSString* NSStringFromSDNetworkQuality(SDNetworkQuality quality)
+{
+    switch (quality)
+    {
+        case SDNetworkQualityOffline:
+            return @"offline";
+        case SDNetworkQualitySlow2G:
+            return @"slow-2g";
+        case SDNetworkQuality2G:
+            return @"2g";
+        case SDNetworkQuality3G:
+            return @"3g";
+        case SDNetworkQuality4G:
+            return @"4g";
+        default:
+            return @"unknown";
+    }
+}
+
+@interface SDNetworkQualityEstimate ()
+
+@property (nonatomic, strong, readwrite) NSString* networkType;
+@property (nonatomic, assign, readwrite) NSTimeInterval roundTripTime;
+@property (nonatomic, assign, readwrite) double throughput;
+@property (nonatomic, assign, readwrite) NSUInteger numberOfRoundTripTimeObservations;
+@property (nonatomic, assign, readwrite) NSUInteger numberOfThroughputObservations;
+
+/**
+ *  Decayed weight of the observations in the estimates, at the time of the last observation.
+ */
+@property (nonatomic, assign) double roundTripTimeWeight;
+@property (nonatomic, assign) CFAbsoluteTime roundTripTimeUpdateTime;
+@property (nonatomic, assign) double throughputWeight;
+@property (nonatomic, assign) CFAbsoluteTime throughputUpdateTime;
+
+@end
+
+@implementation SDNetworkQualityEstimate
+
+- (SDNetworkQuality) quality
+{
+    if ([self.networkType isEqualToString:@"offline"])
+    {
+        return SDNetworkQualityOffline;
+    }
+    if (self.roundTripTime <= 0 && self.throughput <= 0)
+    {
+        return SDNetworkQualityUnknown;
+    }
+    
+    BOOL hasRoundTripTime = self.roundTripTime > 0;
+    BOOL hasThroughput = self.throughput > 0;
+    if ((hasRoundTripTime && self.roundTripTime >= SLOW_2G_ROUND_TRIP_TIME) || (hasThroughput && self.throughput <= SLOW_2G_THROUGHPUT))
+    {
+        return SDNetworkQualitySlow2G;
+    }
+    if ((hasRoundTripTime && self.roundTripTime >= QUALITY_2G_ROUND_TRIP_TIME) || (hasThroughput && self.throughput <= QUALITY_2G_THROUGHPUT))
+    {
+        return SDNetworkQuality2G;
+    }
+    if ((hasRoundTripTime && self.roundTripTime >= QUALITY_3G_ROUND_TRIP_TIME) || (hasThroughput && self.throughput <= QUALITY_3G_THROUGHPUT))
+    {
+        return SDNetworkQuality3G;
+    }
+    return SDNetworkQuality4G;
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    SDNetworkQualityEstimate* estimate = [[[self class] allocWithZone:zone] init];
+    estimate.networkType = self.networkType;
+    estimate.roundTripTime = self.roundTripTime;
+    estimate.throughput = self.throughput;
+    estimate.numberOfRoundTripTimeObservations = self.numberOfRoundTripTimeObservations;
+    estimate.numberOfThroughputObservations = self.numberOfThroughputObservations;
+    estimate.roundTripTimeWeight = self.roundTripTimeWeight;
+    estimate.roundTripTimeUpdateTime = self.roundTripTimeUpdateTime;
+    estimate.throughputWeight = self.throughputWeight;
+    estimate.throughputUpdateTime = self.throughputUpdateTime;
+    return estimate;
+}
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: %@, %@, round trip time %.0f ms (%lu), throughput %.0f kbps (%lu)>", NSStringFromClass([self class]), self.networkType, NSStringFromSDNetworkQuality(self.quality), self.roundTripTime * 1000., (unsigned long)self.numberOfRoundTripTimeObservations, self.throughput, (unsigned long)self.numberOfThroughputObservations];
+}
+
+@end
+
+
+@interface SDNetworkQualityEstimator ()
+
+@property (atomic, strong, readwrite) NSString* currentNetworkType;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDNetworkQualityEstimate*>* estimates;
+
+/**
+ *  Start time of running operations. Key: operation (weak).
+ */
+@property (nonatomic, strong) NSMapTable<AFHTTPRequestOperation*, NSNumber*>* operationStartTimes;
+
+@property (nonatomic, strong) CTTelephonyNetworkInfo* telephonyNetworkInfo;
+
+/**
+ *  Last quality and network type notified.
+ */
+@property (nonatomic, assign) SDNetworkQuality notifiedQuality;
+@property (nonatomic, strong) NSString* notifiedNetworkType;
+
+@end
+
+@implementation SDNetworkQualityEstimator
+
++ (instancetype) sharedEstimator
+{
+    static dispatch_once_t pred;
+    static id sharedEstimatorInstance = nil;
+    
+    dispatch_once(&pred, ^{
+        sharedEstimatorInstance = [[self alloc] init];
+    });
+    
+    return sharedEstimatorInstance;
+}
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        _halfLife = DEFAULT_HALF_LIFE;
+        _maximumRoundTripTimeResponseSize = DEFAULT_MAXIMUM_ROUND_TRIP_TIME_SIZE;
+        _minimumThroughputResponseSize = DEFAULT_MINIMUM_THROUGHPUT_SIZE;
+        _minimumObservationDuration = DEFAULT_MINIMUM_OBSERVATION_DURATION;
+        _estimates = [NSMutableDictionary dictionary];
+        _operationStartTimes = [NSMapTable weakToStrongObjectsMapTable];
+        _telephonyNetworkInfo = [CTTelephonyNetworkInfo new];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(operationDidStart:) name:AFNetworkingOperationDidStartNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(networkTypeDidChange) name:AFNetworkingReachabilityDidChangeNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(networkTypeDidChange) name:CTRadioAccessTechnologyDidChangeNotification object:nil];
+        [[AFNetworkReachabilityManager sharedManager] startMonitoring];
+        [self updateCurrentNetworkType];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - Network type
+
+- (void) networkTypeDidChange
+{
+    [self updateCurrentNetworkType];
+    [self notifyChangeIfNeeded];
+}
+
+- (void) updateCurrentNetworkType
+{
+    switch ([AFNetworkReachabilityManager sharedManager].networkReachabilityStatus)
+    {
+        case AFNetworkReachabilityStatusReachableViaWiFi:
+            self.currentNetworkType = @"wifi";
+            break;
+        case AFNetworkReachabilityStatusReachableViaWWAN: {
+            NSString* radioAccessTechnology = self.telephonyNetworkInfo.currentRadioAccessTechnology;
+            self.currentNetworkType = radioAccessTechnology ? [@"cellular/" stringByAppendingString:radioAccessTechnology] : @"cellular";
+            break;
+        }
+        case AFNetworkReachabilityStatusNotReachable:
+            self.currentNetworkType = @"offline";
+            break;
+        default:
+            self.currentNetworkType = @"unknown";
+            break;
+    }
+}
+
+#pragma mark - Estimates
+
+- (SDNetworkQualityEstimate*) currentEstimate
+{
+    return [self estimateForNetworkType:self.currentNetworkType];
+}
+
+- (SDNetworkQualityEstimate*) estimateForNetworkType:(NSString*)networkType
+{
+    @synchronized (self)
+    {
+        SDNetworkQualityEstimate* estimate = [self.estimates[networkType] copy];
+        if (!estimate)
+        {
+            estimate = [SDNetworkQualityEstimate new];
+            estimate.networkType = networkType;
+        }
+        return estimate;
+    }
+}
+
+- (SDNetworkQuality) quality
+{
+    return [self currentEstimate].quality;
+}
+
+- (void) reset
+{
+    @synchronized (self)
+    {
+        [self.estimates removeAllObjects];
+    }
+    [self notifyChangeIfNeeded];
+}
+
+#pragma mark - Observations
+
+- (void) operationDidStart:(NSNotification*)notification
+{
+    if (![notification.object isKindOfClass:[AFHTTPRequestOperation class]])
+    {
+        return;
+    }
+    @synchronized (self.operationStartTimes)
+    {
+        [self.operationStartTimes setObject:@(CFAbsoluteTimeGetCurrent()) forKey:notification.object];
+    }
+}
+
+- (void) addObservationWithOperation:(AFHTTPRequestOperation*)operation
+{
+    NSNumber* startTime = nil;
+    @synchronized (self.operationStartTimes)
+    {
+        startTime = [self.operationStartTimes objectForKey:operation];
+        [self.operationStartTimes removeObjectForKey:operation];
+    }
+    if (!startTime || !operation.response)
+    {
+        return;
+    }
+    
+    // bytes on the wire when known, responses written to a stream have no data. Responses to HEAD have no body, whatever their Content-Length
+    long long receivedBytes = 0;
+    if (![operation.request.HTTPMethod isEqualToString:@"HEAD"])
+    {
+        receivedBytes = operation.response.expectedContentLength;
+        if (receivedBytes <= 0)
+        {
+            receivedBytes = operation.responseData.length;
+        }
+    }
+    [self addObservationWithDuration:CFAbsoluteTimeGetCurrent() - startTime.doubleValue receivedBytes:receivedBytes];
+}
+
+- (void) addObservationWithDuration:(NSTimeInterval)duration receivedBytes:(long long)receivedBytes
+{
+    if (duration < self.minimumObservationDuration || duration <= 0)
+    {
+        return;
+    }
+    
+    NSString* networkType = self.currentNetworkType;
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    @synchronized (self)
+    {
+        SDNetworkQualityEstimate* estimate = self.estimates[networkType];
+        if (!estimate)
+        {
+            estimate = [SDNetworkQualityEstimate new];
+            estimate.networkType = networkType;
+            self.estimates[networkType] = estimate;
+        }
+        
+        if (receivedBytes <= self.maximumRoundTripTimeResponseSize)
+        {
+            double weight = [self decayedWeight:estimate.roundTripTimeWeight since:estimate.roundTripTimeUpdateTime now:now];
+            estimate.roundTripTime = (estimate.roundTripTime * weight + duration) / (weight + 1.);
+            estimate.roundTripTimeWeight = weight + 1.;
+            estimate.roundTripTimeUpdateTime = now;
+            estimate.numberOfRoundTripTimeObservations++;
+        }
+        if (receivedBytes >= self.minimumThroughputResponseSize)
+        {
+            // time of the transfer only, without the round trip of the request
+            NSTimeInterval transferTime = MAX(duration - estimate.roundTripTime, duration * 0.5);
+            double throughput = receivedBytes * 8. / 1000. / transferTime;
+            double weight = [self decayedWeight:estimate.throughputWeight since:estimate.throughputUpdateTime now:now];
+            estimate.throughput = (estimate.throughput * weight + throughput) / (weight + 1.);
+            estimate.throughputWeight = weight + 1.;
+            estimate.throughputUpdateTime = now;
+            estimate.numberOfThroughputObservations++;
+        }
+    }
+    [self notifyChangeIfNeeded];
+}
+
+- (double) decayedWeight:(double)weight since:(CFAbsoluteTime)updateTime now:(CFAbsoluteTime)now
+{
+    if (weight <= 0 || self.halfLife <= 0)
+    {
+        return 0;
+    }
+    return weight * pow(0.5, MAX(now - updateTime, 0.) / self.halfLife);
+}
+
+#pragma mark - Notification
+
+- (void) notifyChangeIfNeeded
+{
+    if (!NSThread.isMainThread)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self notifyChangeIfNeeded];
+        });
+        return;
+    }
+    
+    SDNetworkQualityEstimate* estimate = [self currentEstimate];
+    if (estimate.quality == self.notifiedQuality && [estimate.networkType isEqualToString:self.notifiedNetworkType])
+    {
+        return;
+    }
+    self.notifiedQuality = estimate.quality;
+    self.notifiedNetworkType = estimate.networkType;
+    [[NSNotificationCenter defaultCenter] postNotificationName:SDNetworkQualityDidChangeNotification object:self userInfo:@{ SDNetworkQualityEstimateKey : estimate }];
+}
+
+@end
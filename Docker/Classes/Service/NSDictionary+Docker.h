@@ -18,4 +18,10 @@
 
 - (NSDictionary *)pruneNullValues;
 
+/**
+ *  String that represents the content of dictionary independently by the order of keys (keys are sorted at every level).
+ *  Two dictionaries with the same content return the same string. Use it to build keys for caches and indexes.
+ */
+- (NSString *)canonicalString;
+
 @end
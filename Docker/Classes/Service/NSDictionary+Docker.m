@@ -14,52 +14,106 @@
 
 #import "NSDictionary+Docker.h"
 
+static void SDAppendCanonicalString(NSMutableString* accumulator, id object)
+{
+    if ([object isKindOfClass:[NSDictionary class]])
+    {
+        NSDictionary* dictionary = object;
+        NSArray* sortedKeys = [dictionary.allKeys sortedArrayUsingSelector:@selector(compare:)];
+        [accumulator appendString:@"{"];
+        BOOL first = YES;
+        for (id key in sortedKeys)
+        {
+            if (!first)
+            {
+                [accumulator appendString:@","];
+            }
+            first = NO;
+            SDAppendCanonicalString(accumulator, [key description]);
+            [accumulator appendString:@":"];
+            SDAppendCanonicalString(accumulator, dictionary[key]);
+        }
+        [accumulator appendString:@"}"];
+    }
+    else if ([object isKindOfClass:[NSArray class]])
+    {
+        [accumulator appendString:@"["];
+        BOOL first = YES;
+        for (id subobject in (NSArray*)object)
+        {
+            if (!first)
+            {
+                [accumulator appendString:@","];
+            }
+            first = NO;
+            SDAppendCanonicalString(accumulator, subobject);
+        }
+        [accumulator appendString:@"]"];
+    }
+    else if ([object isKindOfClass:[NSString class]])
+    {
+        NSString* escaped = [(NSString*)object stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"];
+        escaped = [escaped stringByReplacingOccurrencesOfString:@"\"" withString:@"\\\""];
+        [accumulator appendFormat:@"\"%@\"", escaped];
+    }
+    else if (object == nil || object == (id)[NSNull null])
+    {
+        [accumulator appendString:@"null"];
+    }
+    else
+    {
+        [accumulator appendString:[object description]];
+    }
+}
+
 @implementation NSDictionary (Docker)
 
 - (NSDictionary *)pruneNullValues
 {
-    NSMutableDictionary *dictionaryCopy = [self mutableCopy];
-    for (NSString *key in [self allKeys])
-    {
-        id object = [self objectForKey:key];
+    NSMutableDictionary *dictionaryCopy = [NSMutableDictionary dictionaryWithCapacity:self.count];
+    [self enumerateKeysAndObjectsUsingBlock:^(id key, id object, BOOL *stop) {
         if ([object isKindOfClass:[NSDictionary class]])
         {
             NSDictionary* prunedDict = [(NSDictionary *)object pruneNullValues];
-            if(prunedDict.allKeys.count > 0)
+            if(prunedDict.count > 0)
             {
                 [dictionaryCopy setObject:prunedDict forKey:key];
             }
-            else
-            {
-                [dictionaryCopy removeObjectForKey:key];
-            }
         }
         else if([object isKindOfClass:[NSArray class]])
         {
-            NSMutableArray* arrayCopy = [(NSArray*) object mutableCopy];
+            // single pass: pruned dictionaries are added in place, empty ones are skipped
+            NSMutableArray* arrayCopy = [NSMutableArray arrayWithCapacity:[(NSArray*) object count]];
             for(id subobject in object)
             {
                 if([subobject isKindOfClass:[NSDictionary class]])
                 {
                     NSDictionary* prunedDict = [(NSDictionary *)subobject pruneNullValues];
-                    if(prunedDict.allKeys.count > 0)
+                    if(prunedDict.count > 0)
                     {
-                        [arrayCopy replaceObjectAtIndex:[arrayCopy indexOfObject:subobject] withObject:prunedDict];
-                    }
-                    else
-                    {
-                        [arrayCopy removeObjectAtIndex:[arrayCopy indexOfObject:subobject]];
+                        [arrayCopy addObject:prunedDict];
                     }
                 }
+                else
+                {
+                    [arrayCopy addObject:subobject];
+                }
             }
             [dictionaryCopy setObject:arrayCopy forKey:key];
         }
-        else if (object == (id)[NSNull null])
+        else if (object != (id)[NSNull null])
         {
-            [dictionaryCopy removeObjectForKey:key];
+            [dictionaryCopy setObject:object forKey:key];
         }
-    }
+    }];
     return dictionaryCopy;
 }
 
+- (NSString *)canonicalString
+{
+    NSMutableString* accumulator = [NSMutableString new];
+    SDAppendCanonicalString(accumulator, self);
+    return accumulator;
+}
+
 @end
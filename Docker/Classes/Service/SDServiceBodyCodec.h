@@ -0,0 +1,51 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Encoder and decoder of request and response bodies of a binary or text format, registered in SDServiceManager for its content types.
+ *  Decoded objects must be the same Foundation objects NSJSONSerialization returns (NSDictionary with NSString keys, NSArray, NSString, NSNumber, NSNull),
+ *  so responseForObject:error: of services and Mantle mapping work with any format.
+ *
+ *  Codecs are used from mapping executor threads, so they must be thread safe.
+ */
+@protocol SDServiceBodyCodec <NSObject>
+
+/**
+ *  Content types handled by the codec, lowercase and without parameters (ex. application/msgpack).
+ */
+- (NSArray<NSString*>* _Nonnull) contentTypes;
+
+/**
+ *  Body of a request.
+ *
+ *  @param object     parameters of the request (same objects accepted by NSJSONSerialization).
+ *  @param error      possible error encoding (passed by reference).
+ *
+ *  @return encoded data, or nil in case of failure.
+ */
+- (NSData* _Nullable) dataWithObject:(id _Nonnull)object error:(NSError* _Nullable * _Nullable)error;
+
+/**
+ *  Object of the body of a response.
+ *
+ *  @param data       body of the response.
+ *  @param error      possible error decoding (passed by reference).
+ *
+ *  @return decoded object, or nil in case of failure.
+ */
+- (id _Nullable) objectWithData:(NSData* _Nonnull)data error:(NSError* _Nullable * _Nullable)error;
+
+@end
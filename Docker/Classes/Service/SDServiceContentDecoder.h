@@ -0,0 +1,132 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceContentDecoderErrorDomain;
+
+typedef NS_ENUM (NSInteger, SDServiceContentDecoderErrorCode)
+{
+    /**
+     *  Content-Encoding of the response without a registered decoder, or refused by the factory of its decoder.
+     */
+    SDServiceContentDecoderErrorCodeUnsupportedEncoding = -1,
+    /**
+     *  Body compressed with a dictionary that is not available.
+     */
+    SDServiceContentDecoderErrorCodeDictionaryNotFound = -2,
+    /**
+     *  Body is not valid for its encoding, or has bytes after the end of the compressed stream.
+     */
+    SDServiceContentDecoderErrorCodeInvalidData = -3,
+    /**
+     *  Body ends before the end of the compressed stream.
+     */
+    SDServiceContentDecoderErrorCodeTruncatedData = -4,
+};
+
+/**
+ *  Streaming decoder of a Content-Encoding of response bodies, registered in SDServiceManager through a SDServiceContentDecoderFactory.
+ *  A new decoder is created for every response, and receives the body while it arrives from the network thread of the call.
+ */
+@protocol SDServiceContentDecoder <NSObject>
+
+/**
+ *  Decode the next bytes of the body.
+ *
+ *  @param bytes      encoded bytes.
+ *  @param length     number of encoded bytes.
+ *  @param data       decoded bytes are appended to data.
+ *  @param error      possible error decoding (passed by reference).
+ *
+ *  @return NO in case of failure.
+ */
+- (BOOL) decodeBytes:(const uint8_t* _Nonnull)bytes length:(NSUInteger)length intoData:(NSMutableData* _Nonnull)data error:(NSError* _Nullable * _Nullable)error;
+
+/**
+ *  Called when the body ends, to append the remaining decoded bytes and check the body is complete.
+ *
+ *  @param data       decoded bytes are appended to data.
+ *  @param error      possible error decoding (passed by reference).
+ *
+ *  @return NO in case of failure.
+ */
+- (BOOL) finishIntoData:(NSMutableData* _Nonnull)data error:(NSError* _Nullable * _Nullable)error;
+
+@end
+
+/**
+ *  Block that creates the decoder of a response (ex. choosing the dictionary from its headers).
+ *
+ *  @param response   response whose body must be decoded.
+ *
+ *  @return decoder, or nil if the body can't be decoded.
+ */
+typedef id<SDServiceContentDecoder> _Nullable (^ SDServiceContentDecoderFactory)(NSHTTPURLResponse* _Nonnull response);
+
+/**
+ *  Decoder of zlib streams (RFC 1950) compressed with a pre-shared dictionary, for custom Content-Encoding values like x-deflate-dictionary.
+ *  Compressing with a dictionary of the typical contents of responses (ex. keys and common values of JSON objects) makes small responses much smaller than with gzip.
+ *
+ *  The dictionary is chosen by the identifier (Adler-32 checksum) the server writes in the zlib header, so the app can ship more versions of the dictionary.
+ *  Streams compressed without dictionary are decoded too.
+ */
+@interface SDServiceDeflateContentDecoder : NSObject <SDServiceContentDecoder>
+
+- (instancetype _Nonnull) initWithDictionaries:(NSArray<NSData*>* _Nullable)dictionaries;
+
+/**
+ *  Factory of decoders with the dictionaries, to register in SDServiceManager (dictionary identifiers are computed once).
+ */
++ (SDServiceContentDecoderFactory _Nonnull) factoryWithDictionaries:(NSArray<NSData*>* _Nullable)dictionaries;
+
+/**
+ *  Dictionaries shipped in the bundle as resources with the extension (ex. zdict).
+ */
++ (NSArray<NSData*>* _Nonnull) dictionariesWithExtension:(NSString* _Nonnull)extension inBundle:(NSBundle* _Nonnull)bundle;
+
+/**
+ *  Identifier of the dictionary written in the zlib header (Adler-32 checksum of the dictionary).
+ */
++ (uint32_t) identifierOfDictionary:(NSData* _Nonnull)dictionary;
+
+@end
+
+/**
+ *  Output stream of response bodies that decodes, while the body arrives, the Content-Encoding values that have a decoder factory.
+ *  Encodings applied in sequence (ex. "x-deflate-dictionary, x-other") are decoded in reverse order. Bodies with only encodings without factory (ex. gzip, decoded by the system) are kept as they are.
+ *
+ *  After an error the stream has no space available, so the operation writing in it fails with streamError; if the error is found when the body ends, decoded data is nil.
+ */
+@interface SDServiceContentDecodingStream : NSOutputStream
+
+/**
+ *  @param decoderFactories factories by Content-Encoding value (lowercase).
+ *  @param responseBlock    returns the response of the body, called on the first write.
+ */
+- (instancetype _Nonnull) initWithDecoderFactories:(NSDictionary<NSString*, SDServiceContentDecoderFactory>* _Nonnull)decoderFactories responseBlock:(NSHTTPURLResponse* _Nullable (^ _Nonnull)(void))responseBlock;
+
+/**
+ *  Decoded body (NSStreamDataWrittenToMemoryStreamKey property). The body ends when it is read: nil in case of error.
+ */
+@property (nonatomic, readonly) NSData* _Nullable decodedData;
+
+/**
+ *  Decode a whole body at once (ex. a body read from NSURLCache).
+ *
+ *  @return data decoded, data itself if no encoding of the response has a factory, nil in case of failure.
+ */
++ (NSData* _Nullable) dataByDecodingData:(NSData* _Nonnull)data response:(NSHTTPURLResponse* _Nonnull)response decoderFactories:(NSDictionary<NSString*, SDServiceContentDecoderFactory>* _Nonnull)decoderFactories error:(NSError* _Nullable * _Nullable)error;
+
+@end
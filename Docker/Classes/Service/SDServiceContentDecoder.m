@@ -0,0 +1,405 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceContentDecoder.h"
+#import <zlib.h>
+
+NSString* const SDServiceContentDecoderErrorDomain = @"SDServiceContentDecoderErrorDomain";
+
+#define CONTENT_DECODER_OUTPUT_CHUNK_SIZE   16384
+
+static BOOL SDServiceContentDecoderFail(NSError** error, NSInteger code, NSString* description)
+{
+    if (error)
+    {
+        *error = [NSError errorWithDomain:SDServiceContentDecoderErrorDomain code:code userInfo:@{ NSLocalizedDescriptionKey : description }];
+    }
+    return NO;
+}
+
+#pragma mark - SDServiceDeflateContentDecoder
+
+@interface SDServiceDeflateContentDecoder ()
+{
+    z_stream stream;
+}
+@property (nonatomic, strong) NSDictionary<NSNumber*, NSData*>* dictionariesByIdentifier;
+@property (nonatomic, assign) BOOL initialized;
+@property (nonatomic, assign) BOOL ended;
+@end
+
+@implementation SDServiceDeflateContentDecoder
+
+- (instancetype) initWithDictionaries:(NSArray<NSData*>*)dictionaries
+{
+    return [self initWithDictionariesByIdentifier:[SDServiceDeflateContentDecoder dictionariesByIdentifierWithDictionaries:dictionaries]];
+}
+
+- (instancetype) initWithDictionariesByIdentifier:(NSDictionary<NSNumber*, NSData*>*)dictionariesByIdentifier
+{
+    self = [super init];
+    if (self)
+    {
+        _dictionariesByIdentifier = dictionariesByIdentifier;
+        memset(&stream, 0, sizeof(z_stream));
+        _initialized = inflateInit2(&stream, MAX_WBITS) == Z_OK;
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    if (_initialized)
+    {
+        inflateEnd(&stream);
+    }
+}
+
++ (SDServiceContentDecoderFactory) factoryWithDictionaries:(NSArray<NSData*>*)dictionaries
+{
+    NSDictionary<NSNumber*, NSData*>* dictionariesByIdentifier = [self dictionariesByIdentifierWithDictionaries:dictionaries];
+    return ^id<SDServiceContentDecoder>(NSHTTPURLResponse* response) {
+        return [[SDServiceDeflateContentDecoder alloc] initWithDictionariesByIdentifier:dictionariesByIdentifier];
+    };
+}
+
++ (NSArray<NSData*>*) dictionariesWithExtension:(NSString*)extension inBundle:(NSBundle*)bundle
+{
+    NSMutableArray<NSData*>* dictionaries = [NSMutableArray array];
+    for (NSString* path in [bundle pathsForResourcesOfType:extension inDirectory:nil])
+    {
+        NSData* dictionary = [NSData dataWithContentsOfFile:path];
+        if (dictionary.length > 0)
+        {
+            [dictionaries addObject:dictionary];
+        }
+    }
+    return dictionaries;
+}
+
++ (uint32_t) identifierOfDictionary:(NSData*)dictionary
+{
+    return (uint32_t)adler32(adler32(0L, Z_NULL, 0), dictionary.bytes, (uInt)dictionary.length);
+}
+
++ (NSDictionary<NSNumber*, NSData*>*) dictionariesByIdentifierWithDictionaries:(NSArray<NSData*>*)dictionaries
+{
+    NSMutableDictionary<NSNumber*, NSData*>* dictionariesByIdentifier = [NSMutableDictionary dictionary];
+    for (NSData* dictionary in dictionaries)
+    {
+        dictionariesByIdentifier[@([self identifierOfDictionary:dictionary])] = dictionary;
+    }
+    return [dictionariesByIdentifier copy];
+}
+
+- (BOOL) decodeBytes:(const uint8_t*)bytes length:(NSUInteger)length intoData:(NSMutableData*)data error:(NSError**)error
+{
+    if (!self.initialized)
+    {
+        return SDServiceContentDecoderFail(error, SDServiceContentDecoderErrorCodeInvalidData, @"zlib stream not initialized");
+    }
+    if (self.ended)
+    {
+        return length == 0 || SDServiceContentDecoderFail(error, SDServiceContentDecoderErrorCodeInvalidData, @"Bytes after the end of the compressed stream");
+    }
+    
+    stream.next_in = (Bytef*)bytes;
+    stream.avail_in = (uInt)length;
+    do
+    {
+        // inflate directly at the end of data
+        NSUInteger start = data.length;
+        [data setLength:start + CONTENT_DECODER_OUTPUT_CHUNK_SIZE];
+        stream.next_out = (Bytef*)data.mutableBytes + start;
+        stream.avail_out = CONTENT_DECODER_OUTPUT_CHUNK_SIZE;
+        
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_NEED_DICT)
+        {
+            // adler holds the identifier of the dictionary read from the header
+            NSData* dictionary = self.dictionariesByIdentifier[@((uint32_t)stream.adler)];
+            if (!dictionary)
+            {
+                [data setLength:start];
+                return SDServiceContentDecoderFail(error, SDServiceContentDecoderErrorCodeDictionaryNotFound, [NSString stringWithFormat:@"Dictionary %08lx not found", (unsigned long)stream.adler]);
+            }
+            result = inflateSetDictionary(&stream, dictionary.bytes, (uInt)dictionary.length);
+        }
+        [data setLength:start + CONTENT_DECODER_OUTPUT_CHUNK_SIZE - stream.avail_out];
+        
+        if (result == Z_STREAM_END)
+        {
+            self.ended = YES;
+            return stream.avail_in == 0 || SDServiceContentDecoderFail(error, SDServiceContentDecoderErrorCodeInvalidData, @"Bytes after the end of the compressed stream");
+        }
+        if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+            return SDServiceContentDecoderFail(error, SDServiceContentDecoderErrorCodeInvalidData, [NSString stringWithFormat:@"Invalid zlib stream: %s", stream.msg ?: "error"]);
+        }
+    }
+    while (stream.avail_in > 0 || stream.avail_out == 0);
+    
+    return YES;
+}
+
+- (BOOL) finishIntoData:(NSMutableData*)data error:(NSError**)error
+{
+    return self.ended || SDServiceContentDecoderFail(error, SDServiceContentDecoderErrorCodeTruncatedData, @"Body ends before the end of the compressed stream");
+}
+
+@end
+
+#pragma mark - SDServiceContentDecodingStream
+
+@interface SDServiceContentDecodingStream ()
+@property (nonatomic, strong) NSDictionary<NSString*, SDServiceContentDecoderFactory>* decoderFactories;
+@property (nonatomic, copy) NSHTTPURLResponse* (^ responseBlock)(void);
+
+/**
+ *  Decoders in decoding order (empty if the body is kept as it is), nil until the first write.
+ */
+@property (nonatomic, strong) NSArray<id<SDServiceContentDecoder>>* decoders;
+
+/**
+ *  Output of every decoder but the last one, input of the next decoder.
+ */
+@property (nonatomic, strong) NSArray<NSMutableData*>* buffers;
+
+@property (nonatomic, strong) NSMutableData* data;
+@property (nonatomic, weak) id<NSStreamDelegate> streamDelegate;
+@property (nonatomic, assign) NSStreamStatus status;
+@property (nonatomic, strong) NSError* error;
+@property (nonatomic, assign) BOOL ended;
+@end
+
+@implementation SDServiceContentDecodingStream
+
+- (instancetype) initWithDecoderFactories:(NSDictionary<NSString*, SDServiceContentDecoderFactory>*)decoderFactories responseBlock:(NSHTTPURLResponse* (^)(void))responseBlock
+{
+    self = [super init];
+    if (self)
+    {
+        _decoderFactories = [decoderFactories copy];
+        _responseBlock = [responseBlock copy];
+        _data = [NSMutableData data];
+        _status = NSStreamStatusNotOpen;
+    }
+    return self;
+}
+
++ (NSData*) dataByDecodingData:(NSData*)data response:(NSHTTPURLResponse*)response decoderFactories:(NSDictionary<NSString*, SDServiceContentDecoderFactory>*)decoderFactories error:(NSError**)error
+{
+    SDServiceContentDecodingStream* stream = [[SDServiceContentDecodingStream alloc] initWithDecoderFactories:decoderFactories responseBlock:^NSHTTPURLResponse* {
+        return response;
+    }];
+    [stream open];
+    if (data.length > 0)
+    {
+        [stream write:data.bytes maxLength:data.length];
+    }
+    NSData* decodedData = stream.decodedData;
+    [stream close];
+    if (!decodedData && error)
+    {
+        *error = stream.streamError;
+    }
+    return decodedData;
+}
+
+#pragma mark NSStream
+
+- (void) open
+{
+    if (self.status == NSStreamStatusNotOpen)
+    {
+        self.status = NSStreamStatusOpen;
+    }
+}
+
+- (void) close
+{
+    if (self.status != NSStreamStatusError)
+    {
+        self.status = NSStreamStatusClosed;
+    }
+}
+
+- (id<NSStreamDelegate>) delegate
+{
+    return self.streamDelegate ?: self;
+}
+
+- (void) setDelegate:(id<NSStreamDelegate>)delegate
+{
+    self.streamDelegate = delegate;
+}
+
+- (NSStreamStatus) streamStatus
+{
+    return self.status;
+}
+
+- (NSError*) streamError
+{
+    return self.error;
+}
+
+- (id) propertyForKey:(NSString*)key
+{
+    return [key isEqualToString:NSStreamDataWrittenToMemoryStreamKey] ? self.decodedData : nil;
+}
+
+- (BOOL) setProperty:(id)property forKey:(NSString*)key
+{
+    return NO;
+}
+
+- (void) scheduleInRunLoop:(NSRunLoop*)runLoop forMode:(NSString*)mode
+{
+    // writes are synchronous: nothing to schedule
+}
+
+- (void) removeFromRunLoop:(NSRunLoop*)runLoop forMode:(NSString*)mode
+{
+}
+
+#pragma mark NSOutputStream
+
+- (BOOL) hasSpaceAvailable
+{
+    return self.status == NSStreamStatusOpen && !self.ended;
+}
+
+- (NSInteger) write:(const uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    if (![self hasSpaceAvailable])
+    {
+        return -1;
+    }
+    
+    NSError* error = nil;
+    if (!self.decoders && ![self resolveDecodersWithError:&error])
+    {
+        [self failWithError:error];
+        return -1;
+    }
+    if (![self decodeBytes:buffer length:length finishing:NO error:&error])
+    {
+        [self failWithError:error];
+        return -1;
+    }
+    return (NSInteger)length;
+}
+
+#pragma mark Decoding
+
+- (NSData*) decodedData
+{
+    if (!self.ended && self.status != NSStreamStatusError)
+    {
+        self.ended = YES;
+        NSError* error = nil;
+        if (self.decoders && ![self decodeBytes:NULL length:0 finishing:YES error:&error])
+        {
+            [self failWithError:error];
+        }
+    }
+    return self.status == NSStreamStatusError ? nil : self.data;
+}
+
+/**
+ *  Create decoders for Content-Encoding of the response (read when the body starts arriving).
+ */
+- (BOOL) resolveDecodersWithError:(NSError**)error
+{
+    self.decoders = @[];
+    NSHTTPURLResponse* response = self.responseBlock ? self.responseBlock() : nil;
+    NSString* contentEncoding = nil;
+    for (NSString* key in response.allHeaderFields)
+    {
+        if ([key caseInsensitiveCompare:@"Content-Encoding"] == NSOrderedSame)
+        {
+            contentEncoding = [response.allHeaderFields[key] description];
+        }
+    }
+    
+    NSMutableArray<NSString*>* encodings = [NSMutableArray array];
+    BOOL decodes = NO;
+    for (NSString* component in [contentEncoding componentsSeparatedByString:@","])
+    {
+        NSString* encoding = [component stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]].lowercaseString;
+        if (encoding.length > 0 && ![encoding isEqualToString:@"identity"])
+        {
+            [encodings addObject:encoding];
+            decodes = decodes || self.decoderFactories[encoding] != nil;
+        }
+    }
+    if (!decodes)
+    {
+        // encodings decoded by the system, or none
+        return YES;
+    }
+    
+    NSMutableArray<id<SDServiceContentDecoder>>* decoders = [NSMutableArray array];
+    for (NSString* encoding in encodings.reverseObjectEnumerator)
+    {
+        SDServiceContentDecoderFactory factory = self.decoderFactories[encoding];
+        id<SDServiceContentDecoder> decoder = factory ? factory(response) : nil;
+        if (!decoder)
+        {
+            return SDServiceContentDecoderFail(error, SDServiceContentDecoderErrorCodeUnsupportedEncoding, [NSString stringWithFormat:@"No decoder for Content-Encoding %@", encoding]);
+        }
+        [decoders addObject:decoder];
+    }
+    NSMutableArray<NSMutableData*>* buffers = [NSMutableArray array];
+    for (NSUInteger i = 1; i < decoders.count; i++)
+    {
+        [buffers addObject:[NSMutableData data]];
+    }
+    self.decoders = decoders;
+    self.buffers = buffers;
+    return YES;
+}
+
+- (BOOL) decodeBytes:(const uint8_t*)bytes length:(NSUInteger)length finishing:(BOOL)finishing error:(NSError**)error
+{
+    if (self.decoders.count == 0)
+    {
+        [self.data appendBytes:bytes length:length];
+        return YES;
+    }
+    
+    BOOL success = YES;
+    for (NSUInteger i = 0; i < self.decoders.count && success; i++)
+    {
+        id<SDServiceContentDecoder> decoder = self.decoders[i];
+        NSMutableData* output = i < self.buffers.count ? self.buffers[i] : self.data;
+        success = (length == 0 || [decoder decodeBytes:bytes length:length intoData:output error:error]) && (!finishing || [decoder finishIntoData:output error:error]);
+        bytes = output.bytes;
+        length = output.length;
+    }
+    for (NSMutableData* buffer in self.buffers)
+    {
+        [buffer setLength:0];
+    }
+    return success;
+}
+
+- (void) failWithError:(NSError*)error
+{
+    self.error = error;
+    self.status = NSStreamStatusError;
+}
+
+@end
@@ -0,0 +1,143 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import "SDServiceMantle.h"
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceEventStreamErrorDomain;
+
+typedef NS_ENUM (NSInteger, SDServiceEventStreamErrorCode)
+{
+    /**
+     *  Response is not a 200 text/event-stream response. userInfo contains the status code for SDServiceEventStreamStatusCodeKey.
+     */
+    SDServiceEventStreamErrorCodeInvalidResponse = -1,
+};
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceEventStreamStatusCodeKey;
+
+typedef NS_ENUM (NSInteger, SDServiceEventStreamState)
+{
+    SDServiceEventStreamStateClosed = 0,
+    SDServiceEventStreamStateConnecting,
+    SDServiceEventStreamStateOpen
+};
+
+/**
+ *  Event received from a text/event-stream connection.
+ */
+@interface SDServiceEvent : NSObject
+
+/**
+ *  Type of the event (field "event"), "message" if not set.
+ */
+@property (nonatomic, strong, readonly) NSString* _Nonnull type;
+
+/**
+ *  Last event ID of the stream when the event was dispatched (field "id"), nil if the server never sent one.
+ */
+@property (nonatomic, strong, readonly) NSString* _Nullable identifier;
+
+/**
+ *  Payload of the event: data lines joined by "\n".
+ */
+@property (nonatomic, strong, readonly) NSString* _Nonnull data;
+
+/**
+ *  Payload parsed as JSON and mapped by responseForObject:error: of the service. nil if the payload isn't mapped, or if it is not JSON or mapping failed (see mappingError).
+ */
+@property (nonatomic, strong, readonly) id<SDServiceGenericResponseProtocol> _Nullable response;
+@property (nonatomic, strong, readonly) NSError* _Nullable mappingError;
+
+@end
+
+/**
+ *  Service of a long lived text/event-stream (Server-Sent Events) connection, to receive updates pushed by server instead of polling.
+ *
+ *  Subclasses implement pathResource, requestOperationManager (for base URL and request serializer) and mapping as any SDServiceMantle service:
+ *  the data of every event is parsed as JSON and mapped by responseForObject:error:. Connections are opened with SDServiceEventStreamConnection.
+ */
+@interface SDServiceEventStream : SDServiceMantle
+
+/**
+ *  Time before reconnecting after the connection ends, until the server sends a "retry" field. Doubled at every consecutive failed attempt, up to maximumReconnectionTime.
+ *
+ *  @return reconnection time in seconds. Default is 3.
+ */
+- (NSTimeInterval) reconnectionTime;
+
+/**
+ *  @return maximum time between reconnection attempts in seconds. Default is 60.
+ */
+- (NSTimeInterval) maximumReconnectionTime;
+
+/**
+ *  Time without any byte from server (events or comments used as heartbeat) after which the connection is considered lost and reopened.
+ *
+ *  @return idle timeout in seconds. Default is 90.
+ */
+- (NSTimeInterval) idleTimeout;
+
+/**
+ *  Events whose data is mapped with responseForObject:error:.
+ *
+ *  @return YES to map the data of events of type. Default is YES.
+ */
+- (BOOL) mapsDataOfEventWithType:(NSString* _Nonnull)type;
+
+@end
+
+typedef void (^ SDServiceEventHandler)(SDServiceEvent* _Nonnull event);
+typedef void (^ SDServiceEventStreamErrorHandler)(NSError* _Nonnull error, BOOL willReconnect);
+
+/**
+ *  Connection to the event stream of a service. Events are parsed incrementally as bytes arrive and delivered on eventQueue.
+ *
+ *  When the connection ends or fails (network error, idle timeout, 5xx response) it is reopened automatically sending the Last-Event-ID header,
+ *  so the server can resend missed events. A 204 response closes the stream, other invalid responses close it with an error.
+ *
+ *  The connection is retained by its URL session while open: call close when done. All methods are thread safe.
+ */
+@interface SDServiceEventStreamConnection : NSObject
+
+- (instancetype _Nonnull) initWithService:(SDServiceEventStream* _Nonnull)service request:(id<SDServiceGenericRequestProtocol> _Nullable)request;
+
+@property (nonatomic, strong, readonly) SDServiceEventStream* _Nonnull service;
+@property (nonatomic, strong, readonly) id<SDServiceGenericRequestProtocol> _Nullable request;
+
+/**
+ *  Queue of eventHandler and errorHandler. Default: main queue
+ */
+@property (atomic, strong) dispatch_queue_t _Nonnull eventQueue;
+
+@property (atomic, copy) SDServiceEventHandler _Nullable eventHandler;
+
+/**
+ *  Called when the connection fails: willReconnect is NO when the stream is closed.
+ */
+@property (atomic, copy) SDServiceEventStreamErrorHandler _Nullable errorHandler;
+
+/**
+ *  ID of the last event received, sent as Last-Event-ID when reconnecting. Set it before open to resume a previous stream.
+ */
+@property (atomic, strong) NSString* _Nullable lastEventIdentifier;
+
+@property (atomic, readonly) SDServiceEventStreamState state;
+@property (atomic, readonly) NSUInteger numberOfEvents;
+@property (atomic, readonly) NSUInteger numberOfReconnections;
+
+- (void) open;
+- (void) close;
+
+@end
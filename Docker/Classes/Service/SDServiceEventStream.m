@@ -0,0 +1,475 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceEventStream.h"
+#import "SDDockerLogger.h"
+
+#define DEFAULT_EVENT_STREAM_RECONNECTION_TIME          3.
+#define DEFAULT_EVENT_STREAM_MAXIMUM_RECONNECTION_TIME  60.
+#define DEFAULT_EVENT_STREAM_IDLE_TIMEOUT               90.
+
+#define ConnectionQueueName     "com.sysdata.SDServiceEventStreamConnection.connectionQueue"
+
+NSString* const SDServiceEventStreamErrorDomain = @"EVENT_STREAM";
+NSString* const SDServiceEventStreamStatusCodeKey = @"SDServiceEventStreamStatusCode";
+
+@interface SDServiceEvent ()
+
+@property (nonatomic, strong, readwrite) NSString* type;
+@property (nonatomic, strong, readwrite) NSString* identifier;
+@property (nonatomic, strong, readwrite) NSString* data;
+@property (nonatomic, strong, readwrite) id<SDServiceGenericResponseProtocol> response;
+@property (nonatomic, strong, readwrite) NSError* mappingError;
+
+@end
+
+@implementation SDServiceEvent
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: %p type: %@ id: %@ data: %@>", NSStringFromClass([self class]), self, self.type, self.identifier, self.data];
+}
+
+@end
+
+
+@implementation SDServiceEventStream
+
+- (NSTimeInterval) reconnectionTime
+{
+    return DEFAULT_EVENT_STREAM_RECONNECTION_TIME;
+}
+
+- (NSTimeInterval) maximumReconnectionTime
+{
+    return DEFAULT_EVENT_STREAM_MAXIMUM_RECONNECTION_TIME;
+}
+
+- (NSTimeInterval) idleTimeout
+{
+    return DEFAULT_EVENT_STREAM_IDLE_TIMEOUT;
+}
+
+- (BOOL) mapsDataOfEventWithType:(NSString*)type
+{
+    return YES;
+}
+
+@end
+
+
+@interface SDServiceEventStreamConnection () <NSURLSessionDataDelegate>
+{
+    /**
+     *  Serial queue of the state of the connection, URL session callbacks and parsing.
+     */
+    dispatch_queue_t connectionQueue;
+    NSURLSession* URLSession;
+    NSURLSessionDataTask* dataTask;
+    
+    /**
+     *  Increased at every attempt and at close, to ignore scheduled reconnections that are not valid anymore.
+     */
+    NSUInteger attempt;
+    NSUInteger numberOfConsecutiveFailures;
+    NSTimeInterval reconnectionTime;
+    
+    // parser
+    NSMutableData* lineBuffer;
+    BOOL skipsLineFeed;
+    BOOL isFirstLine;
+    NSMutableString* dataBuffer;
+    NSString* eventTypeBuffer;
+    NSString* lastEventIdentifierBuffer;
+}
+
+@property (atomic, readwrite) SDServiceEventStreamState state;
+@property (atomic, readwrite) NSUInteger numberOfEvents;
+@property (atomic, readwrite) NSUInteger numberOfReconnections;
+
+@end
+
+@implementation SDServiceEventStreamConnection
+
+- (instancetype) initWithService:(SDServiceEventStream*)service request:(id<SDServiceGenericRequestProtocol>)request
+{
+    self = [super init];
+    if (self)
+    {
+        _service = service;
+        _request = request;
+        _eventQueue = dispatch_get_main_queue();
+        connectionQueue = dispatch_queue_create(ConnectionQueueName, DISPATCH_QUEUE_SERIAL);
+        reconnectionTime = [service reconnectionTime];
+        lineBuffer = [NSMutableData data];
+        dataBuffer = [NSMutableString string];
+    }
+    return self;
+}
+
+- (void) open
+{
+    dispatch_async(connectionQueue, ^{
+        if (self.state != SDServiceEventStreamStateClosed)
+        {
+            return;
+        }
+        self.state = SDServiceEventStreamStateConnecting;
+        numberOfConsecutiveFailures = 0;
+        lastEventIdentifierBuffer = self.lastEventIdentifier;
+        [self connect];
+    });
+}
+
+- (void) close
+{
+    dispatch_async(connectionQueue, ^{
+        [self closeSession];
+    });
+}
+
+- (void) closeSession
+{
+    self.state = SDServiceEventStreamStateClosed;
+    attempt++;
+    [dataTask cancel];
+    dataTask = nil;
+    // releases the delegate (self)
+    [URLSession invalidateAndCancel];
+    URLSession = nil;
+}
+
+#pragma mark - Connection
+
+/**
+ *  Request of the stream. Must be called on main thread: the request serializer is shared with SDServiceManager, that sets temporary headers on it while sending calls.
+ */
+- (NSURLRequest*) URLRequestWithLastEventIdentifier:(NSString*)lastEventIdentifier error:(NSError**)error
+{
+    AFHTTPRequestOperationManager* requestOperationManager = [self.service requestOperationManager];
+    NSString* URLString = [[NSURL URLWithString:[self.service pathResource] relativeToURL:requestOperationManager.baseURL] absoluteString];
+    NSDictionary* parameters = [self.service parametersForRequest:self.request error:error];
+    if (error && *error)
+    {
+        return nil;
+    }
+    
+    NSMutableURLRequest* URLRequest = [requestOperationManager.requestSerializer requestWithMethod:NSStringFromSDHTTPMethod([self.service requestMethodType]) URLString:URLString parameters:parameters error:error];
+    [self.request.additionalRequestHeaders enumerateKeysAndObjectsUsingBlock:^(NSString* name, NSString* value, BOOL* stop) {
+        [URLRequest setValue:value forHTTPHeaderField:name];
+    }];
+    [URLRequest setValue:@"text/event-stream" forHTTPHeaderField:@"Accept"];
+    [URLRequest setValue:@"no-cache" forHTTPHeaderField:@"Cache-Control"];
+    if (lastEventIdentifier.length > 0)
+    {
+        [URLRequest setValue:lastEventIdentifier forHTTPHeaderField:@"Last-Event-ID"];
+    }
+    URLRequest.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+    URLRequest.timeoutInterval = [self.service idleTimeout];
+    return URLRequest;
+}
+
+- (void) connect
+{
+    NSUInteger connectingAttempt = attempt;
+    NSString* lastEventIdentifier = lastEventIdentifierBuffer;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        NSError* error = nil;
+        NSURLRequest* URLRequest = [self URLRequestWithLastEventIdentifier:lastEventIdentifier error:&error];
+        dispatch_async(connectionQueue, ^{
+            // closed or reconnected meanwhile
+            if (attempt == connectingAttempt && self.state == SDServiceEventStreamStateConnecting)
+            {
+                [self connectWithURLRequest:URLRequest error:error];
+            }
+        });
+    });
+}
+
+- (void) connectWithURLRequest:(NSURLRequest*)URLRequest error:(NSError*)error
+{
+    if (!URLRequest)
+    {
+        [self failWithError:error reconnects:NO];
+        return;
+    }
+    
+    if (!URLSession)
+    {
+        NSOperationQueue* delegateQueue = [NSOperationQueue new];
+        delegateQueue.maxConcurrentOperationCount = 1;
+        delegateQueue.underlyingQueue = connectionQueue;
+        NSURLSessionConfiguration* configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        configuration.timeoutIntervalForRequest = [self.service idleTimeout];
+        configuration.URLCache = nil;
+        URLSession = [NSURLSession sessionWithConfiguration:configuration delegate:self delegateQueue:delegateQueue];
+    }
+    
+    // a new connection starts a new stream: only the last event ID is kept
+    [lineBuffer setLength:0];
+    skipsLineFeed = NO;
+    isFirstLine = YES;
+    [dataBuffer setString:@""];
+    eventTypeBuffer = nil;
+    
+    attempt++;
+    SDLogModuleInfo(kServiceManagerLogModuleName, @"Event stream %@: connecting to %@ (last event ID %@)", NSStringFromClass([self.service class]), URLRequest.URL.absoluteString, lastEventIdentifierBuffer);
+    dataTask = [URLSession dataTaskWithRequest:URLRequest];
+    [dataTask resume];
+}
+
+- (void) failWithError:(NSError*)error reconnects:(BOOL)reconnects
+{
+    [dataTask cancel];
+    dataTask = nil;
+    
+    if (error)
+    {
+        SDLogModuleWarning(kServiceManagerLogModuleName, @"Event stream %@ failed: %@", NSStringFromClass([self.service class]), error.localizedDescription);
+        SDServiceEventStreamErrorHandler errorHandler = self.errorHandler;
+        if (errorHandler)
+        {
+            dispatch_async(self.eventQueue, ^{
+                errorHandler(error, reconnects);
+            });
+        }
+    }
+    
+    if (!reconnects)
+    {
+        [self closeSession];
+        return;
+    }
+    
+    // exponential backoff of consecutive failures
+    self.state = SDServiceEventStreamStateConnecting;
+    NSTimeInterval delay = MIN(reconnectionTime * pow(2., numberOfConsecutiveFailures), MAX([self.service maximumReconnectionTime], reconnectionTime));
+    numberOfConsecutiveFailures++;
+    NSUInteger scheduledAttempt = ++attempt;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), connectionQueue, ^{
+        if (attempt == scheduledAttempt && self.state == SDServiceEventStreamStateConnecting)
+        {
+            self.numberOfReconnections++;
+            [self connect];
+        }
+    });
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void) URLSession:(NSURLSession*)session dataTask:(NSURLSessionDataTask*)task didReceiveResponse:(NSURLResponse*)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    if (task != dataTask)
+    {
+        completionHandler(NSURLSessionResponseCancel);
+        return;
+    }
+    
+    NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse*)response).statusCode : 0;
+    if (statusCode == 200 && [response.MIMEType.lowercaseString isEqualToString:@"text/event-stream"])
+    {
+        self.state = SDServiceEventStreamStateOpen;
+        numberOfConsecutiveFailures = 0;
+        completionHandler(NSURLSessionResponseAllow);
+        return;
+    }
+    
+    completionHandler(NSURLSessionResponseCancel);
+    if (statusCode == 204)
+    {
+        // server asks to stop reconnecting
+        SDLogModuleInfo(kServiceManagerLogModuleName, @"Event stream %@ closed by server", NSStringFromClass([self.service class]));
+        [self failWithError:nil reconnects:NO];
+        return;
+    }
+    NSString* errorString = [NSString stringWithFormat:@"Invalid event stream response: status code %ld, content type %@", (long)statusCode, response.MIMEType];
+    NSError* error = [NSError errorWithDomain:SDServiceEventStreamErrorDomain code:SDServiceEventStreamErrorCodeInvalidResponse userInfo:@{ NSLocalizedDescriptionKey : errorString, SDServiceEventStreamStatusCodeKey : @(statusCode) }];
+    [self failWithError:error reconnects:statusCode >= 500];
+}
+
+- (void) URLSession:(NSURLSession*)session dataTask:(NSURLSessionDataTask*)task didReceiveData:(NSData*)data
+{
+    if (task != dataTask)
+    {
+        return;
+    }
+    [data enumerateByteRangesUsingBlock:^(const void* bytes, NSRange byteRange, BOOL* stop) {
+        [self parseBytes:bytes length:byteRange.length];
+    }];
+}
+
+- (void) URLSession:(NSURLSession*)session task:(NSURLSessionTask*)task didCompleteWithError:(NSError*)error
+{
+    if (task != dataTask || self.state == SDServiceEventStreamStateClosed)
+    {
+        return;
+    }
+    // end of stream from server is not an error, but the stream goes on with a new connection
+    [self failWithError:error reconnects:YES];
+}
+
+#pragma mark - Parser
+
+/**
+ *  Split bytes in lines (terminated by CRLF, LF or CR), keeping the last incomplete line for the next bytes.
+ */
+- (void) parseBytes:(const uint8_t*)bytes length:(NSUInteger)length
+{
+    NSUInteger lineStart = 0;
+    NSUInteger i = 0;
+    if (skipsLineFeed && length > 0)
+    {
+        // CRLF split between two chunks
+        if (bytes[0] == '\n')
+        {
+            i = lineStart = 1;
+        }
+        skipsLineFeed = NO;
+    }
+    
+    for (; i < length; i++)
+    {
+        uint8_t c = bytes[i];
+        if (c != '\r' && c != '\n')
+        {
+            continue;
+        }
+        [lineBuffer appendBytes:bytes + lineStart length:i - lineStart];
+        [self processLine];
+        [lineBuffer setLength:0];
+        if (c == '\r')
+        {
+            if (i + 1 == length)
+            {
+                skipsLineFeed = YES;
+            }
+            else if (bytes[i + 1] == '\n')
+            {
+                i++;
+            }
+        }
+        lineStart = i + 1;
+    }
+    [lineBuffer appendBytes:bytes + lineStart length:length - lineStart];
+}
+
+- (void) processLine
+{
+    const uint8_t* bytes = lineBuffer.bytes;
+    NSUInteger length = lineBuffer.length;
+    if (isFirstLine)
+    {
+        isFirstLine = NO;
+        if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+        {
+            bytes += 3;
+            length -= 3;
+        }
+    }
+    
+    if (length == 0)
+    {
+        [self dispatchEvent];
+        return;
+    }
+    if (bytes[0] == ':')
+    {
+        // comment (ex. heartbeat)
+        return;
+    }
+    
+    NSUInteger fieldLength = length;
+    NSUInteger valueStart = length;
+    const uint8_t* colon = memchr(bytes, ':', length);
+    if (colon)
+    {
+        fieldLength = colon - bytes;
+        valueStart = fieldLength + 1;
+        if (valueStart < length && bytes[valueStart] == ' ')
+        {
+            valueStart++;
+        }
+    }
+    NSString* field = [[NSString alloc] initWithBytes:bytes length:fieldLength encoding:NSUTF8StringEncoding];
+    NSString* value = [[NSString alloc] initWithBytes:bytes + valueStart length:length - valueStart encoding:NSUTF8StringEncoding];
+    if (!field || !value)
+    {
+        SDLogModuleWarning(kServiceManagerLogModuleName, @"Event stream %@: line ignored, invalid UTF-8", NSStringFromClass([self.service class]));
+        return;
+    }
+    
+    if ([field isEqualToString:@"data"])
+    {
+        [dataBuffer appendString:value];
+        [dataBuffer appendString:@"\n"];
+    }
+    else if ([field isEqualToString:@"event"])
+    {
+        eventTypeBuffer = value;
+    }
+    else if ([field isEqualToString:@"id"])
+    {
+        if ([value rangeOfString:@"\0"].location == NSNotFound)
+        {
+            lastEventIdentifierBuffer = value;
+        }
+    }
+    else if ([field isEqualToString:@"retry"])
+    {
+        NSCharacterSet* nonDigits = [[NSCharacterSet decimalDigitCharacterSet] invertedSet];
+        if (value.length > 0 && [value rangeOfCharacterFromSet:nonDigits].location == NSNotFound)
+        {
+            reconnectionTime = value.longLongValue / 1000.;
+        }
+    }
+}
+
+- (void) dispatchEvent
+{
+    self.lastEventIdentifier = lastEventIdentifierBuffer;
+    if (dataBuffer.length == 0)
+    {
+        eventTypeBuffer = nil;
+        return;
+    }
+    
+    SDServiceEvent* event = [SDServiceEvent new];
+    event.type = eventTypeBuffer.length > 0 ? eventTypeBuffer : @"message";
+    event.identifier = lastEventIdentifierBuffer;
+    event.data = [dataBuffer substringToIndex:dataBuffer.length - 1];
+    [dataBuffer setString:@""];
+    eventTypeBuffer = nil;
+    
+    if ([self.service mapsDataOfEventWithType:event.type])
+    {
+        NSError* error = nil;
+        id object = [NSJSONSerialization JSONObjectWithData:[event.data dataUsingEncoding:NSUTF8StringEncoding] options:NSJSONReadingAllowFragments error:&error];
+        if (object)
+        {
+            event.response = [self.service responseForObject:object error:&error];
+        }
+        event.mappingError = error;
+    }
+    
+    self.numberOfEvents++;
+    SDServiceEventHandler eventHandler = self.eventHandler;
+    if (eventHandler)
+    {
+        dispatch_async(self.eventQueue, ^{
+            eventHandler(event);
+        });
+    }
+}
+
+@end
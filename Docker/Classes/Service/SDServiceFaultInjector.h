@@ -0,0 +1,228 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+@class SDServiceGeneric;
+
+typedef NS_ENUM (NSInteger, SDServiceLatencyDistribution)
+{
+    /**
+     *  Uniform value in demoWaitingTimeRange of the service (same of demo mode without fault injection).
+     */
+    SDServiceLatencyDistributionDemoRange = 0,
+    /**
+     *  Always latencyMedian.
+     */
+    SDServiceLatencyDistributionFixed,
+    /**
+     *  Log-normal distribution with median latencyMedian and shape latencySigma.
+     */
+    SDServiceLatencyDistributionLogNormal,
+    /**
+     *  Distribution defined by latencyPercentiles, linearly interpolated between given percentiles.
+     */
+    SDServiceLatencyDistributionPercentiles
+};
+
+typedef NS_ENUM (NSInteger, SDServiceFaultType)
+{
+    SDServiceFaultTypeNone = 0,
+    /**
+     *  Server answers with an error status code (see burst properties of profile).
+     */
+    SDServiceFaultTypeErrorStatusCode,
+    /**
+     *  No answer before timeoutInterval: call fails with NSURLErrorTimedOut.
+     */
+    SDServiceFaultTypeTimeout,
+    /**
+     *  Connection lost while receiving the body: call fails with NSURLErrorNetworkConnectionLost.
+     */
+    SDServiceFaultTypeConnectionDrop
+};
+
+/**
+ *  Configuration of latencies and faults simulated for services in demo mode.
+ */
+@interface SDServiceFaultProfile : NSObject <NSCopying>
+
+/**
+ *  Default: SDServiceLatencyDistributionDemoRange
+ */
+@property (nonatomic, assign) SDServiceLatencyDistribution latencyDistribution;
+
+/**
+ *  Median latency (time to first byte) in seconds, used by fixed and log-normal distributions.
+ *
+ *  Default: 0.2
+ */
+@property (nonatomic, assign) NSTimeInterval latencyMedian;
+
+/**
+ *  Shape of log-normal distribution (standard deviation of the logarithm). Higher values give longer tails: 0.5 gives p99 ~3.2x the median, 1 gives p99 ~10x the median.
+ *
+ *  Default: 0.5
+ */
+@property (nonatomic, assign) double latencySigma;
+
+/**
+ *  Latency for each percentile, used by percentiles distribution. Key: percentile (0-100), value: latency in seconds. Ex. @{ @50 : @0.1, @95 : @0.8, @99 : @2 }
+ *  Latencies below the first percentile and above the last one are clamped.
+ */
+@property (nonatomic, strong) NSDictionary<NSNumber*, NSNumber*>* _Nullable latencyPercentiles;
+
+/**
+ *  Probability (0-1) that a call times out.
+ *
+ *  Default: 0
+ */
+@property (nonatomic, assign) double timeoutChance;
+
+/**
+ *  Time after which a call that times out fails.
+ *
+ *  Default: 60 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval timeoutInterval;
+
+/**
+ *  Probability (0-1) that connection is lost while receiving the body. The point of the body where connection drops is random.
+ *
+ *  Default: 0
+ */
+@property (nonatomic, assign) double connectionDropChance;
+
+/**
+ *  Probability (0-1) that a call starts a burst of errors.
+ *
+ *  Default: 0
+ */
+@property (nonatomic, assign) double burstChance;
+
+/**
+ *  Number of consecutive calls of the same service that fail in a burst (the first included).
+ *
+ *  Default: 1
+ */
+@property (nonatomic, assign) NSUInteger burstLength;
+
+/**
+ *  Status codes returned during a burst. One of them is picked for every burst.
+ *
+ *  Default: @[@503]
+ */
+@property (nonatomic, strong) NSArray<NSNumber*>* _Nonnull burstStatusCodes;
+
+/**
+ *  Value of Retry-After header (in seconds) returned during bursts. 0 means no header.
+ *
+ *  Default: 0
+ */
+@property (nonatomic, assign) NSTimeInterval burstRetryAfter;
+
+/**
+ *  Bandwidth in bytes per second used to deliver the body after latency. 0 means unlimited.
+ *
+ *  Default: 0
+ */
+@property (nonatomic, assign) double bandwidth;
+
+@end
+
+
+/**
+ *  Result of a simulated call.
+ */
+@interface SDServiceFaultOutcome : NSObject
+
+@property (nonatomic, assign) SDServiceFaultType faultType;
+
+/**
+ *  Time (in seconds) from start of the call to the end of the call (success or failure).
+ */
+@property (nonatomic, assign) NSTimeInterval duration;
+
+/**
+ *  Time (in seconds) from start of the call to the first byte of the body.
+ */
+@property (nonatomic, assign) NSTimeInterval latency;
+
+/**
+ *  Bytes of the body delivered before the end of the call.
+ */
+@property (nonatomic, assign) unsigned long long deliveredLength;
+
+/**
+ *  Status code for SDServiceFaultTypeErrorStatusCode.
+ */
+@property (nonatomic, assign) NSInteger statusCode;
+
+/**
+ *  Headers of the response for SDServiceFaultTypeErrorStatusCode (ex. Retry-After).
+ */
+@property (nonatomic, strong) NSDictionary<NSString*, NSString*>* _Nullable headers;
+
+@end
+
+
+/**
+ *  Decides latency and faults of services called in demo mode, following a SDServiceFaultProfile.
+ *
+ *  All random values come from a generator initialized with seed, so the same sequence of calls always gets the same sequence of outcomes.
+ *  Not thread safe: SDServiceManager uses it from main thread.
+ */
+@interface SDServiceFaultInjector : NSObject
+
+- (instancetype _Nonnull) initWithSeed:(uint64_t)seed;
+
+@property (nonatomic, readonly) uint64_t seed;
+
+/**
+ *  Profile used by services without a specific profile.
+ *
+ *  Default: nil (services without a profile use the plain demo mode)
+ */
+@property (nonatomic, strong) SDServiceFaultProfile* _Nullable globalProfile;
+
+/**
+ *  Set the profile for all services of the given class. It has precedence on globalProfile, while demoModeFaultProfile of the service has precedence on it.
+ */
+- (void) setProfile:(SDServiceFaultProfile* _Nullable)profile forServiceClass:(Class _Nonnull)serviceClass;
+
+/**
+ *  Profile used for the service: demoModeFaultProfile of the service, then profile for its class, then globalProfile.
+ */
+- (SDServiceFaultProfile* _Nullable) profileForService:(SDServiceGeneric* _Nonnull)service;
+
+/**
+ *  Decide outcome of next call of the service.
+ *
+ *  @param service        service to call
+ *  @param profile        profile to use
+ *  @param responseLength length in bytes of the body that would be returned
+ */
+- (SDServiceFaultOutcome* _Nonnull) nextOutcomeForService:(SDServiceGeneric* _Nonnull)service profile:(SDServiceFaultProfile* _Nonnull)profile responseLength:(unsigned long long)responseLength;
+
+/**
+ *  Next random value in [0, 1) from the seeded generator.
+ */
+- (double) nextRandom;
+
+/**
+ *  Restart the generator from seed and clear running bursts, to repeat the same sequence of outcomes.
+ */
+- (void) reset;
+
+@end
@@ -0,0 +1,316 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceFaultInjector.h"
+#import "SDServiceGeneric.h"
+
+#define DEFAULT_FAULT_LATENCY_MEDIAN           0.2
+#define DEFAULT_FAULT_LATENCY_SIGMA            0.5
+#define DEFAULT_FAULT_TIMEOUT_INTERVAL         60
+
+@implementation SDServiceFaultProfile
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        self.latencyDistribution = SDServiceLatencyDistributionDemoRange;
+        self.latencyMedian = DEFAULT_FAULT_LATENCY_MEDIAN;
+        self.latencySigma = DEFAULT_FAULT_LATENCY_SIGMA;
+        self.timeoutInterval = DEFAULT_FAULT_TIMEOUT_INTERVAL;
+        self.burstLength = 1;
+        self.burstStatusCodes = @[@503];
+    }
+    return self;
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    SDServiceFaultProfile* profile = [[[self class] allocWithZone:zone] init];
+    profile.latencyDistribution = self.latencyDistribution;
+    profile.latencyMedian = self.latencyMedian;
+    profile.latencySigma = self.latencySigma;
+    profile.latencyPercentiles = self.latencyPercentiles;
+    profile.timeoutChance = self.timeoutChance;
+    profile.timeoutInterval = self.timeoutInterval;
+    profile.connectionDropChance = self.connectionDropChance;
+    profile.burstChance = self.burstChance;
+    profile.burstLength = self.burstLength;
+    profile.burstStatusCodes = self.burstStatusCodes;
+    profile.burstRetryAfter = self.burstRetryAfter;
+    profile.bandwidth = self.bandwidth;
+    return profile;
+}
+
+@end
+
+
+
+@implementation SDServiceFaultOutcome
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: fault %d, status %d, latency %.0f ms, duration %.0f ms, delivered %llu bytes>", NSStringFromClass([self class]), (int)self.faultType, (int)self.statusCode, self.latency * 1000., self.duration * 1000., self.deliveredLength];
+}
+
+@end
+
+
+
+/**
+ *  Burst of errors running for a service class.
+ */
+@interface SDServiceFaultBurst : NSObject
+
+@property (nonatomic, assign) NSUInteger remainingCalls;
+@property (nonatomic, assign) NSInteger statusCode;
+
+@end
+
+@implementation SDServiceFaultBurst
+
+@end
+
+
+
+@interface SDServiceFaultInjector ()
+{
+    // state of xorshift128+ generator
+    uint64_t randomState[2];
+}
+
+@property (nonatomic, readwrite) uint64_t seed;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDServiceFaultProfile*>* profilesByServiceClass;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDServiceFaultBurst*>* burstsByServiceClass;
+
+@end
+
+@implementation SDServiceFaultInjector
+
+- (instancetype) init
+{
+    return [self initWithSeed:0];
+}
+
+- (instancetype) initWithSeed:(uint64_t)seed
+{
+    self = [super init];
+    if (self)
+    {
+        self.seed = seed;
+        self.profilesByServiceClass = [NSMutableDictionary new];
+        self.burstsByServiceClass = [NSMutableDictionary new];
+        [self reset];
+    }
+    return self;
+}
+
+- (void) reset
+{
+    // splitmix64 expands the seed in the state of the generator (state can't be all zeros)
+    uint64_t z = self.seed;
+    for (int i = 0; i < 2; i++)
+    {
+        z += 0x9E3779B97F4A7C15ULL;
+        uint64_t x = z;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        randomState[i] = x ^ (x >> 31);
+    }
+    [self.burstsByServiceClass removeAllObjects];
+}
+
+#pragma mark - Random
+
+- (double) nextRandom
+{
+    uint64_t s1 = randomState[0];
+    const uint64_t s0 = randomState[1];
+    randomState[0] = s0;
+    s1 ^= s1 << 23;
+    randomState[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+    uint64_t value = randomState[1] + s0;
+    
+    // 53 bits of mantissa
+    return (value >> 11) * (1.0 / 9007199254740992.0);
+}
+
+- (double) nextGaussian
+{
+    // Box-Muller transform
+    double u1 = 1. - [self nextRandom];
+    double u2 = [self nextRandom];
+    return sqrt(-2. * log(u1)) * cos(2. * M_PI * u2);
+}
+
+- (BOOL) nextEventWithChance:(double)chance
+{
+    return chance > 0 && [self nextRandom] < chance;
+}
+
+#pragma mark - Profiles
+
+- (void) setProfile:(SDServiceFaultProfile*)profile forServiceClass:(Class)serviceClass
+{
+    [self.profilesByServiceClass setValue:profile forKey:NSStringFromClass(serviceClass)];
+}
+
+- (SDServiceFaultProfile*) profileForService:(SDServiceGeneric*)service
+{
+    if ([service respondsToSelector:@selector(demoModeFaultProfile)])
+    {
+        SDServiceFaultProfile* profile = [service demoModeFaultProfile];
+        if (profile)
+        {
+            return profile;
+        }
+    }
+    
+    SDServiceFaultProfile* profile = self.profilesByServiceClass[NSStringFromClass([service class])];
+    return profile ? : self.globalProfile;
+}
+
+#pragma mark - Outcome
+
+- (SDServiceFaultOutcome*) nextOutcomeForService:(SDServiceGeneric*)service profile:(SDServiceFaultProfile*)profile responseLength:(unsigned long long)responseLength
+{
+    SDServiceFaultOutcome* outcome = [SDServiceFaultOutcome new];
+    
+    // timeout doesn't depend by latency
+    if ([self nextEventWithChance:profile.timeoutChance])
+    {
+        outcome.faultType = SDServiceFaultTypeTimeout;
+        outcome.latency = profile.timeoutInterval;
+        outcome.duration = profile.timeoutInterval;
+        return outcome;
+    }
+    
+    outcome.latency = [self nextLatencyForService:service profile:profile];
+    
+    NSInteger burstStatusCode = [self nextBurstStatusCodeForService:service profile:profile];
+    if (burstStatusCode > 0)
+    {
+        // error bodies are small: bandwidth is ignored
+        outcome.faultType = SDServiceFaultTypeErrorStatusCode;
+        outcome.statusCode = burstStatusCode;
+        outcome.duration = outcome.latency;
+        if (profile.burstRetryAfter > 0)
+        {
+            outcome.headers = @{ @"Retry-After" : [NSString stringWithFormat:@"%.0f", ceil(profile.burstRetryAfter)] };
+        }
+        return outcome;
+    }
+    
+    NSTimeInterval transferTime = profile.bandwidth > 0 ? responseLength / profile.bandwidth : 0;
+    
+    if ([self nextEventWithChance:profile.connectionDropChance])
+    {
+        double droppedAt = [self nextRandom];
+        outcome.faultType = SDServiceFaultTypeConnectionDrop;
+        outcome.deliveredLength = (unsigned long long)(responseLength * droppedAt);
+        outcome.duration = outcome.latency + transferTime * droppedAt;
+        return outcome;
+    }
+    
+    outcome.faultType = SDServiceFaultTypeNone;
+    outcome.statusCode = 200;
+    outcome.deliveredLength = responseLength;
+    outcome.duration = outcome.latency + transferTime;
+    
+    // a call that lasts more than timeout fails anyway
+    if (profile.timeoutInterval > 0 && outcome.duration > profile.timeoutInterval)
+    {
+        outcome.faultType = SDServiceFaultTypeTimeout;
+        outcome.duration = profile.timeoutInterval;
+        outcome.deliveredLength = profile.bandwidth > 0 ? (unsigned long long)(MAX(profile.timeoutInterval - outcome.latency, 0) * profile.bandwidth) : 0;
+    }
+    return outcome;
+}
+
+- (NSTimeInterval) nextLatencyForService:(SDServiceGeneric*)service profile:(SDServiceFaultProfile*)profile
+{
+    switch (profile.latencyDistribution)
+    {
+        case SDServiceLatencyDistributionDemoRange: {
+            if (![service respondsToSelector:@selector(demoWaitingTimeRange)])
+            {
+                return 0;
+            }
+            NSRange range = [service demoWaitingTimeRange];
+            return range.location + [self nextRandom] * range.length;
+        }
+        case SDServiceLatencyDistributionFixed:
+            return profile.latencyMedian;
+        case SDServiceLatencyDistributionLogNormal:
+            return profile.latencyMedian * exp(profile.latencySigma * [self nextGaussian]);
+        case SDServiceLatencyDistributionPercentiles:
+            return [self latencyAtPercentile:[self nextRandom] * 100. inPercentiles:profile.latencyPercentiles];
+    }
+    return 0;
+}
+
+- (NSTimeInterval) latencyAtPercentile:(double)percentile inPercentiles:(NSDictionary<NSNumber*, NSNumber*>*)percentiles
+{
+    NSArray<NSNumber*>* sortedPercentiles = [percentiles.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    if (sortedPercentiles.count == 0)
+    {
+        return 0;
+    }
+    
+    NSNumber* lower = sortedPercentiles.firstObject;
+    if (percentile <= lower.doubleValue)
+    {
+        return percentiles[lower].doubleValue;
+    }
+    for (NSNumber* upper in sortedPercentiles)
+    {
+        if (percentile <= upper.doubleValue)
+        {
+            double fraction = (percentile - lower.doubleValue) / (upper.doubleValue - lower.doubleValue);
+            return percentiles[lower].doubleValue + fraction * (percentiles[upper].doubleValue - percentiles[lower].doubleValue);
+        }
+        lower = upper;
+    }
+    return percentiles[sortedPercentiles.lastObject].doubleValue;
+}
+
+- (NSInteger) nextBurstStatusCodeForService:(SDServiceGeneric*)service profile:(SDServiceFaultProfile*)profile
+{
+    NSString* serviceKey = NSStringFromClass([service class]);
+    SDServiceFaultBurst* burst = self.burstsByServiceClass[serviceKey];
+    
+    if (!burst && profile.burstStatusCodes.count > 0 && [self nextEventWithChance:profile.burstChance])
+    {
+        burst = [SDServiceFaultBurst new];
+        burst.remainingCalls = MAX(profile.burstLength, 1);
+        NSUInteger index = MIN((NSUInteger)([self nextRandom] * profile.burstStatusCodes.count), profile.burstStatusCodes.count - 1);
+        burst.statusCode = profile.burstStatusCodes[index].integerValue;
+        self.burstsByServiceClass[serviceKey] = burst;
+    }
+    
+    if (!burst)
+    {
+        return 0;
+    }
+    
+    burst.remainingCalls--;
+    if (burst.remainingCalls == 0)
+    {
+        [self.burstsByServiceClass removeObjectForKey:serviceKey];
+    }
+    return burst.statusCode;
+}
+
+@end
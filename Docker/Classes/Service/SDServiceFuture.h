@@ -0,0 +1,154 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import "SDServiceGeneric.h"
+
+@class SDServiceCallInfo;
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceFutureErrorDomain;
+
+typedef NS_ENUM (NSInteger, SDServiceFutureErrorCode)
+{
+    /**
+     *  Future cancelled, or waiting for a cancelled future.
+     */
+    SDServiceFutureErrorCodeCancelled = -1,
+    /**
+     *  Service call failed with an error object without error.
+     */
+    SDServiceFutureErrorCodeServiceFailure = -2,
+};
+
+typedef NS_ENUM (NSInteger, SDServiceFutureState)
+{
+    SDServiceFutureStatePending = 0,
+    SDServiceFutureStateFulfilled,
+    SDServiceFutureStateRejected,
+    SDServiceFutureStateCancelled
+};
+
+/**
+ *  Block chained to a future: receives the value of the fulfilled future and returns
+ *  another SDServiceFuture to wait for (ex. a dependent call), a NSError to reject the chain, or the value of the chain.
+ */
+typedef id _Nullable (^ SDServiceFutureThenBlock)(id _Nullable value);
+
+/**
+ *  Block that recovers a rejected future: returns an SDServiceFuture, a NSError or a value as SDServiceFutureThenBlock.
+ */
+typedef id _Nullable (^ SDServiceFutureCatchBlock)(NSError* _Nonnull error, id<SDServiceGenericErrorProtocol> _Nullable serviceError);
+
+/**
+ *  Result of a service call (see futureByCallingService:withRequest: of SDServiceManager), or of a chain or combination of calls, available later.
+ *
+ *  A future is settled once: fulfilled with a value, rejected with an error or cancelled. Blocks are called on callbackQueue as soon as the future is settled,
+ *  so a dependent call starts as soon as its inputs are available. Derived futures (then:, all:, ...) inherit callbackQueue.
+ *
+ *  Cancelling a future cancels its call and the futures it waits for, unless other futures still wait for them: cancelling the last future of a chain cancels the whole chain.
+ *  Changing priority changes priority of the call and of the futures it waits for.
+ *
+ *  All methods are thread safe.
+ */
+@interface SDServiceFuture : NSObject
+
++ (instancetype _Nonnull) futureWithValue:(id _Nullable)value;
++ (instancetype _Nonnull) futureWithError:(NSError* _Nonnull)error;
+
+/**
+ *  Pending future, to settle with fulfillWithValue: or rejectWithError: (ex. to wrap other asynchronous work).
+ */
++ (instancetype _Nonnull) pendingFuture;
+
+/**
+ *  Pending future of a call (used by SDServiceManager): cancellationBlock is called when the future is cancelled while pending.
+ */
+- (instancetype _Nonnull) initWithServiceCallInfo:(SDServiceCallInfo* _Nullable)serviceCallInfo cancellationBlock:(dispatch_block_t _Nullable)cancellationBlock;
+
+@property (atomic, readonly) SDServiceFutureState state;
+@property (atomic, readonly) BOOL isPending;
+
+/**
+ *  Value of fulfilled future (response of the call).
+ */
+@property (atomic, strong, readonly) id _Nullable value;
+
+/**
+ *  Error of rejected or cancelled future.
+ */
+@property (atomic, strong, readonly) NSError* _Nullable error;
+
+/**
+ *  Error object of the failed call, if the future has been rejected by a service.
+ */
+@property (atomic, strong, readonly) id<SDServiceGenericErrorProtocol> _Nullable serviceError;
+
+/**
+ *  Queue of blocks of the future. Default: main queue
+ */
+@property (atomic, strong) dispatch_queue_t _Nonnull callbackQueue;
+
+/**
+ *  Priority of the call of the future and of the futures it waits for. Default: priority of the call, or SDServiceCallPriorityNormal
+ */
+@property (atomic, assign) SDServiceCallPriority priority;
+
+/**
+ *  Call of the future (nil if the future is not created by SDServiceManager). The call retains the future, not the opposite.
+ */
+@property (atomic, weak, readonly) SDServiceCallInfo* _Nullable serviceCallInfo;
+
+- (void) fulfillWithValue:(id _Nullable)value;
+- (void) rejectWithError:(NSError* _Nonnull)error;
+- (void) rejectWithError:(NSError* _Nonnull)error serviceError:(id<SDServiceGenericErrorProtocol> _Nullable)serviceError;
+
+/**
+ *  Cancel the future, its call and the futures it waits for that nothing else waits for.
+ */
+- (void) cancel;
+
+/**
+ *  Future of the result of block, called with the value of this future once fulfilled. If this future fails, the returned one fails the same way.
+ */
+- (SDServiceFuture* _Nonnull) then:(SDServiceFutureThenBlock _Nonnull)block;
+- (SDServiceFuture* _Nonnull) then:(SDServiceFutureThenBlock _Nonnull)block onQueue:(dispatch_queue_t _Nonnull)queue;
+
+/**
+ *  Future of the result of block, called with the error of this future once rejected (not if cancelled). If this future succeeds, the returned one has the same value.
+ */
+- (SDServiceFuture* _Nonnull) catchError:(SDServiceFutureCatchBlock _Nonnull)block;
+
+/**
+ *  Observe the result without deriving a future. Return self, to chain them.
+ */
+- (instancetype _Nonnull) onSuccess:(void (^ _Nonnull)(id _Nullable value))block;
+- (instancetype _Nonnull) onFailure:(void (^ _Nonnull)(NSError* _Nonnull error, id<SDServiceGenericErrorProtocol> _Nullable serviceError))block;
+
+/**
+ *  Fulfilled with values of all futures, in the same order (NSNull for nil values), when all are fulfilled.
+ *  Fails as soon as one fails, cancelling the others.
+ */
++ (SDServiceFuture* _Nonnull) all:(NSArray<SDServiceFuture*>* _Nonnull)futures;
+
+/**
+ *  Fulfilled with the value of the first fulfilled future, cancelling the others. Fails as the last one if all fail.
+ */
++ (SDServiceFuture* _Nonnull) any:(NSArray<SDServiceFuture*>* _Nonnull)futures;
+
+/**
+ *  Settled as the first settled future, fulfilled or failed, cancelling the others.
+ */
++ (SDServiceFuture* _Nonnull) race:(NSArray<SDServiceFuture*>* _Nonnull)futures;
+
+@end
@@ -0,0 +1,488 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceFuture.h"
+#import "SDServiceManager.h"
+
+NSString* const SDServiceFutureErrorDomain = @"FUTURE";
+
+@interface SDServiceFuture ()
+
+@property (atomic, readwrite) SDServiceFutureState state;
+@property (atomic, strong, readwrite) id value;
+@property (atomic, strong, readwrite) NSError* error;
+@property (atomic, strong, readwrite) id<SDServiceGenericErrorProtocol> serviceError;
+@property (atomic, weak, readwrite) SDServiceCallInfo* serviceCallInfo;
+
+/**
+ *  Called when the future is settled (nil once settled).
+ */
+@property (nonatomic, strong) NSMutableArray<dispatch_block_t>* callbacks;
+@property (nonatomic, copy) dispatch_block_t cancellationBlock;
+
+/**
+ *  Futures this one waits for, and number of pending futures waiting for this one.
+ */
+@property (nonatomic, strong) NSArray<SDServiceFuture*>* dependencies;
+@property (nonatomic, assign) NSUInteger numberOfDependents;
+
+@end
+
+@implementation SDServiceFuture
+
+@synthesize priority = _priority;
+
+- (instancetype) init
+{
+    return [self initWithServiceCallInfo:nil cancellationBlock:nil];
+}
+
+- (instancetype) initWithServiceCallInfo:(SDServiceCallInfo*)serviceCallInfo cancellationBlock:(dispatch_block_t)cancellationBlock
+{
+    self = [super init];
+    if (self)
+    {
+        _state = SDServiceFutureStatePending;
+        _callbackQueue = dispatch_get_main_queue();
+        _priority = serviceCallInfo ? serviceCallInfo.priority : SDServiceCallPriorityNormal;
+        _serviceCallInfo = serviceCallInfo;
+        _cancellationBlock = [cancellationBlock copy];
+        _callbacks = [NSMutableArray array];
+    }
+    return self;
+}
+
++ (instancetype) pendingFuture
+{
+    return [self new];
+}
+
++ (instancetype) futureWithValue:(id)value
+{
+    SDServiceFuture* future = [self new];
+    [future fulfillWithValue:value];
+    return future;
+}
+
++ (instancetype) futureWithError:(NSError*)error
+{
+    SDServiceFuture* future = [self new];
+    [future rejectWithError:error];
+    return future;
+}
+
++ (NSError*) cancellationError
+{
+    return [NSError errorWithDomain:SDServiceFutureErrorDomain code:SDServiceFutureErrorCodeCancelled userInfo:@{ NSLocalizedDescriptionKey : @"Future cancelled" }];
+}
+
+- (BOOL) isPending
+{
+    return self.state == SDServiceFutureStatePending;
+}
+
+#pragma mark - Settle
+
+- (BOOL) settleWithState:(SDServiceFutureState)state value:(id)value error:(NSError*)error serviceError:(id<SDServiceGenericErrorProtocol>)serviceError
+{
+    NSArray<dispatch_block_t>* callbacks = nil;
+    @synchronized (self)
+    {
+        if (self.state != SDServiceFutureStatePending)
+        {
+            return NO;
+        }
+        self.value = value;
+        self.error = error;
+        self.serviceError = serviceError;
+        self.state = state;
+        callbacks = self.callbacks;
+        self.callbacks = nil;
+        self.cancellationBlock = nil;
+        self.dependencies = nil;
+    }
+    for (dispatch_block_t callback in callbacks)
+    {
+        callback();
+    }
+    return YES;
+}
+
+/**
+ *  Settle this future as future, already settled.
+ */
+- (BOOL) settleLikeFuture:(SDServiceFuture*)future
+{
+    if (!future || future.isPending)
+    {
+        return NO;
+    }
+    return [self settleWithState:future.state value:future.value error:future.error serviceError:future.serviceError];
+}
+
+- (void) fulfillWithValue:(id)value
+{
+    [self settleWithState:SDServiceFutureStateFulfilled value:value error:nil serviceError:nil];
+}
+
+- (void) rejectWithError:(NSError*)error
+{
+    [self rejectWithError:error serviceError:nil];
+}
+
+- (void) rejectWithError:(NSError*)error serviceError:(id<SDServiceGenericErrorProtocol>)serviceError
+{
+    [self settleWithState:SDServiceFutureStateRejected value:nil error:error serviceError:serviceError];
+}
+
+/**
+ *  Settle with the result of a then or catch block.
+ */
+- (void) resolveWithResult:(id)result
+{
+    if ([result isKindOfClass:[SDServiceFuture class]])
+    {
+        [self waitForFutures:@[result]];
+        if (self.priority != SDServiceCallPriorityNormal)
+        {
+            [(SDServiceFuture*)result setPriority:self.priority];
+        }
+        __weak SDServiceFuture* weakResult = result;
+        [result addCallback:^{
+            [self settleLikeFuture:weakResult];
+        }];
+    }
+    else if ([result isKindOfClass:[NSError class]])
+    {
+        [self rejectWithError:result];
+    }
+    else
+    {
+        [self fulfillWithValue:result];
+    }
+}
+
+/**
+ *  Call callback when the future is settled, immediately if it is already settled. Callback runs on the thread that settles the future.
+ */
+- (void) addCallback:(dispatch_block_t)callback
+{
+    @synchronized (self)
+    {
+        if (self.state == SDServiceFutureStatePending)
+        {
+            [self.callbacks addObject:callback];
+            return;
+        }
+    }
+    callback();
+}
+
+#pragma mark - Dependencies
+
+- (void) waitForFutures:(NSArray<SDServiceFuture*>*)futures
+{
+    @synchronized (self)
+    {
+        self.dependencies = self.dependencies ? [self.dependencies arrayByAddingObjectsFromArray:futures] : futures;
+    }
+    for (SDServiceFuture* future in futures)
+    {
+        @synchronized (future)
+        {
+            future.numberOfDependents++;
+        }
+    }
+}
+
+/**
+ *  Future derived from futures, with their callback queue.
+ */
++ (instancetype) futureWaitingForFutures:(NSArray<SDServiceFuture*>*)futures
+{
+    SDServiceFuture* future = [self new];
+    future.callbackQueue = futures.firstObject.callbackQueue ?: dispatch_get_main_queue();
+    [future waitForFutures:futures];
+    return future;
+}
+
+/**
+ *  A future waiting for this one doesn't need it anymore: cancel it if nothing else waits for it.
+ */
+- (void) releaseDependent
+{
+    BOOL shouldCancel = NO;
+    @synchronized (self)
+    {
+        if (self.numberOfDependents > 0)
+        {
+            self.numberOfDependents--;
+        }
+        shouldCancel = self.numberOfDependents == 0;
+    }
+    if (shouldCancel)
+    {
+        [self cancel];
+    }
+}
+
+- (void) cancel
+{
+    dispatch_block_t cancellationBlock = nil;
+    NSArray<SDServiceFuture*>* dependencies = nil;
+    @synchronized (self)
+    {
+        cancellationBlock = self.cancellationBlock;
+        dependencies = self.dependencies;
+    }
+    if (![self settleWithState:SDServiceFutureStateCancelled value:nil error:[SDServiceFuture cancellationError] serviceError:nil])
+    {
+        return;
+    }
+    if (cancellationBlock)
+    {
+        cancellationBlock();
+    }
+    for (SDServiceFuture* dependency in dependencies)
+    {
+        [dependency releaseDependent];
+    }
+}
+
+- (SDServiceCallPriority) priority
+{
+    @synchronized (self)
+    {
+        return _priority;
+    }
+}
+
+- (void) setPriority:(SDServiceCallPriority)priority
+{
+    NSArray<SDServiceFuture*>* dependencies = nil;
+    @synchronized (self)
+    {
+        _priority = priority;
+        dependencies = self.dependencies;
+    }
+    // calls are managed on main thread
+    SDServiceCallInfo* serviceCallInfo = self.serviceCallInfo;
+    if (serviceCallInfo)
+    {
+        if ([NSThread isMainThread])
+        {
+            serviceCallInfo.priority = priority;
+        }
+        else
+        {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                serviceCallInfo.priority = priority;
+            });
+        }
+    }
+    for (SDServiceFuture* dependency in dependencies)
+    {
+        dependency.priority = priority;
+    }
+}
+
+#pragma mark - Chaining
+
+- (SDServiceFuture*) then:(SDServiceFutureThenBlock)block
+{
+    return [self then:block onQueue:self.callbackQueue];
+}
+
+- (SDServiceFuture*) then:(SDServiceFutureThenBlock)block onQueue:(dispatch_queue_t)queue
+{
+    SDServiceFuture* future = [SDServiceFuture futureWaitingForFutures:@[self]];
+    future.callbackQueue = queue;
+    __weak typeof (self) weakself = self;
+    [self addCallback:^{
+        SDServiceFuture* strongself = weakself;
+        if (strongself.state != SDServiceFutureStateFulfilled)
+        {
+            [future settleLikeFuture:strongself];
+            return;
+        }
+        id value = strongself.value;
+        dispatch_async(queue, ^{
+            if (future.isPending)
+            {
+                [future resolveWithResult:block(value)];
+            }
+        });
+    }];
+    return future;
+}
+
+- (SDServiceFuture*) catchError:(SDServiceFutureCatchBlock)block
+{
+    SDServiceFuture* future = [SDServiceFuture futureWaitingForFutures:@[self]];
+    __weak typeof (self) weakself = self;
+    [self addCallback:^{
+        SDServiceFuture* strongself = weakself;
+        if (strongself.state != SDServiceFutureStateRejected)
+        {
+            [future settleLikeFuture:strongself];
+            return;
+        }
+        NSError* error = strongself.error;
+        id<SDServiceGenericErrorProtocol> serviceError = strongself.serviceError;
+        dispatch_async(future.callbackQueue, ^{
+            if (future.isPending)
+            {
+                [future resolveWithResult:block(error, serviceError)];
+            }
+        });
+    }];
+    return future;
+}
+
+- (instancetype) onSuccess:(void (^)(id))block
+{
+    __weak typeof (self) weakself = self;
+    [self addCallback:^{
+        SDServiceFuture* strongself = weakself;
+        if (strongself.state == SDServiceFutureStateFulfilled)
+        {
+            id value = strongself.value;
+            dispatch_async(strongself.callbackQueue, ^{
+                block(value);
+            });
+        }
+    }];
+    return self;
+}
+
+- (instancetype) onFailure:(void (^)(NSError*, id<SDServiceGenericErrorProtocol>))block
+{
+    __weak typeof (self) weakself = self;
+    [self addCallback:^{
+        SDServiceFuture* strongself = weakself;
+        if (strongself.state == SDServiceFutureStateRejected || strongself.state == SDServiceFutureStateCancelled)
+        {
+            NSError* error = strongself.error;
+            id<SDServiceGenericErrorProtocol> serviceError = strongself.serviceError;
+            dispatch_async(strongself.callbackQueue, ^{
+                block(error, serviceError);
+            });
+        }
+    }];
+    return self;
+}
+
+#pragma mark - Combinators
+
+/**
+ *  Future settled by the callbacks of futures: once it is settled, futures still pending are not needed anymore.
+ */
++ (SDServiceFuture*) combinationOfFutures:(NSArray<SDServiceFuture*>*)futures callback:(void (^)(SDServiceFuture* combination, SDServiceFuture* future, NSUInteger index))callback
+{
+    SDServiceFuture* combination = [SDServiceFuture futureWaitingForFutures:futures];
+    __weak SDServiceFuture* weakCombination = combination;
+    [futures enumerateObjectsUsingBlock:^(SDServiceFuture* future, NSUInteger index, BOOL* stop) {
+        __weak SDServiceFuture* weakFuture = future;
+        [future addCallback:^{
+            SDServiceFuture* strongCombination = weakCombination;
+            if (!strongCombination.isPending)
+            {
+                return;
+            }
+            callback(strongCombination, weakFuture, index);
+            if (!strongCombination.isPending)
+            {
+                for (SDServiceFuture* otherFuture in futures)
+                {
+                    if (otherFuture.isPending)
+                    {
+                        [otherFuture releaseDependent];
+                    }
+                }
+            }
+        }];
+    }];
+    return combination;
+}
+
++ (SDServiceFuture*) all:(NSArray<SDServiceFuture*>*)futures
+{
+    if (futures.count == 0)
+    {
+        return [SDServiceFuture futureWithValue:@[]];
+    }
+    
+    NSMutableArray* values = [NSMutableArray arrayWithCapacity:futures.count];
+    for (NSUInteger i = 0; i < futures.count; i++)
+    {
+        [values addObject:[NSNull null]];
+    }
+    __block NSUInteger numberOfPendingFutures = futures.count;
+    return [self combinationOfFutures:futures callback:^(SDServiceFuture* combination, SDServiceFuture* future, NSUInteger index) {
+        if (future.state != SDServiceFutureStateFulfilled)
+        {
+            [combination settleLikeFuture:future];
+            return;
+        }
+        NSArray* result = nil;
+        @synchronized (values)
+        {
+            values[index] = future.value ?: [NSNull null];
+            if (--numberOfPendingFutures == 0)
+            {
+                result = [values copy];
+            }
+        }
+        if (result)
+        {
+            [combination fulfillWithValue:result];
+        }
+    }];
+}
+
++ (SDServiceFuture*) any:(NSArray<SDServiceFuture*>*)futures
+{
+    if (futures.count == 0)
+    {
+        return [SDServiceFuture futureWithError:[SDServiceFuture cancellationError]];
+    }
+    
+    __block NSUInteger numberOfPendingFutures = futures.count;
+    NSObject* lock = [NSObject new];
+    return [self combinationOfFutures:futures callback:^(SDServiceFuture* combination, SDServiceFuture* future, NSUInteger index) {
+        if (future.state == SDServiceFutureStateFulfilled)
+        {
+            [combination settleLikeFuture:future];
+            return;
+        }
+        BOOL allFailed = NO;
+        @synchronized (lock)
+        {
+            allFailed = --numberOfPendingFutures == 0;
+        }
+        if (allFailed)
+        {
+            [combination settleLikeFuture:future];
+        }
+    }];
+}
+
++ (SDServiceFuture*) race:(NSArray<SDServiceFuture*>*)futures
+{
+    return [self combinationOfFutures:futures callback:^(SDServiceFuture* combination, SDServiceFuture* future, NSUInteger index) {
+        [combination settleLikeFuture:future];
+    }];
+}
+
+@end
@@ -15,6 +15,10 @@
 #import <Foundation/Foundation.h>
 @import AFNetworking;
 
+@class SDServiceFaultProfile;
+@class SDServiceHedgingPolicy;
+@class SDServicePartialResultsCollector;
+
 /**
  *  HTTP methots supported by SDServiceManager.
  */
@@ -46,6 +50,21 @@ typedef NS_ENUM (NSUInteger, SDHTTPMethod)
     SDHTTPMethodPATCH
 };
 
+/**
+ *  HTTP method name (ex. "GET") for the given SDHTTPMethod.
+ */
+FOUNDATION_EXPORT NSString* _Nonnull NSStringFromSDHTTPMethod(SDHTTPMethod method);
+
+/**
+ *  Priority of a service call, used when calls have to wait (ex. rate limiting).
+ */
+typedef NS_ENUM (NSInteger, SDServiceCallPriority)
+{
+    SDServiceCallPriorityLow = -1,
+    SDServiceCallPriorityNormal = 0,
+    SDServiceCallPriorityHigh = 1
+};
+
 @interface MultipartBodyInfo : NSObject
 
 @property (nonatomic, strong) NSData* _Nullable data;
@@ -210,6 +229,70 @@ typedef NS_ENUM (NSUInteger, SDHTTPMethod)
 - (Class _Nullable) errorClass;
 
 @optional
+/**
+ *  Body of the request already encoded, for HTTP methods that send parameters in body when requestSerializer is a AFJSONRequestSerializer.
+ *  When it returns data, parametersForRequest:error: is not called for those methods. Return nil (without error) to use parametersForRequest:error:.
+ *  Not called when SDServiceManager has a codec for bodyContentType: parameters are encoded by the codec.
+ *
+ *  @param request    request.
+ *  @param error      possible error encoding (passed by reference).
+ *
+ *  @return JSON body of the request, or nil.
+ */
+- (NSData* _Nullable) bodyForRequest:(id<SDServiceGenericRequestProtocol> _Nullable)request error:(NSError*_Nullable* _Nullable)error;
+
+/**
+ *  Parameters always sent in the query string of the URL, whatever the HTTP method (ex. sparse fieldset of SDServiceMantle).
+ *
+ *  @param request    request.
+ *
+ *  @return query parameters (string values), or nil.
+ */
+- (NSDictionary<NSString*, NSString*>* _Nullable) queryParametersForRequest:(id<SDServiceGenericRequestProtocol> _Nullable)request;
+
+/**
+ *  Headers added to every request of the service. additionalRequestHeaders of the request win over them.
+ *
+ *  @param request    request.
+ *
+ *  @return headers, or nil.
+ */
+- (NSDictionary<NSString*, NSString*>* _Nullable) requestHeadersForRequest:(id<SDServiceGenericRequestProtocol> _Nullable)request;
+
+/**
+ *  If YES the response serializer of the service only validates responses, without building JSON objects: responses are mapped by responseForData:error: instead of responseForObject:error:.
+ *  Responses of demo and replay mode are still mapped by responseForObject:error:. Default is NO.
+ *
+ *  @return YES to map responses from their data.
+ */
+- (BOOL) decodesResponseFromData;
+
+/**
+ *  Return the service response starting from the data of the response. Used when decodesResponseFromData is YES.
+ *
+ *  @param data       body of the response.
+ *  @param error      possible error mapping (passed by reference).
+ *
+ *  @return final response object or nil in case of failure. In case of failure, error object will be instantiate.
+ */
+- (id<SDServiceGenericResponseProtocol> _Nullable) responseForData:(NSData* _Nullable)data error:(NSError*_Nullable* _Nullable)error;
+
+/**
+ *  Same as responseForObject:error:, adding to collector the items of array responses as soon as they are mapped. Used instead of responseForObject:error: when the call has a partialResultsHandler.
+ *
+ *  @param object     object returned by service that will be mapped in the final response object.
+ *  @param collector  collector of the mapped items.
+ *  @param error      possible error mapping (passed by reference).
+ *
+ *  @return final response object or nil in case of failure. In case of failure, error object will be instantiate.
+ */
+- (id<SDServiceGenericResponseProtocol> _Nullable) responseForObject:(id _Nullable)object partialResultsCollector:(SDServicePartialResultsCollector* _Nonnull)collector error:(NSError*_Nullable* _Nullable)error;
+
+/**
+ *  Same as responseForData:error:, adding to collector the items of array responses as soon as they are mapped. Used instead of responseForData:error: when the call has a partialResultsHandler.
+ */
+- (id<SDServiceGenericResponseProtocol> _Nullable) responseForData:(NSData* _Nullable)data partialResultsCollector:(SDServicePartialResultsCollector* _Nonnull)collector error:(NSError*_Nullable* _Nullable)error;
+
 /**
  *  Falg to anable service to retreive the response from a local file (set in demoModeJsonFileName)
  *
@@ -232,6 +315,14 @@ typedef NS_ENUM (NSUInteger, SDHTTPMethod)
 - (NSRange) demoWaitingTimeRange;
 
 
+/**
+ *  Flag to return in demo mode the same immutable object parsed from the local file, shared by all calls, instead of a new mutable copy for each call.
+ *  File is parsed only once in both cases: use it when mapping never changes the returned object, to also skip the copy.
+ *
+ *  @return YES to share the immutable object. Default is NO.
+ */
+- (BOOL) demoModeUsesImmutableFixtures;
+
 /**
  *  File name of local file that contains the response of service (in the Bundle) to simulate error cases.
  *
@@ -255,6 +346,53 @@ typedef NS_ENUM (NSUInteger, SDHTTPMethod)
  */
 - (double) demoModeFailureChanceEvent;
 
+/**
+ *  Latencies and faults to simulate in demo mode for this service, when SDServiceManager has a faultInjector. It has precedence on profiles set in the fault injector.
+ *  When a profile is used, demoModeFailureChanceEvent is ignored (use burst properties of the profile instead).
+ *
+ *  @return profile of simulated faults. Default is nil.
+ */
+- (SDServiceFaultProfile* _Nullable) demoModeFaultProfile;
+
+/**
+ *  Policy to hedge slow calls of this service: after the latency observed at the policy percentile a duplicate request is sent and the first response wins.
+ *  Use it only for latency critical calls that the server can receive twice.
+ *
+ *  @return hedging policy. Default is nil (calls are never hedged).
+ */
+- (SDServiceHedgingPolicy* _Nullable) hedgingPolicy;
+
+/**
+ *  Content type of bodies of this service (ex. application/msgpack). When SDServiceManager has a codec for it, request parameters are sent encoded by the codec (for methods with a body, instead of bodyForRequest:error:) and the content type is preferred in Accept header.
+ *  Responses are always decoded by the codec of their Content-Type, so servers can still answer JSON.
+ *
+ *  @return content type of bodies. Default is nil (JSON).
+ */
+- (NSString* _Nullable) bodyContentType;
+
+/**
+ *  Delta responses (RFC 3229 with JSON Patch, RFC 6902): SDServiceManager keeps the last document of the call with its ETag in deltaDocumentCache, and next calls send it in If-None-Match with A-IM: json-patch.
+ *  The server can answer 226 IM Used with a JSON Patch of that document (application/json-patch+json), applied to the cached document before mapping, or 304 if it didn't change.
+ *  When the patch doesn't apply (ex. failed test, Delta-Base different from the cached ETag) the call is repeated without delta.
+ *  Not used for conditional calls (notModifiedHandler) and for services that map responses from data.
+ *
+ *  @return YES to accept delta responses. Default is NO.
+ */
+- (BOOL) acceptsDeltaResponses;
+
+/**
+ *  Same as responseForObject:error: for a document patched by a delta response, reusing what was mapped from previousObject for the parts still in object
+ *  (parts untouched by the patch are the same instances of previousObject). Not used when the call has a partialResultsHandler.
+ *
+ *  @param object           patched document.
+ *  @param previousObject   cached document the patch was applied to.
+ *  @param previousResponse response mapped from previousObject.
+ *  @param error            possible error mapping (passed by reference).
+ *
+ *  @return final response object or nil in case of failure. In case of failure, error object will be instantiate.
+ */
+- (id<SDServiceGenericResponseProtocol> _Nullable) responseForObject:(id _Nullable)object previousObject:(id _Nullable)previousObject previousResponse:(id<SDServiceGenericResponseProtocol> _Nullable)previousResponse error:(NSError*_Nullable* _Nullable)error;
+
 /**
 *  Flag to prevent to print service response in console
 *
@@ -283,4 +421,29 @@ typedef NS_ENUM (NSUInteger, SDHTTPMethod)
 - (void) getResultFromJSONFileWithCompletion:(void (^_Nullable)  (id _Nullable result))completion;
 - (void) getResultFromJSONFileAtPath:(NSString* _Nonnull)pathToFile withCompletion:(void (^_Nullable) (id _Nullable result))completion;
 
+/**
+ *  Retreive response from a local file after the given waiting time, instead of a random value in demoWaitingTimeRange.
+ */
+- (void) getResultFromJSONFileAtPath:(NSString* _Nullable)pathToFile waitingTime:(NSTimeInterval)waitingTime withCompletion:(void (^_Nullable) (id _Nullable result))completion;
+
+/**
+ *  Path of the local file with the success response (demoModeJsonFileName or Class name of service).
+ */
+- (NSString* _Nullable) demoModeJsonFilePath;
+
+/**
+ *  Random waiting time in demoWaitingTimeRange (0 if not implemented).
+ */
+- (NSTimeInterval) demoModeWaitingTime;
+
+/**
+ *  Content of a local file, from the same cache used by getResultFromJSONFileAtPath.
+ */
++ (NSData* _Nullable) demoModeFileDataAtPath:(NSString* _Nullable)pathToFile;
+
+/**
+ *  Local files read in demo mode are kept in memory (memory mapped) to avoid reading them at every call. This method empties that cache.
+ */
++ (void) clearDemoModeFixturesCache;
+
 @end
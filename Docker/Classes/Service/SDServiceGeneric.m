@@ -15,11 +15,128 @@
 #import "SDServiceGeneric.h"
 #import "SDDockerLogger.h"
 
+NSString* NSStringFromSDHTTPMethod(SDHTTPMethod method)
+{
+    switch (method)
+    {
+        case SDHTTPMethodGET:
+            return @"GET";
+        case SDHTTPMethodPOST:
+            return @"POST";
+        case SDHTTPMethodPUT:
+            return @"PUT";
+        case SDHTTPMethodDELETE:
+            return @"DELETE";
+        case SDHTTPMethodHEAD:
+            return @"HEAD";
+        case SDHTTPMethodPATCH:
+            return @"PATCH";
+    }
+    return @"GET";
+}
+
 @implementation MultipartBodyInfo
 
 @end
 
 
+/**
+ *  Content of a local file used in demo mode.
+ */
+@interface SDDemoModeFixture : NSObject
+
+- (instancetype) initWithData:(NSData*)data;
+
+@property (nonatomic, readonly) NSData* data;
+
+/**
+ *  New mutable copy of the tree at every call (containers only, as NSJSONReadingMutableContainers).
+ */
+- (id) mutableObjectWithError:(NSError**)error;
+
+/**
+ *  Immutable tree parsed only once and shared by all callers (fixtures are read from any thread).
+ */
+- (id) immutableObjectWithError:(NSError**)error;
+
+@end
+
+@implementation SDDemoModeFixture
+{
+    NSData* _data;
+    id _immutableObject;
+    NSError* _immutableObjectError;
+    BOOL _parsed;
+}
+
+- (instancetype) initWithData:(NSData*)data
+{
+    self = [super init];
+    if (self)
+    {
+        _data = data;
+    }
+    return self;
+}
+
+- (id) mutableObjectWithError:(NSError**)error
+{
+    id immutableObject = [self immutableObjectWithError:error];
+    return immutableObject ? [SDDemoModeFixture mutableContainersCopyOfObject:immutableObject] : nil;
+}
+
+- (id) immutableObjectWithError:(NSError**)error
+{
+    id immutableObject = nil;
+    NSError* parsingError = nil;
+    @synchronized (self)
+    {
+        if (!_parsed)
+        {
+            _immutableObject = [NSJSONSerialization JSONObjectWithData:_data options:0 error:&_immutableObjectError];
+            _parsed = YES;
+        }
+        immutableObject = _immutableObject;
+        parsingError = _immutableObjectError;
+    }
+    
+    if (error)
+    {
+        *error = parsingError;
+    }
+    return immutableObject;
+}
+
+/**
+ *  Copying containers is cheaper than parsing the file again: strings and numbers are immutable, so they are shared.
+ */
++ (id) mutableContainersCopyOfObject:(id)object
+{
+    if ([object isKindOfClass:[NSDictionary class]])
+    {
+        NSDictionary* dictionary = object;
+        NSMutableDictionary* copy = [NSMutableDictionary dictionaryWithCapacity:dictionary.count];
+        [dictionary enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL* stop) {
+            copy[key] = [self mutableContainersCopyOfObject:value];
+        }];
+        return copy;
+    }
+    if ([object isKindOfClass:[NSArray class]])
+    {
+        NSArray* array = object;
+        NSMutableArray* copy = [NSMutableArray arrayWithCapacity:array.count];
+        for (id value in array)
+        {
+            [copy addObject:[self mutableContainersCopyOfObject:value]];
+        }
+        return copy;
+    }
+    return object;
+}
+
+@end
+
+
 @implementation SDServiceGeneric
 
 - (NSString*) pathResource
@@ -65,6 +182,11 @@
 //// Parses a JSON file and retrieves the response object
 //// ASYNCHRONOUS version of method
 - (void) getResultFromJSONFileWithCompletion:(void (^) (id result))completion
+{
+    [self getResultFromJSONFileAtPath:[self demoModeJsonFilePath] withCompletion:completion];
+}
+
+- (NSString*) demoModeJsonFilePath
 {
     // read json from file asking at service the demo file name
     NSString* jsonFileName = NSStringFromClass([self class]);
@@ -74,44 +196,101 @@
         jsonFileName = [self demoModeJsonFileName];
     }
     
-    NSString* pathToFile = [[NSBundle mainBundle] pathForResource:jsonFileName ofType:@"json"];
-    [self getResultFromJSONFileAtPath:pathToFile withCompletion:completion];
+    return [[NSBundle mainBundle] pathForResource:jsonFileName ofType:@"json"];
 }
 
-- (void) getResultFromJSONFileAtPath:(NSString*)pathToFile withCompletion:(void (^) (id result))completion
+- (NSTimeInterval) demoModeWaitingTime
 {
-    if ([[NSFileManager defaultManager] fileExistsAtPath:pathToFile])
+    NSTimeInterval waitingTime = 0;
+    if([self respondsToSelector:@selector(demoWaitingTimeRange)])
     {
-        // execution in separate thread
-        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT,
-                                                 (unsigned long)NULL), ^(void) {
-            
-            if([self respondsToSelector:@selector(demoWaitingTimeRange)])
-            {
-                NSRange range = [self demoWaitingTimeRange];
-                float waitingTime = (arc4random_uniform(range.length*100.)/100.) + range.location;
-                sleep(waitingTime);
-            }
-            
-            NSString* jsonString = [[NSString alloc] initWithContentsOfFile:pathToFile encoding:NSUTF8StringEncoding error:NULL];
-            NSError* jsonError;
-            NSDictionary* dictionary = [NSJSONSerialization JSONObjectWithData:[jsonString dataUsingEncoding:NSUTF8StringEncoding] options:NSJSONReadingMutableContainers error:&jsonError];
-            if (jsonError)
-            {
-                SDLogModuleError(kServiceManagerLogModuleName, @"Local file %@ doesn't contain a valid dictionary: %@", pathToFile, jsonError.localizedDescription);
-                dictionary = nil;
-            }
-            
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(dictionary);
-            });
-        });
+        NSRange range = [self demoWaitingTimeRange];
+        waitingTime = (arc4random_uniform(range.length*100.)/100.) + range.location;
     }
-    else
+    return waitingTime;
+}
+
+- (void) getResultFromJSONFileAtPath:(NSString*)pathToFile withCompletion:(void (^) (id result))completion
+{
+    [self getResultFromJSONFileAtPath:pathToFile waitingTime:[self demoModeWaitingTime] withCompletion:completion];
+}
+
+- (void) getResultFromJSONFileAtPath:(NSString*)pathToFile waitingTime:(NSTimeInterval)waitingTime withCompletion:(void (^) (id result))completion
+{
+    SDDemoModeFixture* fixture = [SDServiceGeneric demoModeFixtureAtPath:pathToFile];
+    if (!fixture)
     {
         SDLogModuleError(kServiceManagerLogModuleName, @"Local file %@ doesn't exist", pathToFile);
         completion(nil);
+        return;
+    }
+    
+    // waiting time starts now and runs in parallel with parsing. No thread is blocked while waiting.
+    dispatch_time_t completionTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(waitingTime * NSEC_PER_SEC));
+    
+    BOOL useImmutableFixture = [self respondsToSelector:@selector(demoModeUsesImmutableFixtures)] && [self demoModeUsesImmutableFixtures];
+    
+    // execution in separate thread
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(void) {
+        NSError* jsonError;
+        id result = useImmutableFixture ? [fixture immutableObjectWithError:&jsonError] : [fixture mutableObjectWithError:&jsonError];
+        if (jsonError)
+        {
+            SDLogModuleError(kServiceManagerLogModuleName, @"Local file %@ doesn't contain a valid dictionary: %@", pathToFile, jsonError.localizedDescription);
+            result = nil;
+        }
+        
+        dispatch_after(completionTime, dispatch_get_main_queue(), ^{
+            completion(result);
+        });
+    });
+}
+
+#pragma mark - Demo mode fixtures cache
+
++ (NSCache<NSString*, SDDemoModeFixture*>*) demoModeFixturesCache
+{
+    static dispatch_once_t pred;
+    static NSCache* demoModeFixturesCache = nil;
+    
+    dispatch_once(&pred, ^{
+        demoModeFixturesCache = [[NSCache alloc] init];
+        demoModeFixturesCache.name = @"com.sysdata.SDServiceGeneric.demoModeFixtures";
+    });
+    
+    return demoModeFixturesCache;
+}
+
++ (SDDemoModeFixture*) demoModeFixtureAtPath:(NSString*)pathToFile
+{
+    if (pathToFile.length == 0)
+    {
+        return nil;
     }
+    
+    SDDemoModeFixture* fixture = [[self demoModeFixturesCache] objectForKey:pathToFile];
+    if (!fixture)
+    {
+        // mapped read: pages are loaded lazily by the kernel and shared by all calls
+        NSData* data = [NSData dataWithContentsOfFile:pathToFile options:NSDataReadingMappedIfSafe error:NULL];
+        if (!data)
+        {
+            return nil;
+        }
+        fixture = [[SDDemoModeFixture alloc] initWithData:data];
+        [[self demoModeFixturesCache] setObject:fixture forKey:pathToFile cost:data.length];
+    }
+    return fixture;
+}
+
++ (NSData*) demoModeFileDataAtPath:(NSString*)pathToFile
+{
+    return [self demoModeFixtureAtPath:pathToFile].data;
+}
+
++ (void) clearDemoModeFixturesCache
+{
+    [[self demoModeFixturesCache] removeAllObjects];
 }
 
 @end
@@ -0,0 +1,67 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Configuration of hedged requests of a service (see hedgingPolicy of SDServiceGenericProtocol).
+ *
+ *  When a call has no response after the observed latency at percentile, SDServiceManager sends a duplicate of the request (optionally to alternateBaseURL):
+ *  the first response wins and the other request is cancelled. Only idempotent calls (GET, HEAD, PUT, DELETE) without multipart body are hedged.
+ */
+@interface SDServiceHedgingPolicy : NSObject <NSCopying>
+
+/**
+ *  Percentile (0-100) of latencies observed for the service after which the duplicate is sent.
+ *
+ *  Default: 95
+ */
+@property (nonatomic, assign) double percentile;
+
+/**
+ *  Latencies observed before hedging starts: with less samples the percentile is not meaningful and calls are not hedged.
+ *
+ *  Default: 20
+ */
+@property (nonatomic, assign) NSUInteger minimumNumberOfSamples;
+
+/**
+ *  Minimum time before the duplicate is sent, whatever the observed latency.
+ *
+ *  Default: 0.01 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval minimumDelay;
+
+/**
+ *  Base URL used by the duplicate request, ex. another instance or region of the backend. nil to use the same URL of the call.
+ *
+ *  Default: nil
+ */
+@property (nonatomic, strong) NSURL* _Nullable alternateBaseURL;
+
+/**
+ *  Hedge budget: every call of the service earns budgetRatio duplicates, and a duplicate is sent only if a whole one has been earned. 0.1 means at most ~10% more requests.
+ *
+ *  Default: 0.1
+ */
+@property (nonatomic, assign) double budgetRatio;
+
+/**
+ *  Maximum duplicates that can be earned and kept for later (burst of hedges after a quiet period).
+ *
+ *  Default: 5
+ */
+@property (nonatomic, assign) double maximumBudget;
+
+@end
@@ -0,0 +1,51 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceHedgingPolicy.h"
+
+#define DEFAULT_HEDGING_PERCENTILE             95
+#define DEFAULT_HEDGING_MINIMUM_SAMPLES        20
+#define DEFAULT_HEDGING_MINIMUM_DELAY          0.01
+#define DEFAULT_HEDGING_BUDGET_RATIO           0.1
+#define DEFAULT_HEDGING_MAXIMUM_BUDGET         5
+
+@implementation SDServiceHedgingPolicy
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        self.percentile = DEFAULT_HEDGING_PERCENTILE;
+        self.minimumNumberOfSamples = DEFAULT_HEDGING_MINIMUM_SAMPLES;
+        self.minimumDelay = DEFAULT_HEDGING_MINIMUM_DELAY;
+        self.budgetRatio = DEFAULT_HEDGING_BUDGET_RATIO;
+        self.maximumBudget = DEFAULT_HEDGING_MAXIMUM_BUDGET;
+    }
+    return self;
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    SDServiceHedgingPolicy* policy = [[[self class] allocWithZone:zone] init];
+    policy.percentile = self.percentile;
+    policy.minimumNumberOfSamples = self.minimumNumberOfSamples;
+    policy.minimumDelay = self.minimumDelay;
+    policy.alternateBaseURL = self.alternateBaseURL;
+    policy.budgetRatio = self.budgetRatio;
+    policy.maximumBudget = self.maximumBudget;
+    return policy;
+}
+
+@end
@@ -0,0 +1,83 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#import <Foundation/Foundation.h>
+#import <Mantle/Mantle.h>
+
+typedef NS_ENUM (NSInteger, SDServiceJSONValueType)
+{
+    SDServiceJSONValueTypeNone,         // empty data or only whitespaces
+    SDServiceJSONValueTypeObject,
+    SDServiceJSONValueTypeArray,
+    SDServiceJSONValueTypeOther         // string, number, boolean, null or invalid JSON
+};
+
+/**
+ *  Optional methods of models read by SDServiceJSONDecoder.
+ */
+@protocol SDServiceJSONDecoding <MTLJSONSerializing>
+@optional
+/**
+ *  Model class of properties that have a custom transformer for a nested model or an array of models (ex. +[MTLJSONAdapter dictionaryTransformerWithModelClass:] or +[MTLJSONAdapter arrayTransformerWithModelClass:]).
+ *  These properties are read directly as models (arrays of models if the property is a NSArray) instead of building their JSON and passing it to the transformer.
+ *
+ *  @return model classes by property key.
+ */
++ (NSDictionary<NSString*, Class>* _Nonnull) JSONDecodingModelClassesByPropertyKey;
+
+@end
+
+/**
+ *  Reads Mantle models directly from UTF-8 JSON data, without building the NSDictionary/NSArray tree of the whole response first.
+ *
+ *  Models are read following their JSONKeyPathsByPropertyKey and value transformers, as MTLJSONAdapter does: values of mapped keys are read and transformed, nested models (without a custom transformer, or declared by JSONDecodingModelClassesByPropertyKey) are read in the same walk and values of keys not mapped are skipped without allocating objects.
+ *  Models that map a property to an array of key paths or implement classForParsingJSONDictionary: are read as JSON objects and passed to MTLJSONAdapter.
+ */
+@interface SDServiceJSONDecoder : NSObject
+
+/**
+ *  Type of the top level value of data, read from its first byte.
+ */
++ (SDServiceJSONValueType) typeOfValueInData:(NSData* _Nonnull)data;
+
+/**
+ *  Model of the JSON object in data.
+ *
+ *  @return model, or nil in case of failure (error object will be instantiated).
+ */
++ (id _Nullable) modelOfClass:(Class _Nonnull)modelClass fromData:(NSData* _Nonnull)data error:(NSError* _Nullable * _Nullable)error;
+
+/**
+ *  Models of the JSON array of objects in data.
+ *
+ *  @return array of models, or nil in case of failure (error object will be instantiated).
+ */
++ (NSArray* _Nullable) modelsOfClass:(Class _Nonnull)modelClass fromData:(NSData* _Nonnull)data error:(NSError* _Nullable * _Nullable)error;
+
+/**
+ *  Same as modelsOfClass:fromData:error:, calling itemHandler with every model as soon as it is read (ex. to show the first items of a long list).
+ */
++ (NSArray* _Nullable) modelsOfClass:(Class _Nonnull)modelClass fromData:(NSData* _Nonnull)data itemHandler:(void (^ _Nullable)(id _Nonnull model))itemHandler error:(NSError* _Nullable * _Nullable)error;
+
+/**
+ *  JSON key paths read for the model class (ex. "id", "owner.display_name"), sorted. Nested models and arrays of models (see JSONDecodingModelClassesByPropertyKey) are followed,
+ *  so their key paths are listed instead of the key of the whole object; other values with custom transformers are listed with their key only.
+ *  Computed once for every class.
+ *
+ *  @return key paths, or nil if any key of the JSON object may be read (ex. the class implements classForParsingJSONDictionary:).
+ */
++ (NSArray<NSString*>* _Nullable) JSONKeyPathsOfModelClass:(Class _Nonnull)modelClass;
+
+@end
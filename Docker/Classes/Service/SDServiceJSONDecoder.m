@@ -0,0 +1,1295 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#import "SDServiceJSONDecoder.h"
+#import <objc/runtime.h>
+
+#define JSONDecoderErrorDomain          @"JSON_DECODER"
+#define JSONDecoderMaximumDepth         512
+#define JSONDecoderNumberBufferLength   64
+#define JSONDecoderKeyBufferLength      256
+
+/**
+ *  Value transformers of a model class, computed by MTLJSONAdapter (declared in its class extension).
+ */
+@interface MTLJSONAdapter (SDServiceJSONDecoder)
+
++ (NSDictionary*) valueTransformersForModelClass:(Class)modelClass;
+
+@end
+
+/**
+ *  Key of a JSON object read for a model: a property (leaf) or an object with other keys (intermediate component of key paths like "a.b").
+ */
+@interface SDServiceJSONDecodingNode : NSObject
+
+@property (nonatomic, strong) NSString* key;
+
+/**
+ *  UTF-8 of key, compared with the bytes of keys in data.
+ */
+@property (nonatomic, strong) NSData* keyData;
+
+@property (nonatomic, strong) NSString* propertyKey;
+@property (nonatomic, strong) NSValueTransformer* transformer;
+
+/**
+ *  Class of the nested model read in the same walk, Nil if the value is read as JSON and transformed.
+ */
+@property (nonatomic, assign) Class modelClass;
+
+/**
+ *  The property is an array of modelClass.
+ */
+@property (nonatomic, assign) BOOL isArrayOfModels;
+
+@property (nonatomic, strong) NSMutableArray<SDServiceJSONDecodingNode*>* children;
+
+@end
+
+@implementation SDServiceJSONDecodingNode
+
+@end
+
+#pragma mark - Reader
+
+/**
+ *  Position in the JSON data being read.
+ */
+typedef struct
+{
+    const uint8_t* bytes;
+    NSUInteger length;
+    NSUInteger position;
+    NSUInteger depth;
+} SDJSONReader;
+
+static SDJSONReader SDJSONReaderMake(NSData* data)
+{
+    SDJSONReader reader = { data.bytes, data.length, 0, 0 };
+    if (reader.length >= 3 && memcmp(reader.bytes, "\xEF\xBB\xBF", 3) == 0)
+    {
+        reader.position = 3;
+    }
+    return reader;
+}
+
+/**
+ *  NSJSONSerialization also reads UTF-16 and UTF-32: their first bytes always contain a zero.
+ */
+static BOOL SDJSONDataIsUTF8(NSData* data)
+{
+    const uint8_t* bytes = data.bytes;
+    return data.length < 2 || (bytes[0] != 0 && bytes[1] != 0 && !(bytes[0] == 0xFE && bytes[1] == 0xFF) && !(bytes[0] == 0xFF && bytes[1] == 0xFE));
+}
+
+static BOOL SDJSONFail(SDJSONReader* reader, NSString* message, NSError** error)
+{
+    if (error)
+    {
+        *error = [NSError errorWithDomain:JSONDecoderErrorDomain code:-1 userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"%@ at byte %lu", message, (unsigned long)reader->position] }];
+    }
+    return NO;
+}
+
+static inline void SDJSONSkipWhitespace(SDJSONReader* reader)
+{
+    while (reader->position < reader->length)
+    {
+        uint8_t byte = reader->bytes[reader->position];
+        if (byte != ' ' && byte != '\n' && byte != '\r' && byte != '\t')
+        {
+            break;
+        }
+        reader->position++;
+    }
+}
+
+/**
+ *  Byte at position, -1 at the end of data.
+ */
+static inline int SDJSONPeek(SDJSONReader* reader)
+{
+    return reader->position < reader->length ? reader->bytes[reader->position] : -1;
+}
+
+static BOOL SDJSONCheckEnd(SDJSONReader* reader, NSError** error)
+{
+    SDJSONSkipWhitespace(reader);
+    return reader->position == reader->length || SDJSONFail(reader, @"Garbage at end of JSON", error);
+}
+
+static BOOL SDJSONReadHex4(const uint8_t* bytes, NSUInteger length, uint32_t* value)
+{
+    if (length < 4)
+    {
+        return NO;
+    }
+    uint32_t result = 0;
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        uint8_t byte = bytes[i];
+        uint32_t digit = 0;
+        if (byte >= '0' && byte <= '9')
+        {
+            digit = byte - '0';
+        }
+        else if (byte >= 'a' && byte <= 'f')
+        {
+            digit = byte - 'a' + 10;
+        }
+        else if (byte >= 'A' && byte <= 'F')
+        {
+            digit = byte - 'A' + 10;
+        }
+        else
+        {
+            return NO;
+        }
+        result = (result << 4) | digit;
+    }
+    *value = result;
+    return YES;
+}
+
+/**
+ *  Escape after a backslash (bytes start after it), checked also for strings that are skipped: NSJSONSerialization rejects the whole data.
+ */
+static BOOL SDJSONIsValidEscape(const uint8_t* bytes, NSUInteger length)
+{
+    if (length == 0)
+    {
+        return NO;
+    }
+    uint32_t codePoint = 0;
+    switch (bytes[0])
+    {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+            return YES;
+        case 'u':
+            return SDJSONReadHex4(bytes + 1, length - 1, &codePoint);
+        default:
+            return NO;
+    }
+}
+
+/**
+ *  Length of the well-formed UTF-8 sequence starting with a byte >= 0x80, 0 if it is invalid (overlong, surrogate, above U+10FFFF or truncated).
+ */
+static NSUInteger SDJSONUTF8SequenceLength(const uint8_t* bytes, NSUInteger length)
+{
+    uint8_t lead = bytes[0];
+    uint8_t minimum = 0x80;
+    uint8_t maximum = 0xBF;
+    NSUInteger sequenceLength = 0;
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        sequenceLength = 2;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        sequenceLength = 3;
+        minimum = lead == 0xE0 ? 0xA0 : minimum;
+        maximum = lead == 0xED ? 0x9F : maximum;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        sequenceLength = 4;
+        minimum = lead == 0xF0 ? 0x90 : minimum;
+        maximum = lead == 0xF4 ? 0x8F : maximum;
+    }
+    if (sequenceLength == 0 || length < sequenceLength || bytes[1] < minimum || bytes[1] > maximum)
+    {
+        return 0;
+    }
+    for (NSUInteger i = 2; i < sequenceLength; i++)
+    {
+        if ((bytes[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+    }
+    return sequenceLength;
+}
+
+/**
+ *  Scan the string at position (on the opening quote) without decoding it: range of the content and if it contains escapes.
+ */
+static BOOL SDJSONScanString(SDJSONReader* reader, NSRange* range, BOOL* hasEscapes, NSError** error)
+{
+    const uint8_t* bytes = reader->bytes;
+    NSUInteger length = reader->length;
+    NSUInteger start = reader->position + 1;
+    BOOL escapes = NO;
+    for (NSUInteger i = start; i < length; i++)
+    {
+        uint8_t byte = bytes[i];
+        if (byte == '"')
+        {
+            *range = NSMakeRange(start, i - start);
+            if (hasEscapes)
+            {
+                *hasEscapes = escapes;
+            }
+            reader->position = i + 1;
+            return YES;
+        }
+        if (byte == '\\')
+        {
+            escapes = YES;
+            if (!SDJSONIsValidEscape(bytes + i + 1, length - i - 1))
+            {
+                reader->position = i;
+                return SDJSONFail(reader, @"Invalid escape in string", error);
+            }
+            i++;
+        }
+        else if (byte < 0x20)
+        {
+            reader->position = i;
+            return SDJSONFail(reader, @"Unescaped control character in string", error);
+        }
+        else if (byte >= 0x80)
+        {
+            NSUInteger sequenceLength = SDJSONUTF8SequenceLength(bytes + i, length - i);
+            if (sequenceLength == 0)
+            {
+                reader->position = i;
+                return SDJSONFail(reader, @"Invalid UTF-8 in string", error);
+            }
+            i += sequenceLength - 1;
+        }
+    }
+    reader->position = length;
+    return SDJSONFail(reader, @"Unterminated string", error);
+}
+
+/**
+ *  Decode the escapes of a string content into buffer, at least as long as the content (decoded strings are never longer).
+ *
+ *  @return decoded length, or NSNotFound if an escape is invalid.
+ */
+static NSUInteger SDJSONUnescape(const uint8_t* bytes, NSUInteger length, uint8_t* buffer)
+{
+    NSUInteger decodedLength = 0;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        uint8_t byte = bytes[i];
+        if (byte != '\\')
+        {
+            buffer[decodedLength++] = byte;
+            continue;
+        }
+        if (++i >= length)
+        {
+            return NSNotFound;
+        }
+        switch (bytes[i])
+        {
+            case '"': buffer[decodedLength++] = '"'; break;
+            case '\\': buffer[decodedLength++] = '\\'; break;
+            case '/': buffer[decodedLength++] = '/'; break;
+            case 'b': buffer[decodedLength++] = '\b'; break;
+            case 'f': buffer[decodedLength++] = '\f'; break;
+            case 'n': buffer[decodedLength++] = '\n'; break;
+            case 'r': buffer[decodedLength++] = '\r'; break;
+            case 't': buffer[decodedLength++] = '\t'; break;
+            case 'u': {
+                uint32_t codePoint = 0;
+                if (!SDJSONReadHex4(bytes + i + 1, length - i - 1, &codePoint))
+                {
+                    return NSNotFound;
+                }
+                i += 4;
+                if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+                {
+                    // surrogate pair, lone surrogates become U+FFFD
+                    uint32_t lowSurrogate = 0;
+                    if (codePoint <= 0xDBFF && i + 6 < length && bytes[i + 1] == '\\' && bytes[i + 2] == 'u' && SDJSONReadHex4(bytes + i + 3, length - i - 3, &lowSurrogate) && lowSurrogate >= 0xDC00 && lowSurrogate <= 0xDFFF)
+                    {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+                        i += 6;
+                    }
+                    else
+                    {
+                        codePoint = 0xFFFD;
+                    }
+                }
+                if (codePoint < 0x80)
+                {
+                    buffer[decodedLength++] = codePoint;
+                }
+                else if (codePoint < 0x800)
+                {
+                    buffer[decodedLength++] = 0xC0 | (codePoint >> 6);
+                    buffer[decodedLength++] = 0x80 | (codePoint & 0x3F);
+                }
+                else if (codePoint < 0x10000)
+                {
+                    buffer[decodedLength++] = 0xE0 | (codePoint >> 12);
+                    buffer[decodedLength++] = 0x80 | ((codePoint >> 6) & 0x3F);
+                    buffer[decodedLength++] = 0x80 | (codePoint & 0x3F);
+                }
+                else
+                {
+                    buffer[decodedLength++] = 0xF0 | (codePoint >> 18);
+                    buffer[decodedLength++] = 0x80 | ((codePoint >> 12) & 0x3F);
+                    buffer[decodedLength++] = 0x80 | ((codePoint >> 6) & 0x3F);
+                    buffer[decodedLength++] = 0x80 | (codePoint & 0x3F);
+                }
+                break;
+            }
+            default:
+                return NSNotFound;
+        }
+    }
+    return decodedLength;
+}
+
+static NSString* SDJSONReadString(SDJSONReader* reader, NSError** error)
+{
+    NSRange range;
+    BOOL hasEscapes = NO;
+    if (!SDJSONScanString(reader, &range, &hasEscapes, error))
+    {
+        return nil;
+    }
+    
+    const uint8_t* bytes = reader->bytes + range.location;
+    NSString* string = nil;
+    if (!hasEscapes)
+    {
+        string = [[NSString alloc] initWithBytes:bytes length:range.length encoding:NSUTF8StringEncoding];
+    }
+    else
+    {
+        uint8_t* buffer = malloc(MAX(range.length, 1));
+        NSUInteger length = SDJSONUnescape(bytes, range.length, buffer);
+        if (length != NSNotFound)
+        {
+            string = [[NSString alloc] initWithBytes:buffer length:length encoding:NSUTF8StringEncoding];
+        }
+        free(buffer);
+    }
+    if (!string)
+    {
+        SDJSONFail(reader, @"Invalid string", error);
+    }
+    return string;
+}
+
+/**
+ *  Scan the number at position, following the JSON grammar.
+ */
+static BOOL SDJSONScanNumber(SDJSONReader* reader, BOOL* isInteger, NSError** error)
+{
+    const uint8_t* bytes = reader->bytes;
+    NSUInteger length = reader->length;
+    NSUInteger i = reader->position;
+    BOOL integer = YES;
+    
+    if (i < length && bytes[i] == '-')
+    {
+        i++;
+    }
+    NSUInteger digitsStart = i;
+    while (i < length && bytes[i] >= '0' && bytes[i] <= '9')
+    {
+        i++;
+    }
+    if (i == digitsStart || (bytes[digitsStart] == '0' && i - digitsStart > 1))
+    {
+        return SDJSONFail(reader, @"Invalid value", error);
+    }
+    if (i < length && bytes[i] == '.')
+    {
+        integer = NO;
+        NSUInteger fractionStart = ++i;
+        while (i < length && bytes[i] >= '0' && bytes[i] <= '9')
+        {
+            i++;
+        }
+        if (i == fractionStart)
+        {
+            return SDJSONFail(reader, @"Invalid number", error);
+        }
+    }
+    if (i < length && (bytes[i] == 'e' || bytes[i] == 'E'))
+    {
+        integer = NO;
+        i++;
+        if (i < length && (bytes[i] == '+' || bytes[i] == '-'))
+        {
+            i++;
+        }
+        NSUInteger exponentStart = i;
+        while (i < length && bytes[i] >= '0' && bytes[i] <= '9')
+        {
+            i++;
+        }
+        if (i == exponentStart)
+        {
+            return SDJSONFail(reader, @"Invalid number", error);
+        }
+    }
+    
+    reader->position = i;
+    if (isInteger)
+    {
+        *isInteger = integer;
+    }
+    return YES;
+}
+
+static NSNumber* SDJSONReadNumber(SDJSONReader* reader, NSError** error)
+{
+    NSUInteger start = reader->position;
+    BOOL isInteger = YES;
+    if (!SDJSONScanNumber(reader, &isInteger, error))
+    {
+        return nil;
+    }
+    
+    NSUInteger length = reader->position - start;
+    char buffer[JSONDecoderNumberBufferLength];
+    if (length >= sizeof(buffer))
+    {
+        NSString* string = [[NSString alloc] initWithBytes:reader->bytes + start length:length encoding:NSUTF8StringEncoding];
+        return isInteger ? [NSDecimalNumber decimalNumberWithString:string] : @(string.doubleValue);
+    }
+    memcpy(buffer, reader->bytes + start, length);
+    buffer[length] = 0;
+    
+    if (!isInteger)
+    {
+        return @(strtod(buffer, NULL));
+    }
+    // same types of NSJSONSerialization: integers too big for 64 bits become decimal numbers
+    errno = 0;
+    long long value = strtoll(buffer, NULL, 10);
+    if (errno != ERANGE)
+    {
+        return @(value);
+    }
+    if (buffer[0] != '-')
+    {
+        errno = 0;
+        unsigned long long unsignedValue = strtoull(buffer, NULL, 10);
+        if (errno != ERANGE)
+        {
+            return @(unsignedValue);
+        }
+    }
+    return [NSDecimalNumber decimalNumberWithString:@(buffer)];
+}
+
+/**
+ *  null, true or false: shared objects, nothing is allocated.
+ */
+static id SDJSONReadLiteral(SDJSONReader* reader, NSError** error)
+{
+    const uint8_t* bytes = reader->bytes + reader->position;
+    NSUInteger remainingLength = reader->length - reader->position;
+    if (remainingLength >= 4 && memcmp(bytes, "null", 4) == 0)
+    {
+        reader->position += 4;
+        return [NSNull null];
+    }
+    if (remainingLength >= 4 && memcmp(bytes, "true", 4) == 0)
+    {
+        reader->position += 4;
+        return @YES;
+    }
+    if (remainingLength >= 5 && memcmp(bytes, "false", 5) == 0)
+    {
+        reader->position += 5;
+        return @NO;
+    }
+    SDJSONFail(reader, @"Invalid value", error);
+    return nil;
+}
+
+/**
+ *  Enter the object or array at position. An empty container is also left.
+ */
+static BOOL SDJSONBeginContainer(SDJSONReader* reader, uint8_t closingByte, BOOL* empty, NSError** error)
+{
+    if (++reader->depth > JSONDecoderMaximumDepth)
+    {
+        return SDJSONFail(reader, @"Too many nested objects", error);
+    }
+    reader->position++;
+    SDJSONSkipWhitespace(reader);
+    *empty = SDJSONPeek(reader) == closingByte;
+    if (*empty)
+    {
+        reader->position++;
+        reader->depth--;
+    }
+    return YES;
+}
+
+/**
+ *  After a member of a container: more is YES after a comma, NO after the end of the container.
+ */
+static BOOL SDJSONNextInContainer(SDJSONReader* reader, uint8_t closingByte, BOOL* more, NSError** error)
+{
+    SDJSONSkipWhitespace(reader);
+    int byte = SDJSONPeek(reader);
+    if (byte == ',')
+    {
+        reader->position++;
+        SDJSONSkipWhitespace(reader);
+        *more = YES;
+        return YES;
+    }
+    if (byte == closingByte)
+    {
+        reader->position++;
+        reader->depth--;
+        *more = NO;
+        return YES;
+    }
+    return SDJSONFail(reader, closingByte == '}' ? @"Expected ',' or '}'" : @"Expected ',' or ']'", error);
+}
+
+static BOOL SDJSONSkipColon(SDJSONReader* reader, NSError** error)
+{
+    SDJSONSkipWhitespace(reader);
+    if (SDJSONPeek(reader) != ':')
+    {
+        return SDJSONFail(reader, @"Expected ':'", error);
+    }
+    reader->position++;
+    SDJSONSkipWhitespace(reader);
+    return YES;
+}
+
+/**
+ *  Scan "key": at position, without decoding the key. Position is left on the value.
+ */
+static BOOL SDJSONScanKey(SDJSONReader* reader, NSRange* range, BOOL* hasEscapes, NSError** error)
+{
+    if (SDJSONPeek(reader) != '"')
+    {
+        return SDJSONFail(reader, @"Expected a key", error);
+    }
+    return SDJSONScanString(reader, range, hasEscapes, error) && SDJSONSkipColon(reader, error);
+}
+
+/**
+ *  Skip the value at position, without allocating objects.
+ */
+static BOOL SDJSONSkipValue(SDJSONReader* reader, NSError** error)
+{
+    SDJSONSkipWhitespace(reader);
+    NSRange range;
+    BOOL empty = NO;
+    BOOL more = NO;
+    switch (SDJSONPeek(reader))
+    {
+        case -1:
+            return SDJSONFail(reader, @"Unexpected end of JSON", error);
+        case '"':
+            return SDJSONScanString(reader, &range, NULL, error);
+        case '{':
+            if (!SDJSONBeginContainer(reader, '}', &empty, error))
+            {
+                return NO;
+            }
+            more = !empty;
+            while (more)
+            {
+                if (!SDJSONScanKey(reader, &range, NULL, error) || !SDJSONSkipValue(reader, error) || !SDJSONNextInContainer(reader, '}', &more, error))
+                {
+                    return NO;
+                }
+            }
+            return YES;
+        case '[':
+            if (!SDJSONBeginContainer(reader, ']', &empty, error))
+            {
+                return NO;
+            }
+            more = !empty;
+            while (more)
+            {
+                if (!SDJSONSkipValue(reader, error) || !SDJSONNextInContainer(reader, ']', &more, error))
+                {
+                    return NO;
+                }
+            }
+            return YES;
+        case 't':
+        case 'f':
+        case 'n':
+            return SDJSONReadLiteral(reader, error) != nil;
+        default:
+            return SDJSONScanNumber(reader, NULL, error);
+    }
+}
+
+/**
+ *  Read the value at position as JSON objects (NSDictionary, NSArray, NSString, NSNumber, NSNull).
+ */
+static id SDJSONReadValue(SDJSONReader* reader, NSError** error)
+{
+    SDJSONSkipWhitespace(reader);
+    BOOL empty = NO;
+    BOOL more = NO;
+    switch (SDJSONPeek(reader))
+    {
+        case -1:
+            SDJSONFail(reader, @"Unexpected end of JSON", error);
+            return nil;
+        case '"':
+            return SDJSONReadString(reader, error);
+        case '{': {
+            if (!SDJSONBeginContainer(reader, '}', &empty, error))
+            {
+                return nil;
+            }
+            NSMutableDictionary* dictionary = [NSMutableDictionary dictionary];
+            more = !empty;
+            while (more)
+            {
+                if (SDJSONPeek(reader) != '"')
+                {
+                    SDJSONFail(reader, @"Expected a key", error);
+                    return nil;
+                }
+                NSString* key = SDJSONReadString(reader, error);
+                if (!key || !SDJSONSkipColon(reader, error))
+                {
+                    return nil;
+                }
+                id value = SDJSONReadValue(reader, error);
+                if (!value)
+                {
+                    return nil;
+                }
+                dictionary[key] = value;
+                if (!SDJSONNextInContainer(reader, '}', &more, error))
+                {
+                    return nil;
+                }
+            }
+            return dictionary;
+        }
+        case '[': {
+            if (!SDJSONBeginContainer(reader, ']', &empty, error))
+            {
+                return nil;
+            }
+            NSMutableArray* array = [NSMutableArray array];
+            more = !empty;
+            while (more)
+            {
+                id value = SDJSONReadValue(reader, error);
+                if (!value)
+                {
+                    return nil;
+                }
+                [array addObject:value];
+                if (!SDJSONNextInContainer(reader, ']', &more, error))
+                {
+                    return nil;
+                }
+            }
+            return array;
+        }
+        case 't':
+        case 'f':
+        case 'n':
+            return SDJSONReadLiteral(reader, error);
+        default:
+            return SDJSONReadNumber(reader, error);
+    }
+}
+
+/**
+ *  Child of node with the key (raw bytes of data), nil if the key is not mapped.
+ */
+static SDServiceJSONDecodingNode* SDJSONChildWithKey(SDServiceJSONDecodingNode* node, const uint8_t* bytes, NSUInteger length, BOOL hasEscapes)
+{
+    uint8_t stackBuffer[JSONDecoderKeyBufferLength];
+    uint8_t* heapBuffer = NULL;
+    if (hasEscapes)
+    {
+        uint8_t* buffer = stackBuffer;
+        if (length > sizeof(stackBuffer))
+        {
+            heapBuffer = malloc(length);
+            buffer = heapBuffer;
+        }
+        length = SDJSONUnescape(bytes, length, buffer);
+        bytes = buffer;
+    }
+    
+    SDServiceJSONDecodingNode* match = nil;
+    if (length != NSNotFound)
+    {
+        for (SDServiceJSONDecodingNode* child in node.children)
+        {
+            NSData* keyData = child.keyData;
+            if (keyData.length == length && memcmp(keyData.bytes, bytes, length) == 0)
+            {
+                match = child;
+                break;
+            }
+        }
+    }
+    free(heapBuffer);
+    return match;
+}
+
+/**
+ *  Declared class of the property, Nil if it is not an object.
+ */
+static Class SDJSONClassOfProperty(Class modelClass, NSString* propertyKey)
+{
+    objc_property_t property = class_getProperty(modelClass, propertyKey.UTF8String);
+    if (!property)
+    {
+        return Nil;
+    }
+    char* type = property_copyAttributeValue(property, "T");
+    if (!type)
+    {
+        return Nil;
+    }
+    
+    // @"ClassName" or @"ClassName<Protocol>"
+    Class propertyClass = Nil;
+    if (type[0] == '@' && type[1] == '"')
+    {
+        const char* className = type + 2;
+        NSString* name = [[NSString alloc] initWithBytes:className length:strcspn(className, "\"<") encoding:NSUTF8StringEncoding];
+        propertyClass = NSClassFromString(name);
+    }
+    free(type);
+    return propertyClass;
+}
+
+/**
+ *  Model class read for the property (nil if it isn't a nested model or an array of models): declared by JSONDecodingModelClassesByPropertyKey, or of the property itself if MTLJSONAdapter would use dictionaryTransformerWithModelClass:.
+ */
+static Class SDJSONNestedModelClass(Class modelClass, NSString* propertyKey, NSDictionary<NSString*, Class>* modelClassesByPropertyKey, BOOL* isArrayOfModels)
+{
+    Class propertyClass = SDJSONClassOfProperty(modelClass, propertyKey);
+    *isArrayOfModels = NO;
+    if (modelClassesByPropertyKey[propertyKey])
+    {
+        *isArrayOfModels = [propertyClass isSubclassOfClass:[NSArray class]];
+        return modelClassesByPropertyKey[propertyKey];
+    }
+    
+    BOOL hasCustomTransformer = [modelClass respondsToSelector:NSSelectorFromString([propertyKey stringByAppendingString:@"JSONTransformer"])] || ([modelClass respondsToSelector:@selector(JSONTransformerForKey:)] && [modelClass JSONTransformerForKey:propertyKey] != nil);
+    if (!hasCustomTransformer && [propertyClass conformsToProtocol:@protocol(MTLJSONSerializing)] && ![MTLJSONAdapter respondsToSelector:NSSelectorFromString([NSStringFromClass(propertyClass) stringByAppendingString:@"JSONTransformer"])])
+    {
+        return propertyClass;
+    }
+    return Nil;
+}
+
+@implementation SDServiceJSONDecoder
+
+#pragma mark - Public
+
++ (SDServiceJSONValueType) typeOfValueInData:(NSData*)data
+{
+    SDJSONReader reader = SDJSONReaderMake(data);
+    SDJSONSkipWhitespace(&reader);
+    switch (SDJSONPeek(&reader))
+    {
+        case -1:
+            return SDServiceJSONValueTypeNone;
+        case '{':
+            return SDServiceJSONValueTypeObject;
+        case '[':
+            return SDServiceJSONValueTypeArray;
+        default:
+            return SDServiceJSONValueTypeOther;
+    }
+}
+
++ (id) modelOfClass:(Class)modelClass fromData:(NSData*)data error:(NSError**)error
+{
+    if (!SDJSONDataIsUTF8(data))
+    {
+        id object = [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+        if (object && ![object isKindOfClass:[NSDictionary class]])
+        {
+            SDJSONReader reader = SDJSONReaderMake(data);
+            SDJSONFail(&reader, [NSString stringWithFormat:@"Expected a JSON object for %@", NSStringFromClass(modelClass)], error);
+            return nil;
+        }
+        return object ? [MTLJSONAdapter modelOfClass:modelClass fromJSONDictionary:object error:error] : nil;
+    }
+    
+    SDJSONReader reader = SDJSONReaderMake(data);
+    id model = [self readModelOfClass:modelClass reader:&reader error:error];
+    return model && SDJSONCheckEnd(&reader, error) ? model : nil;
+}
+
++ (NSArray*) modelsOfClass:(Class)modelClass fromData:(NSData*)data error:(NSError**)error
+{
+    return [self modelsOfClass:modelClass fromData:data itemHandler:nil error:error];
+}
+
++ (NSArray*) modelsOfClass:(Class)modelClass fromData:(NSData*)data itemHandler:(void (^)(id))itemHandler error:(NSError**)error
+{
+    if (!SDJSONDataIsUTF8(data))
+    {
+        // MTLJSONAdapter checks the type of the array
+        id object = [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+        NSArray* models = object ? [MTLJSONAdapter modelsOfClass:modelClass fromJSONArray:object error:error] : nil;
+        for (id model in models)
+        {
+            if (itemHandler)
+            {
+                itemHandler(model);
+            }
+        }
+        return models;
+    }
+    
+    SDJSONReader reader = SDJSONReaderMake(data);
+    NSArray* models = [self readModelsOfClass:modelClass allowsNull:NO itemHandler:itemHandler reader:&reader error:error];
+    return models && SDJSONCheckEnd(&reader, error) ? models : nil;
+}
+
+#pragma mark - Decoding plan
+
+/**
+ *  Root node of keys read for the model class, computed once for every class. nil if the class can't be read directly.
+ */
++ (SDServiceJSONDecodingNode*) decodingPlanForModelClass:(Class)modelClass
+{
+    static NSMutableDictionary<NSString*, id>* plans;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        plans = [NSMutableDictionary dictionary];
+    });
+    
+    NSString* className = NSStringFromClass(modelClass);
+    @synchronized (plans)
+    {
+        id plan = plans[className];
+        if (plan)
+        {
+            return plan == [NSNull null] ? nil : plan;
+        }
+    }
+    
+    SDServiceJSONDecodingNode* plan = [self buildDecodingPlanForModelClass:modelClass];
+    @synchronized (plans)
+    {
+        plans[className] = plan ? : [NSNull null];
+    }
+    return plan;
+}
+
++ (SDServiceJSONDecodingNode*) buildDecodingPlanForModelClass:(Class)modelClass
+{
+    if (![MTLJSONAdapter respondsToSelector:@selector(valueTransformersForModelClass:)] || [modelClass respondsToSelector:@selector(classForParsingJSONDictionary:)])
+    {
+        return nil;
+    }
+    
+    NSDictionary* keyPathsByPropertyKey = [modelClass JSONKeyPathsByPropertyKey];
+    NSDictionary* transformers = [MTLJSONAdapter valueTransformersForModelClass:modelClass];
+    NSDictionary<NSString*, Class>* modelClassesByPropertyKey = nil;
+    if ([modelClass respondsToSelector:@selector(JSONDecodingModelClassesByPropertyKey)])
+    {
+        modelClassesByPropertyKey = [modelClass JSONDecodingModelClassesByPropertyKey];
+    }
+    
+    SDServiceJSONDecodingNode* root = [SDServiceJSONDecodingNode new];
+    root.children = [NSMutableArray array];
+    
+    for (NSString* propertyKey in keyPathsByPropertyKey)
+    {
+        id keyPath = keyPathsByPropertyKey[propertyKey];
+        if (![keyPath isKindOfClass:[NSString class]])
+        {
+            // array of key paths
+            return nil;
+        }
+        
+        SDServiceJSONDecodingNode* node = root;
+        NSArray<NSString*>* components = [keyPath componentsSeparatedByString:@"."];
+        for (NSUInteger i = 0; i < components.count; i++)
+        {
+            SDServiceJSONDecodingNode* child = nil;
+            for (SDServiceJSONDecodingNode* existingChild in node.children)
+            {
+                if ([existingChild.key isEqualToString:components[i]])
+                {
+                    child = existingChild;
+                    break;
+                }
+            }
+            
+            BOOL leaf = i == components.count - 1;
+            if (child && (leaf || child.propertyKey))
+            {
+                // a key is both a value and an object, or more properties read the same key
+                return nil;
+            }
+            if (!child)
+            {
+                child = [SDServiceJSONDecodingNode new];
+                child.key = components[i];
+                child.keyData = [child.key dataUsingEncoding:NSUTF8StringEncoding];
+                if (!leaf)
+                {
+                    child.children = [NSMutableArray array];
+                }
+                [node.children addObject:child];
+            }
+            node = child;
+        }
+        
+        node.propertyKey = propertyKey;
+        node.transformer = transformers[propertyKey];
+        
+        BOOL isArrayOfModels = NO;
+        node.modelClass = SDJSONNestedModelClass(modelClass, propertyKey, modelClassesByPropertyKey, &isArrayOfModels);
+        node.isArrayOfModels = isArrayOfModels;
+    }
+    return root;
+}
+
+#pragma mark - Key paths
+
++ (NSArray<NSString*>*) JSONKeyPathsOfModelClass:(Class)modelClass
+{
+    static NSMutableDictionary<NSString*, id>* keyPathsByClassName;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        keyPathsByClassName = [NSMutableDictionary dictionary];
+    });
+    
+    NSString* className = NSStringFromClass(modelClass);
+    @synchronized (keyPathsByClassName)
+    {
+        id keyPaths = keyPathsByClassName[className];
+        if (keyPaths)
+        {
+            return keyPaths == [NSNull null] ? nil : keyPaths;
+        }
+    }
+    
+    NSArray<NSString*>* keyPaths = [[[self collectJSONKeyPathsOfModelClass:modelClass visitedClasses:[NSMutableSet set]] allObjects] sortedArrayUsingSelector:@selector(compare:)];
+    @synchronized (keyPathsByClassName)
+    {
+        keyPathsByClassName[className] = keyPaths ? : [NSNull null];
+    }
+    return keyPaths;
+}
+
+/**
+ *  Key paths read for the model class, nil if all keys of the object may be read (unknown subclass, empty mapping or recursive model).
+ */
++ (NSSet<NSString*>*) collectJSONKeyPathsOfModelClass:(Class)modelClass visitedClasses:(NSMutableSet<Class>*)visitedClasses
+{
+    if (![modelClass conformsToProtocol:@protocol(MTLJSONSerializing)] || [modelClass respondsToSelector:@selector(classForParsingJSONDictionary:)] || [visitedClasses containsObject:modelClass])
+    {
+        return nil;
+    }
+    
+    NSDictionary* keyPathsByPropertyKey = [modelClass JSONKeyPathsByPropertyKey];
+    NSDictionary<NSString*, Class>* modelClassesByPropertyKey = nil;
+    if ([modelClass respondsToSelector:@selector(JSONDecodingModelClassesByPropertyKey)])
+    {
+        modelClassesByPropertyKey = [modelClass JSONDecodingModelClassesByPropertyKey];
+    }
+    
+    [visitedClasses addObject:modelClass];
+    NSMutableSet<NSString*>* keyPaths = [NSMutableSet set];
+    for (NSString* propertyKey in keyPathsByPropertyKey)
+    {
+        id keyPath = keyPathsByPropertyKey[propertyKey];
+        NSArray<NSString*>* propertyKeyPaths = [keyPath isKindOfClass:[NSArray class]] ? keyPath : @[keyPath];
+        
+        // a nested model reads only its own key paths, an array of models the key paths of every item
+        BOOL isArrayOfModels = NO;
+        Class nestedModelClass = SDJSONNestedModelClass(modelClass, propertyKey, modelClassesByPropertyKey, &isArrayOfModels);
+        NSSet<NSString*>* nestedKeyPaths = nestedModelClass && propertyKeyPaths.count == 1 ? [self collectJSONKeyPathsOfModelClass:nestedModelClass visitedClasses:visitedClasses] : nil;
+        for (NSString* propertyKeyPath in propertyKeyPaths)
+        {
+            if (nestedKeyPaths.count == 0)
+            {
+                [keyPaths addObject:propertyKeyPath];
+                continue;
+            }
+            for (NSString* nestedKeyPath in nestedKeyPaths)
+            {
+                [keyPaths addObject:[NSString stringWithFormat:@"%@.%@", propertyKeyPath, nestedKeyPath]];
+            }
+        }
+    }
+    // the same class can be nested again in another branch
+    [visitedClasses removeObject:modelClass];
+    return keyPaths.count > 0 ? keyPaths : nil;
+}
+
+#pragma mark - Reading
+
++ (id) readModelOfClass:(Class)modelClass reader:(SDJSONReader*)reader error:(NSError**)error
+{
+    SDServiceJSONDecodingNode* plan = [self decodingPlanForModelClass:modelClass];
+    SDJSONSkipWhitespace(reader);
+    if (SDJSONPeek(reader) != '{')
+    {
+        SDJSONFail(reader, [NSString stringWithFormat:@"Expected a JSON object for %@", NSStringFromClass(modelClass)], error);
+        return nil;
+    }
+    
+    if (!plan)
+    {
+        NSDictionary* dictionary = SDJSONReadValue(reader, error);
+        return dictionary ? [MTLJSONAdapter modelOfClass:modelClass fromJSONDictionary:dictionary error:error] : nil;
+    }
+    
+    // same steps of MTLJSONAdapter, with values read from data instead of a dictionary
+    NSMutableDictionary* dictionaryValue = [NSMutableDictionary dictionary];
+    if (![self readObjectOfNode:plan intoDictionaryValue:dictionaryValue reader:reader error:error])
+    {
+        return nil;
+    }
+    id model = [modelClass modelWithDictionary:dictionaryValue error:error];
+    return [model validate:error] ? model : nil;
+}
+
+/**
+ *  Array of models. With allowsNull null items are added as NSNull, as arrayTransformerWithModelClass: does. itemHandler is called with every item added.
+ */
++ (NSArray*) readModelsOfClass:(Class)modelClass allowsNull:(BOOL)allowsNull itemHandler:(void (^)(id))itemHandler reader:(SDJSONReader*)reader error:(NSError**)error
+{
+    SDJSONSkipWhitespace(reader);
+    BOOL empty = NO;
+    if (SDJSONPeek(reader) != '[')
+    {
+        SDJSONFail(reader, [NSString stringWithFormat:@"Expected a JSON array of %@", NSStringFromClass(modelClass)], error);
+        return nil;
+    }
+    if (!SDJSONBeginContainer(reader, ']', &empty, error))
+    {
+        return nil;
+    }
+    
+    NSMutableArray* models = [NSMutableArray array];
+    BOOL more = !empty;
+    while (more)
+    {
+        id model = nil;
+        if (allowsNull && SDJSONPeek(reader) == 'n')
+        {
+            model = SDJSONReadLiteral(reader, error);
+        }
+        else
+        {
+            model = [self readModelOfClass:modelClass reader:reader error:error];
+        }
+        if (!model)
+        {
+            return nil;
+        }
+        [models addObject:model];
+        if (itemHandler)
+        {
+            itemHandler(model);
+        }
+        if (!SDJSONNextInContainer(reader, ']', &more, error))
+        {
+            return nil;
+        }
+    }
+    return models;
+}
+
+/**
+ *  Read the object at position: values of mapped keys are added to dictionaryValue, the others are skipped.
+ */
++ (BOOL) readObjectOfNode:(SDServiceJSONDecodingNode*)node intoDictionaryValue:(NSMutableDictionary*)dictionaryValue reader:(SDJSONReader*)reader error:(NSError**)error
+{
+    BOOL empty = NO;
+    if (!SDJSONBeginContainer(reader, '}', &empty, error))
+    {
+        return NO;
+    }
+    
+    BOOL more = !empty;
+    while (more)
+    {
+        NSRange keyRange;
+        BOOL hasEscapes = NO;
+        if (!SDJSONScanKey(reader, &keyRange, &hasEscapes, error))
+        {
+            return NO;
+        }
+        
+        SDServiceJSONDecodingNode* child = SDJSONChildWithKey(node, reader->bytes + keyRange.location, keyRange.length, hasEscapes);
+        BOOL success = YES;
+        if (!child)
+        {
+            success = SDJSONSkipValue(reader, error);
+        }
+        else if (child.children)
+        {
+            success = [self readKeyPathComponentOfNode:child intoDictionaryValue:dictionaryValue reader:reader error:error];
+        }
+        else
+        {
+            success = [self readValueOfNode:child intoDictionaryValue:dictionaryValue reader:reader error:error];
+        }
+        if (!success || !SDJSONNextInContainer(reader, '}', &more, error))
+        {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+/**
+ *  Value of an intermediate component of key paths, with the same rules of mtl_valueForJSONKeyPath:success:error:.
+ */
++ (BOOL) readKeyPathComponentOfNode:(SDServiceJSONDecodingNode*)node intoDictionaryValue:(NSMutableDictionary*)dictionaryValue reader:(SDJSONReader*)reader error:(NSError**)error
+{
+    int byte = SDJSONPeek(reader);
+    if (byte == '{')
+    {
+        return [self readObjectOfNode:node intoDictionaryValue:dictionaryValue reader:reader error:error];
+    }
+    if (byte == 'n')
+    {
+        // key paths through null give null
+        return SDJSONReadLiteral(reader, error) && [self setNullForNode:node intoDictionaryValue:dictionaryValue error:error];
+    }
+    
+    if (error)
+    {
+        *error = [NSError errorWithDomain:MTLJSONAdapterErrorDomain code:MTLJSONAdapterErrorInvalidJSONDictionary userInfo:@{ NSLocalizedDescriptionKey : @"Invalid JSON dictionary", NSLocalizedFailureReasonErrorKey : [NSString stringWithFormat:@"JSON key path component %@ could not be resolved because it is not a JSON dictionary", node.key] }];
+    }
+    return NO;
+}
+
++ (BOOL) setNullForNode:(SDServiceJSONDecodingNode*)node intoDictionaryValue:(NSMutableDictionary*)dictionaryValue error:(NSError**)error
+{
+    if (!node.children)
+    {
+        return [self setValue:[NSNull null] forNode:node intoDictionaryValue:dictionaryValue error:error];
+    }
+    for (SDServiceJSONDecodingNode* child in node.children)
+    {
+        if (![self setNullForNode:child intoDictionaryValue:dictionaryValue error:error])
+        {
+            return NO;
+        }
+    }
+    return YES;
+}
+
++ (BOOL) readValueOfNode:(SDServiceJSONDecodingNode*)node intoDictionaryValue:(NSMutableDictionary*)dictionaryValue reader:(SDJSONReader*)reader error:(NSError**)error
+{
+    int byte = SDJSONPeek(reader);
+    if (node.modelClass && byte == (node.isArrayOfModels ? '[' : '{'))
+    {
+        id value = nil;
+        if (node.isArrayOfModels)
+        {
+            value = [self readModelsOfClass:node.modelClass allowsNull:YES itemHandler:nil reader:reader error:error];
+        }
+        else
+        {
+            value = [self readModelOfClass:node.modelClass reader:reader error:error];
+        }
+        if (!value)
+        {
+            return NO;
+        }
+        dictionaryValue[node.propertyKey] = value;
+        return YES;
+    }
+    if (node.modelClass && byte == 'n')
+    {
+        // model transformers give nil for null
+        if (!SDJSONReadLiteral(reader, error))
+        {
+            return NO;
+        }
+        dictionaryValue[node.propertyKey] = [NSNull null];
+        return YES;
+    }
+    
+    id value = SDJSONReadValue(reader, error);
+    return value && [self setValue:value forNode:node intoDictionaryValue:dictionaryValue error:error];
+}
+
+/**
+ *  Transform the JSON value and add it to dictionaryValue, as MTLJSONAdapter does.
+ */
++ (BOOL) setValue:(id)value forNode:(SDServiceJSONDecodingNode*)node intoDictionaryValue:(NSMutableDictionary*)dictionaryValue error:(NSError**)error
+{
+    NSValueTransformer* transformer = node.transformer;
+    if (transformer)
+    {
+        @try
+        {
+            if (value == [NSNull null])
+            {
+                value = nil;
+            }
+            if ([transformer respondsToSelector:@selector(transformedValue:success:error:)])
+            {
+                BOOL success = YES;
+                value = [(id<MTLTransformerErrorHandling>)transformer transformedValue:value success:&success error:error];
+                if (!success)
+                {
+                    return NO;
+                }
+            }
+            else
+            {
+                value = [transformer transformedValue:value];
+            }
+            if (value == nil)
+            {
+                value = [NSNull null];
+            }
+        }
+        @catch (NSException* exception)
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:MTLJSONAdapterErrorDomain code:MTLJSONAdapterErrorExceptionThrown userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Caught exception parsing JSON key \"%@\" for property: %@", node.key, node.propertyKey], NSLocalizedFailureReasonErrorKey : exception.reason ? : @"", MTLJSONAdapterThrownExceptionErrorKey : exception }];
+            }
+            return NO;
+        }
+    }
+    dictionaryValue[node.propertyKey] = value;
+    return YES;
+}
+
+@end
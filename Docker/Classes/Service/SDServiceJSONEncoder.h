@@ -0,0 +1,41 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import <Mantle/Mantle.h>
+
+/**
+ *  Writes UTF-8 JSON directly from Mantle models, in a single walk of the model, without building intermediate dictionaries.
+ *
+ *  Models are written following their JSONKeyPathsByPropertyKey and value transformers, as MTLJSONAdapter does; nested models without a custom transformer are written in the same walk.
+ *  Models mapping a property to an array of key paths are converted with MTLJSONAdapter and then written.
+ *  With removeNilValues, null values are removed while writing with the same rules of pruneNullValues of NSDictionary+Docker.
+ */
+@interface SDServiceJSONEncoder : NSObject
+
+/**
+ *  JSON of model, with additionalParameters added to the top level object (they replace model values with the same key).
+ *
+ *  @return UTF-8 JSON data, or nil in case of failure (error object will be instantiated).
+ */
++ (NSData* _Nullable) dataWithModel:(MTLModel<MTLJSONSerializing>* _Nonnull)model additionalParameters:(NSDictionary* _Nullable)additionalParameters removeNilValues:(BOOL)removeNilValues error:(NSError* _Nullable * _Nullable)error;
+
+/**
+ *  JSON of a dictionary or an array of JSON values (NSDictionary, NSArray, NSString, NSNumber, NSNull).
+ *
+ *  @return UTF-8 JSON data, or nil in case of failure (error object will be instantiated).
+ */
++ (NSData* _Nullable) dataWithJSONObject:(id _Nonnull)object removeNilValues:(BOOL)removeNilValues error:(NSError* _Nullable * _Nullable)error;
+
+@end
@@ -0,0 +1,565 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceJSONEncoder.h"
+
+#define JSONEncoderErrorDomain      @"JSON_ENCODER"
+#define JSONEncoderInitialCapacity  1024
+
+/**
+ *  Value transformers of a model class, computed by MTLJSONAdapter (declared in its class extension).
+ */
+@interface MTLJSONAdapter (SDServiceJSONEncoder)
+
++ (NSDictionary*) valueTransformersForModelClass:(Class)modelClass;
+
+@end
+
+/**
+ *  Key of a JSON object written for a model: a property (leaf) or an object with other keys (intermediate component of key paths like "a.b").
+ */
+@interface SDServiceJSONEncodingNode : NSObject
+
+@property (nonatomic, strong) NSString* key;
+
+/**
+ *  "key": already escaped.
+ */
+@property (nonatomic, strong) NSData* encodedKey;
+
+@property (nonatomic, strong) NSString* propertyKey;
+@property (nonatomic, strong) NSValueTransformer* transformer;
+
+/**
+ *  Transformer is set by the model class: nested models are written by the transformer and not directly.
+ */
+@property (nonatomic, assign) BOOL hasCustomTransformer;
+
+@property (nonatomic, strong) NSMutableArray<SDServiceJSONEncodingNode*>* children;
+
+@end
+
+@implementation SDServiceJSONEncodingNode
+
+@end
+
+
+
+static NSError* SDJSONEncoderError(NSString* message)
+{
+    return [NSError errorWithDomain:JSONEncoderErrorDomain code:-1 userInfo:@{ NSLocalizedDescriptionKey : message }];
+}
+
+static inline void SDJSONAppendByte(NSMutableData* data, char byte)
+{
+    [data appendBytes:&byte length:1];
+}
+
+static void SDJSONAppendString(NSMutableData* data, NSString* string)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    
+    SDJSONAppendByte(data, '"');
+    
+    NSUInteger length = string.length;
+    NSRange range = NSMakeRange(0, length);
+    uint8_t buffer[512];
+    while (range.length > 0)
+    {
+        NSUInteger usedLength = 0;
+        NSRange remainingRange;
+        [string getBytes:buffer maxLength:sizeof(buffer) usedLength:&usedLength encoding:NSUTF8StringEncoding options:0 range:range remainingRange:&remainingRange];
+        if (usedLength == 0)
+        {
+            break;
+        }
+        range = remainingRange;
+        
+        // copy runs of bytes that don't need escape
+        NSUInteger runStart = 0;
+        for (NSUInteger i = 0; i < usedLength; i++)
+        {
+            uint8_t byte = buffer[i];
+            if (byte >= 0x20 && byte != '"' && byte != '\\')
+            {
+                continue;
+            }
+            if (i > runStart)
+            {
+                [data appendBytes:buffer + runStart length:i - runStart];
+            }
+            runStart = i + 1;
+            switch (byte)
+            {
+                case '"': [data appendBytes:"\\\"" length:2]; break;
+                case '\\': [data appendBytes:"\\\\" length:2]; break;
+                case '\n': [data appendBytes:"\\n" length:2]; break;
+                case '\r': [data appendBytes:"\\r" length:2]; break;
+                case '\t': [data appendBytes:"\\t" length:2]; break;
+                case '\b': [data appendBytes:"\\b" length:2]; break;
+                case '\f': [data appendBytes:"\\f" length:2]; break;
+                default: {
+                    char escaped[6] = { '\\', 'u', '0', '0', hexDigits[byte >> 4], hexDigits[byte & 0xF] };
+                    [data appendBytes:escaped length:6];
+                    break;
+                }
+            }
+        }
+        if (usedLength > runStart)
+        {
+            [data appendBytes:buffer + runStart length:usedLength - runStart];
+        }
+    }
+    
+    SDJSONAppendByte(data, '"');
+}
+
+static BOOL SDJSONAppendNumber(NSMutableData* data, NSNumber* number, NSError** error)
+{
+    if ((__bridge CFBooleanRef)number == kCFBooleanTrue)
+    {
+        [data appendBytes:"true" length:4];
+        return YES;
+    }
+    if ((__bridge CFBooleanRef)number == kCFBooleanFalse)
+    {
+        [data appendBytes:"false" length:5];
+        return YES;
+    }
+    if ([number isKindOfClass:[NSDecimalNumber class]])
+    {
+        if (isnan(number.doubleValue))
+        {
+            if (error)
+            {
+                *error = SDJSONEncoderError(@"Invalid number value (NaN) in JSON write");
+            }
+            return NO;
+        }
+        NSString* string = number.description;
+        [data appendBytes:string.UTF8String length:[string lengthOfBytesUsingEncoding:NSUTF8StringEncoding]];
+        return YES;
+    }
+    
+    char buffer[32];
+    int length = 0;
+    switch (number.objCType[0])
+    {
+        case 'f':
+        case 'd': {
+            double value = number.doubleValue;
+            if (!isfinite(value))
+            {
+                if (error)
+                {
+                    *error = SDJSONEncoderError(@"Invalid number value (NaN or infinity) in JSON write");
+                }
+                return NO;
+            }
+            // shortest representation that reads back the same value
+            length = snprintf(buffer, sizeof(buffer), "%.15g", value);
+            if (strtod(buffer, NULL) != value)
+            {
+                length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+            }
+            break;
+        }
+        case 'Q':
+        case 'L':
+        case 'I':
+        case 'S':
+            length = snprintf(buffer, sizeof(buffer), "%llu", number.unsignedLongLongValue);
+            break;
+        default:
+            length = snprintf(buffer, sizeof(buffer), "%lld", number.longLongValue);
+            break;
+    }
+    [data appendBytes:buffer length:length];
+    return YES;
+}
+
+@implementation SDServiceJSONEncoder
+
+#pragma mark - Public
+
++ (NSData*) dataWithModel:(MTLModel<MTLJSONSerializing>*)model additionalParameters:(NSDictionary*)additionalParameters removeNilValues:(BOOL)removeNilValues error:(NSError**)error
+{
+    NSMutableData* data = [NSMutableData dataWithCapacity:JSONEncoderInitialCapacity];
+    if (![self appendModel:model additionalParameters:additionalParameters removeNilValues:removeNilValues toData:data error:error])
+    {
+        return nil;
+    }
+    return data;
+}
+
++ (NSData*) dataWithJSONObject:(id)object removeNilValues:(BOOL)removeNilValues error:(NSError**)error
+{
+    NSMutableData* data = [NSMutableData dataWithCapacity:JSONEncoderInitialCapacity];
+    if (![self appendValue:object pruning:removeNilValues toData:data error:error])
+    {
+        return nil;
+    }
+    return data;
+}
+
+#pragma mark - Encoding plan
+
+/**
+ *  Root node of keys written for the model class, computed once for every class. nil if the class can't be written directly.
+ */
++ (SDServiceJSONEncodingNode*) encodingPlanForModelClass:(Class)modelClass
+{
+    static NSMutableDictionary<NSString*, id>* plans;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        plans = [NSMutableDictionary dictionary];
+    });
+    
+    NSString* className = NSStringFromClass(modelClass);
+    @synchronized (plans)
+    {
+        id plan = plans[className];
+        if (plan)
+        {
+            return plan == [NSNull null] ? nil : plan;
+        }
+    }
+    
+    SDServiceJSONEncodingNode* plan = [self buildEncodingPlanForModelClass:modelClass];
+    @synchronized (plans)
+    {
+        plans[className] = plan ? : [NSNull null];
+    }
+    return plan;
+}
+
++ (SDServiceJSONEncodingNode*) buildEncodingPlanForModelClass:(Class)modelClass
+{
+    if (![MTLJSONAdapter respondsToSelector:@selector(valueTransformersForModelClass:)])
+    {
+        return nil;
+    }
+    
+    NSDictionary* keyPathsByPropertyKey = [modelClass JSONKeyPathsByPropertyKey];
+    NSDictionary* transformers = [MTLJSONAdapter valueTransformersForModelClass:modelClass];
+    
+    SDServiceJSONEncodingNode* root = [SDServiceJSONEncodingNode new];
+    root.children = [NSMutableArray array];
+    
+    // sorted property keys: same bytes for the same model at every call
+    for (NSString* propertyKey in [keyPathsByPropertyKey.allKeys sortedArrayUsingSelector:@selector(compare:)])
+    {
+        id keyPath = keyPathsByPropertyKey[propertyKey];
+        if (![keyPath isKindOfClass:[NSString class]])
+        {
+            // array of key paths
+            return nil;
+        }
+        
+        SDServiceJSONEncodingNode* node = root;
+        NSArray<NSString*>* components = [keyPath componentsSeparatedByString:@"."];
+        for (NSUInteger i = 0; i < components.count; i++)
+        {
+            SDServiceJSONEncodingNode* child = nil;
+            for (SDServiceJSONEncodingNode* existingChild in node.children)
+            {
+                if ([existingChild.key isEqualToString:components[i]])
+                {
+                    child = existingChild;
+                    break;
+                }
+            }
+            
+            BOOL leaf = i == components.count - 1;
+            if (child && (leaf || child.propertyKey))
+            {
+                // a key is both a value and an object
+                return nil;
+            }
+            if (!child)
+            {
+                child = [SDServiceJSONEncodingNode new];
+                child.key = components[i];
+                NSMutableData* encodedKey = [NSMutableData data];
+                SDJSONAppendString(encodedKey, child.key);
+                SDJSONAppendByte(encodedKey, ':');
+                child.encodedKey = encodedKey;
+                if (!leaf)
+                {
+                    child.children = [NSMutableArray array];
+                }
+                [node.children addObject:child];
+            }
+            node = child;
+        }
+        
+        node.propertyKey = propertyKey;
+        node.transformer = transformers[propertyKey];
+        node.hasCustomTransformer = [modelClass respondsToSelector:NSSelectorFromString([propertyKey stringByAppendingString:@"JSONTransformer"])] || ([modelClass respondsToSelector:@selector(JSONTransformerForKey:)] && [modelClass JSONTransformerForKey:propertyKey] != nil);
+    }
+    return root;
+}
+
+#pragma mark - Writing
+
++ (BOOL) appendModel:(MTLModel<MTLJSONSerializing>*)model additionalParameters:(NSDictionary*)additionalParameters removeNilValues:(BOOL)removeNilValues toData:(NSMutableData*)data error:(NSError**)error
+{
+    SDServiceJSONEncodingNode* plan = [self encodingPlanForModelClass:[model class]];
+    if (!plan)
+    {
+        NSMutableDictionary* dictionary = [[MTLJSONAdapter JSONDictionaryFromModel:model error:error] mutableCopy];
+        if (!dictionary)
+        {
+            return NO;
+        }
+        [dictionary addEntriesFromDictionary:additionalParameters];
+        return [self appendValue:dictionary pruning:removeNilValues toData:data error:error];
+    }
+    
+    SDJSONAppendByte(data, '{');
+    BOOL first = YES;
+    for (SDServiceJSONEncodingNode* node in plan.children)
+    {
+        if (additionalParameters[node.key])
+        {
+            continue;
+        }
+        if (![self appendNode:node ofModel:model removeNilValues:removeNilValues first:&first toData:data error:error])
+        {
+            return NO;
+        }
+    }
+    for (NSString* key in additionalParameters)
+    {
+        if (![self appendKey:key value:additionalParameters[key] pruning:removeNilValues first:&first toData:data error:error])
+        {
+            return NO;
+        }
+    }
+    SDJSONAppendByte(data, '}');
+    return YES;
+}
+
+/**
+ *  Append "key":value of the node. Nothing is appended if the value is removed.
+ */
++ (BOOL) appendNode:(SDServiceJSONEncodingNode*)node ofModel:(MTLModel<MTLJSONSerializing>*)model removeNilValues:(BOOL)removeNilValues first:(BOOL*)first toData:(NSMutableData*)data error:(NSError**)error
+{
+    NSUInteger mark = data.length;
+    if (node.children)
+    {
+        if (!*first)
+        {
+            SDJSONAppendByte(data, ',');
+        }
+        [data appendData:node.encodedKey];
+        
+        // object of a key path component: removed if empty
+        NSUInteger objectStart = data.length;
+        SDJSONAppendByte(data, '{');
+        BOOL firstChild = YES;
+        for (SDServiceJSONEncodingNode* child in node.children)
+        {
+            if (![self appendNode:child ofModel:model removeNilValues:removeNilValues first:&firstChild toData:data error:error])
+            {
+                return NO;
+            }
+        }
+        SDJSONAppendByte(data, '}');
+        if (removeNilValues && data.length == objectStart + 2)
+        {
+            data.length = mark;
+            return YES;
+        }
+        *first = NO;
+        return YES;
+    }
+    
+    id value = [model valueForKey:node.propertyKey];
+    
+    if (!node.hasCustomTransformer && [value isKindOfClass:[MTLModel class]] && [value conformsToProtocol:@protocol(MTLJSONSerializing)])
+    {
+        // nested model written in the same walk
+        if (!*first)
+        {
+            SDJSONAppendByte(data, ',');
+        }
+        [data appendData:node.encodedKey];
+        NSUInteger objectStart = data.length;
+        if (![self appendModel:value additionalParameters:nil removeNilValues:removeNilValues toData:data error:error])
+        {
+            return NO;
+        }
+        if (removeNilValues && data.length == objectStart + 2)
+        {
+            data.length = mark;
+            return YES;
+        }
+        *first = NO;
+        return YES;
+    }
+    
+    // same rules of MTLJSONAdapter
+    NSValueTransformer* transformer = node.transformer;
+    if (value == nil)
+    {
+        value = [NSNull null];
+    }
+    if (transformer && [transformer.class allowsReverseTransformation])
+    {
+        if (value == [NSNull null])
+        {
+            value = nil;
+        }
+        if ([transformer respondsToSelector:@selector(reverseTransformedValue:success:error:)])
+        {
+            BOOL success = YES;
+            value = [(id<MTLTransformerErrorHandling>)transformer reverseTransformedValue:value success:&success error:error];
+            if (!success)
+            {
+                return NO;
+            }
+            if (!value)
+            {
+                // MTLJSONAdapter doesn't set the key
+                return YES;
+            }
+        }
+        else
+        {
+            value = [transformer reverseTransformedValue:value] ? : [NSNull null];
+        }
+    }
+    
+    return [self appendKey:nil value:value encodedKey:node.encodedKey pruning:removeNilValues first:first toData:data error:error];
+}
+
++ (BOOL) appendKey:(NSString*)key value:(id)value pruning:(BOOL)pruning first:(BOOL*)first toData:(NSMutableData*)data error:(NSError**)error
+{
+    return [self appendKey:key value:value encodedKey:nil pruning:pruning first:first toData:data error:error];
+}
+
+/**
+ *  Append "key":value to an object, with the rules of pruneNullValues when pruning: null values are removed, dictionaries are pruned and removed if empty, dictionaries inside arrays are pruned and removed if empty.
+ */
++ (BOOL) appendKey:(NSString*)key value:(id)value encodedKey:(NSData*)encodedKey pruning:(BOOL)pruning first:(BOOL*)first toData:(NSMutableData*)data error:(NSError**)error
+{
+    if (pruning && value == [NSNull null])
+    {
+        return YES;
+    }
+    
+    NSUInteger mark = data.length;
+    if (!*first)
+    {
+        SDJSONAppendByte(data, ',');
+    }
+    if (encodedKey)
+    {
+        [data appendData:encodedKey];
+    }
+    else
+    {
+        if (![key isKindOfClass:[NSString class]])
+        {
+            if (error)
+            {
+                *error = SDJSONEncoderError(@"Invalid (non-string) key in JSON dictionary");
+            }
+            return NO;
+        }
+        SDJSONAppendString(data, key);
+        SDJSONAppendByte(data, ':');
+    }
+    
+    NSUInteger valueStart = data.length;
+    if (![self appendValue:value pruning:pruning toData:data error:error])
+    {
+        return NO;
+    }
+    if (pruning && [value isKindOfClass:[NSDictionary class]] && data.length == valueStart + 2)
+    {
+        data.length = mark;
+        return YES;
+    }
+    *first = NO;
+    return YES;
+}
+
++ (BOOL) appendValue:(id)value pruning:(BOOL)pruning toData:(NSMutableData*)data error:(NSError**)error
+{
+    if ([value isKindOfClass:[NSString class]])
+    {
+        SDJSONAppendString(data, value);
+    }
+    else if ([value isKindOfClass:[NSNumber class]])
+    {
+        return SDJSONAppendNumber(data, value, error);
+    }
+    else if (value == nil || value == [NSNull null])
+    {
+        [data appendBytes:"null" length:4];
+    }
+    else if ([value isKindOfClass:[NSDictionary class]])
+    {
+        SDJSONAppendByte(data, '{');
+        BOOL first = YES;
+        for (id key in (NSDictionary*)value)
+        {
+            if (![self appendKey:key value:((NSDictionary*)value)[key] pruning:pruning first:&first toData:data error:error])
+            {
+                return NO;
+            }
+        }
+        SDJSONAppendByte(data, '}');
+    }
+    else if ([value isKindOfClass:[NSArray class]])
+    {
+        SDJSONAppendByte(data, '[');
+        BOOL first = YES;
+        for (id item in (NSArray*)value)
+        {
+            NSUInteger mark = data.length;
+            if (!first)
+            {
+                SDJSONAppendByte(data, ',');
+            }
+            // pruneNullValues prunes only dictionaries inside arrays
+            BOOL prunesItem = pruning && [item isKindOfClass:[NSDictionary class]];
+            NSUInteger itemStart = data.length;
+            if (![self appendValue:item pruning:prunesItem toData:data error:error])
+            {
+                return NO;
+            }
+            if (prunesItem && data.length == itemStart + 2)
+            {
+                data.length = mark;
+                continue;
+            }
+            first = NO;
+        }
+        SDJSONAppendByte(data, ']');
+    }
+    else
+    {
+        if (error)
+        {
+            *error = SDJSONEncoderError([NSString stringWithFormat:@"Invalid type in JSON write (%@)", NSStringFromClass([value class])]);
+        }
+        return NO;
+    }
+    return YES;
+}
+
+@end
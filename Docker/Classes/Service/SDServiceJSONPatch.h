@@ -0,0 +1,56 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceJSONPatchErrorDomain;
+
+typedef NS_ENUM (NSInteger, SDServiceJSONPatchErrorCode)
+{
+    /**
+     *  Patch is not an array of valid operations (unknown op, missing path, value or from, invalid JSON Pointer).
+     */
+    SDServiceJSONPatchErrorCodeInvalidPatch = -1,
+    /**
+     *  Path (or from) of an operation doesn't exist in the document, or an array index is out of bounds.
+     */
+    SDServiceJSONPatchErrorCodePathNotFound = -2,
+    /**
+     *  Value of a test operation is different from the value in the document.
+     */
+    SDServiceJSONPatchErrorCodeTestFailed = -3,
+    /**
+     *  Patch was made for another version of the document (ex. Delta-Base of a delta response different from the cached ETag).
+     */
+    SDServiceJSONPatchErrorCodeBaseMismatch = -4,
+};
+
+/**
+ *  JSON Patch (RFC 6902) of JSON objects (as returned by NSJSONSerialization): add, remove, replace, move, copy and test operations, with paths in JSON Pointer syntax (RFC 6901).
+ */
+@interface SDServiceJSONPatch : NSObject
+
+/**
+ *  Apply all operations of patch in order, or none of them.
+ *  The document is never modified: only the containers on the paths of operations are copied, so untouched parts of the result are the same instances of the document.
+ *
+ *  @param patch    array of operations.
+ *  @param object   document (NSDictionary or NSArray).
+ *  @param error    possible error applying the patch (passed by reference).
+ *
+ *  @return patched document, or nil if an operation fails.
+ */
++ (id _Nullable) objectByApplyingPatch:(NSArray* _Nonnull)patch toObject:(id _Nonnull)object error:(NSError* _Nullable * _Nullable)error;
+
+@end
@@ -0,0 +1,437 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceJSONPatch.h"
+
+NSString* const SDServiceJSONPatchErrorDomain = @"SDServiceJSONPatchErrorDomain";
+
+/**
+ *  State of a patch being applied.
+ */
+@interface SDServiceJSONPatchApplication : NSObject
+
+- (instancetype) initWithDocument:(id)document;
+
+@property (nonatomic, strong) id document;
+
+/**
+ *  Containers copied by this patch: next operations modify them in place.
+ */
+@property (nonatomic, strong) NSHashTable* copiedContainers;
+
+@property (nonatomic, strong) NSError* error;
+
+- (BOOL) applyOperation:(id)operation;
+- (BOOL) failWithCode:(SDServiceJSONPatchErrorCode)code description:(NSString*)description;
+
+@end
+
+@implementation SDServiceJSONPatchApplication
+
+- (instancetype) initWithDocument:(id)document
+{
+    self = [super init];
+    if (self)
+    {
+        self.document = document;
+        self.copiedContainers = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality capacity:0];
+    }
+    return self;
+}
+
+- (BOOL) failWithCode:(SDServiceJSONPatchErrorCode)code description:(NSString*)description
+{
+    if (!self.error)
+    {
+        self.error = [NSError errorWithDomain:SDServiceJSONPatchErrorDomain code:code userInfo:@{ NSLocalizedDescriptionKey : description }];
+    }
+    return NO;
+}
+
+- (BOOL) applyOperation:(id)operation
+{
+    if (![operation isKindOfClass:[NSDictionary class]] || ![operation[@"op"] isKindOfClass:[NSString class]])
+    {
+        return [self failWithCode:SDServiceJSONPatchErrorCodeInvalidPatch description:[NSString stringWithFormat:@"Invalid operation %@", operation]];
+    }
+    NSString* op = operation[@"op"];
+    NSString* path = operation[@"path"];
+    NSArray<NSString*>* tokens = [self tokensOfPointer:path];
+    if (!tokens)
+    {
+        return NO;
+    }
+    
+    id value = operation[@"value"];
+    if (!value && ([op isEqualToString:@"add"] || [op isEqualToString:@"replace"] || [op isEqualToString:@"test"]))
+    {
+        return [self failWithCode:SDServiceJSONPatchErrorCodeInvalidPatch description:[NSString stringWithFormat:@"Operation %@ of %@ without value", op, path]];
+    }
+    
+    if ([op isEqualToString:@"add"])
+    {
+        return [self addValue:value atTokens:tokens pointer:path];
+    }
+    if ([op isEqualToString:@"remove"])
+    {
+        return [self removeValueAtTokens:tokens pointer:path] != nil;
+    }
+    if ([op isEqualToString:@"replace"])
+    {
+        return [self replaceValue:value atTokens:tokens pointer:path];
+    }
+    if ([op isEqualToString:@"test"])
+    {
+        id currentValue = [self valueAtTokens:tokens pointer:path];
+        if (currentValue && ![currentValue isEqual:value])
+        {
+            return [self failWithCode:SDServiceJSONPatchErrorCodeTestFailed description:[NSString stringWithFormat:@"Test of %@ failed", path]];
+        }
+        return currentValue != nil;
+    }
+    
+    if ([op isEqualToString:@"move"] || [op isEqualToString:@"copy"])
+    {
+        NSString* from = operation[@"from"];
+        NSArray<NSString*>* fromTokens = [self tokensOfPointer:from];
+        if (!fromTokens)
+        {
+            return NO;
+        }
+        if ([op isEqualToString:@"copy"])
+        {
+            id copiedValue = [self valueAtTokens:fromTokens pointer:from];
+            return copiedValue && [self addValue:[self sharedValue:copiedValue] atTokens:tokens pointer:path];
+        }
+        if ([path isEqualToString:from])
+        {
+            return YES;
+        }
+        if ([path hasPrefix:[from stringByAppendingString:@"/"]])
+        {
+            return [self failWithCode:SDServiceJSONPatchErrorCodeInvalidPatch description:[NSString stringWithFormat:@"Can't move %@ into its child %@", from, path]];
+        }
+        id movedValue = [self removeValueAtTokens:fromTokens pointer:from];
+        return movedValue && [self addValue:movedValue atTokens:tokens pointer:path];
+    }
+    
+    return [self failWithCode:SDServiceJSONPatchErrorCodeInvalidPatch description:[NSString stringWithFormat:@"Unknown operation %@", op]];
+}
+
+#pragma mark - Pointers
+
+/**
+ *  Reference tokens of a JSON Pointer (empty for the whole document).
+ */
+- (NSArray<NSString*>*) tokensOfPointer:(id)pointer
+{
+    if (![pointer isKindOfClass:[NSString class]] || ([pointer length] > 0 && ![pointer hasPrefix:@"/"]))
+    {
+        [self failWithCode:SDServiceJSONPatchErrorCodeInvalidPatch description:[NSString stringWithFormat:@"Invalid pointer %@", pointer]];
+        return nil;
+    }
+    if ([pointer length] == 0)
+    {
+        return @[];
+    }
+    NSArray<NSString*>* components = [[pointer substringFromIndex:1] componentsSeparatedByString:@"/"];
+    NSMutableArray<NSString*>* tokens = [NSMutableArray arrayWithCapacity:components.count];
+    for (NSString* component in components)
+    {
+        if ([component rangeOfString:@"~"].location == NSNotFound)
+        {
+            [tokens addObject:component];
+        }
+        else
+        {
+            [tokens addObject:[[component stringByReplacingOccurrencesOfString:@"~1" withString:@"/"] stringByReplacingOccurrencesOfString:@"~0" withString:@"~"]];
+        }
+    }
+    return tokens;
+}
+
+/**
+ *  Index of an array element, NSNotFound if token is not an index of the array. "-" (end of the array) is allowed only to add elements.
+ */
+- (NSUInteger) indexOfToken:(NSString*)token inArray:(NSArray*)array allowsEnd:(BOOL)allowsEnd pointer:(NSString*)pointer
+{
+    if (allowsEnd && [token isEqualToString:@"-"])
+    {
+        return array.count;
+    }
+    static NSCharacterSet* nonDigits = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        nonDigits = [[NSCharacterSet characterSetWithCharactersInString:@"0123456789"] invertedSet];
+    });
+    if (token.length == 0 || (token.length > 1 && [token characterAtIndex:0] == '0') || [token rangeOfCharacterFromSet:nonDigits].location != NSNotFound)
+    {
+        [self failWithCode:SDServiceJSONPatchErrorCodePathNotFound description:[NSString stringWithFormat:@"Invalid array index in %@", pointer]];
+        return NSNotFound;
+    }
+    unsigned long long index = strtoull(token.UTF8String, NULL, 10);
+    if (index > array.count || (!allowsEnd && index == array.count))
+    {
+        [self failWithCode:SDServiceJSONPatchErrorCodePathNotFound description:[NSString stringWithFormat:@"Array index out of bounds in %@", pointer]];
+        return NSNotFound;
+    }
+    return (NSUInteger)index;
+}
+
+- (id) valueAtTokens:(NSArray<NSString*>*)tokens pointer:(NSString*)pointer
+{
+    id value = self.document;
+    for (NSString* token in tokens)
+    {
+        if ([value isKindOfClass:[NSDictionary class]])
+        {
+            value = value[token];
+        }
+        else if ([value isKindOfClass:[NSArray class]])
+        {
+            NSUInteger index = [self indexOfToken:token inArray:value allowsEnd:NO pointer:pointer];
+            value = index != NSNotFound ? value[index] : nil;
+        }
+        else
+        {
+            value = nil;
+        }
+        if (!value)
+        {
+            [self failWithCode:SDServiceJSONPatchErrorCodePathNotFound description:[NSString stringWithFormat:@"Path %@ not found", pointer]];
+            return nil;
+        }
+    }
+    return value;
+}
+
+#pragma mark - Copy on write
+
+- (id) copiedContainer:(id)container
+{
+    if ([self.copiedContainers containsObject:container])
+    {
+        return container;
+    }
+    id copy = [container mutableCopy];
+    [self.copiedContainers addObject:copy];
+    return copy;
+}
+
+/**
+ *  Container of the last token, copied with all containers above it (copies of this patch are reused).
+ */
+- (id) parentContainerOfTokens:(NSArray<NSString*>*)tokens pointer:(NSString*)pointer
+{
+    if (![self.document isKindOfClass:[NSDictionary class]] && ![self.document isKindOfClass:[NSArray class]])
+    {
+        [self failWithCode:SDServiceJSONPatchErrorCodePathNotFound description:[NSString stringWithFormat:@"Path %@ not found", pointer]];
+        return nil;
+    }
+    self.document = [self copiedContainer:self.document];
+    id container = self.document;
+    for (NSUInteger i = 0; i + 1 < tokens.count; i++)
+    {
+        NSString* token = tokens[i];
+        id child = nil;
+        NSUInteger index = NSNotFound;
+        if ([container isKindOfClass:[NSDictionary class]])
+        {
+            child = container[token];
+        }
+        else
+        {
+            index = [self indexOfToken:token inArray:container allowsEnd:NO pointer:pointer];
+            child = index != NSNotFound ? container[index] : nil;
+        }
+        if (![child isKindOfClass:[NSDictionary class]] && ![child isKindOfClass:[NSArray class]])
+        {
+            [self failWithCode:SDServiceJSONPatchErrorCodePathNotFound description:[NSString stringWithFormat:@"Path %@ not found", pointer]];
+            return nil;
+        }
+        
+        id copiedChild = [self copiedContainer:child];
+        if (copiedChild != child)
+        {
+            if (index == NSNotFound)
+            {
+                ((NSMutableDictionary*)container)[token] = copiedChild;
+            }
+            else
+            {
+                [(NSMutableArray*)container replaceObjectAtIndex:index withObject:copiedChild];
+            }
+        }
+        container = copiedChild;
+    }
+    return container;
+}
+
+/**
+ *  Value that can be placed in a second location: containers copied by this patch (modified in place by next operations) are copied again.
+ */
+- (id) sharedValue:(id)value
+{
+    if (![self.copiedContainers containsObject:value])
+    {
+        return value;
+    }
+    if ([value isKindOfClass:[NSDictionary class]])
+    {
+        NSMutableDictionary* dictionary = [NSMutableDictionary dictionaryWithCapacity:[value count]];
+        [value enumerateKeysAndObjectsUsingBlock:^(id key, id object, BOOL* stop) {
+            dictionary[key] = [self sharedValue:object];
+        }];
+        return [dictionary copy];
+    }
+    NSMutableArray* array = [NSMutableArray arrayWithCapacity:[value count]];
+    for (id object in value)
+    {
+        [array addObject:[self sharedValue:object]];
+    }
+    return [array copy];
+}
+
+#pragma mark - Operations
+
+- (BOOL) addValue:(id)value atTokens:(NSArray<NSString*>*)tokens pointer:(NSString*)pointer
+{
+    if (tokens.count == 0)
+    {
+        self.document = value;
+        return YES;
+    }
+    id container = [self parentContainerOfTokens:tokens pointer:pointer];
+    if (!container)
+    {
+        return NO;
+    }
+    if ([container isKindOfClass:[NSDictionary class]])
+    {
+        ((NSMutableDictionary*)container)[tokens.lastObject] = value;
+        return YES;
+    }
+    NSUInteger index = [self indexOfToken:tokens.lastObject inArray:container allowsEnd:YES pointer:pointer];
+    if (index == NSNotFound)
+    {
+        return NO;
+    }
+    [(NSMutableArray*)container insertObject:value atIndex:index];
+    return YES;
+}
+
+/**
+ *  @return removed value, nil if not found.
+ */
+- (id) removeValueAtTokens:(NSArray<NSString*>*)tokens pointer:(NSString*)pointer
+{
+    if (tokens.count == 0)
+    {
+        [self failWithCode:SDServiceJSONPatchErrorCodeInvalidPatch description:@"Can't remove the whole document"];
+        return nil;
+    }
+    id container = [self parentContainerOfTokens:tokens pointer:pointer];
+    if (!container)
+    {
+        return nil;
+    }
+    id value = nil;
+    if ([container isKindOfClass:[NSDictionary class]])
+    {
+        value = container[tokens.lastObject];
+        [(NSMutableDictionary*)container removeObjectForKey:tokens.lastObject];
+    }
+    else
+    {
+        NSUInteger index = [self indexOfToken:tokens.lastObject inArray:container allowsEnd:NO pointer:pointer];
+        if (index != NSNotFound)
+        {
+            value = container[index];
+            [(NSMutableArray*)container removeObjectAtIndex:index];
+        }
+    }
+    if (!value)
+    {
+        [self failWithCode:SDServiceJSONPatchErrorCodePathNotFound description:[NSString stringWithFormat:@"Path %@ not found", pointer]];
+    }
+    return value;
+}
+
+- (BOOL) replaceValue:(id)value atTokens:(NSArray<NSString*>*)tokens pointer:(NSString*)pointer
+{
+    if (tokens.count == 0)
+    {
+        self.document = value;
+        return YES;
+    }
+    id container = [self parentContainerOfTokens:tokens pointer:pointer];
+    if (!container)
+    {
+        return NO;
+    }
+    if ([container isKindOfClass:[NSDictionary class]])
+    {
+        if (!container[tokens.lastObject])
+        {
+            return [self failWithCode:SDServiceJSONPatchErrorCodePathNotFound description:[NSString stringWithFormat:@"Path %@ not found", pointer]];
+        }
+        ((NSMutableDictionary*)container)[tokens.lastObject] = value;
+        return YES;
+    }
+    NSUInteger index = [self indexOfToken:tokens.lastObject inArray:container allowsEnd:NO pointer:pointer];
+    if (index == NSNotFound)
+    {
+        return NO;
+    }
+    [(NSMutableArray*)container replaceObjectAtIndex:index withObject:value];
+    return YES;
+}
+
+@end
+
+
+@implementation SDServiceJSONPatch
+
++ (id) objectByApplyingPatch:(NSArray*)patch toObject:(id)object error:(NSError**)error
+{
+    SDServiceJSONPatchApplication* application = [[SDServiceJSONPatchApplication alloc] initWithDocument:object];
+    BOOL success = [patch isKindOfClass:[NSArray class]];
+    if (success)
+    {
+        for (id operation in patch)
+        {
+            if (![application applyOperation:operation])
+            {
+                success = NO;
+                break;
+            }
+        }
+    }
+    else
+    {
+        [application failWithCode:SDServiceJSONPatchErrorCodeInvalidPatch description:@"Patch is not an array of operations"];
+    }
+    
+    if (!success)
+    {
+        if (error)
+        {
+            *error = application.error;
+        }
+        return nil;
+    }
+    return application.document;
+}
+
+@end
@@ -0,0 +1,49 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+@class SDServiceGeneric;
+
+/**
+ *  Keeps the latencies of the last calls of every service class (sliding window) and computes their percentiles.
+ *
+ *  SDServiceManager adds the latency of every attempt that receives a response from server. Not thread safe: used from main thread.
+ */
+@interface SDServiceLatencyTracker : NSObject
+
+/**
+ *  Number of latencies kept for each service class. Oldest ones are replaced.
+ *
+ *  Default: 200
+ */
+@property (nonatomic, assign) NSUInteger maximumNumberOfSamples;
+
+- (void) addLatency:(NSTimeInterval)latency forService:(SDServiceGeneric* _Nonnull)service;
+
+- (NSUInteger) numberOfSamplesForService:(SDServiceGeneric* _Nonnull)service;
+
+/**
+ *  Latency at the given percentile (0-100, nearest rank) of the samples kept for the service class.
+ *
+ *  @return latency in seconds, or 0 if there are no samples.
+ */
+- (NSTimeInterval) latencyAtPercentile:(double)percentile forService:(SDServiceGeneric* _Nonnull)service;
+
+/**
+ *  Remove all samples.
+ */
+- (void) reset;
+
+@end
@@ -0,0 +1,153 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceLatencyTracker.h"
+
+#define DEFAULT_LATENCY_MAXIMUM_SAMPLES     200
+
+/**
+ *  Ring buffer of latencies of a service class.
+ */
+@interface SDServiceLatencySamples : NSObject
+
+- (instancetype) initWithCapacity:(NSUInteger)capacity;
+
+- (void) addLatency:(NSTimeInterval)latency;
+- (NSTimeInterval) latencyAtPercentile:(double)percentile;
+
+@property (nonatomic, readonly) NSUInteger count;
+
+@end
+
+@implementation SDServiceLatencySamples
+{
+    NSTimeInterval* samples;
+    NSTimeInterval* sortedSamples;
+    NSUInteger capacity;
+    NSUInteger nextIndex;
+    BOOL sorted;
+}
+
+- (instancetype) initWithCapacity:(NSUInteger)aCapacity
+{
+    self = [super init];
+    if (self)
+    {
+        capacity = MAX(aCapacity, 1);
+        samples = calloc(capacity, sizeof(NSTimeInterval));
+        sortedSamples = calloc(capacity, sizeof(NSTimeInterval));
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    free(samples);
+    free(sortedSamples);
+}
+
+- (void) addLatency:(NSTimeInterval)latency
+{
+    samples[nextIndex] = latency;
+    nextIndex = (nextIndex + 1) % capacity;
+    _count = MIN(_count + 1, capacity);
+    sorted = NO;
+}
+
+static int SDCompareLatencies(const void* a, const void* b)
+{
+    NSTimeInterval first = *(const NSTimeInterval*)a;
+    NSTimeInterval second = *(const NSTimeInterval*)b;
+    return first < second ? -1 : (first > second ? 1 : 0);
+}
+
+- (NSTimeInterval) latencyAtPercentile:(double)percentile
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    // samples are sorted only when asked after a change
+    if (!sorted)
+    {
+        memcpy(sortedSamples, samples, _count * sizeof(NSTimeInterval));
+        qsort(sortedSamples, _count, sizeof(NSTimeInterval), SDCompareLatencies);
+        sorted = YES;
+    }
+    // nearest rank
+    NSUInteger rank = (NSUInteger)ceil(percentile / 100. * _count);
+    rank = MIN(MAX(rank, 1), _count);
+    return sortedSamples[rank - 1];
+}
+
+@end
+
+
+
+@interface SDServiceLatencyTracker ()
+
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDServiceLatencySamples*>* samplesByService;
+
+@end
+
+@implementation SDServiceLatencyTracker
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        self.maximumNumberOfSamples = DEFAULT_LATENCY_MAXIMUM_SAMPLES;
+        self.samplesByService = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void) setMaximumNumberOfSamples:(NSUInteger)maximumNumberOfSamples
+{
+    if (_maximumNumberOfSamples != maximumNumberOfSamples)
+    {
+        _maximumNumberOfSamples = maximumNumberOfSamples;
+        [self.samplesByService removeAllObjects];
+    }
+}
+
+- (void) addLatency:(NSTimeInterval)latency forService:(SDServiceGeneric*)service
+{
+    NSString* key = NSStringFromClass([service class]);
+    SDServiceLatencySamples* samples = self.samplesByService[key];
+    if (!samples)
+    {
+        samples = [[SDServiceLatencySamples alloc] initWithCapacity:self.maximumNumberOfSamples];
+        self.samplesByService[key] = samples;
+    }
+    [samples addLatency:latency];
+}
+
+- (NSUInteger) numberOfSamplesForService:(SDServiceGeneric*)service
+{
+    return self.samplesByService[NSStringFromClass([service class])].count;
+}
+
+- (NSTimeInterval) latencyAtPercentile:(double)percentile forService:(SDServiceGeneric*)service
+{
+    return [self.samplesByService[NSStringFromClass([service class])] latencyAtPercentile:percentile];
+}
+
+- (void) reset
+{
+    [self.samplesByService removeAllObjects];
+}
+
+@end
@@ -16,10 +16,28 @@
 #import "SDServiceGeneric.h"
 @import AFNetworking;
 #import "SDDockerLogger.h"
+#import "SDConnectionPrewarmer.h"
+#import "SDServiceTrafficArchive.h"
+#import "SDServiceFaultInjector.h"
+#import "SDServiceLatencyTracker.h"
+#import "SDServiceHedgingPolicy.h"
+#import "SDServiceRateLimiter.h"
+#import "SDServicePartialResultsCollector.h"
+#import "SDServiceMappingExecutor.h"
+#import "SDServiceFuture.h"
+#import "SDNetworkQualityEstimator.h"
+#import "SDDeferredRequestQueue.h"
+#import "SDServiceBodyCodec.h"
+#import "SDServiceContentDecoder.h"
+#import "SDServiceJSONPatch.h"
+
+@class SDServicePollingScheduler;
 
 typedef void (^ ServiceCompletionSuccessHandler)(id<SDServiceGenericResponseProtocol> _Nullable response);
 typedef void (^ ServiceCompletionFailureHandler)(id<SDServiceGenericErrorProtocol> _Nullable error);
 typedef void (^ ServiceDownloadProgressHandler)(NSUInteger bytesRead, long long totalBytesRead, long long totalBytesExpectedToRead);
+typedef void (^ ServicePartialResultsHandler)(NSArray* _Nonnull items, NSUInteger firstIndex);
+typedef void (^ ServiceNotModifiedHandler)(void);
 typedef void (^ ServiceUploadProgressHandler)(NSUInteger bytesWritten, long long totalBytesWritten, long long totalBytesExpectedToWrite);
 typedef NSCachedURLResponse* _Nullable (^ ServiceCachingBlock)(NSURLConnection* _Nullable connection, NSCachedURLResponse* _Nullable cachedResponse);
 typedef void (^ ServiceAuthenticationChallenge)(NSURLConnection * _Nonnull connection, NSURLAuthenticationChallenge * _Nonnull challenge);
@@ -29,7 +47,28 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
     kSDServiceOperationTypeInvalid = -1
 };
 
+typedef NS_ENUM (NSInteger, SDServiceTrafficMode)
+{
+    SDServiceTrafficModeDisabled = 0,
+    SDServiceTrafficModeRecord,
+    SDServiceTrafficModeReplay
+};
+
 @protocol SDServiceManagerDelegate;
+
+/**
+ *  Last document received by a service that accepts delta responses, base of the next delta response.
+ */
+@interface SDServiceDeltaDocument : NSObject
+
+- (instancetype _Nonnull) initWithEntityTag:(NSString* _Nonnull)entityTag document:(id _Nonnull)document response:(id<SDServiceGenericResponseProtocol> _Nonnull)response;
+
+@property (nonatomic, strong, readonly) NSString* _Nonnull entityTag;
+@property (nonatomic, strong, readonly) id _Nonnull document;
+@property (nonatomic, strong, readonly) id<SDServiceGenericResponseProtocol> _Nonnull response;
+
+@end
+
 /**
  *  Wrapper class for a single call of SDServiceGeneric.
  */
@@ -46,6 +85,73 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
 @property (nonatomic, assign) BOOL isProcessing;
 @property (nonatomic, assign) int numAutomaticRetry;
 
+/**
+ *  Absolute time by which the caller needs an answer, across all attempts. Timeout of every attempt shrinks to the time left,
+ *  no retry starts if the time left can't fit minimumAttemptTimeout of SDServiceManager, and a call started after deadline fails immediately with NSURLErrorTimedOut.
+ *  A request still running at deadline (ex. a response arriving slowly) is cancelled and the call fails with the same error.
+ *
+ *  Default: nil (no deadline)
+ */
+@property (nonatomic, strong) NSDate* _Nullable deadline;
+
+/**
+ *  Priority of the call when it has to wait (ex. for rate limiter of SDServiceManager): low priority calls are served last and shed first.
+ *
+ *  Default: SDServiceCallPriorityNormal
+ */
+@property (nonatomic, assign) SDServiceCallPriority priority;
+
+/**
+ *  Body encoded at the first attempt by bodyForRequest:error: of the service or by the codec of its bodyContentType, reused by retries (nil if parameters are sent by the request serializer).
+ *  Set it to nil after changing the request to encode it again.
+ */
+@property (nonatomic, strong) NSData* _Nullable requestBody;
+
+/**
+ *  Called on main thread with chunks of mapped items of an array response while it is mapped, before completionSuccess (ex. to show the first rows of a long list).
+ *  firstIndex is the index in the array of the first item of the chunk. If mapping fails after some chunks completionFailure is called and the chunks already delivered must be discarded.
+ *  Used only if the service implements responseForObject:partialResultsCollector:error: (or responseForData:partialResultsCollector:error:), as SDServiceMantle does.
+ *
+ *  Default: nil
+ */
+@property (nonatomic, strong) ServicePartialResultsHandler _Nullable partialResultsHandler;
+
+/**
+ *  A chunk of partial results is delivered when it reaches partialResultsChunkSize items or when partialResultsInterval passed since the previous chunk.
+ *
+ *  Default: 200 items, 0.016 seconds
+ */
+@property (nonatomic, assign) NSUInteger partialResultsChunkSize;
+@property (nonatomic, assign) NSTimeInterval partialResultsInterval;
+
+/**
+ *  Validators of the response the caller already has, to make a conditional call: entityTag is sent as If-None-Match and lastModified as If-Modified-Since (bypassing NSURLCache),
+ *  responseDigest (SHA256 of the body) detects unchanged bodies of servers that don't send validators.
+ *  Used only if notModifiedHandler is set. When the call ends they contain the validators of the last response received.
+ *
+ *  Default: nil
+ */
+@property (nonatomic, strong) NSString* _Nullable entityTag;
+@property (nonatomic, strong) NSString* _Nullable lastModified;
+@property (nonatomic, strong) NSString* _Nullable responseDigest;
+
+/**
+ *  Called on main thread instead of completionSuccess when server answers 304 or a body with the same responseDigest: the response is not mapped.
+ *  The delegate receives didEndServiceOperation:withRequest:result:error: with nil result and error.
+ *
+ *  Default: nil (no conditional call)
+ */
+@property (nonatomic, strong) ServiceNotModifiedHandler _Nullable notModifiedHandler;
+
+/**
+ *  Non urgent call (ex. analytics, background refresh): it waits in deferredRequestQueue of SDServiceManager and is sent together with other deferred calls and downloads,
+ *  when another call wakes the radio, when it waited maximumDelay of the queue or when the batch is full. Cancel it with cancelServiceCallInfo: while it waits.
+ *  Calls whose request conforms to NSCoding are saved across launches: restored calls are sent by the service manager of the same class, without completion blocks nor delegate.
+ *
+ *  Default: NO
+ */
+@property (nonatomic, assign) BOOL deferrable;
+
 @property (nonatomic, strong) ServiceCompletionSuccessHandler _Nullable completionSuccess;
 @property (nonatomic, strong) ServiceCompletionFailureHandler _Nullable completionFailure;
 @property (nonatomic, strong) ServiceDownloadProgressHandler _Nullable downloadProgressHandler;
@@ -53,6 +159,11 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
 @property (nonatomic, strong) ServiceCachingBlock _Nullable cachingBlock;
 @property (nonatomic, strong) ServiceAuthenticationChallenge _Nullable authenticationChallengeBlock;
 
+/**
+ *  Operation of the current attempt (nil before start, in demo and replay mode).
+ */
+@property (nonatomic, weak, readonly) AFHTTPRequestOperation* _Nullable operation;
+
 @end
 
 @protocol SDServiceManagerDelegate <NSObject>
@@ -123,6 +234,96 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
  */
 @property (nonatomic, assign) NSTimeInterval timeBeforeRetry;
 
+/**
+ *  Minimum time an attempt needs to be useful: services with deadline don't start an attempt (or a retry) with less time left.
+ *
+ *  Default: 1 second
+ */
+@property (nonatomic, assign) NSTimeInterval minimumAttemptTimeout;
+
+/**
+ *  Name of the header where the time left before deadline (in milliseconds) is sent to server, for services with deadline. nil to not send it.
+ *
+ *  Default: nil
+ */
+@property (nonatomic, strong) NSString* _Nullable deadlineHeaderName;
+
+/**
+ *  Latencies of calls that received a response from server, for each service class. Used by hedging policies of services.
+ */
+@property (nonatomic, strong, readonly) SDServiceLatencyTracker* _Nonnull latencyTracker;
+
+/**
+ *  Executor of response mapping: number of workers, backpressure on network results when mapping is late, and queue depth metrics.
+ *  Mapping of a call runs with the priority of the call. Responses are parsed by the response serializer of the service in the executor too.
+ */
+@property (nonatomic, strong, readonly) SDServiceMappingExecutor* _Nonnull mappingExecutor;
+
+/**
+ *  Polls services on behalf of many subscribers: identical subscriptions share one conditional call, and intervals back off while responses don't change.
+ */
+@property (nonatomic, strong, readonly) SDServicePollingScheduler* _Nonnull pollingScheduler;
+
+/**
+ *  Estimator that receives round trip time and throughput of every call that gets a response from server. Use nil to disable observations.
+ *
+ *  Default: [SDNetworkQualityEstimator sharedEstimator]
+ */
+@property (nonatomic, strong) SDNetworkQualityEstimator* _Nullable networkQualityEstimator;
+
+/**
+ *  Queue of deferrable calls (see deferrable of SDServiceCallInfo). Use nil to send deferrable calls immediately.
+ *
+ *  Default: [SDDeferredRequestQueue sharedQueue]
+ */
+@property (nonatomic, strong) SDDeferredRequestQueue* _Nullable deferredRequestQueue;
+
+/**
+ *  Documents of services that accept delta responses (see acceptsDeltaResponses of SDServiceGenericProtocol) by HTTP method, resolved path and parameters of their calls.
+ *  Documents are kept with their ETag and mapped response, to apply the JSON Patch of the next delta response and map only what changed.
+ *
+ *  Default: cache of 20 documents
+ */
+@property (nonatomic, strong, readonly) NSCache<NSString*, SDServiceDeltaDocument*>* _Nonnull deltaDocumentCache;
+
+/**
+ *  Codecs of request and response bodies by content type (lowercase, without parameters).
+ *  Responses with a registered Content-Type are decoded by its codec instead of the response serializer of the service; services with a bodyContentType send bodies encoded by its codec.
+ *
+ *  Default: SDServiceMessagePackCodec for application/msgpack and application/x-msgpack
+ */
+@property (atomic, strong, readonly) NSDictionary<NSString*, id<SDServiceBodyCodec>>* _Nonnull bodyCodecs;
+
+/**
+ *  Register the codec for all its content types, replacing codecs already registered for them.
+ */
+- (void) registerBodyCodec:(id<SDServiceBodyCodec> _Nonnull)codec;
+- (void) unregisterBodyCodecForContentType:(NSString* _Nonnull)contentType;
+
+/**
+ *  Codec registered for the content type (parameters like charset are ignored), nil if none.
+ */
+- (id<SDServiceBodyCodec> _Nullable) bodyCodecForContentType:(NSString* _Nullable)contentType;
+
+/**
+ *  Factories of decoders of response bodies by Content-Encoding value (lowercase), for encodings the system doesn't decode (ex. compression with a pre-shared dictionary).
+ *  While factories are registered, calls send their encodings in Accept-Encoding (with gzip and deflate) and bodies are decoded while they arrive.
+ *
+ *  Default: no factories
+ */
+@property (atomic, strong, readonly) NSDictionary<NSString*, SDServiceContentDecoderFactory>* _Nonnull contentDecoderFactories;
+
+- (void) registerContentDecoderFactory:(SDServiceContentDecoderFactory _Nonnull)factory forContentEncoding:(NSString* _Nonnull)contentEncoding;
+- (void) unregisterContentDecoderFactoryForContentEncoding:(NSString* _Nonnull)contentEncoding;
+
+/**
+ *  Rate limiter of calls (not used in demo and replay mode). Calls over the limits of their host or pathResource wait for their turn, and fail with SDServiceRateLimitErrorDomain if shed or waiting too long.
+ *  Responses adapt its limits to Retry-After and rate limit headers.
+ *
+ *  Default: nil (no rate limiting)
+ */
+@property (nonatomic, strong) SDServiceRateLimiter* _Nullable rateLimiter;
+
 /**
  *  Flag to use alla services in demo mode (response retreived from local files). If you want different behaviours, use this flag on specific services.
     Default is NO.
@@ -131,6 +332,52 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
  */
 @property (nonatomic, assign) BOOL useDemoMode;
 
+/**
+ *  Simulates latencies and faults (timeouts, connection drops, bursts of error status codes, limited bandwidth) of services in demo mode.
+ *  Services with a profile (demoModeFaultProfile, profile for their class or globalProfile of the injector) use it instead of demoWaitingTimeRange and demoModeFailureChanceEvent.
+ *
+ *  Default: nil
+ */
+@property (nonatomic, strong) SDServiceFaultInjector* _Nullable faultInjector;
+
+/**
+ *  Archive where service traffic is recorded (SDServiceTrafficModeRecord) or read from (SDServiceTrafficModeReplay).
+ *
+ *  Default: nil
+ */
+@property (nonatomic, strong) SDServiceTrafficArchive* _Nullable trafficArchive;
+
+/**
+ *  SDServiceTrafficModeRecord: every call that receives a response from server is saved in trafficArchive (request, response headers and body, duration).
+ *  SDServiceTrafficModeReplay: calls are never sent to server, the matching record of trafficArchive is returned instead (after the recorded duration scaled by replayLatencyScale). Calls without a matching record fail.
+ *  A call matches a record if it has same HTTP method, resolved path and parameters.
+ *
+ *  Demo mode has precedence over replay mode.
+ *
+ *  Default: SDServiceTrafficModeDisabled
+ */
+@property (nonatomic, assign) SDServiceTrafficMode trafficMode;
+
+/**
+ *  Multiplier of the recorded durations in replay mode. Use 0 to replay without latency.
+ *
+ *  Default: 1
+ */
+@property (nonatomic, assign) double replayLatencyScale;
+
+/**
+ *  Urls of hosts (ex. base urls of your request operation managers) whose connections are opened at startup and every time network becomes reachable, before the first service call.
+ *  Setting this property starts immediately the pre-warm. Pre-warm is skipped while there are pending services.
+ *
+ *  Default: nil (no pre-warm)
+ */
+@property (nonatomic, strong) NSArray<NSURL*>* _Nullable prewarmHosts;
+
+/**
+ *  Object that pre-warm connections of prewarmHosts. Use it to change budget and intervals or to read durations of pre-warms.
+ */
+@property (nonatomic, strong, readonly) SDConnectionPrewarmer* _Nonnull connectionPrewarmer;
+
 
 /**
  *  Queue of all pending services.
@@ -171,6 +418,11 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
 - (void) didCompleteAllServices;
 
 
+/**
+ *  Pre-warm connections to all prewarmHosts. Called automatically when prewarmHosts is set and when network becomes reachable.
+ */
+- (void) prewarmConnections;
+
 /**
  *  Repeat the service call and decrement number of authomatic retries.
  *
@@ -183,6 +435,16 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
  */
 - (void) repeatFailedServices;
 
+/**
+ *  Check if the service has time for an attempt starting after delay, before its deadline.
+ *
+ *  @param delay       seconds before the attempt starts.
+ *  @param serviceInfo service to check.
+ *
+ *  @return YES if service has no deadline or the time left after delay is at least minimumAttemptTimeout.
+ */
+- (BOOL) hasTimeForAttemptAfterDelay:(NSTimeInterval)delay forServiceInfo:(SDServiceCallInfo* _Nonnull)serviceInfo;
+
 /**
  *  If service expects authomatic retry, by default this method returns NO. If service doesn't provide authomatic retry, by default it returns YES.
  *
@@ -205,6 +467,14 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
  */
 - (void) cancelAllOperationsForService:(SDServiceGeneric* _Nullable)service;
 
+/**
+ *  Cancel a single service call, started with callServiceWithServiceCallInfo:. Pending automatic retries are cancelled too.
+ *  As for the other cancel methods, completion blocks are not called (unless the response was already received and it's being mapped).
+ *
+ *  @param serviceInfo service call to cancel.
+ */
+- (void) cancelServiceCallInfo:(SDServiceCallInfo* _Nonnull)serviceInfo;
+
 /**
  *  Cancels all pending requests with the specific delegate (caller).
  *
@@ -288,6 +558,22 @@ typedef NS_ENUM (NSInteger, SDServiceOperationType)
  */
 - (void) callService:(SDServiceGeneric* _Nonnull)service withRequest:(id<SDServiceGenericRequestProtocol> _Nonnull)request operationType:(NSInteger)operationType delegate:(id <SDServiceManagerDelegate> _Nullable)delegate completionSuccess:(ServiceCompletionSuccessHandler _Nullable)completionSuccess completionFailure:(ServiceCompletionFailureHandler _Nullable)completionFailure;
 
+/**
+ *  Enqueue service operation with all service info parameters and return its future: fulfilled with the response, or rejected with the error object of the service.
+ *  completionSuccess and completionFailure of serviceInfo, if set, are called before the future is settled. Cancelling the future cancels the call.
+ *  Can be called from any thread (ex. in then: blocks of other futures running on another queue): the call starts on main thread.
+ *
+ *  @param serviceInfo object with all informations about service to call.
+ *
+ *  @return future of the call.
+ */
+- (SDServiceFuture* _Nonnull) futureByCallingServiceWithServiceCallInfo:(SDServiceCallInfo* _Nonnull)serviceInfo;
+
+/**
+ *  Same as futureByCallingServiceWithServiceCallInfo: with a call without delegate and automatic retries.
+ */
+- (SDServiceFuture* _Nonnull) futureByCallingService:(SDServiceGeneric* _Nonnull)service withRequest:(id<SDServiceGenericRequestProtocol> _Nonnull)request;
+
 /**
  * Print Service Request
  * Override this method if you want to customize your logs.
@@ -16,8 +16,104 @@
 #import <Mantle/Mantle.h>
 #import "SOCKit.h"
 #import "NSDictionary+Docker.h"
+#import "SDServicePollingScheduler.h"
+#import "SDServiceMessagePackCodec.h"
+#import <CommonCrypto/CommonDigest.h>
+
+#define DEFAULT_PARTIAL_RESULTS_CHUNK_SIZE    200
+#define DEFAULT_PARTIAL_RESULTS_INTERVAL      0.016
+#define DEFAULT_DELTA_DOCUMENTS_LIMIT         20
+
+#define DEFERRED_CALL_SERVICE_CLASS           @"serviceClass"
+#define DEFERRED_CALL_REQUEST                 @"request"
+#define DEFERRED_CALL_OPERATION_TYPE          @"operationType"
+#define DEFERRED_CALL_NUM_AUTOMATIC_RETRY     @"numAutomaticRetry"
+
+@interface SDServiceCallInfo ()
+
+/**
+ *  Start time of the current attempt, used to measure duration of recorded calls.
+ */
+@property (nonatomic, assign) CFAbsoluteTime attemptStartTime;
+
+/**
+ *  Key of the call in the traffic archive (nil if traffic mode is disabled).
+ */
+@property (nonatomic, strong) NSString* trafficKey;
+
+@property (nonatomic, weak, readwrite) AFHTTPRequestOperation* operation;
+
+/**
+ *  Duplicate request of the current attempt, sent by hedging policy of the service (nil if not hedged or once one of the two requests wins).
+ */
+@property (nonatomic, strong) AFHTTPRequestOperation* hedgeOperation;
+
+/**
+ *  Request cancelled because the other one of the hedged attempt won: its result is ignored.
+ */
+@property (nonatomic, weak) AFHTTPRequestOperation* hedgeLoserOperation;
+
+/**
+ *  Requests of the current attempt were cancelled because deadline passed: their cancellation fails the call with the deadline error.
+ */
+@property (nonatomic, assign) BOOL deadlineExceeded;
+
+/**
+ *  Ticket of the call waiting in rate limiter.
+ */
+@property (nonatomic, strong) id rateLimitTicket;
+
+/**
+ *  Response data of the current attempt is parsed by the response serializer of the service in mapping executor, not by the operation.
+ */
+@property (nonatomic, assign) BOOL defersResponseParsing;
+
+/**
+ *  Deferrable call waiting in the deferred request queue (nil once sent).
+ */
+@property (nonatomic, weak) SDDeferredRequest* deferredRequest;
+@property (nonatomic, weak) SDServiceManager* deferringServiceManager;
+
+/**
+ *  Deferrable call already released by the deferred request queue: retries are not deferred again.
+ */
+@property (nonatomic, assign) BOOL deferralEnded;
+
+/**
+ *  Key of the call in deltaDocumentCache (nil if the service doesn't accept delta responses) and document sent as base of the current attempt.
+ */
+@property (nonatomic, strong) NSString* deltaKey;
+@property (nonatomic, strong) SDServiceDeltaDocument* deltaDocument;
+
+/**
+ *  A delta response didn't apply: next attempts ask the full document.
+ */
+@property (nonatomic, assign) BOOL deltaDisabled;
+
+/**
+ *  Content type of requestBody when it was encoded by a body codec (nil if it is JSON).
+ */
+@property (nonatomic, strong) NSString* requestBodyContentType;
+
+@end
+
+@implementation SDServiceDeltaDocument
+
+- (instancetype) initWithEntityTag:(NSString*)entityTag document:(id)document response:(id<SDServiceGenericResponseProtocol>)response
+{
+    self = [super init];
+    if (self)
+    {
+        _entityTag = entityTag;
+        _document = document;
+        _response = response;
+    }
+    return self;
+}
+
+@end
+
 
-#define MappingQueueName "com.sysdata.SDServiceManager.mappingQueue"
 
 @implementation SDServiceCallInfo
 
@@ -28,6 +124,8 @@
     {
         _service = service;
         _request = request;
+        _partialResultsChunkSize = DEFAULT_PARTIAL_RESULTS_CHUNK_SIZE;
+        _partialResultsInterval = DEFAULT_PARTIAL_RESULTS_INTERVAL;
     }
     return self;
 }
@@ -37,15 +135,21 @@
 
 
 @interface SDServiceManager ()
-{
-    /**
-     *  Thread to use for mapping operations.
-     */
-    dispatch_queue_t mappingQueue;
-}
 
 @property (nonatomic, strong, readwrite) NSMutableArray<SDServiceCallInfo*>* servicesQueue;
 @property (nonatomic, strong, readwrite) NSMutableDictionary<NSNumber*, NSMutableArray<AFHTTPRequestOperation*>*>* serviceInvocationDictionary;
+@property (nonatomic, strong, readwrite) SDConnectionPrewarmer* connectionPrewarmer;
+@property (nonatomic, strong, readwrite) SDServiceLatencyTracker* latencyTracker;
+@property (nonatomic, strong, readwrite) SDServiceMappingExecutor* mappingExecutor;
+@property (nonatomic, strong, readwrite) SDServicePollingScheduler* pollingScheduler;
+@property (nonatomic, strong, readwrite) NSCache<NSString*, SDServiceDeltaDocument*>* deltaDocumentCache;
+@property (atomic, strong, readwrite) NSDictionary<NSString*, id<SDServiceBodyCodec>>* bodyCodecs;
+@property (atomic, strong, readwrite) NSDictionary<NSString*, SDServiceContentDecoderFactory>* contentDecoderFactories;
+
+/**
+ *  Hedges earned by every service class and not yet used (see budgetRatio of SDServiceHedgingPolicy).
+ */
+@property (nonatomic, strong) NSMutableDictionary<NSString*, NSNumber*>* hedgeBudgets;
 
 @end
 
@@ -73,13 +177,32 @@
 #if DEBUG
         logLevel = SDLogLevelVerbose;
 #endif
-        
+
         [[SDLogger sharedLogger] setLogLevel:logLevel forModuleWithName:self.loggerModuleName];
 #endif
         self.servicesQueue = [NSMutableArray arrayWithCapacity:0];
         self.serviceInvocationDictionary = [NSMutableDictionary dictionaryWithCapacity:0];
         self.timeBeforeRetry = 3.;
-        mappingQueue = dispatch_queue_create(MappingQueueName, DISPATCH_QUEUE_CONCURRENT);
+        self.replayLatencyScale = 1.;
+        self.minimumAttemptTimeout = 1.;
+        self.latencyTracker = [SDServiceLatencyTracker new];
+        self.hedgeBudgets = [NSMutableDictionary dictionary];
+        self.mappingExecutor = [SDServiceMappingExecutor new];
+        self.pollingScheduler = [[SDServicePollingScheduler alloc] initWithServiceManager:self];
+        self.networkQualityEstimator = [SDNetworkQualityEstimator sharedEstimator];
+        self.deferredRequestQueue = [SDDeferredRequestQueue sharedQueue];
+        self.deltaDocumentCache = [NSCache new];
+        self.deltaDocumentCache.countLimit = DEFAULT_DELTA_DOCUMENTS_LIMIT;
+        self.bodyCodecs = @{};
+        [self registerBodyCodec:[SDServiceMessagePackCodec new]];
+        self.contentDecoderFactories = @{};
+        
+        self.connectionPrewarmer = [[SDConnectionPrewarmer alloc] initWithLogModuleName:kServiceManagerLogModuleName];
+        __weak typeof (self) weakself = self;
+        self.connectionPrewarmer.shouldPrewarmBlock = ^BOOL{
+            // real calls already open the connections
+            return !weakself.hasPendingOperations;
+        };
     }
     return self;
 }
@@ -105,6 +228,20 @@
 
 #endif
 
+#pragma mark - Connection pre-warm
+
+- (void) setPrewarmHosts:(NSArray<NSURL*>*)prewarmHosts
+{
+    _prewarmHosts = [prewarmHosts copy];
+    self.connectionPrewarmer.hosts = _prewarmHosts;
+    [self prewarmConnections];
+}
+
+- (void) prewarmConnections
+{
+    [self.connectionPrewarmer prewarm];
+}
+
 #pragma mark - Call service
 
 - (void) callService:(SDServiceGeneric*)service withRequest:(id<SDServiceGenericRequestProtocol>)request operationType:(NSInteger)operationType delegate:(id <SDServiceManagerDelegate> )delegate completionSuccess:(ServiceCompletionSuccessHandler)completionSuccess completionFailure:(ServiceCompletionFailureHandler)completionFailure
@@ -112,6 +249,58 @@
     [self callService:service withRequest:request operationType:operationType responseAction:nil numAutomaticRetry:0 delegate:delegate downloadBlock:nil uploadBlock:nil completionSuccess:completionSuccess completionFailure:completionFailure cachingBlock:nil];
 }
 
+- (SDServiceFuture*) futureByCallingService:(SDServiceGeneric*)service withRequest:(id<SDServiceGenericRequestProtocol>)request
+{
+    return [self futureByCallingServiceWithServiceCallInfo:[[SDServiceCallInfo alloc] initWithService:service request:request]];
+}
+
+- (SDServiceFuture*) futureByCallingServiceWithServiceCallInfo:(SDServiceCallInfo*)serviceInfo
+{
+    __weak typeof (self) weakself = self;
+    __weak SDServiceCallInfo* weakServiceInfo = serviceInfo;
+    SDServiceFuture* future = [[SDServiceFuture alloc] initWithServiceCallInfo:serviceInfo cancellationBlock:^{
+        dispatch_async(dispatch_get_main_queue(), ^{
+            SDServiceCallInfo* strongServiceInfo = weakServiceInfo;
+            if (strongServiceInfo)
+            {
+                [weakself cancelServiceCallInfo:strongServiceInfo];
+            }
+        });
+    }];
+    
+    // the call retains the future until it ends
+    ServiceCompletionSuccessHandler completionSuccess = serviceInfo.completionSuccess;
+    serviceInfo.completionSuccess = ^(id<SDServiceGenericResponseProtocol> response) {
+        if (completionSuccess)
+        {
+            completionSuccess(response);
+        }
+        [future fulfillWithValue:response];
+    };
+    ServiceCompletionFailureHandler completionFailure = serviceInfo.completionFailure;
+    Class serviceClass = [serviceInfo.service class];
+    serviceInfo.completionFailure = ^(id<SDServiceGenericErrorProtocol> error) {
+        if (completionFailure)
+        {
+            completionFailure(error);
+        }
+        NSError* futureError = error.error ?: [NSError errorWithDomain:SDServiceFutureErrorDomain code:SDServiceFutureErrorCodeServiceFailure userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Service %@ failed", NSStringFromClass(serviceClass)] }];
+        [future rejectWithError:futureError serviceError:error];
+    };
+    
+    if ([NSThread isMainThread])
+    {
+        [self callServiceWithServiceCallInfo:serviceInfo];
+    }
+    else
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [weakself callServiceWithServiceCallInfo:serviceInfo];
+        });
+    }
+    return future;
+}
+
 - (void)  callService:(SDServiceGeneric*)service
           withRequest:(id<SDServiceGenericRequestProtocol>)request
         operationType:(NSInteger)operationType
@@ -142,6 +331,12 @@
 
 - (void) callServiceWithServiceCallInfo:(SDServiceCallInfo*)serviceInfo
 {
+    if (serviceInfo.deferrable && !serviceInfo.deferralEnded && self.deferredRequestQueue)
+    {
+        [self deferServiceInfo:serviceInfo];
+        return;
+    }
+    
     // Asks to delegate if can start service.
     BOOL shouldStart = YES;
     
@@ -165,6 +360,13 @@
     // if ServiceManager or specific service is in demo mode try to retreive response from file. Indipendently from result goes over.
     if (self.useDemoMode || ([serviceInfo.service respondsToSelector:@selector(useDemoMode)] && [serviceInfo.service useDemoMode]))
     {
+        SDServiceFaultProfile* faultProfile = [self.faultInjector profileForService:serviceInfo.service];
+        if (faultProfile)
+        {
+            [self callServiceInDemoModeWithFaultProfile:faultProfile serviceCallInfo:serviceInfo];
+            return;
+        }
+        
         double failureChance = 0;
         
         // check if need error demo
@@ -189,7 +391,13 @@
         // simulate success response in demo mode
         SDLogModuleInfo(kServiceManagerLogModuleName, @"Service %@ in DEMO MODE -> SUCCESS CASE", NSStringFromClass([serviceInfo.service class]));
         
-        [self callServiceInDemoModeWithServiceCallInfo:serviceInfo];
+        [self callServiceInDemoModeWithServiceCallInfo:serviceInfo waitingTime:[serviceInfo.service demoModeWaitingTime]];
+        return;
+    }
+    
+    if (![self hasTimeForAttemptAfterDelay:0 forServiceInfo:serviceInfo])
+    {
+        [self manageDeadlineExceededForServiceInfo:serviceInfo];
         return;
     }
     
@@ -197,18 +405,33 @@
     [self.servicesQueue addObject:serviceInfo];
     serviceInfo.isProcessing = YES;
     
-    AFHTTPRequestOperationManager* requestOperationManager = [serviceInfo.service requestOperationManager];
-    AFHTTPRequestSerializer* serializer = requestOperationManager.requestSerializer;
-    
-    // retreive path and parameters
+    // retreive path and parameters (or body already encoded by the service)
     NSString* path = [serviceInfo.service pathResource];
     NSError* mappingError = nil;
-    NSDictionary* parameters = [serviceInfo.service parametersForRequest:serviceInfo.request error:&mappingError];
-    
-    // remove nil parameters from request
-    if ([serviceInfo.request respondsToSelector:@selector(removeNilParameters)] && [serviceInfo.request removeNilParameters])
+    NSDictionary* parameters = nil;
+    // the codec of the service content type wins over the JSON body of the service
+    id<SDServiceBodyCodec> requestCodec = serviceInfo.requestBody ? nil : [self requestBodyCodecForServiceInfo:serviceInfo];
+    if (!serviceInfo.requestBody && !requestCodec && [self shouldEncodeBodyForServiceInfo:serviceInfo])
     {
-        parameters = [parameters pruneNullValues];
+        serviceInfo.requestBody = [serviceInfo.service bodyForRequest:serviceInfo.request error:&mappingError];
+        serviceInfo.requestBodyContentType = nil;
+    }
+    if (!serviceInfo.requestBody && !mappingError)
+    {
+        parameters = [serviceInfo.service parametersForRequest:serviceInfo.request error:&mappingError];
+        
+        // remove nil parameters from request
+        if ([serviceInfo.request respondsToSelector:@selector(removeNilParameters)] && [serviceInfo.request removeNilParameters])
+        {
+            parameters = [parameters pruneNullValues];
+        }
+        
+        // parameters sent in body encoded by the codec of the service content type (parameters are still used for traffic keys)
+        if (requestCodec && !mappingError)
+        {
+            serviceInfo.requestBody = [requestCodec dataWithObject:parameters ?: @{} error:&mappingError];
+            serviceInfo.requestBodyContentType = [self bodyContentTypeForService:serviceInfo.service];
+        }
     }
     
     if (mappingError)
@@ -218,236 +441,1262 @@
         return;
     }
     
-    // mapping of request parameters
-    SOCPattern* pathPattern = [SOCPattern patternWithString:path];
-    path = [pathPattern stringFromObject:serviceInfo.request];
+    // mapping of request parameters (compiled pattern is cached for the path resource)
+    SOCPattern* pathPattern = [SOCPattern cachedPatternWithString:path];
+    path = [pathPattern percentEncodedStringFromObject:serviceInfo.request];
+    if ([serviceInfo.service respondsToSelector:@selector(queryParametersForRequest:)])
+    {
+        path = [self path:path byAddingQueryParameters:[serviceInfo.service queryParametersForRequest:serviceInfo.request]];
+    }
+    
+    serviceInfo.attemptStartTime = CFAbsoluteTimeGetCurrent();
+    serviceInfo.trafficKey = nil;
+    if (self.trafficMode != SDServiceTrafficModeDisabled && self.trafficArchive)
+    {
+        serviceInfo.trafficKey = [SDServiceTrafficArchive keyForHTTPMethod:NSStringFromSDHTTPMethod(serviceInfo.service.requestMethodType) path:path parameters:parameters];
+        
+        if (self.trafficMode == SDServiceTrafficModeReplay)
+        {
+            SDLogModuleInfo(kServiceManagerLogModuleName, @"Service %@ in REPLAY MODE -> %@", NSStringFromClass([serviceInfo.service class]), serviceInfo.trafficKey);
+            
+            [self callServiceInReplayModeWithServiceCallInfo:serviceInfo];
+            return;
+        }
+    }
+    
+    if (self.rateLimiter)
+    {
+        // wait for tokens of host and path resource (at most until deadline)
+        NSString* host = [NSURL URLWithString:path relativeToURL:[serviceInfo.service requestOperationManager].baseURL].host;
+        NSTimeInterval maximumWaitingTime = serviceInfo.deadline ? [serviceInfo.deadline timeIntervalSinceNow] - self.minimumAttemptTimeout : self.rateLimiter.maximumWaitingTime;
+        
+        // completion is synchronous when tokens are available
+        __block BOOL waiting = YES;
+        __weak typeof (self) weakself = self;
+        id ticket = [self.rateLimiter acquireForHost:host pathResource:[serviceInfo.service pathResource] priority:serviceInfo.priority maximumWaitingTime:maximumWaitingTime completion:^(NSError* _Nullable error) {
+            waiting = NO;
+            serviceInfo.rateLimitTicket = nil;
+            if (error)
+            {
+                serviceInfo.isProcessing = NO;
+                [weakself printWebServiceError:error service:serviceInfo];
+                [weakself manageError:error forServiceInfo:serviceInfo withErrorObject:nil statusCode:0];
+                return;
+            }
+            [weakself sendRequestForServiceInfo:serviceInfo path:path parameters:parameters];
+        }];
+        if (waiting)
+        {
+            serviceInfo.rateLimitTicket = ticket;
+        }
+        return;
+    }
+    
+    [self sendRequestForServiceInfo:serviceInfo path:path parameters:parameters];
+}
+
+/**
+ *  Service can send its own encoded body: JSON body method, without multipart and without traffic record (archive keys are built from parameters).
+ */
+- (BOOL) shouldEncodeBodyForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (![serviceInfo.service respondsToSelector:@selector(bodyForRequest:error:)] || serviceInfo.request.multipartInfos.count > 0)
+    {
+        return NO;
+    }
+    if (self.trafficMode != SDServiceTrafficModeDisabled && self.trafficArchive)
+    {
+        return NO;
+    }
+    AFHTTPRequestSerializer* serializer = [serviceInfo.service requestOperationManager].requestSerializer;
+    NSString* method = NSStringFromSDHTTPMethod(serviceInfo.service.requestMethodType);
+    return [serializer isKindOfClass:[AFJSONRequestSerializer class]] && ![serializer.HTTPMethodsEncodingParametersInURI containsObject:method];
+}
+
+/**
+ *  Codec of the body content type of the service, when its parameters go in body (method with a body, without multipart).
+ */
+- (id<SDServiceBodyCodec>) requestBodyCodecForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    id<SDServiceBodyCodec> codec = [self bodyCodecForContentType:[self bodyContentTypeForService:serviceInfo.service]];
+    if (!codec || serviceInfo.request.multipartInfos.count > 0)
+    {
+        return nil;
+    }
+    AFHTTPRequestSerializer* serializer = [serviceInfo.service requestOperationManager].requestSerializer;
+    NSString* method = NSStringFromSDHTTPMethod(serviceInfo.service.requestMethodType);
+    return [serializer.HTTPMethodsEncodingParametersInURI containsObject:method] ? nil : codec;
+}
+
+- (BOOL) shouldDecodeResponseFromDataForService:(SDServiceGeneric*)service
+{
+    return [service respondsToSelector:@selector(decodesResponseFromData)] && [service decodesResponseFromData] && [service respondsToSelector:@selector(responseForData:error:)];
+}
+
+/**
+ *  Serializer that returns response data, validating responses as serializer does.
+ */
+- (AFHTTPResponseSerializer*) dataResponseSerializerWithSerializer:(AFHTTPResponseSerializer*)serializer
+{
+    AFHTTPResponseSerializer* dataSerializer = [AFHTTPResponseSerializer serializer];
+    dataSerializer.acceptableStatusCodes = serializer.acceptableStatusCodes;
+    dataSerializer.acceptableContentTypes = serializer.acceptableContentTypes ? [serializer.acceptableContentTypes setByAddingObjectsFromArray:self.bodyCodecs.allKeys] : nil;
+    dataSerializer.stringEncoding = serializer.stringEncoding;
+    return dataSerializer;
+}
+
+- (void) sendRequestForServiceInfo:(SDServiceCallInfo*)serviceInfo path:(NSString*)path parameters:(NSDictionary*)parameters
+{
+    AFHTTPRequestOperationManager* requestOperationManager = [serviceInfo.service requestOperationManager];
+    AFHTTPRequestSerializer* serializer = requestOperationManager.requestSerializer;
+    serviceInfo.attemptStartTime = CFAbsoluteTimeGetCurrent();
     
-    // set additional request parameters
+    // set headers of the service, then additional request parameters
+    NSDictionary<NSString*, NSString*>* serviceRequestHeaders = [serviceInfo.service respondsToSelector:@selector(requestHeadersForRequest:)] ? [serviceInfo.service requestHeadersForRequest:serviceInfo.request] : nil;
+    for (NSString* headerKey in serviceRequestHeaders.allKeys)
+    {
+        [serializer setValue:serviceRequestHeaders[headerKey] forHTTPHeaderField:headerKey];
+    }
     NSDictionary<NSString*, NSString*>* additionalRequestHeaders = [serviceInfo.request additionalRequestHeaders];
     for (NSString* headerKey in additionalRequestHeaders.allKeys)
     {
         [serializer setValue:additionalRequestHeaders[headerKey] forHTTPHeaderField:headerKey];
     }
     
-    // switch on HTTP method
+    // shrink timeout of the attempt to the time left before deadline
+    NSTimeInterval defaultTimeoutInterval = serializer.timeoutInterval;
+    NSString* deadlineHeaderName = nil;
+    if (serviceInfo.deadline)
+    {
+        NSTimeInterval remainingTime = [serviceInfo.deadline timeIntervalSinceNow];
+        serializer.timeoutInterval = MIN(defaultTimeoutInterval, remainingTime);
+        if (self.deadlineHeaderName.length > 0)
+        {
+            deadlineHeaderName = self.deadlineHeaderName;
+            [serializer setValue:[NSString stringWithFormat:@"%.0f", remainingTime * 1000.] forHTTPHeaderField:deadlineHeaderName];
+        }
+    }
+    
+    // conditional call: server validates the response the caller already has
+    NSURLRequestCachePolicy defaultCachePolicy = serializer.cachePolicy;
+    NSDictionary<NSString*, NSString*>* conditionalHeaders = [self conditionalRequestHeadersForServiceInfo:serviceInfo];
+    for (NSString* headerKey in conditionalHeaders.allKeys)
+    {
+        [serializer setValue:conditionalHeaders[headerKey] forHTTPHeaderField:headerKey];
+    }
+    if (serviceInfo.notModifiedHandler)
+    {
+        // 304 must reach the manager, not be replaced by the cached response
+        serializer.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+    }
+    
+    // prefer the body content type of the service in responses
+    NSString* defaultAccept = [serializer valueForHTTPHeaderField:@"Accept"];
+    NSString* bodyContentType = [self bodyContentTypeForService:serviceInfo.service];
+    BOOL setsAccept = [self bodyCodecForContentType:bodyContentType] && !additionalRequestHeaders[@"Accept"];
+    if (setsAccept)
+    {
+        [serializer setValue:[NSString stringWithFormat:@"%@, application/json;q=0.8", bodyContentType] forHTTPHeaderField:@"Accept"];
+    }
+    
+    // offer encodings with a decoder, besides the ones decoded by the system
+    NSDictionary<NSString*, SDServiceContentDecoderFactory>* contentDecoderFactories = self.contentDecoderFactories;
+    NSString* defaultAcceptEncoding = [serializer valueForHTTPHeaderField:@"Accept-Encoding"];
+    BOOL setsAcceptEncoding = contentDecoderFactories.count > 0 && !additionalRequestHeaders[@"Accept-Encoding"];
+    if (setsAcceptEncoding)
+    {
+        NSArray<NSString*>* encodings = [contentDecoderFactories.allKeys sortedArrayUsingSelector:@selector(compare:)];
+        [serializer setValue:[[encodings arrayByAddingObjectsFromArray:@[@"gzip", @"deflate"]] componentsJoinedByString:@", "] forHTTPHeaderField:@"Accept-Encoding"];
+    }
+    
+    // response data is mapped by the service: the response serializer only validates it
+    AFHTTPResponseSerializer* defaultResponseSerializer = requestOperationManager.responseSerializer;
+    serviceInfo.defersResponseParsing = NO;
+    if ([self shouldDecodeResponseFromDataForService:serviceInfo.service])
+    {
+        requestOperationManager.responseSerializer = [self dataResponseSerializerWithSerializer:defaultResponseSerializer];
+    }
+    else if ([defaultResponseSerializer class] != [AFHTTPResponseSerializer class])
+    {
+        // parsed in mapping executor, so responses waiting for backpressure keep only their data
+        requestOperationManager.responseSerializer = [self dataResponseSerializerWithSerializer:defaultResponseSerializer];
+        serviceInfo.defersResponseParsing = YES;
+    }
+    
+    // delta call: server can answer with a JSON Patch of the cached document
+    SDServiceDeltaDocument* deltaDocument = [self deltaDocumentForServiceInfo:serviceInfo path:path parameters:parameters additionalRequestHeaders:additionalRequestHeaders];
+    serviceInfo.deltaDocument = deltaDocument;
+    if (deltaDocument)
+    {
+        [serializer setValue:@"json-patch" forHTTPHeaderField:@"A-IM"];
+        [serializer setValue:deltaDocument.entityTag forHTTPHeaderField:@"If-None-Match"];
+        serializer.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+        // copy: the response serializer may still be the one of the request operation manager
+        AFHTTPResponseSerializer* dataSerializer = [requestOperationManager.responseSerializer copy];
+        dataSerializer.acceptableContentTypes = [dataSerializer.acceptableContentTypes setByAddingObject:@"application/json-patch+json"];
+        requestOperationManager.responseSerializer = dataSerializer;
+    }
+    
+    // results wait in completion queue while mapping executor is overloaded
+    dispatch_queue_t defaultCompletionQueue = requestOperationManager.completionQueue;
+    requestOperationManager.completionQueue = self.mappingExecutor.completionQueue;
+    
+    // operations are built here and enqueued only when ready, so the body can be decoded from the first byte
     __weak typeof (self) weakself = self;
-    AFHTTPRequestOperation* operation = nil;
-    switch (serviceInfo.service.requestMethodType)
-    {
-        case SDHTTPMethodGET : {
-            operation = [requestOperationManager GET:path parameters:parameters success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
-                [weakself manageResponse:responseObject inOperation:operation forServiceInfo:serviceInfo];
-            } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
-                [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
-            }];
-            break;
+    NSString* URLString = [[NSURL URLWithString:path relativeToURL:requestOperationManager.baseURL] absoluteString];
+    NSString* method = NSStringFromSDHTTPMethod(serviceInfo.service.requestMethodType);
+    NSError* serializationError = nil;
+    NSMutableURLRequest* request = nil;
+    if (serviceInfo.requestBody)
+    {
+        // body already encoded by the service or by the codec of its content type
+        request = [serializer requestWithMethod:method URLString:URLString parameters:nil error:&serializationError];
+        if (request && ![request valueForHTTPHeaderField:@"Content-Type"])
+        {
+            [request setValue:serviceInfo.requestBodyContentType ?: @"application/json" forHTTPHeaderField:@"Content-Type"];
         }
-        case SDHTTPMethodPOST : {
-            if (serviceInfo.request.multipartInfos.count > 0)
+        request.HTTPBody = serviceInfo.requestBody;
+    }
+    else if (serviceInfo.service.requestMethodType == SDHTTPMethodPOST && serviceInfo.request.multipartInfos.count > 0)
+    {
+        request = [serializer multipartFormRequestWithMethod:method URLString:URLString parameters:parameters constructingBodyWithBlock:^(id < AFMultipartFormData >  _Nonnull formData) {
+            for (MultipartBodyInfo* multipartInfo in serviceInfo.request.multipartInfos)
             {
-                operation = [requestOperationManager POST:path parameters:parameters constructingBodyWithBlock:^(id < AFMultipartFormData >  _Nonnull formData) {
-                    for (MultipartBodyInfo* multipartInfo in serviceInfo.request.multipartInfos)
+                if (multipartInfo.data && multipartInfo.name)
+                {
+                    if (multipartInfo.fileName && multipartInfo.mimeType)
+                    {
+                        [formData appendPartWithFileData:multipartInfo.data name:multipartInfo.name fileName:multipartInfo.fileName mimeType:multipartInfo.mimeType];
+                    }
+                    else
                     {
-                        if (multipartInfo.data && multipartInfo.name)
-                        {
-                            if (multipartInfo.fileName && multipartInfo.mimeType)
-                            {
-                                [formData appendPartWithFileData:multipartInfo.data name:multipartInfo.name fileName:multipartInfo.fileName mimeType:multipartInfo.mimeType];
-                            }
-                            else
-                            {
-                                [formData appendPartWithFormData:multipartInfo.data name:multipartInfo.name];
-                            }
-                        }
+                        [formData appendPartWithFormData:multipartInfo.data name:multipartInfo.name];
                     }
-                    [formData throttleBandwidthWithPacketSize:kAFUploadStream3GSuggestedPacketSize delay:kAFUploadStream3GSuggestedDelay];
-                } success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
-                    [weakself manageResponse:responseObject inOperation:operation forServiceInfo:serviceInfo];
-                } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
-                    [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
-                }];
+                }
             }
-            else
+            [formData throttleBandwidthWithPacketSize:kAFUploadStream3GSuggestedPacketSize delay:kAFUploadStream3GSuggestedDelay];
+        } error:&serializationError];
+    }
+    else
+    {
+        request = [serializer requestWithMethod:method URLString:URLString parameters:parameters error:&serializationError];
+    }
+    
+    AFHTTPRequestOperation* operation = nil;
+    if (serializationError || !request)
+    {
+        // as AFNetworking: the call fails without operation
+        NSError* error = serializationError ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadURL userInfo:nil];
+        dispatch_async(requestOperationManager.completionQueue ?: dispatch_get_main_queue(), ^{
+            [weakself manageError:error inOperation:nil forServiceInfo:serviceInfo];
+        });
+    }
+    else
+    {
+        BOOL hasResponseBody = serviceInfo.service.requestMethodType != SDHTTPMethodHEAD;
+        operation = [requestOperationManager HTTPRequestOperationWithRequest:request success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
+            [weakself manageResponse:hasResponseBody ? responseObject : nil inOperation:operation forServiceInfo:serviceInfo];
+        } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
+            [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
+        }];
+        if (contentDecoderFactories.count > 0)
+        {
+            [self setContentDecodingStreamOfOperation:operation decoderFactories:contentDecoderFactories];
+        }
+        [requestOperationManager.operationQueue addOperation:operation];
+    }
+    
+    // remove additional header from serializer
+    for (NSString* headerKey in additionalRequestHeaders.allKeys)
+    {
+        [serializer setValue:nil forHTTPHeaderField:headerKey];
+    }
+    for (NSString* headerKey in serviceRequestHeaders.allKeys)
+    {
+        [serializer setValue:nil forHTTPHeaderField:headerKey];
+    }
+    serializer.timeoutInterval = defaultTimeoutInterval;
+    if (deadlineHeaderName)
+    {
+        [serializer setValue:nil forHTTPHeaderField:deadlineHeaderName];
+    }
+    for (NSString* headerKey in conditionalHeaders.allKeys)
+    {
+        [serializer setValue:nil forHTTPHeaderField:headerKey];
+    }
+    serializer.cachePolicy = defaultCachePolicy;
+    if (deltaDocument)
+    {
+        [serializer setValue:nil forHTTPHeaderField:@"A-IM"];
+        [serializer setValue:nil forHTTPHeaderField:@"If-None-Match"];
+    }
+    if (setsAccept)
+    {
+        [serializer setValue:defaultAccept forHTTPHeaderField:@"Accept"];
+    }
+    if (setsAcceptEncoding)
+    {
+        [serializer setValue:defaultAcceptEncoding forHTTPHeaderField:@"Accept-Encoding"];
+    }
+    requestOperationManager.responseSerializer = defaultResponseSerializer;
+    requestOperationManager.completionQueue = defaultCompletionQueue;
+    
+    // set the operation's download progress block if needed
+    ServiceDownloadProgressHandler downloadHandler = [self downloadProgressHandlerForServiceInfo:serviceInfo];
+    if (downloadHandler)
+    {
+        [operation setDownloadProgressBlock:downloadHandler];
+    }
+    
+    // set the operation's upload progress block if needed
+    if (serviceInfo.uploadProgressHandler != nil || [serviceInfo.delegate respondsToSelector:@selector(didUploadBytes:onTotalExpected:)])
+    {
+        ServiceUploadProgressHandler uploadHandler = ^void (NSUInteger bytesWritten, long long totalBytesWritten, long long totalBytesExpectedToWrite) {
+            if ([serviceInfo.delegate respondsToSelector:@selector(didUploadBytes:onTotalExpected:)])
             {
-                operation = [requestOperationManager POST:path parameters:parameters success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
-                    [weakself manageResponse:responseObject inOperation:operation forServiceInfo:serviceInfo];
-                } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
-                    [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
-                }];
+                [serviceInfo.delegate didUploadBytes:totalBytesWritten onTotalExpected:totalBytesExpectedToWrite];
             }
             
-            break;
+            if (serviceInfo.uploadProgressHandler)
+            {
+                serviceInfo.uploadProgressHandler(bytesWritten, totalBytesWritten, totalBytesExpectedToWrite);
+            }
+        };
+        
+        [operation setUploadProgressBlock:uploadHandler];
+    }
+    
+    // set the operation's caching block if needed
+    if (serviceInfo.cachingBlock != nil)
+    {
+        [operation setCacheResponseBlock:serviceInfo.cachingBlock];
+    }
+    
+    // set the operation's authentication block if needed
+    if (serviceInfo.authenticationChallengeBlock != nil)
+    {
+        [operation setWillSendRequestForAuthenticationChallengeBlock:serviceInfo.authenticationChallengeBlock];
+    }
+    
+    // add operation to the caller
+    serviceInfo.operation = operation;
+    [self addOperation:operation forDelegate:serviceInfo.delegate];
+    
+    [self scheduleHedgeForServiceInfo:serviceInfo];
+    [self scheduleDeadlineForServiceInfo:serviceInfo];
+}
+
+/**
+ *  Timeout of the request is an idle timeout: a response that keeps arriving slowly can outlive it, so requests still running at deadline are cancelled.
+ */
+- (void) scheduleDeadlineForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(expireDeadlineOfServiceInfo:) object:serviceInfo];
+    if (!serviceInfo.deadline || !serviceInfo.operation)
+    {
+        return;
+    }
+    [self performSelector:@selector(expireDeadlineOfServiceInfo:) withObject:serviceInfo afterDelay:MAX([serviceInfo.deadline timeIntervalSinceNow], 0.)];
+}
+
+- (void) expireDeadlineOfServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    AFHTTPRequestOperation* operation = serviceInfo.operation;
+    if (!operation || operation.isFinished || operation.isCancelled)
+    {
+        return;
+    }
+    
+    SDLogModuleVerbose(kServiceManagerLogModuleName, @"Service %@ is still running at deadline: cancelling request", NSStringFromClass([serviceInfo.service class]));
+    
+    // no retry nor hedge once deadline passed
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(sendHedgedRequestForServiceInfo:) object:serviceInfo];
+    serviceInfo.deadlineExceeded = YES;
+    [serviceInfo.hedgeOperation cancel];
+    [operation cancel];
+}
+
+- (ServiceDownloadProgressHandler) downloadProgressHandlerForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (serviceInfo.downloadProgressHandler == nil && ![serviceInfo.delegate respondsToSelector:@selector(didDownloadBytes:onTotalExpected:)])
+    {
+        return nil;
+    }
+    
+    return ^void (NSUInteger bytesRead, long long totalBytesRead, long long totalBytesExpectedToRead) {
+        if ([serviceInfo.delegate respondsToSelector:@selector(didDownloadBytes:onTotalExpected:)])
+        {
+            [serviceInfo.delegate didDownloadBytes:totalBytesRead onTotalExpected:totalBytesExpectedToRead];
         }
-        case SDHTTPMethodPUT : {
-            operation = [requestOperationManager PUT:path parameters:parameters success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
-                [weakself manageResponse:responseObject inOperation:operation forServiceInfo:serviceInfo];
-            } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
-                [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
-            }];
+        
+        if (serviceInfo.downloadProgressHandler)
+        {
+            serviceInfo.downloadProgressHandler(bytesRead, totalBytesRead, totalBytesExpectedToRead);
+        }
+    };
+}
+
+/**
+ *  Retrieve response from local file.
+ */
+- (void) callServiceInDemoModeWithServiceCallInfo:(SDServiceCallInfo*)serviceInfo waitingTime:(NSTimeInterval)waitingTime
+{
+    __weak typeof (self) weakSelf = self;
+    [serviceInfo.service getResultFromJSONFileAtPath:[serviceInfo.service demoModeJsonFilePath] waitingTime:waitingTime withCompletion:^(id responseObject) {
+        if (responseObject)
+        {
+            [weakSelf manageResponse:responseObject inOperation:nil forServiceInfo:serviceInfo];
+        }
+        else
+        {
+            NSString* errorString = [NSString stringWithFormat:@"Cannot find JSON file %@ for service %@", [serviceInfo.service demoModeJsonFileName], NSStringFromClass([serviceInfo.service class])];
+            NSError* error = [NSError errorWithDomain:@"DEMO_MODE" code:-1 userInfo:@{ NSLocalizedDescriptionKey : errorString }];
+            [weakSelf manageError:error inOperation:nil forServiceInfo:serviceInfo];
+        }
+    }];
+}
+
+/**
+ *  Retrieve error response from local file.
+ */
+- (void) callServiceInDemoModeForFailureWithServiceCallInfo:(SDServiceCallInfo*)serviceInfo
+{
+    // read json from file asking at service the demo file name
+    NSString* jsonFileName;
+    
+    if ([serviceInfo.service respondsToSelector:@selector(demoModeJsonFailureFileName)])
+    {
+        jsonFileName = [serviceInfo.service demoModeJsonFailureFileName];
+    }
+    
+    NSString* pathToFile = [[NSBundle mainBundle] pathForResource:jsonFileName ofType:@"json"];
+    
+    __weak typeof (self) weakSelf = self;
+    [serviceInfo.service getResultFromJSONFileAtPath:pathToFile withCompletion:^(id  _Nullable responseObject) {
+        if (responseObject)
+        {
+            int statusCode = 400;
+            if([serviceInfo.service respondsToSelector:@selector(demoModeFailureStatusCode)])
+            {
+                statusCode = [serviceInfo.service demoModeFailureStatusCode];
+            }
+            
+            NSError* mappingError = nil;
+            id errorObject = [serviceInfo.service errorForObject:responseObject error:&mappingError];
+            if (mappingError)
+            {
+                SDLogModuleError(kServiceManagerLogModuleName, @"Error object unmanaged: %@\nError: %@", responseObject, mappingError);
+            }
+            
+            [weakSelf manageError:mappingError forServiceInfo:serviceInfo withErrorObject:errorObject statusCode:statusCode];
+        }
+        else
+        {
+            NSString* errorString = [NSString stringWithFormat:@"Cannot find JSON file %@ for service %@", jsonFileName, NSStringFromClass([serviceInfo.service class])];
+            NSError* error = [NSError errorWithDomain:@"DEMO_MODE" code:-1 userInfo:@{ NSLocalizedDescriptionKey : errorString }];
+            [weakSelf manageError:error inOperation:nil forServiceInfo:serviceInfo];
+        }
+    }];
+}
+
+/**
+ *  Simulate latency and faults of the profile in demo mode.
+ */
+- (void) callServiceInDemoModeWithFaultProfile:(SDServiceFaultProfile*)profile serviceCallInfo:(SDServiceCallInfo*)serviceInfo
+{
+    NSData* responseData = [SDServiceGeneric demoModeFileDataAtPath:[serviceInfo.service demoModeJsonFilePath]];
+    SDServiceFaultOutcome* outcome = [self.faultInjector nextOutcomeForService:serviceInfo.service profile:profile responseLength:responseData.length];
+    
+    SDLogModuleInfo(kServiceManagerLogModuleName, @"Service %@ in DEMO MODE -> %@", NSStringFromClass([serviceInfo.service class]), outcome);
+    
+    [self simulateDownloadProgressOfOutcome:outcome expectedLength:responseData.length forServiceInfo:serviceInfo];
+    
+    if (outcome.faultType == SDServiceFaultTypeNone)
+    {
+        [self callServiceInDemoModeWithServiceCallInfo:serviceInfo waitingTime:outcome.duration];
+        return;
+    }
+    
+    NSError* error = nil;
+    NSHTTPURLResponse* response = nil;
+    NSData* errorData = nil;
+    NSURL* url = [NSURL URLWithString:serviceInfo.service.pathResource relativeToURL:serviceInfo.service.requestOperationManager.baseURL] ? : [NSURL URLWithString:@"http://localhost/"];
+    
+    switch (outcome.faultType)
+    {
+        case SDServiceFaultTypeErrorStatusCode: {
+            if ([serviceInfo.service respondsToSelector:@selector(demoModeJsonFailureFileName)])
+            {
+                errorData = [SDServiceGeneric demoModeFileDataAtPath:[[NSBundle mainBundle] pathForResource:[serviceInfo.service demoModeJsonFailureFileName] ofType:@"json"]];
+            }
+            
+            NSMutableDictionary* headers = [NSMutableDictionary dictionaryWithDictionary:outcome.headers];
+            headers[@"Content-Type"] = @"application/json";
+            response = [[NSHTTPURLResponse alloc] initWithURL:url statusCode:outcome.statusCode HTTPVersion:@"HTTP/1.1" headerFields:headers];
+            
+            // same error of AFNetworking for unacceptable status codes
+            NSString* errorString = [NSString stringWithFormat:@"Request failed: %@ (%ld)", [NSHTTPURLResponse localizedStringForStatusCode:outcome.statusCode], (long)outcome.statusCode];
+            error = [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorBadServerResponse userInfo:@{ NSLocalizedDescriptionKey : errorString, NSURLErrorFailingURLErrorKey : url, AFNetworkingOperationFailingURLResponseErrorKey : response }];
             break;
         }
-        case SDHTTPMethodDELETE : {
-            operation = [requestOperationManager DELETE:path parameters:parameters success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
-                [weakself manageResponse:responseObject inOperation:operation forServiceInfo:serviceInfo];
-            } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
-                [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
-            }];
+        case SDServiceFaultTypeTimeout: {
+            error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:@{ NSLocalizedDescriptionKey : @"The request timed out.", NSURLErrorFailingURLErrorKey : url }];
             break;
         }
-        case SDHTTPMethodHEAD : {
-            operation = [requestOperationManager HEAD:path parameters:parameters success:^(AFHTTPRequestOperation* _Nonnull operation) {
-                [weakself manageResponse:nil inOperation:operation forServiceInfo:serviceInfo];
-            } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
-                [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
-            }];
+        case SDServiceFaultTypeConnectionDrop: {
+            error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:@{ NSLocalizedDescriptionKey : @"The network connection was lost.", NSURLErrorFailingURLErrorKey : url }];
             break;
         }
-        case SDHTTPMethodPATCH : {
-            operation = [requestOperationManager PATCH:path parameters:parameters success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
-                [weakself manageResponse:responseObject inOperation:operation forServiceInfo:serviceInfo];
-            } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
-                [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
-            }];
+        case SDServiceFaultTypeNone:
             break;
+    }
+    
+    __weak typeof (self) weakself = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(outcome.duration * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [weakself manageError:error HTTPResponse:response responseData:errorData inOperation:nil forServiceInfo:serviceInfo];
+    });
+}
+
+/**
+ *  Report download progress of the simulated body, delivered at the bandwidth of the profile.
+ */
+- (void) simulateDownloadProgressOfOutcome:(SDServiceFaultOutcome*)outcome expectedLength:(unsigned long long)expectedLength forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    ServiceDownloadProgressHandler downloadHandler = [self downloadProgressHandlerForServiceInfo:serviceInfo];
+    if (!downloadHandler || outcome.deliveredLength == 0)
+    {
+        return;
+    }
+    
+    // one update every 100 ms (at most 100 updates)
+    NSTimeInterval transferTime = MAX(outcome.duration - outcome.latency, 0);
+    NSUInteger steps = MIN(MAX((NSUInteger)ceil(transferTime / 0.1), 1), 100);
+    unsigned long long previousDelivered = 0;
+    for (NSUInteger step = 1; step <= steps; step++)
+    {
+        unsigned long long delivered = outcome.deliveredLength * step / steps;
+        NSUInteger bytesRead = (NSUInteger)(delivered - previousDelivered);
+        previousDelivered = delivered;
+        
+        NSTimeInterval time = outcome.latency + transferTime * step / steps;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(time * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            downloadHandler(bytesRead, (long long)delivered, (long long)expectedLength);
+        });
+    }
+}
+
+/**
+ *  Retrieve response from the traffic archive.
+ */
+- (void) callServiceInReplayModeWithServiceCallInfo:(SDServiceCallInfo*)serviceInfo
+{
+    SDServiceTrafficArchive* archive = self.trafficArchive;
+    AFHTTPResponseSerializer* responseSerializer = serviceInfo.service.requestOperationManager.responseSerializer;
+    double latencyScale = MAX(self.replayLatencyScale, 0.);
+    
+    __weak typeof (self) weakself = self;
+    [self.mappingExecutor addBlock:^{
+        SDServiceTrafficRecord* record = [archive recordForKey:serviceInfo.trafficKey];
+        if (!record)
+        {
+            NSString* errorString = [NSString stringWithFormat:@"Cannot find record %@ for service %@", serviceInfo.trafficKey, NSStringFromClass([serviceInfo.service class])];
+            NSError* error = [NSError errorWithDomain:@"REPLAY_MODE" code:-1 userInfo:@{ NSLocalizedDescriptionKey : errorString }];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [weakself manageError:error HTTPResponse:nil responseData:nil inOperation:nil forServiceInfo:serviceInfo];
+            });
+            return;
         }
+        
+        // recorded latency is counted from the start of the call
+        dispatch_time_t completionTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)((record.duration * latencyScale - (CFAbsoluteTimeGetCurrent() - serviceInfo.attemptStartTime)) * NSEC_PER_SEC));
+        
+        // same validation and parsing of a real response
+        NSHTTPURLResponse* response = [record HTTPURLResponse];
+        NSError* error = nil;
+        id responseObject = [weakself responseObjectForResponse:response data:record.responseBody serializer:responseSerializer error:&error];
+        
+        dispatch_after(completionTime, dispatch_get_main_queue(), ^{
+            if (error)
+            {
+                [weakself manageError:error HTTPResponse:response responseData:record.responseBody inOperation:nil forServiceInfo:serviceInfo];
+            }
+            else
+            {
+                [weakself manageResponse:responseObject HTTPResponse:response inOperation:nil forServiceInfo:serviceInfo];
+            }
+        });
+    } priority:serviceInfo.priority];
+}
+
+#pragma mark - Body codecs
+
+- (void) registerBodyCodec:(id<SDServiceBodyCodec>)codec
+{
+    @synchronized (self)
+    {
+        NSMutableDictionary<NSString*, id<SDServiceBodyCodec>>* codecs = [self.bodyCodecs mutableCopy];
+        for (NSString* contentType in [codec contentTypes])
+        {
+            codecs[contentType.lowercaseString] = codec;
+        }
+        self.bodyCodecs = [codecs copy];
+    }
+}
+
+- (void) unregisterBodyCodecForContentType:(NSString*)contentType
+{
+    @synchronized (self)
+    {
+        NSMutableDictionary<NSString*, id<SDServiceBodyCodec>>* codecs = [self.bodyCodecs mutableCopy];
+        [codecs removeObjectForKey:contentType.lowercaseString];
+        self.bodyCodecs = [codecs copy];
+    }
+}
+
+/**
+ *  Path with query parameters appended to its query string, sorted by name (values are strings).
+ */
+- (NSString*) path:(NSString*)path byAddingQueryParameters:(NSDictionary<NSString*, NSString*>*)queryParameters
+{
+    if (queryParameters.count == 0)
+    {
+        return path;
+    }
+    
+    // separators of query string are escaped in names and values
+    NSMutableCharacterSet* allowedCharacters = [[NSCharacterSet URLQueryAllowedCharacterSet] mutableCopy];
+    [allowedCharacters removeCharactersInString:@"&=+?"];
+    NSMutableArray<NSString*>* pairs = [NSMutableArray arrayWithCapacity:queryParameters.count];
+    for (NSString* name in [queryParameters.allKeys sortedArrayUsingSelector:@selector(compare:)])
+    {
+        NSString* value = [queryParameters[name] description];
+        [pairs addObject:[NSString stringWithFormat:@"%@=%@", [name stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters], [value stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters]]];
+    }
+    NSString* separator = [path rangeOfString:@"?"].location == NSNotFound ? @"?" : @"&";
+    return [NSString stringWithFormat:@"%@%@%@", path, separator, [pairs componentsJoinedByString:@"&"]];
+}
+
+- (id<SDServiceBodyCodec>) bodyCodecForContentType:(NSString*)contentType
+{
+    if (contentType.length == 0)
+    {
+        return nil;
+    }
+    NSString* mediaType = [[contentType componentsSeparatedByString:@";"].firstObject stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    return self.bodyCodecs[mediaType.lowercaseString];
+}
+
+- (NSString*) bodyContentTypeForService:(SDServiceGeneric*)service
+{
+    return [service respondsToSelector:@selector(bodyContentType)] ? [service bodyContentType] : nil;
+}
+
+/**
+ *  Response object decoded by the codec of the response Content-Type, or by serializer if there is no codec for it.
+ *  As AFNetworking serializers, the object is returned also with an error for unacceptable status codes (to map error bodies).
+ */
+- (id) responseObjectForResponse:(NSURLResponse*)response data:(NSData*)data serializer:(AFHTTPResponseSerializer*)serializer error:(NSError**)error
+{
+    id<SDServiceBodyCodec> codec = [self bodyCodecForContentType:response.MIMEType];
+    if (!codec)
+    {
+        return [serializer responseObjectForResponse:response data:data error:error];
+    }
+    
+    // content type was validated by the data serializer of the call
+    NSError* decodingError = nil;
+    id object = data.length > 0 ? [codec objectWithData:data error:&decodingError] : nil;
+    NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse*)response).statusCode : 200;
+    if (!decodingError && serializer.acceptableStatusCodes && ![serializer.acceptableStatusCodes containsIndex:(NSUInteger)statusCode])
+    {
+        NSMutableDictionary* userInfo = [NSMutableDictionary dictionary];
+        userInfo[NSLocalizedDescriptionKey] = [NSString stringWithFormat:@"Request failed: %@ (%ld)", [NSHTTPURLResponse localizedStringForStatusCode:statusCode], (long)statusCode];
+        userInfo[NSURLErrorFailingURLErrorKey] = response.URL;
+        userInfo[AFNetworkingOperationFailingURLResponseErrorKey] = response;
+        userInfo[AFNetworkingOperationFailingURLResponseDataErrorKey] = data;
+        decodingError = [NSError errorWithDomain:AFURLResponseSerializationErrorDomain code:NSURLErrorBadServerResponse userInfo:userInfo];
+    }
+    if (decodingError && error)
+    {
+        *error = decodingError;
+    }
+    return object;
+}
+
+#pragma mark - Content decoders
+
+- (void) registerContentDecoderFactory:(SDServiceContentDecoderFactory)factory forContentEncoding:(NSString*)contentEncoding
+{
+    @synchronized (self)
+    {
+        NSMutableDictionary<NSString*, SDServiceContentDecoderFactory>* factories = [self.contentDecoderFactories mutableCopy];
+        factories[contentEncoding.lowercaseString] = [factory copy];
+        self.contentDecoderFactories = [factories copy];
+    }
+}
+
+- (void) unregisterContentDecoderFactoryForContentEncoding:(NSString*)contentEncoding
+{
+    @synchronized (self)
+    {
+        NSMutableDictionary<NSString*, SDServiceContentDecoderFactory>* factories = [self.contentDecoderFactories mutableCopy];
+        [factories removeObjectForKey:contentEncoding.lowercaseString];
+        self.contentDecoderFactories = [factories copy];
+    }
+}
+
+/**
+ *  Write the body of the operation in a stream that decodes it while it arrives. Must be called before the operation starts.
+ */
+- (void) setContentDecodingStreamOfOperation:(AFHTTPRequestOperation*)operation decoderFactories:(NSDictionary<NSString*, SDServiceContentDecoderFactory>*)decoderFactories
+{
+    if (!operation)
+    {
+        return;
+    }
+    __weak AFHTTPRequestOperation* weakOperation = operation;
+    operation.outputStream = [[SDServiceContentDecodingStream alloc] initWithDecoderFactories:decoderFactories responseBlock:^NSHTTPURLResponse* {
+        return weakOperation.response;
+    }];
+}
+
+/**
+ *  Error decoding the body of the operation, if the body could not be decoded (the operation keeps its stream only without response data).
+ */
+- (NSError*) contentDecodingErrorOfOperation:(AFHTTPRequestOperation*)operation
+{
+    if (!operation || operation.responseData || ![operation.outputStream isKindOfClass:[SDServiceContentDecodingStream class]])
+    {
+        return nil;
+    }
+    return operation.outputStream.streamError;
+}
+
+/**
+ *  Body of a response cached by NSURLCache, that keeps bodies as they arrived: encodings with a decoder are decoded.
+ */
+- (NSData*) decodedDataOfCachedResponse:(NSCachedURLResponse*)cachedResponse
+{
+    NSDictionary<NSString*, SDServiceContentDecoderFactory>* contentDecoderFactories = self.contentDecoderFactories;
+    if (!cachedResponse.data || contentDecoderFactories.count == 0 || ![cachedResponse.response isKindOfClass:[NSHTTPURLResponse class]])
+    {
+        return cachedResponse.data;
+    }
+    NSError* error = nil;
+    NSData* data = [SDServiceContentDecodingStream dataByDecodingData:cachedResponse.data response:(NSHTTPURLResponse*)cachedResponse.response decoderFactories:contentDecoderFactories error:&error];
+    if (!data)
+    {
+        SDLogModuleError(kServiceManagerLogModuleName, @"Cached response of %@ can't be decoded: %@", cachedResponse.response.URL.absoluteString, error);
+    }
+    return data;
+}
+
+#pragma mark - Deferrable calls
+
+- (void) setDeferredRequestQueue:(SDDeferredRequestQueue*)deferredRequestQueue
+{
+    _deferredRequestQueue = deferredRequestQueue;
+    
+    // calls deferred by managers of this class, restored ones included
+    __weak typeof (self) weakself = self;
+    [deferredRequestQueue setSendBlock:^BOOL (SDDeferredRequest* request) {
+        SDServiceCallInfo* serviceInfo = request.context ?: [weakself serviceInfoWithDeferredPayload:request.payload];
+        if (!serviceInfo)
+        {
+            // invalid payload: discarded
+            SDLogModuleWarning(kServiceManagerLogModuleName, @"Deferred call %@ can't be restored", request.requestDescription);
+            return YES;
+        }
+        SDServiceManager* serviceManager = serviceInfo.deferringServiceManager ?: weakself;
+        if (!serviceManager)
+        {
+            return NO;
+        }
+        serviceInfo.deferredRequest = nil;
+        serviceInfo.deferralEnded = YES;
+        [serviceManager callServiceWithServiceCallInfo:serviceInfo];
+        return YES;
+    } forOwnerName:NSStringFromClass([self class])];
+}
+
+- (void) deferServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    SDLogModuleVerbose(kServiceManagerLogModuleName, @"Service %@ deferred", NSStringFromClass([serviceInfo.service class]));
+    serviceInfo.deferringServiceManager = self;
+    serviceInfo.deferredRequest = [self.deferredRequestQueue enqueueRequestWithOwnerName:NSStringFromClass([self class]) requestDescription:NSStringFromClass([serviceInfo.service class]) payload:[self deferredPayloadForServiceInfo:serviceInfo] context:serviceInfo];
+}
+
+/**
+ *  Property list of the call saved across launches: service class and archived request (nil if the request can't be archived).
+ */
+- (NSDictionary*) deferredPayloadForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (![serviceInfo.request conformsToProtocol:@protocol(NSCoding)])
+    {
+        return nil;
+    }
+    NSData* requestData = nil;
+    @try
+    {
+        requestData = [NSKeyedArchiver archivedDataWithRootObject:serviceInfo.request];
+    }
+    @catch (NSException* exception)
+    {
+        SDLogModuleWarning(kServiceManagerLogModuleName, @"Deferred call %@ will not be saved: %@", NSStringFromClass([serviceInfo.service class]), exception.reason);
+        return nil;
+    }
+    return @{ DEFERRED_CALL_SERVICE_CLASS : NSStringFromClass([serviceInfo.service class]),
+              DEFERRED_CALL_REQUEST : requestData,
+              DEFERRED_CALL_OPERATION_TYPE : @(serviceInfo.type),
+              DEFERRED_CALL_NUM_AUTOMATIC_RETRY : @(serviceInfo.numAutomaticRetry) };
+}
+
+- (SDServiceCallInfo*) serviceInfoWithDeferredPayload:(NSDictionary*)payload
+{
+    Class serviceClass = NSClassFromString(payload[DEFERRED_CALL_SERVICE_CLASS]);
+    NSData* requestData = payload[DEFERRED_CALL_REQUEST];
+    if (![serviceClass isSubclassOfClass:[SDServiceGeneric class]] || ![requestData isKindOfClass:[NSData class]])
+    {
+        return nil;
+    }
+    id request = nil;
+    @try
+    {
+        request = [NSKeyedUnarchiver unarchiveObjectWithData:requestData];
+    }
+    @catch (NSException* exception)
+    {
+        return nil;
+    }
+    if (![request conformsToProtocol:@protocol(SDServiceGenericRequestProtocol)])
+    {
+        return nil;
+    }
+    SDServiceCallInfo* serviceInfo = [[SDServiceCallInfo alloc] initWithService:[serviceClass new] request:request];
+    serviceInfo.type = [payload[DEFERRED_CALL_OPERATION_TYPE] integerValue];
+    serviceInfo.numAutomaticRetry = [payload[DEFERRED_CALL_NUM_AUTOMATIC_RETRY] intValue];
+    serviceInfo.deferrable = YES;
+    return serviceInfo;
+}
+
+#pragma mark - Hedged requests
+
+- (void) scheduleHedgeForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    serviceInfo.hedgeOperation = nil;
+    serviceInfo.hedgeLoserOperation = nil;
+    
+    if (![serviceInfo.service respondsToSelector:@selector(hedgingPolicy)])
+    {
+        return;
+    }
+    SDServiceHedgingPolicy* policy = [serviceInfo.service hedgingPolicy];
+    if (!policy)
+    {
+        return;
+    }
+    
+    // only idempotent calls can be sent twice
+    SDHTTPMethod method = serviceInfo.service.requestMethodType;
+    BOOL idempotent = method == SDHTTPMethodGET || method == SDHTTPMethodHEAD || method == SDHTTPMethodPUT || method == SDHTTPMethodDELETE;
+    if (!idempotent || serviceInfo.request.multipartInfos.count > 0)
+    {
+        return;
+    }
+    
+    // every call earns its share of hedges
+    NSString* key = NSStringFromClass([serviceInfo.service class]);
+    double budget = MIN(self.hedgeBudgets[key].doubleValue + policy.budgetRatio, policy.maximumBudget);
+    self.hedgeBudgets[key] = @(budget);
+    
+    if ([self.latencyTracker numberOfSamplesForService:serviceInfo.service] < MAX(policy.minimumNumberOfSamples, 1))
+    {
+        return;
+    }
+    
+    NSTimeInterval delay = MAX([self.latencyTracker latencyAtPercentile:policy.percentile forService:serviceInfo.service], policy.minimumDelay);
+    if (![self hasTimeForAttemptAfterDelay:delay forServiceInfo:serviceInfo])
+    {
+        return;
+    }
+    [self performSelector:@selector(sendHedgedRequestForServiceInfo:) withObject:serviceInfo afterDelay:delay];
+}
+
+- (void) sendHedgedRequestForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    AFHTTPRequestOperation* operation = serviceInfo.operation;
+    if (!operation || operation.isFinished || operation.isCancelled || serviceInfo.hedgeOperation)
+    {
+        return;
+    }
+    
+    SDServiceHedgingPolicy* policy = [serviceInfo.service hedgingPolicy];
+    NSString* key = NSStringFromClass([serviceInfo.service class]);
+    double budget = self.hedgeBudgets[key].doubleValue;
+    if (budget < 1.)
+    {
+        SDLogModuleVerbose(kServiceManagerLogModuleName, @"Service %@ is slow but hedge budget is over", key);
+        return;
+    }
+    self.hedgeBudgets[key] = @(budget - 1.);
+    
+    AFHTTPRequestOperationManager* requestOperationManager = [serviceInfo.service requestOperationManager];
+    NSMutableURLRequest* request = [operation.request mutableCopy];
+    if (policy.alternateBaseURL)
+    {
+        // keep the part of URL relative to base URL of the operation manager
+        NSString* URLString = request.URL.absoluteString;
+        NSString* baseURLString = requestOperationManager.baseURL.absoluteString;
+        if (baseURLString.length > 0 && [URLString hasPrefix:baseURLString])
+        {
+            URLString = [URLString substringFromIndex:baseURLString.length];
+        }
+        request.URL = [NSURL URLWithString:URLString relativeToURL:policy.alternateBaseURL];
+    }
+    if (serviceInfo.deadline)
+    {
+        request.timeoutInterval = MIN(request.timeoutInterval, [serviceInfo.deadline timeIntervalSinceNow]);
+    }
+    
+    SDLogModuleInfo(kServiceManagerLogModuleName, @"Service %@ is slow: sending hedged request to %@", key, request.URL.absoluteString);
+    
+    __weak typeof (self) weakself = self;
+    AFHTTPRequestOperation* hedgeOperation = [requestOperationManager HTTPRequestOperationWithRequest:request success:^(AFHTTPRequestOperation* _Nonnull operation, id _Nonnull responseObject) {
+        [weakself manageResponse:responseObject inOperation:operation forServiceInfo:serviceInfo];
+    } failure:^(AFHTTPRequestOperation* _Nullable operation, NSError* _Nonnull error) {
+        [weakself manageError:error inOperation:operation forServiceInfo:serviceInfo];
+    }];
+    hedgeOperation.responseSerializer = operation.responseSerializer;
+    hedgeOperation.completionQueue = operation.completionQueue;
+    if (serviceInfo.cachingBlock != nil)
+    {
+        [hedgeOperation setCacheResponseBlock:serviceInfo.cachingBlock];
+    }
+    if (serviceInfo.authenticationChallengeBlock != nil)
+    {
+        [hedgeOperation setWillSendRequestForAuthenticationChallengeBlock:serviceInfo.authenticationChallengeBlock];
+    }
+    if ([operation.outputStream isKindOfClass:[SDServiceContentDecodingStream class]])
+    {
+        [self setContentDecodingStreamOfOperation:hedgeOperation decoderFactories:self.contentDecoderFactories];
+    }
+    
+    serviceInfo.hedgeOperation = hedgeOperation;
+    [self addOperation:hedgeOperation forDelegate:serviceInfo.delegate];
+    [requestOperationManager.operationQueue addOperation:hedgeOperation];
+}
+
+/**
+ *  Decide if the result of the operation must be managed: with a hedged attempt, the first response wins and the other request is cancelled.
+ *  A failure without response waits for the other request, if still running.
+ */
+- (BOOL) shouldManageResultOfOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (operation && operation == serviceInfo.hedgeLoserOperation)
+    {
+        [self removeExecutedOperation:operation forDelegate:serviceInfo.delegate];
+        return NO;
+    }
+    
+    AFHTTPRequestOperation* hedgeOperation = serviceInfo.hedgeOperation;
+    if (!hedgeOperation)
+    {
+        // not hedged
+        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(sendHedgedRequestForServiceInfo:) object:serviceInfo];
+        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(expireDeadlineOfServiceInfo:) object:serviceInfo];
+        return YES;
+    }
+    
+    AFHTTPRequestOperation* otherOperation = (operation == hedgeOperation) ? serviceInfo.operation : hedgeOperation;
+    serviceInfo.hedgeOperation = nil;
+    
+    if (!operation.response && otherOperation && !otherOperation.isFinished)
+    {
+        // the other request is still running and can still get a response
+        [self removeExecutedOperation:operation forDelegate:serviceInfo.delegate];
+        serviceInfo.operation = otherOperation;
+        return NO;
+    }
+    
+    SDLogModuleVerbose(kServiceManagerLogModuleName, @"Service %@: %@ request wins", NSStringFromClass([serviceInfo.service class]), operation == hedgeOperation ? @"hedged" : @"original");
+    serviceInfo.operation = operation;
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(expireDeadlineOfServiceInfo:) object:serviceInfo];
+    if (otherOperation)
+    {
+        serviceInfo.hedgeLoserOperation = otherOperation;
+        [otherOperation cancel];
+    }
+    return YES;
+}
+
+#pragma mark - Traffic record
+
+- (void) recordOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (self.trafficMode != SDServiceTrafficModeRecord || !serviceInfo.trafficKey || !operation.response)
+    {
+        return;
+    }
+    
+    SDServiceTrafficRecord* record = [SDServiceTrafficRecord new];
+    record.key = serviceInfo.trafficKey;
+    record.HTTPMethod = operation.request.HTTPMethod;
+    record.URLString = operation.request.URL.absoluteString;
+    record.requestHeaders = operation.request.allHTTPHeaderFields;
+    record.requestBody = operation.request.HTTPBody;
+    record.statusCode = operation.response.statusCode;
+    record.responseHeaders = operation.response.allHeaderFields;
+    record.responseBody = operation.responseData;
+    record.duration = CFAbsoluteTimeGetCurrent() - serviceInfo.attemptStartTime;
+    record.date = [NSDate date];
+    
+    if (record.statusCode == 304)
+    {
+        // replay must return the content, not the validation of the cache
+        NSCachedURLResponse* cachedResponse = [[NSURLCache sharedURLCache] cachedResponseForRequest:operation.request];
+        if ([cachedResponse.response isKindOfClass:[NSHTTPURLResponse class]])
+        {
+            record.statusCode = ((NSHTTPURLResponse*)cachedResponse.response).statusCode;
+            record.responseBody = [self decodedDataOfCachedResponse:cachedResponse];
+        }
+    }
+    
+    [self.trafficArchive addRecord:record];
+}
+
+#pragma mark - Conditional calls
+
+- (NSDictionary<NSString*, NSString*>*) conditionalRequestHeadersForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (!serviceInfo.notModifiedHandler)
+    {
+        return nil;
+    }
+    NSMutableDictionary<NSString*, NSString*>* headers = [NSMutableDictionary dictionary];
+    if (serviceInfo.entityTag.length > 0)
+    {
+        headers[@"If-None-Match"] = serviceInfo.entityTag;
+    }
+    if (serviceInfo.lastModified.length > 0)
+    {
+        headers[@"If-Modified-Since"] = serviceInfo.lastModified;
+    }
+    return headers;
+}
+
+/**
+ *  Save validators of the response in the call, for conditional calls.
+ *
+ *  @return YES if server answered 304 to a conditional call.
+ */
+- (BOOL) updateValidatorsOfServiceInfo:(SDServiceCallInfo*)serviceInfo withOperation:(AFHTTPRequestOperation*)operation
+{
+    NSHTTPURLResponse* response = operation.response;
+    if (!serviceInfo.notModifiedHandler || !response)
+    {
+        return NO;
+    }
+    BOOL notModified = response.statusCode == 304;
+    if (!notModified && (response.statusCode < 200 || response.statusCode >= 300))
+    {
+        return NO;
     }
     
-    // remove additional header from serializer
-    for (NSString* headerKey in additionalRequestHeaders.allKeys)
+    NSString* entityTag = [self valueForHeader:@"ETag" inResponse:response];
+    NSString* lastModified = [self valueForHeader:@"Last-Modified" inResponse:response];
+    if (!notModified || entityTag)
     {
-        [serializer setValue:nil forHTTPHeaderField:headerKey];
+        serviceInfo.entityTag = entityTag;
     }
+    if (!notModified || lastModified)
+    {
+        serviceInfo.lastModified = lastModified;
+    }
+    return notModified;
+}
+
+- (NSString*) valueForHeader:(NSString*)headerName inResponse:(NSHTTPURLResponse*)response
+{
+    for (NSString* key in response.allHeaderFields)
+    {
+        if ([key caseInsensitiveCompare:headerName] == NSOrderedSame)
+        {
+            return [response.allHeaderFields[key] description];
+        }
+    }
+    return nil;
+}
+
++ (NSString*) digestOfData:(NSData*)data
+{
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    NSMutableString* digestString = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++)
+    {
+        [digestString appendFormat:@"%02x", digest[i]];
+    }
+    return digestString;
+}
+
+- (void) manageNotModifiedResponseInOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    SDLogModuleVerbose(kServiceManagerLogModuleName, @"Service %@: response not modified", NSStringFromClass([serviceInfo.service class]));
     
+    serviceInfo.isProcessing = NO;
+    [self.servicesQueue removeObject:serviceInfo];
+    [self removeExecutedOperation:operation forDelegate:serviceInfo.delegate];
     
-    // set the operation's download progress block if needed
-    if (serviceInfo.downloadProgressHandler != nil || [serviceInfo.delegate respondsToSelector:@selector(didDownloadBytes:onTotalExpected:)])
+    if (serviceInfo.notModifiedHandler)
     {
-        ServiceDownloadProgressHandler downloadHandler = ^void (NSUInteger bytesRead, long long totalBytesRead, long long totalBytesExpectedToRead) {
-            if ([serviceInfo.delegate respondsToSelector:@selector(didDownloadBytes:onTotalExpected:)])
-            {
-                [serviceInfo.delegate didDownloadBytes:totalBytesRead onTotalExpected:totalBytesExpectedToRead];
-            }
-            
-            if (serviceInfo.downloadProgressHandler)
-            {
-                serviceInfo.downloadProgressHandler(bytesRead, totalBytesRead, totalBytesExpectedToRead);
-            }
-        };
-        
-        [operation setDownloadProgressBlock:downloadHandler];
+        serviceInfo.notModifiedHandler();
     }
     
-    // set the operation's upload progress block if needed
-    if (serviceInfo.uploadProgressHandler != nil || [serviceInfo.delegate respondsToSelector:@selector(didUploadBytes:onTotalExpected:)])
+    if ([serviceInfo.delegate respondsToSelector:@selector(didEndServiceOperation:withRequest:result:error:)])
     {
-        ServiceUploadProgressHandler uploadHandler = ^void (NSUInteger bytesWritten, long long totalBytesWritten, long long totalBytesExpectedToWrite) {
-            if ([serviceInfo.delegate respondsToSelector:@selector(didUploadBytes:onTotalExpected:)])
-            {
-                [serviceInfo.delegate didUploadBytes:totalBytesWritten onTotalExpected:totalBytesExpectedToWrite];
-            }
-            
-            if (serviceInfo.uploadProgressHandler)
-            {
-                serviceInfo.uploadProgressHandler(bytesWritten, totalBytesWritten, totalBytesExpectedToWrite);
-            }
-        };
-        
-        [operation setUploadProgressBlock:uploadHandler];
+        [serviceInfo.delegate didEndServiceOperation:serviceInfo.type withRequest:serviceInfo.request result:nil error:nil];
     }
     
-    // set the operation's caching block if needed
-    if (serviceInfo.cachingBlock != nil)
+    if (!self.hasPendingOperations)
     {
-        [operation setCacheResponseBlock:serviceInfo.cachingBlock];
+        [self didCompleteAllServices];
     }
-    
-    // set the operation's authentication block if needed
-    if (serviceInfo.authenticationChallengeBlock != nil)
+}
+
+#pragma mark - Delta responses
+
+/**
+ *  Cached document to send as base of a delta response, nil for a full call. It also sets the key of the call in deltaDocumentCache.
+ */
+- (SDServiceDeltaDocument*) deltaDocumentForServiceInfo:(SDServiceCallInfo*)serviceInfo path:(NSString*)path parameters:(NSDictionary*)parameters additionalRequestHeaders:(NSDictionary<NSString*, NSString*>*)additionalRequestHeaders
+{
+    serviceInfo.deltaKey = nil;
+    SDServiceGeneric* service = serviceInfo.service;
+    if (![service respondsToSelector:@selector(acceptsDeltaResponses)] || ![service acceptsDeltaResponses] || serviceInfo.notModifiedHandler || !serviceInfo.defersResponseParsing)
     {
-        [operation setWillSendRequestForAuthenticationChallengeBlock:serviceInfo.authenticationChallengeBlock];
+        return nil;
     }
     
-    // add operation to the caller
-    [self addOperation:operation forDelegate:serviceInfo.delegate];
+    // body encoded by the service is part of the request
+    NSDictionary* keyParameters = parameters ?: (serviceInfo.requestBody ? @{ @"body" : [SDServiceManager digestOfData:serviceInfo.requestBody] } : nil);
+    serviceInfo.deltaKey = [SDServiceTrafficArchive keyForHTTPMethod:NSStringFromSDHTTPMethod(service.requestMethodType) path:path parameters:keyParameters];
+    if (serviceInfo.deltaDisabled || additionalRequestHeaders[@"If-None-Match"] || additionalRequestHeaders[@"A-IM"])
+    {
+        return nil;
+    }
+    return [self.deltaDocumentCache objectForKey:serviceInfo.deltaKey];
 }
 
 /**
- *  Retrieve response from local file.
+ *  Document of a delta response: the base document if not modified (304), the base document patched if server answered 226 with a JSON Patch.
  */
-- (void) callServiceInDemoModeWithServiceCallInfo:(SDServiceCallInfo*)serviceInfo
+- (id) documentForDeltaResponse:(NSHTTPURLResponse*)HTTPResponse data:(NSData*)data baseDocument:(SDServiceDeltaDocument*)baseDocument error:(NSError**)error
 {
-    __weak typeof (self) weakSelf = self;
-    [serviceInfo.service getResultFromJSONFileWithCompletion:^(id responseObject) {
-        if (responseObject)
+    if (HTTPResponse.statusCode == 304)
+    {
+        return baseDocument.document;
+    }
+    
+    NSString* instanceManipulations = [self valueForHeader:@"IM" inResponse:HTTPResponse];
+    NSString* deltaBase = [self valueForHeader:@"Delta-Base" inResponse:HTTPResponse];
+    if (!instanceManipulations || [instanceManipulations rangeOfString:@"json-patch" options:NSCaseInsensitiveSearch].location == NSNotFound || (deltaBase && ![deltaBase isEqualToString:baseDocument.entityTag]))
+    {
+        if (error)
         {
-            [weakSelf manageResponse:responseObject inOperation:nil forServiceInfo:serviceInfo];
+            *error = [NSError errorWithDomain:SDServiceJSONPatchErrorDomain code:SDServiceJSONPatchErrorCodeBaseMismatch userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Delta response %@ of %@ for cached document %@", instanceManipulations, deltaBase, baseDocument.entityTag] }];
         }
-        else
+        return nil;
+    }
+    
+    id patch = data.length > 0 ? [NSJSONSerialization JSONObjectWithData:data options:0 error:error] : nil;
+    if (![patch isKindOfClass:[NSArray class]])
+    {
+        if (error && !*error)
         {
-            NSString* errorString = [NSString stringWithFormat:@"Cannot find JSON file %@ for service %@", [serviceInfo.service demoModeJsonFileName], NSStringFromClass([serviceInfo.service class])];
-            NSError* error = [NSError errorWithDomain:@"DEMO_MODE" code:-1 userInfo:@{ NSLocalizedDescriptionKey : errorString }];
-            [weakSelf manageError:error inOperation:nil forServiceInfo:serviceInfo];
+            *error = [NSError errorWithDomain:SDServiceJSONPatchErrorDomain code:SDServiceJSONPatchErrorCodeInvalidPatch userInfo:@{ NSLocalizedDescriptionKey : @"Delta response is not a JSON Patch" }];
         }
-    }];
+        return nil;
+    }
+    return [SDServiceJSONPatch objectByApplyingPatch:patch toObject:baseDocument.document error:error];
 }
 
 /**
- *  Retrieve error response from local file.
+ *  Keep the document of the response as base of next delta responses, if server sent its ETag.
  */
-- (void) callServiceInDemoModeForFailureWithServiceCallInfo:(SDServiceCallInfo*)serviceInfo
+- (void) updateDeltaDocumentCacheForServiceInfo:(SDServiceCallInfo*)serviceInfo HTTPResponse:(NSHTTPURLResponse*)HTTPResponse document:(id)document response:(id<SDServiceGenericResponseProtocol>)response
 {
-    // read json from file asking at service the demo file name
-    NSString* jsonFileName;
-    
-    if ([serviceInfo.service respondsToSelector:@selector(demoModeJsonFailureFileName)])
+    NSString* entityTag = [self valueForHeader:@"ETag" inResponse:HTTPResponse];
+    if (HTTPResponse.statusCode == 304 && serviceInfo.deltaDocument)
     {
-        jsonFileName = [serviceInfo.service demoModeJsonFailureFileName];
+        entityTag = entityTag ?: serviceInfo.deltaDocument.entityTag;
     }
-    
-    NSString* pathToFile = [[NSBundle mainBundle] pathForResource:jsonFileName ofType:@"json"];
+    serviceInfo.deltaDisabled = NO;
+    if (entityTag.length > 0 && document && response)
+    {
+        [self.deltaDocumentCache setObject:[[SDServiceDeltaDocument alloc] initWithEntityTag:entityTag document:document response:response] forKey:serviceInfo.deltaKey];
+    }
+    else
+    {
+        [self.deltaDocumentCache removeObjectForKey:serviceInfo.deltaKey];
+    }
+}
 
-    __weak typeof (self) weakSelf = self;
-    [serviceInfo.service getResultFromJSONFileAtPath:pathToFile withCompletion:^(id  _Nullable responseObject) {
-        if (responseObject)
-        {
-            int statusCode = 400;
-            if([serviceInfo.service respondsToSelector:@selector(demoModeFailureStatusCode)])
-            {
-                statusCode = [serviceInfo.service demoModeFailureStatusCode];
-            }
-            
-            NSError* mappingError = nil;
-            id errorObject = [serviceInfo.service errorForObject:responseObject error:&mappingError];
-            if (mappingError)
-            {
-                SDLogModuleError(kServiceManagerLogModuleName, @"Error object unmanaged: %@\nError: %@", responseObject, mappingError);
-            }
-            
-            [weakSelf manageError:mappingError forServiceInfo:serviceInfo withErrorObject:errorObject statusCode:statusCode];
-        }
-        else
-        {
-            NSString* errorString = [NSString stringWithFormat:@"Cannot find JSON file %@ for service %@", jsonFileName, NSStringFromClass([serviceInfo.service class])];
-            NSError* error = [NSError errorWithDomain:@"DEMO_MODE" code:-1 userInfo:@{ NSLocalizedDescriptionKey : errorString }];
-            [weakSelf manageError:error inOperation:nil forServiceInfo:serviceInfo];
-        }
-    }];
+/**
+ *  Delta response that doesn't apply to the cached document: the call is repeated asking the full document.
+ */
+- (void) manageDeltaMismatchWithError:(NSError*)error inOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    SDLogModuleWarning(kServiceManagerLogModuleName, @"Service %@: delta response not applied (%@), asking full document", NSStringFromClass([serviceInfo.service class]), error.localizedDescription);
+    
+    [self.deltaDocumentCache removeObjectForKey:serviceInfo.deltaKey];
+    serviceInfo.deltaDisabled = YES;
+    serviceInfo.isProcessing = NO;
+    [self removeExecutedOperation:operation forDelegate:serviceInfo.delegate];
+    [self.servicesQueue removeObject:serviceInfo];
+    [self callServiceWithServiceCallInfo:serviceInfo];
 }
 
 #pragma mark - Operation result management
 
 - (void) manageResponse:(id)responseObject inOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    NSError* decodingError = [self contentDecodingErrorOfOperation:operation];
+    if (decodingError)
+    {
+        // body ended before the end of its encoding
+        [self manageError:decodingError inOperation:operation forServiceInfo:serviceInfo];
+        return;
+    }
+    if (![self shouldManageResultOfOperation:operation forServiceInfo:serviceInfo])
+    {
+        return;
+    }
+    [self.latencyTracker addLatency:CFAbsoluteTimeGetCurrent() - serviceInfo.attemptStartTime forService:serviceInfo.service];
+    [self.rateLimiter updateWithResponse:operation.response pathResource:[serviceInfo.service pathResource]];
+    [self.networkQualityEstimator addObservationWithOperation:operation];
+    [self recordOperation:operation forServiceInfo:serviceInfo];
+    if ([self updateValidatorsOfServiceInfo:serviceInfo withOperation:operation])
+    {
+        [self manageNotModifiedResponseInOperation:operation forServiceInfo:serviceInfo];
+        return;
+    }
+    [self manageResponse:responseObject HTTPResponse:operation.response inOperation:operation forServiceInfo:serviceInfo];
+}
+
+- (void) manageResponse:(id)responseObject HTTPResponse:(NSHTTPURLResponse*)HTTPResponse inOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
 {
     SDLogModuleInfo(kServiceManagerLogModuleName, @"\n**************** %@: received response\n!", [serviceInfo.service class]);
     
-    if (operation.response.statusCode == 304)
+    NSURLResponse* dataResponse = HTTPResponse;
+    if (operation && operation.response.statusCode == 304)
     {
         NSCachedURLResponse* r = [[NSURLCache sharedURLCache] cachedResponseForRequest:operation.request];
         NSError* error = nil;
-        responseObject = [operation.responseSerializer responseObjectForResponse:r.response data:r.data error:&error];
+        responseObject = [operation.responseSerializer responseObjectForResponse:r.response data:[self decodedDataOfCachedResponse:r] error:&error];
+        dataResponse = r.response;
     }
     
-    if (!(self.useDemoMode || ([serviceInfo.service respondsToSelector:@selector(useDemoMode)] && [serviceInfo.service useDemoMode])))
+    if (operation)
     {
         [self printWebServiceRequest:operation];
         if ([serviceInfo.service respondsToSelector:@selector(printServiceResponse)]) {
@@ -460,17 +1709,98 @@
     {
         SDLogModuleVerbose(kServiceManagerLogModuleName, @"FILE CONTENT:\n%@", responseObject);
     }
+    BOOL decodesResponseFromData = [responseObject isKindOfClass:[NSData class]] && [self shouldDecodeResponseFromDataForService:serviceInfo.service];
+    BOOL parsesResponseObject = operation && serviceInfo.defersResponseParsing && [responseObject isKindOfClass:[NSData class]];
+    AFHTTPResponseSerializer* responseSerializer = serviceInfo.service.requestOperationManager.responseSerializer;
     __weak typeof (self) weakself = self;
-    dispatch_async(mappingQueue, ^{
+    BOOL comparesResponseDigest = operation && serviceInfo.notModifiedHandler && HTTPResponse.statusCode != 304;
+    [self.mappingExecutor addBlock:^{
+        if (comparesResponseDigest)
+        {
+            // same body of the response the caller already has: no mapping
+            NSString* digest = [SDServiceManager digestOfData:operation.responseData];
+            NSString* previousDigest = serviceInfo.responseDigest;
+            serviceInfo.responseDigest = digest;
+            if (previousDigest && [digest isEqualToString:previousDigest])
+            {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    [weakself manageNotModifiedResponseInOperation:operation forServiceInfo:serviceInfo];
+                });
+                return;
+            }
+        }
+        
+        id object = responseObject;
         id<SDServiceGenericResponseProtocol> response = nil;
+        SDServiceDeltaDocument* deltaDocument = operation ? serviceInfo.deltaDocument : nil;
+        BOOL appliesDelta = deltaDocument && (HTTPResponse.statusCode == 226 || HTTPResponse.statusCode == 304);
+        if (appliesDelta)
+        {
+            NSError* deltaError = nil;
+            object = [weakself documentForDeltaResponse:HTTPResponse data:operation.responseData baseDocument:deltaDocument error:&deltaError];
+            if (!object)
+            {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    [weakself manageDeltaMismatchWithError:deltaError inOperation:operation forServiceInfo:serviceInfo];
+                });
+                return;
+            }
+            if (object == deltaDocument.document)
+            {
+                response = deltaDocument.response;
+            }
+        }
+        else if (parsesResponseObject)
+        {
+            NSError* parsingError = nil;
+            object = [weakself responseObjectForResponse:dataResponse data:responseObject serializer:responseSerializer error:&parsingError];
+            if (parsingError)
+            {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    [weakself manageError:parsingError HTTPResponse:HTTPResponse responseData:responseObject inOperation:operation forServiceInfo:serviceInfo];
+                });
+                return;
+            }
+        }
+        
         NSError* mappingError = nil;
-        response = [serviceInfo.service responseForObject:responseObject error:&mappingError];
+        SDServicePartialResultsCollector* collector = [weakself partialResultsCollectorForServiceInfo:serviceInfo decodesResponseFromData:decodesResponseFromData];
+        if (response)
+        {
+            // not modified: response mapped from the cached document
+        }
+        else if (decodesResponseFromData)
+        {
+            response = collector ? [serviceInfo.service responseForData:object partialResultsCollector:collector error:&mappingError] : [serviceInfo.service responseForData:object error:&mappingError];
+        }
+        else if (appliesDelta && !collector && [serviceInfo.service respondsToSelector:@selector(responseForObject:previousObject:previousResponse:error:)])
+        {
+            response = [serviceInfo.service responseForObject:object previousObject:deltaDocument.document previousResponse:deltaDocument.response error:&mappingError];
+        }
+        else
+        {
+            response = collector ? [serviceInfo.service responseForObject:object partialResultsCollector:collector error:&mappingError] : [serviceInfo.service responseForObject:object error:&mappingError];
+        }
+        if (mappingError && appliesDelta)
+        {
+            // the patched document may be wrong: ask the full document
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [weakself manageDeltaMismatchWithError:mappingError inOperation:operation forServiceInfo:serviceInfo];
+            });
+            return;
+        }
         if (mappingError)
         {
             // errore mapping response.
-            [weakself manageMappingFailureForServiceInfo:serviceInfo HTTPStatusCode:operation.response.statusCode andError:mappingError];
+            [weakself manageMappingFailureForServiceInfo:serviceInfo HTTPStatusCode:HTTPResponse.statusCode andError:mappingError];
             return;
         }
+        // chunks are dispatched on main queue before completion
+        [collector flush];
+        if (operation && serviceInfo.deltaKey && !decodesResponseFromData)
+        {
+            [weakself updateDeltaDocumentCacheForServiceInfo:serviceInfo HTTPResponse:HTTPResponse document:object response:response];
+        }
         
         dispatch_async(dispatch_get_main_queue(), ^{
             if (serviceInfo.actionSelector && [serviceInfo.service respondsToSelector:serviceInfo.actionSelector])
@@ -481,8 +1811,8 @@
 #pragma clang diagnostic pop
             }
             
-            response.httpStatusCode = (int)operation.response.statusCode;
-            response.headers = operation.response.allHeaderFields;
+            response.httpStatusCode = (int)HTTPResponse.statusCode;
+            response.headers = HTTPResponse.allHeaderFields;
             
             [weakself handleSuccessForServiceInfo:serviceInfo withResponse:response];
             [weakself removeExecutedOperation:operation forDelegate:serviceInfo.delegate];
@@ -502,12 +1832,62 @@
                 [weakself didCompleteAllServices];
             }
         });
-    });
+    } priority:serviceInfo.priority];
+}
+
+/**
+ *  Collector that delivers partial results of the call on main queue, nil if the call has no partialResultsHandler or the service can't deliver them.
+ */
+- (SDServicePartialResultsCollector*) partialResultsCollectorForServiceInfo:(SDServiceCallInfo*)serviceInfo decodesResponseFromData:(BOOL)decodesResponseFromData
+{
+    ServicePartialResultsHandler handler = serviceInfo.partialResultsHandler;
+    if (!handler)
+    {
+        return nil;
+    }
+    SEL selector = decodesResponseFromData ? @selector(responseForData:partialResultsCollector:error:) : @selector(responseForObject:partialResultsCollector:error:);
+    if (![serviceInfo.service respondsToSelector:selector])
+    {
+        return nil;
+    }
+    return [[SDServicePartialResultsCollector alloc] initWithChunkSize:MAX(serviceInfo.partialResultsChunkSize, 1) interval:serviceInfo.partialResultsInterval block:^(NSArray* items, NSUInteger firstIndex) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            handler(items, firstIndex);
+        });
+    }];
 }
 
 - (void) manageError:(NSError*)error inOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
 {
-    if (!(self.useDemoMode || ([serviceInfo.service respondsToSelector:@selector(useDemoMode)] && [serviceInfo.service useDemoMode])))
+    if (![self shouldManageResultOfOperation:operation forServiceInfo:serviceInfo])
+    {
+        return;
+    }
+    if (operation.response)
+    {
+        [self.latencyTracker addLatency:CFAbsoluteTimeGetCurrent() - serviceInfo.attemptStartTime forService:serviceInfo.service];
+        [self.rateLimiter updateWithResponse:operation.response pathResource:[serviceInfo.service pathResource]];
+        [self.networkQualityEstimator addObservationWithOperation:operation];
+    }
+    [self recordOperation:operation forServiceInfo:serviceInfo];
+    if ([self updateValidatorsOfServiceInfo:serviceInfo withOperation:operation])
+    {
+        // 304 is not an acceptable status code of response serializers
+        [self manageNotModifiedResponseInOperation:operation forServiceInfo:serviceInfo];
+        return;
+    }
+    if (operation.response.statusCode == 304 && serviceInfo.deltaDocument)
+    {
+        // cached document of the delta call is still current
+        [self manageResponse:nil HTTPResponse:operation.response inOperation:operation forServiceInfo:serviceInfo];
+        return;
+    }
+    [self manageError:error HTTPResponse:operation.response responseData:operation.responseData inOperation:operation forServiceInfo:serviceInfo];
+}
+
+- (void) manageError:(NSError*)error HTTPResponse:(NSHTTPURLResponse*)HTTPResponse responseData:(NSData*)responseData inOperation:(AFHTTPRequestOperation*)operation forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (operation)
     {
         [self printWebServiceRequest:operation];
         [self printWebServiceResponse:operation];
@@ -519,9 +1899,17 @@
     
     [self printWebServiceError:error service:serviceInfo];
     
-    if (!operation.response)
+    if (!HTTPResponse)
     {
         // can't reach server
+        // cancelled at deadline: the call fails as any call out of time
+        if (error.code == NSURLErrorCancelled && serviceInfo.deadlineExceeded)
+        {
+            serviceInfo.deadlineExceeded = NO;
+            [self manageDeadlineExceededForServiceInfo:serviceInfo];
+            return;
+        }
+        
         // if is not cancelled and is a repeateble service, it will retry
         if (error.code != NSURLErrorCancelled)
         {
@@ -543,14 +1931,14 @@
     }
     
     __weak typeof (self) weakself = self;
-    dispatch_async(mappingQueue, ^{
+    [self.mappingExecutor addBlock:^{
         __block id<SDServiceGenericErrorProtocol> errorObject = nil;
         int statusCode = 0;
-        if (operation && operation.response)
+        if (HTTPResponse)
         {
             // if there is a service response, get the error code
             NSError* mappingError = nil;
-            id errorResponse = [serviceInfo.service.requestOperationManager.responseSerializer responseObjectForResponse:operation.response data:operation.responseData error:&mappingError];
+            id errorResponse = [weakself responseObjectForResponse:HTTPResponse data:responseData serializer:serviceInfo.service.requestOperationManager.responseSerializer error:&mappingError];
             if (errorResponse)
             {
                 mappingError = nil;
@@ -564,12 +1952,12 @@
             {
                 [weakself printWebServiceErrorMessage:[NSString stringWithFormat:@"Can't retreive error from response: %@", mappingError]];
             }
-            statusCode = (int)operation.response.statusCode;
+            statusCode = (int)HTTPResponse.statusCode;
         }
         dispatch_async(dispatch_get_main_queue(), ^{
             [weakself manageError:error forServiceInfo:serviceInfo withErrorObject:errorObject statusCode:statusCode];
         });
-    });
+    } priority:serviceInfo.priority];
 }
 
 
@@ -606,6 +1994,21 @@
 
 
 
+- (void) manageDeadlineExceededForServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    SDLogModuleWarning(kServiceManagerLogModuleName, @"Service %@ exceeded its deadline %@", NSStringFromClass([serviceInfo.service class]), serviceInfo.deadline);
+    
+    NSError* error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:@{ NSLocalizedDescriptionKey : @"Deadline exceeded" }];
+    serviceInfo.isProcessing = NO;
+    
+    // failure is always asynchronous, as for real calls
+    __weak typeof (self) weakself = self;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [weakself printWebServiceError:error service:serviceInfo];
+        [weakself manageError:error forServiceInfo:serviceInfo withErrorObject:nil statusCode:0];
+    });
+}
+
 - (void) manageMappingFailureForServiceInfo:(SDServiceCallInfo*)serviceInfo HTTPStatusCode:(NSInteger)httpStatusCode andError:(NSError*)error
 {
     __weak typeof (self) weakself = self;
@@ -647,7 +2050,7 @@
 - (BOOL) shouldCatchFailureForMissingResponseInServiceInfo:(SDServiceCallInfo*)serviceInfo error:(NSError*)error
 {
     // by default if service expects authomatic retry, it will avoid to throw failure to the caller (failure block never called)
-    if (serviceInfo.numAutomaticRetry > 0)
+    if (serviceInfo.numAutomaticRetry > 0 && [self hasTimeForAttemptAfterDelay:self.timeBeforeRetry forServiceInfo:serviceInfo])
     {
         [self performSelector:@selector(performAutomaticRetry:) withObject:serviceInfo afterDelay:self.timeBeforeRetry];
         return YES;
@@ -658,6 +2061,15 @@
     }
 }
 
+- (BOOL) hasTimeForAttemptAfterDelay:(NSTimeInterval)delay forServiceInfo:(SDServiceCallInfo*)serviceInfo
+{
+    if (!serviceInfo.deadline)
+    {
+        return YES;
+    }
+    return [serviceInfo.deadline timeIntervalSinceNow] - delay >= self.minimumAttemptTimeout;
+}
+
 - (void) didCompleteAllServices
 {
     SDLogModuleInfo(kServiceManagerLogModuleName, @"Did complete all services...");
@@ -705,6 +2117,43 @@
     }
 }
 
+- (void) cancelServiceCallInfo:(SDServiceCallInfo*)serviceInfo
+{
+    // no retry after cancel
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(performAutomaticRetry:) object:serviceInfo];
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(sendHedgedRequestForServiceInfo:) object:serviceInfo];
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(expireDeadlineOfServiceInfo:) object:serviceInfo];
+    serviceInfo.numAutomaticRetry = 0;
+    
+    if (serviceInfo.deferredRequest)
+    {
+        [self.deferredRequestQueue removeRequest:serviceInfo.deferredRequest];
+        serviceInfo.deferredRequest = nil;
+    }
+    
+    if (serviceInfo.rateLimitTicket)
+    {
+        [self.rateLimiter cancelTicket:serviceInfo.rateLimitTicket];
+        serviceInfo.rateLimitTicket = nil;
+    }
+    
+    AFHTTPRequestOperation* operation = serviceInfo.operation;
+    if (operation && !operation.isFinished)
+    {
+        // removed from queue by the cancellation error
+        [serviceInfo.hedgeOperation cancel];
+        [operation cancel];
+    }
+    else if ([self.servicesQueue containsObject:serviceInfo])
+    {
+        [self.servicesQueue removeObject:serviceInfo];
+        if (!self.hasPendingOperations)
+        {
+            [self didCompleteAllServices];
+        }
+    }
+}
+
 - (void) cancelAllOperationsForDelegate:(id <SDServiceManagerDelegate> )delegate
 {
     NSMutableArray* arrayOfServices = [self.serviceInvocationDictionary objectForKey:@([delegate hash])];
@@ -14,14 +14,78 @@
 
 #import "SDServiceGeneric.h"
 #import <Mantle/Mantle.h>
+#import "SDServiceParallelMapper.h"
+
+/**
+ *  Where the sparse fieldset of SDServiceMantle is sent.
+ */
+typedef NS_ENUM (NSInteger, SDServiceFieldsPlacement)
+{
+    /**
+     *  Query string of the URL, for every HTTP method.
+     */
+    SDServiceFieldsPlacementQuery = 0,
+    /**
+     *  HTTP header named fieldsParameterName.
+     */
+    SDServiceFieldsPlacementHeader,
+    /**
+     *  With the other request parameters: in query string or in body depending on the HTTP method.
+     *  Bodies are then serialized by the request serializer instead of SDServiceJSONEncoder.
+     */
+    SDServiceFieldsPlacementParameters
+};
 
 /**
  * This calss should be used as superclass for service that uses content type 'application/json'. Use Mantle to map request and response
  *
  *  Specific service should subclass SDServiceMantle to implement details.
+ *
+ *  Body of requests is written directly by SDServiceJSONEncoder, unless the subclass overrides parametersForRequest:error: or sends the sparse fieldset with parameters (SDServiceFieldsPlacementParameters).
+ *  Subclasses that return YES from decodesResponseFromData have responses read directly from data by SDServiceJSONDecoder, without building the JSON objects of the response.
+ *  Array responses patched by delta responses (acceptsDeltaResponses) map only the items changed by the patch, reusing the models of the others.
  */
 @interface SDServiceMantle : SDServiceGeneric
 
+/**
+ *  Mapper of items of array responses (see propertyNameForArrayResponse of SDServiceGenericResponseProtocol) parsed as JSON objects:
+ *  long arrays are split in chunks mapped concurrently. Value transformers of the item class must be thread safe.
+ *  Not used when the response is read from data (decodesResponseFromData), whose items are mapped while they are read.
+ *
+ *  @return parallel mapper. Default is nil (items are mapped sequentially).
+ */
+- (SDServiceParallelMapper* _Nullable) parallelMapper;
+
+/**
+ *  Name of the request parameter with the fields the response needs (sparse fieldset, ex. @"fields"), sent in every request as fieldsPlacement says.
+ *  Fields are the JSON key paths mapped by the response class (by the item class for array responses), listed by JSONKeyPathsOfModelClass: of SDServiceJSONDecoder.
+ *  The parameter is not sent if the request already has it (in additionalRequestParameters, or in additionalRequestHeaders for SDServiceFieldsPlacementHeader), or if key paths can't be derived from the response class.
+ *
+ *  @return parameter name. Default is nil (server returns all fields).
+ */
+- (NSString* _Nullable) fieldsParameterName;
+
+/**
+ *  Value of the fieldsParameterName parameter. Override it to follow the syntax of your server (ex. "items(id,title)").
+ *
+ *  @param keyPaths JSON key paths of the response, separated by dots (ex. "owner.display_name").
+ *
+ *  @return parameter value. Default joins key paths with commas.
+ */
+- (id _Nullable) fieldsParameterValueWithKeyPaths:(NSArray<NSString*>* _Nonnull)keyPaths;
+
+/**
+ *  Where the fieldsParameterName parameter is sent. Query string and header don't change the body of POST, PUT and PATCH requests.
+ *
+ *  @return placement of the sparse fieldset. Default is SDServiceFieldsPlacementQuery.
+ */
+- (SDServiceFieldsPlacement) fieldsPlacement;
+
+/**
+ *  JSON key paths mapped by the response class, or by the item class for array responses. nil if they can't be derived.
+ */
+- (NSArray<NSString*>* _Nullable) responseJSONKeyPaths;
+
 @end
 
 /**
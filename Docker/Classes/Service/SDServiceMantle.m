@@ -14,6 +14,9 @@
 
 #import "SDServiceMantle.h"
 #import "SDDockerLogger.h"
+#import "SDServiceJSONEncoder.h"
+#import "SDServiceJSONDecoder.h"
+#import "SDServicePartialResultsCollector.h"
 
 @implementation SDServiceMantle
 
@@ -22,6 +25,10 @@
     NSAssert([request isKindOfClass:[SDServiceMantleRequest class]], @"Request passed should subclass SDServiceMantleRequest");
     NSMutableDictionary* dict = [[MTLJSONAdapter JSONDictionaryFromModel:(SDServiceMantleRequest*)request error:error] mutableCopy];
     [dict addEntriesFromDictionary:request.additionalRequestParameters];
+    if ([self fieldsPlacement] == SDServiceFieldsPlacementParameters)
+    {
+        [self addFieldsParameterToParameters:dict];
+    }
     if (*error)
     {
         SDLogModuleError(kServiceManagerLogModuleName, @"Request invalid error: %@", (*error).localizedDescription);
@@ -30,7 +37,40 @@
     return dict;
 }
 
+- (NSData*) bodyForRequest:(id<SDServiceGenericRequestProtocol>)request error:(NSError**)error
+{
+    // subclasses that customize parameters keep their dictionary, fields placed with parameters are serialized with them
+    if ([self methodForSelector:@selector(parametersForRequest:error:)] != [SDServiceMantle instanceMethodForSelector:@selector(parametersForRequest:error:)] || ([self fieldsPlacement] == SDServiceFieldsPlacementParameters && [self fieldsParameterName]))
+    {
+        return nil;
+    }
+    
+    NSAssert([request isKindOfClass:[SDServiceMantleRequest class]], @"Request passed should subclass SDServiceMantleRequest");
+    BOOL removeNilValues = [request respondsToSelector:@selector(removeNilParameters)] && request.removeNilParameters;
+    NSData* body = [SDServiceJSONEncoder dataWithModel:(SDServiceMantleRequest*)request additionalParameters:request.additionalRequestParameters removeNilValues:removeNilValues error:error];
+    if (!body)
+    {
+        SDLogModuleError(kServiceManagerLogModuleName, @"Request invalid error: %@", error ? (*error).localizedDescription : nil);
+    }
+    return body;
+}
+
 - (id<SDServiceGenericResponseProtocol>) responseForObject:(id)object error:(NSError**)error
+{
+    return [self responseForObject:object collector:nil error:error];
+}
+
+- (id<SDServiceGenericResponseProtocol>) responseForObject:(id)object partialResultsCollector:(SDServicePartialResultsCollector*)collector error:(NSError**)error
+{
+    // subclasses that customize mapping keep their method, without partial results
+    if ([self methodForSelector:@selector(responseForObject:error:)] != [SDServiceMantle instanceMethodForSelector:@selector(responseForObject:error:)])
+    {
+        return [self responseForObject:object error:error];
+    }
+    return [self responseForObject:object collector:collector error:error];
+}
+
+- (id<SDServiceGenericResponseProtocol>) responseForObject:(id)object collector:(SDServicePartialResultsCollector*)collector error:(NSError**)error
 {
     SDServiceMantleResponse* resp = nil;
     
@@ -45,7 +85,7 @@
         {
             if ([resp classOfItemsInArrayResponse] != NULL)
             {
-                [resp setValue:[MTLJSONAdapter modelsOfClass:[resp classOfItemsInArrayResponse] fromJSONArray:(NSArray*)object error:error] forKey:resp.propertyNameForArrayResponse];
+                [resp setValue:[self modelsOfClass:[resp classOfItemsInArrayResponse] fromJSONArray:(NSArray*)object collector:collector error:error] forKey:resp.propertyNameForArrayResponse];
             }
             else
             {
@@ -65,6 +105,231 @@
     return resp;
 }
 
+- (id<SDServiceGenericResponseProtocol>) responseForObject:(id)object previousObject:(id)previousObject previousResponse:(id<SDServiceGenericResponseProtocol>)previousResponse error:(NSError**)error
+{
+    // only array responses reuse models (subclasses that customize mapping keep their method)
+    if ([self methodForSelector:@selector(responseForObject:error:)] != [SDServiceMantle instanceMethodForSelector:@selector(responseForObject:error:)] || ![object isKindOfClass:[NSArray class]] || ![previousObject isKindOfClass:[NSArray class]] || ![previousResponse isKindOfClass:[self responseClass]])
+    {
+        return [self responseForObject:object error:error];
+    }
+    SDServiceMantleResponse* previous = (SDServiceMantleResponse*)previousResponse;
+    NSString* propertyName = previous.propertyNameForArrayResponse;
+    Class itemClass = [previous classOfItemsInArrayResponse];
+    NSArray* previousModels = propertyName.length > 0 && itemClass != NULL ? [previous valueForKey:propertyName] : nil;
+    if (![previousModels isKindOfClass:[NSArray class]] || previousModels.count != [previousObject count])
+    {
+        return [self responseForObject:object error:error];
+    }
+    
+    // models of previous items by instance: items untouched by the patch are found
+    NSMapTable* modelsByItem = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory capacity:previousModels.count];
+    [(NSArray*)previousObject enumerateObjectsUsingBlock:^(id item, NSUInteger index, BOOL* stop) {
+        [modelsByItem setObject:previousModels[index] forKey:item];
+    }];
+    
+    NSMutableArray* models = [NSMutableArray arrayWithCapacity:[object count]];
+    NSUInteger numberOfMappedItems = 0;
+    for (id item in (NSArray*)object)
+    {
+        id model = [modelsByItem objectForKey:item];
+        if (!model)
+        {
+            NSError* itemError = nil;
+            model = [MTLJSONAdapter modelOfClass:itemClass fromJSONDictionary:item error:&itemError];
+            if (!model)
+            {
+                SDLogModuleError(kServiceManagerLogModuleName, @"Response mapping error: %@", itemError.localizedDescription);
+                if (error)
+                {
+                    *error = itemError;
+                }
+                return nil;
+            }
+            numberOfMappedItems++;
+        }
+        [models addObject:model];
+    }
+    SDLogModuleVerbose(kServiceManagerLogModuleName, @"Patched response: mapped %lu of %lu items", (unsigned long)numberOfMappedItems, (unsigned long)models.count);
+    
+    SDServiceMantleResponse* resp = [[[self responseClass] alloc] init];
+    [resp setValue:models forKey:propertyName];
+    return resp;
+}
+
+- (SDServiceParallelMapper*) parallelMapper
+{
+    return nil;
+}
+
+- (NSString*) fieldsParameterName
+{
+    return nil;
+}
+
+- (id) fieldsParameterValueWithKeyPaths:(NSArray<NSString*>*)keyPaths
+{
+    return [keyPaths componentsJoinedByString:@","];
+}
+
+- (SDServiceFieldsPlacement) fieldsPlacement
+{
+    return SDServiceFieldsPlacementQuery;
+}
+
+- (NSDictionary<NSString*, NSString*>*) queryParametersForRequest:(id<SDServiceGenericRequestProtocol>)request
+{
+    if ([self fieldsPlacement] != SDServiceFieldsPlacementQuery || request.additionalRequestParameters[[self fieldsParameterName] ?: @""])
+    {
+        return nil;
+    }
+    NSString* fields = [self fieldsStringValue];
+    return fields ? @{ [self fieldsParameterName] : fields } : nil;
+}
+
+- (NSDictionary<NSString*, NSString*>*) requestHeadersForRequest:(id<SDServiceGenericRequestProtocol>)request
+{
+    if ([self fieldsPlacement] != SDServiceFieldsPlacementHeader || request.additionalRequestHeaders[[self fieldsParameterName] ?: @""])
+    {
+        return nil;
+    }
+    NSString* fields = [self fieldsStringValue];
+    return fields ? @{ [self fieldsParameterName] : fields } : nil;
+}
+
+- (NSArray<NSString*>*) responseJSONKeyPaths
+{
+    Class responseClass = [self responseClass];
+    if (![responseClass conformsToProtocol:@protocol(MTLJSONSerializing)])
+    {
+        return nil;
+    }
+    
+    SDServiceMantleResponse* response = [[responseClass alloc] init];
+    Class itemClass = response.propertyNameForArrayResponse.length > 0 ? [response classOfItemsInArrayResponse] : NULL;
+    return [SDServiceJSONDecoder JSONKeyPathsOfModelClass:itemClass ? : responseClass];
+}
+
+/**
+ *  Value of the sparse fieldset as string, for query string and header (nil if it isn't sent).
+ */
+- (NSString*) fieldsStringValue
+{
+    NSMutableDictionary* parameters = [NSMutableDictionary dictionary];
+    [self addFieldsParameterToParameters:parameters];
+    id value = parameters.allValues.firstObject;
+    if ([value isKindOfClass:[NSArray class]])
+    {
+        return [value componentsJoinedByString:@","];
+    }
+    return value ? [value description] : nil;
+}
+
+- (void) addFieldsParameterToParameters:(NSMutableDictionary*)parameters
+{
+    NSString* parameterName = [self fieldsParameterName];
+    if (parameterName.length == 0 || parameters[parameterName])
+    {
+        return;
+    }
+    NSArray<NSString*>* keyPaths = [self responseJSONKeyPaths];
+    if (keyPaths.count > 0)
+    {
+        parameters[parameterName] = [self fieldsParameterValueWithKeyPaths:keyPaths];
+    }
+}
+
+- (BOOL) decodesResponseFromData
+{
+    return NO;
+}
+
+- (id<SDServiceGenericResponseProtocol>) responseForData:(NSData*)data error:(NSError**)error
+{
+    return [self responseForData:data collector:nil error:error];
+}
+
+- (id<SDServiceGenericResponseProtocol>) responseForData:(NSData*)data partialResultsCollector:(SDServicePartialResultsCollector*)collector error:(NSError**)error
+{
+    if ([self methodForSelector:@selector(responseForData:error:)] != [SDServiceMantle instanceMethodForSelector:@selector(responseForData:error:)])
+    {
+        return [self responseForData:data error:error];
+    }
+    return [self responseForData:data collector:collector error:error];
+}
+
+- (id<SDServiceGenericResponseProtocol>) responseForData:(NSData*)data collector:(SDServicePartialResultsCollector*)collector error:(NSError**)error
+{
+    SDServiceMantleResponse* resp = nil;
+    
+    switch ([SDServiceJSONDecoder typeOfValueInData:data])
+    {
+        case SDServiceJSONValueTypeObject:
+            resp = [SDServiceJSONDecoder modelOfClass:[self responseClass] fromData:data error:error];
+            break;
+        case SDServiceJSONValueTypeArray:
+            resp = [[[self responseClass] alloc] init];
+            if (resp.propertyNameForArrayResponse.length > 0 && [resp respondsToSelector:NSSelectorFromString(resp.propertyNameForArrayResponse)])
+            {
+                if ([resp classOfItemsInArrayResponse] != NULL)
+                {
+                    NSArray* items = [SDServiceJSONDecoder modelsOfClass:[resp classOfItemsInArrayResponse] fromData:data itemHandler:collector ? ^(id model) {
+                        [collector addItem:model];
+                    } : nil error:error];
+                    [collector flush];
+                    [resp setValue:items forKey:resp.propertyNameForArrayResponse];
+                }
+                else
+                {
+                    SDLogModuleError(kServiceManagerLogModuleName, @"Class for method 'classOfItemsInArrayResponse' not provided for SDServiceResponse of class %@", NSStringFromClass([resp class]));
+                }
+            }
+            else
+            {
+                SDLogModuleError(kServiceManagerLogModuleName, @"Unknown property for mapping response array in SDServiceResponse of class %@", NSStringFromClass([resp class]));
+            }
+            break;
+        default:
+            // same result of responseForObject: with an empty body or a JSON fragment
+            break;
+    }
+    
+    if (error && *error)
+    {
+        SDLogModuleError(kServiceManagerLogModuleName, @"Response mapping error: %@", (*error).localizedDescription);
+    }
+    return resp;
+}
+
+/**
+ *  Same as modelsOfClass:fromJSONArray:error: of MTLJSONAdapter, in parallel with parallelMapper and adding models to collector as soon as they are mapped.
+ */
+- (NSArray*) modelsOfClass:(Class)modelClass fromJSONArray:(NSArray*)JSONArray collector:(SDServicePartialResultsCollector*)collector error:(NSError**)error
+{
+    SDServiceParallelMapper* parallelMapper = [self parallelMapper];
+    if ((!collector && !parallelMapper) || ![JSONArray isKindOfClass:[NSArray class]])
+    {
+        return [MTLJSONAdapter modelsOfClass:modelClass fromJSONArray:JSONArray error:error];
+    }
+    
+    if (!parallelMapper)
+    {
+        // sequential, to deliver every item as soon as it is mapped
+        parallelMapper = [SDServiceParallelMapper new];
+        parallelMapper.threshold = NSUIntegerMax;
+        parallelMapper.chunkSize = 1;
+    }
+    NSArray* models = [parallelMapper mapArray:JSONArray withBlock:^id(id JSONDictionary, NSError** itemError) {
+        return [MTLJSONAdapter modelOfClass:modelClass fromJSONDictionary:JSONDictionary error:itemError];
+    } chunkBlock:collector ? ^(NSArray* items, NSUInteger firstIndex) {
+        for (id model in items)
+        {
+            [collector addItem:model];
+        }
+    } : nil error:error];
+    [collector flush];
+    return models;
+}
+
 - (id<SDServiceGenericErrorProtocol>) errorForObject:(id)object error:(NSError**)error
 {
     SDServiceMantleError* resp = [MTLJSONAdapter modelOfClass:[self errorClass] fromJSONDictionary:object error:error];
@@ -0,0 +1,99 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import "SDServiceGeneric.h"
+
+/**
+ *  Runs mapping of responses on a bounded number of workers, in order of priority of calls.
+ *
+ *  Blocks wait in a queue for each priority (high first, FIFO within a priority) and at most maximumConcurrency of them run at the same time,
+ *  so a burst of responses doesn't create a thread for each of them.
+ *
+ *  Backpressure: operations of SDServiceManager deliver their results on completionQueue. When blocks waiting exceed maximumBacklog,
+ *  completionQueue is suspended and finished network operations wait there, until the backlog drops to half of maximumBacklog.
+ *
+ *  All methods are thread safe.
+ */
+@interface SDServiceMappingExecutor : NSObject
+
+/**
+ *  Maximum number of blocks running at the same time.
+ *
+ *  Default: number of active processors - 1 (at least 1), to leave a core to main thread
+ */
+@property (atomic, assign) NSUInteger maximumConcurrency;
+
+/**
+ *  Blocks waiting after which completionQueue is suspended. 0 to never suspend it.
+ *
+ *  Default: 16
+ */
+@property (atomic, assign) NSUInteger maximumBacklog;
+
+/**
+ *  Serial queue that runs on main thread, used as completionQueue of network operations to make them wait when backlog is too long.
+ */
+@property (nonatomic, strong, readonly) dispatch_queue_t _Nonnull completionQueue;
+
+- (void) addBlock:(dispatch_block_t _Nonnull)block priority:(SDServiceCallPriority)priority;
+
+/**
+ *  Executor running the block of the current thread, nil outside of its workers.
+ */
++ (SDServiceMappingExecutor* _Nullable) currentExecutor;
+
+/**
+ *  Take free workers for a running block that splits its work on more threads (ex. SDServiceParallelMapper), so all together they don't exceed maximumConcurrency.
+ *  Taken workers don't run other blocks until they are given back with releaseWorkers:.
+ *
+ *  @return number of workers taken, from 0 (no free workers) to numberOfWorkers.
+ */
+- (NSUInteger) acquireFreeWorkers:(NSUInteger)numberOfWorkers;
+- (void) releaseWorkers:(NSUInteger)numberOfWorkers;
+
+#pragma mark - Metrics
+
+/**
+ *  Blocks waiting for a worker (queue depth), for all priorities or for a priority.
+ */
+@property (atomic, readonly) NSUInteger numberOfPendingBlocks;
+- (NSUInteger) numberOfPendingBlocksWithPriority:(SDServiceCallPriority)priority;
+
+@property (atomic, readonly) NSUInteger numberOfRunningBlocks;
+
+/**
+ *  Maximum queue depth reached since creation or last resetMetrics.
+ */
+@property (atomic, readonly) NSUInteger peakNumberOfPendingBlocks;
+
+/**
+ *  Moving average of time spent by blocks in queue before running (seconds).
+ */
+@property (atomic, readonly) NSTimeInterval averageWaitingTime;
+
+/**
+ *  YES while completionQueue is suspended because of backlog.
+ */
+@property (atomic, readonly) BOOL isApplyingBackpressure;
+
+/**
+ *  Times completionQueue has been suspended, and total time it stayed suspended (seconds), since creation or last resetMetrics.
+ */
+@property (atomic, readonly) NSUInteger numberOfBackpressureEvents;
+@property (atomic, readonly) NSTimeInterval backpressureTime;
+
+- (void) resetMetrics;
+
+@end
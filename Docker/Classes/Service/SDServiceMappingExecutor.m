@@ -0,0 +1,227 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceMappingExecutor.h"
+
+#define DEFAULT_MAPPING_MAXIMUM_BACKLOG        16
+#define WAITING_TIME_SMOOTHING                 0.2
+
+#define WorkerQueueName         "com.sysdata.SDServiceMappingExecutor.workerQueue"
+#define CompletionQueueName     "com.sysdata.SDServiceMappingExecutor.completionQueue"
+
+static void* const SDServiceMappingExecutorKey = (void*)&SDServiceMappingExecutorKey;
+
+@interface SDServiceMappingTask : NSObject
+
+@property (nonatomic, strong) dispatch_block_t block;
+@property (nonatomic, assign) CFAbsoluteTime enqueueTime;
+
+@end
+
+@implementation SDServiceMappingTask
+
+@end
+
+
+@interface SDServiceMappingExecutor ()
+{
+    /**
+     *  Waiting tasks: high, normal and low priority.
+     */
+    NSMutableArray<SDServiceMappingTask*>* pendingTasks[3];
+    dispatch_queue_t workerQueue;
+    CFAbsoluteTime backpressureStartTime;
+    
+    /**
+     *  Workers taken by running blocks with acquireFreeWorkers:.
+     */
+    NSUInteger numberOfAcquiredWorkers;
+}
+
+@property (atomic, readwrite) NSUInteger numberOfPendingBlocks;
+@property (atomic, readwrite) NSUInteger numberOfRunningBlocks;
+@property (atomic, readwrite) NSUInteger peakNumberOfPendingBlocks;
+@property (atomic, readwrite) NSTimeInterval averageWaitingTime;
+@property (atomic, readwrite) BOOL isApplyingBackpressure;
+@property (atomic, readwrite) NSUInteger numberOfBackpressureEvents;
+@property (atomic, readwrite) NSTimeInterval backpressureTime;
+
+@end
+
+@implementation SDServiceMappingExecutor
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        for (NSUInteger i = 0; i < 3; i++)
+        {
+            pendingTasks[i] = [NSMutableArray array];
+        }
+        workerQueue = dispatch_queue_create(WorkerQueueName, DISPATCH_QUEUE_CONCURRENT);
+        dispatch_queue_set_specific(workerQueue, SDServiceMappingExecutorKey, (__bridge void*)self, NULL);
+        _completionQueue = dispatch_queue_create(CompletionQueueName, DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_completionQueue, dispatch_get_main_queue());
+        
+        NSUInteger numberOfProcessors = [NSProcessInfo processInfo].activeProcessorCount;
+        self.maximumConcurrency = numberOfProcessors > 1 ? numberOfProcessors - 1 : 1;
+        self.maximumBacklog = DEFAULT_MAPPING_MAXIMUM_BACKLOG;
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    // a suspended queue can't be released
+    if (self.isApplyingBackpressure)
+    {
+        dispatch_resume(_completionQueue);
+    }
+}
+
+static NSUInteger SDIndexOfPriority(SDServiceCallPriority priority)
+{
+    return priority > SDServiceCallPriorityNormal ? 0 : (priority < SDServiceCallPriorityNormal ? 2 : 1);
+}
+
+- (void) addBlock:(dispatch_block_t)block priority:(SDServiceCallPriority)priority
+{
+    SDServiceMappingTask* task = [SDServiceMappingTask new];
+    task.block = block;
+    task.enqueueTime = CFAbsoluteTimeGetCurrent();
+    
+    @synchronized (self)
+    {
+        [pendingTasks[SDIndexOfPriority(priority)] addObject:task];
+        self.numberOfPendingBlocks++;
+        self.peakNumberOfPendingBlocks = MAX(self.peakNumberOfPendingBlocks, self.numberOfPendingBlocks);
+        [self updateBackpressure];
+    }
+    [self startPendingTasks];
+}
+
+- (void) startPendingTasks
+{
+    while (YES)
+    {
+        SDServiceMappingTask* task = nil;
+        @synchronized (self)
+        {
+            if (self.numberOfRunningBlocks + numberOfAcquiredWorkers >= MAX(self.maximumConcurrency, 1))
+            {
+                return;
+            }
+            for (NSUInteger i = 0; i < 3 && !task; i++)
+            {
+                task = pendingTasks[i].firstObject;
+                if (task)
+                {
+                    [pendingTasks[i] removeObjectAtIndex:0];
+                }
+            }
+            if (!task)
+            {
+                return;
+            }
+            self.numberOfPendingBlocks--;
+            self.numberOfRunningBlocks++;
+            
+            NSTimeInterval waitingTime = CFAbsoluteTimeGetCurrent() - task.enqueueTime;
+            self.averageWaitingTime = self.averageWaitingTime > 0 ? WAITING_TIME_SMOOTHING * waitingTime + (1. - WAITING_TIME_SMOOTHING) * self.averageWaitingTime : waitingTime;
+            [self updateBackpressure];
+        }
+        
+        dispatch_async(workerQueue, ^{
+            task.block();
+            @synchronized (self)
+            {
+                self.numberOfRunningBlocks--;
+            }
+            [self startPendingTasks];
+        });
+    }
+}
+
++ (SDServiceMappingExecutor*) currentExecutor
+{
+    return (__bridge SDServiceMappingExecutor*)dispatch_get_specific(SDServiceMappingExecutorKey);
+}
+
+- (NSUInteger) acquireFreeWorkers:(NSUInteger)numberOfWorkers
+{
+    @synchronized (self)
+    {
+        NSUInteger maximumConcurrency = MAX(self.maximumConcurrency, 1);
+        NSUInteger busyWorkers = self.numberOfRunningBlocks + numberOfAcquiredWorkers;
+        NSUInteger acquiredWorkers = busyWorkers < maximumConcurrency ? MIN(numberOfWorkers, maximumConcurrency - busyWorkers) : 0;
+        numberOfAcquiredWorkers += acquiredWorkers;
+        return acquiredWorkers;
+    }
+}
+
+- (void) releaseWorkers:(NSUInteger)numberOfWorkers
+{
+    if (numberOfWorkers == 0)
+    {
+        return;
+    }
+    @synchronized (self)
+    {
+        numberOfAcquiredWorkers -= MIN(numberOfWorkers, numberOfAcquiredWorkers);
+    }
+    [self startPendingTasks];
+}
+
+/**
+ *  Suspend or resume completionQueue depending on backlog. Called holding the lock.
+ */
+- (void) updateBackpressure
+{
+    NSUInteger maximumBacklog = self.maximumBacklog;
+    if (!self.isApplyingBackpressure && maximumBacklog > 0 && self.numberOfPendingBlocks >= maximumBacklog)
+    {
+        dispatch_suspend(_completionQueue);
+        self.isApplyingBackpressure = YES;
+        self.numberOfBackpressureEvents++;
+        backpressureStartTime = CFAbsoluteTimeGetCurrent();
+    }
+    else if (self.isApplyingBackpressure && (maximumBacklog == 0 || self.numberOfPendingBlocks <= maximumBacklog / 2))
+    {
+        self.isApplyingBackpressure = NO;
+        self.backpressureTime += CFAbsoluteTimeGetCurrent() - backpressureStartTime;
+        dispatch_resume(_completionQueue);
+    }
+}
+
+- (NSUInteger) numberOfPendingBlocksWithPriority:(SDServiceCallPriority)priority
+{
+    @synchronized (self)
+    {
+        return pendingTasks[SDIndexOfPriority(priority)].count;
+    }
+}
+
+- (void) resetMetrics
+{
+    @synchronized (self)
+    {
+        self.peakNumberOfPendingBlocks = self.numberOfPendingBlocks;
+        self.numberOfBackpressureEvents = 0;
+        self.backpressureTime = 0;
+        backpressureStartTime = CFAbsoluteTimeGetCurrent();
+    }
+}
+
+@end
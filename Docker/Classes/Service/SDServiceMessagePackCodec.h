@@ -0,0 +1,51 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import "SDServiceBodyCodec.h"
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceMessagePackErrorDomain;
+
+typedef NS_ENUM (NSInteger, SDServiceMessagePackErrorCode)
+{
+    /**
+     *  Data ends in the middle of a value.
+     */
+    SDServiceMessagePackErrorCodeTruncatedData = -1,
+    /**
+     *  Invalid data: reserved type byte, invalid UTF-8 string, map key that is not a string or bytes after the top level value.
+     */
+    SDServiceMessagePackErrorCodeInvalidData = -2,
+    /**
+     *  Value without a Foundation representation: extension types when decoding, objects that are not JSON objects when encoding.
+     */
+    SDServiceMessagePackErrorCodeUnsupportedType = -3,
+    /**
+     *  Arrays and maps nested deeper than SDServiceMessagePackMaximumDepth.
+     */
+    SDServiceMessagePackErrorCodeTooDeep = -4,
+};
+
+#define SDServiceMessagePackMaximumDepth    512
+
+/**
+ *  MessagePack (https://msgpack.org) codec, for application/msgpack and application/x-msgpack.
+ *
+ *  Decoding returns the same objects NSJSONSerialization returns for the equivalent JSON: maps are NSDictionary (keys must be strings), arrays NSArray, strings NSString,
+ *  integers, floats and booleans NSNumber, nil NSNull. Binary values are NSData. Containers are immutable. Keys of maps are cached while decoding, so lists of objects share their key strings.
+ *  Encoding accepts the same objects (plus NSData as binary) and writes every number in its smallest representation.
+ */
+@interface SDServiceMessagePackCodec : NSObject <SDServiceBodyCodec>
+
+@end
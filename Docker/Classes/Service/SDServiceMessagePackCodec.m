@@ -0,0 +1,668 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceMessagePackCodec.h"
+
+NSString* const SDServiceMessagePackErrorDomain = @"SDServiceMessagePackErrorDomain";
+
+#define MESSAGE_PACK_KEY_CACHE_SIZE             256 // power of 2
+#define MESSAGE_PACK_MAXIMUM_CACHED_KEY_LENGTH  32
+#define MESSAGE_PACK_INITIAL_BUFFER_CAPACITY    4096
+
+#pragma mark - Reader
+
+typedef struct
+{
+    const uint8_t* bytes;
+    size_t length;
+    size_t position;
+    NSUInteger depth;
+    
+    // first error
+    NSInteger errorCode;
+    const char* errorMessage;
+    
+    // strings of map keys already read, by hash of their bytes (they point into the data being decoded)
+    const uint8_t* keyBytes[MESSAGE_PACK_KEY_CACHE_SIZE];
+    size_t keyLengths[MESSAGE_PACK_KEY_CACHE_SIZE];
+    CFStringRef keys[MESSAGE_PACK_KEY_CACHE_SIZE];
+} SDMessagePackReader;
+
+static id SDMessagePackReadValue(SDMessagePackReader* reader);
+
+static void SDMessagePackReaderFail(SDMessagePackReader* reader, NSInteger code, const char* message)
+{
+    if (reader->errorCode == 0)
+    {
+        reader->errorCode = code;
+        reader->errorMessage = message;
+    }
+}
+
+static inline BOOL SDMessagePackReaderHasBytes(SDMessagePackReader* reader, size_t count)
+{
+    if (reader->length - reader->position < count)
+    {
+        SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeTruncatedData, "Truncated data");
+        return NO;
+    }
+    return YES;
+}
+
+static inline uint64_t SDMessagePackReadBigEndian(SDMessagePackReader* reader, size_t size)
+{
+    uint64_t value = 0;
+    const uint8_t* bytes = reader->bytes + reader->position;
+    for (size_t i = 0; i < size; i++)
+    {
+        value = (value << 8) | bytes[i];
+    }
+    reader->position += size;
+    return value;
+}
+
+/**
+ *  Length of str, bin, array and map types with explicit length (size of the length in bytes).
+ */
+static inline BOOL SDMessagePackReadLength(SDMessagePackReader* reader, size_t size, size_t* length)
+{
+    if (!SDMessagePackReaderHasBytes(reader, size))
+    {
+        return NO;
+    }
+    *length = (size_t)SDMessagePackReadBigEndian(reader, size);
+    return YES;
+}
+
+static NSString* SDMessagePackReadString(SDMessagePackReader* reader, size_t length, BOOL isKey)
+{
+    if (!SDMessagePackReaderHasBytes(reader, length))
+    {
+        return nil;
+    }
+    const uint8_t* bytes = reader->bytes + reader->position;
+    reader->position += length;
+    if (length == 0)
+    {
+        return @"";
+    }
+    
+    NSUInteger slot = 0;
+    BOOL cached = isKey && length <= MESSAGE_PACK_MAXIMUM_CACHED_KEY_LENGTH;
+    if (cached)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        slot = hash & (MESSAGE_PACK_KEY_CACHE_SIZE - 1);
+        if (reader->keys[slot] && reader->keyLengths[slot] == length && memcmp(reader->keyBytes[slot], bytes, length) == 0)
+        {
+            return (__bridge NSString*)reader->keys[slot];
+        }
+    }
+    
+    CFStringRef string = CFStringCreateWithBytes(kCFAllocatorDefault, bytes, (CFIndex)length, kCFStringEncodingUTF8, false);
+    if (!string)
+    {
+        SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeInvalidData, "Invalid UTF-8 string");
+        return nil;
+    }
+    if (cached)
+    {
+        if (reader->keys[slot])
+        {
+            CFRelease(reader->keys[slot]);
+        }
+        reader->keys[slot] = CFRetain(string);
+        reader->keyBytes[slot] = bytes;
+        reader->keyLengths[slot] = length;
+    }
+    return (__bridge_transfer NSString*)string;
+}
+
+static NSData* SDMessagePackReadBinary(SDMessagePackReader* reader, size_t length)
+{
+    if (!SDMessagePackReaderHasBytes(reader, length))
+    {
+        return nil;
+    }
+    NSData* data = [NSData dataWithBytes:reader->bytes + reader->position length:length];
+    reader->position += length;
+    return data;
+}
+
+static NSArray* SDMessagePackReadArray(SDMessagePackReader* reader, size_t count)
+{
+    // every element takes at least one byte: no allocation for counts that can't be in data
+    if (!SDMessagePackReaderHasBytes(reader, count))
+    {
+        return nil;
+    }
+    if (++reader->depth > SDServiceMessagePackMaximumDepth)
+    {
+        SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeTooDeep, "Too deep nesting");
+        return nil;
+    }
+    
+    __strong id* objects = (__strong id*)calloc(MAX(count, 1), sizeof(id));
+    NSArray* array = nil;
+    size_t index = 0;
+    for (; index < count; index++)
+    {
+        objects[index] = SDMessagePackReadValue(reader);
+        if (!objects[index])
+        {
+            break;
+        }
+    }
+    if (index == count)
+    {
+        array = [NSArray arrayWithObjects:objects count:count];
+    }
+    for (size_t i = 0; i < index; i++)
+    {
+        objects[i] = nil;
+    }
+    free(objects);
+    reader->depth--;
+    return array;
+}
+
+static NSString* SDMessagePackReadKey(SDMessagePackReader* reader)
+{
+    if (!SDMessagePackReaderHasBytes(reader, 1))
+    {
+        return nil;
+    }
+    uint8_t type = reader->bytes[reader->position++];
+    size_t length = 0;
+    if ((type & 0xe0) == 0xa0)
+    {
+        length = type & 0x1f;
+    }
+    else if (type == 0xd9 || type == 0xda || type == 0xdb)
+    {
+        if (!SDMessagePackReadLength(reader, (size_t)1 << (type - 0xd9), &length))
+        {
+            return nil;
+        }
+    }
+    else
+    {
+        SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeInvalidData, "Map key is not a string");
+        return nil;
+    }
+    return SDMessagePackReadString(reader, length, YES);
+}
+
+static NSDictionary* SDMessagePackReadMap(SDMessagePackReader* reader, size_t count)
+{
+    // every pair takes at least two bytes
+    if (count > (reader->length - reader->position) / 2)
+    {
+        SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeTruncatedData, "Truncated data");
+        return nil;
+    }
+    if (++reader->depth > SDServiceMessagePackMaximumDepth)
+    {
+        SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeTooDeep, "Too deep nesting");
+        return nil;
+    }
+    
+    __strong id* keys = (__strong id*)calloc(MAX(count, 1), sizeof(id));
+    __strong id* values = (__strong id*)calloc(MAX(count, 1), sizeof(id));
+    NSDictionary* dictionary = nil;
+    size_t index = 0;
+    for (; index < count; index++)
+    {
+        keys[index] = SDMessagePackReadKey(reader);
+        values[index] = keys[index] ? SDMessagePackReadValue(reader) : nil;
+        if (!values[index])
+        {
+            index++;
+            break;
+        }
+    }
+    if (reader->errorCode == 0)
+    {
+        dictionary = [NSDictionary dictionaryWithObjects:values forKeys:keys count:count];
+    }
+    for (size_t i = 0; i < index; i++)
+    {
+        keys[i] = nil;
+        values[i] = nil;
+    }
+    free(keys);
+    free(values);
+    reader->depth--;
+    return dictionary;
+}
+
+static id SDMessagePackReadValue(SDMessagePackReader* reader)
+{
+    if (!SDMessagePackReaderHasBytes(reader, 1))
+    {
+        return nil;
+    }
+    uint8_t type = reader->bytes[reader->position++];
+    
+    if (type <= 0x7f)
+    {
+        return @(type);
+    }
+    if (type >= 0xe0)
+    {
+        return @((int8_t)type);
+    }
+    if (type <= 0x8f)
+    {
+        return SDMessagePackReadMap(reader, type & 0x0f);
+    }
+    if (type <= 0x9f)
+    {
+        return SDMessagePackReadArray(reader, type & 0x0f);
+    }
+    if (type <= 0xbf)
+    {
+        return SDMessagePackReadString(reader, type & 0x1f, NO);
+    }
+    
+    size_t length = 0;
+    switch (type)
+    {
+        case 0xc0:
+            return [NSNull null];
+        case 0xc2:
+            return @NO;
+        case 0xc3:
+            return @YES;
+        case 0xc4:
+        case 0xc5:
+        case 0xc6:
+            return SDMessagePackReadLength(reader, (size_t)1 << (type - 0xc4), &length) ? SDMessagePackReadBinary(reader, length) : nil;
+        case 0xca: {
+            if (!SDMessagePackReaderHasBytes(reader, 4))
+            {
+                return nil;
+            }
+            uint32_t bits = (uint32_t)SDMessagePackReadBigEndian(reader, 4);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return @((double)value);
+        }
+        case 0xcb: {
+            if (!SDMessagePackReaderHasBytes(reader, 8))
+            {
+                return nil;
+            }
+            uint64_t bits = SDMessagePackReadBigEndian(reader, 8);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return @(value);
+        }
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf: {
+            size_t size = (size_t)1 << (type - 0xcc);
+            if (!SDMessagePackReaderHasBytes(reader, size))
+            {
+                return nil;
+            }
+            uint64_t value = SDMessagePackReadBigEndian(reader, size);
+            return value <= LLONG_MAX ? @((long long)value) : @((unsigned long long)value);
+        }
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3: {
+            size_t size = (size_t)1 << (type - 0xd0);
+            if (!SDMessagePackReaderHasBytes(reader, size))
+            {
+                return nil;
+            }
+            uint64_t value = SDMessagePackReadBigEndian(reader, size);
+            // sign extension
+            unsigned shift = (unsigned)(64 - size * 8);
+            return @((long long)(value << shift) >> shift);
+        }
+        case 0xd9:
+        case 0xda:
+        case 0xdb:
+            return SDMessagePackReadLength(reader, (size_t)1 << (type - 0xd9), &length) ? SDMessagePackReadString(reader, length, NO) : nil;
+        case 0xdc:
+        case 0xdd:
+            return SDMessagePackReadLength(reader, type == 0xdc ? 2 : 4, &length) ? SDMessagePackReadArray(reader, length) : nil;
+        case 0xde:
+        case 0xdf:
+            return SDMessagePackReadLength(reader, type == 0xde ? 2 : 4, &length) ? SDMessagePackReadMap(reader, length) : nil;
+        case 0xc7:
+        case 0xc8:
+        case 0xc9:
+        case 0xd4:
+        case 0xd5:
+        case 0xd6:
+        case 0xd7:
+        case 0xd8:
+            SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeUnsupportedType, "Extension types are not supported");
+            return nil;
+        default:
+            SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeInvalidData, "Invalid type byte");
+            return nil;
+    }
+}
+
+#pragma mark - Writer
+
+typedef struct
+{
+    uint8_t* bytes;
+    size_t length;
+    size_t capacity;
+    NSUInteger depth;
+    
+    NSInteger errorCode;
+    const char* errorMessage;
+} SDMessagePackWriter;
+
+static BOOL SDMessagePackWriteValue(SDMessagePackWriter* writer, id object);
+
+static BOOL SDMessagePackWriterFail(SDMessagePackWriter* writer, NSInteger code, const char* message)
+{
+    writer->errorCode = code;
+    writer->errorMessage = message;
+    return NO;
+}
+
+static inline void SDMessagePackWriterReserve(SDMessagePackWriter* writer, size_t count)
+{
+    if (writer->capacity - writer->length >= count)
+    {
+        return;
+    }
+    size_t capacity = MAX(writer->capacity * 2, writer->length + count);
+    writer->bytes = reallocf(writer->bytes, capacity);
+    writer->capacity = capacity;
+}
+
+static inline void SDMessagePackWriteByte(SDMessagePackWriter* writer, uint8_t byte)
+{
+    SDMessagePackWriterReserve(writer, 1);
+    writer->bytes[writer->length++] = byte;
+}
+
+static inline void SDMessagePackWriteTypeAndBigEndian(SDMessagePackWriter* writer, uint8_t type, uint64_t value, size_t size)
+{
+    SDMessagePackWriterReserve(writer, 1 + size);
+    writer->bytes[writer->length++] = type;
+    for (size_t i = size; i > 0; i--)
+    {
+        writer->bytes[writer->length++] = (uint8_t)(value >> ((i - 1) * 8));
+    }
+}
+
+/**
+ *  Header of str, bin, array and map: fixed type for small lengths (0 if the type has none), then 8, 16 and 32 bit lengths.
+ */
+static inline void SDMessagePackWriteHeader(SDMessagePackWriter* writer, size_t length, uint8_t fixedType, size_t maximumFixedLength, uint8_t type8, uint8_t type16, uint8_t type32)
+{
+    if (fixedType && length <= maximumFixedLength)
+    {
+        SDMessagePackWriteByte(writer, fixedType | (uint8_t)length);
+    }
+    else if (type8 && length <= UINT8_MAX)
+    {
+        SDMessagePackWriteTypeAndBigEndian(writer, type8, length, 1);
+    }
+    else if (length <= UINT16_MAX)
+    {
+        SDMessagePackWriteTypeAndBigEndian(writer, type16, length, 2);
+    }
+    else
+    {
+        SDMessagePackWriteTypeAndBigEndian(writer, type32, length, 4);
+    }
+}
+
+static inline size_t SDMessagePackStringHeaderSize(size_t length)
+{
+    return length <= 31 ? 1 : (length <= UINT8_MAX ? 2 : (length <= UINT16_MAX ? 3 : 5));
+}
+
+static BOOL SDMessagePackWriteString(SDMessagePackWriter* writer, NSString* string)
+{
+    // bytes are written after the largest header, then moved next to the actual one
+    NSUInteger maximumLength = [string maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    SDMessagePackWriterReserve(writer, 5 + maximumLength);
+    NSUInteger usedLength = 0;
+    uint8_t* bytes = writer->bytes + writer->length + 5;
+    if (![string getBytes:bytes maxLength:maximumLength usedLength:&usedLength encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, string.length) remainingRange:NULL] && string.length > 0)
+    {
+        return SDMessagePackWriterFail(writer, SDServiceMessagePackErrorCodeInvalidData, "String can't be encoded in UTF-8");
+    }
+    size_t headerSize = SDMessagePackStringHeaderSize(usedLength);
+    if (headerSize < 5)
+    {
+        memmove(writer->bytes + writer->length + headerSize, bytes, usedLength);
+    }
+    SDMessagePackWriteHeader(writer, usedLength, 0xa0, 31, 0xd9, 0xda, 0xdb);
+    writer->length += usedLength;
+    return YES;
+}
+
+static void SDMessagePackWriteNumber(SDMessagePackWriter* writer, NSNumber* number)
+{
+    if (CFGetTypeID((__bridge CFTypeRef)number) == CFBooleanGetTypeID())
+    {
+        SDMessagePackWriteByte(writer, number.boolValue ? 0xc3 : 0xc2);
+        return;
+    }
+    
+    const char* objCType = number.objCType;
+    if (objCType[0] == 'f')
+    {
+        float value = number.floatValue;
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        SDMessagePackWriteTypeAndBigEndian(writer, 0xca, bits, 4);
+        return;
+    }
+    if (objCType[0] == 'd')
+    {
+        double value = number.doubleValue;
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        SDMessagePackWriteTypeAndBigEndian(writer, 0xcb, bits, 8);
+        return;
+    }
+    
+    long long signedValue = number.longLongValue;
+    if (objCType[0] == 'Q' || signedValue >= 0)
+    {
+        unsigned long long value = number.unsignedLongLongValue;
+        if (value <= 0x7f)
+        {
+            SDMessagePackWriteByte(writer, (uint8_t)value);
+        }
+        else if (value <= UINT8_MAX)
+        {
+            SDMessagePackWriteTypeAndBigEndian(writer, 0xcc, value, 1);
+        }
+        else if (value <= UINT16_MAX)
+        {
+            SDMessagePackWriteTypeAndBigEndian(writer, 0xcd, value, 2);
+        }
+        else if (value <= UINT32_MAX)
+        {
+            SDMessagePackWriteTypeAndBigEndian(writer, 0xce, value, 4);
+        }
+        else
+        {
+            SDMessagePackWriteTypeAndBigEndian(writer, 0xcf, value, 8);
+        }
+        return;
+    }
+    
+    if (signedValue >= -32)
+    {
+        SDMessagePackWriteByte(writer, (uint8_t)(int8_t)signedValue);
+    }
+    else if (signedValue >= INT8_MIN)
+    {
+        SDMessagePackWriteTypeAndBigEndian(writer, 0xd0, (uint8_t)signedValue, 1);
+    }
+    else if (signedValue >= INT16_MIN)
+    {
+        SDMessagePackWriteTypeAndBigEndian(writer, 0xd1, (uint16_t)signedValue, 2);
+    }
+    else if (signedValue >= INT32_MIN)
+    {
+        SDMessagePackWriteTypeAndBigEndian(writer, 0xd2, (uint32_t)signedValue, 4);
+    }
+    else
+    {
+        SDMessagePackWriteTypeAndBigEndian(writer, 0xd3, (uint64_t)signedValue, 8);
+    }
+}
+
+static BOOL SDMessagePackWriteValue(SDMessagePackWriter* writer, id object)
+{
+    if ([object isKindOfClass:[NSString class]])
+    {
+        return SDMessagePackWriteString(writer, object);
+    }
+    if ([object isKindOfClass:[NSNumber class]])
+    {
+        SDMessagePackWriteNumber(writer, object);
+        return YES;
+    }
+    if (object == [NSNull null])
+    {
+        SDMessagePackWriteByte(writer, 0xc0);
+        return YES;
+    }
+    if ([object isKindOfClass:[NSData class]])
+    {
+        NSData* data = object;
+        SDMessagePackWriteHeader(writer, data.length, 0, 0, 0xc4, 0xc5, 0xc6);
+        SDMessagePackWriterReserve(writer, data.length);
+        [data getBytes:writer->bytes + writer->length length:data.length];
+        writer->length += data.length;
+        return YES;
+    }
+    
+    BOOL isArray = [object isKindOfClass:[NSArray class]];
+    if (!isArray && ![object isKindOfClass:[NSDictionary class]])
+    {
+        return SDMessagePackWriterFail(writer, SDServiceMessagePackErrorCodeUnsupportedType, "Object is not a JSON object");
+    }
+    if (++writer->depth > SDServiceMessagePackMaximumDepth)
+    {
+        return SDMessagePackWriterFail(writer, SDServiceMessagePackErrorCodeTooDeep, "Too deep nesting");
+    }
+    if (isArray)
+    {
+        NSArray* array = object;
+        SDMessagePackWriteHeader(writer, array.count, 0x90, 15, 0, 0xdc, 0xdd);
+        for (id element in array)
+        {
+            if (!SDMessagePackWriteValue(writer, element))
+            {
+                return NO;
+            }
+        }
+    }
+    else
+    {
+        NSDictionary* dictionary = object;
+        SDMessagePackWriteHeader(writer, dictionary.count, 0x80, 15, 0, 0xde, 0xdf);
+        __block BOOL success = YES;
+        [dictionary enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL* stop) {
+            if (![key isKindOfClass:[NSString class]])
+            {
+                success = SDMessagePackWriterFail(writer, SDServiceMessagePackErrorCodeUnsupportedType, "Map key is not a string");
+            }
+            else
+            {
+                success = SDMessagePackWriteString(writer, key) && SDMessagePackWriteValue(writer, value);
+            }
+            *stop = !success;
+        }];
+        if (!success)
+        {
+            return NO;
+        }
+    }
+    writer->depth--;
+    return YES;
+}
+
+#pragma mark - Codec
+
+@implementation SDServiceMessagePackCodec
+
+- (NSArray<NSString*>*) contentTypes
+{
+    return @[@"application/msgpack", @"application/x-msgpack"];
+}
+
+- (NSData*) dataWithObject:(id)object error:(NSError**)error
+{
+    SDMessagePackWriter writer = { 0 };
+    writer.bytes = malloc(MESSAGE_PACK_INITIAL_BUFFER_CAPACITY);
+    writer.capacity = MESSAGE_PACK_INITIAL_BUFFER_CAPACITY;
+    if (!SDMessagePackWriteValue(&writer, object))
+    {
+        free(writer.bytes);
+        if (error)
+        {
+            *error = [NSError errorWithDomain:SDServiceMessagePackErrorDomain code:writer.errorCode userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"%s", writer.errorMessage] }];
+        }
+        return nil;
+    }
+    return [NSData dataWithBytesNoCopy:reallocf(writer.bytes, MAX(writer.length, 1)) length:writer.length freeWhenDone:YES];
+}
+
+- (id) objectWithData:(NSData*)data error:(NSError**)error
+{
+    SDMessagePackReader* reader = calloc(1, sizeof(SDMessagePackReader));
+    reader->bytes = data.bytes;
+    reader->length = data.length;
+    
+    id object = SDMessagePackReadValue(reader);
+    if (object && reader->position != reader->length)
+    {
+        SDMessagePackReaderFail(reader, SDServiceMessagePackErrorCodeInvalidData, "Bytes after the top level value");
+        object = nil;
+    }
+    if (!object && error)
+    {
+        *error = [NSError errorWithDomain:SDServiceMessagePackErrorDomain code:reader->errorCode userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"%s at byte %lu", reader->errorMessage, (unsigned long)reader->position] }];
+    }
+    
+    for (NSUInteger i = 0; i < MESSAGE_PACK_KEY_CACHE_SIZE; i++)
+    {
+        if (reader->keys[i])
+        {
+            CFRelease(reader->keys[i]);
+        }
+    }
+    free(reader);
+    return object;
+}
+
+@end
@@ -0,0 +1,131 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import "SDServiceManager.h"
+
+/**
+ *  Block that builds the request of a page.
+ *
+ *  @param pageIndex    index of the page (0 is the first page).
+ *  @param previousPage mapped response of the previous page, to read the cursor (nil for the first page).
+ *
+ *  @return request of the page, or nil if there are no more pages.
+ */
+typedef id<SDServiceGenericRequestProtocol> _Nullable (^ SDServicePageRequestBlock)(NSUInteger pageIndex, id<SDServiceGenericResponseProtocol> _Nullable previousPage);
+
+typedef void (^ SDServicePageLoadedBlock)(NSUInteger pageIndex, id<SDServiceGenericResponseProtocol> _Nullable page);
+typedef void (^ SDServicePageFailedBlock)(NSUInteger pageIndex, id<SDServiceGenericErrorProtocol> _Nullable error);
+
+/**
+ *  Loads pages of a paged list service (cursor or offset based) through SDServiceManager, prefetching the next pages before the user reaches them.
+ *
+ *  The caller reports the visible page and the scroll velocity: pages are prefetched ahead (or behind, scrolling back) as far as the time needed to load a page allows, up to maximumPrefetchDistance.
+ *  Only a window of maximumNumberOfPages mapped pages is kept in memory: farthest pages from the visible one are released and prefetches that fall out of range are cancelled.
+ *  Requests of pages are kept in a wider window (maximumNumberOfRequests), so a released page can be loaded again even with cursor based services;
+ *  farther pages of cursor based services are reached again through their previous pages.
+ *
+ *  Must be used from main thread.
+ */
+@interface SDServicePaginationController : NSObject
+
+- (instancetype _Nonnull) initWithService:(SDServiceGeneric* _Nonnull)service serviceManager:(SDServiceManager* _Nonnull)serviceManager requestBlock:(SDServicePageRequestBlock _Nonnull)requestBlock;
+
+@property (nonatomic, strong, readonly) SDServiceGeneric* _Nonnull service;
+@property (nonatomic, strong, readonly) SDServiceManager* _Nonnull serviceManager;
+
+/**
+ *  Delegate and operation type of all page calls, passed to SDServiceManager (ex. to cancel them with cancelAllOperationsForDelegate:).
+ */
+@property (nonatomic, weak) id<SDServiceManagerDelegate> _Nullable delegate;
+@property (nonatomic, assign) SDServiceOperationType operationType;
+
+/**
+ *  Automatic retries of each page call. Default: 0
+ */
+@property (nonatomic, assign) int numAutomaticRetry;
+
+/**
+ *  Maximum number of mapped pages kept in memory. Default: 5
+ */
+@property (nonatomic, assign) NSUInteger maximumNumberOfPages;
+
+/**
+ *  Maximum distance from the visible page of prefetched pages. Default: 2
+ */
+@property (nonatomic, assign) NSUInteger maximumPrefetchDistance;
+
+/**
+ *  Maximum number of requests of pages kept, to load released pages again (never less than maximumNumberOfPages). Farthest requests from the visible page are released first. Default: 50
+ */
+@property (nonatomic, assign) NSUInteger maximumNumberOfRequests;
+
+/**
+ *  Called every time a page is loaded, prefetched ones included.
+ */
+@property (nonatomic, strong) SDServicePageLoadedBlock _Nullable pageLoadedBlock;
+
+/**
+ *  Called every time a page fails, prefetched ones included.
+ */
+@property (nonatomic, strong) SDServicePageFailedBlock _Nullable pageFailedBlock;
+
+/**
+ *  Last visible page reported.
+ */
+@property (nonatomic, readonly) NSUInteger visiblePageIndex;
+
+/**
+ *  NO when requestBlock returned nil: lastPageIndex is the last page (NSNotFound if the list is empty or the last page is not known yet).
+ */
+@property (nonatomic, readonly) BOOL hasMorePages;
+@property (nonatomic, readonly) NSUInteger lastPageIndex;
+
+/**
+ *  Moving average of load time of a page (seconds), used to decide how far to prefetch.
+ */
+@property (nonatomic, readonly) NSTimeInterval averagePageLoadTime;
+
+/**
+ *  Mapped page if it is in memory, nil otherwise.
+ */
+- (id<SDServiceGenericResponseProtocol> _Nullable) pageAtIndex:(NSUInteger)pageIndex;
+
+- (BOOL) isLoadingPageAtIndex:(NSUInteger)pageIndex;
+
+/**
+ *  Load the page. If the page is in memory completion is called immediately; if it is being prefetched completion is called when prefetch ends.
+ *  Pages asked with this method are never cancelled because out of range. Completion receives a nil page beyond the last page.
+ */
+- (void) loadPageAtIndex:(NSUInteger)pageIndex completionSuccess:(ServiceCompletionSuccessHandler _Nullable)completionSuccess completionFailure:(ServiceCompletionFailureHandler _Nullable)completionFailure;
+
+/**
+ *  Report the page visible to the user and the scroll velocity, to prefetch pages and release the ones out of window.
+ *
+ *  @param pageIndex      visible page
+ *  @param scrollVelocity velocity in pages per second: positive toward next pages, negative toward previous pages.
+ */
+- (void) updateVisiblePageIndex:(NSUInteger)pageIndex scrollVelocity:(double)scrollVelocity;
+
+/**
+ *  Cancel all running prefetches.
+ */
+- (void) cancelAllPrefetches;
+
+/**
+ *  Cancel all calls and release all pages and requests (ex. for pull to refresh).
+ */
+- (void) reset;
+
+@end
@@ -0,0 +1,431 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServicePaginationController.h"
+
+#define DEFAULT_PAGINATION_MAXIMUM_PAGES       5
+#define DEFAULT_PAGINATION_PREFETCH_DISTANCE   2
+#define DEFAULT_PAGINATION_MAXIMUM_REQUESTS     50
+
+// weight of the last load time in the moving average
+#define PAGE_LOAD_TIME_SMOOTHING               0.3
+
+/**
+ *  Running call of a page.
+ */
+@interface SDServicePageLoad : NSObject
+
+@property (nonatomic, strong) SDServiceCallInfo* serviceInfo;
+@property (nonatomic, assign) BOOL prefetch;
+@property (nonatomic, assign) CFAbsoluteTime startTime;
+@property (nonatomic, strong) NSMutableArray<ServiceCompletionSuccessHandler>* successHandlers;
+@property (nonatomic, strong) NSMutableArray<ServiceCompletionFailureHandler>* failureHandlers;
+
+@end
+
+@implementation SDServicePageLoad
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        self.successHandlers = [NSMutableArray array];
+        self.failureHandlers = [NSMutableArray array];
+    }
+    return self;
+}
+
+@end
+
+
+
+@interface SDServicePaginationController ()
+
+@property (nonatomic, strong, readwrite) SDServiceGeneric* service;
+@property (nonatomic, strong, readwrite) SDServiceManager* serviceManager;
+@property (nonatomic, strong) SDServicePageRequestBlock requestBlock;
+
+@property (nonatomic, readwrite) NSUInteger visiblePageIndex;
+@property (nonatomic, assign) double scrollVelocity;
+@property (nonatomic, readwrite) BOOL hasMorePages;
+@property (nonatomic, readwrite) NSUInteger lastPageIndex;
+@property (nonatomic, readwrite) NSTimeInterval averagePageLoadTime;
+
+@property (nonatomic, strong) NSMutableDictionary<NSNumber*, id<SDServiceGenericResponseProtocol>>* pages;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber*, id<SDServiceGenericRequestProtocol>>* requests;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber*, SDServicePageLoad*>* loads;
+
+@end
+
+@implementation SDServicePaginationController
+
+- (instancetype) initWithService:(SDServiceGeneric*)service serviceManager:(SDServiceManager*)serviceManager requestBlock:(SDServicePageRequestBlock)requestBlock
+{
+    self = [super init];
+    if (self)
+    {
+        self.service = service;
+        self.serviceManager = serviceManager;
+        self.requestBlock = requestBlock;
+        self.operationType = kSDServiceOperationTypeInvalid;
+        self.maximumNumberOfPages = DEFAULT_PAGINATION_MAXIMUM_PAGES;
+        self.maximumPrefetchDistance = DEFAULT_PAGINATION_PREFETCH_DISTANCE;
+        self.maximumNumberOfRequests = DEFAULT_PAGINATION_MAXIMUM_REQUESTS;
+        
+        self.pages = [NSMutableDictionary dictionary];
+        self.requests = [NSMutableDictionary dictionary];
+        self.loads = [NSMutableDictionary dictionary];
+        self.hasMorePages = YES;
+        self.lastPageIndex = NSNotFound;
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    for (SDServicePageLoad* load in self.loads.allValues)
+    {
+        [_serviceManager cancelServiceCallInfo:load.serviceInfo];
+    }
+}
+
+#pragma mark - Pages
+
+- (id<SDServiceGenericResponseProtocol>) pageAtIndex:(NSUInteger)pageIndex
+{
+    return self.pages[@(pageIndex)];
+}
+
+- (BOOL) isLoadingPageAtIndex:(NSUInteger)pageIndex
+{
+    return self.loads[@(pageIndex)] != nil;
+}
+
+- (BOOL) isBeyondLastPage:(NSUInteger)pageIndex
+{
+    return !self.hasMorePages && (self.lastPageIndex == NSNotFound || pageIndex > self.lastPageIndex);
+}
+
+- (void) loadPageAtIndex:(NSUInteger)pageIndex completionSuccess:(ServiceCompletionSuccessHandler)completionSuccess completionFailure:(ServiceCompletionFailureHandler)completionFailure
+{
+    id<SDServiceGenericResponseProtocol> page = self.pages[@(pageIndex)];
+    if (page || [self isBeyondLastPage:pageIndex])
+    {
+        if (completionSuccess)
+        {
+            completionSuccess(page);
+        }
+        return;
+    }
+    
+    SDServicePageLoad* load = [self startLoadOfPageAtIndex:pageIndex prefetch:NO];
+    if (!load && !self.requests[@(pageIndex)] && pageIndex > 0 && ![self isBeyondLastPage:pageIndex])
+    {
+        // cursor of the page is in the previous page: load it first
+        __weak typeof (self) weakself = self;
+        [self loadPageAtIndex:pageIndex - 1 completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            [weakself loadPageAtIndex:pageIndex completionSuccess:completionSuccess completionFailure:completionFailure];
+        } completionFailure:completionFailure];
+        return;
+    }
+    
+    if (!load)
+    {
+        // requestBlock says there are no more pages
+        if (completionSuccess)
+        {
+            completionSuccess(nil);
+        }
+        return;
+    }
+    
+    if (completionSuccess)
+    {
+        [load.successHandlers addObject:completionSuccess];
+    }
+    if (completionFailure)
+    {
+        [load.failureHandlers addObject:completionFailure];
+    }
+}
+
+#pragma mark - Requests
+
+- (id<SDServiceGenericRequestProtocol>) requestForPageAtIndex:(NSUInteger)pageIndex
+{
+    id<SDServiceGenericRequestProtocol> request = self.requests[@(pageIndex)];
+    if (request || [self isBeyondLastPage:pageIndex])
+    {
+        return request;
+    }
+    
+    id<SDServiceGenericResponseProtocol> previousPage = nil;
+    if (pageIndex > 0)
+    {
+        previousPage = self.pages[@(pageIndex - 1)];
+        if (!previousPage)
+        {
+            // cursor not known yet
+            return nil;
+        }
+    }
+    
+    request = self.requestBlock(pageIndex, previousPage);
+    if (!request)
+    {
+        self.hasMorePages = NO;
+        self.lastPageIndex = pageIndex > 0 ? pageIndex - 1 : NSNotFound;
+        return nil;
+    }
+    
+    self.requests[@(pageIndex)] = request;
+    return request;
+}
+
+- (SDServicePageLoad*) startLoadOfPageAtIndex:(NSUInteger)pageIndex prefetch:(BOOL)prefetch
+{
+    SDServicePageLoad* load = self.loads[@(pageIndex)];
+    if (load)
+    {
+        // a page asked by the caller is not a prefetch anymore
+        load.prefetch = load.prefetch && prefetch;
+        return load;
+    }
+    
+    id<SDServiceGenericRequestProtocol> request = [self requestForPageAtIndex:pageIndex];
+    if (!request)
+    {
+        return nil;
+    }
+    
+    SDServiceCallInfo* serviceInfo = [[SDServiceCallInfo alloc] initWithService:self.service request:request];
+    serviceInfo.type = self.operationType;
+    serviceInfo.delegate = self.delegate;
+    serviceInfo.numAutomaticRetry = self.numAutomaticRetry;
+    
+    load = [SDServicePageLoad new];
+    load.serviceInfo = serviceInfo;
+    load.prefetch = prefetch;
+    load.startTime = CFAbsoluteTimeGetCurrent();
+    
+    // load is weak: when it's cancelled the result is ignored
+    __weak typeof (self) weakself = self;
+    __weak SDServicePageLoad* weakLoad = load;
+    serviceInfo.completionSuccess = ^(id<SDServiceGenericResponseProtocol> response) {
+        [weakself pageLoad:weakLoad atIndex:pageIndex didEndWithResponse:response error:nil];
+    };
+    serviceInfo.completionFailure = ^(id<SDServiceGenericErrorProtocol> error) {
+        [weakself pageLoad:weakLoad atIndex:pageIndex didEndWithResponse:nil error:error];
+    };
+    
+    self.loads[@(pageIndex)] = load;
+    SDLogModuleVerbose(kServiceManagerLogModuleName, @"%@ page %lu of %@", prefetch ? @"Prefetch" : @"Load", (unsigned long)pageIndex, NSStringFromClass([self.service class]));
+    [self.serviceManager callServiceWithServiceCallInfo:serviceInfo];
+    return load;
+}
+
+- (void) pageLoad:(SDServicePageLoad*)load atIndex:(NSUInteger)pageIndex didEndWithResponse:(id<SDServiceGenericResponseProtocol>)response error:(id<SDServiceGenericErrorProtocol>)error
+{
+    if (!load || self.loads[@(pageIndex)] != load)
+    {
+        return;
+    }
+    [self.loads removeObjectForKey:@(pageIndex)];
+    
+    if (error)
+    {
+        for (ServiceCompletionFailureHandler handler in load.failureHandlers)
+        {
+            handler(error);
+        }
+        if (self.pageFailedBlock)
+        {
+            self.pageFailedBlock(pageIndex, error);
+        }
+        return;
+    }
+    
+    NSTimeInterval loadTime = CFAbsoluteTimeGetCurrent() - load.startTime;
+    self.averagePageLoadTime = self.averagePageLoadTime > 0 ? PAGE_LOAD_TIME_SMOOTHING * loadTime + (1. - PAGE_LOAD_TIME_SMOOTHING) * self.averagePageLoadTime : loadTime;
+    
+    if (response)
+    {
+        self.pages[@(pageIndex)] = response;
+    }
+    
+    for (ServiceCompletionSuccessHandler handler in load.successHandlers)
+    {
+        handler(response);
+    }
+    if (self.pageLoadedBlock)
+    {
+        self.pageLoadedBlock(pageIndex, response);
+    }
+    
+    // with cursors, next pages can be prefetched only now
+    [self updatePrefetches];
+    [self releasePagesOutOfWindow];
+}
+
+#pragma mark - Prefetch
+
+- (void) updateVisiblePageIndex:(NSUInteger)pageIndex scrollVelocity:(double)scrollVelocity
+{
+    self.visiblePageIndex = pageIndex;
+    self.scrollVelocity = scrollVelocity;
+    
+    [self updatePrefetches];
+    [self releasePagesOutOfWindow];
+}
+
+- (NSUInteger) prefetchDistance
+{
+    // pages scrolled while a page loads, plus the next one
+    NSUInteger distance = 1;
+    if (self.averagePageLoadTime > 0)
+    {
+        distance += (NSUInteger)floor(fabs(self.scrollVelocity) * self.averagePageLoadTime);
+    }
+    return MIN(distance, self.maximumPrefetchDistance);
+}
+
+- (void) updatePrefetches
+{
+    NSUInteger visiblePageIndex = self.visiblePageIndex;
+    NSUInteger distance = [self prefetchDistance];
+    
+    // cancel prefetches out of range
+    for (NSNumber* index in self.loads.allKeys)
+    {
+        SDServicePageLoad* load = self.loads[index];
+        NSUInteger pageIndex = index.unsignedIntegerValue;
+        BOOL outOfRange = pageIndex > visiblePageIndex + self.maximumPrefetchDistance || pageIndex + self.maximumPrefetchDistance < visiblePageIndex;
+        if (load.prefetch && outOfRange)
+        {
+            SDLogModuleVerbose(kServiceManagerLogModuleName, @"Cancel prefetch of page %lu of %@", (unsigned long)pageIndex, NSStringFromClass([self.service class]));
+            [self.loads removeObjectForKey:index];
+            [self.serviceManager cancelServiceCallInfo:load.serviceInfo];
+        }
+    }
+    
+    // visible page first, then pages in scroll direction
+    NSMutableArray<NSNumber*>* pagesToPrefetch = [NSMutableArray arrayWithObject:@(visiblePageIndex)];
+    for (NSUInteger step = 1; step <= distance; step++)
+    {
+        if (self.scrollVelocity >= 0)
+        {
+            [pagesToPrefetch addObject:@(visiblePageIndex + step)];
+        }
+        else if (visiblePageIndex >= step)
+        {
+            [pagesToPrefetch addObject:@(visiblePageIndex - step)];
+        }
+    }
+    
+    for (NSNumber* index in pagesToPrefetch)
+    {
+        NSUInteger pageIndex = index.unsignedIntegerValue;
+        if ([self isBeyondLastPage:pageIndex])
+        {
+            break;
+        }
+        if (self.pages[index] || self.loads[index])
+        {
+            continue;
+        }
+        if (![self startLoadOfPageAtIndex:pageIndex prefetch:YES] && self.scrollVelocity >= 0)
+        {
+            // cursor of next pages not known yet: prefetch continues when this page arrives
+            break;
+        }
+    }
+}
+
+- (void) releasePagesOutOfWindow
+{
+    NSUInteger maximumNumberOfPages = MAX(self.maximumNumberOfPages, 1);
+    while (self.pages.count > maximumNumberOfPages)
+    {
+        NSNumber* farthestIndex = nil;
+        NSUInteger farthestDistance = 0;
+        for (NSNumber* index in self.pages)
+        {
+            NSUInteger distance = [self distanceFromVisiblePageOfPageAtIndex:index.unsignedIntegerValue];
+            if (!farthestIndex || distance > farthestDistance)
+            {
+                farthestIndex = index;
+                farthestDistance = distance;
+            }
+        }
+        [self.pages removeObjectForKey:farthestIndex];
+    }
+    
+    // requests of released pages are kept a little longer, so scrolling back doesn't go through previous pages to rebuild cursors
+    NSUInteger maximumNumberOfRequests = MAX(self.maximumNumberOfRequests, maximumNumberOfPages);
+    if (self.requests.count <= maximumNumberOfRequests)
+    {
+        return;
+    }
+    NSArray<NSNumber*>* indexes = [self.requests.allKeys sortedArrayUsingComparator:^NSComparisonResult (NSNumber* index1, NSNumber* index2) {
+        return [@([self distanceFromVisiblePageOfPageAtIndex:index2.unsignedIntegerValue]) compare:@([self distanceFromVisiblePageOfPageAtIndex:index1.unsignedIntegerValue])];
+    }];
+    for (NSNumber* index in indexes)
+    {
+        if (self.requests.count <= maximumNumberOfRequests)
+        {
+            break;
+        }
+        if (!self.pages[index] && !self.loads[index])
+        {
+            [self.requests removeObjectForKey:index];
+        }
+    }
+}
+
+- (NSUInteger) distanceFromVisiblePageOfPageAtIndex:(NSUInteger)pageIndex
+{
+    return pageIndex > self.visiblePageIndex ? pageIndex - self.visiblePageIndex : self.visiblePageIndex - pageIndex;
+}
+
+- (void) cancelAllPrefetches
+{
+    for (NSNumber* index in self.loads.allKeys)
+    {
+        SDServicePageLoad* load = self.loads[index];
+        if (load.prefetch)
+        {
+            [self.loads removeObjectForKey:index];
+            [self.serviceManager cancelServiceCallInfo:load.serviceInfo];
+        }
+    }
+}
+
+- (void) reset
+{
+    for (SDServicePageLoad* load in self.loads.allValues)
+    {
+        [self.serviceManager cancelServiceCallInfo:load.serviceInfo];
+    }
+    [self.loads removeAllObjects];
+    [self.pages removeAllObjects];
+    [self.requests removeAllObjects];
+    
+    self.hasMorePages = YES;
+    self.lastPageIndex = NSNotFound;
+    self.visiblePageIndex = 0;
+    self.scrollVelocity = 0;
+}
+
+@end
@@ -0,0 +1,74 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Block that maps one item of the array (called concurrently on many threads).
+ *
+ *  @return mapped item, or nil setting error.
+ */
+typedef id _Nullable (^ SDServiceParallelMappingBlock)(id _Nonnull item, NSError* _Nullable * _Nonnull error);
+
+/**
+ *  Block that receives mapped chunks in order of the array, one at a time.
+ */
+typedef void (^ SDServiceParallelChunkBlock)(NSArray* _Nonnull items, NSUInteger firstIndex);
+
+/**
+ *  Maps large arrays splitting them in chunks mapped concurrently on global queues, then puts results together in the order of the array.
+ *
+ *  Workers take the next chunk not mapped yet until chunks are over, so slow chunks don't keep the others waiting.
+ *  The first error stops workers: chunks not started are skipped and the error of the lowest failed chunk is returned.
+ *  Arrays shorter than threshold are mapped sequentially on the calling thread, where splitting costs more than it saves.
+ *  Called from a block of SDServiceMappingExecutor, the calling thread maps too and is helped only by free workers of the executor, so mapping never exceeds its maximumConcurrency.
+ *
+ *  Items are mapped on many threads at once: the mapping block, and the value transformers it uses, must be thread safe.
+ */
+@interface SDServiceParallelMapper : NSObject <NSCopying>
+
+/**
+ *  Minimum number of items of arrays mapped in parallel.
+ *
+ *  Default: 2000
+ */
+@property (nonatomic, assign) NSUInteger threshold;
+
+/**
+ *  Number of items mapped by a worker at a time.
+ *
+ *  Default: 500
+ */
+@property (nonatomic, assign) NSUInteger chunkSize;
+
+/**
+ *  Maximum number of workers mapping at the same time.
+ *
+ *  Default: number of active processors
+ */
+@property (nonatomic, assign) NSUInteger maximumConcurrency;
+
+/**
+ *  Map array with block, in parallel if it is long enough.
+ *
+ *  @param array        items to map.
+ *  @param block        block that maps an item.
+ *  @param chunkBlock   optional block called with mapped chunks, in order of the array, as soon as all previous chunks are mapped (ex. for partial results).
+ *  @param error        error of the first item that failed.
+ *
+ *  @return mapped items in the order of array, nil if an item failed.
+ */
+- (NSArray* _Nullable) mapArray:(NSArray* _Nonnull)array withBlock:(SDServiceParallelMappingBlock _Nonnull)block chunkBlock:(SDServiceParallelChunkBlock _Nullable)chunkBlock error:(NSError* _Nullable * _Nullable)error;
+
+@end
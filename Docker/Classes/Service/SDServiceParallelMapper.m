@@ -0,0 +1,179 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceParallelMapper.h"
+#import "SDServiceMappingExecutor.h"
+
+#define DEFAULT_PARALLEL_MAPPING_THRESHOLD     2000
+#define DEFAULT_PARALLEL_MAPPING_CHUNK_SIZE    500
+
+@implementation SDServiceParallelMapper
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        self.threshold = DEFAULT_PARALLEL_MAPPING_THRESHOLD;
+        self.chunkSize = DEFAULT_PARALLEL_MAPPING_CHUNK_SIZE;
+        self.maximumConcurrency = [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    return self;
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    SDServiceParallelMapper* mapper = [[[self class] allocWithZone:zone] init];
+    mapper.threshold = self.threshold;
+    mapper.chunkSize = self.chunkSize;
+    mapper.maximumConcurrency = self.maximumConcurrency;
+    return mapper;
+}
+
+- (NSArray*) mapArray:(NSArray*)array withBlock:(SDServiceParallelMappingBlock)block chunkBlock:(SDServiceParallelChunkBlock)chunkBlock error:(NSError**)error
+{
+    NSUInteger count = array.count;
+    NSUInteger chunkSize = MAX(self.chunkSize, 1);
+    NSUInteger numberOfChunks = (count + chunkSize - 1) / chunkSize;
+    NSUInteger numberOfWorkers = MIN(MAX(self.maximumConcurrency, 1), numberOfChunks);
+    if (count < self.threshold || numberOfWorkers <= 1)
+    {
+        return [self mapArraySequentially:array withBlock:block chunkBlock:chunkBlock error:error];
+    }
+    
+    // on a worker of a mapping executor, the calling thread is helped only by free workers of the executor
+    SDServiceMappingExecutor* executor = [SDServiceMappingExecutor currentExecutor];
+    NSUInteger acquiredWorkers = 0;
+    if (executor)
+    {
+        acquiredWorkers = [executor acquireFreeWorkers:numberOfWorkers - 1];
+        numberOfWorkers = acquiredWorkers + 1;
+        if (numberOfWorkers <= 1)
+        {
+            return [self mapArraySequentially:array withBlock:block chunkBlock:chunkBlock error:error];
+        }
+    }
+    
+    // every chunk writes only its own slot
+    __strong id* results = (__strong id*)(void*)calloc(numberOfChunks, sizeof(id));
+    __strong NSError** errors = (__strong NSError**)(void*)calloc(numberOfChunks, sizeof(NSError*));
+    
+    NSObject* lock = [NSObject new];
+    __block NSUInteger nextChunk = 0;
+    __block NSUInteger nextChunkToDeliver = 0;
+    __block BOOL failed = NO;
+    
+    dispatch_apply(numberOfWorkers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        while (YES)
+        {
+            NSUInteger chunk;
+            @synchronized (lock)
+            {
+                if (failed || nextChunk == numberOfChunks)
+                {
+                    return;
+                }
+                chunk = nextChunk++;
+            }
+            
+            NSUInteger firstIndex = chunk * chunkSize;
+            NSUInteger length = MIN(chunkSize, count - firstIndex);
+            NSMutableArray* mappedItems = [NSMutableArray arrayWithCapacity:length];
+            NSError* chunkError = nil;
+            @autoreleasepool
+            {
+                for (NSUInteger i = firstIndex; i < firstIndex + length; i++)
+                {
+                    NSError* itemError = nil;
+                    id mappedItem = block(array[i], &itemError);
+                    if (!mappedItem)
+                    {
+                        chunkError = itemError ?: [NSError errorWithDomain:@"PARALLEL_MAPPING" code:-1 userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Cannot map item at index %lu", (unsigned long)i] }];
+                        break;
+                    }
+                    [mappedItems addObject:mappedItem];
+                }
+            }
+            
+            @synchronized (lock)
+            {
+                if (chunkError)
+                {
+                    errors[chunk] = chunkError;
+                    failed = YES;
+                    return;
+                }
+                results[chunk] = mappedItems;
+                // deliver chunks only in order: the worker that completes the sequence delivers it
+                while (chunkBlock && !failed && nextChunkToDeliver < numberOfChunks && results[nextChunkToDeliver])
+                {
+                    chunkBlock(results[nextChunkToDeliver], nextChunkToDeliver * chunkSize);
+                    nextChunkToDeliver++;
+                }
+            }
+        }
+    });
+    [executor releaseWorkers:acquiredWorkers];
+    
+    NSMutableArray* mappedArray = failed ? nil : [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < numberOfChunks; i++)
+    {
+        if (failed && errors[i] && error && !*error)
+        {
+            *error = errors[i];
+        }
+        if (!failed)
+        {
+            [mappedArray addObjectsFromArray:results[i]];
+        }
+        results[i] = nil;
+        errors[i] = nil;
+    }
+    free(results);
+    free(errors);
+    return mappedArray;
+}
+
+- (NSArray*) mapArraySequentially:(NSArray*)array withBlock:(SDServiceParallelMappingBlock)block chunkBlock:(SDServiceParallelChunkBlock)chunkBlock error:(NSError**)error
+{
+    NSUInteger chunkSize = MAX(self.chunkSize, 1);
+    NSUInteger firstIndexToDeliver = 0;
+    NSMutableArray* mappedArray = [NSMutableArray arrayWithCapacity:array.count];
+    for (id item in array)
+    {
+        NSError* itemError = nil;
+        id mappedItem = block(item, &itemError);
+        if (!mappedItem)
+        {
+            if (error)
+            {
+                *error = itemError ?: [NSError errorWithDomain:@"PARALLEL_MAPPING" code:-1 userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Cannot map item at index %lu", (unsigned long)mappedArray.count] }];
+            }
+            return nil;
+        }
+        [mappedArray addObject:mappedItem];
+        if (chunkBlock && mappedArray.count - firstIndexToDeliver == chunkSize)
+        {
+            chunkBlock([mappedArray subarrayWithRange:NSMakeRange(firstIndexToDeliver, chunkSize)], firstIndexToDeliver);
+            firstIndexToDeliver = mappedArray.count;
+        }
+    }
+    if (chunkBlock && mappedArray.count > firstIndexToDeliver)
+    {
+        chunkBlock([mappedArray subarrayWithRange:NSMakeRange(firstIndexToDeliver, mappedArray.count - firstIndexToDeliver)], firstIndexToDeliver);
+    }
+    return mappedArray;
+}
+
+@end
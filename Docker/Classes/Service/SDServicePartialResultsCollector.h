@@ -0,0 +1,51 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Block that receives a chunk of items.
+ *
+ *  @param items      mapped items of the chunk.
+ *  @param firstIndex index in the array response of the first item of the chunk.
+ */
+typedef void (^ SDServicePartialResultsBlock)(NSArray* _Nonnull items, NSUInteger firstIndex);
+
+/**
+ *  Collects the items of an array response while they are mapped and delivers them in chunks, before the mapping of the whole response ends.
+ *
+ *  A chunk is delivered when it reaches chunkSize items or when interval passed since the previous delivery.
+ *  Used by the mapping of a single response: it is not thread safe.
+ */
+@interface SDServicePartialResultsCollector : NSObject
+
+- (instancetype _Nonnull) initWithChunkSize:(NSUInteger)chunkSize interval:(NSTimeInterval)interval block:(SDServicePartialResultsBlock _Nonnull)block;
+
+@property (nonatomic, readonly) NSUInteger chunkSize;
+@property (nonatomic, readonly) NSTimeInterval interval;
+
+/**
+ *  Items added so far.
+ */
+@property (nonatomic, readonly) NSUInteger numberOfItems;
+
+- (void) addItem:(id _Nonnull)item;
+
+/**
+ *  Deliver items not delivered yet. Called when the mapping of the array ends.
+ */
+- (void) flush;
+
+@end
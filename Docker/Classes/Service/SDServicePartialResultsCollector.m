@@ -0,0 +1,66 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#import "SDServicePartialResultsCollector.h"
+
+@interface SDServicePartialResultsCollector ()
+
+@property (nonatomic, strong) SDServicePartialResultsBlock block;
+@property (nonatomic, strong) NSMutableArray* pendingItems;
+@property (nonatomic, assign) CFAbsoluteTime lastDeliveryTime;
+
+@end
+
+@implementation SDServicePartialResultsCollector
+
+- (instancetype) initWithChunkSize:(NSUInteger)chunkSize interval:(NSTimeInterval)interval block:(SDServicePartialResultsBlock)block
+{
+    self = [super init];
+    if (self)
+    {
+        _chunkSize = MAX(chunkSize, 1);
+        _interval = interval;
+        _block = block;
+        _pendingItems = [NSMutableArray arrayWithCapacity:_chunkSize];
+        _lastDeliveryTime = CFAbsoluteTimeGetCurrent();
+    }
+    return self;
+}
+
+- (void) addItem:(id)item
+{
+    [self.pendingItems addObject:item];
+    _numberOfItems++;
+    
+    if (self.pendingItems.count >= self.chunkSize || (self.interval > 0 && CFAbsoluteTimeGetCurrent() - self.lastDeliveryTime >= self.interval))
+    {
+        [self flush];
+    }
+}
+
+- (void) flush
+{
+    self.lastDeliveryTime = CFAbsoluteTimeGetCurrent();
+    if (self.pendingItems.count == 0)
+    {
+        return;
+    }
+    
+    NSArray* items = [self.pendingItems copy];
+    [self.pendingItems removeAllObjects];
+    self.block(items, self.numberOfItems - items.count);
+}
+
+@end
@@ -0,0 +1,139 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import "SDServiceManager.h"
+
+/**
+ *  Subscription to the polling of a service, returned by SDServicePollingScheduler. Keep it to change or remove the subscription.
+ */
+@interface SDServicePollingSubscription : NSObject
+
+@property (nonatomic, strong, readonly) SDServiceGeneric* _Nonnull service;
+@property (nonatomic, strong, readonly) id<SDServiceGenericRequestProtocol> _Nonnull request;
+
+/**
+ *  Interval between polls asked by the subscriber, when responses change.
+ */
+@property (nonatomic, readonly) NSTimeInterval interval;
+
+/**
+ *  Called on main thread with the first response and then only when the response changes.
+ */
+@property (nonatomic, strong, readonly) ServiceCompletionSuccessHandler _Nonnull changeHandler;
+
+/**
+ *  Called on main thread when a poll fails. Polling goes on backing off the interval.
+ */
+@property (nonatomic, strong, readonly) ServiceCompletionFailureHandler _Nullable failureHandler;
+
+/**
+ *  NO once the subscription is removed.
+ */
+@property (nonatomic, readonly) BOOL isActive;
+
+@end
+
+/**
+ *  Polls services on behalf of many subscribers (ex. screens showing the same data), through SDServiceManager.
+ *
+ *  Subscriptions of the same service class with the same method, path, parameters and headers share one poll, at the shortest interval among them.
+ *  Every poll is a conditional call (ETag, Last-Modified or digest of the body): when nothing changed the response is not transferred again nor mapped,
+ *  subscribers are not notified and the interval grows by backoffMultiplier, up to maximumBackoffFactor times the interval. A changed response resets the interval.
+ *  While the app is not active polls are suspended; overdue polls start as soon as the app becomes active again.
+ *
+ *  Must be used from main thread.
+ */
+@interface SDServicePollingScheduler : NSObject
+
+- (instancetype _Nonnull) initWithServiceManager:(SDServiceManager* _Nonnull)serviceManager;
+
+@property (nonatomic, weak, readonly) SDServiceManager* _Nullable serviceManager;
+
+/**
+ *  Multiplier of the interval after every poll with an unchanged response or a failure.
+ *
+ *  Default: 1.5
+ */
+@property (nonatomic, assign) double backoffMultiplier;
+
+/**
+ *  Maximum interval reached by backoff, as a multiple of the interval of the subscriptions.
+ *
+ *  Default: 8
+ */
+@property (nonatomic, assign) double maximumBackoffFactor;
+
+/**
+ *  Priority of poll calls.
+ *
+ *  Default: SDServiceCallPriorityLow
+ */
+@property (nonatomic, assign) SDServiceCallPriority priority;
+
+/**
+ *  Suspend polls while the app is not active.
+ *
+ *  Default: YES
+ */
+@property (nonatomic, assign) BOOL suspendsWhenInactive;
+
+/**
+ *  Start polling a service. The first poll starts immediately, unless an identical subscription already polls it: in this case its last response is delivered to changeHandler.
+ *
+ *  @param service        service to poll.
+ *  @param request        request of polls.
+ *  @param interval       interval between polls while responses change.
+ *  @param changeHandler  called with the first response and then only when the response changes.
+ *  @param failureHandler called when a poll fails (optional).
+ *
+ *  @return subscription, to remove it with unsubscribe:.
+ */
+- (SDServicePollingSubscription* _Nonnull) subscribeToService:(SDServiceGeneric* _Nonnull)service
+                                                   withRequest:(id<SDServiceGenericRequestProtocol> _Nonnull)request
+                                                      interval:(NSTimeInterval)interval
+                                                 changeHandler:(ServiceCompletionSuccessHandler _Nonnull)changeHandler
+                                                failureHandler:(ServiceCompletionFailureHandler _Nullable)failureHandler;
+
+/**
+ *  Stop notifying the subscription. The poll in progress is cancelled if there are no other identical subscriptions.
+ */
+- (void) unsubscribe:(SDServicePollingSubscription* _Nonnull)subscription;
+
+- (void) unsubscribeAll;
+
+/**
+ *  Reset backoff of the subscription and poll immediately, unless a poll is in progress (ex. for pull to refresh).
+ */
+- (void) pollNow:(SDServicePollingSubscription* _Nonnull)subscription;
+
+/**
+ *  Current interval of the poll of the subscription, backoff included (0 if the subscription is not active).
+ */
+- (NSTimeInterval) currentIntervalOfSubscription:(SDServicePollingSubscription* _Nonnull)subscription;
+
+/**
+ *  Number of polls actually scheduled: identical subscriptions count once.
+ */
+@property (nonatomic, readonly) NSUInteger numberOfPolls;
+
+@property (nonatomic, readonly) NSUInteger numberOfSubscriptions;
+
+/**
+ *  Calls sent, and calls answered with an unchanged response, since creation.
+ */
+@property (nonatomic, readonly) NSUInteger numberOfCalls;
+@property (nonatomic, readonly) NSUInteger numberOfUnchangedResponses;
+
+@end
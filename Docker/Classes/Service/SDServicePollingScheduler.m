@@ -0,0 +1,393 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <UIKit/UIKit.h>
+#import "SDServicePollingScheduler.h"
+#import "SOCKit.h"
+#import "NSDictionary+Docker.h"
+
+#define DEFAULT_BACKOFF_MULTIPLIER          1.5
+#define DEFAULT_MAXIMUM_BACKOFF_FACTOR      8.
+
+@interface SDServicePollingSubscription ()
+
+@property (nonatomic, strong, readwrite) SDServiceGeneric* service;
+@property (nonatomic, strong, readwrite) id<SDServiceGenericRequestProtocol> request;
+@property (nonatomic, assign, readwrite) NSTimeInterval interval;
+@property (nonatomic, strong, readwrite) ServiceCompletionSuccessHandler changeHandler;
+@property (nonatomic, strong, readwrite) ServiceCompletionFailureHandler failureHandler;
+@property (nonatomic, assign, readwrite) BOOL isActive;
+
+/**
+ *  Key of the poll shared by identical subscriptions.
+ */
+@property (nonatomic, strong) NSString* pollKey;
+
+@end
+
+@implementation SDServicePollingSubscription
+
+@end
+
+
+/**
+ *  Poll shared by identical subscriptions.
+ */
+@interface SDServicePoll : NSObject
+
+@property (nonatomic, strong) NSString* key;
+@property (nonatomic, strong) SDServiceGeneric* service;
+@property (nonatomic, strong) id<SDServiceGenericRequestProtocol> request;
+@property (nonatomic, strong) NSMutableArray<SDServicePollingSubscription*>* subscriptions;
+
+/**
+ *  Last response delivered to subscribers and its validators.
+ */
+@property (nonatomic, strong) id<SDServiceGenericResponseProtocol> lastResponse;
+@property (nonatomic, strong) NSString* entityTag;
+@property (nonatomic, strong) NSString* lastModified;
+@property (nonatomic, strong) NSString* responseDigest;
+
+/**
+ *  Shortest interval of subscriptions, and interval after backoff.
+ */
+@property (nonatomic, assign) NSTimeInterval interval;
+@property (nonatomic, assign) NSTimeInterval currentInterval;
+
+@property (nonatomic, assign) CFAbsoluteTime nextPollTime;
+
+/**
+ *  Incremented at every scheduling: a scheduled poll with an older value is obsolete.
+ */
+@property (nonatomic, assign) NSUInteger generation;
+
+@property (nonatomic, strong) SDServiceCallInfo* callInfo;
+
+@end
+
+@implementation SDServicePoll
+
+@end
+
+
+@interface SDServicePollingScheduler ()
+
+@property (nonatomic, weak, readwrite) SDServiceManager* serviceManager;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDServicePoll*>* polls;
+@property (nonatomic, assign) BOOL suspended;
+@property (nonatomic, assign, readwrite) NSUInteger numberOfCalls;
+@property (nonatomic, assign, readwrite) NSUInteger numberOfUnchangedResponses;
+
+@end
+
+@implementation SDServicePollingScheduler
+
+- (instancetype) initWithServiceManager:(SDServiceManager*)serviceManager
+{
+    self = [super init];
+    if (self)
+    {
+        _serviceManager = serviceManager;
+        _polls = [NSMutableDictionary dictionary];
+        _backoffMultiplier = DEFAULT_BACKOFF_MULTIPLIER;
+        _maximumBackoffFactor = DEFAULT_MAXIMUM_BACKOFF_FACTOR;
+        _priority = SDServiceCallPriorityLow;
+        _suspendsWhenInactive = YES;
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(applicationWillResignActive) name:UIApplicationWillResignActiveNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(applicationDidBecomeActive) name:UIApplicationDidBecomeActiveNotification object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - Subscriptions
+
+- (SDServicePollingSubscription*) subscribeToService:(SDServiceGeneric*)service withRequest:(id<SDServiceGenericRequestProtocol>)request interval:(NSTimeInterval)interval changeHandler:(ServiceCompletionSuccessHandler)changeHandler failureHandler:(ServiceCompletionFailureHandler)failureHandler
+{
+    SDServicePollingSubscription* subscription = [SDServicePollingSubscription new];
+    subscription.service = service;
+    subscription.request = request;
+    subscription.interval = MAX(interval, 0.);
+    subscription.changeHandler = changeHandler;
+    subscription.failureHandler = failureHandler;
+    subscription.isActive = YES;
+    subscription.pollKey = [self pollKeyForService:service request:request];
+    
+    SDServicePoll* poll = self.polls[subscription.pollKey];
+    if (!poll)
+    {
+        poll = [SDServicePoll new];
+        poll.key = subscription.pollKey;
+        poll.service = service;
+        poll.request = request;
+        poll.subscriptions = [NSMutableArray arrayWithObject:subscription];
+        poll.interval = subscription.interval;
+        poll.currentInterval = subscription.interval;
+        self.polls[poll.key] = poll;
+        
+        SDLogModuleVerbose(kServiceManagerLogModuleName, @"Polling %@ every %.1f seconds", NSStringFromClass([service class]), interval);
+        [self schedulePoll:poll afterDelay:0];
+        return subscription;
+    }
+    
+    SDLogModuleVerbose(kServiceManagerLogModuleName, @"Polling %@: subscription joins an identical poll", NSStringFromClass([service class]));
+    [poll.subscriptions addObject:subscription];
+    if (subscription.interval < poll.interval)
+    {
+        // poll at the shortest interval, sooner if the next poll was further
+        poll.interval = subscription.interval;
+        poll.currentInterval = MIN(poll.currentInterval, poll.interval);
+        if (!poll.callInfo && poll.nextPollTime - CFAbsoluteTimeGetCurrent() > poll.currentInterval)
+        {
+            [self schedulePoll:poll afterDelay:poll.currentInterval];
+        }
+    }
+    
+    id<SDServiceGenericResponseProtocol> lastResponse = poll.lastResponse;
+    if (lastResponse)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (subscription.isActive)
+            {
+                subscription.changeHandler(lastResponse);
+            }
+        });
+    }
+    return subscription;
+}
+
+- (void) unsubscribe:(SDServicePollingSubscription*)subscription
+{
+    if (!subscription.isActive)
+    {
+        return;
+    }
+    subscription.isActive = NO;
+    
+    SDServicePoll* poll = self.polls[subscription.pollKey];
+    [poll.subscriptions removeObject:subscription];
+    if (poll.subscriptions.count > 0)
+    {
+        poll.interval = [[poll.subscriptions valueForKeyPath:@"@min.interval"] doubleValue];
+        return;
+    }
+    
+    [self.polls removeObjectForKey:poll.key];
+    poll.generation++;
+    if (poll.callInfo)
+    {
+        [self.serviceManager cancelServiceCallInfo:poll.callInfo];
+        poll.callInfo = nil;
+    }
+}
+
+- (void) unsubscribeAll
+{
+    for (SDServicePoll* poll in self.polls.allValues)
+    {
+        for (SDServicePollingSubscription* subscription in [poll.subscriptions copy])
+        {
+            [self unsubscribe:subscription];
+        }
+    }
+}
+
+- (void) pollNow:(SDServicePollingSubscription*)subscription
+{
+    SDServicePoll* poll = subscription.isActive ? self.polls[subscription.pollKey] : nil;
+    poll.currentInterval = poll.interval;
+    if (poll && !poll.callInfo)
+    {
+        [self schedulePoll:poll afterDelay:0];
+    }
+}
+
+- (NSTimeInterval) currentIntervalOfSubscription:(SDServicePollingSubscription*)subscription
+{
+    SDServicePoll* poll = subscription.isActive ? self.polls[subscription.pollKey] : nil;
+    return poll.currentInterval;
+}
+
+- (NSUInteger) numberOfPolls
+{
+    return self.polls.count;
+}
+
+- (NSUInteger) numberOfSubscriptions
+{
+    NSUInteger numberOfSubscriptions = 0;
+    for (SDServicePoll* poll in self.polls.allValues)
+    {
+        numberOfSubscriptions += poll.subscriptions.count;
+    }
+    return numberOfSubscriptions;
+}
+
+/**
+ *  Identical calls have the same key: service class, HTTP method, resolved path, parameters and headers.
+ */
+- (NSString*) pollKeyForService:(SDServiceGeneric*)service request:(id<SDServiceGenericRequestProtocol>)request
+{
+    NSError* error = nil;
+    NSDictionary* parameters = [service parametersForRequest:request error:&error];
+    if (error)
+    {
+        // never coalesced: the call will fail with the mapping error
+        return [[NSUUID UUID] UUIDString];
+    }
+    NSString* path = [[SOCPattern cachedPatternWithString:[service pathResource]] percentEncodedStringFromObject:request];
+    NSDictionary* headers = [request respondsToSelector:@selector(additionalRequestHeaders)] ? [request additionalRequestHeaders] : nil;
+    return [NSString stringWithFormat:@"%@ %@ %@ %@ %@", NSStringFromClass([service class]), NSStringFromSDHTTPMethod(service.requestMethodType), path, [parameters canonicalString], [headers canonicalString]];
+}
+
+#pragma mark - Polls
+
+- (void) schedulePoll:(SDServicePoll*)poll afterDelay:(NSTimeInterval)delay
+{
+    NSUInteger generation = ++poll.generation;
+    poll.nextPollTime = CFAbsoluteTimeGetCurrent() + delay;
+    
+    __weak typeof (self) weakself = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        // suspended polls are scheduled again when the app becomes active
+        if (poll.generation == generation && !weakself.suspended && weakself.polls[poll.key] == poll)
+        {
+            [weakself startPoll:poll];
+        }
+    });
+}
+
+- (void) startPoll:(SDServicePoll*)poll
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    if (!serviceManager || poll.callInfo)
+    {
+        return;
+    }
+    
+    SDServiceCallInfo* callInfo = [[SDServiceCallInfo alloc] initWithService:poll.service request:poll.request];
+    callInfo.priority = self.priority;
+    if (poll.lastResponse)
+    {
+        // validators only of a response already delivered
+        callInfo.entityTag = poll.entityTag;
+        callInfo.lastModified = poll.lastModified;
+        callInfo.responseDigest = poll.responseDigest;
+    }
+    
+    __weak typeof (self) weakself = self;
+    __weak SDServiceCallInfo* weakCallInfo = callInfo;
+    callInfo.completionSuccess = ^(id<SDServiceGenericResponseProtocol> response) {
+        [weakself poll:poll didEndCall:weakCallInfo withResponse:response error:nil];
+    };
+    callInfo.notModifiedHandler = ^{
+        [weakself poll:poll didEndCall:weakCallInfo withResponse:nil error:nil];
+    };
+    callInfo.completionFailure = ^(id<SDServiceGenericErrorProtocol> error) {
+        [weakself poll:poll didEndCall:weakCallInfo withResponse:nil error:error];
+    };
+    
+    poll.callInfo = callInfo;
+    self.numberOfCalls++;
+    [serviceManager callServiceWithServiceCallInfo:callInfo];
+}
+
+- (void) poll:(SDServicePoll*)poll didEndCall:(SDServiceCallInfo*)callInfo withResponse:(id<SDServiceGenericResponseProtocol>)response error:(id<SDServiceGenericErrorProtocol>)error
+{
+    if (!callInfo || poll.callInfo != callInfo || self.polls[poll.key] != poll)
+    {
+        return;
+    }
+    poll.callInfo = nil;
+    
+    NSArray<SDServicePollingSubscription*>* subscriptions = [poll.subscriptions copy];
+    if (response)
+    {
+        poll.lastResponse = response;
+        poll.entityTag = callInfo.entityTag;
+        poll.lastModified = callInfo.lastModified;
+        poll.responseDigest = callInfo.responseDigest;
+        poll.currentInterval = poll.interval;
+        for (SDServicePollingSubscription* subscription in subscriptions)
+        {
+            if (subscription.isActive)
+            {
+                subscription.changeHandler(response);
+            }
+        }
+    }
+    else
+    {
+        if (!error)
+        {
+            self.numberOfUnchangedResponses++;
+            poll.entityTag = callInfo.entityTag;
+            poll.lastModified = callInfo.lastModified;
+            poll.responseDigest = callInfo.responseDigest;
+        }
+        else
+        {
+            for (SDServicePollingSubscription* subscription in subscriptions)
+            {
+                if (subscription.isActive && subscription.failureHandler)
+                {
+                    subscription.failureHandler(error);
+                }
+            }
+        }
+        poll.currentInterval = MIN(MAX(poll.currentInterval, poll.interval) * self.backoffMultiplier, poll.interval * MAX(self.maximumBackoffFactor, 1.));
+        SDLogModuleVerbose(kServiceManagerLogModuleName, @"Polling %@: %@, next poll in %.1f seconds", NSStringFromClass([poll.service class]), error ? @"failed" : @"not modified", poll.currentInterval);
+    }
+    
+    // handlers may have removed the last subscription
+    if (self.polls[poll.key] == poll)
+    {
+        [self schedulePoll:poll afterDelay:poll.currentInterval];
+    }
+}
+
+#pragma mark - Application state
+
+- (void) applicationWillResignActive
+{
+    if (self.suspendsWhenInactive)
+    {
+        self.suspended = YES;
+    }
+}
+
+- (void) applicationDidBecomeActive
+{
+    if (!self.suspended)
+    {
+        return;
+    }
+    self.suspended = NO;
+    
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    for (SDServicePoll* poll in self.polls.allValues)
+    {
+        if (!poll.callInfo)
+        {
+            [self schedulePoll:poll afterDelay:MAX(poll.nextPollTime - now, 0.)];
+        }
+    }
+}
+
+@end
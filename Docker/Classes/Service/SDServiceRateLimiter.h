@@ -0,0 +1,130 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+#import "SDServiceGeneric.h"
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceRateLimitErrorDomain;
+
+typedef NS_ENUM (NSInteger, SDServiceRateLimitErrorCode)
+{
+    /**
+     *  Call removed from a full queue to leave room to calls with higher priority.
+     */
+    SDServiceRateLimitErrorCodeShed = -1,
+    /**
+     *  Call waited more than the maximum waiting time.
+     */
+    SDServiceRateLimitErrorCodeWaitExceeded = -2
+};
+
+/**
+ *  Token bucket: calls are allowed at rate per second, with bursts up to burst calls.
+ */
+@interface SDServiceRateLimit : NSObject <NSCopying>
+
++ (instancetype _Nonnull) limitWithRate:(double)rate burst:(NSUInteger)burst;
+
+/**
+ *  Calls per second.
+ */
+@property (nonatomic, assign) double rate;
+
+/**
+ *  Calls allowed at the same time after a quiet period.
+ *
+ *  Default: 1
+ */
+@property (nonatomic, assign) NSUInteger burst;
+
+@end
+
+
+/**
+ *  Client side rate limiting of calls, with token buckets for hosts and for path resources of services.
+ *
+ *  A call waits until all its buckets (host and path resource) have a token: waiting calls are served by priority, then in order of arrival.
+ *  Calls that wait longer than maximumWaitingTime fail, and when more than maximumQueueLength calls wait, calls with lowest priority are shed.
+ *  Retry-After of 429 and 503 responses and RateLimit-Remaining/RateLimit-Reset headers (also with X- prefix) slow down or pause the buckets until the server allows again.
+ *
+ *  Not thread safe: SDServiceManager uses it from main thread.
+ */
+@interface SDServiceRateLimiter : NSObject
+
+/**
+ *  Set limit of all calls to host (ex. "api.example.com"). nil removes the limit.
+ */
+- (void) setLimit:(SDServiceRateLimit* _Nullable)limit forHost:(NSString* _Nonnull)host;
+
+/**
+ *  Set limit of all calls of services with the given pathResource. nil removes the limit.
+ */
+- (void) setLimit:(SDServiceRateLimit* _Nullable)limit forPathResource:(NSString* _Nonnull)pathResource;
+
+/**
+ *  Maximum time a call waits for its tokens.
+ *
+ *  Default: 10 seconds
+ */
+@property (nonatomic, assign) NSTimeInterval maximumWaitingTime;
+
+/**
+ *  Maximum number of waiting calls.
+ *
+ *  Default: 50
+ */
+@property (nonatomic, assign) NSUInteger maximumQueueLength;
+
+/**
+ *  Flag to adapt buckets to Retry-After and rate limit headers of responses. Buckets are created for hosts without a limit, if needed.
+ *
+ *  Default: YES
+ */
+@property (nonatomic, assign) BOOL adaptsToResponseHeaders;
+
+/**
+ *  Current time used for tokens, waiting times and rate limit headers (ex. a manual clock in tests).
+ *  Waiting calls are still checked again after real delays: call processTickets after moving a manual clock.
+ *
+ *  Default: CFAbsoluteTimeGetCurrent
+ */
+@property (nonatomic, copy) CFAbsoluteTime (^ _Nonnull clock)(void);
+
+@property (nonatomic, readonly) NSUInteger numberOfWaitingCalls;
+
+/**
+ *  Wait for a token of host and pathResource buckets. Completion is called once (synchronously if tokens are available), with an error if the call is shed or waits too long.
+ *
+ *  @param maximumWaitingTime maximum waiting time of this call (ex. time left before its deadline). maximumWaitingTime of the rate limiter is used if lower.
+ *
+ *  @return ticket to cancel the wait.
+ */
+- (id _Nonnull) acquireForHost:(NSString* _Nullable)host pathResource:(NSString* _Nullable)pathResource priority:(SDServiceCallPriority)priority maximumWaitingTime:(NSTimeInterval)maximumWaitingTime completion:(void (^ _Nonnull)(NSError* _Nullable error))completion;
+
+/**
+ *  Stop waiting: completion of the ticket is not called.
+ */
+- (void) cancelTicket:(id _Nonnull)ticket;
+
+/**
+ *  Serve waiting calls whose tokens are available and fail the ones waiting too long. Called automatically when limits change and when tokens are expected.
+ */
+- (void) processTickets;
+
+/**
+ *  Adapt buckets of host of the response and of pathResource to its headers (if adaptsToResponseHeaders).
+ */
+- (void) updateWithResponse:(NSHTTPURLResponse* _Nullable)response pathResource:(NSString* _Nullable)pathResource;
+
+@end
@@ -0,0 +1,497 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import "SDServiceRateLimiter.h"
+
+#define DEFAULT_RATE_LIMIT_MAXIMUM_WAITING_TIME    10
+#define DEFAULT_RATE_LIMIT_MAXIMUM_QUEUE_LENGTH    50
+
+NSString* const SDServiceRateLimitErrorDomain = @"RATE_LIMIT";
+
+@implementation SDServiceRateLimit
+
++ (instancetype) limitWithRate:(double)rate burst:(NSUInteger)burst
+{
+    SDServiceRateLimit* limit = [self new];
+    limit.rate = rate;
+    limit.burst = burst;
+    return limit;
+}
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        self.burst = 1;
+    }
+    return self;
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    SDServiceRateLimit* limit = [[[self class] allocWithZone:zone] init];
+    limit.rate = self.rate;
+    limit.burst = self.burst;
+    return limit;
+}
+
+@end
+
+
+
+/**
+ *  Tokens of a host or a path resource.
+ */
+@interface SDServiceTokenBucket : NSObject
+
+/**
+ *  Configured rate (0 for buckets created only to adapt to response headers: no limit, except when adapted).
+ */
+@property (nonatomic, assign) double rate;
+@property (nonatomic, assign) NSUInteger burst;
+@property (nonatomic, assign) double tokens;
+@property (nonatomic, assign) CFAbsoluteTime lastRefillTime;
+
+/**
+ *  No call before this time (Retry-After or exhausted rate limit).
+ */
+@property (nonatomic, assign) CFAbsoluteTime blockedUntil;
+
+/**
+ *  Rate allowed by server until adaptedUntil.
+ */
+@property (nonatomic, assign) double adaptedRate;
+@property (nonatomic, assign) CFAbsoluteTime adaptedUntil;
+
+@end
+
+@implementation SDServiceTokenBucket
+
+- (instancetype) initWithLimit:(SDServiceRateLimit*)limit time:(CFAbsoluteTime)time
+{
+    self = [super init];
+    if (self)
+    {
+        self.lastRefillTime = time;
+        [self updateWithLimit:limit];
+        self.tokens = self.burst;
+    }
+    return self;
+}
+
+- (void) updateWithLimit:(SDServiceRateLimit*)limit
+{
+    self.rate = MAX(limit.rate, 0);
+    self.burst = MAX(limit.burst, 1);
+    self.tokens = MIN(self.tokens, self.burst);
+}
+
+- (double) rateAtTime:(CFAbsoluteTime)time
+{
+    if (time < self.adaptedUntil)
+    {
+        return self.rate > 0 ? MIN(self.rate, self.adaptedRate) : self.adaptedRate;
+    }
+    return self.rate;
+}
+
+- (BOOL) isUnlimitedAtTime:(CFAbsoluteTime)time
+{
+    return self.rate <= 0 && time >= self.adaptedUntil;
+}
+
+- (void) refillAtTime:(CFAbsoluteTime)time
+{
+    double rate = [self rateAtTime:time];
+    self.tokens = MIN(self.tokens + MAX(time - self.lastRefillTime, 0) * rate, self.burst);
+    self.lastRefillTime = time;
+}
+
+- (BOOL) canConsumeAtTime:(CFAbsoluteTime)time
+{
+    if (time < self.blockedUntil)
+    {
+        return NO;
+    }
+    return [self isUnlimitedAtTime:time] || self.tokens >= 1.;
+}
+
+- (void) consumeAtTime:(CFAbsoluteTime)time
+{
+    if (![self isUnlimitedAtTime:time])
+    {
+        self.tokens -= 1.;
+    }
+}
+
+- (NSTimeInterval) timeUntilAvailableAtTime:(CFAbsoluteTime)time
+{
+    NSTimeInterval blockedTime = MAX(self.blockedUntil - time, 0);
+    if ([self isUnlimitedAtTime:time + blockedTime] || self.tokens >= 1.)
+    {
+        return blockedTime;
+    }
+    double rate = [self rateAtTime:time];
+    NSTimeInterval refillTime = rate > 0 ? (1. - self.tokens) / rate : MAX(self.adaptedUntil - time, 0);
+    return MAX(blockedTime, refillTime);
+}
+
+@end
+
+
+
+@interface SDServiceRateLimitTicket : NSObject
+
+@property (nonatomic, strong) NSString* host;
+@property (nonatomic, strong) NSString* pathResource;
+@property (nonatomic, assign) SDServiceCallPriority priority;
+@property (nonatomic, assign) CFAbsoluteTime expirationTime;
+@property (nonatomic, copy) void (^ completion)(NSError* error);
+@property (nonatomic, strong) NSError* error;
+
+@end
+
+@implementation SDServiceRateLimitTicket
+
+@end
+
+
+
+@interface SDServiceRateLimiter ()
+
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDServiceTokenBucket*>* hostBuckets;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDServiceTokenBucket*>* pathResourceBuckets;
+
+/**
+ *  Waiting calls, sorted by priority (highest first) and by arrival.
+ */
+@property (nonatomic, strong) NSMutableArray<SDServiceRateLimitTicket*>* tickets;
+
+@end
+
+@implementation SDServiceRateLimiter
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        self.maximumWaitingTime = DEFAULT_RATE_LIMIT_MAXIMUM_WAITING_TIME;
+        self.maximumQueueLength = DEFAULT_RATE_LIMIT_MAXIMUM_QUEUE_LENGTH;
+        self.adaptsToResponseHeaders = YES;
+        self.clock = ^CFAbsoluteTime {
+            return CFAbsoluteTimeGetCurrent();
+        };
+        self.hostBuckets = [NSMutableDictionary dictionary];
+        self.pathResourceBuckets = [NSMutableDictionary dictionary];
+        self.tickets = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [NSObject cancelPreviousPerformRequestsWithTarget:self];
+}
+
+#pragma mark - Limits
+
+- (void) setLimit:(SDServiceRateLimit*)limit forHost:(NSString*)host
+{
+    [self setLimit:limit forKey:host.lowercaseString inBuckets:self.hostBuckets];
+}
+
+- (void) setLimit:(SDServiceRateLimit*)limit forPathResource:(NSString*)pathResource
+{
+    [self setLimit:limit forKey:pathResource inBuckets:self.pathResourceBuckets];
+}
+
+- (void) setLimit:(SDServiceRateLimit*)limit forKey:(NSString*)key inBuckets:(NSMutableDictionary<NSString*, SDServiceTokenBucket*>*)buckets
+{
+    if (key.length == 0)
+    {
+        return;
+    }
+    if (!limit)
+    {
+        [buckets removeObjectForKey:key];
+    }
+    else if (buckets[key])
+    {
+        [buckets[key] updateWithLimit:limit];
+    }
+    else
+    {
+        buckets[key] = [[SDServiceTokenBucket alloc] initWithLimit:limit time:self.clock()];
+    }
+    [self processTickets];
+}
+
+- (NSArray<SDServiceTokenBucket*>*) bucketsForHost:(NSString*)host pathResource:(NSString*)pathResource
+{
+    NSMutableArray* buckets = [NSMutableArray arrayWithCapacity:2];
+    SDServiceTokenBucket* hostBucket = host ? self.hostBuckets[host] : nil;
+    if (hostBucket)
+    {
+        [buckets addObject:hostBucket];
+    }
+    SDServiceTokenBucket* pathResourceBucket = pathResource ? self.pathResourceBuckets[pathResource] : nil;
+    if (pathResourceBucket)
+    {
+        [buckets addObject:pathResourceBucket];
+    }
+    return buckets;
+}
+
+#pragma mark - Waiting calls
+
+- (NSUInteger) numberOfWaitingCalls
+{
+    return self.tickets.count;
+}
+
+- (id) acquireForHost:(NSString*)host pathResource:(NSString*)pathResource priority:(SDServiceCallPriority)priority maximumWaitingTime:(NSTimeInterval)maximumWaitingTime completion:(void (^)(NSError*))completion
+{
+    SDServiceRateLimitTicket* ticket = [SDServiceRateLimitTicket new];
+    ticket.host = host.lowercaseString;
+    ticket.pathResource = pathResource;
+    ticket.priority = priority;
+    ticket.expirationTime = self.clock() + MAX(MIN(maximumWaitingTime, self.maximumWaitingTime), 0);
+    ticket.completion = completion;
+    
+    // after calls with the same or higher priority
+    NSUInteger index = self.tickets.count;
+    while (index > 0 && self.tickets[index - 1].priority < priority)
+    {
+        index--;
+    }
+    [self.tickets insertObject:ticket atIndex:index];
+    
+    NSMutableArray<SDServiceRateLimitTicket*>* endedTickets = [NSMutableArray array];
+    if (self.tickets.count > self.maximumQueueLength)
+    {
+        // shed the newest call with lowest priority
+        SDServiceRateLimitTicket* shedTicket = self.tickets.lastObject;
+        [self.tickets removeLastObject];
+        shedTicket.error = [NSError errorWithDomain:SDServiceRateLimitErrorDomain code:SDServiceRateLimitErrorCodeShed userInfo:@{ NSLocalizedDescriptionKey : @"Call shed by rate limiter" }];
+        [endedTickets addObject:shedTicket];
+    }
+    
+    [self processTicketsEndingTickets:endedTickets];
+    return ticket;
+}
+
+- (void) cancelTicket:(id)ticket
+{
+    [self.tickets removeObjectIdenticalTo:ticket];
+}
+
+- (void) processTickets
+{
+    [self processTicketsEndingTickets:[NSMutableArray array]];
+}
+
+- (void) processTicketsEndingTickets:(NSMutableArray<SDServiceRateLimitTicket*>*)endedTickets
+{
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(processTickets) object:nil];
+    
+    CFAbsoluteTime now = self.clock();
+    NSMutableSet<SDServiceTokenBucket*>* refilledBuckets = [NSMutableSet set];
+    
+    // a bucket that can't serve a call doesn't serve calls behind it
+    NSMutableSet<SDServiceTokenBucket*>* busyBuckets = [NSMutableSet set];
+    NSTimeInterval nextProcessingDelay = DBL_MAX;
+    
+    for (SDServiceRateLimitTicket* ticket in [self.tickets copy])
+    {
+        NSArray<SDServiceTokenBucket*>* buckets = [self bucketsForHost:ticket.host pathResource:ticket.pathResource];
+        BOOL available = YES;
+        for (SDServiceTokenBucket* bucket in buckets)
+        {
+            if (![refilledBuckets containsObject:bucket])
+            {
+                [bucket refillAtTime:now];
+                [refilledBuckets addObject:bucket];
+            }
+            if ([busyBuckets containsObject:bucket] || ![bucket canConsumeAtTime:now])
+            {
+                available = NO;
+            }
+        }
+        
+        if (available)
+        {
+            for (SDServiceTokenBucket* bucket in buckets)
+            {
+                [bucket consumeAtTime:now];
+            }
+            [self.tickets removeObjectIdenticalTo:ticket];
+            [endedTickets addObject:ticket];
+        }
+        else if (now >= ticket.expirationTime)
+        {
+            [self.tickets removeObjectIdenticalTo:ticket];
+            ticket.error = [NSError errorWithDomain:SDServiceRateLimitErrorDomain code:SDServiceRateLimitErrorCodeWaitExceeded userInfo:@{ NSLocalizedDescriptionKey : @"Call waited too long for rate limit" }];
+            [endedTickets addObject:ticket];
+        }
+        else
+        {
+            nextProcessingDelay = MIN(nextProcessingDelay, ticket.expirationTime - now);
+            for (SDServiceTokenBucket* bucket in buckets)
+            {
+                if (![busyBuckets containsObject:bucket])
+                {
+                    nextProcessingDelay = MIN(nextProcessingDelay, [bucket timeUntilAvailableAtTime:now]);
+                    [busyBuckets addObject:bucket];
+                }
+            }
+        }
+    }
+    
+    if (self.tickets.count > 0)
+    {
+        [self performSelector:@selector(processTickets) withObject:nil afterDelay:MAX(nextProcessingDelay, 0.001)];
+    }
+    
+    // completions at the end: they can start new calls
+    for (SDServiceRateLimitTicket* ticket in endedTickets)
+    {
+        ticket.completion(ticket.error);
+    }
+}
+
+#pragma mark - Response headers
+
+- (void) updateWithResponse:(NSHTTPURLResponse*)response pathResource:(NSString*)pathResource
+{
+    NSString* host = response.URL.host.lowercaseString;
+    if (!self.adaptsToResponseHeaders || !response || host.length == 0)
+    {
+        return;
+    }
+    
+    CFAbsoluteTime now = self.clock();
+    BOOL changed = NO;
+    
+    // server is overloaded or we called too much: pause until Retry-After
+    NSTimeInterval retryAfter = [self retryAfterOfResponse:response atTime:now];
+    if ((response.statusCode == 429 || response.statusCode == 503) && retryAfter > 0)
+    {
+        NSMutableArray<SDServiceTokenBucket*>* buckets = [[self bucketsForHost:host pathResource:pathResource] mutableCopy];
+        if (buckets.count == 0)
+        {
+            [buckets addObject:[self adaptiveBucketForHost:host]];
+        }
+        for (SDServiceTokenBucket* bucket in buckets)
+        {
+            bucket.blockedUntil = MAX(bucket.blockedUntil, now + retryAfter);
+            bucket.tokens = 0;
+        }
+        changed = YES;
+    }
+    
+    // calls left in the current window of server
+    NSString* remainingString = [self valueForHeaders:@[@"RateLimit-Remaining", @"X-RateLimit-Remaining"] inResponse:response];
+    NSString* resetString = [self valueForHeaders:@[@"RateLimit-Reset", @"X-RateLimit-Reset"] inResponse:response];
+    if (remainingString && resetString)
+    {
+        double remaining = remainingString.doubleValue;
+        NSTimeInterval reset = resetString.doubleValue;
+        if (reset > 1000000000.)
+        {
+            // epoch time instead of seconds
+            reset -= now + kCFAbsoluteTimeIntervalSince1970;
+        }
+        if (reset > 0)
+        {
+            SDServiceTokenBucket* bucket = (pathResource ? self.pathResourceBuckets[pathResource] : nil) ? : [self adaptiveBucketForHost:host];
+            [bucket refillAtTime:now];
+            if (remaining < 1.)
+            {
+                bucket.blockedUntil = MAX(bucket.blockedUntil, now + reset);
+                bucket.tokens = 0;
+            }
+            else
+            {
+                bucket.adaptedRate = remaining / reset;
+                bucket.adaptedUntil = now + reset;
+                bucket.tokens = MIN(bucket.tokens, remaining);
+            }
+            changed = YES;
+        }
+    }
+    
+    if (changed && self.tickets.count > 0)
+    {
+        [self processTickets];
+    }
+}
+
+- (SDServiceTokenBucket*) adaptiveBucketForHost:(NSString*)host
+{
+    SDServiceTokenBucket* bucket = self.hostBuckets[host];
+    if (!bucket)
+    {
+        // no limit, except when adapted
+        bucket = [[SDServiceTokenBucket alloc] initWithLimit:[SDServiceRateLimit limitWithRate:0 burst:1] time:self.clock()];
+        self.hostBuckets[host] = bucket;
+    }
+    return bucket;
+}
+
+- (NSString*) valueForHeaders:(NSArray<NSString*>*)headerNames inResponse:(NSHTTPURLResponse*)response
+{
+    for (NSString* key in response.allHeaderFields)
+    {
+        for (NSString* headerName in headerNames)
+        {
+            if ([key caseInsensitiveCompare:headerName] == NSOrderedSame)
+            {
+                return [response.allHeaderFields[key] description];
+            }
+        }
+    }
+    return nil;
+}
+
+- (NSTimeInterval) retryAfterOfResponse:(NSHTTPURLResponse*)response atTime:(CFAbsoluteTime)time
+{
+    NSString* retryAfter = [self valueForHeaders:@[@"Retry-After"] inResponse:response];
+    if (retryAfter.length == 0)
+    {
+        return 0;
+    }
+    
+    NSScanner* scanner = [NSScanner scannerWithString:retryAfter];
+    double seconds = 0;
+    if ([scanner scanDouble:&seconds] && scanner.isAtEnd)
+    {
+        return seconds;
+    }
+    
+    // HTTP date
+    static NSDateFormatter* formatter;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [NSDateFormatter new];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        formatter.dateFormat = @"EEE',' dd MMM yyyy HH':'mm':'ss 'GMT'";
+    });
+    NSDate* date = [formatter dateFromString:retryAfter];
+    return date ? [date timeIntervalSinceReferenceDate] - time : 0;
+}
+
+@end
@@ -0,0 +1,125 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#import <Foundation/Foundation.h>
+
+@class SOCPattern;
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceRouterErrorDomain;
+
+typedef NS_ENUM (NSInteger, SDServiceRouterErrorCode)
+{
+    /**
+     *  Another route matches exactly the same strings (same static segments, parameters in the same places). userInfo contains the pattern of the other route for SDServiceRouterConflictingPatternKey.
+     */
+    SDServiceRouterErrorCodeAmbiguousRoute = -1,
+    /**
+     *  Pattern with more than SDServiceRouterMaximumNumberOfParameters parameters.
+     */
+    SDServiceRouterErrorCodeTooManyParameters = -2,
+};
+
+FOUNDATION_EXPORT NSString* const _Nonnull SDServiceRouterConflictingPatternKey;
+
+#define SDServiceRouterMaximumNumberOfParameters    32
+
+/**
+ *  Route added to a SDServiceRouter.
+ */
+@interface SDServiceRoute : NSObject
+
+@property (nonatomic, strong, readonly) SOCPattern* _Nonnull pattern;
+@property (nonatomic, strong, readonly) NSString* _Nonnull patternString;
+
+/**
+ *  Object associated to the route (ex. a block or a handler object).
+ */
+@property (nonatomic, strong, readonly) id _Nullable handler;
+
+/**
+ *  Names of the parameters of the pattern, in order.
+ */
+@property (nonatomic, strong, readonly) NSArray<NSString*>* _Nonnull parameterNames;
+
+@end
+
+/**
+ *  Result of a match: the route and the values of its parameters.
+ */
+@interface SDServiceRouteMatch : NSObject
+
+@property (nonatomic, strong, readonly) SDServiceRoute* _Nonnull route;
+@property (nonatomic, strong, readonly) NSDictionary<NSString*, NSString*>* _Nonnull parameters;
+
+@end
+
+/**
+ *  Matches strings (deep links, paths of replayed or demo calls...) against many SOCPatterns at once.
+ *
+ *  Patterns are compiled into a single trie of path segments (separated by "/"), so a string is matched segment by segment instead of trying every pattern.
+ *  Parameter values are read from the string only when the match is found, without intermediate arrays.
+ *
+ *  At every segment the static child is tried first, then the children with static text and parameters (in the order routes were added), then the parameter child.
+ *  When the following segments don't match in a branch, matching backtracks to the next branch of the segment: the first complete match in this order wins.
+ *  So when routes overlap in part, the route with a static segment first wins the strings they share (ex. "/x/b" matches "/x/:c" instead of "/:a/b").
+ *  Every node of the trie is visited at most once per match: with routes that don't share the first segments with parameters the time is proportional to the length of the string,
+ *  in the worst case (siblings with parameters at every level that fail only at the last segment) it is proportional to the number of nodes of the trie, as a linear scan of the patterns.
+ *
+ *  Only routes that would match exactly the same strings are refused when they are added.
+ *
+ *  Differently from SOCPattern, a parameter never spans more than a segment: "/files/:name" doesn't match "/files/a/b".
+ *  A segment can mix static text and parameters (ex. ":id.json" or "v:major.:minor"), with the same rules of SOCPattern inside the segment.
+ *
+ *  Routes must be added before matching from more threads: matching is thread safe as long as routes don't change.
+ */
+@interface SDServiceRouter : NSObject
+
+/**
+ *  If YES, query and fragment of matched strings (from the first "?" or "#") are ignored. Default: YES
+ */
+@property (nonatomic, assign) BOOL ignoresQueryAndFragment;
+
+/**
+ *  Routes in the order they were added.
+ */
+@property (nonatomic, strong, readonly) NSArray<SDServiceRoute*>* _Nonnull routes;
+
+/**
+ *  Compile the pattern in the router.
+ *
+ *  @param pattern pattern of the route.
+ *  @param handler object returned with the route when it matches.
+ *  @param error   SDServiceRouterErrorDomain error if the route is ambiguous or has too many parameters.
+ *
+ *  @return the new route, or nil if it was refused.
+ */
+- (SDServiceRoute* _Nullable) addRouteWithPattern:(SOCPattern* _Nonnull)pattern handler:(id _Nullable)handler error:(NSError* _Nullable * _Nullable)error;
+- (SDServiceRoute* _Nullable) addRouteWithPatternString:(NSString* _Nonnull)patternString handler:(id _Nullable)handler error:(NSError* _Nullable * _Nullable)error;
+
+- (void) removeAllRoutes;
+
+/**
+ *  Find the route matching the string.
+ *
+ *  @return route and parameter values, or nil if no route matches.
+ */
+- (SDServiceRouteMatch* _Nullable) matchString:(NSString* _Nonnull)string;
+
+/**
+ *  Same as matchString: but without reading parameter values.
+ */
+- (SDServiceRoute* _Nullable) routeMatchingString:(NSString* _Nonnull)string;
+
+@end
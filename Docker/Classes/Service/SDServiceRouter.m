@@ -0,0 +1,506 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#import "SDServiceRouter.h"
+#import "SOCKit.h"
+
+#define ROUTER_STACK_BUFFER_LENGTH      256
+
+NSString* const SDServiceRouterErrorDomain = @"ROUTER";
+NSString* const SDServiceRouterConflictingPatternKey = @"SDServiceRouterConflictingPattern";
+
+static NSUInteger SDServiceRouterHash(const unichar* characters, NSUInteger length)
+{
+    // FNV-1a on 32 bits: NSNumber of the hash is a tagged pointer, lookups don't allocate
+    uint32_t hash = 2166136261u;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        hash = (hash ^ characters[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#pragma mark - Part
+
+/**
+ *  Static text or parameter of a segment.
+ */
+@interface SDServiceRouterPart : NSObject
+{
+@public
+    NSString* string;
+    BOOL isParameter;
+    unichar* characters;
+    NSUInteger length;
+}
+
+- (instancetype) initWithString:(NSString*)string parameter:(BOOL)parameter;
+
+@end
+
+@implementation SDServiceRouterPart
+
+- (instancetype) initWithString:(NSString*)aString parameter:(BOOL)parameter
+{
+    self = [super init];
+    if (self)
+    {
+        string = [aString copy];
+        isParameter = parameter;
+        length = string.length;
+        characters = malloc(MAX(length, 1) * sizeof(unichar));
+        [string getCharacters:characters range:NSMakeRange(0, length)];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    free(characters);
+}
+
+- (BOOL) isEqualToPart:(SDServiceRouterPart*)part
+{
+    // parameter names don't matter: routes with parameters in the same places match the same strings
+    return isParameter == part->isParameter && (isParameter || [string isEqualToString:part->string]);
+}
+
+@end
+
+#pragma mark - Node
+
+/**
+ *  Node of the trie: a segment of one or more patterns.
+ */
+@interface SDServiceRouterNode : NSObject
+{
+@public
+    // segment matched by the node: a single static part, a single parameter or a mix of both
+    NSArray<SDServiceRouterPart*>* parts;
+    
+    NSMutableDictionary<NSNumber*, NSMutableArray<SDServiceRouterNode*>*>* staticChildren;
+    NSMutableArray<SDServiceRouterNode*>* mixedChildren;
+    SDServiceRouterNode* parameterChild;
+    
+    SDServiceRoute* route;
+}
+
+@end
+
+@implementation SDServiceRouterNode
+
+- (SDServiceRouterNode*) childWithParts:(NSArray<SDServiceRouterPart*>*)childParts
+{
+    SDServiceRouterPart* firstPart = childParts.firstObject;
+    if (childParts.count == 1 && firstPart->isParameter)
+    {
+        if (!parameterChild)
+        {
+            parameterChild = [SDServiceRouterNode new];
+            parameterChild->parts = childParts;
+        }
+        return parameterChild;
+    }
+    
+    NSMutableArray<SDServiceRouterNode*>* candidates = nil;
+    if (childParts.count == 1)
+    {
+        if (!staticChildren)
+        {
+            staticChildren = [NSMutableDictionary dictionary];
+        }
+        NSNumber* hash = @(SDServiceRouterHash(firstPart->characters, firstPart->length));
+        candidates = staticChildren[hash];
+        if (!candidates)
+        {
+            candidates = [NSMutableArray array];
+            staticChildren[hash] = candidates;
+        }
+    }
+    else
+    {
+        if (!mixedChildren)
+        {
+            mixedChildren = [NSMutableArray array];
+        }
+        candidates = mixedChildren;
+    }
+    
+    for (SDServiceRouterNode* candidate in candidates)
+    {
+        if (candidate->parts.count != childParts.count)
+        {
+            continue;
+        }
+        BOOL equal = YES;
+        for (NSUInteger i = 0; i < childParts.count && equal; i++)
+        {
+            equal = [candidate->parts[i] isEqualToPart:childParts[i]];
+        }
+        if (equal)
+        {
+            return candidate;
+        }
+    }
+    
+    SDServiceRouterNode* child = [SDServiceRouterNode new];
+    child->parts = childParts;
+    [candidates addObject:child];
+    return child;
+}
+
+@end
+
+#pragma mark - Matching
+
+static BOOL SDServiceRouterEqualCharacters(const unichar* characters, SDServiceRouterPart* part)
+{
+    return memcmp(characters, part->characters, part->length * sizeof(unichar)) == 0;
+}
+
+/**
+ *  Match the parts of a mixed segment with the same rules of SOCPattern: a parameter goes until the first occurrence of the following static text, or until the end of the segment if it is the last part. Parameters can't be empty.
+ *
+ *  @return number of parameter ranges written, or NSNotFound if the segment doesn't match.
+ */
+static NSUInteger SDServiceRouterMatchParts(NSArray<SDServiceRouterPart*>* parts, const unichar* characters, NSUInteger start, NSUInteger end, NSRange* ranges)
+{
+    NSUInteger location = start;
+    NSUInteger numberOfRanges = 0;
+    NSUInteger numberOfParts = parts.count;
+    for (NSUInteger i = 0; i < numberOfParts; i++)
+    {
+        SDServiceRouterPart* part = parts[i];
+        if (!part->isParameter)
+        {
+            if (location + part->length > end || !SDServiceRouterEqualCharacters(characters + location, part))
+            {
+                return NSNotFound;
+            }
+            location += part->length;
+            continue;
+        }
+        
+        NSUInteger parameterEnd = end;
+        if (i + 1 < numberOfParts)
+        {
+            // parameters are always followed by static text
+            SDServiceRouterPart* nextPart = parts[i + 1];
+            parameterEnd = NSNotFound;
+            for (NSUInteger j = location; j + nextPart->length <= end; j++)
+            {
+                if (SDServiceRouterEqualCharacters(characters + j, nextPart))
+                {
+                    parameterEnd = j;
+                    break;
+                }
+            }
+            if (parameterEnd == NSNotFound)
+            {
+                return NSNotFound;
+            }
+        }
+        if (parameterEnd == location)
+        {
+            return NSNotFound;
+        }
+        ranges[numberOfRanges++] = NSMakeRange(location, parameterEnd - location);
+        location = parameterEnd;
+    }
+    return location == end ? numberOfRanges : NSNotFound;
+}
+
+/**
+ *  Match the segment starting at start, and the following ones, against the children of node.
+ *  Static children are tried first, then mixed ones and the parameter one: other branches are tried only if the deeper segments of a branch don't match.
+ *  A node is always matched against the same segment (segments don't depend on the branch), so every node is visited at most once.
+ */
+static SDServiceRoute* SDServiceRouterMatchNode(SDServiceRouterNode* node, const unichar* characters, NSUInteger start, NSUInteger length, NSRange* ranges, NSUInteger numberOfRanges)
+{
+    NSUInteger end = start;
+    while (end < length && characters[end] != '/')
+    {
+        end++;
+    }
+    BOOL lastSegment = (end == length);
+    SDServiceRoute* route = nil;
+    
+    if (node->staticChildren)
+    {
+        NSArray<SDServiceRouterNode*>* candidates = node->staticChildren[@(SDServiceRouterHash(characters + start, end - start))];
+        for (SDServiceRouterNode* child in candidates)
+        {
+            SDServiceRouterPart* part = child->parts[0];
+            if (part->length == end - start && SDServiceRouterEqualCharacters(characters + start, part))
+            {
+                route = lastSegment ? child->route : SDServiceRouterMatchNode(child, characters, end + 1, length, ranges, numberOfRanges);
+                if (route)
+                {
+                    return route;
+                }
+            }
+        }
+    }
+    
+    for (SDServiceRouterNode* child in node->mixedChildren)
+    {
+        NSUInteger numberOfPartRanges = SDServiceRouterMatchParts(child->parts, characters, start, end, ranges + numberOfRanges);
+        if (numberOfPartRanges != NSNotFound)
+        {
+            route = lastSegment ? child->route : SDServiceRouterMatchNode(child, characters, end + 1, length, ranges, numberOfRanges + numberOfPartRanges);
+            if (route)
+            {
+                return route;
+            }
+        }
+    }
+    
+    if (node->parameterChild && end > start)
+    {
+        ranges[numberOfRanges] = NSMakeRange(start, end - start);
+        route = lastSegment ? node->parameterChild->route : SDServiceRouterMatchNode(node->parameterChild, characters, end + 1, length, ranges, numberOfRanges + 1);
+    }
+    return route;
+}
+
+#pragma mark - Route
+
+@interface SDServiceRoute ()
+
+@property (nonatomic, strong, readwrite) SOCPattern* _Nonnull pattern;
+@property (nonatomic, strong, readwrite) NSString* _Nonnull patternString;
+@property (nonatomic, strong, readwrite) id _Nullable handler;
+@property (nonatomic, strong, readwrite) NSArray<NSString*>* _Nonnull parameterNames;
+
+@end
+
+@implementation SDServiceRoute
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: %p, %@>", NSStringFromClass([self class]), self, self.patternString];
+}
+
+@end
+
+@interface SDServiceRouteMatch ()
+
+@property (nonatomic, strong, readwrite) SDServiceRoute* _Nonnull route;
+@property (nonatomic, strong, readwrite) NSDictionary<NSString*, NSString*>* _Nonnull parameters;
+
+@end
+
+@implementation SDServiceRouteMatch
+
+@end
+
+#pragma mark - Router
+
+@interface SDServiceRouter ()
+
+@property (nonatomic, strong) NSMutableArray<SDServiceRoute*>* mutableRoutes;
+@property (nonatomic, strong) SDServiceRouterNode* root;
+
+@end
+
+@implementation SDServiceRouter
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        _ignoresQueryAndFragment = YES;
+        _mutableRoutes = [NSMutableArray array];
+        _root = [SDServiceRouterNode new];
+    }
+    return self;
+}
+
+- (NSArray<SDServiceRoute*>*) routes
+{
+    return [self.mutableRoutes copy];
+}
+
+#pragma mark Building
+
+/**
+ *  Split the tokens of the pattern in segments of parts. Adjacent static texts are joined.
+ */
+- (NSArray<NSArray<SDServiceRouterPart*>*>*) segmentsOfPattern:(SOCPattern*)pattern parameterNames:(NSMutableArray<NSString*>*)parameterNames
+{
+    NSMutableArray<NSArray<SDServiceRouterPart*>*>* segments = [NSMutableArray array];
+    NSMutableArray<SDServiceRouterPart*>* currentParts = [NSMutableArray array];
+    NSMutableString* currentText = [NSMutableString string];
+    
+    void (^ closeText)(void) = ^{
+        if (currentText.length > 0)
+        {
+            [currentParts addObject:[[SDServiceRouterPart alloc] initWithString:currentText parameter:NO]];
+            [currentText setString:@""];
+        }
+    };
+    void (^ closeSegment)(void) = ^{
+        closeText();
+        if (currentParts.count == 0)
+        {
+            // empty segment (ex. before the leading "/")
+            [currentParts addObject:[[SDServiceRouterPart alloc] initWithString:@"" parameter:NO]];
+        }
+        [segments addObject:[currentParts copy]];
+        [currentParts removeAllObjects];
+    };
+    
+    [pattern enumerateTokensUsingBlock:^(NSString* staticText, NSString* parameterName) {
+        if (parameterName)
+        {
+            closeText();
+            [currentParts addObject:[[SDServiceRouterPart alloc] initWithString:parameterName parameter:YES]];
+            [parameterNames addObject:parameterName];
+            return;
+        }
+        NSArray<NSString*>* components = [staticText componentsSeparatedByString:@"/"];
+        for (NSUInteger i = 0; i < components.count; i++)
+        {
+            if (i > 0)
+            {
+                closeSegment();
+            }
+            [currentText appendString:components[i]];
+        }
+    }];
+    closeSegment();
+    return segments;
+}
+
+- (SDServiceRoute*) addRouteWithPattern:(SOCPattern*)pattern handler:(id)handler error:(NSError**)error
+{
+    NSMutableArray<NSString*>* parameterNames = [NSMutableArray array];
+    NSArray<NSArray<SDServiceRouterPart*>*>* segments = [self segmentsOfPattern:pattern parameterNames:parameterNames];
+    NSString* patternString = pattern.patternString ? : @"";
+    
+    if (parameterNames.count > SDServiceRouterMaximumNumberOfParameters)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:SDServiceRouterErrorDomain code:SDServiceRouterErrorCodeTooManyParameters userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Route %@ has more than %d parameters", patternString, SDServiceRouterMaximumNumberOfParameters] }];
+        }
+        return nil;
+    }
+    
+    SDServiceRouterNode* node = self.root;
+    for (NSArray<SDServiceRouterPart*>* parts in segments)
+    {
+        node = [node childWithParts:parts];
+    }
+    
+    if (node->route)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:SDServiceRouterErrorDomain code:SDServiceRouterErrorCodeAmbiguousRoute userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Route %@ is ambiguous with route %@", patternString, node->route.patternString], SDServiceRouterConflictingPatternKey : node->route.patternString }];
+        }
+        return nil;
+    }
+    
+    SDServiceRoute* route = [SDServiceRoute new];
+    route.pattern = pattern;
+    route.patternString = patternString;
+    route.handler = handler;
+    route.parameterNames = [parameterNames copy];
+    node->route = route;
+    [self.mutableRoutes addObject:route];
+    return route;
+}
+
+- (SDServiceRoute*) addRouteWithPatternString:(NSString*)patternString handler:(id)handler error:(NSError**)error
+{
+    return [self addRouteWithPattern:[SOCPattern patternWithString:patternString] handler:handler error:error];
+}
+
+- (void) removeAllRoutes
+{
+    [self.mutableRoutes removeAllObjects];
+    self.root = [SDServiceRouterNode new];
+}
+
+#pragma mark Matching
+
+- (SDServiceRoute*) routeMatchingString:(NSString*)string ranges:(NSRange*)ranges
+{
+    NSUInteger length = string.length;
+    unichar stackBuffer[ROUTER_STACK_BUFFER_LENGTH];
+    unichar* heapBuffer = NULL;
+    const unichar* characters = CFStringGetCharactersPtr((__bridge CFStringRef)string);
+    if (!characters)
+    {
+        unichar* buffer = stackBuffer;
+        if (length > ROUTER_STACK_BUFFER_LENGTH)
+        {
+            heapBuffer = malloc(length * sizeof(unichar));
+            buffer = heapBuffer;
+        }
+        [string getCharacters:buffer range:NSMakeRange(0, length)];
+        characters = buffer;
+    }
+    
+    if (self.ignoresQueryAndFragment)
+    {
+        for (NSUInteger i = 0; i < length; i++)
+        {
+            if (characters[i] == '?' || characters[i] == '#')
+            {
+                length = i;
+                break;
+            }
+        }
+    }
+    
+    SDServiceRoute* route = SDServiceRouterMatchNode(self.root, characters, 0, length, ranges, 0);
+    free(heapBuffer);
+    return route;
+}
+
+- (SDServiceRoute*) routeMatchingString:(NSString*)string
+{
+    NSRange ranges[SDServiceRouterMaximumNumberOfParameters];
+    return [self routeMatchingString:string ranges:ranges];
+}
+
+- (SDServiceRouteMatch*) matchString:(NSString*)string
+{
+    NSRange ranges[SDServiceRouterMaximumNumberOfParameters];
+    SDServiceRoute* route = [self routeMatchingString:string ranges:ranges];
+    if (!route)
+    {
+        return nil;
+    }
+    
+    NSUInteger numberOfParameters = route.parameterNames.count;
+    __strong id keys[SDServiceRouterMaximumNumberOfParameters];
+    __strong id values[SDServiceRouterMaximumNumberOfParameters];
+    for (NSUInteger i = 0; i < numberOfParameters; i++)
+    {
+        keys[i] = route.parameterNames[i];
+        values[i] = [string substringWithRange:ranges[i]];
+    }
+    
+    SDServiceRouteMatch* match = [SDServiceRouteMatch new];
+    match.route = route;
+    match.parameters = [NSDictionary dictionaryWithObjects:values forKeys:keys count:numberOfParameters];
+    return match;
+}
+
+@end
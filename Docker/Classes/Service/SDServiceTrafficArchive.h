@@ -0,0 +1,107 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  A single service call captured by SDServiceManager in record mode: request, response and timing.
+ */
+@interface SDServiceTrafficRecord : NSObject
+
+/**
+ *  Key used to match the call in replay mode. See SDServiceTrafficArchive keyForHTTPMethod:path:parameters:
+ */
+@property (nonatomic, strong) NSString* _Nonnull key;
+
+@property (nonatomic, strong) NSString* _Nullable HTTPMethod;
+@property (nonatomic, strong) NSString* _Nullable URLString;
+@property (nonatomic, strong) NSDictionary<NSString*, NSString*>* _Nullable requestHeaders;
+@property (nonatomic, strong) NSData* _Nullable requestBody;
+
+@property (nonatomic, assign) NSInteger statusCode;
+@property (nonatomic, strong) NSDictionary<NSString*, NSString*>* _Nullable responseHeaders;
+@property (nonatomic, strong) NSData* _Nullable responseBody;
+
+/**
+ *  Time (in seconds) between the start of the call and the response.
+ */
+@property (nonatomic, assign) NSTimeInterval duration;
+
+/**
+ *  Date of record.
+ */
+@property (nonatomic, strong) NSDate* _Nullable date;
+
+/**
+ *  Build an HTTP response with url, status code and headers of the record.
+ */
+- (NSHTTPURLResponse* _Nullable) HTTPURLResponse;
+
+@end
+
+
+/**
+ *  On-disk archive of SDServiceTrafficRecord.
+ *
+ *  Records are appended to a single binary file (each one is a length-prefixed binary plist), so recording costs one write per call.
+ *  An index of the offsets by key is kept in memory and persisted with synchronize, so lookup doesn't depend by the size of the archive.
+ *  If the index on disk is missing or older than the records file, it's rebuilt scanning only the records not indexed yet.
+ *
+ *  If the same key is recorded more times, the last record wins.
+ */
+@interface SDServiceTrafficArchive : NSObject
+
+/**
+ *  Open (or create) the archive in the given directory.
+ */
+- (instancetype _Nonnull) initWithDirectoryPath:(NSString* _Nonnull)directoryPath;
+
+@property (nonatomic, strong, readonly) NSString* _Nonnull directoryPath;
+
+/**
+ *  Number of distinct keys in archive.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ *  Append the record to the archive. Thread safe.
+ */
+- (void) addRecord:(SDServiceTrafficRecord* _Nonnull)record;
+
+/**
+ *  Return the last record for the key or nil if there isn't any. Thread safe.
+ */
+- (SDServiceTrafficRecord* _Nullable) recordForKey:(NSString* _Nonnull)key;
+
+/**
+ *  All keys in archive.
+ */
+- (NSArray<NSString*>* _Nonnull) allKeys;
+
+/**
+ *  Persist the index on disk. Called automatically when app resigns active.
+ */
+- (void) synchronize;
+
+/**
+ *  Delete all records.
+ */
+- (void) removeAllRecords;
+
+/**
+ *  Key that identifies a call: HTTP method, resolved path and parameters normalized (independent by the order of keys).
+ */
++ (NSString* _Nonnull) keyForHTTPMethod:(NSString* _Nonnull)method path:(NSString* _Nullable)path parameters:(NSDictionary* _Nullable)parameters;
+
+@end
@@ -0,0 +1,338 @@
+// Copyright 2017 Sysdata S.p.A.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#import <UIKit/UIKit.h>
+#import "SDServiceTrafficArchive.h"
+#import "SDDockerLogger.h"
+#import "NSDictionary+Docker.h"
+#import "NSString+Docker.h"
+
+#define TrafficArchiveQueueName                "com.sysdata.SDServiceTrafficArchive"
+
+#define TRAFFIC_ARCHIVE_RECORDS_FILE           @"records.bin"
+#define TRAFFIC_ARCHIVE_INDEX_FILE             @"index.plist"
+
+#define TRAFFIC_INDEX_INDEXED_LENGTH           @"indexedLength"
+#define TRAFFIC_INDEX_OFFSETS                  @"offsets"
+
+#define TRAFFIC_RECORD_KEY                     @"key"
+#define TRAFFIC_RECORD_METHOD                  @"method"
+#define TRAFFIC_RECORD_URL                     @"url"
+#define TRAFFIC_RECORD_REQUEST_HEADERS         @"requestHeaders"
+#define TRAFFIC_RECORD_REQUEST_BODY            @"requestBody"
+#define TRAFFIC_RECORD_STATUS_CODE             @"statusCode"
+#define TRAFFIC_RECORD_RESPONSE_HEADERS        @"responseHeaders"
+#define TRAFFIC_RECORD_RESPONSE_BODY           @"responseBody"
+#define TRAFFIC_RECORD_DURATION                @"duration"
+#define TRAFFIC_RECORD_DATE                    @"date"
+
+// size of the length prefix of each record
+#define TRAFFIC_RECORD_HEADER_SIZE             sizeof(uint32_t)
+
+@implementation SDServiceTrafficRecord
+
+- (instancetype) initWithDictionary:(NSDictionary*)dictionary
+{
+    self = [super init];
+    if (self)
+    {
+        self.key = dictionary[TRAFFIC_RECORD_KEY];
+        self.HTTPMethod = dictionary[TRAFFIC_RECORD_METHOD];
+        self.URLString = dictionary[TRAFFIC_RECORD_URL];
+        self.requestHeaders = dictionary[TRAFFIC_RECORD_REQUEST_HEADERS];
+        self.requestBody = dictionary[TRAFFIC_RECORD_REQUEST_BODY];
+        self.statusCode = [dictionary[TRAFFIC_RECORD_STATUS_CODE] integerValue];
+        self.responseHeaders = dictionary[TRAFFIC_RECORD_RESPONSE_HEADERS];
+        self.responseBody = dictionary[TRAFFIC_RECORD_RESPONSE_BODY];
+        self.duration = [dictionary[TRAFFIC_RECORD_DURATION] doubleValue];
+        self.date = dictionary[TRAFFIC_RECORD_DATE];
+    }
+    return self;
+}
+
+- (NSDictionary*) dictionaryRepresentation
+{
+    NSMutableDictionary* dictionary = [NSMutableDictionary dictionaryWithCapacity:10];
+    [dictionary setValue:self.key forKey:TRAFFIC_RECORD_KEY];
+    [dictionary setValue:self.HTTPMethod forKey:TRAFFIC_RECORD_METHOD];
+    [dictionary setValue:self.URLString forKey:TRAFFIC_RECORD_URL];
+    [dictionary setValue:self.requestHeaders forKey:TRAFFIC_RECORD_REQUEST_HEADERS];
+    [dictionary setValue:self.requestBody forKey:TRAFFIC_RECORD_REQUEST_BODY];
+    [dictionary setValue:@(self.statusCode) forKey:TRAFFIC_RECORD_STATUS_CODE];
+    [dictionary setValue:self.responseHeaders forKey:TRAFFIC_RECORD_RESPONSE_HEADERS];
+    [dictionary setValue:self.responseBody forKey:TRAFFIC_RECORD_RESPONSE_BODY];
+    [dictionary setValue:@(self.duration) forKey:TRAFFIC_RECORD_DURATION];
+    [dictionary setValue:self.date forKey:TRAFFIC_RECORD_DATE];
+    return dictionary;
+}
+
+- (NSHTTPURLResponse*) HTTPURLResponse
+{
+    NSURL* url = self.URLString ? [NSURL URLWithString:self.URLString] : nil;
+    if (!url)
+    {
+        return nil;
+    }
+    return [[NSHTTPURLResponse alloc] initWithURL:url statusCode:self.statusCode HTTPVersion:@"HTTP/1.1" headerFields:self.responseHeaders];
+}
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: %@ %@ -> %d (%.0f ms)>", NSStringFromClass([self class]), self.HTTPMethod, self.URLString, (int)self.statusCode, self.duration * 1000.];
+}
+
+@end
+
+
+
+@interface SDServiceTrafficArchive ()
+{
+    dispatch_queue_t archiveQueue;
+}
+
+@property (nonatomic, strong, readwrite) NSString* directoryPath;
+@property (nonatomic, strong) NSString* recordsPath;
+@property (nonatomic, strong) NSString* indexPath;
+
+@property (nonatomic, strong) NSFileHandle* recordsFileHandle;
+@property (nonatomic, assign) unsigned long long recordsLength;
+
+// key -> [offset, length] of the last record for the key
+@property (nonatomic, strong) NSMutableDictionary<NSString*, NSArray<NSNumber*>*>* offsets;
+@property (nonatomic, assign) BOOL indexChanged;
+
+@end
+
+@implementation SDServiceTrafficArchive
+
+- (instancetype) initWithDirectoryPath:(NSString*)directoryPath
+{
+    self = [super init];
+    if (self)
+    {
+        self.directoryPath = directoryPath;
+        self.recordsPath = [directoryPath stringByAppendingPathComponent:TRAFFIC_ARCHIVE_RECORDS_FILE];
+        self.indexPath = [directoryPath stringByAppendingPathComponent:TRAFFIC_ARCHIVE_INDEX_FILE];
+        
+        archiveQueue = dispatch_queue_create(TrafficArchiveQueueName, DISPATCH_QUEUE_SERIAL);
+        
+        [[NSFileManager defaultManager] createDirectoryAtPath:directoryPath withIntermediateDirectories:YES attributes:nil error:NULL];
+        if (![[NSFileManager defaultManager] fileExistsAtPath:self.recordsPath])
+        {
+            [[NSFileManager defaultManager] createFileAtPath:self.recordsPath contents:nil attributes:nil];
+        }
+        self.recordsFileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.recordsPath];
+        self.recordsLength = [self.recordsFileHandle seekToEndOfFile];
+        
+        [self loadIndex];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(synchronize) name:UIApplicationWillResignActiveNotification object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self writeIndex];
+    [self.recordsFileHandle closeFile];
+}
+
+#pragma mark - Index
+
+- (void) loadIndex
+{
+    NSDictionary* index = [NSDictionary dictionaryWithContentsOfFile:self.indexPath];
+    unsigned long long indexedLength = [index[TRAFFIC_INDEX_INDEXED_LENGTH] unsignedLongLongValue];
+    
+    if (index && indexedLength <= self.recordsLength)
+    {
+        self.offsets = [index[TRAFFIC_INDEX_OFFSETS] mutableCopy];
+    }
+    else
+    {
+        indexedLength = 0;
+    }
+    
+    if (!self.offsets)
+    {
+        self.offsets = [NSMutableDictionary new];
+    }
+    
+    if (indexedLength < self.recordsLength)
+    {
+        // records appended after the last synchronize (ex. app killed): index only them
+        SDLogModuleInfo(kServiceManagerLogModuleName, @"Traffic archive %@: rebuilding index from offset %llu", self.directoryPath, indexedLength);
+        [self indexRecordsFromOffset:indexedLength];
+        self.indexChanged = YES;
+    }
+}
+
+- (void) indexRecordsFromOffset:(unsigned long long)offset
+{
+    while (offset + TRAFFIC_RECORD_HEADER_SIZE <= self.recordsLength)
+    {
+        [self.recordsFileHandle seekToFileOffset:offset];
+        NSData* header = [self.recordsFileHandle readDataOfLength:TRAFFIC_RECORD_HEADER_SIZE];
+        if (header.length < TRAFFIC_RECORD_HEADER_SIZE)
+        {
+            break;
+        }
+        uint32_t length = CFSwapInt32BigToHost(*(const uint32_t*)header.bytes);
+        unsigned long long recordOffset = offset + TRAFFIC_RECORD_HEADER_SIZE;
+        if (recordOffset + length > self.recordsLength)
+        {
+            // truncated record: it will be overwritten by the next one
+            SDLogModuleWarning(kServiceManagerLogModuleName, @"Traffic archive %@: truncated record at offset %llu", self.directoryPath, offset);
+            self.recordsLength = offset;
+            [self.recordsFileHandle truncateFileAtOffset:offset];
+            break;
+        }
+        
+        NSDictionary* dictionary = [self dictionaryAtOffset:recordOffset length:length];
+        NSString* key = dictionary[TRAFFIC_RECORD_KEY];
+        if (key)
+        {
+            self.offsets[key] = @[@(recordOffset), @(length)];
+        }
+        offset = recordOffset + length;
+    }
+}
+
+- (void) writeIndex
+{
+    if (!self.indexChanged)
+    {
+        return;
+    }
+    NSDictionary* index = @{
+                            TRAFFIC_INDEX_INDEXED_LENGTH : @(self.recordsLength),
+                            TRAFFIC_INDEX_OFFSETS : [self.offsets copy]
+                            };
+    [self.recordsFileHandle synchronizeFile];
+    if ([index writeToFile:self.indexPath atomically:YES])
+    {
+        self.indexChanged = NO;
+    }
+    else
+    {
+        SDLogModuleError(kServiceManagerLogModuleName, @"Traffic archive %@: can't write index", self.directoryPath);
+    }
+}
+
+- (NSDictionary*) dictionaryAtOffset:(unsigned long long)offset length:(NSUInteger)length
+{
+    [self.recordsFileHandle seekToFileOffset:offset];
+    NSData* data = [self.recordsFileHandle readDataOfLength:length];
+    if (data.length != length)
+    {
+        return nil;
+    }
+    NSDictionary* dictionary = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL];
+    return [dictionary isKindOfClass:[NSDictionary class]] ? dictionary : nil;
+}
+
+#pragma mark - Public methods
+
+- (NSUInteger) count
+{
+    __block NSUInteger count = 0;
+    dispatch_sync(archiveQueue, ^{
+        count = self.offsets.count;
+    });
+    return count;
+}
+
+- (NSArray<NSString*>*) allKeys
+{
+    __block NSArray* keys = nil;
+    dispatch_sync(archiveQueue, ^{
+        keys = self.offsets.allKeys;
+    });
+    return keys;
+}
+
+- (void) addRecord:(SDServiceTrafficRecord*)record
+{
+    if (record.key.length == 0)
+    {
+        return;
+    }
+    
+    NSDictionary* dictionary = [record dictionaryRepresentation];
+    dispatch_async(archiveQueue, ^{
+        NSError* error = nil;
+        NSData* data = [NSPropertyListSerialization dataWithPropertyList:dictionary format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+        if (!data)
+        {
+            SDLogModuleError(kServiceManagerLogModuleName, @"Traffic archive %@: can't serialize record %@: %@", self.directoryPath, record, error);
+            return;
+        }
+        
+        uint32_t header = CFSwapInt32HostToBig((uint32_t)data.length);
+        [self.recordsFileHandle seekToFileOffset:self.recordsLength];
+        [self.recordsFileHandle writeData:[NSData dataWithBytes:&header length:TRAFFIC_RECORD_HEADER_SIZE]];
+        [self.recordsFileHandle writeData:data];
+        
+        unsigned long long recordOffset = self.recordsLength + TRAFFIC_RECORD_HEADER_SIZE;
+        self.offsets[record.key] = @[@(recordOffset), @(data.length)];
+        self.recordsLength = recordOffset + data.length;
+        self.indexChanged = YES;
+    });
+}
+
+- (SDServiceTrafficRecord*) recordForKey:(NSString*)key
+{
+    __block SDServiceTrafficRecord* record = nil;
+    dispatch_sync(archiveQueue, ^{
+        NSArray<NSNumber*>* location = self.offsets[key];
+        if (location.count == 2)
+        {
+            NSDictionary* dictionary = [self dictionaryAtOffset:location[0].unsignedLongLongValue length:location[1].unsignedIntegerValue];
+            if (dictionary)
+            {
+                record = [[SDServiceTrafficRecord alloc] initWithDictionary:dictionary];
+            }
+        }
+    });
+    return record;
+}
+
+- (void) synchronize
+{
+    dispatch_async(archiveQueue, ^{
+        [self writeIndex];
+    });
+}
+
+- (void) removeAllRecords
+{
+    dispatch_async(archiveQueue, ^{
+        [self.recordsFileHandle truncateFileAtOffset:0];
+        self.recordsLength = 0;
+        [self.offsets removeAllObjects];
+        self.indexChanged = YES;
+        [self writeIndex];
+    });
+}
+
+#pragma mark - Key
+
++ (NSString*) keyForHTTPMethod:(NSString*)method path:(NSString*)path parameters:(NSDictionary*)parameters
+{
+    NSString* normalizedParameters = parameters.count > 0 ? [[parameters canonicalString] MD5String] : @"-";
+    return [NSString stringWithFormat:@"%@ %@ %@", method.uppercaseString, path ? : @"", normalizedParameters];
+}
+
+@end
@@ -102,6 +102,8 @@
   NSString* _patternString;
   NSArray* _tokens;
   NSArray* _parameters;
+  NSArray* _encodedTokens;
+  NSMapTable* _accessorsByClass;
 }
 
 /**
@@ -112,6 +114,19 @@
 - (id)initWithString:(NSString *)string;
 + (id)patternWithString:(NSString *)string;
 
+/**
+ * The string the pattern was created with.
+ */
+- (NSString *)patternString;
+
+/**
+ * Returns a compiled pattern for the given string, shared by all callers with the same string.
+ *
+ * Patterns are immutable once compiled, so the cache avoids compiling the same pattern at every
+ * use (ex. the path of a service at every call). Thread safe.
+ */
++ (id)cachedPatternWithString:(NSString *)string;
+
 /**
  * Returns YES if the given string can be used with performSelector:onObject:sourceString: or
  * extractParameterKeyValuesFromSourceString:.
@@ -201,6 +216,36 @@
  */
 - (NSString *)stringFromObject:(id)object withBlock:(NSString*(^)(NSString*))block;
 
+/**
+ * Returns a string with the parameters of this pattern replaced by the percent encoded values of
+ * the receiving object, for use as URL path.
+ *
+ * Values are the same of stringFromObject:. Characters not allowed in a URL path are percent
+ * encoded. "/" is kept, so values can contain sub paths, and "%" is kept only when it starts a
+ * valid escape ("%2F" stays as is, "50%" becomes "50%25"), so already encoded text is not
+ * encoded twice.
+ *
+ * Parameters that are simple property names (no key path) are read by calling the getter
+ * directly: getters are looked up once for each class of object. The string is built in a
+ * single pass over the tokens, encoding values while they are written.
+ *
+ *      @param object  The object whose properties will be used to replace the parameters in
+ *                     the pattern.
+ *      @returns A string with the pattern parameters replaced by the encoded property values.
+ *      @see stringFromObject:
+ */
+- (NSString *)percentEncodedStringFromObject:(id)object;
+
+/**
+ * Enumerates the tokens of the pattern in order.
+ *
+ * Static tokens are passed with escaped characters already replaced (staticText), parameters
+ * with their name (parameterName). Exactly one of the two is non-nil at every call.
+ *
+ * Used to compile patterns into other structures (ex. the trie of SDServiceRouter).
+ */
+- (void)enumerateTokensUsingBlock:(void (^)(NSString *staticText, NSString *parameterName))block;
+
 @end
 
 /**
@@ -43,6 +43,37 @@ NSString* kTemporaryBackslashToken = @"/backslash/";
 
 @end
 
+/**
+ * Output of percentEncodedStringFromObject:, on the stack until it grows beyond stackBytes.
+ */
+typedef struct {
+  char* bytes;
+  size_t length;
+  size_t capacity;
+  char stackBytes[256];
+} SOCBuffer;
+
+static void SOCBufferInit(SOCBuffer* buffer);
+static void SOCBufferAppend(SOCBuffer* buffer, const void* bytes, size_t length, BOOL percentEncoding);
+static void SOCBufferFree(SOCBuffer* buffer);
+
+/**
+ * Reads the value of a parameter from objects of a class, calling the getter directly when the
+ * parameter is a plain property name.
+ */
+@interface SOCParameterAccessor : NSObject {
+  NSString* _keyPath;
+  SEL _selector;
+  IMP _imp;
+  char _returnType;
+}
+
++ (instancetype)accessorForKeyPath:(NSString *)keyPath ofClass:(Class)class;
+
+- (void)appendValueOfObject:(id)object toBuffer:(SOCBuffer *)buffer;
+
+@end
+
 @implementation SOCPattern
 
 - (id)initWithString:(NSString *)string {
@@ -58,12 +89,37 @@ NSString* kTemporaryBackslashToken = @"/backslash/";
   return [[self alloc] initWithString:string];
 }
 
++ (id)cachedPatternWithString:(NSString *)string {
+  static NSCache* cache = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    cache = [[NSCache alloc] init];
+    cache.countLimit = 256;
+  });
+
+  if (nil == string) {
+    return nil;
+  }
+  SOCPattern* pattern = [cache objectForKey:string];
+  if (nil == pattern) {
+    string = [string copy];
+    pattern = [[self alloc] initWithString:string];
+    [cache setObject:pattern forKey:string];
+  }
+  return pattern;
+}
+
+- (NSString *)patternString {
+  return _patternString;
+}
+
 - (id)copyWithZone:(NSZone *)zone {
   SOCPattern* copy = [[[self class] alloc] init];
 
   copy->_patternString = [_patternString copy];
   copy->_tokens = [_tokens copy];
   copy->_parameters = [_parameters copy];
+  copy->_encodedTokens = [_encodedTokens copy];
 
   return copy;
 }
@@ -162,6 +218,17 @@ NSString* kTemporaryBackslashToken = @"/backslash/";
   if ([parameters count] > 0) {
     _parameters = [parameters copy];
   }
+
+  // UTF-8 of static tokens, ready to be copied by percentEncodedStringFromObject:.
+  NSMutableArray* encodedTokens = [[NSMutableArray alloc] initWithCapacity:[_tokens count]];
+  for (id token in _tokens) {
+    if ([token isKindOfClass:[NSString class]]) {
+      [encodedTokens addObject:[[self _stringFromEscapedToken:token] dataUsingEncoding:NSUTF8StringEncoding]];
+    } else {
+      [encodedTokens addObject:token];
+    }
+  }
+  _encodedTokens = [encodedTokens copy];
 }
 
 - (NSString *)_stringFromEscapedToken:(NSString *)token {
@@ -422,6 +489,225 @@ NSString* kTemporaryBackslashToken = @"/backslash/";
   return [self _stringWithParameterValues:parameterValues];
 }
 
+#pragma mark - Percent Encoded Strings
+
+- (NSArray *)_accessorsForClass:(Class)class {
+  @synchronized (self) {
+    if (nil == _accessorsByClass) {
+      _accessorsByClass = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+                                                valueOptions:NSPointerFunctionsStrongMemory];
+    }
+    NSArray* accessors = [_accessorsByClass objectForKey:class];
+    if (nil == accessors) {
+      NSMutableArray* newAccessors = [[NSMutableArray alloc] initWithCapacity:[_parameters count]];
+      for (SOCParameter* parameter in _parameters) {
+        [newAccessors addObject:[SOCParameterAccessor accessorForKeyPath:parameter.string ofClass:class]];
+      }
+      accessors = [newAccessors copy];
+      [_accessorsByClass setObject:accessors forKey:class];
+    }
+    return accessors;
+  }
+}
+
+- (NSString *)percentEncodedStringFromObject:(id)object {
+  if ([_tokens count] == 0) {
+    return @"";
+  }
+  NSArray* accessors = [self _accessorsForClass:[object class]];
+
+  SOCBuffer buffer;
+  SOCBufferInit(&buffer);
+
+  NSInteger parameterIndex = 0;
+  for (id token in _encodedTokens) {
+    if ([token isKindOfClass:[NSData class]]) {
+      SOCBufferAppend(&buffer, [token bytes], [token length], NO);
+
+    } else {
+      SOCParameterAccessor* accessor = [accessors objectAtIndex:parameterIndex++];
+      [accessor appendValueOfObject:object toBuffer:&buffer];
+    }
+  }
+
+  NSString* result = [[NSString alloc] initWithBytes:buffer.bytes length:buffer.length encoding:NSUTF8StringEncoding];
+  SOCBufferFree(&buffer);
+  return result;
+}
+
+- (void)enumerateTokensUsingBlock:(void (^)(NSString *staticText, NSString *parameterName))block {
+  for (id token in _tokens) {
+    if ([token isKindOfClass:[NSString class]]) {
+      block([self _stringFromEscapedToken:token], nil);
+    } else {
+      block(nil, [token string]);
+    }
+  }
+}
+
+@end
+
+#pragma mark - Buffer
+
+static bool SOCPathAllowedBytes[256];
+
+static void SOCBufferInit(SOCBuffer* buffer) {
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    // RFC 3986 pchar, plus "/". "%" is kept only when it starts a valid escape (see SOCBufferAppend).
+    const char* allowed = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~!$&'()*+,;=:@/";
+    for (const char* c = allowed; *c; c++) {
+      SOCPathAllowedBytes[(unsigned char)*c] = true;
+    }
+  });
+  buffer->bytes = buffer->stackBytes;
+  buffer->length = 0;
+  buffer->capacity = sizeof(buffer->stackBytes);
+}
+
+static void SOCBufferReserve(SOCBuffer* buffer, size_t length) {
+  if (buffer->length + length <= buffer->capacity) {
+    return;
+  }
+  size_t capacity = MAX(buffer->capacity * 2, buffer->length + length);
+  if (buffer->bytes == buffer->stackBytes) {
+    buffer->bytes = malloc(capacity);
+    memcpy(buffer->bytes, buffer->stackBytes, buffer->length);
+  } else {
+    buffer->bytes = realloc(buffer->bytes, capacity);
+  }
+  buffer->capacity = capacity;
+}
+
+static BOOL SOCIsHexDigit(unsigned char byte) {
+  return (byte >= '0' && byte <= '9') || (byte >= 'A' && byte <= 'F') || (byte >= 'a' && byte <= 'f');
+}
+
+static BOOL SOCIsPercentEscape(const unsigned char* bytes, size_t length) {
+  return length >= 3 && bytes[0] == '%' && SOCIsHexDigit(bytes[1]) && SOCIsHexDigit(bytes[2]);
+}
+
+static void SOCBufferAppend(SOCBuffer* buffer, const void* bytes, size_t length, BOOL percentEncoding) {
+  static const char hexDigits[] = "0123456789ABCDEF";
+
+  if (!percentEncoding) {
+    SOCBufferReserve(buffer, length);
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+    return;
+  }
+
+  // Worst case: every byte is encoded.
+  SOCBufferReserve(buffer, length * 3);
+  const unsigned char* source = bytes;
+  char* destination = buffer->bytes + buffer->length;
+  for (size_t ix = 0; ix < length; ++ix) {
+    unsigned char byte = source[ix];
+    if (SOCPathAllowedBytes[byte] || (byte == '%' && SOCIsPercentEscape(source + ix, length - ix))) {
+      *destination++ = (char)byte;
+    } else {
+      *destination++ = '%';
+      *destination++ = hexDigits[byte >> 4];
+      *destination++ = hexDigits[byte & 0xF];
+    }
+  }
+  buffer->length = destination - buffer->bytes;
+}
+
+static void SOCBufferAppendString(SOCBuffer* buffer, NSString* string) {
+  // Strings are converted in chunks on the stack: no temporary UTF-8 copy of the string.
+  char chunk[256];
+  NSRange range = NSMakeRange(0, [string length]);
+  while (range.length > 0) {
+    NSUInteger usedLength = 0;
+    NSRange remainingRange;
+    if (![string getBytes:chunk maxLength:sizeof(chunk) usedLength:&usedLength encoding:NSUTF8StringEncoding options:0 range:range remainingRange:&remainingRange] || usedLength == 0) {
+      break;
+    }
+    if (remainingRange.length > 0 && usedLength > 2) {
+      // An escape cut by the end of the chunk is moved to the next one, so it is still recognized ("%" and hex digits are single bytes).
+      NSUInteger cutLength = chunk[usedLength - 1] == '%' ? 1 : (chunk[usedLength - 2] == '%' ? 2 : 0);
+      usedLength -= cutLength;
+      remainingRange = NSMakeRange(remainingRange.location - cutLength, remainingRange.length + cutLength);
+    }
+    SOCBufferAppend(buffer, chunk, usedLength, YES);
+    range = remainingRange;
+  }
+}
+
+static void SOCBufferFree(SOCBuffer* buffer) {
+  if (buffer->bytes != buffer->stackBytes) {
+    free(buffer->bytes);
+  }
+}
+
+#pragma mark - Parameter Accessor
+
+@implementation SOCParameterAccessor
+
++ (instancetype)accessorForKeyPath:(NSString *)keyPath ofClass:(Class)class {
+  SOCParameterAccessor* accessor = [[self alloc] init];
+  accessor->_keyPath = [keyPath copy];
+
+  // Only plain property names with a getter; key paths and operators go through KVC.
+  if ([keyPath rangeOfCharacterFromSet:[NSCharacterSet characterSetWithCharactersInString:@".@"]].length == 0) {
+    SEL selector = NSSelectorFromString(keyPath);
+    Method method = class_getInstanceMethod(class, selector);
+    if (NULL != method && method_getNumberOfArguments(method) == 2) {
+      char returnType[4];
+      method_getReturnType(method, returnType, sizeof(returnType));
+      if (strchr("@cBislqCISLQfd", returnType[0]) != NULL) {
+        accessor->_selector = selector;
+        accessor->_imp = method_getImplementation(method);
+        accessor->_returnType = returnType[0];
+      }
+    }
+  }
+  return accessor;
+}
+
+- (void)appendValueOfObject:(id)object toBuffer:(SOCBuffer *)buffer {
+  char number[32];
+  int length = -1;
+
+  switch (_returnType) {
+    case '@': {
+      id value = ((id (*)(id, SEL))_imp)(object, _selector);
+      if ([value isKindOfClass:[NSString class]]) {
+        SOCBufferAppendString(buffer, value);
+      } else {
+        SOCBufferAppendString(buffer, [NSString stringWithFormat:@"%@", value]);
+      }
+      return;
+    }
+    case 'c': length = snprintf(number, sizeof(number), "%d", ((char (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'B': length = snprintf(number, sizeof(number), "%d", ((bool (*)(id, SEL))_imp)(object, _selector) ? 1 : 0); break;
+    case 'i': length = snprintf(number, sizeof(number), "%d", ((int (*)(id, SEL))_imp)(object, _selector)); break;
+    case 's': length = snprintf(number, sizeof(number), "%d", ((short (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'l': length = snprintf(number, sizeof(number), "%ld", ((long (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'q': length = snprintf(number, sizeof(number), "%lld", ((long long (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'C': length = snprintf(number, sizeof(number), "%u", ((unsigned char (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'I': length = snprintf(number, sizeof(number), "%u", ((unsigned int (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'S': length = snprintf(number, sizeof(number), "%u", ((unsigned short (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'L': length = snprintf(number, sizeof(number), "%lu", ((unsigned long (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'Q': length = snprintf(number, sizeof(number), "%llu", ((unsigned long long (*)(id, SEL))_imp)(object, _selector)); break;
+    case 'f': {
+      // Same text of the NSNumber returned by KVC.
+      SOCBufferAppendString(buffer, [@(((float (*)(id, SEL))_imp)(object, _selector)) description]);
+      return;
+    }
+    case 'd': {
+      SOCBufferAppendString(buffer, [@(((double (*)(id, SEL))_imp)(object, _selector)) description]);
+      return;
+    }
+    default: {
+      SOCBufferAppendString(buffer, [NSString stringWithFormat:@"%@", [object valueForKeyPath:_keyPath]]);
+      return;
+    }
+  }
+  SOCBufferAppend(buffer, number, length, NO);
+}
+
 @end
 
 @implementation SOCParameter
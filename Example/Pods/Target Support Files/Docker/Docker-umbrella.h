@@ -18,12 +18,34 @@
 #import "SDDownloadManagerUtils.h"
 #import "SDUIImageViewAligned.h"
 #import "UIImage+Docker.h"
+#import "SDConnectionPrewarmer.h"
+#import "SDDeferredRequestQueue.h"
 #import "SDDocker.h"
 #import "SDDockerLogger.h"
+#import "SDNetworkQualityEstimator.h"
 #import "NSDictionary+Docker.h"
+#import "SDServiceBodyCodec.h"
+#import "SDServiceContentDecoder.h"
+#import "SDServiceEventStream.h"
+#import "SDServiceFaultInjector.h"
+#import "SDServiceFuture.h"
 #import "SDServiceGeneric.h"
+#import "SDServiceHedgingPolicy.h"
+#import "SDServiceJSONDecoder.h"
+#import "SDServiceJSONEncoder.h"
+#import "SDServiceJSONPatch.h"
+#import "SDServiceLatencyTracker.h"
 #import "SDServiceManager.h"
 #import "SDServiceMantle.h"
+#import "SDServiceMappingExecutor.h"
+#import "SDServiceMessagePackCodec.h"
+#import "SDServicePaginationController.h"
+#import "SDServiceParallelMapper.h"
+#import "SDServicePartialResultsCollector.h"
+#import "SDServicePollingScheduler.h"
+#import "SDServiceRateLimiter.h"
+#import "SDServiceRouter.h"
+#import "SDServiceTrafficArchive.h"
 #import "SOCKit.h"
 
 FOUNDATION_EXPORT double DockerVersionNumber;
@@ -0,0 +1,88 @@
+//
+//  SDBenchmarkHTTPServer.h
+//  DockerTests
+//
+//  Minimal HTTP/1.1 server on loopback, optionally over TLS, used as stub by benchmarks.
+//
+
+@import Foundation;
+@import Security;
+
+@interface SDBenchmarkHTTPRequest : NSObject
+
+@property (nonatomic, strong) NSString* method;
+@property (nonatomic, strong) NSString* path;
+@property (nonatomic, strong) NSDictionary<NSString*, NSString*>* queryParameters;
+@property (nonatomic, strong) NSDictionary<NSString*, NSString*>* headers;  // lowercase names
+@property (nonatomic, strong) NSData* body;
+
+@end
+
+
+@interface SDBenchmarkHTTPResponse : NSObject
+
++ (instancetype) responseWithStatusCode:(NSInteger)statusCode JSONData:(NSData*)data;
+
+@property (nonatomic, assign) NSInteger statusCode;
+@property (nonatomic, strong) NSDictionary<NSString*, NSString*>* headers;
+@property (nonatomic, strong) NSData* body;
+
+/**
+ *  Close the connection without answering (the client gets a connection lost error).
+ */
+@property (nonatomic, assign) BOOL dropsConnection;
+
+/**
+ *  Close the connection after the response (no keep-alive).
+ */
+@property (nonatomic, assign) BOOL closesConnection;
+
+/**
+ *  Streamed body (ex. text/event-stream): called until it returns nil, every chunk is sent as soon as it is returned.
+ *  The block can sleep to pace chunks. Streamed responses have no Content-Length and close the connection at the end.
+ */
+@property (nonatomic, copy) NSData* (^bodyStreamBlock)(void);
+
+@end
+
+
+typedef SDBenchmarkHTTPResponse* (^SDBenchmarkHTTPHandler)(SDBenchmarkHTTPRequest* request);
+
+/**
+ *  Serves requests on 127.0.0.1 on a random free port. Every connection is served on its own thread, with keep-alive.
+ *  Handlers are called on connection threads, so they must be thread safe.
+ */
+@interface SDBenchmarkHTTPServer : NSObject
+
+- (BOOL) startWithError:(NSError**)error;
+- (void) stop;
+
+/**
+ *  Identity (certificate and private key) used to serve requests over TLS. Set it before start: baseURL becomes https.
+ */
+@property (nonatomic, strong) __attribute__((NSObject)) SecIdentityRef TLSIdentity;
+
+/**
+ *  Self-signed identity of 127.0.0.1. Clients must accept invalid certificates without validating the domain name.
+ */
++ (SecIdentityRef) loopbackTLSIdentity;
+
+@property (nonatomic, readonly) uint16_t port;
+@property (nonatomic, readonly) NSURL* baseURL;
+
+/**
+ *  Handler of requests whose path starts with prefix. Longest prefix wins. Unhandled requests get 404.
+ */
+- (void) setHandler:(SDBenchmarkHTTPHandler)handler forPathPrefix:(NSString*)prefix;
+
+/**
+ *  Total number of requests received (dropped ones included).
+ */
+@property (atomic, readonly) NSUInteger numberOfRequests;
+
+/**
+ *  Total number of connections accepted (each one pays TCP and TLS setup).
+ */
+@property (atomic, readonly) NSUInteger numberOfConnections;
+
+@end
@@ -0,0 +1,534 @@
+//
+//  SDBenchmarkHTTPServer.m
+//  DockerTests
+//
+//  Minimal HTTP/1.1 server on loopback, optionally over TLS, used as stub by benchmarks.
+//
+
+#import "SDBenchmarkHTTPServer.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define BENCHMARK_SERVER_READ_BUFFER_SIZE      (64 * 1024)
+#define BENCHMARK_SERVER_MAX_HEADER_SIZE       (64 * 1024)
+#define BENCHMARK_SERVER_TLS_PASSPHRASE        @"benchmark"
+
+// PKCS#12 of a self-signed certificate of 127.0.0.1 (RSA 2048, valid until 2125), with its private key
+static NSString* const kBenchmarkServerTLSIdentityBase64 =
+    @"MIIJ7AIBAzCCCbIGCSqGSIb3DQEHAaCCCaMEggmfMIIJmzCCBBcGCSqGSIb3DQEHBqCCBAgwggQE"
+    @"AgEAMIID/QYJKoZIhvcNAQcBMBwGCiqGSIb3DQEMAQMwDgQIoatw4xmwPDkCAggAgIID0CRKuSG3"
+    @"OygowvVQ4XWfmccpuWuRO3cSNloAPZncz9oM5eSyiXVhCdYe3aewkdTLJBEE67cFZ1PTzLx07Mw7"
+    @"rn9c4CQFFzN2vIFJpjlTRYlVjW978/Z1wl3kuXbs2E2vW0SGT0TyvP0AyTDXxVkS+2XEKgnwUIMd"
+    @"KrWVlItTS7uIWibYmgqrHvEBI92VjxaVpFuqsCHyXATAsT+s1Epmhat/HS5jUCsnTg6cjNFVFbqO"
+    @"RfRupj6XeWLBUo01rpNb4RwLSmDD0XUTmmB0GRkBOjy2IDU4Y9XhI3iN1hievxT0bLyD0Zvi86cc"
+    @"GfOybt9xx0mfQ76OUZ9U7gUKRD4wEsLMldoHByRei2HzwPwRGjIjSHz6YAqnQ0/uG2kagD8tHPBE"
+    @"M3kQ/J1v8N6+RCcmRMfcJveGVnWjpClL0GSlSJNxkS7GVZ1Mv/6P9tnFQoQhNwC0FU3FWNBznSfq"
+    @"wS9yY82C59mVuxdfePSxY1mcdlfDOQaPgEYY8mjzOQUWFPd8X26JoqCCILTkTahAV2QHEPgim0AH"
+    @"WYsiMnMNgfaaz9QGwjiSnJvXi96NX3PrCagt72o13ivY8tV3HM8RWzY4L4oSbepBGMVwRDVLoajw"
+    @"rBosqQWdnGP7AXBE86p07TIi7f+30H3NXs9ck1/rtTrzRbtNJLwN9XLCCyy4h5Yd9wgnzkSnGiB0"
+    @"cjJFUZFZY8d+97bm0b9o8SWbJ/bT4HuCvxQCnZf32FS0KiLNMJXMREx9YGlryS/8elsH1sYiUjyu"
+    @"wHGg3jOHaNi+YM2g7T2WBVbip9d+ZvyyW/u3+nT47KHtE1Pp47S2acwmRbKqVGA3KiRQpgoJr4wS"
+    @"ZVGp8RaSN+dqVYK1qKDCJXNn0e+5Qb6vfzEBTQs3/4jdlDiKaKU4d4akSW0U1qV7CcguPs5rfUOa"
+    @"MzoK9Wdqcr+NlH291itCfG45RFp0+p2UGRMMjfcAyWgVeqmkOgTwsLAIQgX+6VmIW/MuRw17jpML"
+    @"lqBWeBideyYfx3bUfYgx+fVPA75vgGMgaef9Xf534JkjOY3tIi1V49xzzl/koU786BMqRNAAb3Ox"
+    @"6NJg4zjq81RwlmiR5fckCWprHisPUm9C2qm9uLMRipW2CwnM94PhlbZqL8rcst+17qRDJ0BnJWgH"
+    @"9nVbGSQERpB9r/0pAxyWZSZyQY0awXNFcuFVzf+b3o+6UXU7EERqajgZysXUX0M0UAXv71w2CJHB"
+    @"tUG2nPaL2BmsqNstoRzhq3isWUCAGjShf33j2pEHM/Tgfwm4alt2oQ+KhDUim4NMsLaX4smjW/Bj"
+    @"FbYwggV8BgkqhkiG9w0BBwGgggVtBIIFaTCCBWUwggVhBgsqhkiG9w0BDAoBAqCCBO4wggTqMBwG"
+    @"CiqGSIb3DQEMAQMwDgQIEqEiY68CsX0CAggABIIEyE0JryZZzct8H2+oEfU6SRCQRiYmBraWwv9E"
+    @"oZ9judDw008NkqRtMTCbFNTYu0UvXDobFSnZzWX31a/sJo8dzQGh6t2EyOMmVBShYTAlALop8vLh"
+    @"2Cj04Bw64oslgRl4Tcb7uhDtYJWyL/pooe8eQmn31NZy2IMlf72Hj2JjLv8rbm9zGZjYZZDWkEvL"
+    @"okkV35ca/7C04QEraHCbjEce9IXPt2hA++1HSvqoQiBeE1Pn5qxXlxK/McB304AepFXhJoTrijf5"
+    @"DMprQk8y6LG9RtgmlaxjFbt9hPzruVA887e6mukzI8MzrtLDoguk+nrN8lV/OuFT5M3jQCHF8Z88"
+    @"it4A6ntMOlH/t17Vdq+VlnIl5v6dhTf5H1nFxFwtOKlS6damu1dGUSuYjHxp5mT8HqgzYCgGAiQi"
+    @"zAjl0HTrqhBg8UQqvuJoaBv7EXeYPyiI/MTAz12hRWWp0DZLvFpWWC0VgQQ+FVTnh9+LHWhsvaG5"
+    @"UPNXv3hJ/aM+4V4uOS925q0LMI+9YxhCJtw90tlNNqXGW1rDygXaGHKIaOrW8dU1Q4adun4ZdOON"
+    @"3YuYfzkYhMHCAX0dbTEiJvcpnTuUxkGTZmqqalT6xkROpwUYM1iK3jptYMLUPJcE5W+A7UNQUSZh"
+    @"BUGemEYnM9Ogyen8c+xAgKT7iaV1P8aKNlpnjhv2PKY9m+kS5YY+MD1q10laiiz1friP5NY3zbpH"
+    @"4OXKaHt9uLztWhEMbRLmSAh/0JLytDyKaeoy5u3Qb4Ol0H2kFiAgX3zPOmr5h2fneZ0XyzqvVJp8"
+    @"1/XTRbKsfWabpnXspY5DrgPHr9MG0bYEWVmRfCTldjCNyMyNcO9+9A1SG9mAnI2LPf2uT/y8f6qy"
+    @"9Pp5PFN8mOWWWKE5Ix5cL8LlwdJwx3o+0lBITmGZrsAv2ZZItlvLuz8wWnrBpEZ886FyheBfbc5J"
+    @"Wn3PLkTHt0z7rt9T6Qb+rh9LqGKhtiKZfBfzXJ3JQFCvR7OjGvFjwuUHFoAiqB4na6kSrIl1kxx3"
+    @"TjqXl62EAn5PF2rD9QXF/rQEcGNoZBaVNrPKqAAPZ1R5zda9/tjwQamgfaGNyQcrQHOOazKu6Ye/"
+    @"7fFXJSP5A29LXw//9L92VyyZSZzAGbJyjNOP4XKfkGBvaPa/newTdc73BuOfCaZxI2Ndbw7V36AJ"
+    @"9cIqIKl1a+doj8WYhVpbZpkeTOgk6MA1Kj+9qmQPa1mV8ydCUyA/OAbGzh7nxgFKotVuRXIGnC2Y"
+    @"ZCi+22D6T2njyup8J+6/Mq710CCklCARwp8sb02RR0tblT/StVE59f0RDnbMCa1+7Q8074/x30n2"
+    @"EHRhMSnAZycv8KVmi/5xM1SwZAH+DO/3ooinLB9xrf/1vKkddP1uiGqm2+bdcyMyFVC4ZRBu5U+h"
+    @"cEGmyAyNQ1aHmP75m0rB72dCmV7TO2LSnXiWb6aRXFe03iKOYruGyXc0Hdjz1muVk44B5Dtjehwi"
+    @"2rvT3Bb6Y3wmaY7Cc61qCHM1iM5Q+mKPyTnIg4YMz+7KD+QuvNBEBhjjvT1tF4+V3Qye8Iy118ZU"
+    @"vp+rNCI6jy49FEcqg2yshBIyK/Pt8DZkdfVYe8FR+rQ8qLZfHJzi/EdzgcwHRsP/QTPeuAFiO5hb"
+    @"cDFgMCMGCSqGSIb3DQEJFTEWBBRzyPWzDmvLrFMgP6Apu2KBu2DHgjA5BgkqhkiG9w0BCRQxLB4q"
+    @"AFMARABCAGUAbgBjAGgAbQBhAHIAawBIAFQAVABQAFMAZQByAHYAZQByMDEwITAJBgUrDgMCGgUA"
+    @"BBQcc5xHWQwM7IHR74TlmAU5noYo1QQI3EZC0c38uWsCAggA";
+
+static OSStatus SDBenchmarkTLSRead(SSLConnectionRef connection, void* data, size_t* length)
+{
+    int clientSocket = (int)(intptr_t)connection;
+    size_t requested = *length;
+    *length = 0;
+    while (*length < requested)
+    {
+        ssize_t count = recv(clientSocket, (uint8_t*)data + *length, requested - *length, 0);
+        if (count <= 0)
+        {
+            return count == 0 ? errSSLClosedGraceful : errSSLClosedAbort;
+        }
+        *length += count;
+    }
+    return noErr;
+}
+
+static OSStatus SDBenchmarkTLSWrite(SSLConnectionRef connection, const void* data, size_t* length)
+{
+    int clientSocket = (int)(intptr_t)connection;
+    size_t requested = *length;
+    *length = 0;
+    while (*length < requested)
+    {
+        ssize_t count = send(clientSocket, (const uint8_t*)data + *length, requested - *length, 0);
+        if (count <= 0)
+        {
+            return errSSLClosedAbort;
+        }
+        *length += count;
+    }
+    return noErr;
+}
+
+@implementation SDBenchmarkHTTPRequest
+
+@end
+
+
+
+/**
+ *  Socket of a client, with its TLS context when the server has an identity.
+ */
+@interface SDBenchmarkHTTPConnection : NSObject
+{
+@public
+    int clientSocket;
+    SSLContextRef context;
+}
+
+@end
+
+@implementation SDBenchmarkHTTPConnection
+
+@end
+
+
+
+@implementation SDBenchmarkHTTPResponse
+
++ (instancetype) responseWithStatusCode:(NSInteger)statusCode JSONData:(NSData*)data
+{
+    SDBenchmarkHTTPResponse* response = [self new];
+    response.statusCode = statusCode;
+    // never served from URL cache: every call reaches the server
+    response.headers = @{ @"Content-Type" : @"application/json", @"Cache-Control" : @"no-store" };
+    response.body = data;
+    return response;
+}
+
+@end
+
+
+
+@interface SDBenchmarkHTTPServer ()
+{
+    int listenSocket;
+    dispatch_source_t acceptSource;
+    dispatch_queue_t acceptQueue;
+}
+
+@property (nonatomic, readwrite) uint16_t port;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, SDBenchmarkHTTPHandler>* handlers;
+@property (atomic, readwrite) NSUInteger numberOfRequests;
+@property (atomic, readwrite) NSUInteger numberOfConnections;
+
+@end
+
+@implementation SDBenchmarkHTTPServer
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self)
+    {
+        listenSocket = -1;
+        self.handlers = [NSMutableDictionary new];
+        acceptQueue = dispatch_queue_create("com.sysdata.SDBenchmarkHTTPServer.accept", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [self stop];
+}
+
+- (NSURL*) baseURL
+{
+    return [NSURL URLWithString:[NSString stringWithFormat:@"%@://127.0.0.1:%d", self.TLSIdentity ? @"https" : @"http", self.port]];
+}
+
++ (SecIdentityRef) loopbackTLSIdentity
+{
+    static SecIdentityRef identity = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSData* data = [[NSData alloc] initWithBase64EncodedString:kBenchmarkServerTLSIdentityBase64 options:0];
+        CFArrayRef items = NULL;
+        OSStatus status = SecPKCS12Import((__bridge CFDataRef)data, (__bridge CFDictionaryRef)@{ (__bridge id)kSecImportExportPassphrase : BENCHMARK_SERVER_TLS_PASSPHRASE }, &items);
+        if (status == errSecSuccess && CFArrayGetCount(items) > 0)
+        {
+            NSDictionary* item = (__bridge NSDictionary*)CFArrayGetValueAtIndex(items, 0);
+            identity = (SecIdentityRef)CFRetain((__bridge CFTypeRef)item[(__bridge id)kSecImportItemIdentity]);
+        }
+        else
+        {
+            NSLog(@"Can't import benchmark TLS identity: %d", (int)status);
+        }
+        if (items)
+        {
+            CFRelease(items);
+        }
+    });
+    return identity;
+}
+
+- (void) setHandler:(SDBenchmarkHTTPHandler)handler forPathPrefix:(NSString*)prefix
+{
+    @synchronized (self.handlers)
+    {
+        self.handlers[prefix] = [handler copy];
+    }
+}
+
+#pragma mark - Start / Stop
+
+- (BOOL) startWithError:(NSError**)error
+{
+    listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket < 0)
+    {
+        return [self failWithError:error];
+    }
+
+    int yes = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = 0;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 128) != 0)
+    {
+        return [self failWithError:error];
+    }
+
+    socklen_t addressLength = sizeof(address);
+    getsockname(listenSocket, (struct sockaddr*)&address, &addressLength);
+    self.port = ntohs(address.sin_port);
+
+    fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL) | O_NONBLOCK);
+
+    int socketToAccept = listenSocket;
+    __weak typeof (self) weakself = self;
+    acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, socketToAccept, 0, acceptQueue);
+    dispatch_source_set_event_handler(acceptSource, ^{
+        int clientSocket;
+        while ((clientSocket = accept(socketToAccept, NULL, NULL)) >= 0)
+        {
+            [weakself serveConnectionOnSocket:clientSocket];
+        }
+    });
+    dispatch_source_set_cancel_handler(acceptSource, ^{
+        close(socketToAccept);
+    });
+    dispatch_resume(acceptSource);
+    return YES;
+}
+
+- (BOOL) failWithError:(NSError**)error
+{
+    if (error)
+    {
+        *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+    }
+    if (listenSocket >= 0)
+    {
+        close(listenSocket);
+        listenSocket = -1;
+    }
+    return NO;
+}
+
+- (void) stop
+{
+    if (acceptSource)
+    {
+        dispatch_source_cancel(acceptSource);
+        acceptSource = nil;
+        listenSocket = -1;
+    }
+}
+
+#pragma mark - Connection
+
+- (void) serveConnectionOnSocket:(int)clientSocket
+{
+    int yes = 1;
+    setsockopt(clientSocket, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+    setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL) & ~O_NONBLOCK);
+    @synchronized (self)
+    {
+        self.numberOfConnections++;
+    }
+
+    // blocking reads: every connection has its own thread
+    [NSThread detachNewThreadSelector:@selector(runConnection:) toTarget:self withObject:@(clientSocket)];
+}
+
+- (void) runConnection:(NSNumber*)socketNumber
+{
+    SDBenchmarkHTTPConnection* connection = [SDBenchmarkHTTPConnection new];
+    connection->clientSocket = socketNumber.intValue;
+    NSMutableData* buffer = [NSMutableData data];
+
+    BOOL open = !self.TLSIdentity || [self startTLSOnConnection:connection];
+    while (open)
+    {
+        @autoreleasepool
+        {
+            SDBenchmarkHTTPRequest* request = [self readRequestFromConnection:connection buffer:buffer];
+            if (!request)
+            {
+                break;
+            }
+            @synchronized (self)
+            {
+                self.numberOfRequests++;
+            }
+
+            SDBenchmarkHTTPResponse* response = [self responseForRequest:request];
+            if (response.dropsConnection)
+            {
+                break;
+            }
+
+            BOOL closes = response.closesConnection || response.bodyStreamBlock || [request.headers[@"connection"].lowercaseString isEqualToString:@"close"];
+            if (![self writeResponse:response toRequest:request closesConnection:closes toConnection:connection] || closes)
+            {
+                break;
+            }
+        }
+    }
+
+    if (connection->context)
+    {
+        SSLClose(connection->context);
+        CFRelease(connection->context);
+    }
+    close(connection->clientSocket);
+}
+
+- (BOOL) startTLSOnConnection:(SDBenchmarkHTTPConnection*)connection
+{
+    connection->context = SSLCreateContext(kCFAllocatorDefault, kSSLServerSide, kSSLStreamType);
+    SSLSetIOFuncs(connection->context, SDBenchmarkTLSRead, SDBenchmarkTLSWrite);
+    SSLSetConnection(connection->context, (SSLConnectionRef)(intptr_t)connection->clientSocket);
+    SSLSetCertificate(connection->context, (__bridge CFArrayRef)@[(__bridge id)self.TLSIdentity]);
+
+    OSStatus status;
+    do
+    {
+        status = SSLHandshake(connection->context);
+    }
+    while (status == errSSLWouldBlock);
+    return status == noErr;
+}
+
+- (SDBenchmarkHTTPResponse*) responseForRequest:(SDBenchmarkHTTPRequest*)request
+{
+    SDBenchmarkHTTPHandler handler = nil;
+    @synchronized (self.handlers)
+    {
+        NSUInteger matchLength = 0;
+        for (NSString* prefix in self.handlers)
+        {
+            if ([request.path hasPrefix:prefix] && prefix.length >= matchLength)
+            {
+                handler = self.handlers[prefix];
+                matchLength = prefix.length;
+            }
+        }
+    }
+
+    SDBenchmarkHTTPResponse* response = handler ? handler(request) : nil;
+    if (!response)
+    {
+        response = [SDBenchmarkHTTPResponse responseWithStatusCode:404 JSONData:[@"{}" dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    return response;
+}
+
+- (BOOL) fillBuffer:(NSMutableData*)buffer fromConnection:(SDBenchmarkHTTPConnection*)connection
+{
+    uint8_t chunk[BENCHMARK_SERVER_READ_BUFFER_SIZE];
+    ssize_t count = 0;
+    if (connection->context)
+    {
+        // with blocking I/O SSLRead waits until the whole length is read: ask only for bytes already decrypted, or for one byte to read the next record
+        size_t buffered = 0;
+        SSLGetBufferedReadSize(connection->context, &buffered);
+        size_t processed = 0;
+        OSStatus status = SSLRead(connection->context, chunk, MAX(MIN(buffered, sizeof(chunk)), 1), &processed);
+        count = status == noErr ? (ssize_t)processed : -1;
+    }
+    else
+    {
+        count = recv(connection->clientSocket, chunk, sizeof(chunk), 0);
+    }
+    if (count <= 0)
+    {
+        return NO;
+    }
+    [buffer appendBytes:chunk length:count];
+    return YES;
+}
+
+- (SDBenchmarkHTTPRequest*) readRequestFromConnection:(SDBenchmarkHTTPConnection*)connection buffer:(NSMutableData*)buffer
+{
+    NSData* separator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    NSRange headerEnd = NSMakeRange(NSNotFound, 0);
+    while ((headerEnd = [buffer rangeOfData:separator options:0 range:NSMakeRange(0, buffer.length)]).location == NSNotFound)
+    {
+        if (buffer.length > BENCHMARK_SERVER_MAX_HEADER_SIZE || ![self fillBuffer:buffer fromConnection:connection])
+        {
+            return nil;
+        }
+    }
+
+    NSString* head = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(0, headerEnd.location)] encoding:NSASCIIStringEncoding];
+    NSArray<NSString*>* lines = [head componentsSeparatedByString:@"\r\n"];
+    NSArray<NSString*>* requestLine = [lines.firstObject componentsSeparatedByString:@" "];
+    if (requestLine.count < 2)
+    {
+        return nil;
+    }
+
+    SDBenchmarkHTTPRequest* request = [SDBenchmarkHTTPRequest new];
+    request.method = requestLine[0];
+
+    NSURLComponents* components = [NSURLComponents componentsWithString:requestLine[1]];
+    request.path = components.path;
+    NSMutableDictionary* query = [NSMutableDictionary dictionary];
+    for (NSURLQueryItem* item in components.queryItems)
+    {
+        [query setValue:item.value ? : @"" forKey:item.name];
+    }
+    request.queryParameters = query;
+
+    NSMutableDictionary* headers = [NSMutableDictionary dictionary];
+    for (NSString* line in [lines subarrayWithRange:NSMakeRange(1, lines.count - 1)])
+    {
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location != NSNotFound)
+        {
+            NSString* name = [[line substringToIndex:colon.location] lowercaseString];
+            headers[name] = [[line substringFromIndex:colon.location + 1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+    request.headers = headers;
+
+    NSUInteger bodyStart = NSMaxRange(headerEnd);
+    NSUInteger bodyLength = (NSUInteger)[headers[@"content-length"] integerValue];
+    while (buffer.length < bodyStart + bodyLength)
+    {
+        if (![self fillBuffer:buffer fromConnection:connection])
+        {
+            return nil;
+        }
+    }
+    request.body = [buffer subdataWithRange:NSMakeRange(bodyStart, bodyLength)];
+
+    // keep bytes of next request (pipelining)
+    [buffer replaceBytesInRange:NSMakeRange(0, bodyStart + bodyLength) withBytes:NULL length:0];
+    return request;
+}
+
+- (BOOL) writeResponse:(SDBenchmarkHTTPResponse*)response toRequest:(SDBenchmarkHTTPRequest*)request closesConnection:(BOOL)closes toConnection:(SDBenchmarkHTTPConnection*)connection
+{
+    NSMutableString* head = [NSMutableString stringWithFormat:@"HTTP/1.1 %d %@\r\n", (int)response.statusCode, [[NSHTTPURLResponse localizedStringForStatusCode:response.statusCode] capitalizedString]];
+    [response.headers enumerateKeysAndObjectsUsingBlock:^(NSString* name, NSString* value, BOOL* stop) {
+        [head appendFormat:@"%@: %@\r\n", name, value];
+    }];
+    if (!response.bodyStreamBlock)
+    {
+        [head appendFormat:@"Content-Length: %lu\r\n", (unsigned long)response.body.length];
+    }
+    [head appendFormat:@"Connection: %@\r\n\r\n", closes ? @"close" : @"keep-alive"];
+
+    NSMutableData* data = [[head dataUsingEncoding:NSASCIIStringEncoding] mutableCopy];
+    // HEAD responses have Content-Length but no body: bytes after the head would be read as the next response of the connection
+    BOOL sendsBody = ![request.method isEqualToString:@"HEAD"];
+    if (response.body && sendsBody)
+    {
+        [data appendData:response.body];
+    }
+    if (![self sendData:data toConnection:connection])
+    {
+        return NO;
+    }
+
+    if (response.bodyStreamBlock && sendsBody)
+    {
+        NSData* chunk = nil;
+        while ((chunk = response.bodyStreamBlock()))
+        {
+            if (![self sendData:chunk toConnection:connection])
+            {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
+- (BOOL) sendData:(NSData*)data toConnection:(SDBenchmarkHTTPConnection*)connection
+{
+    const uint8_t* bytes = data.bytes;
+    NSUInteger written = 0;
+    while (written < data.length)
+    {
+        ssize_t count = 0;
+        if (connection->context)
+        {
+            size_t processed = 0;
+            OSStatus status = SSLWrite(connection->context, bytes + written, data.length - written, &processed);
+            count = status == noErr ? (ssize_t)processed : -1;
+        }
+        else
+        {
+            count = send(connection->clientSocket, bytes + written, data.length - written, 0);
+        }
+        if (count <= 0)
+        {
+            return NO;
+        }
+        written += count;
+    }
+    return YES;
+}
+
+@end
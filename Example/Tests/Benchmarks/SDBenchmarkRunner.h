@@ -0,0 +1,102 @@
+//
+//  SDBenchmarkRunner.h
+//  DockerTests
+//
+//  Drives concurrent calls of a scenario and measures throughput, latency, allocations and main thread time.
+//
+
+@import Foundation;
+
+/**
+ *  Block that starts call number index and calls completion when it ends. Called on main thread.
+ */
+typedef void (^SDBenchmarkCallBlock)(NSUInteger index, void (^completion)(BOOL success));
+
+@interface SDBenchmarkScenario : NSObject
+
++ (instancetype) scenarioWithName:(NSString*)name numberOfCalls:(NSUInteger)numberOfCalls concurrency:(NSUInteger)concurrency callBlock:(SDBenchmarkCallBlock)callBlock;
+
+@property (nonatomic, strong) NSString* name;
+@property (nonatomic, assign) NSUInteger numberOfCalls;
+
+/**
+ *  Calls running at the same time.
+ */
+@property (nonatomic, assign) NSUInteger concurrency;
+
+/**
+ *  Calls executed before measuring (not included in results). Default: 5
+ */
+@property (nonatomic, assign) NSUInteger warmupCalls;
+
+@property (nonatomic, copy) SDBenchmarkCallBlock callBlock;
+
+/**
+ *  Extra values added to the result (ex. payload size).
+ */
+@property (nonatomic, strong) NSDictionary<NSString*, id>* parameters;
+
+@end
+
+
+@interface SDBenchmarkResult : NSObject
+
+@property (nonatomic, strong) NSString* name;
+@property (nonatomic, assign) NSUInteger numberOfCalls;
+@property (nonatomic, assign) NSUInteger concurrency;
+@property (nonatomic, assign) NSUInteger successes;
+@property (nonatomic, assign) NSUInteger failures;
+
+/**
+ *  NO if the scenario didn't end before timeout.
+ */
+@property (nonatomic, assign) BOOL completed;
+
+@property (nonatomic, assign) NSTimeInterval wallTime;
+@property (nonatomic, readonly) double throughput;                     // calls per second
+
+@property (nonatomic, strong) NSArray<NSNumber*>* latencies;           // seconds, sorted
+- (NSTimeInterval) latencyAtPercentile:(double)percentile;
+
+@property (nonatomic, assign) NSTimeInterval mainThreadCPUTime;        // user + system time of main thread
+@property (nonatomic, assign) long long mallocBlocksDelta;             // blocks in use at end - blocks in use at start
+@property (nonatomic, assign) long long mallocBytesDelta;
+@property (nonatomic, assign) long long peakMallocBytesDelta;          // max bytes in use during run - bytes in use at start
+
+@property (nonatomic, strong) NSDictionary<NSString*, id>* parameters;
+
+- (NSDictionary*) dictionaryRepresentation;
+
+@end
+
+
+@interface SDBenchmarkRunner : NSObject
+
+/**
+ *  Run the scenario spinning the main run loop. Must be called on main thread.
+ */
+- (SDBenchmarkResult*) runScenario:(SDBenchmarkScenario*)scenario timeout:(NSTimeInterval)timeout;
+
+/**
+ *  Write a JSON report with all results. Path is the SD_BENCHMARK_OUTPUT environment variable, or a new file in temporary directory.
+ *
+ *  @return path of the report.
+ */
++ (NSString*) writeReportWithResults:(NSArray<SDBenchmarkResult*>*)results error:(NSError**)error;
+
+/**
+ *  Scale of the benchmarks, from the SD_BENCHMARK_SCALE environment variable (ex. 0.1 or 10). Default: 1
+ */
++ (double) scale;
+
+/**
+ *  Count (of calls, items, events...) multiplied by scale, at least minimum: below it a scenario measures nothing useful.
+ */
++ (NSUInteger) scaledCount:(NSUInteger)count minimum:(NSUInteger)minimum;
+
+/**
+ *  Count multiplied by scale, at least 1.
+ */
++ (NSUInteger) scaledCount:(NSUInteger)count;
+
+@end
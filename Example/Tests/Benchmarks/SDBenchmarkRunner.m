@@ -0,0 +1,295 @@
+//
+//  SDBenchmarkRunner.m
+//  DockerTests
+//
+//  Drives concurrent calls of a scenario and measures throughput, latency, allocations and main thread time.
+//
+
+#import "SDBenchmarkRunner.h"
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#include <sys/sysctl.h>
+
+#define BENCHMARK_REPORT_SCHEMA_VERSION        1
+#define BENCHMARK_MEMORY_SAMPLING_INTERVAL     0.01
+
+@implementation SDBenchmarkScenario
+
++ (instancetype) scenarioWithName:(NSString*)name numberOfCalls:(NSUInteger)numberOfCalls concurrency:(NSUInteger)concurrency callBlock:(SDBenchmarkCallBlock)callBlock
+{
+    SDBenchmarkScenario* scenario = [self new];
+    scenario.name = name;
+    scenario.numberOfCalls = numberOfCalls;
+    scenario.concurrency = MAX(concurrency, 1);
+    scenario.warmupCalls = 5;
+    scenario.callBlock = callBlock;
+    return scenario;
+}
+
+@end
+
+
+
+@implementation SDBenchmarkResult
+
+- (double) throughput
+{
+    return self.wallTime > 0 ? (self.successes + self.failures) / self.wallTime : 0;
+}
+
+- (NSTimeInterval) latencyAtPercentile:(double)percentile
+{
+    if (self.latencies.count == 0)
+    {
+        return 0;
+    }
+    // nearest rank
+    NSUInteger rank = (NSUInteger)ceil(percentile / 100. * self.latencies.count);
+    rank = MIN(MAX(rank, 1), self.latencies.count);
+    return self.latencies[rank - 1].doubleValue;
+}
+
+- (NSDictionary*) dictionaryRepresentation
+{
+    double sum = 0;
+    for (NSNumber* latency in self.latencies)
+    {
+        sum += latency.doubleValue;
+    }
+    double mean = self.latencies.count > 0 ? sum / self.latencies.count : 0;
+
+    NSMutableDictionary* dictionary = [NSMutableDictionary dictionary];
+    dictionary[@"name"] = self.name;
+    dictionary[@"calls"] = @(self.numberOfCalls);
+    dictionary[@"concurrency"] = @(self.concurrency);
+    dictionary[@"completed"] = @(self.completed);
+    dictionary[@"successes"] = @(self.successes);
+    dictionary[@"failures"] = @(self.failures);
+    dictionary[@"wall_time_ms"] = @(self.wallTime * 1000.);
+    dictionary[@"throughput_calls_per_s"] = @(self.throughput);
+    dictionary[@"latency_ms"] = @{
+                                  @"mean" : @(mean * 1000.),
+                                  @"p50" : @([self latencyAtPercentile:50] * 1000.),
+                                  @"p90" : @([self latencyAtPercentile:90] * 1000.),
+                                  @"p95" : @([self latencyAtPercentile:95] * 1000.),
+                                  @"p99" : @([self latencyAtPercentile:99] * 1000.),
+                                  @"max" : @([self latencyAtPercentile:100] * 1000.)
+                                  };
+    dictionary[@"main_thread_cpu_ms"] = @(self.mainThreadCPUTime * 1000.);
+    dictionary[@"main_thread_cpu_ms_per_call"] = @(self.numberOfCalls > 0 ? self.mainThreadCPUTime * 1000. / self.numberOfCalls : 0);
+    dictionary[@"malloc"] = @{
+                              @"blocks_delta" : @(self.mallocBlocksDelta),
+                              @"bytes_delta" : @(self.mallocBytesDelta),
+                              @"peak_bytes_delta" : @(self.peakMallocBytesDelta)
+                              };
+    if (self.parameters.count > 0)
+    {
+        dictionary[@"parameters"] = self.parameters;
+    }
+    return dictionary;
+}
+
+@end
+
+
+
+static NSTimeInterval SDCurrentThreadCPUTime(void)
+{
+    mach_port_t thread = mach_thread_self();
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    kern_return_t result = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (result != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    return info.user_time.seconds + info.user_time.microseconds / 1e6 + info.system_time.seconds + info.system_time.microseconds / 1e6;
+}
+
+static malloc_statistics_t SDMallocStatistics(void)
+{
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    return statistics;
+}
+
+@implementation SDBenchmarkRunner
+
+- (SDBenchmarkResult*) runScenario:(SDBenchmarkScenario*)scenario timeout:(NSTimeInterval)timeout
+{
+    NSAssert(NSThread.isMainThread, @"Benchmarks run on main thread");
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = scenario.name;
+    result.numberOfCalls = scenario.numberOfCalls;
+    result.concurrency = scenario.concurrency;
+    result.parameters = scenario.parameters;
+
+    CFAbsoluteTime deadline = CFAbsoluteTimeGetCurrent() + timeout;
+
+    // warm up connections, caches and lazy initializations
+    [self runCalls:scenario.warmupCalls firstIndex:0 scenario:scenario deadline:deadline latencies:nil result:nil];
+
+    // memory is sampled in background to catch the peak
+    malloc_statistics_t startStatistics = SDMallocStatistics();
+    __block size_t peakBytes = startStatistics.size_in_use;
+    dispatch_source_t samplingTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0));
+    dispatch_source_set_timer(samplingTimer, DISPATCH_TIME_NOW, (uint64_t)(BENCHMARK_MEMORY_SAMPLING_INTERVAL * NSEC_PER_SEC), 0);
+    dispatch_source_set_event_handler(samplingTimer, ^{
+        peakBytes = MAX(peakBytes, SDMallocStatistics().size_in_use);
+    });
+    dispatch_resume(samplingTimer);
+
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:scenario.numberOfCalls];
+    NSTimeInterval startCPUTime = SDCurrentThreadCPUTime();
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+
+    result.completed = [self runCalls:scenario.numberOfCalls firstIndex:scenario.warmupCalls scenario:scenario deadline:deadline latencies:latencies result:result];
+
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.mainThreadCPUTime = SDCurrentThreadCPUTime() - startCPUTime;
+
+    dispatch_source_cancel(samplingTimer);
+    malloc_statistics_t endStatistics = SDMallocStatistics();
+    result.mallocBlocksDelta = (long long)endStatistics.blocks_in_use - (long long)startStatistics.blocks_in_use;
+    result.mallocBytesDelta = (long long)endStatistics.size_in_use - (long long)startStatistics.size_in_use;
+    result.peakMallocBytesDelta = (long long)MAX(peakBytes, endStatistics.size_in_use) - (long long)startStatistics.size_in_use;
+
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+- (BOOL) runCalls:(NSUInteger)numberOfCalls firstIndex:(NSUInteger)firstIndex scenario:(SDBenchmarkScenario*)scenario deadline:(CFAbsoluteTime)deadline latencies:(NSMutableArray<NSNumber*>*)latencies result:(SDBenchmarkResult*)result
+{
+    __block NSUInteger started = 0;
+    __block NSUInteger finished = 0;
+
+    __block __weak void (^ weakStartNextCall)(void);
+    void (^ startNextCall)(void) = ^{
+        if (started >= numberOfCalls)
+        {
+            return;
+        }
+        NSUInteger index = firstIndex + started;
+        started++;
+
+        CFAbsoluteTime callStartTime = CFAbsoluteTimeGetCurrent();
+        __block BOOL callFinished = NO;
+        scenario.callBlock(index, ^(BOOL success) {
+            if (callFinished)
+            {
+                return;
+            }
+            callFinished = YES;
+            finished++;
+
+            [latencies addObject:@(CFAbsoluteTimeGetCurrent() - callStartTime)];
+            if (success)
+            {
+                result.successes++;
+            }
+            else
+            {
+                result.failures++;
+            }
+
+            if (weakStartNextCall)
+            {
+                weakStartNextCall();
+            }
+        });
+    };
+    weakStartNextCall = startNextCall;
+
+    for (NSUInteger i = 0; i < MIN(scenario.concurrency, numberOfCalls); i++)
+    {
+        startNextCall();
+    }
+
+    while (finished < numberOfCalls && CFAbsoluteTimeGetCurrent() < deadline)
+    {
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.01, true);
+    }
+    return finished == numberOfCalls;
+}
+
+#pragma mark - Scale
+
++ (double) scale
+{
+    double scale = [[[NSProcessInfo processInfo] environment][@"SD_BENCHMARK_SCALE"] doubleValue];
+    return scale > 0 ? scale : 1;
+}
+
++ (NSUInteger) scaledCount:(NSUInteger)count minimum:(NSUInteger)minimum
+{
+    return MAX((NSUInteger)(count * [self scale]), minimum);
+}
+
++ (NSUInteger) scaledCount:(NSUInteger)count
+{
+    return [self scaledCount:count minimum:1];
+}
+
+#pragma mark - Report
+
++ (NSString*) writeReportWithResults:(NSArray<SDBenchmarkResult*>*)results error:(NSError**)error
+{
+    NSMutableArray* scenarios = [NSMutableArray arrayWithCapacity:results.count];
+    for (SDBenchmarkResult* result in results)
+    {
+        [scenarios addObject:[result dictionaryRepresentation]];
+    }
+
+    NSDateFormatter* formatter = [NSDateFormatter new];
+    formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+    formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+    formatter.dateFormat = @"yyyy-MM-dd'T'HH:mm:ss'Z'";
+    NSString* date = [formatter stringFromDate:[NSDate date]];
+
+    NSDictionary* report = @{
+                             @"schema_version" : @(BENCHMARK_REPORT_SCHEMA_VERSION),
+                             @"date" : date,
+                             @"machine" : [self machineName],
+                             @"system" : [[NSProcessInfo processInfo] operatingSystemVersionString],
+                             @"processors" : @([[NSProcessInfo processInfo] activeProcessorCount]),
+#if DEBUG
+                             @"configuration" : @"Debug",
+#else
+                             @"configuration" : @"Release",
+#endif
+                             @"scenarios" : scenarios
+                             };
+
+    NSString* path = [[NSProcessInfo processInfo] environment][@"SD_BENCHMARK_OUTPUT"];
+    if (path.length == 0)
+    {
+        formatter.dateFormat = @"yyyyMMdd-HHmmss";
+        NSString* directory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"DockerBenchmarks"];
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL];
+        path = [directory stringByAppendingPathComponent:[NSString stringWithFormat:@"benchmark-%@.json", [formatter stringFromDate:[NSDate date]]]];
+    }
+
+    NSData* data = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:error];
+    if (!data || ![data writeToFile:path options:NSDataWritingAtomic error:error])
+    {
+        return nil;
+    }
+    return path;
+}
+
++ (NSString*) machineName
+{
+    size_t size = 0;
+    sysctlbyname("hw.machine", NULL, &size, NULL, 0);
+    char* machine = malloc(size);
+    sysctlbyname("hw.machine", machine, &size, NULL, 0);
+    NSString* name = [NSString stringWithUTF8String:machine];
+    free(machine);
+    return name ? : @"unknown";
+}
+
+@end
@@ -0,0 +1,142 @@
+//
+//  SDBenchmarkServices.h
+//  DockerTests
+//
+//  Services, requests and models used by benchmarks. Payloads mimic a typical REST API.
+//
+
+@import Foundation;
+@import Mantle;
+#import <Docker/SDDocker.h>
+
+/**
+ *  Base class of benchmark services: all of them use the same request operation manager, pointing to the stub server.
+ */
+@interface SDBenchmarkService : SDServiceMantle
+
++ (void) setRequestOperationManager:(AFHTTPRequestOperationManager*)requestOperationManager;
+
+@end
+
+
+@interface SDBenchmarkOwner : MTLModel <MTLJSONSerializing>
+
+@property (nonatomic, strong) NSString* identifier;
+@property (nonatomic, strong) NSString* displayName;
+@property (nonatomic, strong) NSURL* avatarURL;
+
+@end
+
+
+@interface SDBenchmarkItem : MTLModel <SDServiceJSONDecoding>
+
+@property (nonatomic, strong) NSNumber* identifier;
+@property (nonatomic, strong) NSString* title;
+@property (nonatomic, strong) NSString* summary;
+@property (nonatomic, assign) double score;
+@property (nonatomic, assign) BOOL published;
+@property (nonatomic, strong) NSArray<NSString*>* tags;
+@property (nonatomic, strong) NSDate* createdAt;
+@property (nonatomic, strong) SDBenchmarkOwner* owner;
+
+/**
+ *  JSON object of an item as returned by the stub server.
+ */
++ (NSDictionary*) JSONObjectForIdentifier:(NSInteger)identifier;
+
+@end
+
+
+#pragma mark - Small GET
+
+@interface SDBenchmarkItemService : SDBenchmarkService
+
+@end
+
+@interface SDBenchmarkItemRequest : SDServiceMantleRequest
+
+@property (nonatomic, strong) NSNumber* itemId;
+
+@end
+
+@interface SDBenchmarkItemResponse : SDServiceMantleResponse
+
+@property (nonatomic, strong) SDBenchmarkItem* item;
+
+@end
+
+
+#pragma mark - Large array
+
+@interface SDBenchmarkItemListService : SDBenchmarkService
+
+@end
+
+@interface SDBenchmarkItemListRequest : SDServiceMantleRequest
+
+@property (nonatomic, strong) NSNumber* count;
+
+@end
+
+@interface SDBenchmarkItemListResponse : SDServiceMantleResponse
+
+@property (nonatomic, strong) NSArray<SDBenchmarkItem*>* items;
+
+@end
+
+/**
+ *  Same as SDBenchmarkItemListService, with models read directly from response data.
+ */
+@interface SDBenchmarkItemListDataService : SDBenchmarkItemListService
+
+@end
+
+
+#pragma mark - Multipart POST
+
+@interface SDBenchmarkUploadService : SDBenchmarkService
+
+@end
+
+@interface SDBenchmarkUploadRequest : SDServiceMantleRequest
+
+@property (nonatomic, strong) NSString* fileDescription;
+
+@end
+
+@interface SDBenchmarkUploadResponse : SDServiceMantleResponse
+
+@property (nonatomic, strong) NSString* uploadId;
+@property (nonatomic, strong) NSNumber* receivedBytes;
+
+@end
+
+
+#pragma mark - Errors and retries
+
+/**
+ *  Always answers with a 500 and an error body.
+ */
+@interface SDBenchmarkErrorService : SDBenchmarkService
+
+@end
+
+/**
+ *  Server drops the connection at the first attempt of every call id, then answers as SDBenchmarkItemService.
+ */
+@interface SDBenchmarkFlakyService : SDBenchmarkService
+
+@end
+
+@interface SDBenchmarkFlakyRequest : SDServiceMantleRequest
+
+@property (nonatomic, strong) NSString* callId;
+
+@end
+
+@interface SDBenchmarkError : SDServiceMantleError
+
+@property (nonatomic, strong) NSString* code;
+@property (nonatomic, strong) NSString* message;
+
+@end
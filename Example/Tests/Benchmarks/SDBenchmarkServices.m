@@ -0,0 +1,328 @@
+//
+//  SDBenchmarkServices.m
+//  DockerTests
+//
+//  Services, requests and models used by benchmarks. Payloads mimic a typical REST API.
+//
+
+#import "SDBenchmarkServices.h"
+
+static AFHTTPRequestOperationManager* benchmarkRequestOperationManager = nil;
+
+@implementation SDBenchmarkService
+
++ (void) setRequestOperationManager:(AFHTTPRequestOperationManager*)requestOperationManager
+{
+    benchmarkRequestOperationManager = requestOperationManager;
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return benchmarkRequestOperationManager;
+}
+
+- (Class) errorClass
+{
+    return [SDBenchmarkError class];
+}
+
+@end
+
+
+@implementation SDBenchmarkOwner
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"identifier" : @"id",
+             @"displayName" : @"display_name",
+             @"avatarURL" : @"avatar_url"
+             };
+}
+
++ (NSValueTransformer*) avatarURLJSONTransformer
+{
+    return [NSValueTransformer valueTransformerForName:MTLURLValueTransformerName];
+}
+
+@end
+
+
+@implementation SDBenchmarkItem
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"identifier" : @"id",
+             @"title" : @"title",
+             @"summary" : @"summary",
+             @"score" : @"score",
+             @"published" : @"published",
+             @"tags" : @"tags",
+             @"createdAt" : @"created_at",
+             @"owner" : @"owner"
+             };
+}
+
++ (NSDateFormatter*) dateFormatter
+{
+    static NSDateFormatter* formatter = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [NSDateFormatter new];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        formatter.dateFormat = @"yyyy-MM-dd'T'HH:mm:ss'Z'";
+    });
+    return formatter;
+}
+
++ (NSValueTransformer*) createdAtJSONTransformer
+{
+    // NSDateFormatter is thread safe since iOS 7: no lock, items are mapped in parallel by SDServiceParallelMapper benchmarks
+    return [MTLValueTransformer transformerUsingForwardBlock:^id(NSString* value, BOOL* success, NSError** error) {
+        return [[SDBenchmarkItem dateFormatter] dateFromString:value];
+    } reverseBlock:^id(NSDate* value, BOOL* success, NSError** error) {
+        return [[SDBenchmarkItem dateFormatter] stringFromDate:value];
+    }];
+}
+
++ (NSValueTransformer*) ownerJSONTransformer
+{
+    return [MTLJSONAdapter dictionaryTransformerWithModelClass:[SDBenchmarkOwner class]];
+}
+
++ (NSDictionary<NSString*, Class>*) JSONDecodingModelClassesByPropertyKey
+{
+    return @{
+             @"owner" : [SDBenchmarkOwner class]
+             };
+}
+
++ (NSDictionary*) JSONObjectForIdentifier:(NSInteger)identifier
+{
+    return @{
+             @"id" : @(identifier),
+             @"title" : [NSString stringWithFormat:@"Item number %ld", (long)identifier],
+             @"summary" : @"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua.",
+             @"score" : @(identifier * 0.37),
+             @"published" : @(identifier % 2 == 0),
+             @"tags" : @[@"news", @"sport", @"weather"],
+             @"created_at" : @"2017-10-04T12:30:00Z",
+             @"owner" : @{
+                     @"id" : [NSString stringWithFormat:@"user-%ld", (long)(identifier % 50)],
+                     @"display_name" : @"Mario Rossi",
+                     @"avatar_url" : @"https://example.com/avatars/mario.png"
+                     },
+             @"unmapped_field" : @"not used by the app"
+             };
+}
+
+@end
+
+
+#pragma mark - Small GET
+
+@implementation SDBenchmarkItemService
+
+- (NSString*) pathResource
+{
+    return @"/items/:itemId";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodGET;
+}
+
+- (Class) responseClass
+{
+    return [SDBenchmarkItemResponse class];
+}
+
+@end
+
+@implementation SDBenchmarkItemRequest
+
+@end
+
+@implementation SDBenchmarkItemResponse
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"item" : @"item"
+             };
+}
+
++ (NSValueTransformer*) itemJSONTransformer
+{
+    return [MTLJSONAdapter dictionaryTransformerWithModelClass:[SDBenchmarkItem class]];
+}
+
+@end
+
+
+#pragma mark - Large array
+
+@implementation SDBenchmarkItemListService
+
+- (NSString*) pathResource
+{
+    return @"/items";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodGET;
+}
+
+- (Class) responseClass
+{
+    return [SDBenchmarkItemListResponse class];
+}
+
+@end
+
+@implementation SDBenchmarkItemListRequest
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"count" : @"count"
+             };
+}
+
+@end
+
+@implementation SDBenchmarkItemListResponse
+
+- (NSString*) propertyNameForArrayResponse
+{
+    return @"items";
+}
+
+- (Class) classOfItemsInArrayResponse
+{
+    return [SDBenchmarkItem class];
+}
+
+@end
+
+@implementation SDBenchmarkItemListDataService
+
+- (BOOL) decodesResponseFromData
+{
+    return YES;
+}
+
+@end
+
+
+#pragma mark - Multipart POST
+
+@implementation SDBenchmarkUploadService
+
+- (NSString*) pathResource
+{
+    return @"/upload";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodPOST;
+}
+
+- (Class) responseClass
+{
+    return [SDBenchmarkUploadResponse class];
+}
+
+@end
+
+@implementation SDBenchmarkUploadRequest
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"fileDescription" : @"description"
+             };
+}
+
+@end
+
+@implementation SDBenchmarkUploadResponse
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"uploadId" : @"upload_id",
+             @"receivedBytes" : @"received_bytes"
+             };
+}
+
+@end
+
+
+#pragma mark - Errors and retries
+
+@implementation SDBenchmarkErrorService
+
+- (NSString*) pathResource
+{
+    return @"/error";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodGET;
+}
+
+- (Class) responseClass
+{
+    return [SDBenchmarkItemResponse class];
+}
+
+@end
+
+@implementation SDBenchmarkFlakyService
+
+- (NSString*) pathResource
+{
+    return @"/flaky";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodGET;
+}
+
+- (Class) responseClass
+{
+    return [SDBenchmarkItemResponse class];
+}
+
+@end
+
+@implementation SDBenchmarkFlakyRequest
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"callId" : @"call_id"
+             };
+}
+
+@end
+
+@implementation SDBenchmarkError
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"code" : @"error.code",
+             @"message" : @"error.message"
+             };
+}
+
+@end
@@ -0,0 +1,218 @@
+//
+//  SDConnectionPrewarmerBenchmarks.m
+//  DockerTests
+//
+//  Latency of the first call to a host, on a cold connection and on a connection opened by SDConnectionPrewarmer,
+//  against local TLS stubs: every call goes to its own server, so no call reuses the connection of another one.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT).
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_SCENARIO_TIMEOUT             120
+#define BENCHMARK_PREWARM_TIMEOUT              30.
+#define BENCHMARK_FIRST_CALLS                  20
+#define BENCHMARK_PREWARM_BUDGET               4
+
+/**
+ *  Item service toward the server of its request operation manager.
+ */
+@interface SDPrewarmBenchmarkItemService : SDBenchmarkItemService
+
+@property (nonatomic, strong) AFHTTPRequestOperationManager* requestOperationManager;
+
+@end
+
+@implementation SDPrewarmBenchmarkItemService
+
+@end
+
+
+@interface SDConnectionPrewarmerBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDServiceManager* serviceManager;
+@property (nonatomic, strong) NSMutableArray<SDBenchmarkHTTPServer*>* servers;
+@property (nonatomic, strong) AFSecurityPolicy* securityPolicy;
+
+@end
+
+@implementation SDConnectionPrewarmerBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    SecIdentityRef identity = [SDBenchmarkHTTPServer loopbackTLSIdentity];
+    XCTAssertTrue(identity != NULL);
+
+    // self-signed certificate of the stubs, pinned: the same policy is needed by real calls and by pre-warms
+    SecCertificateRef certificate = NULL;
+    SecIdentityCopyCertificate(identity, &certificate);
+    self.securityPolicy = [AFSecurityPolicy policyWithPinningMode:AFSSLPinningModeCertificate];
+    self.securityPolicy.pinnedCertificates = certificate ? @[(__bridge_transfer NSData*)SecCertificateCopyData(certificate)] : @[];
+    self.securityPolicy.allowInvalidCertificates = YES;
+    self.securityPolicy.validatesDomainName = NO;
+    if (certificate)
+    {
+        CFRelease(certificate);
+    }
+
+    self.serviceManager = [[SDServiceManager alloc] init];
+    self.serviceManager.connectionPrewarmer.securityPolicy = self.securityPolicy;
+    self.serviceManager.connectionPrewarmer.budget = BENCHMARK_PREWARM_BUDGET;
+    // reachability changes of the test host would pre-warm hosts again in the middle of a scenario
+    self.serviceManager.connectionPrewarmer.prewarmsOnReachabilityChange = NO;
+
+    self.servers = [NSMutableArray array];
+}
+
+- (void) tearDown
+{
+    [self.serviceManager.connectionPrewarmer cancelAllPrewarms];
+    self.serviceManager = nil;
+    for (SDBenchmarkHTTPServer* server in self.servers)
+    {
+        [server stop];
+    }
+    self.servers = nil;
+    [super tearDown];
+}
+
+- (SDBenchmarkHTTPServer*) startServer
+{
+    SDBenchmarkHTTPServer* server = [SDBenchmarkHTTPServer new];
+    server.TLSIdentity = [SDBenchmarkHTTPServer loopbackTLSIdentity];
+
+    NSData* itemData = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:1] } options:0 error:NULL];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:itemData];
+    } forPathPrefix:@"/items/"];
+
+    NSError* error = nil;
+    XCTAssertTrue([server startWithError:&error], @"%@", error);
+    [self.servers addObject:server];
+    return server;
+}
+
+- (SDPrewarmBenchmarkItemService*) itemServiceForServer:(SDBenchmarkHTTPServer*)server
+{
+    AFHTTPRequestOperationManager* requestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:server.baseURL];
+    requestOperationManager.requestSerializer = [AFJSONRequestSerializer serializer];
+    requestOperationManager.requestSerializer.HTTPMethodsEncodingParametersInURI = [NSSet setWithObjects:@"GET", @"HEAD", nil];
+    requestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+    requestOperationManager.securityPolicy = self.securityPolicy;
+
+    SDPrewarmBenchmarkItemService* service = [SDPrewarmBenchmarkItemService new];
+    service.requestOperationManager = requestOperationManager;
+    return service;
+}
+
+/**
+ *  Pre-warm all servers and spin the main run loop until every one of them answered.
+ */
+- (BOOL) prewarmServers:(NSArray<SDBenchmarkHTTPServer*>*)servers
+{
+    self.serviceManager.prewarmHosts = [servers valueForKey:NSStringFromSelector(@selector(baseURL))];
+
+    SDConnectionPrewarmer* prewarmer = self.serviceManager.connectionPrewarmer;
+    NSDate* deadline = [NSDate dateWithTimeIntervalSinceNow:BENCHMARK_PREWARM_TIMEOUT];
+    while (prewarmer.lastPrewarmDurations.count < servers.count && deadline.timeIntervalSinceNow > 0)
+    {
+        [[NSRunLoop mainRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    return prewarmer.lastPrewarmDurations.count >= servers.count;
+}
+
+#pragma mark - Tests
+
+- (void) testPrewarmedConnectionIsReused
+{
+    SDBenchmarkHTTPServer* server = [self startServer];
+    XCTAssertEqualObjects(server.baseURL.scheme, @"https");
+
+    XCTAssertTrue([self prewarmServers:@[server]]);
+    XCTAssertEqual(server.numberOfConnections, 1);
+    XCTAssertEqual(server.numberOfRequests, 1);
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"first call"];
+    SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+    request.itemId = @1;
+    __block SDBenchmarkItem* item = nil;
+    [self.serviceManager callService:[self itemServiceForServer:server] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+        item = [(SDBenchmarkItemResponse*)response item];
+        [expectation fulfill];
+    } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:BENCHMARK_PREWARM_TIMEOUT handler:nil];
+
+    // the body-less answer to the pre-warm leaves the connection ready for the real call
+    XCTAssertNotNil(item);
+    XCTAssertEqual(server.numberOfRequests, 2);
+    XCTAssertEqual(server.numberOfConnections, 1);
+}
+
+#pragma mark - Scenarios
+
+- (void) testFirstCallCold
+{
+    [self runFirstCallScenarioWithName:@"first_call_cold" prewarmed:NO];
+}
+
+- (void) testFirstCallPrewarmed
+{
+    [self runFirstCallScenarioWithName:@"first_call_prewarmed" prewarmed:YES];
+}
+
+- (void) runFirstCallScenarioWithName:(NSString*)name prewarmed:(BOOL)prewarmed
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    NSMutableArray<SDPrewarmBenchmarkItemService*>* services = [NSMutableArray array];
+    // calls one after the other, so that the handshakes of concurrent calls don't add up in the latency of each other
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:name numberOfCalls:[SDBenchmarkRunner scaledCount:BENCHMARK_FIRST_CALLS minimum:5] concurrency:1 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+        request.itemId = @(index);
+        [serviceManager callService:services[index] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion([(SDBenchmarkItemResponse*)response item] != nil);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        }];
+    }];
+
+    // warm-up calls go to their own servers too: they warm up the network stack, not the connections of measured calls
+    NSUInteger numberOfServers = scenario.warmupCalls + scenario.numberOfCalls;
+    for (NSUInteger i = 0; i < numberOfServers; i++)
+    {
+        [services addObject:[self itemServiceForServer:[self startServer]]];
+    }
+
+    NSMutableDictionary* parameters = [@{ @"tls" : @YES, @"prewarmed" : @(prewarmed) } mutableCopy];
+    if (prewarmed)
+    {
+        XCTAssertTrue([self prewarmServers:self.servers], @"Pre-warm didn't end in %.0f seconds", BENCHMARK_PREWARM_TIMEOUT);
+
+        double prewarmTime = 0;
+        for (NSNumber* duration in serviceManager.connectionPrewarmer.lastPrewarmDurations.allValues)
+        {
+            prewarmTime += duration.doubleValue;
+        }
+        parameters[@"prewarm_mean_ms"] = @(prewarmTime * 1000. / MAX(serviceManager.connectionPrewarmer.lastPrewarmDurations.count, 1));
+    }
+    scenario.parameters = parameters;
+
+    NSUInteger connectionsBefore = [[self.servers valueForKeyPath:@"@sum.numberOfConnections"] unsignedIntegerValue];
+    SDBenchmarkResult* result = [[SDBenchmarkRunner new] runScenario:scenario timeout:BENCHMARK_SCENARIO_TIMEOUT];
+    NSUInteger newConnections = [[self.servers valueForKeyPath:@"@sum.numberOfConnections"] unsignedIntegerValue] - connectionsBefore;
+
+    XCTAssertTrue(result.completed, @"Scenario %@ didn't complete in %d seconds", scenario.name, BENCHMARK_SCENARIO_TIMEOUT);
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+    // a cold call opens its connection, a pre-warmed one finds it open
+    XCTAssertEqual(newConnections, prewarmed ? 0 : numberOfServers);
+}
+
+@end
@@ -0,0 +1,350 @@
+//
+//  SDDeferredRequestQueueBenchmarks.m
+//  DockerTests
+//
+//  Deferrable calls against a local stub: analytics-like calls triggered one at a time, sent immediately and through SDDeferredRequestQueue,
+//  counting the bursts of traffic that reach the server (every burst wakes the cellular radio). Flush by urgent traffic, maximum delay,
+//  batch size, and calls saved and restored by a new queue as at next launch.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT).
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_DEFERRED_CALLS            20
+#define BENCHMARK_DEFERRED_CALL_INTERVAL    0.1
+#define BENCHMARK_DEFERRED_BURST_GAP        0.05
+#define BENCHMARK_DEFERRED_TIMEOUT          30.
+
+static AFHTTPRequestOperationManager* deferredRequestOperationManager = nil;
+
+@interface SDBenchmarkDeferredItemService : SDBenchmarkItemService
+
+@end
+
+@implementation SDBenchmarkDeferredItemService
+
+- (NSString*) pathResource
+{
+    return @"/deferred/:itemId";
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return deferredRequestOperationManager;
+}
+
+@end
+
+
+@interface SDBenchmarkUrgentItemService : SDBenchmarkDeferredItemService
+
+@end
+
+@implementation SDBenchmarkUrgentItemService
+
+- (NSString*) pathResource
+{
+    return @"/urgent/:itemId";
+}
+
+@end
+
+
+/**
+ *  Service manager of a relaunched app: sends calls restored from the deferred request queue.
+ */
+@interface SDBenchmarkDeferringServiceManager : SDServiceManager
+
+@end
+
+@implementation SDBenchmarkDeferringServiceManager
+
+@end
+
+
+@interface SDDeferredRequestQueueBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDBenchmarkHTTPServer* server;
+@property (nonatomic, strong) NSMutableArray<NSNumber*>* arrivalTimes;
+@property (nonatomic, strong) NSMutableArray<NSString*>* arrivalPaths;
+@property (nonatomic, strong) NSString* persistencePath;
+
+@end
+
+@implementation SDDeferredRequestQueueBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    self.arrivalTimes = [NSMutableArray array];
+    self.arrivalPaths = [NSMutableArray array];
+    self.server = [SDBenchmarkHTTPServer new];
+    [self installHandlersOnServer:self.server];
+    NSError* error = nil;
+    XCTAssertTrue([self.server startWithError:&error], @"%@", error);
+
+    deferredRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:self.server.baseURL];
+    deferredRequestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+    self.persistencePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"SDDeferredRequests-%@.plist", [NSUUID UUID].UUIDString]];
+}
+
+- (void) tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:self.persistencePath error:NULL];
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+- (void) installHandlersOnServer:(SDBenchmarkHTTPServer*)server
+{
+    __weak typeof (self) weakself = self;
+    SDBenchmarkHTTPHandler handler = ^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        NSString* itemId = [request.path lastPathComponent];
+        @synchronized (weakself)
+        {
+            [weakself.arrivalTimes addObject:@(CFAbsoluteTimeGetCurrent())];
+            [weakself.arrivalPaths addObject:request.path];
+        }
+        NSData* data = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:itemId.integerValue] } options:0 error:NULL];
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:data];
+    };
+    [server setHandler:handler forPathPrefix:@"/deferred"];
+    [server setHandler:handler forPathPrefix:@"/urgent"];
+}
+
+/**
+ *  Groups of requests that reached the server less than BENCHMARK_DEFERRED_BURST_GAP apart.
+ */
+- (NSUInteger) numberOfBursts
+{
+    NSArray<NSNumber*>* times = nil;
+    @synchronized (self)
+    {
+        times = [self.arrivalTimes sortedArrayUsingSelector:@selector(compare:)];
+    }
+    NSUInteger bursts = 0;
+    double previousTime = 0;
+    for (NSNumber* time in times)
+    {
+        if (bursts == 0 || time.doubleValue - previousTime > BENCHMARK_DEFERRED_BURST_GAP)
+        {
+            bursts++;
+        }
+        previousTime = time.doubleValue;
+    }
+    return bursts;
+}
+
+- (void) waitForDuration:(NSTimeInterval)duration
+{
+    XCTestExpectation* expectation = [self expectationWithDescription:@"wait"];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(duration * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:duration + 10 handler:nil];
+}
+
+- (SDServiceCallInfo*) callInfoWithService:(SDServiceGeneric*)service itemId:(NSUInteger)itemId deferrable:(BOOL)deferrable completion:(void (^)(BOOL success))completion
+{
+    SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+    request.itemId = @(itemId);
+    SDServiceCallInfo* serviceInfo = [[SDServiceCallInfo alloc] initWithService:service request:request];
+    serviceInfo.deferrable = deferrable;
+    serviceInfo.completionSuccess = ^(id<SDServiceGenericResponseProtocol> response) {
+        completion(YES);
+    };
+    serviceInfo.completionFailure = ^(id<SDServiceGenericErrorProtocol> error) {
+        completion(NO);
+    };
+    return serviceInfo;
+}
+
+/**
+ *  Calls triggered one at a time, then an urgent call. Returns the number of bursts.
+ */
+- (NSUInteger) runCallsWithQueue:(SDDeferredRequestQueue*)queue numberOfCalls:(NSUInteger)numberOfCalls name:(NSString*)name
+{
+    @synchronized (self)
+    {
+        [self.arrivalTimes removeAllObjects];
+        [self.arrivalPaths removeAllObjects];
+    }
+    SDServiceManager* serviceManager = [[SDServiceManager alloc] init];
+    serviceManager.deferredRequestQueue = queue;
+
+    XCTestExpectation* expectation = [self expectationWithDescription:name];
+    __block NSUInteger remaining = numberOfCalls + 1;
+    __block NSUInteger successes = 0;
+    void (^ completion)(BOOL) = ^(BOOL success) {
+        successes += success ? 1 : 0;
+        if (--remaining == 0)
+        {
+            [expectation fulfill];
+        }
+    };
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < numberOfCalls; i++)
+    {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(i * BENCHMARK_DEFERRED_CALL_INTERVAL * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            [serviceManager callServiceWithServiceCallInfo:[self callInfoWithService:[SDBenchmarkDeferredItemService new] itemId:i deferrable:YES completion:completion]];
+        });
+    }
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(numberOfCalls * BENCHMARK_DEFERRED_CALL_INTERVAL * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        XCTAssertEqual(queue.pendingRequests.count, queue ? numberOfCalls : 0);
+        [serviceManager callServiceWithServiceCallInfo:[self callInfoWithService:[SDBenchmarkUrgentItemService new] itemId:numberOfCalls deferrable:NO completion:completion]];
+    });
+    [self waitForExpectationsWithTimeout:BENCHMARK_DEFERRED_TIMEOUT handler:nil];
+
+    NSUInteger bursts = [self numberOfBursts];
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = numberOfCalls + 1;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = numberOfCalls + 1 - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.parameters = @{ @"deferrable_calls" : @(numberOfCalls),
+                           @"call_interval_ms" : @(BENCHMARK_DEFERRED_CALL_INTERVAL * 1000.),
+                           @"server_bursts" : @(bursts) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    XCTAssertEqual(successes, numberOfCalls + 1);
+    return bursts;
+}
+
+#pragma mark - Scenarios
+
+- (void) testDeferredCallsRideUrgentTraffic
+{
+    NSUInteger numberOfCalls = [SDBenchmarkRunner scaledCount:BENCHMARK_DEFERRED_CALLS minimum:5];
+    NSUInteger immediateBursts = [self runCallsWithQueue:nil numberOfCalls:numberOfCalls name:@"deferred_calls_immediate"];
+
+    SDDeferredRequestQueue* queue = [[SDDeferredRequestQueue alloc] initWithPersistencePath:nil];
+    queue.maximumBatchSize = numberOfCalls + 1;
+    NSUInteger deferredBursts = [self runCallsWithQueue:queue numberOfCalls:numberOfCalls name:@"deferred_calls_batched"];
+
+    // every immediate call wakes the radio, deferred ones leave with the urgent call
+    XCTAssertGreaterThanOrEqual(immediateBursts, numberOfCalls / 2);
+    XCTAssertLessThanOrEqual(deferredBursts, 2);
+    XCTAssertEqual(queue.numberOfFlushes, 1);
+    XCTAssertEqual(queue.numberOfSentRequests, numberOfCalls);
+    XCTAssertEqual(queue.lastFlushReason, SDDeferredRequestFlushReasonUrgentTraffic);
+    XCTAssertEqual(queue.pendingRequests.count, 0);
+}
+
+- (void) testMaximumDelayAndBatchSize
+{
+    SDDeferredRequestQueue* queue = [[SDDeferredRequestQueue alloc] initWithPersistencePath:nil];
+    queue.maximumDelay = 0.5;
+    queue.maximumBatchSize = 3;
+    SDServiceManager* serviceManager = [[SDServiceManager alloc] init];
+    serviceManager.deferredRequestQueue = queue;
+
+    // a lone call leaves after maximum delay
+    XCTestExpectation* delayExpectation = [self expectationWithDescription:@"delay"];
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    __block NSTimeInterval delay = 0;
+    [serviceManager callServiceWithServiceCallInfo:[self callInfoWithService:[SDBenchmarkDeferredItemService new] itemId:1 deferrable:YES completion:^(BOOL success) {
+        XCTAssertTrue(success);
+        delay = CFAbsoluteTimeGetCurrent() - startTime;
+        [delayExpectation fulfill];
+    }]];
+    XCTAssertEqual(self.server.numberOfRequests, 0);
+    [self waitForExpectationsWithTimeout:BENCHMARK_DEFERRED_TIMEOUT handler:nil];
+    XCTAssertGreaterThanOrEqual(delay, 0.5);
+    XCTAssertEqual(queue.lastFlushReason, SDDeferredRequestFlushReasonMaximumDelay);
+
+    // a full batch leaves immediately
+    XCTestExpectation* batchExpectation = [self expectationWithDescription:@"batch"];
+    __block NSUInteger remaining = 3;
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < 3; i++)
+    {
+        [serviceManager callServiceWithServiceCallInfo:[self callInfoWithService:[SDBenchmarkDeferredItemService new] itemId:i deferrable:YES completion:^(BOOL success) {
+            if (--remaining == 0)
+            {
+                [batchExpectation fulfill];
+            }
+        }]];
+    }
+    [self waitForExpectationsWithTimeout:BENCHMARK_DEFERRED_TIMEOUT handler:nil];
+    XCTAssertLessThan(CFAbsoluteTimeGetCurrent() - startTime, 0.5);
+    XCTAssertEqual(queue.lastFlushReason, SDDeferredRequestFlushReasonBatchSize);
+
+    // cancelled calls never leave
+    queue.maximumBatchSize = 10;
+    SDServiceCallInfo* cancelledInfo = [self callInfoWithService:[SDBenchmarkDeferredItemService new] itemId:99 deferrable:YES completion:^(BOOL success) {
+        XCTFail(@"cancelled deferred call sent");
+    }];
+    [serviceManager callServiceWithServiceCallInfo:cancelledInfo];
+    XCTAssertEqual(queue.pendingRequests.count, 1);
+    [serviceManager cancelServiceCallInfo:cancelledInfo];
+    XCTAssertEqual(queue.pendingRequests.count, 0);
+}
+
+- (void) testDeferredCallsRestoredAtNextLaunch
+{
+    NSUInteger numberOfCalls = 5;
+    SDDeferredRequestQueue* queue = [[SDDeferredRequestQueue alloc] initWithPersistencePath:self.persistencePath];
+    queue.flushesOnUrgentTraffic = NO;
+    queue.maximumNumberOfRequests = numberOfCalls - 1;
+    SDBenchmarkDeferringServiceManager* serviceManager = [[SDBenchmarkDeferringServiceManager alloc] init];
+    serviceManager.deferredRequestQueue = queue;
+    for (NSUInteger i = 0; i < numberOfCalls; i++)
+    {
+        [serviceManager callServiceWithServiceCallInfo:[self callInfoWithService:[SDBenchmarkDeferredItemService new] itemId:i deferrable:YES completion:^(BOOL success) {
+            XCTFail(@"deferred call sent before relaunch");
+        }]];
+    }
+    // bounded: the oldest call is discarded
+    XCTAssertEqual(queue.pendingRequests.count, numberOfCalls - 1);
+    XCTAssertEqual(queue.numberOfDiscardedRequests, 1);
+
+    // saving is asynchronous: wait for the last state of the queue
+    NSString* firstIdentifier = queue.pendingRequests.firstObject.identifier;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    while (![[[NSArray arrayWithContentsOfFile:self.persistencePath] firstObject][@"identifier"] isEqualToString:firstIdentifier] && CFAbsoluteTimeGetCurrent() - startTime < BENCHMARK_DEFERRED_TIMEOUT)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    [serviceManager.deferredRequestQueue setSendBlock:nil forOwnerName:NSStringFromClass([SDBenchmarkDeferringServiceManager class])];
+    serviceManager = nil;
+    queue = nil;
+
+    // next launch
+    SDDeferredRequestQueue* restoredQueue = [[SDDeferredRequestQueue alloc] initWithPersistencePath:self.persistencePath];
+    XCTAssertEqual(restoredQueue.pendingRequests.count, numberOfCalls - 1);
+    for (SDDeferredRequest* request in restoredQueue.pendingRequests)
+    {
+        XCTAssertTrue(request.isRestored);
+        XCTAssertNil(request.context);
+        XCTAssertEqualObjects(request.requestDescription, NSStringFromClass([SDBenchmarkDeferredItemService class]));
+    }
+    SDBenchmarkDeferringServiceManager* relaunchedServiceManager = [[SDBenchmarkDeferringServiceManager alloc] init];
+    relaunchedServiceManager.deferredRequestQueue = restoredQueue;
+    [restoredQueue flush];
+    XCTAssertEqual(restoredQueue.pendingRequests.count, 0);
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    while (self.server.numberOfRequests < numberOfCalls - 1 && CFAbsoluteTimeGetCurrent() - startTime < BENCHMARK_DEFERRED_TIMEOUT)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    NSArray<NSString*>* paths = nil;
+    @synchronized (self)
+    {
+        paths = [self.arrivalPaths sortedArrayUsingSelector:@selector(compare:)];
+    }
+    NSArray<NSString*>* expectedPaths = @[@"/deferred/1", @"/deferred/2", @"/deferred/3", @"/deferred/4"];
+    XCTAssertEqualObjects(paths, expectedPaths);
+}
+
+@end
@@ -0,0 +1,271 @@
+//
+//  SDNetworkQualityEstimatorBenchmarks.m
+//  DockerTests
+//
+//  SDNetworkQualityEstimator: cost of an observation, decay of estimates and classes of quality, and estimates measured passively
+//  from service calls against a local stub that adds a known latency and paces the body of large responses.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT).
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_QUALITY_OBSERVATIONS      100000
+#define BENCHMARK_QUALITY_SERVER_DELAY      0.3
+#define BENCHMARK_QUALITY_CHUNKS            8
+#define BENCHMARK_QUALITY_CHUNK_SIZE        8192
+#define BENCHMARK_QUALITY_CHUNK_INTERVAL    0.04
+#define BENCHMARK_QUALITY_CALLS             5
+#define BENCHMARK_QUALITY_TIMEOUT           30.
+
+static AFHTTPRequestOperationManager* qualityRequestOperationManager = nil;
+
+/**
+ *  Estimator with a fixed network type, so that reachability changes of the test host don't split observations.
+ */
+@interface SDBenchmarkNetworkQualityEstimator : SDNetworkQualityEstimator
+
+@end
+
+@implementation SDBenchmarkNetworkQualityEstimator
+
+- (NSString*) currentNetworkType
+{
+    return @"benchmark";
+}
+
+@end
+
+
+@interface SDBenchmarkQualityItemService : SDBenchmarkItemService
+
+@property (nonatomic, strong) NSString* path;
+
+@end
+
+@implementation SDBenchmarkQualityItemService
+
+- (NSString*) pathResource
+{
+    return self.path;
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return qualityRequestOperationManager;
+}
+
+@end
+
+
+@interface SDNetworkQualityEstimatorBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDBenchmarkHTTPServer* server;
+
+@end
+
+@implementation SDNetworkQualityEstimatorBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    self.server = [SDBenchmarkHTTPServer new];
+    [self installHandlersOnServer:self.server];
+    NSError* error = nil;
+    XCTAssertTrue([self.server startWithError:&error], @"%@", error);
+
+    qualityRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:self.server.baseURL];
+    qualityRequestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+}
+
+- (void) tearDown
+{
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+- (void) installHandlersOnServer:(SDBenchmarkHTTPServer*)server
+{
+    // small response after a fixed latency: round trip time observations
+    NSData* itemData = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:1] } options:0 error:NULL];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        [NSThread sleepForTimeInterval:BENCHMARK_QUALITY_SERVER_DELAY];
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:itemData];
+    } forPathPrefix:@"/quality/small"];
+
+    // large response paced in chunks, like a slow link: throughput observations
+    NSString* padding = [@"" stringByPaddingToLength:BENCHMARK_QUALITY_CHUNKS * BENCHMARK_QUALITY_CHUNK_SIZE withString:@"x" startingAtIndex:0];
+    NSData* largeData = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:2], @"padding" : padding } options:0 error:NULL];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        [NSThread sleepForTimeInterval:BENCHMARK_QUALITY_SERVER_DELAY];
+        SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:nil];
+        __block NSUInteger offset = 0;
+        response.bodyStreamBlock = ^NSData* {
+            if (offset >= largeData.length)
+            {
+                return nil;
+            }
+            if (offset > 0)
+            {
+                [NSThread sleepForTimeInterval:BENCHMARK_QUALITY_CHUNK_INTERVAL];
+            }
+            NSUInteger length = MIN(BENCHMARK_QUALITY_CHUNK_SIZE, largeData.length - offset);
+            NSData* chunk = [largeData subdataWithRange:NSMakeRange(offset, length)];
+            offset += length;
+            return chunk;
+        };
+        return response;
+    } forPathPrefix:@"/quality/large"];
+}
+
+- (void) callService:(SDBenchmarkQualityItemService*)service serviceManager:(SDServiceManager*)serviceManager times:(NSUInteger)times failures:(NSUInteger*)failures
+{
+    XCTestExpectation* expectation = [self expectationWithDescription:service.path];
+    __block NSUInteger remaining = times;
+    __block NSUInteger failed = 0;
+    __block void (^ nextCall)(void) = nil;
+    void (^ callCompleted)(void) = ^{
+        if (--remaining == 0)
+        {
+            [expectation fulfill];
+        }
+        else
+        {
+            nextCall();
+        }
+    };
+    // sequential calls, as concurrent ones would share the bandwidth
+    nextCall = ^{
+        SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+        request.itemId = @(remaining);
+        [serviceManager callService:service withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            callCompleted();
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            failed++;
+            callCompleted();
+        }];
+    };
+    nextCall();
+    [self waitForExpectationsWithTimeout:BENCHMARK_QUALITY_TIMEOUT handler:nil];
+    nextCall = nil;
+    *failures += failed;
+}
+
+#pragma mark - Scenarios
+
+- (void) testObservationsAndDecay
+{
+    SDBenchmarkNetworkQualityEstimator* estimator = [SDBenchmarkNetworkQualityEstimator new];
+    XCTAssertEqual(estimator.quality, SDNetworkQualityUnknown);
+
+    // cost of an observation, alternating small and large responses
+    NSUInteger numberOfObservations = [SDBenchmarkRunner scaledCount:BENCHMARK_QUALITY_OBSERVATIONS minimum:100];
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < numberOfObservations; i++)
+    {
+        if (i % 2 == 0)
+        {
+            [estimator addObservationWithDuration:0.05 receivedBytes:1024];
+        }
+        else
+        {
+            [estimator addObservationWithDuration:0.5 receivedBytes:1000000];
+        }
+    }
+    NSTimeInterval wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    SDNetworkQualityEstimate* estimate = estimator.currentEstimate;
+    XCTAssertEqual(estimate.numberOfRoundTripTimeObservations, (numberOfObservations + 1) / 2);
+    XCTAssertEqual(estimate.numberOfThroughputObservations, numberOfObservations / 2);
+    XCTAssertEqualWithAccuracy(estimate.roundTripTime, 0.05, 0.001);
+    // 8000 kbit in 0.45 seconds of transfer
+    XCTAssertEqualWithAccuracy(estimate.throughput, 8000. / 0.45, 10.);
+    XCTAssertEqual(estimate.quality, SDNetworkQuality4G);
+
+    // with a short half-life the estimate follows the network as soon as it gets worse
+    estimator.halfLife = 0.02;
+    [self expectationForNotification:SDNetworkQualityDidChangeNotification object:estimator handler:^BOOL(NSNotification* notification) {
+        return [(SDNetworkQualityEstimate*)notification.userInfo[SDNetworkQualityEstimateKey] quality] == SDNetworkQualitySlow2G;
+    }];
+    [NSThread sleepForTimeInterval:1.];
+    [estimator addObservationWithDuration:3. receivedBytes:512];
+    [estimator addObservationWithDuration:20. receivedBytes:40000];
+    XCTAssertGreaterThan(estimator.currentEstimate.roundTripTime, 2.9);
+    XCTAssertLessThan(estimator.currentEstimate.throughput, 40.);
+    XCTAssertEqual(estimator.quality, SDNetworkQualitySlow2G);
+    [self waitForExpectationsWithTimeout:BENCHMARK_QUALITY_TIMEOUT handler:nil];
+
+    // estimates are kept per network type
+    XCTAssertEqual([estimator estimateForNetworkType:@"wifi"].quality, SDNetworkQualityUnknown);
+    [estimator reset];
+    XCTAssertEqual(estimator.quality, SDNetworkQualityUnknown);
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = @"network_quality_observations";
+    result.numberOfCalls = numberOfObservations;
+    result.concurrency = 1;
+    result.successes = numberOfObservations;
+    result.completed = YES;
+    result.wallTime = wallTime;
+    result.parameters = @{ @"ns_per_observation" : @(wallTime * 1e9 / numberOfObservations) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+}
+
+- (void) testEstimatesFromServiceCalls
+{
+    SDBenchmarkNetworkQualityEstimator* estimator = [SDBenchmarkNetworkQualityEstimator new];
+    SDServiceManager* serviceManager = [[SDServiceManager alloc] init];
+    serviceManager.networkQualityEstimator = estimator;
+    __block SDNetworkQuality notifiedQuality = SDNetworkQualityUnknown;
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName:SDNetworkQualityDidChangeNotification object:estimator queue:nil usingBlock:^(NSNotification* notification) {
+        notifiedQuality = [(SDNetworkQualityEstimate*)notification.userInfo[SDNetworkQualityEstimateKey] quality];
+    }];
+
+    NSUInteger failures = 0;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    SDBenchmarkQualityItemService* smallService = [SDBenchmarkQualityItemService new];
+    smallService.path = @"/quality/small/:itemId";
+    [self callService:smallService serviceManager:serviceManager times:BENCHMARK_QUALITY_CALLS failures:&failures];
+    SDNetworkQualityEstimate* estimate = estimator.currentEstimate;
+    XCTAssertEqual(estimate.numberOfRoundTripTimeObservations, BENCHMARK_QUALITY_CALLS);
+    XCTAssertGreaterThanOrEqual(estimate.roundTripTime, BENCHMARK_QUALITY_SERVER_DELAY);
+    XCTAssertLessThan(estimate.roundTripTime, 1.);
+    XCTAssertEqual(estimate.quality, SDNetworkQuality3G);
+
+    SDBenchmarkQualityItemService* largeService = [SDBenchmarkQualityItemService new];
+    largeService.path = @"/quality/large/:itemId";
+    [self callService:largeService serviceManager:serviceManager times:BENCHMARK_QUALITY_CALLS failures:&failures];
+    estimate = estimator.currentEstimate;
+    NSTimeInterval wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+
+    // paced body: the latency of the server before the first chunk is excluded as round trip time
+    double pacedThroughput = BENCHMARK_QUALITY_CHUNKS * BENCHMARK_QUALITY_CHUNK_SIZE * 8. / 1000. / ((BENCHMARK_QUALITY_CHUNKS - 1) * BENCHMARK_QUALITY_CHUNK_INTERVAL);
+    XCTAssertEqual(failures, 0);
+    XCTAssertEqual(estimate.numberOfThroughputObservations, BENCHMARK_QUALITY_CALLS);
+    XCTAssertGreaterThan(estimate.throughput, 400.);
+    XCTAssertLessThan(estimate.throughput, pacedThroughput * 1.2);
+    XCTAssertEqual(notifiedQuality, estimate.quality);
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = @"network_quality_service_calls";
+    result.numberOfCalls = BENCHMARK_QUALITY_CALLS * 2;
+    result.concurrency = 1;
+    result.successes = BENCHMARK_QUALITY_CALLS * 2 - failures;
+    result.failures = failures;
+    result.completed = YES;
+    result.wallTime = wallTime;
+    result.parameters = @{ @"server_delay_ms" : @(BENCHMARK_QUALITY_SERVER_DELAY * 1000.),
+                           @"estimated_rtt_ms" : @(estimate.roundTripTime * 1000.),
+                           @"paced_throughput_kbps" : @(pacedThroughput),
+                           @"estimated_throughput_kbps" : @(estimate.throughput),
+                           @"quality" : NSStringFromSDNetworkQuality(estimate.quality) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+}
+
+@end
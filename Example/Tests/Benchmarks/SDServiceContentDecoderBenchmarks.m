@@ -0,0 +1,473 @@
+//
+//  SDServiceContentDecoderBenchmarks.m
+//  DockerTests
+//
+//  Content-Encoding decoders: calls of small pages of items against a local stub that compresses bodies (custom Content-Encoding x-deflate-dictionary)
+//  with the same dictionary the client loads from a bundle, measured against plain JSON and compression without dictionary.
+//  A large body sent in paced chunks must be decoded while it arrives, and bodies that can't be decoded (truncated, unknown dictionary or encoding) must fail the call.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT).
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import <zlib.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_CONTENT_ENCODING              @"x-deflate-dictionary"
+#define BENCHMARK_CONTENT_DECODER_CALLS         50
+#define BENCHMARK_CONTENT_DECODER_PAGE_COUNT    5
+#define BENCHMARK_CONTENT_DECODER_LARGE_COUNT   2000
+#define BENCHMARK_CONTENT_DECODER_CHUNKS        16
+#define BENCHMARK_CONTENT_DECODER_CHUNK_DELAY   0.02
+#define BENCHMARK_CONTENT_DECODER_TIMEOUT       30.
+
+typedef NS_ENUM (NSInteger, SDBenchmarkCompression)
+{
+    SDBenchmarkCompressionNone,
+    SDBenchmarkCompressionWithoutDictionary,
+    SDBenchmarkCompressionSharedDictionary,
+    SDBenchmarkCompressionUnknownDictionary,
+};
+
+static AFHTTPRequestOperationManager* contentDecoderRequestOperationManager = nil;
+
+@interface SDBenchmarkEncodedItemListService : SDBenchmarkItemListService
+
+@end
+
+@implementation SDBenchmarkEncodedItemListService
+
+- (NSString*) pathResource
+{
+    return @"/encoded/items";
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return contentDecoderRequestOperationManager;
+}
+
+@end
+
+
+/**
+ *  Forwards to a decoder and reports the decoded length after every chunk of the body.
+ */
+@interface SDBenchmarkRecordingContentDecoder : NSObject <SDServiceContentDecoder>
+
+@property (nonatomic, strong) id<SDServiceContentDecoder> decoder;
+@property (nonatomic, copy) void (^ decodedLengthBlock)(NSUInteger decodedLength);
+
+@end
+
+@implementation SDBenchmarkRecordingContentDecoder
+
+- (BOOL) decodeBytes:(const uint8_t*)bytes length:(NSUInteger)length intoData:(NSMutableData*)data error:(NSError**)error
+{
+    BOOL success = [self.decoder decodeBytes:bytes length:length intoData:data error:error];
+    self.decodedLengthBlock(data.length);
+    return success;
+}
+
+- (BOOL) finishIntoData:(NSMutableData*)data error:(NSError**)error
+{
+    return [self.decoder finishIntoData:data error:error];
+}
+
+@end
+
+
+@interface SDServiceContentDecoderBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDBenchmarkHTTPServer* server;
+@property (nonatomic, strong) NSData* dictionary;
+@property (nonatomic, strong) NSBundle* dictionaryBundle;
+
+/**
+ *  State of the stub, guarded by @synchronized (self).
+ */
+@property (nonatomic, assign) SDBenchmarkCompression compression;
+@property (nonatomic, strong) NSString* contentEncoding;
+@property (nonatomic, assign) BOOL streamsBody;
+@property (nonatomic, assign) BOOL truncatesBody;
+@property (nonatomic, strong) NSString* lastAcceptEncoding;
+@property (nonatomic, assign) NSUInteger bytesSent;
+@property (nonatomic, assign) BOOL sendingLastChunk;
+
+/**
+ *  Decoded bytes reported by the recording decoder, guarded by @synchronized (self).
+ */
+@property (nonatomic, assign) NSUInteger numberOfDecodedChunks;
+@property (nonatomic, assign) NSUInteger bytesDecodedBeforeLastChunk;
+
+@end
+
+@implementation SDServiceContentDecoderBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    // dictionary of typical items, shipped in a bundle (items of the pages are not in it)
+    NSMutableArray* sampleItems = [NSMutableArray array];
+    for (NSInteger i = 0; i < 20; i++)
+    {
+        [sampleItems addObject:[SDBenchmarkItem JSONObjectForIdentifier:10000 + i * 37]];
+    }
+    self.dictionary = [NSJSONSerialization dataWithJSONObject:sampleItems options:0 error:NULL];
+    NSString* bundlePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SDContentDecoderBenchmarks.bundle"];
+    [[NSFileManager defaultManager] removeItemAtPath:bundlePath error:NULL];
+    [[NSFileManager defaultManager] createDirectoryAtPath:bundlePath withIntermediateDirectories:YES attributes:nil error:NULL];
+    XCTAssertTrue([self.dictionary writeToFile:[bundlePath stringByAppendingPathComponent:@"items.zdict"] atomically:YES]);
+    self.dictionaryBundle = [NSBundle bundleWithPath:bundlePath];
+
+    self.contentEncoding = BENCHMARK_CONTENT_ENCODING;
+    self.server = [SDBenchmarkHTTPServer new];
+    [self installHandlersOnServer:self.server];
+    NSError* error = nil;
+    XCTAssertTrue([self.server startWithError:&error], @"%@", error);
+
+    contentDecoderRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:self.server.baseURL];
+    contentDecoderRequestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+}
+
+- (void) tearDown
+{
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+- (void) installHandlersOnServer:(SDBenchmarkHTTPServer*)server
+{
+    __weak typeof (self) weakself = self;
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        return [weakself responseForRequest:request];
+    } forPathPrefix:@"/encoded/items"];
+}
+
+- (SDBenchmarkHTTPResponse*) responseForRequest:(SDBenchmarkHTTPRequest*)request
+{
+    NSData* JSONData = [NSJSONSerialization dataWithJSONObject:[[self class] itemsWithCount:(NSUInteger)[request.queryParameters[@"count"] integerValue]] options:0 error:NULL];
+    SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:JSONData];
+    @synchronized (self)
+    {
+        self.lastAcceptEncoding = request.headers[@"accept-encoding"];
+        if (self.compression != SDBenchmarkCompressionNone && [self.lastAcceptEncoding rangeOfString:BENCHMARK_CONTENT_ENCODING].location != NSNotFound)
+        {
+            NSData* dictionary = nil;
+            if (self.compression == SDBenchmarkCompressionSharedDictionary)
+            {
+                dictionary = self.dictionary;
+            }
+            else if (self.compression == SDBenchmarkCompressionUnknownDictionary)
+            {
+                dictionary = [@"{\"id\":\"title\":\"summary\":\"another dictionary\"}" dataUsingEncoding:NSUTF8StringEncoding];
+            }
+            response.body = [[self class] compressedData:JSONData dictionary:dictionary];
+            NSMutableDictionary* headers = [response.headers mutableCopy];
+            headers[@"Content-Encoding"] = self.contentEncoding;
+            response.headers = headers;
+        }
+
+        if (self.streamsBody || self.truncatesBody)
+        {
+            // body in paced chunks, until the connection closes (a truncated body sends only half of them)
+            NSData* body = response.body;
+            NSUInteger chunkLength = (body.length + BENCHMARK_CONTENT_DECODER_CHUNKS - 1) / BENCHMARK_CONTENT_DECODER_CHUNKS;
+            NSUInteger numberOfChunks = self.truncatesBody ? BENCHMARK_CONTENT_DECODER_CHUNKS / 2 : BENCHMARK_CONTENT_DECODER_CHUNKS;
+            __block NSUInteger chunkIndex = 0;
+            __weak typeof (self) weakself = self;
+            response.body = nil;
+            response.bodyStreamBlock = ^NSData* {
+                NSUInteger location = chunkIndex * chunkLength;
+                if (chunkIndex >= numberOfChunks || location >= body.length)
+                {
+                    return nil;
+                }
+                if (chunkIndex > 0)
+                {
+                    [NSThread sleepForTimeInterval:BENCHMARK_CONTENT_DECODER_CHUNK_DELAY];
+                }
+                chunkIndex++;
+                if (chunkIndex == numberOfChunks || location + chunkLength >= body.length)
+                {
+                    @synchronized (weakself)
+                    {
+                        weakself.sendingLastChunk = YES;
+                    }
+                }
+                return [body subdataWithRange:NSMakeRange(location, MIN(chunkLength, body.length - location))];
+            };
+            self.bytesSent += body.length;
+        }
+        else
+        {
+            self.bytesSent += response.body.length;
+        }
+    }
+    return response;
+}
+
++ (NSData*) compressedData:(NSData*)data dictionary:(NSData*)dictionary
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    deflateInit(&stream, Z_BEST_COMPRESSION);
+    if (dictionary)
+    {
+        deflateSetDictionary(&stream, dictionary.bytes, (uInt)dictionary.length);
+    }
+    NSMutableData* compressedData = [NSMutableData dataWithLength:deflateBound(&stream, data.length)];
+    stream.next_in = (Bytef*)data.bytes;
+    stream.avail_in = (uInt)data.length;
+    stream.next_out = compressedData.mutableBytes;
+    stream.avail_out = (uInt)compressedData.length;
+    deflate(&stream, Z_FINISH);
+    compressedData.length = stream.total_out;
+    deflateEnd(&stream);
+    return compressedData;
+}
+
++ (NSArray*) itemsWithCount:(NSUInteger)count
+{
+    NSMutableArray* items = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [items addObject:[SDBenchmarkItem JSONObjectForIdentifier:i]];
+    }
+    return items;
+}
+
+- (SDServiceManager*) serviceManagerWithFactory:(SDServiceContentDecoderFactory)factory
+{
+    SDServiceManager* serviceManager = [SDServiceManager new];
+    serviceManager.deferredRequestQueue = nil;
+    [serviceManager registerContentDecoderFactory:factory forContentEncoding:BENCHMARK_CONTENT_ENCODING];
+    return serviceManager;
+}
+
+- (SDServiceContentDecoderFactory) bundleFactory
+{
+    return [SDServiceDeflateContentDecoder factoryWithDictionaries:[SDServiceDeflateContentDecoder dictionariesWithExtension:@"zdict" inBundle:self.dictionaryBundle]];
+}
+
+/**
+ *  Call the service: returns the mapped response, or nil and the error of the call.
+ */
+- (SDBenchmarkItemListResponse*) callWithServiceManager:(SDServiceManager*)serviceManager count:(NSUInteger)count error:(NSError**)error
+{
+    XCTestExpectation* expectation = [self expectationWithDescription:@"call"];
+    __block SDBenchmarkItemListResponse* result = nil;
+    __block NSError* callError = nil;
+    SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+    request.count = @(count);
+    [serviceManager callService:[SDBenchmarkEncodedItemListService new] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+        result = (SDBenchmarkItemListResponse*)response;
+        [expectation fulfill];
+    } completionFailure:^(id<SDServiceGenericErrorProtocol> failure) {
+        callError = failure.error;
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:BENCHMARK_CONTENT_DECODER_TIMEOUT handler:nil];
+    if (error)
+    {
+        *error = callError;
+    }
+    return result;
+}
+
+- (BOOL) isResponse:(SDBenchmarkItemListResponse*)response validForCount:(NSUInteger)count
+{
+    NSArray* titles = [[[self class] itemsWithCount:count] valueForKey:@"title"];
+    return [[response.items valueForKey:@"title"] isEqualToArray:titles];
+}
+
+- (SDBenchmarkResult*) measureCallsNamed:(NSString*)name compression:(SDBenchmarkCompression)compression
+{
+    @synchronized (self)
+    {
+        self.compression = compression;
+    }
+    SDServiceManager* serviceManager = [self serviceManagerWithFactory:[self bundleFactory]];
+
+    NSUInteger numberOfCalls = [SDBenchmarkRunner scaledCount:BENCHMARK_CONTENT_DECODER_CALLS minimum:5];
+    NSUInteger bytesSent = self.bytesSent;
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:numberOfCalls];
+    NSUInteger successes = 0;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < numberOfCalls; i++)
+    {
+        CFAbsoluteTime callStartTime = CFAbsoluteTimeGetCurrent();
+        SDBenchmarkItemListResponse* response = [self callWithServiceManager:serviceManager count:BENCHMARK_CONTENT_DECODER_PAGE_COUNT error:NULL];
+        [latencies addObject:@(CFAbsoluteTimeGetCurrent() - callStartTime)];
+        successes += [self isResponse:response validForCount:BENCHMARK_CONTENT_DECODER_PAGE_COUNT] ? 1 : 0;
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = numberOfCalls;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = numberOfCalls - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = @{ @"items" : @(BENCHMARK_CONTENT_DECODER_PAGE_COUNT), @"dictionary_bytes" : @(self.dictionary.length), @"bytes_per_call" : @((self.bytesSent - bytesSent) / numberOfCalls) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+#pragma mark - Scenarios
+
+- (void) testDecodingStream
+{
+    NSData* JSONData = [NSJSONSerialization dataWithJSONObject:[[self class] itemsWithCount:100] options:0 error:NULL];
+    NSData* compressedData = [[self class] compressedData:JSONData dictionary:self.dictionary];
+    NSDictionary* factories = @{ BENCHMARK_CONTENT_ENCODING : [self bundleFactory] };
+    NSHTTPURLResponse* response = [[NSHTTPURLResponse alloc] initWithURL:self.server.baseURL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:@{ @"Content-Encoding" : BENCHMARK_CONTENT_ENCODING }];
+    NSError* error = nil;
+    XCTAssertEqualObjects([SDServiceContentDecodingStream dataByDecodingData:compressedData response:response decoderFactories:factories error:&error], JSONData, @"%@", error);
+
+    // byte by byte, as the slowest network would deliver it
+    SDServiceContentDecodingStream* stream = [[SDServiceContentDecodingStream alloc] initWithDecoderFactories:factories responseBlock:^NSHTTPURLResponse* {
+        return response;
+    }];
+    [stream open];
+    for (NSUInteger i = 0; i < compressedData.length; i++)
+    {
+        XCTAssertEqual([stream write:(const uint8_t*)compressedData.bytes + i maxLength:1], 1);
+    }
+    XCTAssertEqualObjects(stream.decodedData, JSONData);
+    [stream close];
+
+    // encodings applied twice are decoded in reverse order
+    NSHTTPURLResponse* chainedResponse = [[NSHTTPURLResponse alloc] initWithURL:self.server.baseURL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:@{ @"content-encoding" : @"x-deflate-dictionary, identity, X-Deflate-Dictionary" }];
+    NSData* chainedData = [[self class] compressedData:compressedData dictionary:nil];
+    XCTAssertEqualObjects([SDServiceContentDecodingStream dataByDecodingData:chainedData response:chainedResponse decoderFactories:factories error:&error], JSONData, @"%@", error);
+
+    // encodings without factory are left to the system
+    NSHTTPURLResponse* gzipResponse = [[NSHTTPURLResponse alloc] initWithURL:self.server.baseURL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:@{ @"Content-Encoding" : @"gzip" }];
+    XCTAssertEqualObjects([SDServiceContentDecodingStream dataByDecodingData:JSONData response:gzipResponse decoderFactories:factories error:&error], JSONData);
+
+    // bytes after the end of the stream
+    NSMutableData* trailingData = [compressedData mutableCopy];
+    [trailingData appendData:[@"{}" dataUsingEncoding:NSUTF8StringEncoding]];
+    XCTAssertNil([SDServiceContentDecodingStream dataByDecodingData:trailingData response:response decoderFactories:factories error:&error]);
+    XCTAssertEqual(error.code, SDServiceContentDecoderErrorCodeInvalidData);
+    XCTAssertNil([SDServiceContentDecodingStream dataByDecodingData:[compressedData subdataWithRange:NSMakeRange(0, compressedData.length - 4)] response:response decoderFactories:factories error:&error]);
+    XCTAssertEqual(error.code, SDServiceContentDecoderErrorCodeTruncatedData);
+}
+
+- (void) testDictionaryCallsAgainstPlainCalls
+{
+    SDBenchmarkResult* plainCalls = [self measureCallsNamed:@"plain_json_calls" compression:SDBenchmarkCompressionNone];
+    XCTAssertEqual(plainCalls.failures, 0);
+    XCTAssertTrue([self.lastAcceptEncoding hasPrefix:BENCHMARK_CONTENT_ENCODING], @"%@", self.lastAcceptEncoding);
+    XCTAssertTrue([self.lastAcceptEncoding rangeOfString:@"gzip"].location != NSNotFound, @"%@", self.lastAcceptEncoding);
+
+    SDBenchmarkResult* deflateCalls = [self measureCallsNamed:@"deflate_calls" compression:SDBenchmarkCompressionWithoutDictionary];
+    XCTAssertEqual(deflateCalls.failures, 0);
+
+    SDBenchmarkResult* dictionaryCalls = [self measureCallsNamed:@"deflate_dictionary_calls" compression:SDBenchmarkCompressionSharedDictionary];
+    XCTAssertEqual(dictionaryCalls.failures, 0);
+
+    NSUInteger plainBytes = [plainCalls.parameters[@"bytes_per_call"] unsignedIntegerValue];
+    NSUInteger deflateBytes = [deflateCalls.parameters[@"bytes_per_call"] unsignedIntegerValue];
+    NSUInteger dictionaryBytes = [dictionaryCalls.parameters[@"bytes_per_call"] unsignedIntegerValue];
+    XCTAssertLessThan(deflateBytes, plainBytes);
+    XCTAssertLessThan(dictionaryBytes, deflateBytes / 2);
+}
+
+- (void) testIncrementalDecoding
+{
+    @synchronized (self)
+    {
+        self.compression = SDBenchmarkCompressionSharedDictionary;
+        self.streamsBody = YES;
+    }
+    SDServiceContentDecoderFactory bundleFactory = [self bundleFactory];
+    __weak typeof (self) weakself = self;
+    SDServiceManager* serviceManager = [self serviceManagerWithFactory:^id<SDServiceContentDecoder>(NSHTTPURLResponse* response) {
+        SDBenchmarkRecordingContentDecoder* decoder = [SDBenchmarkRecordingContentDecoder new];
+        decoder.decoder = bundleFactory(response);
+        decoder.decodedLengthBlock = ^(NSUInteger decodedLength) {
+            @synchronized (weakself)
+            {
+                weakself.numberOfDecodedChunks++;
+                if (!weakself.sendingLastChunk)
+                {
+                    weakself.bytesDecodedBeforeLastChunk = decodedLength;
+                }
+            }
+        };
+        return decoder;
+    }];
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    NSError* error = nil;
+    SDBenchmarkItemListResponse* response = [self callWithServiceManager:serviceManager count:BENCHMARK_CONTENT_DECODER_LARGE_COUNT error:&error];
+    CFAbsoluteTime callTime = CFAbsoluteTimeGetCurrent() - startTime;
+    XCTAssertTrue([self isResponse:response validForCount:BENCHMARK_CONTENT_DECODER_LARGE_COUNT], @"%@", error);
+
+    // most of the body is decoded before its last chunk is sent
+    NSUInteger decodedLength = [NSJSONSerialization dataWithJSONObject:[[self class] itemsWithCount:BENCHMARK_CONTENT_DECODER_LARGE_COUNT] options:0 error:NULL].length;
+    XCTAssertGreaterThan(self.numberOfDecodedChunks, 1);
+    XCTAssertGreaterThan(self.bytesDecodedBeforeLastChunk, decodedLength / 2);
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = @"incremental_decoding";
+    result.numberOfCalls = 1;
+    result.concurrency = 1;
+    result.successes = response ? 1 : 0;
+    result.failures = response ? 0 : 1;
+    result.completed = YES;
+    result.wallTime = callTime;
+    result.latencies = @[@(callTime)];
+    result.parameters = @{ @"items" : @(BENCHMARK_CONTENT_DECODER_LARGE_COUNT), @"chunks" : @(BENCHMARK_CONTENT_DECODER_CHUNKS), @"decoded_chunks" : @(self.numberOfDecodedChunks), @"bytes_decoded_before_last_chunk" : @(self.bytesDecodedBeforeLastChunk), @"decoded_bytes" : @(decodedLength) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+}
+
+- (void) testUndecodableBodiesFail
+{
+    SDServiceManager* serviceManager = [self serviceManagerWithFactory:[self bundleFactory]];
+    NSError* error = nil;
+
+    @synchronized (self)
+    {
+        self.compression = SDBenchmarkCompressionUnknownDictionary;
+    }
+    XCTAssertNil([self callWithServiceManager:serviceManager count:BENCHMARK_CONTENT_DECODER_PAGE_COUNT error:&error]);
+    XCTAssertEqualObjects(error.domain, SDServiceContentDecoderErrorDomain);
+    XCTAssertEqual(error.code, SDServiceContentDecoderErrorCodeDictionaryNotFound);
+
+    @synchronized (self)
+    {
+        self.compression = SDBenchmarkCompressionSharedDictionary;
+        self.truncatesBody = YES;
+    }
+    XCTAssertNil([self callWithServiceManager:serviceManager count:BENCHMARK_CONTENT_DECODER_LARGE_COUNT error:&error]);
+    XCTAssertEqualObjects(error.domain, SDServiceContentDecoderErrorDomain);
+    XCTAssertEqual(error.code, SDServiceContentDecoderErrorCodeTruncatedData);
+
+    @synchronized (self)
+    {
+        self.truncatesBody = NO;
+        self.contentEncoding = [NSString stringWithFormat:@"%@, x-unknown", BENCHMARK_CONTENT_ENCODING];
+    }
+    XCTAssertNil([self callWithServiceManager:serviceManager count:BENCHMARK_CONTENT_DECODER_PAGE_COUNT error:&error]);
+    XCTAssertEqualObjects(error.domain, SDServiceContentDecoderErrorDomain);
+    XCTAssertEqual(error.code, SDServiceContentDecoderErrorCodeUnsupportedEncoding);
+
+    // the same manager decodes the next good body
+    @synchronized (self)
+    {
+        self.contentEncoding = BENCHMARK_CONTENT_ENCODING;
+    }
+    XCTAssertTrue([self isResponse:[self callWithServiceManager:serviceManager count:BENCHMARK_CONTENT_DECODER_PAGE_COUNT error:&error] validForCount:BENCHMARK_CONTENT_DECODER_PAGE_COUNT], @"%@", error);
+}
+
+@end
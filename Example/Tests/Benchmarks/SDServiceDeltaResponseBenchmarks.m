@@ -0,0 +1,345 @@
+//
+//  SDServiceDeltaResponseBenchmarks.m
+//  DockerTests
+//
+//  Delta responses: JSON Patch operations of SDServiceJSONPatch, then calls of a large list that changes a few items between calls,
+//  against a local stub that answers 226 with a JSON Patch of the version the client has. Full calls of the same list are measured for comparison,
+//  models of unchanged items must be reused, and a patch that doesn't apply must fall back to a full call.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT).
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_DELTA_ITEMS               1000
+#define BENCHMARK_DELTA_CHANGED_ITEMS       5
+#define BENCHMARK_DELTA_CALLS               50
+#define BENCHMARK_DELTA_TIMEOUT             30.
+
+static AFHTTPRequestOperationManager* deltaRequestOperationManager = nil;
+
+@interface SDBenchmarkDeltaItemListService : SDBenchmarkItemListService
+
+@property (nonatomic, assign) BOOL deltaResponses;
+
+@end
+
+@implementation SDBenchmarkDeltaItemListService
+
+- (NSString*) pathResource
+{
+    return @"/delta/items";
+}
+
+- (BOOL) acceptsDeltaResponses
+{
+    return self.deltaResponses;
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return deltaRequestOperationManager;
+}
+
+@end
+
+
+@interface SDServiceDeltaResponseBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDBenchmarkHTTPServer* server;
+
+/**
+ *  State of the stub, guarded by @synchronized (self): current items and patches from every version to the next one.
+ */
+@property (nonatomic, strong) NSMutableArray* items;
+@property (nonatomic, strong) NSMutableArray<NSArray*>* patches;
+@property (nonatomic, assign) BOOL corruptsNextPatch;
+@property (nonatomic, assign) NSUInteger numberOfFullResponses;
+@property (nonatomic, assign) NSUInteger numberOfDeltaResponses;
+@property (nonatomic, assign) NSUInteger numberOfNotModifiedResponses;
+@property (nonatomic, assign) NSUInteger bytesSent;
+
+@end
+
+@implementation SDServiceDeltaResponseBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    self.items = [NSMutableArray arrayWithCapacity:BENCHMARK_DELTA_ITEMS];
+    for (NSInteger i = 0; i < BENCHMARK_DELTA_ITEMS; i++)
+    {
+        [self.items addObject:[SDBenchmarkItem JSONObjectForIdentifier:i]];
+    }
+    self.patches = [NSMutableArray array];
+
+    self.server = [SDBenchmarkHTTPServer new];
+    [self installHandlersOnServer:self.server];
+    NSError* error = nil;
+    XCTAssertTrue([self.server startWithError:&error], @"%@", error);
+
+    deltaRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:self.server.baseURL];
+    deltaRequestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+}
+
+- (void) tearDown
+{
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+- (void) installHandlersOnServer:(SDBenchmarkHTTPServer*)server
+{
+    __weak typeof (self) weakself = self;
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        return [weakself responseForRequest:request];
+    } forPathPrefix:@"/delta/items"];
+}
+
+- (SDBenchmarkHTTPResponse*) responseForRequest:(SDBenchmarkHTTPRequest*)request
+{
+    @synchronized (self)
+    {
+        NSUInteger version = self.patches.count;
+        NSString* entityTag = [NSString stringWithFormat:@"\"v%lu\"", (unsigned long)version];
+        NSString* baseTag = request.headers[@"if-none-match"];
+        NSUInteger baseVersion = baseTag.length > 3 ? (NSUInteger)[[baseTag substringWithRange:NSMakeRange(2, baseTag.length - 3)] integerValue] : NSNotFound;
+        BOOL acceptsPatch = request.headers[@"a-im"] && [request.headers[@"a-im"] rangeOfString:@"json-patch"].location != NSNotFound;
+
+        SDBenchmarkHTTPResponse* response = nil;
+        if (acceptsPatch && baseVersion == version)
+        {
+            self.numberOfNotModifiedResponses++;
+            response = [SDBenchmarkHTTPResponse responseWithStatusCode:304 JSONData:nil];
+        }
+        else if (acceptsPatch && baseVersion < version)
+        {
+            self.numberOfDeltaResponses++;
+            NSMutableArray* operations = [NSMutableArray array];
+            if (self.corruptsNextPatch)
+            {
+                self.corruptsNextPatch = NO;
+                [operations addObject:@{ @"op" : @"test", @"path" : @"/0/id", @"value" : @(-1) }];
+            }
+            for (NSUInteger i = baseVersion; i < version; i++)
+            {
+                [operations addObjectsFromArray:self.patches[i]];
+            }
+            response = [SDBenchmarkHTTPResponse responseWithStatusCode:226 JSONData:[NSJSONSerialization dataWithJSONObject:operations options:0 error:NULL]];
+            NSMutableDictionary* headers = [response.headers mutableCopy];
+            headers[@"Content-Type"] = @"application/json-patch+json";
+            headers[@"IM"] = @"json-patch";
+            headers[@"Delta-Base"] = baseTag;
+            response.headers = headers;
+        }
+        else
+        {
+            self.numberOfFullResponses++;
+            response = [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:[NSJSONSerialization dataWithJSONObject:self.items options:0 error:NULL]];
+        }
+
+        NSMutableDictionary* headers = [response.headers mutableCopy];
+        headers[@"ETag"] = entityTag;
+        response.headers = headers;
+        self.bytesSent += response.body.length;
+        return response;
+    }
+}
+
+/**
+ *  New version of the list: a few items change title, one is appended and the first one is removed.
+ */
+- (void) advanceVersion
+{
+    @synchronized (self)
+    {
+        NSUInteger version = self.patches.count;
+        NSMutableArray* operations = [NSMutableArray array];
+        for (NSUInteger i = 0; i < BENCHMARK_DELTA_CHANGED_ITEMS; i++)
+        {
+            // never the first item, removed below
+            NSUInteger index = 1 + (version * 7 + i * 131) % (self.items.count - 1);
+            NSString* title = [NSString stringWithFormat:@"Item %lu version %lu", (unsigned long)index, (unsigned long)version + 1];
+            NSMutableDictionary* item = [self.items[index] mutableCopy];
+            item[@"title"] = title;
+            self.items[index] = item;
+            [operations addObject:@{ @"op" : @"replace", @"path" : [NSString stringWithFormat:@"/%lu/title", (unsigned long)index], @"value" : title }];
+        }
+
+        NSDictionary* newItem = [SDBenchmarkItem JSONObjectForIdentifier:BENCHMARK_DELTA_ITEMS + version];
+        [self.items addObject:newItem];
+        [operations addObject:@{ @"op" : @"add", @"path" : @"/-", @"value" : newItem }];
+        [self.items removeObjectAtIndex:0];
+        [operations addObject:@{ @"op" : @"remove", @"path" : @"/0" }];
+        [self.patches addObject:operations];
+    }
+}
+
+- (SDBenchmarkItemListResponse*) callService:(SDBenchmarkDeltaItemListService*)service serviceManager:(SDServiceManager*)serviceManager
+{
+    XCTestExpectation* expectation = [self expectationWithDescription:@"call"];
+    __block SDBenchmarkItemListResponse* result = nil;
+    SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+    request.count = @(BENCHMARK_DELTA_ITEMS);
+    [serviceManager callService:service withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+        result = (SDBenchmarkItemListResponse*)response;
+        [expectation fulfill];
+    } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:BENCHMARK_DELTA_TIMEOUT handler:nil];
+    return result;
+}
+
+/**
+ *  Titles of the items of the stub, to compare with the mapped items.
+ */
+- (NSArray<NSString*>*) currentTitles
+{
+    @synchronized (self)
+    {
+        return [self.items valueForKey:@"title"];
+    }
+}
+
+- (SDBenchmarkResult*) measureCallsNamed:(NSString*)name deltaResponses:(BOOL)deltaResponses
+{
+    SDServiceManager* serviceManager = [SDServiceManager new];
+    serviceManager.deferredRequestQueue = nil;
+    SDBenchmarkDeltaItemListService* service = [SDBenchmarkDeltaItemListService new];
+    service.deltaResponses = deltaResponses;
+
+    // first call downloads the whole list
+    XCTAssertNotNil([self callService:service serviceManager:serviceManager]);
+
+    NSUInteger numberOfCalls = [SDBenchmarkRunner scaledCount:BENCHMARK_DELTA_CALLS minimum:5];
+    NSUInteger bytesSent = self.bytesSent;
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:numberOfCalls];
+    NSUInteger successes = 0;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < numberOfCalls; i++)
+    {
+        [self advanceVersion];
+        CFAbsoluteTime callStartTime = CFAbsoluteTimeGetCurrent();
+        SDBenchmarkItemListResponse* response = [self callService:service serviceManager:serviceManager];
+        [latencies addObject:@(CFAbsoluteTimeGetCurrent() - callStartTime)];
+        if ([[response.items valueForKey:@"title"] isEqualToArray:[self currentTitles]])
+        {
+            successes++;
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = numberOfCalls;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = numberOfCalls - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = @{ @"items" : @(BENCHMARK_DELTA_ITEMS), @"changed_items" : @(BENCHMARK_DELTA_CHANGED_ITEMS + 2), @"bytes_per_call" : @((self.bytesSent - bytesSent) / numberOfCalls) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+#pragma mark - Scenarios
+
+- (void) testPatchOperations
+{
+    NSDictionary* document = @{ @"foo" : @[@"bar", @"baz"], @"a/b" : @1, @"m~n" : @2, @"untouched" : @{ @"x" : @1 } };
+    NSArray* patch = @[
+                       @{ @"op" : @"add", @"path" : @"/foo/1", @"value" : @"qux" },
+                       @{ @"op" : @"replace", @"path" : @"/a~1b", @"value" : @3 },
+                       @{ @"op" : @"remove", @"path" : @"/m~0n" },
+                       @{ @"op" : @"copy", @"from" : @"/foo", @"path" : @"/copy" },
+                       @{ @"op" : @"move", @"from" : @"/foo/0", @"path" : @"/moved" },
+                       @{ @"op" : @"add", @"path" : @"/foo/-", @"value" : @"end" },
+                       @{ @"op" : @"test", @"path" : @"/copy/1", @"value" : @"qux" }
+                       ];
+    NSError* error = nil;
+    NSDictionary* patched = [SDServiceJSONPatch objectByApplyingPatch:patch toObject:document error:&error];
+    NSDictionary* expected = @{ @"foo" : @[@"qux", @"baz", @"end"], @"a/b" : @3, @"copy" : @[@"bar", @"qux", @"baz"], @"moved" : @"bar", @"untouched" : @{ @"x" : @1 } };
+    XCTAssertEqualObjects(patched, expected, @"%@", error);
+
+    // the document is not modified and untouched parts are shared
+    XCTAssertEqualObjects(document[@"foo"], (@[@"bar", @"baz"]));
+    XCTAssertTrue(patched[@"untouched"] == document[@"untouched"]);
+
+    // patches apply entirely or not at all
+    NSArray* failingPatch = @[ @{ @"op" : @"remove", @"path" : @"/foo/0" }, @{ @"op" : @"test", @"path" : @"/a~1b", @"value" : @2 } ];
+    XCTAssertNil([SDServiceJSONPatch objectByApplyingPatch:failingPatch toObject:document error:&error]);
+    XCTAssertEqual(error.code, SDServiceJSONPatchErrorCodeTestFailed);
+    XCTAssertNil([SDServiceJSONPatch objectByApplyingPatch:@[ @{ @"op" : @"replace", @"path" : @"/missing", @"value" : @1 } ] toObject:document error:&error]);
+    XCTAssertEqual(error.code, SDServiceJSONPatchErrorCodePathNotFound);
+    XCTAssertNil([SDServiceJSONPatch objectByApplyingPatch:@[ @{ @"op" : @"remove", @"path" : @"/foo/01" } ] toObject:document error:&error]);
+    XCTAssertEqual(error.code, SDServiceJSONPatchErrorCodePathNotFound);
+    XCTAssertNil([SDServiceJSONPatch objectByApplyingPatch:@[ @{ @"op" : @"move", @"from" : @"/untouched", @"path" : @"/untouched/x/y" } ] toObject:document error:&error]);
+    XCTAssertEqual(error.code, SDServiceJSONPatchErrorCodeInvalidPatch);
+    XCTAssertNil([SDServiceJSONPatch objectByApplyingPatch:@[ @{ @"op" : @"merge", @"path" : @"/foo" } ] toObject:document error:&error]);
+    XCTAssertEqual(error.code, SDServiceJSONPatchErrorCodeInvalidPatch);
+    XCTAssertEqualObjects(document[@"foo"], (@[@"bar", @"baz"]));
+}
+
+- (void) testDeltaCallsAgainstFullCalls
+{
+    SDBenchmarkResult* fullCalls = [self measureCallsNamed:@"full_list_calls" deltaResponses:NO];
+    XCTAssertEqual(fullCalls.failures, 0);
+    XCTAssertEqual(self.numberOfDeltaResponses, 0);
+
+    SDBenchmarkResult* deltaCalls = [self measureCallsNamed:@"delta_list_calls" deltaResponses:YES];
+    XCTAssertEqual(deltaCalls.failures, 0);
+    XCTAssertEqual(self.numberOfDeltaResponses, deltaCalls.numberOfCalls);
+    XCTAssertLessThan([deltaCalls.parameters[@"bytes_per_call"] unsignedIntegerValue], [fullCalls.parameters[@"bytes_per_call"] unsignedIntegerValue] / 10);
+}
+
+- (void) testModelsReusedAndFallback
+{
+    SDServiceManager* serviceManager = [SDServiceManager new];
+    serviceManager.deferredRequestQueue = nil;
+    SDBenchmarkDeltaItemListService* service = [SDBenchmarkDeltaItemListService new];
+    service.deltaResponses = YES;
+
+    SDBenchmarkItemListResponse* first = [self callService:service serviceManager:serviceManager];
+    XCTAssertEqual(first.items.count, BENCHMARK_DELTA_ITEMS);
+
+    // unchanged list: 304 returns the cached response
+    SDBenchmarkItemListResponse* notModified = [self callService:service serviceManager:serviceManager];
+    XCTAssertEqual(self.numberOfNotModifiedResponses, 1);
+    XCTAssertEqualObjects(notModified.items, first.items);
+
+    // only changed items are mapped again: the first one was removed, the others are the same models
+    [self advanceVersion];
+    SDBenchmarkItemListResponse* second = [self callService:service serviceManager:serviceManager];
+    XCTAssertEqual(self.numberOfDeltaResponses, 1);
+    XCTAssertEqualObjects([second.items valueForKey:@"title"], [self currentTitles]);
+    NSUInteger reusedModels = 0;
+    for (NSUInteger i = 0; i + 1 < second.items.count; i++)
+    {
+        reusedModels += second.items[i] == first.items[i + 1] ? 1 : 0;
+    }
+    XCTAssertEqual(reusedModels, BENCHMARK_DELTA_ITEMS - 1 - BENCHMARK_DELTA_CHANGED_ITEMS);
+
+    // a patch that doesn't apply is followed by a full call
+    [self advanceVersion];
+    self.corruptsNextPatch = YES;
+    NSUInteger numberOfFullResponses = self.numberOfFullResponses;
+    SDBenchmarkItemListResponse* third = [self callService:service serviceManager:serviceManager];
+    XCTAssertEqual(self.numberOfDeltaResponses, 2);
+    XCTAssertEqual(self.numberOfFullResponses, numberOfFullResponses + 1);
+    XCTAssertEqualObjects([third.items valueForKey:@"title"], [self currentTitles]);
+
+    // and deltas start again from the full document
+    [self advanceVersion];
+    SDBenchmarkItemListResponse* fourth = [self callService:service serviceManager:serviceManager];
+    XCTAssertEqual(self.numberOfDeltaResponses, 3);
+    XCTAssertEqualObjects([fourth.items valueForKey:@"title"], [self currentTitles]);
+}
+
+@end
@@ -0,0 +1,222 @@
+//
+//  SDServiceEventStreamBenchmarks.m
+//  DockerTests
+//
+//  SDServiceEventStreamConnection against a local text/event-stream stub: incremental parsing of events split in small chunks,
+//  mapping of payloads, reconnection with Last-Event-ID and delivery latency of pushed events.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT), latencies are the time from the write of an event on the server to its delivery on main thread.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_EVENTS                    2000
+#define BENCHMARK_EVENTS_CHUNK_SIZE         7
+#define BENCHMARK_EVENTS_TIMEOUT            60
+
+static AFHTTPRequestOperationManager* eventStreamRequestOperationManager = nil;
+
+@interface SDBenchmarkEventStream : SDServiceEventStream
+
+@property (nonatomic, strong) NSString* path;
+
+@end
+
+@implementation SDBenchmarkEventStream
+
+- (NSString*) pathResource
+{
+    return self.path;
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return eventStreamRequestOperationManager;
+}
+
+- (Class) responseClass
+{
+    return [SDBenchmarkItemResponse class];
+}
+
+- (NSTimeInterval) reconnectionTime
+{
+    return 0.05;
+}
+
+@end
+
+
+@interface SDServiceEventStreamBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDBenchmarkHTTPServer* server;
+
+@end
+
+@implementation SDServiceEventStreamBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    self.server = [SDBenchmarkHTTPServer new];
+    NSError* error = nil;
+    XCTAssertTrue([self.server startWithError:&error], @"%@", error);
+    eventStreamRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:self.server.baseURL];
+}
+
+- (void) tearDown
+{
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+/**
+ *  Text of an event with the item identifier, with a comment, a multi-line payload and CRLF line ends to exercise the parser.
+ */
++ (NSData*) eventDataWithIdentifier:(NSUInteger)identifier
+{
+    NSData* itemData = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:identifier], @"sent_at" : @(CFAbsoluteTimeGetCurrent()) } options:NSJSONWritingPrettyPrinted error:NULL];
+    NSString* payload = [[NSString alloc] initWithData:itemData encoding:NSUTF8StringEncoding];
+    NSMutableString* event = [NSMutableString stringWithFormat:@": heartbeat\r\nevent: item\r\nid: %lu\r\n", (unsigned long)identifier];
+    for (NSString* line in [payload componentsSeparatedByString:@"\n"])
+    {
+        [event appendFormat:@"data: %@\r\n", line];
+    }
+    [event appendString:@"\r\n"];
+    return [event dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (SDBenchmarkHTTPResponse*) streamResponseWithEventsFrom:(NSUInteger)firstIdentifier count:(NSUInteger)count
+{
+    SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse new];
+    response.statusCode = 200;
+    response.headers = @{ @"Content-Type" : @"text/event-stream" };
+    __block NSUInteger identifier = firstIdentifier;
+    __block NSData* pendingData = nil;
+    __block NSUInteger offset = 0;
+    response.bodyStreamBlock = ^NSData* {
+        if (offset == pendingData.length)
+        {
+            if (identifier == firstIdentifier + count)
+            {
+                return nil;
+            }
+            pendingData = [SDServiceEventStreamBenchmarks eventDataWithIdentifier:identifier++];
+            offset = 0;
+        }
+        // small chunks: lines and CRLF split between reads
+        NSRange range = NSMakeRange(offset, MIN(BENCHMARK_EVENTS_CHUNK_SIZE, pendingData.length - offset));
+        offset += range.length;
+        return [pendingData subdataWithRange:range];
+    };
+    return response;
+}
+
+#pragma mark - Scenarios
+
+- (void) testEventsDelivery
+{
+    NSUInteger numberOfEvents = [SDBenchmarkRunner scaledCount:BENCHMARK_EVENTS minimum:10];
+    __weak typeof (self) weakself = self;
+    [self.server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        return [weakself streamResponseWithEventsFrom:0 count:numberOfEvents];
+    } forPathPrefix:@"/events"];
+
+    SDBenchmarkEventStream* service = [SDBenchmarkEventStream new];
+    service.path = @"/events";
+    SDServiceEventStreamConnection* connection = [[SDServiceEventStreamConnection alloc] initWithService:service request:nil];
+    NSMutableArray<SDServiceEvent*>* events = [NSMutableArray array];
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray array];
+    XCTestExpectation* expectation = [self expectationWithDescription:@"events"];
+    connection.eventHandler = ^(SDServiceEvent* event) {
+        NSDictionary* JSONObject = [NSJSONSerialization JSONObjectWithData:[event.data dataUsingEncoding:NSUTF8StringEncoding] options:0 error:NULL];
+        [latencies addObject:@(CFAbsoluteTimeGetCurrent() - [JSONObject[@"sent_at"] doubleValue])];
+        [events addObject:event];
+        if (events.count == numberOfEvents)
+        {
+            [expectation fulfill];
+        }
+    };
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    [connection open];
+    [self waitForExpectationsWithTimeout:BENCHMARK_EVENTS_TIMEOUT handler:nil];
+    NSTimeInterval wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    [connection close];
+
+    NSUInteger successes = 0;
+    for (NSUInteger i = 0; i < events.count; i++)
+    {
+        SDServiceEvent* event = events[i];
+        XCTAssertEqualObjects(event.type, @"item");
+        XCTAssertEqualObjects(event.identifier, ([NSString stringWithFormat:@"%lu", (unsigned long)i]));
+        XCTAssertNil(event.mappingError);
+        successes += [[(SDBenchmarkItemResponse*)event.response item].identifier unsignedIntegerValue] == i ? 1 : 0;
+    }
+    XCTAssertEqual(successes, numberOfEvents);
+    XCTAssertEqualObjects(connection.lastEventIdentifier, ([NSString stringWithFormat:@"%lu", (unsigned long)numberOfEvents - 1]));
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = @"event_stream_delivery";
+    result.numberOfCalls = numberOfEvents;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = numberOfEvents - successes;
+    result.completed = YES;
+    result.wallTime = wallTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = @{ @"chunk_size" : @(BENCHMARK_EVENTS_CHUNK_SIZE) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+}
+
+- (void) testReconnectionWithLastEventID
+{
+    // every connection sends 5 events after the last one received, then the server closes it
+    NSMutableArray<NSString*>* lastEventIdentifiers = [NSMutableArray array];
+    __weak typeof (self) weakself = self;
+    [self.server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        NSString* lastEventIdentifier = request.headers[@"last-event-id"];
+        @synchronized (lastEventIdentifiers)
+        {
+            [lastEventIdentifiers addObject:lastEventIdentifier ?: @""];
+        }
+        NSUInteger firstIdentifier = lastEventIdentifier ? (NSUInteger)lastEventIdentifier.integerValue + 1 : 0;
+        return [weakself streamResponseWithEventsFrom:firstIdentifier count:5];
+    } forPathPrefix:@"/events"];
+
+    SDBenchmarkEventStream* service = [SDBenchmarkEventStream new];
+    service.path = @"/events";
+    SDServiceEventStreamConnection* connection = [[SDServiceEventStreamConnection alloc] initWithService:service request:nil];
+    NSMutableArray<NSString*>* identifiers = [NSMutableArray array];
+    XCTestExpectation* expectation = [self expectationWithDescription:@"events"];
+    connection.eventHandler = ^(SDServiceEvent* event) {
+        [identifiers addObject:event.identifier];
+        if (identifiers.count == 15)
+        {
+            [expectation fulfill];
+        }
+    };
+    [connection open];
+    [self waitForExpectationsWithTimeout:BENCHMARK_EVENTS_TIMEOUT handler:nil];
+    [connection close];
+
+    NSMutableArray<NSString*>* expectedIdentifiers = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 15; i++)
+    {
+        [expectedIdentifiers addObject:[NSString stringWithFormat:@"%lu", (unsigned long)i]];
+    }
+    XCTAssertEqualObjects(identifiers, expectedIdentifiers);
+    XCTAssertGreaterThanOrEqual(connection.numberOfReconnections, 2);
+    @synchronized (lastEventIdentifiers)
+    {
+        XCTAssertEqualObjects([lastEventIdentifiers subarrayWithRange:NSMakeRange(0, 3)], (@[@"", @"4", @"9"]));
+    }
+}
+
+@end
@@ -0,0 +1,582 @@
+//
+//  SDServiceJSONDecoderBenchmarks.m
+//  DockerTests
+//
+//  Models read by SDServiceJSONDecoder against NSJSONSerialization plus MTLJSONAdapter: both must give equal models, or both fail.
+//  Strings with escapes and surrogate pairs, numbers, key paths through null and non-objects, nested models and arrays of models,
+//  classes read by MTLJSONAdapter (classForParsingJSONDictionary:, arrays of key paths) and malformed data.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT), latencies are the time to read the whole response in every run.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkRunner.h"
+#import "SDBenchmarkServices.h"
+
+#define BENCHMARK_DECODER_ITEMS             1000
+#define BENCHMARK_DECODER_RUNS              20
+#define BENCHMARK_DECODER_MAXIMUM_DEPTH     512
+
+@interface SDDecoderBenchmarkOwner : MTLModel <MTLJSONSerializing>
+
+@property (nonatomic, strong) NSNumber* identifier;
+@property (nonatomic, strong) NSString* displayName;
+@property (nonatomic, strong) NSString* city;
+
+@end
+
+@implementation SDDecoderBenchmarkOwner
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"identifier" : @"id",
+             @"displayName" : @"display_name",
+             @"city" : @"address.city"
+             };
+}
+
+@end
+
+/**
+ *  Class chosen from the JSON object: read by MTLJSONAdapter.
+ */
+@interface SDDecoderBenchmarkShape : MTLModel <MTLJSONSerializing>
+
+@property (nonatomic, strong) NSString* type;
+@property (nonatomic, strong) NSString* name;
+
+@end
+
+@interface SDDecoderBenchmarkCircle : SDDecoderBenchmarkShape
+
+@property (nonatomic, strong) NSNumber* radius;
+
+@end
+
+@implementation SDDecoderBenchmarkShape
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"type" : @"type",
+             @"name" : @"name"
+             };
+}
+
++ (Class) classForParsingJSONDictionary:(NSDictionary*)JSONDictionary
+{
+    return [JSONDictionary[@"type"] isEqual:@"circle"] ? [SDDecoderBenchmarkCircle class] : self;
+}
+
+@end
+
+@implementation SDDecoderBenchmarkCircle
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    NSMutableDictionary* keyPaths = [[super JSONKeyPathsByPropertyKey] mutableCopy];
+    keyPaths[@"radius"] = @"radius";
+    return keyPaths;
+}
+
+@end
+
+/**
+ *  Property mapped to an array of key paths: read by MTLJSONAdapter.
+ */
+@interface SDDecoderBenchmarkLocation : MTLModel <MTLJSONSerializing>
+
+@property (nonatomic, strong) NSString* name;
+@property (nonatomic, strong) NSDictionary* coordinates;
+
+@end
+
+@implementation SDDecoderBenchmarkLocation
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"name" : @"name",
+             @"coordinates" : @[@"lat", @"lng"]
+             };
+}
+
+@end
+
+@interface SDDecoderBenchmarkItem : MTLModel <SDServiceJSONDecoding>
+
+@property (nonatomic, strong) NSNumber* identifier;
+@property (nonatomic, strong) NSString* name;
+@property (nonatomic, strong) NSString* nickname;
+@property (nonatomic, strong) NSNumber* age;
+@property (nonatomic, strong) NSString* country;
+@property (nonatomic, assign) BOOL active;
+@property (nonatomic, assign) double score;
+@property (nonatomic, strong) NSNumber* count;
+@property (nonatomic, strong) NSURL* url;
+@property (nonatomic, strong) NSDate* date;
+@property (nonatomic, strong) SDDecoderBenchmarkOwner* owner;
+@property (nonatomic, strong) SDDecoderBenchmarkOwner* reviewer;
+@property (nonatomic, strong) NSArray<SDDecoderBenchmarkOwner*>* contributors;
+@property (nonatomic, strong) NSArray<SDDecoderBenchmarkShape*>* shapes;
+@property (nonatomic, strong) SDDecoderBenchmarkLocation* location;
+@property (nonatomic, strong) NSArray* tags;
+@property (nonatomic, strong) NSDictionary* metadata;
+
+@end
+
+@implementation SDDecoderBenchmarkItem
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"identifier" : @"id",
+             @"name" : @"name",
+             @"nickname" : @"profile.nickname",
+             @"age" : @"profile.age",
+             @"country" : @"profile.location.country",
+             @"active" : @"active",
+             @"score" : @"score",
+             @"count" : @"count",
+             @"url" : @"links.self.url",
+             @"date" : @"date",
+             @"owner" : @"owner",
+             @"reviewer" : @"reviewer",
+             @"contributors" : @"contributors",
+             @"shapes" : @"shapes",
+             @"location" : @"location",
+             @"tags" : @"tags",
+             @"metadata" : @"metadata"
+             };
+}
+
++ (NSDictionary<NSString*, Class>*) JSONDecodingModelClassesByPropertyKey
+{
+    return @{
+             @"reviewer" : [SDDecoderBenchmarkOwner class],
+             @"contributors" : [SDDecoderBenchmarkOwner class],
+             @"shapes" : [SDDecoderBenchmarkShape class]
+             };
+}
+
++ (NSValueTransformer*) dateJSONTransformer
+{
+    return [MTLValueTransformer transformerUsingForwardBlock:^id(NSNumber* timestamp, BOOL* success, NSError** error) {
+        return timestamp ? [NSDate dateWithTimeIntervalSince1970:timestamp.doubleValue] : nil;
+    } reverseBlock:^id(NSDate* date, BOOL* success, NSError** error) {
+        return date ? @(date.timeIntervalSince1970) : nil;
+    }];
+}
+
++ (NSValueTransformer*) reviewerJSONTransformer
+{
+    return [MTLJSONAdapter dictionaryTransformerWithModelClass:[SDDecoderBenchmarkOwner class]];
+}
+
++ (NSValueTransformer*) contributorsJSONTransformer
+{
+    return [MTLJSONAdapter arrayTransformerWithModelClass:[SDDecoderBenchmarkOwner class]];
+}
+
++ (NSValueTransformer*) shapesJSONTransformer
+{
+    return [MTLJSONAdapter arrayTransformerWithModelClass:[SDDecoderBenchmarkShape class]];
+}
+
+@end
+
+
+@interface SDServiceJSONDecoderBenchmarks : XCTestCase
+
+@end
+
+@implementation SDServiceJSONDecoderBenchmarks
+
+/**
+ *  Item with every kind of property, and keys that are not mapped.
+ */
++ (NSString*) fullJSON
+{
+    return @"{\"id\":1,\"name\":\"Mario\",\"profile\":{\"nickname\":\"mario\",\"age\":42,\"location\":{\"country\":\"IT\",\"extra\":[1,2]},\"skip\":{\"a\":[{}]}},"
+            "\"active\":true,\"score\":4.5,\"count\":7,\"links\":{\"self\":{\"url\":\"https://example.com/items/1\"},\"next\":null},\"date\":1500000000.5,"
+            "\"owner\":{\"id\":2,\"display_name\":\"Luigi\",\"address\":{\"city\":\"Padova\",\"zip\":\"35100\"}},\"reviewer\":{\"id\":3,\"display_name\":\"Anna\"},"
+            "\"contributors\":[{\"id\":4},null,{\"id\":5,\"address\":null}],\"shapes\":[{\"type\":\"circle\",\"name\":\"c\",\"radius\":2},{\"type\":\"square\",\"name\":\"s\"}],"
+            "\"location\":{\"name\":\"Padova\",\"lat\":45.4,\"lng\":11.8},\"tags\":[\"a\",1,null,{\"b\":[]}],\"metadata\":{\"k\":\"v\",\"n\":null,\"e\":\"\\u00e9\"},"
+            "\"unmapped\":{\"deep\":[[[{\"x\":\"\\u00e9\\ud83d\\ude00\",\"y\":[true,false,null,-1.5e-3]}]]],\"text\":\"a\\\"b\"}}";
+}
+
+- (id) referenceModelOfClass:(Class)modelClass fromData:(NSData*)data error:(NSError**)error
+{
+    id object = [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+    return [object isKindOfClass:[NSDictionary class]] ? [MTLJSONAdapter modelOfClass:modelClass fromJSONDictionary:object error:error] : nil;
+}
+
+- (NSArray*) referenceModelsOfClass:(Class)modelClass fromData:(NSData*)data error:(NSError**)error
+{
+    id object = [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+    return [object isKindOfClass:[NSArray class]] ? [MTLJSONAdapter modelsOfClass:modelClass fromJSONArray:object error:error] : nil;
+}
+
+/**
+ *  Model read by the decoder, asserted equal to the one of MTLJSONAdapter (both nil if the data can't be read).
+ */
+- (id) assertSameModelOfClass:(Class)modelClass fromData:(NSData*)data
+{
+    NSError* error = nil;
+    id model = [SDServiceJSONDecoder modelOfClass:modelClass fromData:data error:&error];
+    id referenceModel = [self referenceModelOfClass:modelClass fromData:data error:NULL];
+    NSString* JSON = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    XCTAssertEqualObjects(model, referenceModel, @"%@ (%@)", JSON, error);
+    XCTAssertTrue(model != nil || error != nil, @"%@", JSON);
+    return model;
+}
+
+- (id) assertSameModelOfClass:(Class)modelClass fromJSON:(NSString*)JSON
+{
+    return [self assertSameModelOfClass:modelClass fromData:[JSON dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+- (NSArray*) assertSameModelsOfClass:(Class)modelClass fromJSON:(NSString*)JSON
+{
+    NSData* data = [JSON dataUsingEncoding:NSUTF8StringEncoding];
+    NSError* error = nil;
+    NSMutableArray* handledModels = [NSMutableArray array];
+    NSArray* models = [SDServiceJSONDecoder modelsOfClass:modelClass fromData:data itemHandler:^(id model) {
+        [handledModels addObject:model];
+    } error:&error];
+    XCTAssertEqualObjects(models, [self referenceModelsOfClass:modelClass fromData:data error:NULL], @"%@ (%@)", JSON, error);
+    XCTAssertTrue(models != nil || error != nil, @"%@", JSON);
+    if (models)
+    {
+        XCTAssertEqualObjects(handledModels, models);
+    }
+    return models;
+}
+
+- (void) assertFailureOfData:(NSData*)data
+{
+    NSError* error = nil;
+    XCTAssertNil([SDServiceJSONDecoder modelOfClass:[SDDecoderBenchmarkItem class] fromData:data error:&error], @"%@", data);
+    XCTAssertNotNil(error, @"%@", data);
+}
+
+#pragma mark - Models
+
+- (void) testFullModel
+{
+    SDDecoderBenchmarkItem* item = [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:[[self class] fullJSON]];
+    XCTAssertEqualObjects(item.country, @"IT");
+    XCTAssertEqualObjects(item.owner.city, @"Padova");
+    XCTAssertEqual(item.contributors.count, 3);
+    XCTAssertTrue([item.shapes.firstObject isKindOfClass:[SDDecoderBenchmarkCircle class]]);
+    XCTAssertEqualObjects(item.location.coordinates, (@{ @"lat" : @45.4, @"lng" : @11.8 }));
+
+    // same model with whitespaces everywhere, BOM and UTF-16 (read by NSJSONSerialization)
+    NSString* spacedJSON = [[[[self class] fullJSON] stringByReplacingOccurrencesOfString:@"," withString:@" ,\n\t"] stringByReplacingOccurrencesOfString:@":" withString:@"\r : "];
+    spacedJSON = [spacedJSON stringByReplacingOccurrencesOfString:@"https\r : " withString:@"https:"];
+    XCTAssertEqualObjects([self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:spacedJSON], item);
+    NSMutableData* data = [NSMutableData dataWithBytes:"\xEF\xBB\xBF" length:3];
+    [data appendData:[[[self class] fullJSON] dataUsingEncoding:NSUTF8StringEncoding]];
+    XCTAssertEqualObjects([SDServiceJSONDecoder modelOfClass:[SDDecoderBenchmarkItem class] fromData:data error:NULL], item);
+    XCTAssertEqualObjects([self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromData:[[[self class] fullJSON] dataUsingEncoding:NSUTF16LittleEndianStringEncoding]], item);
+}
+
+- (void) testKeyPaths
+{
+    NSArray<NSString*>* JSONs = @[@"{}",
+                                  @"{\"profile\":{}}",
+                                  @"{\"profile\":null}",
+                                  @"{\"profile\":{\"nickname\":null,\"location\":null}}",
+                                  @"{\"profile\":{\"location\":{}},\"links\":{\"self\":null}}",
+                                  @"{\"links\":null,\"profile\":{\"age\":\"42\",\"location\":{\"country\":{\"a\":1}}}}",
+                                  // key paths through values that are not objects
+                                  @"{\"profile\":\"mario\"}",
+                                  @"{\"profile\":[]}",
+                                  @"{\"profile\":1}",
+                                  @"{\"profile\":true}",
+                                  @"{\"profile\":{\"location\":[{\"country\":\"IT\"}]}}",
+                                  @"{\"links\":{\"self\":\"https://example.com\"}}"];
+    for (NSString* JSON in JSONs)
+    {
+        [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:JSON];
+    }
+}
+
+- (void) testNestedModels
+{
+    NSArray<NSString*>* JSONs = @[@"{\"owner\":null,\"reviewer\":null,\"contributors\":null,\"shapes\":null,\"location\":null}",
+                                  @"{\"owner\":{},\"reviewer\":{},\"contributors\":[],\"shapes\":[],\"location\":{}}",
+                                  @"{\"owner\":{\"address\":null},\"contributors\":[null,null],\"shapes\":[null,{\"type\":\"circle\"}]}",
+                                  @"{\"location\":{\"lat\":1},\"shapes\":[{\"type\":\"circle\",\"radius\":null}]}",
+                                  // nested values that are not objects
+                                  @"{\"owner\":\"Luigi\"}",
+                                  @"{\"owner\":[]}",
+                                  @"{\"owner\":{\"address\":\"Padova\"}}",
+                                  @"{\"reviewer\":[{\"id\":1}]}",
+                                  @"{\"contributors\":{\"id\":1}}",
+                                  @"{\"contributors\":[\"Luigi\"]}",
+                                  @"{\"contributors\":[[{\"id\":1}]]}",
+                                  @"{\"shapes\":[1]}",
+                                  @"{\"location\":\"Padova\"}"];
+    for (NSString* JSON in JSONs)
+    {
+        [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:JSON];
+    }
+}
+
+- (void) testFallbackClasses
+{
+    SDDecoderBenchmarkShape* circle = [self assertSameModelOfClass:[SDDecoderBenchmarkShape class] fromJSON:@"{\"type\":\"circle\",\"name\":\"c\",\"radius\":2.5,\"other\":[1]}"];
+    XCTAssertTrue([circle isKindOfClass:[SDDecoderBenchmarkCircle class]]);
+    [self assertSameModelOfClass:[SDDecoderBenchmarkShape class] fromJSON:@"{\"type\":\"square\",\"name\":null}"];
+    [self assertSameModelOfClass:[SDDecoderBenchmarkLocation class] fromJSON:@"{\"name\":\"Padova\",\"lat\":45.4,\"lng\":11.8}"];
+    [self assertSameModelOfClass:[SDDecoderBenchmarkLocation class] fromJSON:@"{\"lat\":null}"];
+    [self assertSameModelsOfClass:[SDDecoderBenchmarkShape class] fromJSON:@"[{\"type\":\"circle\",\"radius\":1},{\"type\":\"square\"}]"];
+    [self assertSameModelsOfClass:[SDDecoderBenchmarkLocation class] fromJSON:@"[{\"lat\":1,\"lng\":2},{}]"];
+}
+
+- (void) testArrays
+{
+    NSString* JSON = [NSString stringWithFormat:@"[%@,{},{\"id\":2,\"profile\":null}]", [[self class] fullJSON]];
+    XCTAssertEqual([self assertSameModelsOfClass:[SDDecoderBenchmarkItem class] fromJSON:JSON].count, 3);
+    XCTAssertEqual([self assertSameModelsOfClass:[SDDecoderBenchmarkItem class] fromJSON:@" [ ] "].count, 0);
+
+    // top level values of the wrong type
+    for (NSString* wrongJSON in @[@"[null]", @"[1]", @"[[]]", @"{}", @"\"items\"", @"null"])
+    {
+        XCTAssertNil([self assertSameModelsOfClass:[SDDecoderBenchmarkItem class] fromJSON:wrongJSON]);
+    }
+    for (NSString* wrongJSON in @[@"[]", @"[{}]", @"\"item\"", @"1", @"null"])
+    {
+        XCTAssertNil([self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:wrongJSON]);
+    }
+}
+
+- (void) testTypeOfValue
+{
+    XCTAssertEqual([SDServiceJSONDecoder typeOfValueInData:[NSData data]], SDServiceJSONValueTypeNone);
+    XCTAssertEqual([SDServiceJSONDecoder typeOfValueInData:[@" \n\t" dataUsingEncoding:NSUTF8StringEncoding]], SDServiceJSONValueTypeNone);
+    XCTAssertEqual([SDServiceJSONDecoder typeOfValueInData:[@"\xEF\xBB\xBF {}" dataUsingEncoding:NSUTF8StringEncoding]], SDServiceJSONValueTypeObject);
+    XCTAssertEqual([SDServiceJSONDecoder typeOfValueInData:[@"\r\n[" dataUsingEncoding:NSUTF8StringEncoding]], SDServiceJSONValueTypeArray);
+    XCTAssertEqual([SDServiceJSONDecoder typeOfValueInData:[@"null" dataUsingEncoding:NSUTF8StringEncoding]], SDServiceJSONValueTypeOther);
+}
+
+#pragma mark - Values
+
+- (void) testStrings
+{
+    NSArray<NSString*>* values = @[@"\"\"",
+                                   @"\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"",
+                                   @"\"\\u0000\\u001f\\u007f\\u00e9\\u4e2d\\uFEFF\\u2028\"",
+                                   @"\"\\ud83d\\ude00 \\uD834\\uDD1E\"",
+                                   @"\"caf\u00e9 \u4e2d\u6587 \U0001F600\U0001D11E\"",
+                                   @"\"mixed \U0001F600 and \\ud83d\\ude00\"",
+                                   @"\"/slash\\/\""];
+    for (NSString* value in values)
+    {
+        NSString* JSON = [NSString stringWithFormat:@"{\"name\":%@,\"profile\":{\"nickname\":%@},\"tags\":[%@],\"metadata\":{%@:%@},\"unmapped\":%@}", value, value, value, value, value, value];
+        [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:JSON];
+    }
+
+    // escaped keys are compared decoded, long keys are decoded out of the stack buffer
+    NSString* longKey = [@"" stringByPaddingToLength:7 * 90 withString:@"\\u00e9k" startingAtIndex:0];
+    NSString* JSON = [NSString stringWithFormat:@"{\"n\\u0061me\":\"Mario\",\"pro\\u0066ile\":{\"nick\\u006Eame\":\"mario\"},\"%@\":1,\"metadata\":{\"%@\":2}}", longKey, longKey];
+    SDDecoderBenchmarkItem* item = [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:JSON];
+    XCTAssertEqualObjects(item.name, @"Mario");
+    XCTAssertEqualObjects(item.nickname, @"mario");
+
+    // long strings with escapes at every offset
+    for (NSUInteger length = 250; length < 262; length++)
+    {
+        NSString* padding = [@"" stringByPaddingToLength:length withString:@"a" startingAtIndex:0];
+        [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:[NSString stringWithFormat:@"{\"name\":\"%@\\ud83d\\ude00%@\\n\"}", padding, padding]];
+    }
+}
+
+- (void) testLoneSurrogates
+{
+    // lone surrogates can't be UTF-8: they become U+FFFD
+    NSDictionary<NSString*, NSString*>* names = @{ @"\"\\ud83d\"" : @"\ufffd",
+                                                   @"\"\\ude00x\"" : @"\ufffdx",
+                                                   @"\"\\ud83d\\u0041\"" : @"\ufffdA",
+                                                   @"\"\\ud83d\\ud83d\\ude00\"" : @"\ufffd\U0001F600" };
+    for (NSString* value in names)
+    {
+        NSData* data = [[NSString stringWithFormat:@"{\"name\":%@}", value] dataUsingEncoding:NSUTF8StringEncoding];
+        SDDecoderBenchmarkItem* item = [SDServiceJSONDecoder modelOfClass:[SDDecoderBenchmarkItem class] fromData:data error:NULL];
+        XCTAssertEqualObjects(item.name, names[value], @"%@", value);
+    }
+}
+
+- (void) testNumbers
+{
+    NSArray<NSString*>* numbers = @[@"0", @"-0", @"1", @"-1", @"0.0", @"-0.0", @"0.5", @"0.1", @"1e2", @"1E+2", @"1e-2", @"-1.5e-3", @"-2.5E-8", @"123.456e7",
+                                    @"1e308", @"1.7976931348623157e308", @"2.2250738585072014e-308", @"5e-324", @"9007199254740993",
+                                    @"2147483648", @"9223372036854775807", @"-9223372036854775808"];
+    for (NSString* number in numbers)
+    {
+        NSString* JSON = [NSString stringWithFormat:@"{\"count\":%@,\"score\":%@,\"tags\":[%@],\"unmapped\":[%@]}", number, number, number, number];
+        SDDecoderBenchmarkItem* item = [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:JSON];
+        SDDecoderBenchmarkItem* referenceItem = [self referenceModelOfClass:[SDDecoderBenchmarkItem class] fromData:[JSON dataUsingEncoding:NSUTF8StringEncoding] error:NULL];
+        XCTAssertEqualObjects(item.count, referenceItem.count, @"%@", number);
+        XCTAssertEqual(CFNumberIsFloatType((__bridge CFNumberRef)item.count), CFNumberIsFloatType((__bridge CFNumberRef)referenceItem.count), @"%@", number);
+        XCTAssertEqual(signbit(item.score), signbit(referenceItem.score), @"%@", number);
+    }
+
+    // integers too big for 64-bit signed and numbers longer than the buffer: same value, maybe not the same class
+    NSString* longInteger = [@"1" stringByPaddingToLength:70 withString:@"0" startingAtIndex:0];
+    NSString* longDouble = [NSString stringWithFormat:@"0.%@1", [@"" stringByPaddingToLength:70 withString:@"3" startingAtIndex:0]];
+    for (NSString* number in @[@"9223372036854775808", @"18446744073709551615", @"18446744073709551616", @"-9223372036854775809", @"100000000000000000000", longInteger, longDouble, [longDouble stringByAppendingString:@"e-5"]])
+    {
+        NSData* data = [[NSString stringWithFormat:@"{\"count\":%@}", number] dataUsingEncoding:NSUTF8StringEncoding];
+        SDDecoderBenchmarkItem* item = [SDServiceJSONDecoder modelOfClass:[SDDecoderBenchmarkItem class] fromData:data error:NULL];
+        SDDecoderBenchmarkItem* referenceItem = [self referenceModelOfClass:[SDDecoderBenchmarkItem class] fromData:data error:NULL];
+        XCTAssertNotNil(item.count, @"%@", number);
+        XCTAssertEqualWithAccuracy(item.count.doubleValue, referenceItem.count.doubleValue, fabs(referenceItem.count.doubleValue) * 1e-15, @"%@", number);
+    }
+}
+
+#pragma mark - Malformed data
+
+- (void) testTruncatedData
+{
+    // every prefix of a document is invalid, reading must fail without reading past the data
+    NSData* data = [[[self class] fullJSON] dataUsingEncoding:NSUTF8StringEncoding];
+    NSData* arrayData = [[NSString stringWithFormat:@"[%@,%@]", [[self class] fullJSON], [[self class] fullJSON]] dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSUInteger length = 0; length < data.length; length++)
+    {
+        NSData* truncatedData = [data subdataWithRange:NSMakeRange(0, length)];
+        XCTAssertNil([self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromData:truncatedData]);
+    }
+    for (NSUInteger length = 0; length < arrayData.length; length++)
+    {
+        NSData* truncatedData = [arrayData subdataWithRange:NSMakeRange(0, length)];
+        NSError* error = nil;
+        XCTAssertNil([SDServiceJSONDecoder modelsOfClass:[SDDecoderBenchmarkItem class] fromData:truncatedData error:&error]);
+        XCTAssertNotNil(error);
+    }
+}
+
+- (void) testTrailingData
+{
+    for (NSString* suffix in @[@" x", @"}", @"]", @",", @"{}", @"[]", @"1", @"null", @"\"\"", @" \n\t\r", @"\n"])
+    {
+        [self assertSameModelOfClass:[SDDecoderBenchmarkItem class] fromJSON:[[[self class] fullJSON] stringByAppendingString:suffix]];
+        [self assertSameModelsOfClass:[SDDecoderBenchmarkItem class] fromJSON:[@"[{},{\"id\":1}]" stringByAppendingString:suffix]];
+    }
+}
+
+- (void) testInvalidValues
+{
+    // rejected in values that are read (metadata) and skipped (unmapped), as NSJSONSerialization rejects the whole data
+    NSArray<NSString*>* values = @[@"01", @"-01", @"1.", @".5", @"+1", @"-", @"1e", @"1e+", @"0x10", @"NaN", @"Infinity", @"-Infinity",
+                                   @"tru", @"nul", @"True", @"NULL", @"'a'", @"\"a\\x\"", @"\"\\u12G4\"", @"\"\\u12\"", @"\"\\\"", @"\"a\tb\"", @"\"a\nb\"",
+                                   @"[1,]", @"[,1]", @"[1 2]", @"{\"a\":1,}", @"{\"a\" 1}", @"{1:2}", @"{\"a\"}", @"{,}", @"[", @"{", @"]", @""];
+    for (NSString* value in values)
+    {
+        for (NSString* key in @[@"metadata", @"unmapped"])
+        {
+            NSString* JSON = [NSString stringWithFormat:@"{\"id\":1,\"%@\":%@}", key, value];
+            [self assertFailureOfData:[JSON dataUsingEncoding:NSUTF8StringEncoding]];
+        }
+    }
+
+    // invalid UTF-8: bad continuation, overlong, surrogate, above U+10FFFF, truncated sequence, lone continuation, invalid byte
+    const char* invalidSequences[] = { "\xC3\x28", "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xE4\xB8", "\x80", "\xFF" };
+    for (NSUInteger i = 0; i < sizeof(invalidSequences) / sizeof(invalidSequences[0]); i++)
+    {
+        for (NSString* key in @[@"name", @"unmapped"])
+        {
+            NSMutableData* data = [[[NSString stringWithFormat:@"{\"id\":1,\"%@\":\"a", key] dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+            [data appendBytes:invalidSequences[i] length:strlen(invalidSequences[i])];
+            [data appendData:[@"b\"}" dataUsingEncoding:NSUTF8StringEncoding]];
+            [self assertFailureOfData:data];
+        }
+    }
+}
+
+- (void) testDepthLimit
+{
+    for (NSString* key in @[@"metadata", @"unmapped", @"tags"])
+    {
+        // the object of the model is the first level
+        NSUInteger allowedDepth = BENCHMARK_DECODER_MAXIMUM_DEPTH - 1;
+        for (NSNumber* depth in @[@(allowedDepth - 1), @(allowedDepth), @(allowedDepth + 1), @(allowedDepth * 4)])
+        {
+            NSString* opening = [@"" stringByPaddingToLength:depth.unsignedIntegerValue - 1 withString:@"[" startingAtIndex:0];
+            NSString* closing = [@"" stringByPaddingToLength:depth.unsignedIntegerValue - 1 withString:@"]" startingAtIndex:0];
+            NSString* value = [key isEqualToString:@"metadata"] ? [NSString stringWithFormat:@"{\"a\":%@%@}", opening, closing] : [NSString stringWithFormat:@"[%@%@]", opening, closing];
+            NSData* data = [[NSString stringWithFormat:@"{\"id\":1,\"%@\":%@}", key, value] dataUsingEncoding:NSUTF8StringEncoding];
+            NSError* error = nil;
+            id model = [SDServiceJSONDecoder modelOfClass:[SDDecoderBenchmarkItem class] fromData:data error:&error];
+            if (depth.unsignedIntegerValue <= allowedDepth)
+            {
+                XCTAssertNotNil(model, @"%@ depth %@: %@", key, depth, error);
+            }
+            else
+            {
+                XCTAssertNil(model, @"%@ depth %@", key, depth);
+                XCTAssertNotNil(error);
+            }
+        }
+    }
+}
+
+#pragma mark - Scenarios
+
+- (SDBenchmarkResult*) measureWithName:(NSString*)name readBlock:(NSArray* (^)(NSData* data))readBlock
+{
+    NSMutableArray* items = [NSMutableArray arrayWithCapacity:BENCHMARK_DECODER_ITEMS];
+    for (NSInteger i = 0; i < BENCHMARK_DECODER_ITEMS; i++)
+    {
+        [items addObject:[SDBenchmarkItem JSONObjectForIdentifier:i]];
+    }
+    NSData* data = [NSJSONSerialization dataWithJSONObject:items options:0 error:NULL];
+
+    NSUInteger numberOfRuns = [SDBenchmarkRunner scaledCount:BENCHMARK_DECODER_RUNS minimum:3];
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:numberOfRuns];
+    NSUInteger successes = 0;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger run = 0; run < numberOfRuns; run++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime runStartTime = CFAbsoluteTimeGetCurrent();
+            successes += readBlock(data).count == BENCHMARK_DECODER_ITEMS ? 1 : 0;
+            [latencies addObject:@(CFAbsoluteTimeGetCurrent() - runStartTime)];
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = numberOfRuns;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = numberOfRuns - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = @{ @"items_per_response" : @(BENCHMARK_DECODER_ITEMS), @"response_bytes" : @(data.length) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+- (void) testReferenceRead
+{
+    SDBenchmarkResult* result = [self measureWithName:@"decoder_json_adapter" readBlock:^NSArray* (NSData* data) {
+        return [self referenceModelsOfClass:[SDBenchmarkItem class] fromData:data error:NULL];
+    }];
+    XCTAssertEqual(result.failures, 0);
+}
+
+- (void) testDecoderRead
+{
+    SDBenchmarkResult* result = [self measureWithName:@"decoder_from_data" readBlock:^NSArray* (NSData* data) {
+        return [SDServiceJSONDecoder modelsOfClass:[SDBenchmarkItem class] fromData:data error:NULL];
+    }];
+    XCTAssertEqual(result.failures, 0);
+}
+
+@end
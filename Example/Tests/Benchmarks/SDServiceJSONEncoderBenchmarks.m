@@ -0,0 +1,503 @@
+//
+//  SDServiceJSONEncoderBenchmarks.m
+//  DockerTests
+//
+//  Request bodies written by SDServiceJSONEncoder against the reference path of SDServiceMantle: JSONDictionaryFromModel of MTLJSONAdapter,
+//  additional parameters, pruneNullValues and NSJSONSerialization. Both bodies must be parsed to the same objects (key order and
+//  number formatting can differ): key paths, nested models, custom and default transformers, nil values with and without
+//  removeNilParameters, additional parameters replacing model keys, numbers and strings to escape.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT), latencies are the mean time to write a body in every batch.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import <Docker/NSDictionary+Docker.h>
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_ENCODER_BODIES            20000
+#define BENCHMARK_ENCODER_BATCH             100
+#define BENCHMARK_ENCODER_CHUNK_SIZE        512
+
+typedef NS_ENUM (NSInteger, SDEncoderBenchmarkStatus)
+{
+    SDEncoderBenchmarkStatusNew,
+    SDEncoderBenchmarkStatusActive,
+    SDEncoderBenchmarkStatusClosed
+};
+
+@interface SDEncoderBenchmarkAddress : MTLModel <MTLJSONSerializing>
+
+@property (nonatomic, strong) NSString* street;
+@property (nonatomic, strong) NSString* city;
+@property (nonatomic, strong) NSNumber* zip;
+
+@end
+
+@implementation SDEncoderBenchmarkAddress
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"street" : @"street",
+             @"city" : @"city.name",
+             @"zip" : @"zip"
+             };
+}
+
+@end
+
+@interface SDEncoderBenchmarkRequest : SDServiceMantleRequest
+
+@property (nonatomic, strong) NSString* name;
+@property (nonatomic, strong) NSString* nickname;
+@property (nonatomic, strong) NSNumber* age;
+@property (nonatomic, assign) BOOL active;
+@property (nonatomic, assign) double score;
+@property (nonatomic, assign) long long identifier;
+@property (nonatomic, strong) NSNumber* count;
+@property (nonatomic, strong) NSDecimalNumber* amount;
+@property (nonatomic, assign) SDEncoderBenchmarkStatus status;
+@property (nonatomic, strong) NSDate* date;
+@property (nonatomic, strong) NSURL* url;
+@property (nonatomic, strong) SDEncoderBenchmarkAddress* address;
+@property (nonatomic, strong) SDEncoderBenchmarkAddress* billingAddress;
+@property (nonatomic, strong) NSArray<SDEncoderBenchmarkAddress*>* addresses;
+@property (nonatomic, strong) NSDictionary* extra;
+@property (nonatomic, strong) NSArray* tags;
+
+@end
+
+@implementation SDEncoderBenchmarkRequest
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"name" : @"name",
+             @"nickname" : @"profile.nickname",
+             @"age" : @"profile.age",
+             @"active" : @"active",
+             @"score" : @"score",
+             @"identifier" : @"id",
+             @"count" : @"count",
+             @"amount" : @"amount",
+             @"status" : @"status",
+             @"date" : @"date",
+             @"url" : @"links.self.url",
+             @"address" : @"address",
+             @"billingAddress" : @"billing_address",
+             @"addresses" : @"addresses",
+             @"extra" : @"extra",
+             @"tags" : @"tags"
+             };
+}
+
++ (NSValueTransformer*) statusJSONTransformer
+{
+    return [NSValueTransformer mtl_valueMappingTransformerWithDictionary:@{ @"new" : @(SDEncoderBenchmarkStatusNew), @"active" : @(SDEncoderBenchmarkStatusActive), @"closed" : @(SDEncoderBenchmarkStatusClosed) }];
+}
+
++ (NSValueTransformer*) dateJSONTransformer
+{
+    return [MTLValueTransformer transformerUsingForwardBlock:^id(NSNumber* timestamp, BOOL* success, NSError** error) {
+        return timestamp ? [NSDate dateWithTimeIntervalSince1970:timestamp.doubleValue] : nil;
+    } reverseBlock:^id(NSDate* date, BOOL* success, NSError** error) {
+        return date ? @(date.timeIntervalSince1970) : nil;
+    }];
+}
+
++ (NSValueTransformer*) billingAddressJSONTransformer
+{
+    // custom transformer: the nested model is not written directly
+    return [MTLJSONAdapter dictionaryTransformerWithModelClass:[SDEncoderBenchmarkAddress class]];
+}
+
++ (NSValueTransformer*) addressesJSONTransformer
+{
+    return [MTLJSONAdapter arrayTransformerWithModelClass:[SDEncoderBenchmarkAddress class]];
+}
+
+@end
+
+/**
+ *  Property mapped to an array of key paths: written with MTLJSONAdapter.
+ */
+@interface SDEncoderBenchmarkLocationRequest : SDServiceMantleRequest
+
+@property (nonatomic, strong) NSString* name;
+@property (nonatomic, strong) NSDictionary* coordinates;
+
+@end
+
+@implementation SDEncoderBenchmarkLocationRequest
+
++ (NSDictionary*) JSONKeyPathsByPropertyKey
+{
+    return @{
+             @"name" : @"name",
+             @"coordinates" : @[@"lat", @"lng"]
+             };
+}
+
+@end
+
+@interface SDEncoderBenchmarkService : SDServiceMantle
+
+@end
+
+@implementation SDEncoderBenchmarkService
+
+- (NSString*) pathResource
+{
+    return @"/encoder";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodPOST;
+}
+
+@end
+
+
+@interface SDServiceJSONEncoderBenchmarks : XCTestCase
+
+@end
+
+@implementation SDServiceJSONEncoderBenchmarks
+
+- (SDEncoderBenchmarkAddress*) addressWithStreet:(NSString*)street city:(NSString*)city
+{
+    SDEncoderBenchmarkAddress* address = [SDEncoderBenchmarkAddress new];
+    address.street = street;
+    address.city = city;
+    address.zip = @(35100);
+    return address;
+}
+
+- (SDEncoderBenchmarkRequest*) fullRequest
+{
+    SDEncoderBenchmarkRequest* request = [SDEncoderBenchmarkRequest new];
+    request.name = @"Mario Rossi";
+    request.nickname = @"mario";
+    request.age = @(42);
+    request.active = YES;
+    request.score = 0.1;
+    request.identifier = 9007199254740993LL;
+    request.count = @(7);
+    request.amount = [NSDecimalNumber decimalNumberWithString:@"1234.56"];
+    request.status = SDEncoderBenchmarkStatusActive;
+    request.date = [NSDate dateWithTimeIntervalSince1970:1500000000.5];
+    request.url = [NSURL URLWithString:@"https://example.com/users/1?fields=name"];
+    request.address = [self addressWithStreet:@"Via Roma 1" city:@"Padova"];
+    request.billingAddress = [self addressWithStreet:@"Via Verdi 2" city:nil];
+    request.addresses = @[[self addressWithStreet:@"Via Dante 3" city:@"Milano"], [self addressWithStreet:nil city:nil]];
+    request.extra = @{ @"null" : [NSNull null], @"empty" : @{ @"null" : [NSNull null] }, @"items" : @[@{ @"null" : [NSNull null] }, @{ @"value" : @1, @"null" : [NSNull null] }, [NSNull null], @[[NSNull null]]], @"value" : @"text" };
+    request.tags = @[@"a", @"b"];
+    return request;
+}
+
+/**
+ *  Body of the reference path: dictionary of MTLJSONAdapter with additional parameters, pruned if needed, parsed back from NSJSONSerialization.
+ */
+- (id) referenceObjectWithModel:(MTLModel<MTLJSONSerializing>*)model additionalParameters:(NSDictionary*)additionalParameters removeNilValues:(BOOL)removeNilValues
+{
+    NSError* error = nil;
+    NSMutableDictionary* dictionary = [[MTLJSONAdapter JSONDictionaryFromModel:model error:&error] mutableCopy];
+    XCTAssertNotNil(dictionary, @"%@", error);
+    [dictionary addEntriesFromDictionary:additionalParameters];
+    NSDictionary* parameters = removeNilValues ? [dictionary pruneNullValues] : dictionary;
+    NSData* data = [NSJSONSerialization dataWithJSONObject:parameters options:0 error:&error];
+    XCTAssertNotNil(data, @"%@", error);
+    return [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL];
+}
+
+- (id) encodedObjectWithModel:(MTLModel<MTLJSONSerializing>*)model additionalParameters:(NSDictionary*)additionalParameters removeNilValues:(BOOL)removeNilValues
+{
+    NSError* error = nil;
+    NSData* data = [SDServiceJSONEncoder dataWithModel:model additionalParameters:additionalParameters removeNilValues:removeNilValues error:&error];
+    XCTAssertNotNil(data, @"%@", error);
+    id object = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:&error] : nil;
+    XCTAssertNotNil(object, @"Invalid JSON %@: %@", data ? [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] : nil, error);
+    return object;
+}
+
+- (void) assertSameBodyOfModel:(MTLModel<MTLJSONSerializing>*)model additionalParameters:(NSDictionary*)additionalParameters
+{
+    for (NSNumber* removeNilValues in @[@NO, @YES])
+    {
+        id encodedObject = [self encodedObjectWithModel:model additionalParameters:additionalParameters removeNilValues:removeNilValues.boolValue];
+        id referenceObject = [self referenceObjectWithModel:model additionalParameters:additionalParameters removeNilValues:removeNilValues.boolValue];
+        XCTAssertEqualObjects(encodedObject, referenceObject, @"removeNilValues %@", removeNilValues);
+    }
+}
+
+#pragma mark - Models
+
+- (void) testFullModel
+{
+    [self assertSameBodyOfModel:[self fullRequest] additionalParameters:nil];
+}
+
+- (void) testNilValues
+{
+    // key path objects with only nil values, nil nested models and nil values of default and custom transformers
+    [self assertSameBodyOfModel:[SDEncoderBenchmarkRequest new] additionalParameters:nil];
+
+    SDEncoderBenchmarkRequest* request = [SDEncoderBenchmarkRequest new];
+    request.nickname = @"mario";
+    request.address = [SDEncoderBenchmarkAddress new];
+    request.addresses = @[];
+    request.extra = @{};
+    [self assertSameBodyOfModel:request additionalParameters:nil];
+
+    // pruned body
+    id object = [self encodedObjectWithModel:[SDEncoderBenchmarkRequest new] additionalParameters:nil removeNilValues:YES];
+    XCTAssertFalse([object[@"profile"] isKindOfClass:[NSDictionary class]]);
+    XCTAssertFalse([object[@"address"] isKindOfClass:[NSDictionary class]]);
+}
+
+- (void) testAdditionalParameters
+{
+    // they replace the whole value of a key, also of key path objects and nested models
+    NSDictionary* additionalParameters = @{
+                                           @"name" : @"Other",
+                                           @"profile" : @{ @"other" : @YES, @"null" : [NSNull null] },
+                                           @"address" : [NSNull null],
+                                           @"new" : @[@{ @"null" : [NSNull null] }],
+                                           @"escaped \"key\"" : @"value"
+                                           };
+    [self assertSameBodyOfModel:[self fullRequest] additionalParameters:additionalParameters];
+    [self assertSameBodyOfModel:[SDEncoderBenchmarkRequest new] additionalParameters:additionalParameters];
+
+    id object = [self encodedObjectWithModel:[self fullRequest] additionalParameters:additionalParameters removeNilValues:NO];
+    XCTAssertEqualObjects(object[@"name"], @"Other");
+    XCTAssertNil(object[@"profile"][@"nickname"]);
+}
+
+- (void) testArrayOfKeyPaths
+{
+    SDEncoderBenchmarkLocationRequest* request = [SDEncoderBenchmarkLocationRequest new];
+    request.name = @"Padova";
+    request.coordinates = @{ @"lat" : @(45.4064), @"lng" : @(11.8768) };
+    [self assertSameBodyOfModel:request additionalParameters:@{ @"extra" : [NSNull null] }];
+    [self assertSameBodyOfModel:[SDEncoderBenchmarkLocationRequest new] additionalParameters:nil];
+}
+
+- (void) testBodyOfService
+{
+    // default body of SDServiceMantle against its parameters pruned as by SDServiceManager
+    SDEncoderBenchmarkService* service = [SDEncoderBenchmarkService new];
+    for (NSNumber* removeNilParameters in @[@NO, @YES])
+    {
+        SDEncoderBenchmarkRequest* request = [self fullRequest];
+        request.nickname = nil;
+        request.removeNilParameters = removeNilParameters.boolValue;
+        request.additionalRequestParameters = @{ @"name" : @"Other", @"empty" : @{} };
+
+        NSError* error = nil;
+        NSData* body = [service bodyForRequest:request error:&error];
+        XCTAssertNotNil(body, @"%@", error);
+        NSDictionary* parameters = [service parametersForRequest:request error:&error];
+        if (removeNilParameters.boolValue)
+        {
+            parameters = [parameters pruneNullValues];
+        }
+        NSData* referenceData = [NSJSONSerialization dataWithJSONObject:parameters options:0 error:NULL];
+        XCTAssertEqualObjects([NSJSONSerialization JSONObjectWithData:body options:0 error:NULL], [NSJSONSerialization JSONObjectWithData:referenceData options:0 error:NULL], @"removeNilParameters %@", removeNilParameters);
+    }
+}
+
+#pragma mark - Values
+
+- (void) testBooleans
+{
+    SDEncoderBenchmarkRequest* request = [SDEncoderBenchmarkRequest new];
+    for (NSNumber* active in @[@YES, @NO])
+    {
+        request.active = active.boolValue;
+        request.count = active;
+        [self assertSameBodyOfModel:request additionalParameters:@{ @"flag" : active }];
+
+        // true and false, not 1 and 0
+        NSData* data = [SDServiceJSONEncoder dataWithModel:request additionalParameters:nil removeNilValues:YES error:NULL];
+        NSString* string = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        NSString* literal = active.boolValue ? @"true" : @"false";
+        XCTAssertTrue([string containsString:[NSString stringWithFormat:@"\"active\":%@", literal]], @"%@", string);
+        XCTAssertTrue([string containsString:[NSString stringWithFormat:@"\"count\":%@", literal]], @"%@", string);
+    }
+}
+
+- (void) testNumbers
+{
+    NSArray<NSNumber*>* doubles = @[@0., @(-0.), @0.1, @(1. / 3.), @(-2.5e-8), @1e21, @1e300, @(DBL_MIN), @(5e-324), @(DBL_MAX), @(9007199254740993.)];
+    NSArray<NSNumber*>* integers = @[@0, @(-1), @(INT_MAX), @(LLONG_MIN), @(LLONG_MAX), @(ULLONG_MAX), @((unsigned char)200), @((short)-300)];
+    NSArray<NSDecimalNumber*>* decimals = @[[NSDecimalNumber decimalNumberWithString:@"3.14159265358979323846264338327950288"],
+                                            [NSDecimalNumber decimalNumberWithString:@"-0.000001"],
+                                            [NSDecimalNumber decimalNumberWithString:@"123456789012345678901234567890"],
+                                            [NSDecimalNumber zero]];
+
+    SDEncoderBenchmarkRequest* request = [SDEncoderBenchmarkRequest new];
+    for (NSNumber* value in doubles)
+    {
+        request.score = value.doubleValue;
+        [self assertSameBodyOfModel:request additionalParameters:@{ @"double" : value }];
+        // read back exactly
+        XCTAssertEqualObjects([self encodedObjectWithModel:request additionalParameters:nil removeNilValues:NO][@"score"], value);
+    }
+    for (NSNumber* value in integers)
+    {
+        request.count = value;
+        request.identifier = value.longLongValue;
+        [self assertSameBodyOfModel:request additionalParameters:@{ @"integer" : value }];
+    }
+    for (NSDecimalNumber* value in decimals)
+    {
+        request.amount = value;
+        [self assertSameBodyOfModel:request additionalParameters:@{ @"decimal" : value }];
+    }
+}
+
+- (void) testInvalidNumbers
+{
+    SDEncoderBenchmarkRequest* request = [SDEncoderBenchmarkRequest new];
+    NSError* error = nil;
+
+    request.score = NAN;
+    XCTAssertNil([SDServiceJSONEncoder dataWithModel:request additionalParameters:nil removeNilValues:NO error:&error]);
+    XCTAssertNotNil(error);
+
+    request.score = 0;
+    request.amount = [NSDecimalNumber notANumber];
+    error = nil;
+    XCTAssertNil([SDServiceJSONEncoder dataWithModel:request additionalParameters:nil removeNilValues:NO error:&error]);
+    XCTAssertNotNil(error);
+
+    request.amount = nil;
+    error = nil;
+    XCTAssertNil([SDServiceJSONEncoder dataWithModel:request additionalParameters:@{ @"infinity" : @(INFINITY) } removeNilValues:NO error:&error]);
+    XCTAssertNotNil(error);
+}
+
+- (void) testStrings
+{
+    unichar controlCharacters[0x20];
+    for (unichar c = 0; c < 0x20; c++)
+    {
+        controlCharacters[c] = c;
+    }
+    NSString* control = [NSString stringWithCharacters:controlCharacters length:0x20];
+    NSArray<NSString*>* strings = @[@"", @"\"quotes\" and \\backslash\\ and /slash/", control, @"\x7f delete", @"citt\u00e0 \u00e8 pi\u00f9", @"\u4e2d\u6587 \u65e5\u672c\u8a9e",
+                                    @"emoji \U0001F600\U0001F44D\U0001F3FD and \U0001D11E", @"line\u2028separator\u2029", @"\ufeffbom", @"lone \\ud83d escape text"];
+    SDEncoderBenchmarkRequest* request = [SDEncoderBenchmarkRequest new];
+    for (NSString* string in strings)
+    {
+        request.name = string;
+        request.nickname = string;
+        request.tags = @[string];
+        [self assertSameBodyOfModel:request additionalParameters:@{ string : string }];
+        XCTAssertEqualObjects([self encodedObjectWithModel:request additionalParameters:nil removeNilValues:NO][@"name"], string);
+    }
+}
+
+- (void) testLongStrings
+{
+    // strings are converted in chunks: characters of several bytes and escapes at the end of a chunk
+    SDEncoderBenchmarkRequest* request = [SDEncoderBenchmarkRequest new];
+    for (NSUInteger offset = 0; offset < 5; offset++)
+    {
+        for (NSString* suffix in @[@"\U0001F600\U0001F600", @"\u00e8\u00e8", @"\"\n", @"\u4e2d\u4e2d"])
+        {
+            NSString* prefix = [@"" stringByPaddingToLength:BENCHMARK_ENCODER_CHUNK_SIZE - offset withString:@"a" startingAtIndex:0];
+            request.name = [NSString stringWithFormat:@"%@%@%@", prefix, suffix, prefix];
+            XCTAssertEqualObjects([self encodedObjectWithModel:request additionalParameters:nil removeNilValues:NO][@"name"], request.name);
+        }
+    }
+}
+
+- (void) testJSONObjects
+{
+    NSArray* objects = @[@{ @"a" : [NSNull null], @"b" : @{ @"c" : [NSNull null] }, @"d" : @[@{ @"e" : [NSNull null] }, [NSNull null], @[@{ @"f" : [NSNull null] }]], @"g" : @[] },
+                         @[@1, [NSNull null], @{ @"a" : @"b" }, @"text", @YES]];
+    for (id object in objects)
+    {
+        for (NSNumber* removeNilValues in @[@NO, @YES])
+        {
+            id expectedObject = object;
+            if (removeNilValues.boolValue && [object isKindOfClass:[NSDictionary class]])
+            {
+                expectedObject = [object pruneNullValues];
+            }
+            else if (removeNilValues.boolValue)
+            {
+                // as pruneNullValues of the values of a dictionary
+                expectedObject = [@{ @"array" : object } pruneNullValues][@"array"];
+            }
+            NSData* data = [SDServiceJSONEncoder dataWithJSONObject:object removeNilValues:removeNilValues.boolValue error:NULL];
+            XCTAssertEqualObjects([NSJSONSerialization JSONObjectWithData:data options:0 error:NULL], expectedObject, @"removeNilValues %@", removeNilValues);
+        }
+    }
+
+    NSError* error = nil;
+    XCTAssertNil([SDServiceJSONEncoder dataWithJSONObject:@{ @1 : @"non-string key" } removeNilValues:NO error:&error]);
+    XCTAssertNotNil(error);
+    error = nil;
+    XCTAssertNil([SDServiceJSONEncoder dataWithJSONObject:@[[NSDate date]] removeNilValues:NO error:&error]);
+    XCTAssertNotNil(error);
+}
+
+#pragma mark - Scenarios
+
+- (SDBenchmarkResult*) measureWithName:(NSString*)name bodyBlock:(NSData* (^)(SDEncoderBenchmarkRequest* request))bodyBlock
+{
+    SDEncoderBenchmarkRequest* request = [self fullRequest];
+    NSUInteger numberOfBodies = [SDBenchmarkRunner scaledCount:BENCHMARK_ENCODER_BODIES minimum:BENCHMARK_ENCODER_BATCH];
+    NSUInteger numberOfBatches = numberOfBodies / BENCHMARK_ENCODER_BATCH;
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:numberOfBatches];
+    NSUInteger successes = 0;
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger batch = 0; batch < numberOfBatches; batch++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime batchStartTime = CFAbsoluteTimeGetCurrent();
+            for (NSUInteger i = 0; i < BENCHMARK_ENCODER_BATCH; i++)
+            {
+                successes += bodyBlock(request).length > 0 ? 1 : 0;
+            }
+            [latencies addObject:@((CFAbsoluteTimeGetCurrent() - batchStartTime) / BENCHMARK_ENCODER_BATCH)];
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = numberOfBatches * BENCHMARK_ENCODER_BATCH;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = result.numberOfCalls - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+- (void) testReferenceBody
+{
+    SDBenchmarkResult* result = [self measureWithName:@"encoder_json_adapter" bodyBlock:^NSData* (SDEncoderBenchmarkRequest* request) {
+        NSDictionary* parameters = [[MTLJSONAdapter JSONDictionaryFromModel:request error:NULL] pruneNullValues];
+        return [NSJSONSerialization dataWithJSONObject:parameters options:0 error:NULL];
+    }];
+    XCTAssertEqual(result.failures, 0);
+}
+
+- (void) testEncoderBody
+{
+    SDBenchmarkResult* result = [self measureWithName:@"encoder_single_pass" bodyBlock:^NSData* (SDEncoderBenchmarkRequest* request) {
+        return [SDServiceJSONEncoder dataWithModel:request additionalParameters:nil removeNilValues:YES error:NULL];
+    }];
+    XCTAssertEqual(result.failures, 0);
+}
+
+@end
@@ -0,0 +1,398 @@
+//
+//  SDServiceManagerBenchmarks.m
+//  DockerTests
+//
+//  End-to-end benchmarks of SDServiceManager (request serialization, network stack, Mantle mapping, completion on main thread)
+//  against a local HTTP stub.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT) and written to a JSON report at the end of the suite,
+//  in the path of SD_BENCHMARK_OUTPUT environment variable or in the temporary directory.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#if __has_include(<Blabber/SDLogger.h>)
+#import <Blabber/SDLogger.h>
+#endif
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_SCENARIO_TIMEOUT             120
+#define BENCHMARK_LARGE_ARRAY_COUNT            1000
+#define BENCHMARK_UPLOAD_SIZE                  (32 * 1024)
+#define BENCHMARK_SLOW_ITEM_ID                 424242
+#define BENCHMARK_SLOW_CHUNK_INTERVAL          0.2
+#define BENCHMARK_SLOW_CHUNKS                  15
+#define BENCHMARK_DEADLINE                     0.5
+
+static SDBenchmarkHTTPServer* benchmarkServer = nil;
+static NSMutableArray<SDBenchmarkResult*>* benchmarkResults = nil;
+
+@interface SDServiceManagerBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDServiceManager* serviceManager;
+@property (nonatomic, strong) SDBenchmarkRunner* runner;
+
+@end
+
+@implementation SDServiceManagerBenchmarks
+
+#pragma mark - Suite
+
++ (void) setUp
+{
+    [super setUp];
+
+    benchmarkResults = [NSMutableArray array];
+    benchmarkServer = [SDBenchmarkHTTPServer new];
+    [self installHandlersOnServer:benchmarkServer];
+
+    NSError* error = nil;
+    if (![benchmarkServer startWithError:&error])
+    {
+        NSLog(@"Can't start benchmark server: %@", error);
+    }
+
+    AFHTTPRequestOperationManager* requestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:benchmarkServer.baseURL];
+    requestOperationManager.requestSerializer = [AFJSONRequestSerializer serializer];
+    requestOperationManager.requestSerializer.HTTPMethodsEncodingParametersInURI = [NSSet setWithObjects:@"GET", @"HEAD", nil];
+    requestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+    [SDBenchmarkService setRequestOperationManager:requestOperationManager];
+
+#if __has_include(<Blabber/SDLogger.h>)
+    // logs of every request and response would be measured too
+    [[SDLogger sharedLogger] setLogLevel:SDLogLevelError forModuleWithName:kServiceManagerLogModuleName];
+#endif
+}
+
++ (void) tearDown
+{
+    NSError* error = nil;
+    NSString* path = [SDBenchmarkRunner writeReportWithResults:benchmarkResults error:&error];
+    if (path)
+    {
+        NSLog(@"SD_BENCHMARK_REPORT %@", path);
+    }
+    else
+    {
+        NSLog(@"Can't write benchmark report: %@", error);
+    }
+
+    [benchmarkServer stop];
+    benchmarkServer = nil;
+    [super tearDown];
+}
+
++ (void) installHandlersOnServer:(SDBenchmarkHTTPServer*)server
+{
+    NSData* itemData = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:1] } options:0 error:NULL];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:itemData];
+    } forPathPrefix:@"/items/"];
+
+    NSMutableDictionary<NSNumber*, NSData*>* listsByCount = [NSMutableDictionary dictionary];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        NSInteger count = [request.queryParameters[@"count"] integerValue];
+        NSData* data = nil;
+        @synchronized (listsByCount)
+        {
+            data = listsByCount[@(count)];
+            if (!data)
+            {
+                NSMutableArray* items = [NSMutableArray arrayWithCapacity:count];
+                for (NSInteger i = 0; i < count; i++)
+                {
+                    [items addObject:[SDBenchmarkItem JSONObjectForIdentifier:i]];
+                }
+                data = [NSJSONSerialization dataWithJSONObject:items options:0 error:NULL];
+                listsByCount[@(count)] = data;
+            }
+        }
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:data];
+    } forPathPrefix:@"/items"];
+
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        NSDictionary* upload = @{ @"upload_id" : [NSUUID UUID].UUIDString, @"received_bytes" : @(request.body.length) };
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:[NSJSONSerialization dataWithJSONObject:upload options:0 error:NULL]];
+    } forPathPrefix:@"/upload"];
+
+    NSData* errorData = [NSJSONSerialization dataWithJSONObject:@{ @"error" : @{ @"code" : @"internal_error", @"message" : @"Something went wrong" } } options:0 error:NULL];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:500 JSONData:errorData];
+    } forPathPrefix:@"/error"];
+
+    NSMutableSet<NSString*>* attemptedCalls = [NSMutableSet set];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        NSString* callId = request.queryParameters[@"call_id"] ? : @"";
+        BOOL firstAttempt = NO;
+        @synchronized (attemptedCalls)
+        {
+            firstAttempt = ![attemptedCalls containsObject:callId];
+            [attemptedCalls addObject:callId];
+        }
+        SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:itemData];
+        response.dropsConnection = firstAttempt;
+        // fresh connection for every call: the network stack doesn't retry by itself on connections it didn't reuse
+        response.closesConnection = YES;
+        return response;
+    } forPathPrefix:@"/flaky"];
+
+    // response trickling under the idle timeout: only the deadline can stop it
+    NSString* slowPath = [NSString stringWithFormat:@"/items/%d", BENCHMARK_SLOW_ITEM_ID];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:nil];
+        __block NSUInteger sentChunks = 0;
+        response.bodyStreamBlock = ^NSData* {
+            if (sentChunks >= BENCHMARK_SLOW_CHUNKS)
+            {
+                return nil;
+            }
+            if (sentChunks > 0)
+            {
+                [NSThread sleepForTimeInterval:BENCHMARK_SLOW_CHUNK_INTERVAL];
+            }
+            sentChunks++;
+            return [(sentChunks == 1 ? @"{\"item\":" : @" ") dataUsingEncoding:NSUTF8StringEncoding];
+        };
+        return response;
+    } forPathPrefix:slowPath];
+}
+
+#pragma mark - Test case
+
+- (void) setUp
+{
+    [super setUp];
+    XCTAssertNotNil(benchmarkServer.baseURL);
+
+    self.serviceManager = [[SDServiceManager alloc] init];
+    self.serviceManager.timeBeforeRetry = 0.01;
+    self.runner = [SDBenchmarkRunner new];
+}
+
+- (void) tearDown
+{
+    self.serviceManager = nil;
+    [super tearDown];
+}
+
+- (SDBenchmarkResult*) runScenario:(SDBenchmarkScenario*)scenario
+{
+    SDBenchmarkResult* result = [self.runner runScenario:scenario timeout:BENCHMARK_SCENARIO_TIMEOUT];
+    [benchmarkResults addObject:result];
+    XCTAssertTrue(result.completed, @"Scenario %@ didn't complete in %d seconds", scenario.name, BENCHMARK_SCENARIO_TIMEOUT);
+    return result;
+}
+
+#pragma mark - Scenarios
+
+- (void) testSmallGET
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"small_get" numberOfCalls:[SDBenchmarkRunner scaledCount:500] concurrency:8 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+        request.itemId = @(index % 100);
+        [serviceManager callService:[SDBenchmarkItemService new] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion([(SDBenchmarkItemResponse*)response item] != nil);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        }];
+    }];
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+}
+
+- (void) testFutures
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    // two items in parallel, then a list sized with both results: each screen load waits for the critical path only
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"futures_fan_in" numberOfCalls:[SDBenchmarkRunner scaledCount:200] concurrency:4 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        SDBenchmarkItemRequest* firstRequest = [SDBenchmarkItemRequest new];
+        firstRequest.itemId = @(index % 100);
+        SDBenchmarkItemRequest* secondRequest = [SDBenchmarkItemRequest new];
+        secondRequest.itemId = @((index + 1) % 100);
+        NSArray* futures = @[[serviceManager futureByCallingService:[SDBenchmarkItemService new] withRequest:firstRequest],
+                             [serviceManager futureByCallingService:[SDBenchmarkItemService new] withRequest:secondRequest]];
+        [[[[SDServiceFuture all:futures] then:^id(NSArray* responses) {
+            SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+            request.count = @(responses.count * 10);
+            return [serviceManager futureByCallingService:[SDBenchmarkItemListService new] withRequest:request];
+        }] onSuccess:^(id response) {
+            completion([(SDBenchmarkItemListResponse*)response items].count == 20);
+        }] onFailure:^(NSError* error, id<SDServiceGenericErrorProtocol> serviceError) {
+            completion(NO);
+        }];
+    }];
+    scenario.parameters = @{ @"calls_per_load" : @3 };
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+}
+
+- (void) testLargeArray
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"large_array" numberOfCalls:[SDBenchmarkRunner scaledCount:30] concurrency:4 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+        request.count = @(BENCHMARK_LARGE_ARRAY_COUNT);
+        [serviceManager callService:[SDBenchmarkItemListService new] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion([(SDBenchmarkItemListResponse*)response items].count == BENCHMARK_LARGE_ARRAY_COUNT);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        }];
+    }];
+    scenario.parameters = @{ @"items_per_response" : @(BENCHMARK_LARGE_ARRAY_COUNT) };
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+}
+
+- (void) testLargeArrayFromData
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"large_array_from_data" numberOfCalls:[SDBenchmarkRunner scaledCount:30] concurrency:4 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+        request.count = @(BENCHMARK_LARGE_ARRAY_COUNT);
+        [serviceManager callService:[SDBenchmarkItemListDataService new] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion([(SDBenchmarkItemListResponse*)response items].count == BENCHMARK_LARGE_ARRAY_COUNT);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        }];
+    }];
+    scenario.parameters = @{ @"items_per_response" : @(BENCHMARK_LARGE_ARRAY_COUNT) };
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+}
+
+- (void) testMappingBurst
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    SDServiceMappingExecutor* executor = serviceManager.mappingExecutor;
+    NSUInteger defaultMaximumBacklog = executor.maximumBacklog;
+    executor.maximumBacklog = 4;
+    [executor resetMetrics];
+
+    // many large responses at once: backpressure keeps the mapping backlog short
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"mapping_burst" numberOfCalls:[SDBenchmarkRunner scaledCount:64] concurrency:32 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+        request.count = @(BENCHMARK_LARGE_ARRAY_COUNT);
+        [serviceManager callService:[SDBenchmarkItemListService new] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion([(SDBenchmarkItemListResponse*)response items].count == BENCHMARK_LARGE_ARRAY_COUNT);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        }];
+    }];
+    scenario.parameters = @{ @"items_per_response" : @(BENCHMARK_LARGE_ARRAY_COUNT), @"maximum_backlog" : @(executor.maximumBacklog), @"mapping_workers" : @(executor.maximumConcurrency) };
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    NSMutableDictionary* parameters = [result.parameters mutableCopy];
+    parameters[@"peak_queue_depth"] = @(executor.peakNumberOfPendingBlocks);
+    parameters[@"backpressure_events"] = @(executor.numberOfBackpressureEvents);
+    parameters[@"backpressure_time_ms"] = @(executor.backpressureTime * 1000.);
+    parameters[@"average_waiting_time_ms"] = @(executor.averageWaitingTime * 1000.);
+    result.parameters = parameters;
+    executor.maximumBacklog = defaultMaximumBacklog;
+
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+}
+
+- (void) testMultipartPOST
+{
+    NSMutableData* fileData = [NSMutableData dataWithLength:BENCHMARK_UPLOAD_SIZE];
+    arc4random_buf(fileData.mutableBytes, fileData.length);
+
+    SDServiceManager* serviceManager = self.serviceManager;
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"multipart_post" numberOfCalls:[SDBenchmarkRunner scaledCount:40] concurrency:4 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        MultipartBodyInfo* multipartInfo = [MultipartBodyInfo new];
+        multipartInfo.data = fileData;
+        multipartInfo.name = @"file";
+        multipartInfo.fileName = @"file.bin";
+        multipartInfo.mimeType = @"application/octet-stream";
+
+        SDBenchmarkUploadRequest* request = [SDBenchmarkUploadRequest new];
+        request.fileDescription = [NSString stringWithFormat:@"upload %lu", (unsigned long)index];
+        request.multipartInfos = @[multipartInfo];
+        [serviceManager callService:[SDBenchmarkUploadService new] withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion([(SDBenchmarkUploadResponse*)response receivedBytes].unsignedIntegerValue > BENCHMARK_UPLOAD_SIZE);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        }];
+    }];
+    scenario.parameters = @{ @"upload_bytes" : @(BENCHMARK_UPLOAD_SIZE) };
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+}
+
+- (void) testErrors
+{
+    SDServiceManager* serviceManager = self.serviceManager;
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"errors" numberOfCalls:[SDBenchmarkRunner scaledCount:300] concurrency:8 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        [serviceManager callService:[SDBenchmarkErrorService new] withRequest:[SDServiceMantleRequest new] operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion(YES);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            // failures are the expected result: they are counted as failures anyway
+            completion(NO);
+        }];
+    }];
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    XCTAssertEqual(result.failures, scenario.numberOfCalls);
+}
+
+- (void) testRetries
+{
+    NSUInteger requestsBefore = benchmarkServer.numberOfRequests;
+
+    SDServiceManager* serviceManager = self.serviceManager;
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"retries" numberOfCalls:[SDBenchmarkRunner scaledCount:100] concurrency:8 callBlock:^(NSUInteger index, void (^completion)(BOOL)) {
+        SDBenchmarkFlakyRequest* request = [SDBenchmarkFlakyRequest new];
+        request.callId = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        [serviceManager callService:[SDBenchmarkFlakyService new] withRequest:request operationType:0 responseAction:nil numAutomaticRetry:1 delegate:nil downloadBlock:nil uploadBlock:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion(YES);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        } cachingBlock:nil];
+    }];
+    scenario.parameters = @{ @"time_before_retry_ms" : @(serviceManager.timeBeforeRetry * 1000.) };
+
+    SDBenchmarkResult* result = [self runScenario:scenario];
+    NSUInteger serverRequests = benchmarkServer.numberOfRequests - requestsBefore;
+    NSMutableDictionary* parameters = [result.parameters mutableCopy];
+    parameters[@"server_requests"] = @(serverRequests);
+    result.parameters = parameters;
+
+    XCTAssertEqual(result.successes, scenario.numberOfCalls);
+}
+
+- (void) testDeadlineCancelsSlowResponse
+{
+    SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+    request.itemId = @(BENCHMARK_SLOW_ITEM_ID);
+    SDServiceCallInfo* serviceInfo = [[SDServiceCallInfo alloc] initWithService:[SDBenchmarkItemService new] request:request];
+    serviceInfo.deadline = [NSDate dateWithTimeIntervalSinceNow:BENCHMARK_DEADLINE];
+
+    XCTestExpectation* expectation = [self expectationWithDescription:@"deadline"];
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    __block NSError* failureError = nil;
+    serviceInfo.completionSuccess = ^(id<SDServiceGenericResponseProtocol> response) {
+        [expectation fulfill];
+    };
+    serviceInfo.completionFailure = ^(id<SDServiceGenericErrorProtocol> error) {
+        failureError = error.error;
+        [expectation fulfill];
+    };
+    [self.serviceManager callServiceWithServiceCallInfo:serviceInfo];
+    [self waitForExpectationsWithTimeout:BENCHMARK_SLOW_CHUNKS * BENCHMARK_SLOW_CHUNK_INTERVAL * 2 handler:nil];
+
+    // the body keeps arriving for seconds, the call ends at deadline
+    NSTimeInterval duration = CFAbsoluteTimeGetCurrent() - startTime;
+    XCTAssertEqual(failureError.code, NSURLErrorTimedOut);
+    XCTAssertLessThan(duration, BENCHMARK_DEADLINE + 2 * BENCHMARK_SLOW_CHUNK_INTERVAL);
+    XCTAssertFalse(self.serviceManager.hasPendingOperations);
+}
+
+@end
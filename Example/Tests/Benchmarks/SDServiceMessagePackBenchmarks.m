@@ -0,0 +1,288 @@
+//
+//  SDServiceMessagePackBenchmarks.m
+//  DockerTests
+//
+//  SDServiceMessagePackCodec against NSJSONSerialization on the fixture corpus (item lists of growing size): decoding and encoding time,
+//  size of bodies and equality of decoded objects and mapped models, then calls that send and receive MessagePack bodies through a local stub.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT).
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_MESSAGE_PACK_RUNS         2000
+#define BENCHMARK_MESSAGE_PACK_CALLS        20
+#define BENCHMARK_MESSAGE_PACK_CALL_COUNT   100
+#define BENCHMARK_MESSAGE_PACK_TIMEOUT      30.
+
+static AFHTTPRequestOperationManager* messagePackRequestOperationManager = nil;
+
+/**
+ *  List of items asked with a MessagePack body, answered in MessagePack when the client accepts it.
+ */
+@interface SDBenchmarkMessagePackItemListService : SDBenchmarkItemListService
+
+@end
+
+@implementation SDBenchmarkMessagePackItemListService
+
+- (NSString*) pathResource
+{
+    return @"/msgpack/items";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodPOST;
+}
+
+- (NSString*) bodyContentType
+{
+    return @"application/msgpack";
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return messagePackRequestOperationManager;
+}
+
+@end
+
+
+@interface SDServiceMessagePackBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDBenchmarkHTTPServer* server;
+@property (atomic, assign) NSUInteger numberOfMessagePackRequests;
+@property (atomic, assign) NSUInteger numberOfMessagePackResponses;
+
+@end
+
+@implementation SDServiceMessagePackBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    self.server = [SDBenchmarkHTTPServer new];
+    [self installHandlersOnServer:self.server];
+    NSError* error = nil;
+    XCTAssertTrue([self.server startWithError:&error], @"%@", error);
+
+    messagePackRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:self.server.baseURL];
+    messagePackRequestOperationManager.requestSerializer = [AFJSONRequestSerializer serializer];
+    messagePackRequestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+}
+
+- (void) tearDown
+{
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+- (void) installHandlersOnServer:(SDBenchmarkHTTPServer*)server
+{
+    SDServiceMessagePackCodec* codec = [SDServiceMessagePackCodec new];
+    __weak typeof (self) weakself = self;
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        // body decoded as its Content-Type says: a mislabeled body fails the call
+        NSString* contentType = request.headers[@"content-type"];
+        BOOL messagePackBody = [contentType isEqualToString:@"application/msgpack"];
+        NSDictionary* parameters = nil;
+        if (messagePackBody)
+        {
+            parameters = [codec objectWithData:request.body error:NULL];
+        }
+        else if ([contentType hasPrefix:@"application/json"])
+        {
+            parameters = [NSJSONSerialization JSONObjectWithData:request.body options:0 error:NULL];
+        }
+        if (![parameters isKindOfClass:[NSDictionary class]] || ![parameters[@"count"] isKindOfClass:[NSNumber class]])
+        {
+            return [SDBenchmarkHTTPResponse responseWithStatusCode:400 JSONData:nil];
+        }
+        if (messagePackBody)
+        {
+            @synchronized (weakself)
+            {
+                weakself.numberOfMessagePackRequests++;
+            }
+        }
+
+        NSArray* items = [SDServiceMessagePackBenchmarks itemsWithCount:[parameters[@"count"] unsignedIntegerValue]];
+        if ([request.headers[@"accept"] hasPrefix:@"application/msgpack"])
+        {
+            @synchronized (weakself)
+            {
+                weakself.numberOfMessagePackResponses++;
+            }
+            SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:[codec dataWithObject:items error:NULL]];
+            NSMutableDictionary* headers = [response.headers mutableCopy];
+            headers[@"Content-Type"] = @"application/msgpack";
+            response.headers = headers;
+            return response;
+        }
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:[NSJSONSerialization dataWithJSONObject:items options:0 error:NULL]];
+    } forPathPrefix:@"/msgpack/items"];
+}
+
++ (NSArray*) itemsWithCount:(NSUInteger)count
+{
+    NSMutableArray* items = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [items addObject:[SDBenchmarkItem JSONObjectForIdentifier:i]];
+    }
+    return items;
+}
+
+- (SDBenchmarkResult*) measureName:(NSString*)name runs:(NSUInteger)runs parameters:(NSDictionary*)parameters block:(BOOL (^)(void))block
+{
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:runs];
+    NSUInteger successes = 0;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger run = 0; run < runs; run++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime runStartTime = CFAbsoluteTimeGetCurrent();
+            BOOL success = block();
+            [latencies addObject:@(CFAbsoluteTimeGetCurrent() - runStartTime)];
+            successes += success ? 1 : 0;
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = runs;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = runs - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = parameters;
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+#pragma mark - Scenarios
+
+- (void) testCodecOnFixtureCorpus
+{
+    SDServiceMessagePackCodec* codec = [SDServiceMessagePackCodec new];
+    SDBenchmarkItemListService* service = [SDBenchmarkItemListService new];
+    for (NSNumber* count in @[@1, @10, @100, @1000])
+    {
+        NSData* JSONData = [NSJSONSerialization dataWithJSONObject:[[self class] itemsWithCount:count.unsignedIntegerValue] options:0 error:NULL];
+        id JSONObject = [NSJSONSerialization JSONObjectWithData:JSONData options:0 error:NULL];
+        NSError* error = nil;
+        NSData* messagePackData = [codec dataWithObject:JSONObject error:&error];
+        XCTAssertNotNil(messagePackData, @"%@", error);
+
+        // same object graph, so same models
+        id messagePackObject = [codec objectWithData:messagePackData error:&error];
+        XCTAssertEqualObjects(messagePackObject, JSONObject, @"%@", error);
+        SDBenchmarkItemListResponse* JSONResponse = (SDBenchmarkItemListResponse*)[service responseForObject:JSONObject error:NULL];
+        SDBenchmarkItemListResponse* messagePackResponse = (SDBenchmarkItemListResponse*)[service responseForObject:messagePackObject error:NULL];
+        XCTAssertEqual(messagePackResponse.items.count, count.unsignedIntegerValue);
+        XCTAssertEqualObjects(messagePackResponse.items, JSONResponse.items);
+        XCTAssertLessThan(messagePackData.length, JSONData.length);
+
+        NSUInteger runs = [SDBenchmarkRunner scaledCount:BENCHMARK_MESSAGE_PACK_RUNS / count.unsignedIntegerValue * 10 minimum:10];
+        NSDictionary* parameters = @{ @"items" : count, @"json_bytes" : @(JSONData.length), @"msgpack_bytes" : @(messagePackData.length) };
+        SDBenchmarkResult* JSONDecoding = [self measureName:[NSString stringWithFormat:@"json_decode_%@", count] runs:runs parameters:parameters block:^BOOL{
+            return [NSJSONSerialization JSONObjectWithData:JSONData options:0 error:NULL] != nil;
+        }];
+        SDBenchmarkResult* messagePackDecoding = [self measureName:[NSString stringWithFormat:@"msgpack_decode_%@", count] runs:runs parameters:parameters block:^BOOL{
+            return [codec objectWithData:messagePackData error:NULL] != nil;
+        }];
+        [self measureName:[NSString stringWithFormat:@"json_encode_%@", count] runs:runs parameters:parameters block:^BOOL{
+            return [NSJSONSerialization dataWithJSONObject:JSONObject options:0 error:NULL] != nil;
+        }];
+        [self measureName:[NSString stringWithFormat:@"msgpack_encode_%@", count] runs:runs parameters:parameters block:^BOOL{
+            return [codec dataWithObject:JSONObject error:NULL] != nil;
+        }];
+        XCTAssertEqual(JSONDecoding.failures, 0);
+        XCTAssertEqual(messagePackDecoding.failures, 0);
+    }
+}
+
+- (void) testMalformedData
+{
+    SDServiceMessagePackCodec* codec = [SDServiceMessagePackCodec new];
+    NSData* data = [codec dataWithObject:@{ @"title" : @"Item", @"values" : @[@1, @-1, @300, @-70000, @(UINT64_MAX), @1.5, @YES, [NSNull null]] } error:NULL];
+    XCTAssertEqualObjects([codec objectWithData:data error:NULL][@"values"], (@[@1, @-1, @300, @-70000, @(UINT64_MAX), @1.5, @YES, [NSNull null]]));
+
+    // every truncation fails without exceptions
+    for (NSUInteger length = 0; length < data.length; length++)
+    {
+        NSError* error = nil;
+        XCTAssertNil([codec objectWithData:[data subdataWithRange:NSMakeRange(0, length)] error:&error]);
+        XCTAssertEqualObjects(error.domain, SDServiceMessagePackErrorDomain);
+    }
+
+    NSError* error = nil;
+    const uint8_t invalidString[] = { 0xa2, 0xff, 0xfe };
+    XCTAssertNil([codec objectWithData:[NSData dataWithBytes:invalidString length:sizeof(invalidString)] error:&error]);
+    XCTAssertEqual(error.code, SDServiceMessagePackErrorCodeInvalidData);
+
+    const uint8_t hugeArray[] = { 0xdd, 0xff, 0xff, 0xff, 0xff };
+    XCTAssertNil([codec objectWithData:[NSData dataWithBytes:hugeArray length:sizeof(hugeArray)] error:&error]);
+    XCTAssertEqual(error.code, SDServiceMessagePackErrorCodeTruncatedData);
+
+    NSMutableData* deepArrays = [NSMutableData dataWithLength:SDServiceMessagePackMaximumDepth + 2];
+    memset(deepArrays.mutableBytes, 0x91, deepArrays.length);
+    XCTAssertNil([codec objectWithData:deepArrays error:&error]);
+    XCTAssertEqual(error.code, SDServiceMessagePackErrorCodeTooDeep);
+
+    XCTAssertNil([codec dataWithObject:@{ @"date" : [NSDate date] } error:&error]);
+    XCTAssertEqual(error.code, SDServiceMessagePackErrorCodeUnsupportedType);
+}
+
+- (void) testMessagePackCalls
+{
+    SDServiceManager* serviceManager = [SDServiceManager new];
+    serviceManager.deferredRequestQueue = nil;
+    SDBenchmarkMessagePackItemListService* service = [SDBenchmarkMessagePackItemListService new];
+    NSUInteger numberOfCalls = MIN([SDBenchmarkRunner scaledCount:BENCHMARK_MESSAGE_PACK_CALLS minimum:10], 200);
+
+    SDBenchmarkScenario* scenario = [SDBenchmarkScenario scenarioWithName:@"msgpack_calls" numberOfCalls:numberOfCalls concurrency:4 callBlock:^(NSUInteger index, void (^completion)(BOOL success)) {
+        SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+        request.count = @(BENCHMARK_MESSAGE_PACK_CALL_COUNT);
+        [serviceManager callService:service withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            completion(((SDBenchmarkItemListResponse*)response).items.count == BENCHMARK_MESSAGE_PACK_CALL_COUNT);
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            completion(NO);
+        }];
+    }];
+    SDBenchmarkResult* result = [[SDBenchmarkRunner new] runScenario:scenario timeout:BENCHMARK_MESSAGE_PACK_TIMEOUT];
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+
+    XCTAssertTrue(result.completed);
+    XCTAssertEqual(result.failures, 0);
+    XCTAssertEqual(self.numberOfMessagePackRequests, self.server.numberOfRequests);
+    XCTAssertEqual(self.numberOfMessagePackResponses, self.server.numberOfRequests);
+
+    // without the codec the same service falls back to JSON
+    [serviceManager unregisterBodyCodecForContentType:@"application/msgpack"];
+    XCTestExpectation* expectation = [self expectationWithDescription:@"json"];
+    SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+    request.count = @(BENCHMARK_MESSAGE_PACK_CALL_COUNT);
+    NSUInteger numberOfMessagePackRequests = self.numberOfMessagePackRequests;
+    [serviceManager callService:service withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+        XCTAssertEqual(((SDBenchmarkItemListResponse*)response).items.count, BENCHMARK_MESSAGE_PACK_CALL_COUNT);
+        [expectation fulfill];
+    } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+        XCTFail(@"%@", error);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:BENCHMARK_MESSAGE_PACK_TIMEOUT handler:nil];
+    XCTAssertEqual(self.numberOfMessagePackRequests, numberOfMessagePackRequests);
+}
+
+@end
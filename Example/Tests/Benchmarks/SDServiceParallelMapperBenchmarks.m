@@ -0,0 +1,196 @@
+//
+//  SDServiceParallelMapperBenchmarks.m
+//  DockerTests
+//
+//  Mapping of a 50k items array with SDServiceParallelMapper, from 1 to 6 workers, against the sequential mapping of MTLJSONAdapter.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT), latencies are the time to map the whole array in every run.
+//  Speedup of every scenario is relative to the sequential mapping.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkRunner.h"
+#import "SDBenchmarkServices.h"
+
+#define BENCHMARK_PARALLEL_ITEMS            50000
+#define BENCHMARK_PARALLEL_RUNS             5
+#define BENCHMARK_PARALLEL_MAX_WORKERS      6
+
+@interface SDServiceParallelMapperBenchmarks : XCTestCase
+
+@property (nonatomic, strong) NSArray<NSDictionary*>* JSONArray;
+
+@end
+
+@implementation SDServiceParallelMapperBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    NSUInteger numberOfItems = [SDBenchmarkRunner scaledCount:BENCHMARK_PARALLEL_ITEMS minimum:1000];
+    NSMutableArray<NSDictionary*>* JSONArray = [NSMutableArray arrayWithCapacity:numberOfItems];
+    for (NSUInteger i = 0; i < numberOfItems; i++)
+    {
+        [JSONArray addObject:[SDBenchmarkItem JSONObjectForIdentifier:i]];
+    }
+    self.JSONArray = JSONArray;
+}
+
+- (SDServiceParallelMapper*) mapperWithWorkers:(NSUInteger)numberOfWorkers
+{
+    SDServiceParallelMapper* mapper = [SDServiceParallelMapper new];
+    mapper.maximumConcurrency = numberOfWorkers;
+    return mapper;
+}
+
+- (NSArray*) mapWithMapper:(SDServiceParallelMapper*)mapper error:(NSError**)error
+{
+    return [mapper mapArray:self.JSONArray withBlock:^id(id JSONDictionary, NSError** itemError) {
+        return [MTLJSONAdapter modelOfClass:[SDBenchmarkItem class] fromJSONDictionary:JSONDictionary error:itemError];
+    } chunkBlock:nil error:error];
+}
+
+- (SDBenchmarkResult*) measureWithName:(NSString*)name workers:(NSUInteger)numberOfWorkers baseline:(SDBenchmarkResult*)baseline mapBlock:(NSArray* (^)(void))mapBlock
+{
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:BENCHMARK_PARALLEL_RUNS];
+    NSUInteger successes = 0;
+
+    // warmup: Mantle caches of the model class
+    mapBlock();
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger run = 0; run < BENCHMARK_PARALLEL_RUNS; run++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime runStartTime = CFAbsoluteTimeGetCurrent();
+            NSArray* models = mapBlock();
+            [latencies addObject:@(CFAbsoluteTimeGetCurrent() - runStartTime)];
+            successes += models.count == self.JSONArray.count ? 1 : 0;
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = BENCHMARK_PARALLEL_RUNS;
+    result.concurrency = numberOfWorkers;
+    result.successes = successes;
+    result.failures = BENCHMARK_PARALLEL_RUNS - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    NSMutableDictionary* parameters = [NSMutableDictionary dictionaryWithDictionary:@{ @"items" : @(self.JSONArray.count), @"cores" : @([NSProcessInfo processInfo].activeProcessorCount) }];
+    if (baseline)
+    {
+        parameters[@"speedup"] = @([baseline latencyAtPercentile:50] / [result latencyAtPercentile:50]);
+    }
+    result.parameters = parameters;
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+#pragma mark - Scenarios
+
+- (void) testSameModels
+{
+    NSError* error = nil;
+    NSArray* sequentialModels = [MTLJSONAdapter modelsOfClass:[SDBenchmarkItem class] fromJSONArray:self.JSONArray error:&error];
+    XCTAssertNotNil(sequentialModels, @"%@", error);
+
+    SDServiceParallelMapper* mapper = [self mapperWithWorkers:BENCHMARK_PARALLEL_MAX_WORKERS];
+    mapper.chunkSize = 333;
+    NSMutableArray* chunkedModels = [NSMutableArray array];
+    NSArray* parallelModels = [mapper mapArray:self.JSONArray withBlock:^id(id JSONDictionary, NSError** itemError) {
+        return [MTLJSONAdapter modelOfClass:[SDBenchmarkItem class] fromJSONDictionary:JSONDictionary error:itemError];
+    } chunkBlock:^(NSArray* items, NSUInteger firstIndex) {
+        XCTAssertEqual(firstIndex, chunkedModels.count);
+        [chunkedModels addObjectsFromArray:items];
+    } error:&error];
+    XCTAssertEqualObjects(parallelModels, sequentialModels, @"%@", error);
+    XCTAssertEqualObjects(chunkedModels, sequentialModels);
+}
+
+- (void) testItemError
+{
+    NSMutableArray* JSONArray = [self.JSONArray mutableCopy];
+    JSONArray[JSONArray.count / 2] = @"not a dictionary";
+    self.JSONArray = JSONArray;
+
+    NSError* error = nil;
+    XCTAssertNil([self mapWithMapper:[self mapperWithWorkers:BENCHMARK_PARALLEL_MAX_WORKERS] error:&error]);
+    XCTAssertEqualObjects(error.domain, MTLJSONAdapterErrorDomain);
+}
+
+- (void) testBoundedByMappingExecutor
+{
+    SDServiceMappingExecutor* executor = [SDServiceMappingExecutor new];
+    executor.maximumConcurrency = 3;
+    SDServiceParallelMapper* mapper = [self mapperWithWorkers:BENCHMARK_PARALLEL_MAX_WORKERS];
+    mapper.threshold = 1000;
+    mapper.chunkSize = 100;
+    NSArray* JSONArray = [self.JSONArray subarrayWithRange:NSMakeRange(0, 1000)];
+
+    // a block keeps one of the three workers busy: the mapping can use only the calling worker and one more
+    dispatch_semaphore_t blockerStarted = dispatch_semaphore_create(0);
+    dispatch_semaphore_t releaseBlocker = dispatch_semaphore_create(0);
+    [executor addBlock:^{
+        dispatch_semaphore_signal(blockerStarted);
+        dispatch_semaphore_wait(releaseBlocker, DISPATCH_TIME_FOREVER);
+    } priority:SDServiceCallPriorityNormal];
+    dispatch_semaphore_wait(blockerStarted, DISPATCH_TIME_FOREVER);
+
+    NSObject* lock = [NSObject new];
+    __block NSUInteger numberOfMappingThreads = 0;
+    __block NSUInteger peakNumberOfMappingThreads = 0;
+    __block NSArray* models = nil;
+    XCTestExpectation* expectation = [self expectationWithDescription:@"mapping"];
+    [executor addBlock:^{
+        models = [mapper mapArray:JSONArray withBlock:^id(id JSONDictionary, NSError** itemError) {
+            @synchronized (lock)
+            {
+                numberOfMappingThreads++;
+                peakNumberOfMappingThreads = MAX(peakNumberOfMappingThreads, numberOfMappingThreads);
+            }
+            usleep(200);
+            @synchronized (lock)
+            {
+                numberOfMappingThreads--;
+            }
+            return JSONDictionary;
+        } chunkBlock:nil error:NULL];
+        [expectation fulfill];
+    } priority:SDServiceCallPriorityNormal];
+    [self waitForExpectationsWithTimeout:30. handler:nil];
+
+    XCTAssertEqualObjects(models, JSONArray);
+    XCTAssertLessThanOrEqual(peakNumberOfMappingThreads, 2);
+
+    // workers taken by the mapping are given back: only the blocker is still busy
+    while (executor.numberOfRunningBlocks > 1)
+    {
+        usleep(1000);
+    }
+    XCTAssertEqual([executor acquireFreeWorkers:3], 2);
+    [executor releaseWorkers:2];
+    dispatch_semaphore_signal(releaseBlocker);
+}
+
+- (void) testScaling
+{
+    __weak typeof (self) weakself = self;
+    SDBenchmarkResult* baseline = [self measureWithName:@"parallel_mapping_sequential" workers:1 baseline:nil mapBlock:^NSArray* {
+        return [MTLJSONAdapter modelsOfClass:[SDBenchmarkItem class] fromJSONArray:weakself.JSONArray error:NULL];
+    }];
+
+    for (NSUInteger numberOfWorkers = 1; numberOfWorkers <= BENCHMARK_PARALLEL_MAX_WORKERS; numberOfWorkers++)
+    {
+        SDServiceParallelMapper* mapper = [self mapperWithWorkers:numberOfWorkers];
+        [self measureWithName:[NSString stringWithFormat:@"parallel_mapping_%lu_workers", (unsigned long)numberOfWorkers] workers:numberOfWorkers baseline:baseline mapBlock:^NSArray* {
+            return [weakself mapWithMapper:mapper error:NULL];
+        }];
+    }
+}
+
+@end
@@ -0,0 +1,215 @@
+//
+//  SDServicePollingSchedulerBenchmarks.m
+//  DockerTests
+//
+//  SDServicePollingScheduler against a local stub whose response changes every few requests: many identical subscriptions
+//  coalesced in one poll, conditional requests with ETag (304) and with digest of the body, backoff while nothing changes.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT): requests that reached the server compared with one timer per subscriber.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkServices.h"
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_POLLING_DURATION          3.
+#define BENCHMARK_POLLING_INTERVAL          0.05
+#define BENCHMARK_POLLING_SUBSCRIPTIONS     20
+#define BENCHMARK_POLLING_CHANGE_EVERY      5
+
+static AFHTTPRequestOperationManager* pollingRequestOperationManager = nil;
+
+@interface SDBenchmarkPolledItemService : SDBenchmarkItemService
+
+@property (nonatomic, strong) NSString* path;
+
+@end
+
+@implementation SDBenchmarkPolledItemService
+
+- (NSString*) pathResource
+{
+    return self.path;
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return pollingRequestOperationManager;
+}
+
+@end
+
+
+@interface SDServicePollingSchedulerBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDBenchmarkHTTPServer* server;
+@property (nonatomic, strong) SDServiceManager* serviceManager;
+
+@end
+
+@implementation SDServicePollingSchedulerBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    self.server = [SDBenchmarkHTTPServer new];
+    [self installHandlersOnServer:self.server];
+    NSError* error = nil;
+    XCTAssertTrue([self.server startWithError:&error], @"%@", error);
+
+    pollingRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:self.server.baseURL];
+    pollingRequestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+    self.serviceManager = [[SDServiceManager alloc] init];
+}
+
+- (void) tearDown
+{
+    [self.serviceManager.pollingScheduler unsubscribeAll];
+    self.serviceManager = nil;
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+- (void) installHandlersOnServer:(SDBenchmarkHTTPServer*)server
+{
+    // new version of the item every few requests, validated with ETag
+    __block NSUInteger numberOfRequests = 0;
+    NSObject* lock = [NSObject new];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        NSUInteger version = 0;
+        @synchronized (lock)
+        {
+            version = numberOfRequests++ / BENCHMARK_POLLING_CHANGE_EVERY;
+        }
+        NSString* entityTag = [NSString stringWithFormat:@"\"v%lu\"", (unsigned long)version];
+        if ([request.headers[@"if-none-match"] isEqualToString:entityTag])
+        {
+            SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse new];
+            response.statusCode = 304;
+            response.headers = @{ @"ETag" : entityTag, @"Cache-Control" : @"no-store" };
+            return response;
+        }
+        NSData* data = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:version] } options:0 error:NULL];
+        SDBenchmarkHTTPResponse* response = [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:data];
+        NSMutableDictionary* headers = [response.headers mutableCopy];
+        headers[@"ETag"] = entityTag;
+        response.headers = headers;
+        return response;
+    } forPathPrefix:@"/polled/etag"];
+
+    // never changes and has no validators: unchanged responses are detected by digest
+    NSData* itemData = [NSJSONSerialization dataWithJSONObject:@{ @"item" : [SDBenchmarkItem JSONObjectForIdentifier:1] } options:0 error:NULL];
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:itemData];
+    } forPathPrefix:@"/polled/plain"];
+}
+
++ (NSTimeInterval) scaledDuration:(NSTimeInterval)duration
+{
+    return MAX(duration * [SDBenchmarkRunner scale], 1.);
+}
+
+- (void) waitForDuration:(NSTimeInterval)duration
+{
+    XCTestExpectation* expectation = [self expectationWithDescription:@"polling"];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(duration * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:duration + 10 handler:nil];
+}
+
+#pragma mark - Scenarios
+
+- (void) testCoalescedConditionalPolling
+{
+    SDServicePollingScheduler* scheduler = self.serviceManager.pollingScheduler;
+    NSTimeInterval duration = [[self class] scaledDuration:BENCHMARK_POLLING_DURATION];
+    NSUInteger initialRequests = self.server.numberOfRequests;
+
+    // every screen subscribes to the same item
+    NSMutableArray<NSMutableArray<NSNumber*>*>* notifiedVersions = [NSMutableArray array];
+    __block NSUInteger failures = 0;
+    for (NSUInteger i = 0; i < BENCHMARK_POLLING_SUBSCRIPTIONS; i++)
+    {
+        SDBenchmarkPolledItemService* service = [SDBenchmarkPolledItemService new];
+        service.path = @"/polled/etag/:itemId";
+        SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+        request.itemId = @1;
+        NSMutableArray<NSNumber*>* versions = [NSMutableArray array];
+        [notifiedVersions addObject:versions];
+        [scheduler subscribeToService:service withRequest:request interval:BENCHMARK_POLLING_INTERVAL changeHandler:^(id<SDServiceGenericResponseProtocol> response) {
+            [versions addObject:[(SDBenchmarkItemResponse*)response item].identifier];
+        } failureHandler:^(id<SDServiceGenericErrorProtocol> error) {
+            failures++;
+        }];
+    }
+    XCTAssertEqual(scheduler.numberOfPolls, 1);
+    XCTAssertEqual(scheduler.numberOfSubscriptions, BENCHMARK_POLLING_SUBSCRIPTIONS);
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    [self waitForDuration:duration];
+    [scheduler unsubscribeAll];
+    NSTimeInterval wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    NSUInteger serverRequests = self.server.numberOfRequests - initialRequests;
+
+    XCTAssertEqual(failures, 0);
+    XCTAssertGreaterThan(scheduler.numberOfUnchangedResponses, 0);
+    for (NSMutableArray<NSNumber*>* versions in notifiedVersions)
+    {
+        // notified only on change, every subscriber sees the same versions
+        XCTAssertGreaterThan(versions.count, 0);
+        XCTAssertEqualObjects(versions, notifiedVersions.firstObject);
+        XCTAssertEqual([NSSet setWithArray:versions].count, versions.count);
+    }
+    XCTAssertLessThanOrEqual(serverRequests, scheduler.numberOfCalls);
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = @"polling_coalesced_etag";
+    result.numberOfCalls = scheduler.numberOfCalls;
+    result.concurrency = 1;
+    result.successes = scheduler.numberOfCalls - failures;
+    result.failures = failures;
+    result.completed = YES;
+    result.wallTime = wallTime;
+    result.parameters = @{ @"subscriptions" : @(BENCHMARK_POLLING_SUBSCRIPTIONS),
+                           @"interval_ms" : @(BENCHMARK_POLLING_INTERVAL * 1000.),
+                           @"server_requests" : @(serverRequests),
+                           @"requests_with_one_timer_per_subscriber" : @((NSUInteger)(BENCHMARK_POLLING_SUBSCRIPTIONS * wallTime / BENCHMARK_POLLING_INTERVAL)),
+                           @"not_modified_responses" : @(scheduler.numberOfUnchangedResponses),
+                           @"notifications_per_subscriber" : @(notifiedVersions.firstObject.count) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+}
+
+- (void) testUnchangedBodyBacksOff
+{
+    SDServicePollingScheduler* scheduler = self.serviceManager.pollingScheduler;
+    SDBenchmarkPolledItemService* service = [SDBenchmarkPolledItemService new];
+    service.path = @"/polled/plain/:itemId";
+    SDBenchmarkItemRequest* request = [SDBenchmarkItemRequest new];
+    request.itemId = @1;
+
+    __block NSUInteger notifications = 0;
+    SDServicePollingSubscription* subscription = [scheduler subscribeToService:service withRequest:request interval:BENCHMARK_POLLING_INTERVAL changeHandler:^(id<SDServiceGenericResponseProtocol> response) {
+        notifications++;
+    } failureHandler:nil];
+
+    [self waitForDuration:[[self class] scaledDuration:1.]];
+
+    XCTAssertEqual(notifications, 1);
+    XCTAssertGreaterThan(scheduler.numberOfCalls, 2);
+    XCTAssertGreaterThanOrEqual(scheduler.numberOfUnchangedResponses + 2, scheduler.numberOfCalls);
+    XCTAssertGreaterThan([scheduler currentIntervalOfSubscription:subscription], BENCHMARK_POLLING_INTERVAL);
+
+    // pull to refresh resets backoff
+    [scheduler pollNow:subscription];
+    XCTAssertEqualWithAccuracy([scheduler currentIntervalOfSubscription:subscription], BENCHMARK_POLLING_INTERVAL, 0.0001);
+    [scheduler unsubscribe:subscription];
+    XCTAssertFalse(subscription.isActive);
+    XCTAssertEqual(scheduler.numberOfPolls, 0);
+}
+
+@end
@@ -0,0 +1,333 @@
+//
+//  SDServiceRateLimiterBenchmarks.m
+//  DockerTests
+//
+//  SDServiceRateLimiter driven by a manual clock: token bucket burst and refill, priority of waiting calls, shedding of a full queue,
+//  maximum waiting time, Retry-After (seconds and HTTP date) and RateLimit-Remaining/Reset headers (seconds and epoch time).
+//  Cost of acquiring tokens with hundreds of waiting calls.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT).
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_RATE_LIMIT_HOST           @"api.example.com"
+#define BENCHMARK_RATE_LIMIT_PATH           @"/items/:itemId"
+#define BENCHMARK_RATE_LIMIT_ACQUIRES       20000
+#define BENCHMARK_RATE_LIMIT_BATCH          100
+#define BENCHMARK_RATE_LIMIT_WAITING_CALLS  200
+
+@interface SDServiceRateLimiterBenchmarks : XCTestCase
+
+@property (nonatomic, strong) SDServiceRateLimiter* rateLimiter;
+@property (nonatomic, assign) CFAbsoluteTime now;
+
+/**
+ *  Results of the calls in order of completion: name of the call, or name and error code.
+ */
+@property (nonatomic, strong) NSMutableArray<NSString*>* results;
+
+@end
+
+@implementation SDServiceRateLimiterBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    // whole seconds: HTTP dates have no fraction
+    self.now = floor(CFAbsoluteTimeGetCurrent());
+    self.results = [NSMutableArray array];
+    self.rateLimiter = [SDServiceRateLimiter new];
+    __weak typeof (self) weakself = self;
+    self.rateLimiter.clock = ^CFAbsoluteTime {
+        return weakself.now;
+    };
+}
+
+- (void) tearDown
+{
+    self.rateLimiter = nil;
+    [super tearDown];
+}
+
+- (id) acquireWithName:(NSString*)name priority:(SDServiceCallPriority)priority maximumWaitingTime:(NSTimeInterval)maximumWaitingTime
+{
+    NSMutableArray<NSString*>* results = self.results;
+    return [self.rateLimiter acquireForHost:BENCHMARK_RATE_LIMIT_HOST pathResource:BENCHMARK_RATE_LIMIT_PATH priority:priority maximumWaitingTime:maximumWaitingTime completion:^(NSError* error) {
+        [results addObject:error ? [NSString stringWithFormat:@"%@ %ld", name, (long)error.code] : name];
+    }];
+}
+
+- (id) acquireWithName:(NSString*)name
+{
+    return [self acquireWithName:name priority:SDServiceCallPriorityNormal maximumWaitingTime:DBL_MAX];
+}
+
+- (void) advanceBy:(NSTimeInterval)interval
+{
+    self.now += interval;
+    [self.rateLimiter processTickets];
+}
+
+- (void) updateWithStatusCode:(NSInteger)statusCode headers:(NSDictionary<NSString*, NSString*>*)headers
+{
+    NSURL* URL = [NSURL URLWithString:[NSString stringWithFormat:@"https://%@/items/1", BENCHMARK_RATE_LIMIT_HOST]];
+    NSHTTPURLResponse* response = [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    [self.rateLimiter updateWithResponse:response pathResource:BENCHMARK_RATE_LIMIT_PATH];
+}
+
+#pragma mark - Token bucket
+
+- (void) testBurstAndRefill
+{
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:2 burst:3] forHost:@"API.example.com"];
+
+    // burst is served synchronously
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        [self acquireWithName:[NSString stringWithFormat:@"call%lu", (unsigned long)i]];
+    }
+    XCTAssertEqualObjects(self.results, (@[@"call0", @"call1", @"call2"]));
+    XCTAssertEqual(self.rateLimiter.numberOfWaitingCalls, 1);
+
+    // a token every 0.5 seconds
+    [self advanceBy:0.25];
+    XCTAssertEqual(self.results.count, 3);
+    [self advanceBy:0.25];
+    XCTAssertEqualObjects(self.results.lastObject, @"call3");
+    XCTAssertEqual(self.rateLimiter.numberOfWaitingCalls, 0);
+
+    // a long quiet period refills the bucket up to burst only
+    [self advanceBy:60];
+    [self.results removeAllObjects];
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        [self acquireWithName:[NSString stringWithFormat:@"call%lu", (unsigned long)i]];
+    }
+    XCTAssertEqual(self.results.count, 3);
+    XCTAssertEqual(self.rateLimiter.numberOfWaitingCalls, 1);
+}
+
+- (void) testHostAndPathResourceBuckets
+{
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:10 burst:10] forHost:BENCHMARK_RATE_LIMIT_HOST];
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:1 burst:1] forPathResource:BENCHMARK_RATE_LIMIT_PATH];
+
+    // the slowest bucket wins
+    [self acquireWithName:@"first"];
+    [self acquireWithName:@"second"];
+    XCTAssertEqualObjects(self.results, @[@"first"]);
+    [self advanceBy:0.5];
+    XCTAssertEqual(self.results.count, 1);
+    [self advanceBy:0.5];
+    XCTAssertEqualObjects(self.results.lastObject, @"second");
+
+    // limit removed: calls are not limited anymore
+    [self.rateLimiter setLimit:nil forPathResource:BENCHMARK_RATE_LIMIT_PATH];
+    [self acquireWithName:@"third"];
+    XCTAssertEqualObjects(self.results.lastObject, @"third");
+}
+
+#pragma mark - Waiting calls
+
+- (void) testPriorityOrdering
+{
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:1 burst:1] forHost:BENCHMARK_RATE_LIMIT_HOST];
+    [self acquireWithName:@"first"];
+
+    [self acquireWithName:@"low" priority:SDServiceCallPriorityLow maximumWaitingTime:DBL_MAX];
+    [self acquireWithName:@"normal1" priority:SDServiceCallPriorityNormal maximumWaitingTime:DBL_MAX];
+    [self acquireWithName:@"high" priority:SDServiceCallPriorityHigh maximumWaitingTime:DBL_MAX];
+    [self acquireWithName:@"normal2" priority:SDServiceCallPriorityNormal maximumWaitingTime:DBL_MAX];
+    id cancelledTicket = [self acquireWithName:@"cancelled" priority:SDServiceCallPriorityHigh maximumWaitingTime:DBL_MAX];
+    [self.rateLimiter cancelTicket:cancelledTicket];
+
+    // by priority, then in order of arrival: a call at a time
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        [self advanceBy:1];
+        XCTAssertEqual(self.results.count, i + 2);
+    }
+    XCTAssertEqualObjects(self.results, (@[@"first", @"high", @"normal1", @"normal2", @"low"]));
+}
+
+- (void) testSheddingAtMaximumQueueLength
+{
+    self.rateLimiter.maximumQueueLength = 2;
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:1 burst:1] forHost:BENCHMARK_RATE_LIMIT_HOST];
+    [self acquireWithName:@"first"];
+
+    [self acquireWithName:@"normal1"];
+    [self acquireWithName:@"normal2"];
+    XCTAssertEqual(self.results.count, 1);
+
+    // the newest call with lowest priority leaves room
+    NSString* shed = [NSString stringWithFormat:@" %ld", (long)SDServiceRateLimitErrorCodeShed];
+    [self acquireWithName:@"high" priority:SDServiceCallPriorityHigh maximumWaitingTime:DBL_MAX];
+    XCTAssertEqualObjects(self.results.lastObject, [@"normal2" stringByAppendingString:shed]);
+
+    // a call with lower priority than all waiting calls is shed immediately
+    [self acquireWithName:@"low" priority:SDServiceCallPriorityLow maximumWaitingTime:DBL_MAX];
+    XCTAssertEqualObjects(self.results.lastObject, [@"low" stringByAppendingString:shed]);
+    XCTAssertEqual(self.rateLimiter.numberOfWaitingCalls, 2);
+
+    [self advanceBy:1];
+    [self advanceBy:1];
+    XCTAssertEqualObjects(self.results, (@[@"first", [@"normal2" stringByAppendingString:shed], [@"low" stringByAppendingString:shed], @"high", @"normal1"]));
+}
+
+- (void) testWaitExceeded
+{
+    self.rateLimiter.maximumWaitingTime = 5;
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:0.01 burst:1] forHost:BENCHMARK_RATE_LIMIT_HOST];
+    [self acquireWithName:@"first"];
+
+    // the lower of the two maximum waiting times
+    [self acquireWithName:@"deadline" priority:SDServiceCallPriorityNormal maximumWaitingTime:2];
+    [self acquireWithName:@"limiter" priority:SDServiceCallPriorityNormal maximumWaitingTime:100];
+
+    NSString* exceeded = [NSString stringWithFormat:@" %ld", (long)SDServiceRateLimitErrorCodeWaitExceeded];
+    [self advanceBy:1.5];
+    XCTAssertEqual(self.results.count, 1);
+    [self advanceBy:0.5];
+    XCTAssertEqualObjects(self.results.lastObject, [@"deadline" stringByAppendingString:exceeded]);
+    [self advanceBy:2.5];
+    XCTAssertEqual(self.results.count, 2);
+    [self advanceBy:0.5];
+    XCTAssertEqualObjects(self.results.lastObject, [@"limiter" stringByAppendingString:exceeded]);
+    XCTAssertEqual(self.rateLimiter.numberOfWaitingCalls, 0);
+}
+
+#pragma mark - Response headers
+
+- (void) assertBlockedFor:(NSTimeInterval)interval
+{
+    [self.results removeAllObjects];
+    [self acquireWithName:@"blocked"];
+    XCTAssertEqual(self.results.count, 0);
+    [self advanceBy:interval - 0.5];
+    XCTAssertEqual(self.results.count, 0);
+    [self advanceBy:0.5];
+    XCTAssertEqualObjects(self.results, @[@"blocked"]);
+}
+
+- (void) testRetryAfterSeconds
+{
+    // without a configured limit: calls are not limited until server asks to wait
+    [self acquireWithName:@"free"];
+    XCTAssertEqualObjects(self.results, @[@"free"]);
+
+    // only with 429 and 503
+    [self updateWithStatusCode:500 headers:@{ @"Retry-After" : @"3" }];
+    [self acquireWithName:@"free"];
+    XCTAssertEqual(self.results.count, 2);
+
+    [self updateWithStatusCode:429 headers:@{ @"retry-after" : @"3" }];
+    [self assertBlockedFor:3];
+}
+
+- (void) testRetryAfterHTTPDate
+{
+    NSDateFormatter* formatter = [NSDateFormatter new];
+    formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+    formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+    formatter.dateFormat = @"EEE',' dd MMM yyyy HH':'mm':'ss 'GMT'";
+    NSString* date = [formatter stringFromDate:[NSDate dateWithTimeIntervalSinceReferenceDate:self.now + 5]];
+
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:100 burst:10] forHost:BENCHMARK_RATE_LIMIT_HOST];
+    [self updateWithStatusCode:503 headers:@{ @"Retry-After" : date }];
+    [self assertBlockedFor:5];
+}
+
+- (void) testRateLimitRemainingAndResetSeconds
+{
+    [self updateWithStatusCode:200 headers:@{ @"X-RateLimit-Remaining" : @"0", @"X-RateLimit-Reset" : @"4" }];
+    [self assertBlockedFor:4];
+}
+
+- (void) testRateLimitRemainingAndResetEpoch
+{
+    NSString* reset = [NSString stringWithFormat:@"%.0f", self.now + kCFAbsoluteTimeIntervalSince1970 + 6];
+    [self updateWithStatusCode:200 headers:@{ @"RateLimit-Remaining" : @"0", @"RateLimit-Reset" : reset }];
+    [self assertBlockedFor:6];
+}
+
+- (void) testRateLimitRemainingSpreadUntilReset
+{
+    // 2 calls left in 10 seconds: a call every 5 seconds, then no limit after reset
+    [self updateWithStatusCode:200 headers:@{ @"X-RateLimit-Remaining" : @"2", @"X-RateLimit-Reset" : @"10" }];
+    [self acquireWithName:@"first"];
+    XCTAssertEqualObjects(self.results, @[@"first"]);
+    [self assertBlockedFor:5.01];
+
+    [self advanceBy:5];
+    [self.results removeAllObjects];
+    for (NSUInteger i = 0; i < 5; i++)
+    {
+        [self acquireWithName:@"free"];
+    }
+    XCTAssertEqual(self.results.count, 5);
+}
+
+- (void) testResponseHeadersIgnored
+{
+    self.rateLimiter.adaptsToResponseHeaders = NO;
+    [self updateWithStatusCode:429 headers:@{ @"Retry-After" : @"3", @"X-RateLimit-Remaining" : @"0", @"X-RateLimit-Reset" : @"4" }];
+    [self acquireWithName:@"free"];
+    XCTAssertEqualObjects(self.results, @[@"free"]);
+}
+
+#pragma mark - Scenarios
+
+- (void) testAcquireWithWaitingCalls
+{
+    // calls of a path resource wait behind a blocked one: every acquire of another path resource scans them
+    self.rateLimiter.maximumQueueLength = BENCHMARK_RATE_LIMIT_WAITING_CALLS * 2;
+    [self.rateLimiter setLimit:[SDServiceRateLimit limitWithRate:0.001 burst:1] forPathResource:BENCHMARK_RATE_LIMIT_PATH];
+    for (NSUInteger i = 0; i < BENCHMARK_RATE_LIMIT_WAITING_CALLS + 1; i++)
+    {
+        [self.rateLimiter acquireForHost:BENCHMARK_RATE_LIMIT_HOST pathResource:BENCHMARK_RATE_LIMIT_PATH priority:SDServiceCallPriorityLow maximumWaitingTime:DBL_MAX completion:^(NSError* error) {
+        }];
+    }
+
+    NSUInteger numberOfAcquires = [SDBenchmarkRunner scaledCount:BENCHMARK_RATE_LIMIT_ACQUIRES minimum:BENCHMARK_RATE_LIMIT_BATCH];
+    NSUInteger numberOfBatches = numberOfAcquires / BENCHMARK_RATE_LIMIT_BATCH;
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:numberOfBatches];
+    __block NSUInteger successes = 0;
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger batch = 0; batch < numberOfBatches; batch++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime batchStartTime = CFAbsoluteTimeGetCurrent();
+            for (NSUInteger i = 0; i < BENCHMARK_RATE_LIMIT_BATCH; i++)
+            {
+                [self.rateLimiter acquireForHost:BENCHMARK_RATE_LIMIT_HOST pathResource:@"/other" priority:SDServiceCallPriorityHigh maximumWaitingTime:DBL_MAX completion:^(NSError* error) {
+                    successes += error ? 0 : 1;
+                }];
+            }
+            [latencies addObject:@((CFAbsoluteTimeGetCurrent() - batchStartTime) / BENCHMARK_RATE_LIMIT_BATCH)];
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = @"rate_limiter_acquire";
+    result.numberOfCalls = numberOfBatches * BENCHMARK_RATE_LIMIT_BATCH;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = result.numberOfCalls - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = @{ @"waiting_calls" : @(self.rateLimiter.numberOfWaitingCalls) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+
+    XCTAssertEqual(result.failures, 0);
+    XCTAssertEqual(self.rateLimiter.numberOfWaitingCalls, BENCHMARK_RATE_LIMIT_WAITING_CALLS);
+}
+
+@end
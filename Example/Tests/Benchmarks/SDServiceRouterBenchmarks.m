@@ -0,0 +1,258 @@
+//
+//  SDServiceRouterBenchmarks.m
+//  DockerTests
+//
+//  Matching of URLs against hundreds of routes: SDServiceRouter trie against the linear scan of SOCPatterns,
+//  on a typical API and on the worst case of the trie (parameter and static siblings at every level, failing at the last segment).
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT), latencies are the mean time of a lookup in every batch of lookups.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import <Docker/SOCKit.h>
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_ROUTER_RESOURCES          125
+#define BENCHMARK_ROUTER_LOOKUPS            20000
+#define BENCHMARK_ROUTER_BATCH              100
+#define BENCHMARK_ROUTER_WORST_CASE_DEPTH   8
+
+@interface SDServiceRouterBenchmarks : XCTestCase
+
+@property (nonatomic, strong) NSArray<SOCPattern*>* patterns;
+@property (nonatomic, strong) SDServiceRouter* router;
+@property (nonatomic, strong) NSArray<NSString*>* URLs;
+
+@end
+
+@implementation SDServiceRouterBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    // in the linear scan the first matching pattern wins, so static and longer patterns come first
+    NSMutableArray<SOCPattern*>* patterns = [NSMutableArray array];
+    for (NSUInteger i = 0; i < BENCHMARK_ROUTER_RESOURCES; i++)
+    {
+        [patterns addObject:[SOCPattern patternWithString:[NSString stringWithFormat:@"/api/v1/resource%lu/search", (unsigned long)i]]];
+        [patterns addObject:[SOCPattern patternWithString:[NSString stringWithFormat:@"/api/v1/resource%lu/:id/items/:itemId\\.json", (unsigned long)i]]];
+        [patterns addObject:[SOCPattern patternWithString:[NSString stringWithFormat:@"/api/v1/resource%lu/:id/items/:itemId", (unsigned long)i]]];
+        [patterns addObject:[SOCPattern patternWithString:[NSString stringWithFormat:@"/api/v1/resource%lu/:id", (unsigned long)i]]];
+    }
+    self.patterns = patterns;
+
+    self.router = [SDServiceRouter new];
+    for (SOCPattern* pattern in patterns)
+    {
+        NSError* error = nil;
+        XCTAssertNotNil([self.router addRouteWithPattern:pattern handler:pattern error:&error], @"%@", error);
+    }
+
+    NSMutableArray<NSString*>* URLs = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 1000; i++)
+    {
+        unsigned long resource = arc4random_uniform(BENCHMARK_ROUTER_RESOURCES);
+        switch (i % 5)
+        {
+            case 0:
+                [URLs addObject:[NSString stringWithFormat:@"/api/v1/resource%lu/search", resource]];
+                break;
+            case 1:
+                [URLs addObject:[NSString stringWithFormat:@"/api/v1/resource%lu/%lu/items/%lu.json", resource, (unsigned long)i, (unsigned long)i * 7]];
+                break;
+            case 2:
+                [URLs addObject:[NSString stringWithFormat:@"/api/v1/resource%lu/%lu/items/%lu", resource, (unsigned long)i, (unsigned long)i * 7]];
+                break;
+            case 3:
+                [URLs addObject:[NSString stringWithFormat:@"/api/v1/resource%lu/%lu", resource, (unsigned long)i]];
+                break;
+            default:
+                // no route
+                [URLs addObject:[NSString stringWithFormat:@"/api/v2/resource%lu/%lu", resource, (unsigned long)i]];
+                break;
+        }
+    }
+    self.URLs = URLs;
+}
+
+- (NSDictionary*) linearMatchOfString:(NSString*)string pattern:(SOCPattern**)matchingPattern
+{
+    return [self linearMatchOfString:string inPatterns:self.patterns pattern:matchingPattern];
+}
+
+- (NSDictionary*) linearMatchOfString:(NSString*)string inPatterns:(NSArray<SOCPattern*>*)patterns pattern:(SOCPattern**)matchingPattern
+{
+    for (SOCPattern* pattern in patterns)
+    {
+        if ([pattern stringMatches:string])
+        {
+            *matchingPattern = pattern;
+            return [pattern parameterDictionaryFromSourceString:string];
+        }
+    }
+    return nil;
+}
+
+/**
+ *  Routes of a complete binary trie: every segment but the last is "s" or a parameter, the last one is "end".
+ *  The static branch is tried first at every level, so "/s/s/.../s/miss" visits every node of the trie before failing.
+ */
+- (NSArray<SOCPattern*>*) worstCasePatterns
+{
+    NSMutableArray<SOCPattern*>* patterns = [NSMutableArray array];
+    for (NSUInteger mask = 0; mask < (1 << BENCHMARK_ROUTER_WORST_CASE_DEPTH); mask++)
+    {
+        NSMutableString* string = [NSMutableString string];
+        for (NSUInteger level = 0; level < BENCHMARK_ROUTER_WORST_CASE_DEPTH; level++)
+        {
+            if (mask & (1 << level))
+            {
+                [string appendString:@"/s"];
+            }
+            else
+            {
+                [string appendFormat:@"/:p%lu", (unsigned long)level];
+            }
+        }
+        [string appendString:@"/end"];
+        [patterns addObject:[SOCPattern patternWithString:string]];
+    }
+    return patterns;
+}
+
+- (NSString*) worstCaseStringWithLastSegment:(NSString*)lastSegment
+{
+    NSMutableString* string = [NSMutableString string];
+    for (NSUInteger level = 0; level < BENCHMARK_ROUTER_WORST_CASE_DEPTH; level++)
+    {
+        [string appendString:@"/s"];
+    }
+    [string appendFormat:@"/%@", lastSegment];
+    return string;
+}
+
+- (SDBenchmarkResult*) measureWithName:(NSString*)name lookupBlock:(BOOL (^)(NSString* string))lookupBlock
+{
+    return [self measureWithName:name URLs:self.URLs parameters:@{ @"routes" : @(self.patterns.count) } lookupBlock:lookupBlock];
+}
+
+- (SDBenchmarkResult*) measureWithName:(NSString*)name URLs:(NSArray<NSString*>*)URLs parameters:(NSDictionary*)parameters lookupBlock:(BOOL (^)(NSString* string))lookupBlock
+{
+    NSUInteger numberOfLookups = [SDBenchmarkRunner scaledCount:BENCHMARK_ROUTER_LOOKUPS minimum:BENCHMARK_ROUTER_BATCH];
+    NSUInteger numberOfBatches = numberOfLookups / BENCHMARK_ROUTER_BATCH;
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:numberOfBatches];
+    NSUInteger successes = 0;
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger batch = 0; batch < numberOfBatches; batch++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime batchStartTime = CFAbsoluteTimeGetCurrent();
+            for (NSUInteger i = 0; i < BENCHMARK_ROUTER_BATCH; i++)
+            {
+                successes += lookupBlock(URLs[(batch * BENCHMARK_ROUTER_BATCH + i) % URLs.count]) ? 1 : 0;
+            }
+            [latencies addObject:@((CFAbsoluteTimeGetCurrent() - batchStartTime) / BENCHMARK_ROUTER_BATCH)];
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = numberOfBatches * BENCHMARK_ROUTER_BATCH;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = result.numberOfCalls - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = parameters;
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+#pragma mark - Scenarios
+
+- (void) testSameMatches
+{
+    for (NSString* URL in self.URLs)
+    {
+        SOCPattern* pattern = nil;
+        NSDictionary* linearParameters = [self linearMatchOfString:URL pattern:&pattern];
+        SDServiceRouteMatch* match = [self.router matchString:URL];
+        XCTAssertEqual(match.route.handler, pattern, @"%@", URL);
+        if (pattern)
+        {
+            XCTAssertEqualObjects(match.parameters, linearParameters, @"%@", URL);
+        }
+    }
+}
+
+- (void) testAmbiguousRoute
+{
+    NSError* error = nil;
+    XCTAssertNil([self.router addRouteWithPatternString:@"/api/v1/resource0/:otherId" handler:nil error:&error]);
+    XCTAssertEqual(error.code, SDServiceRouterErrorCodeAmbiguousRoute);
+    XCTAssertEqualObjects(error.userInfo[SDServiceRouterConflictingPatternKey], @"/api/v1/resource0/:id");
+}
+
+- (void) testOverlappingRoutesPrecedence
+{
+    SDServiceRouter* router = [SDServiceRouter new];
+    XCTAssertNotNil([router addRouteWithPatternString:@"/:a/b" handler:@"parameter first" error:NULL]);
+    XCTAssertNotNil([router addRouteWithPatternString:@"/x/:c" handler:@"static first" error:NULL]);
+
+    // the strings matched by both routes go to the one with a static segment first, whatever the order they were added
+    XCTAssertEqualObjects([router matchString:@"/x/b"].route.handler, @"static first");
+    XCTAssertEqualObjects([router matchString:@"/x/b"].parameters, @{ @"c" : @"b" });
+    XCTAssertEqualObjects([router matchString:@"/y/b"].route.handler, @"parameter first");
+    XCTAssertEqualObjects([router matchString:@"/x/y"].route.handler, @"static first");
+    XCTAssertNil([router matchString:@"/y/y"]);
+}
+
+- (void) testWorstCaseBacktracking
+{
+    NSArray<SOCPattern*>* patterns = [self worstCasePatterns];
+    SDServiceRouter* router = [SDServiceRouter new];
+    for (SOCPattern* pattern in patterns)
+    {
+        NSError* error = nil;
+        XCTAssertNotNil([router addRouteWithPattern:pattern handler:pattern error:&error], @"%@", error);
+    }
+
+    NSString* missingString = [self worstCaseStringWithLastSegment:@"miss"];
+    XCTAssertNil([router matchString:missingString]);
+    // the last pattern has all static segments, and it wins over the patterns with parameters
+    XCTAssertEqual([router matchString:[self worstCaseStringWithLastSegment:@"end"]].route.handler, patterns.lastObject);
+
+    NSDictionary* parameters = @{ @"routes" : @(patterns.count), @"depth" : @(BENCHMARK_ROUTER_WORST_CASE_DEPTH) };
+    __weak typeof (self) weakself = self;
+    [self measureWithName:@"router_linear_scan_worst_case" URLs:@[missingString] parameters:parameters lookupBlock:^BOOL(NSString* string) {
+        SOCPattern* pattern = nil;
+        return [weakself linearMatchOfString:string inPatterns:patterns pattern:&pattern] != nil;
+    }];
+    [self measureWithName:@"router_trie_worst_case" URLs:@[missingString] parameters:parameters lookupBlock:^BOOL(NSString* string) {
+        return [router matchString:string] != nil;
+    }];
+}
+
+- (void) testLinearScan
+{
+    __weak typeof (self) weakself = self;
+    [self measureWithName:@"router_linear_scan" lookupBlock:^BOOL(NSString* string) {
+        SOCPattern* pattern = nil;
+        return [weakself linearMatchOfString:string pattern:&pattern] != nil;
+    }];
+}
+
+- (void) testTrie
+{
+    SDServiceRouter* router = self.router;
+    [self measureWithName:@"router_trie" lookupBlock:^BOOL(NSString* string) {
+        return [router matchString:string] != nil;
+    }];
+}
+
+@end
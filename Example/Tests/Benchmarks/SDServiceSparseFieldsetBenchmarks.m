@@ -0,0 +1,295 @@
+//
+//  SDServiceSparseFieldsetBenchmarks.m
+//  DockerTests
+//
+//  Sparse fieldsets derived from Mantle key paths: size, parse and mapping time of a list response whose items carry fields the app doesn't map,
+//  with all fields and with only the fields listed by fieldsParameterName (the server projection is simulated on the fixture),
+//  and placement of the fieldset in POST calls to a local stub.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT), latencies are the time to parse and map the whole response in every run.
+//
+
+@import XCTest;
+#import <Docker/SDDocker.h>
+#import "SDBenchmarkHTTPServer.h"
+#import "SDBenchmarkRunner.h"
+#import "SDBenchmarkServices.h"
+
+#define BENCHMARK_FIELDSET_ITEMS            2000
+#define BENCHMARK_FIELDSET_RUNS             5
+#define BENCHMARK_FIELDSET_SEARCH_COUNT     3
+#define BENCHMARK_FIELDSET_TIMEOUT          30.
+
+static AFHTTPRequestOperationManager* fieldsetRequestOperationManager = nil;
+
+@interface SDBenchmarkSparseItemListService : SDBenchmarkItemListService
+
+@end
+
+@implementation SDBenchmarkSparseItemListService
+
+- (NSString*) fieldsParameterName
+{
+    return @"fields";
+}
+
+@end
+
+
+/**
+ *  Same list asked with a POST body, with the fieldset where placement says.
+ */
+@interface SDBenchmarkSparseItemSearchService : SDBenchmarkSparseItemListService
+
+@property (nonatomic, assign) SDServiceFieldsPlacement placement;
+
+@end
+
+@implementation SDBenchmarkSparseItemSearchService
+
+- (NSString*) pathResource
+{
+    return @"/items/search";
+}
+
+- (SDHTTPMethod) requestMethodType
+{
+    return SDHTTPMethodPOST;
+}
+
+- (SDServiceFieldsPlacement) fieldsPlacement
+{
+    return self.placement;
+}
+
+- (AFHTTPRequestOperationManager*) requestOperationManager
+{
+    return fieldsetRequestOperationManager;
+}
+
+@end
+
+
+@interface SDServiceSparseFieldsetBenchmarks : XCTestCase
+
+@end
+
+@implementation SDServiceSparseFieldsetBenchmarks
+
+/**
+ *  Item as returned by an API that doesn't know what the app needs: mapped fields and a lot of others.
+ */
++ (NSDictionary*) fullJSONObjectForIdentifier:(NSInteger)identifier
+{
+    NSMutableDictionary* item = [[SDBenchmarkItem JSONObjectForIdentifier:identifier] mutableCopy];
+    NSMutableDictionary* owner = [item[@"owner"] mutableCopy];
+    owner[@"bio"] = @"Sports journalist, weather enthusiast and occasional photographer.";
+    owner[@"followers_count"] = @(identifier * 13);
+    item[@"owner"] = owner;
+    item[@"body_html"] = [@"" stringByPaddingToLength:1200 withString:@"<p>Lorem ipsum dolor sit amet.</p>" startingAtIndex:0];
+    NSMutableArray* comments = [NSMutableArray array];
+    for (NSInteger i = 0; i < 4; i++)
+    {
+        [comments addObject:@{ @"id" : @(identifier * 10 + i), @"author" : @"Luigi Verdi", @"text" : @"Great article, thanks for sharing!" }];
+    }
+    item[@"comments"] = comments;
+    item[@"metadata"] = @{ @"revision" : @(identifier % 7), @"source" : @"cms", @"updated_at" : @"2017-10-05T08:00:00Z", @"permalink" : [NSString stringWithFormat:@"https://example.com/items/%ld", (long)identifier] };
+    return item;
+}
+
+/**
+ *  Projection of the server: only the values at key paths.
+ */
++ (id) projectJSONObject:(id)object keyPaths:(NSArray<NSString*>*)keyPaths
+{
+    if ([object isKindOfClass:[NSArray class]])
+    {
+        NSMutableArray* items = [NSMutableArray arrayWithCapacity:[object count]];
+        for (id item in object)
+        {
+            [items addObject:[self projectJSONObject:item keyPaths:keyPaths]];
+        }
+        return items;
+    }
+    if (![object isKindOfClass:[NSDictionary class]])
+    {
+        return object;
+    }
+
+    NSMutableDictionary<NSString*, NSMutableArray<NSString*>*>* nestedKeyPaths = [NSMutableDictionary dictionary];
+    NSMutableDictionary* projection = [NSMutableDictionary dictionary];
+    for (NSString* keyPath in keyPaths)
+    {
+        NSRange dot = [keyPath rangeOfString:@"."];
+        if (dot.location == NSNotFound)
+        {
+            projection[keyPath] = object[keyPath];
+            continue;
+        }
+        NSString* key = [keyPath substringToIndex:dot.location];
+        if (!nestedKeyPaths[key])
+        {
+            nestedKeyPaths[key] = [NSMutableArray array];
+        }
+        [nestedKeyPaths[key] addObject:[keyPath substringFromIndex:dot.location + 1]];
+    }
+    for (NSString* key in nestedKeyPaths)
+    {
+        projection[key] = [self projectJSONObject:object[key] keyPaths:nestedKeyPaths[key]];
+    }
+    return projection;
+}
+
+- (SDBenchmarkResult*) measureWithName:(NSString*)name data:(NSData*)data models:(NSArray**)models
+{
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:BENCHMARK_FIELDSET_RUNS];
+    NSUInteger successes = 0;
+    SDBenchmarkSparseItemListService* service = [SDBenchmarkSparseItemListService new];
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger run = 0; run < BENCHMARK_FIELDSET_RUNS; run++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime runStartTime = CFAbsoluteTimeGetCurrent();
+            NSError* error = nil;
+            id object = [NSJSONSerialization JSONObjectWithData:data options:0 error:&error];
+            SDBenchmarkItemListResponse* response = object ? (SDBenchmarkItemListResponse*)[service responseForObject:object error:&error] : nil;
+            [latencies addObject:@(CFAbsoluteTimeGetCurrent() - runStartTime)];
+            if (response && !error)
+            {
+                successes++;
+                *models = response.items;
+            }
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = BENCHMARK_FIELDSET_RUNS;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = BENCHMARK_FIELDSET_RUNS - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    result.parameters = @{ @"response_bytes" : @(data.length) };
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+#pragma mark - Scenarios
+
+- (void) testKeyPathsOfModelClass
+{
+    NSArray<NSString*>* expectedKeyPaths = @[@"created_at", @"id", @"owner.avatar_url", @"owner.display_name", @"owner.id", @"published", @"score", @"summary", @"tags", @"title"];
+    XCTAssertEqualObjects([SDServiceJSONDecoder JSONKeyPathsOfModelClass:[SDBenchmarkItem class]], expectedKeyPaths);
+    XCTAssertEqualObjects([[SDBenchmarkSparseItemListService new] responseJSONKeyPaths], expectedKeyPaths);
+
+    // by default fields go in query string, not with the other parameters
+    SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+    request.count = @10;
+    NSError* error = nil;
+    NSDictionary* parameters = [[SDBenchmarkSparseItemListService new] parametersForRequest:request error:&error];
+    XCTAssertNil(error);
+    XCTAssertNil(parameters[@"fields"]);
+    XCTAssertEqualObjects(parameters[@"count"], @10);
+    XCTAssertEqualObjects([[SDBenchmarkSparseItemListService new] queryParametersForRequest:request], @{ @"fields" : [expectedKeyPaths componentsJoinedByString:@","] });
+    XCTAssertNil([[SDBenchmarkSparseItemListService new] requestHeadersForRequest:request]);
+
+    // fields chosen by the caller are kept, services without fieldsParameterName don't send them
+    request.additionalRequestParameters = @{ @"fields" : @"id" };
+    XCTAssertNil([[SDBenchmarkSparseItemListService new] queryParametersForRequest:request]);
+    XCTAssertEqualObjects([[SDBenchmarkSparseItemListService new] parametersForRequest:request error:&error][@"fields"], @"id");
+    request.additionalRequestParameters = nil;
+    XCTAssertNil([[SDBenchmarkItemListService new] queryParametersForRequest:request]);
+    XCTAssertNil([[SDBenchmarkItemListService new] parametersForRequest:request error:&error][@"fields"]);
+}
+
+- (void) testFieldsPlacementOfPOST
+{
+    SDBenchmarkHTTPServer* server = [SDBenchmarkHTTPServer new];
+    __block SDBenchmarkHTTPRequest* lastRequest = nil;
+    [server setHandler:^SDBenchmarkHTTPResponse* (SDBenchmarkHTTPRequest* request) {
+        @synchronized (server)
+        {
+            lastRequest = request;
+        }
+        NSDictionary* body = [NSJSONSerialization JSONObjectWithData:request.body options:0 error:NULL];
+        NSMutableArray* items = [NSMutableArray array];
+        for (NSUInteger i = 0; i < [body[@"count"] unsignedIntegerValue]; i++)
+        {
+            [items addObject:[SDBenchmarkItem JSONObjectForIdentifier:i]];
+        }
+        return [SDBenchmarkHTTPResponse responseWithStatusCode:200 JSONData:[NSJSONSerialization dataWithJSONObject:items options:0 error:NULL]];
+    } forPathPrefix:@"/items/search"];
+    NSError* error = nil;
+    XCTAssertTrue([server startWithError:&error], @"%@", error);
+
+    fieldsetRequestOperationManager = [[AFHTTPRequestOperationManager alloc] initWithBaseURL:server.baseURL];
+    fieldsetRequestOperationManager.requestSerializer = [AFJSONRequestSerializer serializer];
+    fieldsetRequestOperationManager.responseSerializer = [AFJSONResponseSerializer serializer];
+
+    SDServiceManager* serviceManager = [SDServiceManager new];
+    SDBenchmarkSparseItemSearchService* service = [SDBenchmarkSparseItemSearchService new];
+    NSString* fields = [[service responseJSONKeyPaths] componentsJoinedByString:@","];
+    for (NSNumber* placement in @[@(SDServiceFieldsPlacementQuery), @(SDServiceFieldsPlacementHeader), @(SDServiceFieldsPlacementParameters)])
+    {
+        service.placement = placement.integerValue;
+        SDBenchmarkItemListRequest* request = [SDBenchmarkItemListRequest new];
+        request.count = @(BENCHMARK_FIELDSET_SEARCH_COUNT);
+
+        XCTestExpectation* expectation = [self expectationWithDescription:placement.stringValue];
+        __block NSUInteger numberOfItems = 0;
+        [serviceManager callService:service withRequest:request operationType:0 delegate:nil completionSuccess:^(id<SDServiceGenericResponseProtocol> response) {
+            numberOfItems = ((SDBenchmarkItemListResponse*)response).items.count;
+            [expectation fulfill];
+        } completionFailure:^(id<SDServiceGenericErrorProtocol> error) {
+            [expectation fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:BENCHMARK_FIELDSET_TIMEOUT handler:nil];
+        XCTAssertEqual(numberOfItems, BENCHMARK_FIELDSET_SEARCH_COUNT);
+
+        // the body keeps the parameters of the request, the fieldset goes only where placement says
+        SDBenchmarkHTTPRequest* sentRequest = nil;
+        @synchronized (server)
+        {
+            sentRequest = lastRequest;
+        }
+        NSDictionary* body = [NSJSONSerialization JSONObjectWithData:sentRequest.body options:0 error:NULL];
+        XCTAssertEqualObjects(body[@"count"], @(BENCHMARK_FIELDSET_SEARCH_COUNT));
+        XCTAssertEqualObjects(sentRequest.queryParameters[@"fields"], service.placement == SDServiceFieldsPlacementQuery ? fields : nil);
+        XCTAssertEqualObjects(sentRequest.headers[@"fields"], service.placement == SDServiceFieldsPlacementHeader ? fields : nil);
+        XCTAssertEqualObjects(body[@"fields"], service.placement == SDServiceFieldsPlacementParameters ? fields : nil);
+    }
+
+    [server stop];
+}
+
+- (void) testSparseListResponse
+{
+    NSUInteger numberOfItems = [SDBenchmarkRunner scaledCount:BENCHMARK_FIELDSET_ITEMS minimum:100];
+    NSMutableArray* fullJSONArray = [NSMutableArray arrayWithCapacity:numberOfItems];
+    for (NSUInteger i = 0; i < numberOfItems; i++)
+    {
+        [fullJSONArray addObject:[[self class] fullJSONObjectForIdentifier:i]];
+    }
+    NSArray<NSString*>* keyPaths = [[SDBenchmarkSparseItemListService new] responseJSONKeyPaths];
+    NSData* fullData = [NSJSONSerialization dataWithJSONObject:fullJSONArray options:0 error:NULL];
+    NSData* sparseData = [NSJSONSerialization dataWithJSONObject:[[self class] projectJSONObject:fullJSONArray keyPaths:keyPaths] options:0 error:NULL];
+
+    NSArray* fullModels = nil;
+    NSArray* sparseModels = nil;
+    SDBenchmarkResult* fullResult = [self measureWithName:@"fieldset_all_fields" data:fullData models:&fullModels];
+    SDBenchmarkResult* sparseResult = [self measureWithName:@"fieldset_sparse" data:sparseData models:&sparseModels];
+
+    // same models from a much smaller payload
+    XCTAssertEqual(fullResult.successes, BENCHMARK_FIELDSET_RUNS);
+    XCTAssertEqual(sparseResult.successes, BENCHMARK_FIELDSET_RUNS);
+    XCTAssertEqualObjects(sparseModels, fullModels);
+    double reduction = 1. - (double)sparseData.length / fullData.length;
+    NSLog(@"Sparse fieldset: %lu -> %lu bytes (%.0f%% smaller), mapping %.1f -> %.1f ms", (unsigned long)fullData.length, (unsigned long)sparseData.length, reduction * 100., [fullResult latencyAtPercentile:50] * 1000., [sparseResult latencyAtPercentile:50] * 1000.);
+    XCTAssertGreaterThan(reduction, 0.6);
+}
+
+@end
@@ -0,0 +1,274 @@
+//
+//  SOCPatternBenchmarks.m
+//  DockerTests
+//
+//  Service paths built with percentEncodedStringFromObject: against stringFromObject: plus percent encoding of the whole path.
+//  Paths of both must be the same for every return type of the getters, key paths and values to encode.
+//
+//  Results are logged one per line (prefix SD_BENCHMARK_RESULT), latencies are the mean time to build a path in every batch.
+//
+
+@import XCTest;
+#import <Docker/SOCKit.h>
+#import "SDBenchmarkRunner.h"
+
+#define BENCHMARK_PATTERN_PATHS             50000
+#define BENCHMARK_PATTERN_BATCH             100
+#define BENCHMARK_PATTERN_CHUNK_SIZE        256
+
+@interface SOCPatternBenchmarkChild : NSObject
+
+@property (nonatomic, strong) NSString* name;
+
+@end
+
+@implementation SOCPatternBenchmarkChild
+
+@end
+
+@interface SOCPatternBenchmarkObject : NSObject
+
+@property (nonatomic, assign) BOOL flag;
+@property (nonatomic, assign) char letter;
+@property (nonatomic, assign) short shortValue;
+@property (nonatomic, assign) int intValue;
+@property (nonatomic, assign) long longValue;
+@property (nonatomic, assign) long long longLongValue;
+@property (nonatomic, assign) unsigned char unsignedCharValue;
+@property (nonatomic, assign) unsigned short unsignedShortValue;
+@property (nonatomic, assign) unsigned int unsignedIntValue;
+@property (nonatomic, assign) unsigned long unsignedLongValue;
+@property (nonatomic, assign) unsigned long long unsignedLongLongValue;
+@property (nonatomic, assign) float floatValue;
+@property (nonatomic, assign) double doubleValue;
+@property (nonatomic, strong) NSNumber* number;
+@property (nonatomic, strong) NSString* string;
+@property (nonatomic, strong) SOCPatternBenchmarkChild* child;
+@property (nonatomic, strong) NSArray* items;
+
+@end
+
+@implementation SOCPatternBenchmarkObject
+
+@end
+
+
+@interface SOCPatternBenchmarks : XCTestCase
+
+@property (nonatomic, strong) NSCharacterSet* pathAllowedCharacters;
+
+@end
+
+@implementation SOCPatternBenchmarks
+
+- (void) setUp
+{
+    [super setUp];
+
+    // RFC 3986 pchar, plus "/"
+    self.pathAllowedCharacters = [NSCharacterSet characterSetWithCharactersInString:@"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~!$&'()*+,;=:@/"];
+}
+
+- (SOCPatternBenchmarkObject*) objectWithString:(NSString*)string
+{
+    SOCPatternBenchmarkObject* object = [SOCPatternBenchmarkObject new];
+    object.flag = YES;
+    object.letter = 'A';
+    object.shortValue = -12;
+    object.intValue = -123456;
+    object.longValue = LONG_MIN;
+    object.longLongValue = LLONG_MIN;
+    object.unsignedCharValue = 200;
+    object.unsignedShortValue = USHRT_MAX;
+    object.unsignedIntValue = UINT_MAX;
+    object.unsignedLongValue = ULONG_MAX;
+    object.unsignedLongLongValue = ULLONG_MAX;
+    object.floatValue = 0.1f;
+    object.doubleValue = -1.5e-300;
+    object.number = @(3.25);
+    object.string = string;
+    object.child = [SOCPatternBenchmarkChild new];
+    object.child.name = string;
+    object.items = @[@1, @2, @3];
+    return object;
+}
+
+/**
+ *  Path of stringFromObject: encoded as a whole: patterns of these tests have no "%" in static text.
+ */
+- (NSString*) expectedPathOfPattern:(SOCPattern*)pattern object:(id)object
+{
+    return [[pattern stringFromObject:object] stringByAddingPercentEncodingWithAllowedCharacters:self.pathAllowedCharacters];
+}
+
+- (void) assertSamePathOfPatternString:(NSString*)patternString object:(id)object
+{
+    SOCPattern* pattern = [SOCPattern patternWithString:patternString];
+    XCTAssertEqualObjects([pattern percentEncodedStringFromObject:object], [self expectedPathOfPattern:pattern object:object], @"%@", patternString);
+}
+
+#pragma mark - Same paths
+
+- (void) testSamePathForEveryReturnType
+{
+    NSArray<NSString*>* keys = @[@"flag", @"letter", @"shortValue", @"intValue", @"longValue", @"longLongValue",
+                                 @"unsignedCharValue", @"unsignedShortValue", @"unsignedIntValue", @"unsignedLongValue", @"unsignedLongLongValue",
+                                 @"floatValue", @"doubleValue", @"number", @"string"];
+    SOCPatternBenchmarkObject* object = [self objectWithString:@"plain"];
+    for (NSString* key in keys)
+    {
+        [self assertSamePathOfPatternString:[NSString stringWithFormat:@"/values/:%@/end", key] object:object];
+    }
+
+    // all parameters of the same pattern, accessors are cached by class
+    NSMutableString* patternString = [NSMutableString string];
+    for (NSString* key in keys)
+    {
+        [patternString appendFormat:@"/%@/:%@", key, key];
+    }
+    [self assertSamePathOfPatternString:patternString object:object];
+    [self assertSamePathOfPatternString:patternString object:object];
+}
+
+- (void) testSamePathForBooleanValues
+{
+    SOCPatternBenchmarkObject* object = [self objectWithString:@"plain"];
+    object.flag = NO;
+    object.letter = 0;
+    [self assertSamePathOfPatternString:@"/flags/:flag/:letter" object:object];
+}
+
+- (void) testSamePathForFloatingPointValues
+{
+    SOCPatternBenchmarkObject* object = [self objectWithString:@"plain"];
+    NSArray<NSNumber*>* values = @[@0., @(-0.), @1., @(1. / 3.), @1e20, @1e-20, @(DBL_MAX), @(INFINITY), @(NAN)];
+    for (NSNumber* value in values)
+    {
+        object.floatValue = value.floatValue;
+        object.doubleValue = value.doubleValue;
+        [self assertSamePathOfPatternString:@"/float/:floatValue/double/:doubleValue" object:object];
+    }
+}
+
+- (void) testSamePathForNilValues
+{
+    SOCPatternBenchmarkObject* object = [self objectWithString:nil];
+    object.number = nil;
+    object.child = nil;
+    [self assertSamePathOfPatternString:@"/nil/:string/:number/:child.name" object:object];
+    XCTAssertEqualObjects([[SOCPattern patternWithString:@"/nil/:string"] percentEncodedStringFromObject:object], @"/nil/(null)");
+}
+
+- (void) testSamePathForKeyPaths
+{
+    SOCPatternBenchmarkObject* object = [self objectWithString:@"child name/sub"];
+    [self assertSamePathOfPatternString:@"/children/:child.name/items/:items.@count" object:object];
+}
+
+- (void) testSamePathForEncodedCharacters
+{
+    NSArray<NSString*>* strings = @[@"with space", @"sub/path", @"query?and#fragment", @"città", @"emoji 😀 and 𝄞", @"\"quotes\" <tags> [brackets] {braces} |pipe| \\backslash^", @"tab\tnewline\n"];
+    for (NSString* string in strings)
+    {
+        [self assertSamePathOfPatternString:@"/strings/:string/:child.name" object:[self objectWithString:string]];
+    }
+}
+
+#pragma mark - Percent sign
+
+- (void) testPercentSign
+{
+    NSDictionary<NSString*, NSString*>* expectedPaths = @{
+                                                           @"50%" : @"/values/50%25",
+                                                           @"a%zz" : @"/values/a%25zz",
+                                                           @"%" : @"/values/%25",
+                                                           @"%4" : @"/values/%254",
+                                                           @"%2F" : @"/values/%2F",
+                                                           @"%c3%a0" : @"/values/%c3%a0",
+                                                           @"100%%41" : @"/values/100%25%41",
+                                                           @"50% off" : @"/values/50%25%20off",
+                                                           };
+    SOCPattern* pattern = [SOCPattern patternWithString:@"/values/:string"];
+    [expectedPaths enumerateKeysAndObjectsUsingBlock:^(NSString* string, NSString* expectedPath, BOOL* stop) {
+        NSString* path = [pattern percentEncodedStringFromObject:[self objectWithString:string]];
+        XCTAssertEqualObjects(path, expectedPath, @"%@", string);
+        XCTAssertNotNil([NSURL URLWithString:path], @"%@", string);
+    }];
+}
+
+- (void) testPercentSignAtChunkBoundary
+{
+    // strings are encoded in chunks: escapes cut by the end of a chunk are still recognized
+    SOCPattern* pattern = [SOCPattern patternWithString:@":string"];
+    for (NSUInteger offset = 0; offset < 4; offset++)
+    {
+        NSString* prefix = [@"" stringByPaddingToLength:BENCHMARK_PATTERN_CHUNK_SIZE - offset withString:@"a" startingAtIndex:0];
+        XCTAssertEqualObjects([pattern percentEncodedStringFromObject:[self objectWithString:[prefix stringByAppendingString:@"%41b"]]], [prefix stringByAppendingString:@"%41b"]);
+        XCTAssertEqualObjects([pattern percentEncodedStringFromObject:[self objectWithString:[prefix stringByAppendingString:@"%zzb"]]], [prefix stringByAppendingString:@"%25zzb"]);
+    }
+}
+
+#pragma mark - Scenarios
+
+- (SDBenchmarkResult*) measureWithName:(NSString*)name pathBlock:(NSString* (^)(SOCPatternBenchmarkObject* object))pathBlock
+{
+    NSMutableArray<SOCPatternBenchmarkObject*>* objects = [NSMutableArray arrayWithCapacity:BENCHMARK_PATTERN_BATCH];
+    for (NSUInteger i = 0; i < BENCHMARK_PATTERN_BATCH; i++)
+    {
+        SOCPatternBenchmarkObject* object = [self objectWithString:[NSString stringWithFormat:@"user %lu", (unsigned long)i]];
+        object.intValue = (int)i;
+        [objects addObject:object];
+    }
+
+    NSUInteger numberOfPaths = [SDBenchmarkRunner scaledCount:BENCHMARK_PATTERN_PATHS minimum:BENCHMARK_PATTERN_BATCH];
+    NSUInteger numberOfBatches = numberOfPaths / BENCHMARK_PATTERN_BATCH;
+    NSMutableArray<NSNumber*>* latencies = [NSMutableArray arrayWithCapacity:numberOfBatches];
+    NSUInteger successes = 0;
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger batch = 0; batch < numberOfBatches; batch++)
+    {
+        @autoreleasepool
+        {
+            CFAbsoluteTime batchStartTime = CFAbsoluteTimeGetCurrent();
+            for (SOCPatternBenchmarkObject* object in objects)
+            {
+                successes += pathBlock(object).length > 0 ? 1 : 0;
+            }
+            [latencies addObject:@((CFAbsoluteTimeGetCurrent() - batchStartTime) / BENCHMARK_PATTERN_BATCH)];
+        }
+    }
+
+    SDBenchmarkResult* result = [SDBenchmarkResult new];
+    result.name = name;
+    result.numberOfCalls = numberOfBatches * BENCHMARK_PATTERN_BATCH;
+    result.concurrency = 1;
+    result.successes = successes;
+    result.failures = result.numberOfCalls - successes;
+    result.completed = YES;
+    result.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+    result.latencies = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    NSLog(@"SD_BENCHMARK_RESULT %@", [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:[result dictionaryRepresentation] options:0 error:NULL] encoding:NSUTF8StringEncoding]);
+    return result;
+}
+
+- (void) testStringFromObject
+{
+    SOCPattern* pattern = [SOCPattern patternWithString:@"/api/v1/users/:string/items/:intValue/flags/:flag"];
+    NSCharacterSet* allowedCharacters = self.pathAllowedCharacters;
+    SDBenchmarkResult* result = [self measureWithName:@"pattern_string_from_object" pathBlock:^NSString* (SOCPatternBenchmarkObject* object) {
+        return [[pattern stringFromObject:object] stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters];
+    }];
+    XCTAssertEqual(result.failures, 0);
+}
+
+- (void) testPercentEncodedStringFromObject
+{
+    SOCPattern* pattern = [SOCPattern patternWithString:@"/api/v1/users/:string/items/:intValue/flags/:flag"];
+    SDBenchmarkResult* result = [self measureWithName:@"pattern_percent_encoded_string_from_object" pathBlock:^NSString* (SOCPatternBenchmarkObject* object) {
+        return [pattern percentEncodedStringFromObject:object];
+    }];
+    XCTAssertEqual(result.failures, 0);
+}
+
+@end